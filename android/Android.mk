@@ -338,6 +338,7 @@ LOCAL_SRC_FILES := \
 	bluez/monitor/display.c \
 	bluez/monitor/hcidump.c \
 	bluez/monitor/control.c \
+	bluez/monitor/filter.c \
 	bluez/monitor/packet.c \
 	bluez/monitor/l2cap.c \
 	bluez/monitor/avctp.c \
@@ -361,6 +362,7 @@ LOCAL_SRC_FILES := \
 	bluez/src/shared/queue.c \
 	bluez/src/shared/crypto.c \
 	bluez/src/shared/btsnoop.c \
+	bluez/src/shared/monitor-filter.c \
 	bluez/src/shared/mainloop.c \
 	bluez/lib/hci.c \
 	bluez/lib/bluetooth.c \
@@ -62,6 +62,9 @@
 #define GATT_PAIR_CONN_TIMEOUT 30
 #define GATT_CONN_TIMEOUT 2
 
+#define NOTIFY_BATCH_INTERVAL 5
+#define NOTIFY_BATCH_MAX (IPC_MTU - sizeof(struct ipc_hdr))
+
 static const uint8_t BLUETOOTH_UUID[] = {
 	0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
 	0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
@@ -139,6 +142,7 @@ struct notification_data {
 	guint notif_id;
 	guint ind_id;
 	int ref;
+	gint64 last_notify;
 };
 
 struct gatt_device {
@@ -205,6 +209,10 @@ static uint32_t dis_sdp_handle = 0;
 static struct bt_crypto *crypto = NULL;
 
 static int test_client_if = 0;
+
+static uint8_t notify_batch[NOTIFY_BATCH_MAX];
+static uint16_t notify_batch_len = 0;
+static guint notify_batch_id = 0;
 static const uint8_t TEST_UUID[] = {
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04
@@ -806,6 +814,23 @@ static void send_server_connection_state_notify(struct app_connection *conn,
 				HAL_EV_GATT_SERVER_CONNECTION, sizeof(ev), &ev);
 }
 
+static void flush_notify_batch(void)
+{
+	if (notify_batch_id) {
+		g_source_remove(notify_batch_id);
+		notify_batch_id = 0;
+	}
+
+	if (!notify_batch_len)
+		return;
+
+	ipc_send_notif(hal_ipc, HAL_SERVICE_ID_GATT,
+				HAL_EV_GATT_CLIENT_NOTIFY_BATCH,
+				notify_batch_len, notify_batch);
+
+	notify_batch_len = 0;
+}
+
 static void send_client_disconnect_status_notify(struct app_connection *conn,
 								int32_t status)
 {
@@ -823,6 +848,9 @@ static void send_client_disconnect_status_notify(struct app_connection *conn,
 
 	bdaddr2android(&conn->device->bdaddr, &ev.bda);
 
+	/* Pending notifications must not be delivered after disconnection */
+	flush_notify_batch();
+
 	ipc_send_notif(hal_ipc, HAL_SERVICE_ID_GATT,
 				HAL_EV_GATT_CLIENT_DISCONNECT, sizeof(ev), &ev);
 
@@ -3645,6 +3673,59 @@ reply:
 		send_client_write_execute_notify(cmd->conn_id, GATT_FAILURE);
 }
 
+static gboolean notify_batch_timeout(gpointer user_data)
+{
+	notify_batch_id = 0;
+
+	flush_notify_batch();
+
+	return FALSE;
+}
+
+/*
+ * Notifications received within NOTIFY_BATCH_INTERVAL of the previous one
+ * on the same registration are queued and sent to the HAL in one message,
+ * isolated ones are still sent right away.
+ */
+static bool batch_notification(struct notification_data *notification,
+					struct hal_ev_gatt_client_notify *ev)
+{
+	struct hal_ev_gatt_client_notify_batch *batch = (void *) notify_batch;
+	uint16_t len = sizeof(*ev) + ev->len;
+	gint64 now, last;
+
+	now = g_get_monotonic_time();
+	last = notification->last_notify;
+	notification->last_notify = now;
+
+	if (!ev->is_notify || sizeof(*batch) + len > NOTIFY_BATCH_MAX) {
+		flush_notify_batch();
+		return false;
+	}
+
+	if (!notify_batch_len && now - last >= NOTIFY_BATCH_INTERVAL * 1000)
+		return false;
+
+	if (notify_batch_len + len > NOTIFY_BATCH_MAX ||
+						batch->num == UINT8_MAX)
+		flush_notify_batch();
+
+	if (!notify_batch_len) {
+		batch->num = 0;
+		notify_batch_len = sizeof(*batch);
+	}
+
+	memcpy(notify_batch + notify_batch_len, ev, len);
+	notify_batch_len += len;
+	batch->num++;
+
+	if (!notify_batch_id)
+		notify_batch_id = g_timeout_add(NOTIFY_BATCH_INTERVAL,
+						notify_batch_timeout, NULL);
+
+	return true;
+}
+
 static void handle_notification(const uint8_t *pdu, uint16_t len,
 							gpointer user_data)
 {
@@ -3666,6 +3747,9 @@ static void handle_notification(const uint8_t *pdu, uint16_t len,
 	ev->len = len - data_offset;
 	memcpy(ev->value, pdu + data_offset, len - data_offset);
 
+	if (batch_notification(notification, ev))
+		return;
+
 	ipc_send_notif(hal_ipc, HAL_SERVICE_ID_GATT, HAL_EV_GATT_CLIENT_NOTIFY,
 						sizeof(*ev) + ev->len, ev);
 }
@@ -7310,6 +7394,13 @@ void bt_gatt_unregister(void)
 {
 	DBG("");
 
+	if (notify_batch_id) {
+		g_source_remove(notify_batch_id);
+		notify_batch_id = 0;
+	}
+
+	notify_batch_len = 0;
+
 	ipc_unregister(hal_ipc, HAL_SERVICE_ID_GATT);
 	hal_ipc = NULL;
 
@@ -326,6 +326,20 @@ static size_t sbc_get_mediapacket_duration(void *codec_data)
 	return sbc_data->frame_duration * sbc_data->frames_per_packet;
 }
 
+static size_t sbc_frames_fit(struct sbc_data *sbc_data, size_t len,
+							size_t mp_data_len)
+{
+	size_t frames = len / sbc_data->in_frame_len;
+
+	if (frames > mp_data_len / sbc_data->out_frame_len)
+		frames = mp_data_len / sbc_data->out_frame_len;
+
+	if (frames > sbc_data->frames_per_packet)
+		frames = sbc_data->frames_per_packet;
+
+	return frames;
+}
+
 static ssize_t sbc_encode_mediapacket(void *codec_data, const uint8_t *buffer,
 					size_t len, struct media_packet *mp,
 					size_t mp_data_len, size_t *written)
@@ -335,12 +349,14 @@ static ssize_t sbc_encode_mediapacket(void *codec_data, const uint8_t *buffer,
 	size_t consumed = 0;
 	size_t encoded = 0;
 	uint8_t frame_count = 0;
+	size_t frames;
 
 	mp_data_len -= sizeof(mp_sbc->payload);
 
-	while (len - consumed >= sbc_data->in_frame_len &&
-			mp_data_len - encoded >= sbc_data->out_frame_len &&
-			frame_count < sbc_data->frames_per_packet) {
+	/* Size the whole packet up front so the loop only runs the encoder */
+	frames = sbc_frames_fit(sbc_data, len, mp_data_len);
+
+	while (frame_count < frames) {
 		ssize_t read;
 		ssize_t written = 0;
 
@@ -365,6 +381,17 @@ static ssize_t sbc_encode_mediapacket(void *codec_data, const uint8_t *buffer,
 	return consumed;
 }
 
+static ssize_t sbc_skip_mediapacket(void *codec_data, size_t len)
+{
+	struct sbc_data *sbc_data = (struct sbc_data *) codec_data;
+	size_t frames = len / sbc_data->in_frame_len;
+
+	if (frames > sbc_data->frames_per_packet)
+		frames = sbc_data->frames_per_packet;
+
+	return frames * sbc_data->in_frame_len;
+}
+
 static bool sbc_update_qos(void *codec_data, uint8_t op)
 {
 	struct sbc_data *sbc_data = (struct sbc_data *) codec_data;
@@ -383,6 +410,14 @@ static bool sbc_update_qos(void *codec_data, uint8_t op)
 				new_bitpool = SBC_QUALITY_MIN_BITPOOL;
 		}
 		break;
+
+	case QOS_POLICY_INCREASE:
+		if (curr_bitpool < sbc_data->sbc.max_bitpool) {
+			new_bitpool = curr_bitpool + SBC_QUALITY_STEP;
+			if (new_bitpool > sbc_data->sbc.max_bitpool)
+				new_bitpool = sbc_data->sbc.max_bitpool;
+		}
+		break;
 	}
 
 	if (new_bitpool == curr_bitpool)
@@ -409,6 +444,7 @@ static const struct audio_codec codec = {
 	.get_buffer_size = sbc_get_buffer_size,
 	.get_mediapacket_duration = sbc_get_mediapacket_duration,
 	.encode_mediapacket = sbc_encode_mediapacket,
+	.skip_mediapacket = sbc_skip_mediapacket,
 	.update_qos = sbc_update_qos,
 };
 
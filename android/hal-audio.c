@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -34,6 +35,15 @@
 
 #define MAX_DELAY	100000 /* 100ms */
 
+/*
+ * Socket backlog thresholds in media packets. Send buffer accounting
+ * includes per-skb overhead, so these are on the generous side.
+ */
+#define BACKLOG_HIGH	8
+#define BACKLOG_LOW	2
+#define BACKLOG_HOLD	200000 /* 200ms between bitpool decreases */
+#define BACKLOG_RAISE	2000000 /* 2s of low backlog before increasing */
+
 static const uint8_t a2dp_src_uuid[] = {
 		0x00, 0x00, 0x11, 0x0a, 0x00, 0x00, 0x10, 0x00,
 		0x80, 0x00, 0x00, 0x80, 0x5f, 0x9b, 0x34, 0xfb };
@@ -113,6 +123,11 @@ struct audio_endpoint {
 	struct timespec start;
 
 	bool resync;
+
+	int sndbuf;
+	bool backlog_low;
+	struct timespec backlog_since;
+	struct timespec qos_update;
 };
 
 static struct audio_endpoint audio_endpoints[MAX_AUDIO_ENDPOINTS];
@@ -562,6 +577,8 @@ static bool resume_endpoint(struct audio_endpoint *ep)
 
 	ep->samples = 0;
 	ep->resync = false;
+	ep->sndbuf = 0;
+	ep->backlog_low = false;
 
 	ep->codec->update_qos(ep->codec_data, QOS_POLICY_DEFAULT);
 
@@ -645,6 +662,70 @@ static bool write_to_endpoint(struct audio_endpoint *ep, size_t bytes)
 	return true;
 }
 
+/*
+ * Adjust codec bitrate to the L2CAP send queue: back off as soon as
+ * packets start piling up in the socket, rather than waiting until it
+ * is full and we block, and move back up once it has stayed drained.
+ */
+static void check_backlog(struct audio_endpoint *ep, size_t pkt_len)
+{
+	struct timespec now;
+	socklen_t len;
+	int space;
+	size_t queued;
+
+	if (!pkt_len)
+		return;
+
+	if (!ep->sndbuf) {
+		len = sizeof(ep->sndbuf);
+		if (getsockopt(ep->fd, SOL_SOCKET, SO_SNDBUF, &ep->sndbuf,
+								&len) < 0) {
+			ep->sndbuf = -1;
+			return;
+		}
+	}
+
+	/* For Bluetooth sockets TIOCOUTQ reports free send buffer space */
+	if (ep->sndbuf < 0 || ioctl(ep->fd, TIOCOUTQ, &space) < 0)
+		return;
+
+	queued = space < ep->sndbuf ? ep->sndbuf - space : 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (queued >= BACKLOG_HIGH * pkt_len) {
+		ep->backlog_low = false;
+
+		if (timespec_diff_us(&now, &ep->qos_update) < BACKLOG_HOLD)
+			return;
+
+		if (ep->codec->update_qos(ep->codec_data, QOS_POLICY_DECREASE))
+			ep->qos_update = now;
+
+		return;
+	}
+
+	if (queued > BACKLOG_LOW * pkt_len) {
+		ep->backlog_low = false;
+		return;
+	}
+
+	if (!ep->backlog_low) {
+		ep->backlog_low = true;
+		ep->backlog_since = now;
+		return;
+	}
+
+	if (timespec_diff_us(&now, &ep->backlog_since) < BACKLOG_RAISE)
+		return;
+
+	if (ep->codec->update_qos(ep->codec_data, QOS_POLICY_INCREASE))
+		ep->qos_update = now;
+
+	ep->backlog_since = now;
+}
+
 static bool write_data(struct a2dp_stream_out *out, const void *buffer,
 								size_t bytes)
 {
@@ -671,6 +752,32 @@ static bool write_data(struct a2dp_stream_out *out, const void *buffer,
 			mp_rtp->hdr.sequence_number = htons(ep->seq++);
 			mp_rtp->hdr.timestamp = htonl(ep->samples);
 		}
+
+		/*
+		 * media packets are dropped while resyncing, so don't spend
+		 * time encoding them if we're still behind and codec can
+		 * tell how much input a packet takes without encoding it
+		 */
+		if (ep->resync && ep->codec->skip_mediapacket) {
+			clock_gettime(CLOCK_MONOTONIC, &current);
+			audio_sent = ep->samples * 1000000ll / out->cfg.rate;
+			audio_passed = timespec_diff_us(&current, &ep->start);
+
+			if (audio_sent <= audio_passed) {
+				read = ep->codec->skip_mediapacket(
+							ep->codec_data,
+							bytes - consumed);
+				if (read <= 0)
+					return true;
+
+				samples = read /
+					(2 * popcount(out->cfg.channels));
+				ep->samples += samples;
+				consumed += read;
+				continue;
+			}
+		}
+
 		read = ep->codec->encode_mediapacket(ep->codec_data,
 						buffer + consumed,
 						bytes - consumed, mp,
@@ -746,6 +853,8 @@ static bool write_data(struct a2dp_stream_out *out, const void *buffer,
 
 				if (!write_to_endpoint(ep, written))
 					return false;
+
+				check_backlog(ep, written);
 			}
 		}
 
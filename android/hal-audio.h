@@ -79,11 +79,13 @@ struct audio_codec {
 	ssize_t (*encode_mediapacket) (void *codec_data, const uint8_t *buffer,
 					size_t len, struct media_packet *mp,
 					size_t mp_data_len, size_t *written);
+	ssize_t (*skip_mediapacket) (void *codec_data, size_t len);
 	bool (*update_qos) (void *codec_data, uint8_t op);
 };
 
 #define QOS_POLICY_DEFAULT	0x00
 #define QOS_POLICY_DECREASE	0x01
+#define QOS_POLICY_INCREASE	0x02
 
 typedef const struct audio_codec * (*audio_codec_get_t) (void);
 
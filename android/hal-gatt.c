@@ -181,16 +181,10 @@ static void handle_register_for_notification(void *buf, uint16_t len, int fd)
 								&char_id);
 }
 
-static void handle_notify(void *buf, uint16_t len, int fd)
+static void notify(struct hal_ev_gatt_client_notify *ev)
 {
-	struct hal_ev_gatt_client_notify *ev = buf;
 	btgatt_notify_params_t params;
 
-	if (len != sizeof(*ev) + ev->len) {
-		error("gatt: invalid notify event, aborting");
-		exit(EXIT_FAILURE);
-	}
-
 	memset(&params, 0, sizeof(params));
 	memcpy(params.value, ev->value, ev->len);
 	memcpy(&params.bda, ev->bda, sizeof(params.bda));
@@ -205,6 +199,46 @@ static void handle_notify(void *buf, uint16_t len, int fd)
 		cbs->client->notify_cb(ev->conn_id, &params);
 }
 
+static void handle_notify(void *buf, uint16_t len, int fd)
+{
+	struct hal_ev_gatt_client_notify *ev = buf;
+
+	if (len != sizeof(*ev) + ev->len) {
+		error("gatt: invalid notify event, aborting");
+		exit(EXIT_FAILURE);
+	}
+
+	notify(ev);
+}
+
+static void handle_notify_batch(void *buf, uint16_t len, int fd)
+{
+	struct hal_ev_gatt_client_notify_batch *ev = buf;
+	uint8_t *ptr = ev->data;
+	uint8_t i;
+
+	len -= sizeof(*ev);
+
+	for (i = 0; i < ev->num; i++) {
+		struct hal_ev_gatt_client_notify *notif = (void *) ptr;
+
+		if (len < sizeof(*notif) || len < sizeof(*notif) + notif->len) {
+			error("gatt: invalid notify batch event, aborting");
+			exit(EXIT_FAILURE);
+		}
+
+		notify(notif);
+
+		ptr += sizeof(*notif) + notif->len;
+		len -= sizeof(*notif) + notif->len;
+	}
+
+	if (len) {
+		error("gatt: invalid notify batch event, aborting");
+		exit(EXIT_FAILURE);
+	}
+}
+
 static void handle_read_characteristic(void *buf, uint16_t len, int fd)
 {
 	struct hal_ev_gatt_client_read_characteristic *ev = buf;
@@ -787,6 +821,9 @@ static const struct hal_ipc_handler ev_handlers[] = {
 	/* HAL_EV_GATT_SERVER_MTU_CHANGED */
 	{ handle_server_mtu_changed, false,
 		sizeof(struct hal_ev_gatt_server_mtu_changed) },
+	/* HAL_EV_GATT_CLIENT_NOTIFY_BATCH */
+	{ handle_notify_batch, true,
+		sizeof(struct hal_ev_gatt_client_notify_batch) },
 	};
 
 /* Client API */
@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/mman.h>
 #include <stdbool.h>
 #include <poll.h>
 #include <unistd.h>
@@ -32,6 +33,10 @@ static pthread_mutex_t cmd_sk_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_t notif_th = 0;
 
+static struct ipc_ring *ring_map = NULL;
+static struct ipc_ring *ring = NULL;
+static int ring_event = -1;
+
 struct service_handler {
 	const struct hal_ipc_handler *handler;
 	uint8_t size;
@@ -116,6 +121,138 @@ static bool handle_msg(void *buf, ssize_t len, int fd)
 	return true;
 }
 
+static void ring_copy(void *buf, uint32_t pos, size_t len)
+{
+	size_t off = pos & IPC_RING_MASK;
+	size_t n = len < IPC_RING_SIZE - off ? len : IPC_RING_SIZE - off;
+
+	memcpy(buf, ring->data + off, n);
+	memcpy((uint8_t *) buf + n, ring->data, len - n);
+}
+
+static ssize_t ring_recv(void *buf, size_t size)
+{
+	struct ipc_hdr *hdr = buf;
+	uint32_t head, tail;
+	size_t len;
+
+	tail = ring->tail;
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if (head == tail)
+		return 0;
+
+	if (head - tail < sizeof(*hdr)) {
+		error("IPC: ring record truncated");
+		return -1;
+	}
+
+	ring_copy(hdr, tail, sizeof(*hdr));
+
+	len = sizeof(*hdr) + hdr->len;
+	if (len > size || head - tail < len) {
+		error("IPC: ring record malformed (%zu bytes)", len);
+		return -1;
+	}
+
+	ring_copy(hdr->payload, tail + sizeof(*hdr), hdr->len);
+
+	__atomic_store_n(&ring->tail, tail + len, __ATOMIC_RELEASE);
+
+	return len;
+}
+
+/* Returns true if the notification socket needs to be read */
+static bool ring_wait(void)
+{
+	struct pollfd pfd[2];
+	uint64_t val;
+
+	memset(pfd, 0, sizeof(pfd));
+
+	__atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->head, __ATOMIC_RELAXED) == ring->tail) {
+		pfd[0].fd = ring_event;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = notif_sk;
+		pfd[1].events = POLLIN;
+
+		if (poll(pfd, 2, -1) < 0 && errno != EINTR)
+			error("IPC: ring poll failed: %s", strerror(errno));
+	}
+
+	__atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+
+	if (pfd[0].revents & POLLIN) {
+		if (read(ring_event, &val, sizeof(val)) < 0)
+			error("IPC: ring event read failed: %s",
+							strerror(errno));
+	}
+
+	return pfd[1].revents != 0;
+}
+
+static void ring_cleanup(void)
+{
+	if (ring_map)
+		munmap(ring_map, sizeof(*ring_map));
+
+	if (ring_event >= 0)
+		close(ring_event);
+
+	ring_map = NULL;
+	ring = NULL;
+	ring_event = -1;
+}
+
+static bool handle_notif_ring(void *buf, ssize_t len, int fd)
+{
+	struct ipc_hdr *msg = buf;
+	struct hal_ev_notif_ring *ev = (void *) msg->payload;
+
+	if (len != (ssize_t) (sizeof(*msg) + sizeof(*ev)) ||
+				msg->service_id != HAL_SERVICE_ID_CORE ||
+				msg->opcode != HAL_EV_NOTIF_RING)
+		return false;
+
+	if (fd < 0) {
+		error("IPC: notification ring without descriptor");
+		exit(EXIT_FAILURE);
+	}
+
+	switch (ev->type) {
+	case HAL_NOTIF_RING_MEMORY:
+		ring_map = mmap(NULL, sizeof(*ring_map), PROT_READ | PROT_WRITE,
+							MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (ring_map == MAP_FAILED) {
+			ring_map = NULL;
+			error("IPC: failed to map ring: %s", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		break;
+	case HAL_NOTIF_RING_EVENT:
+		if (!ring_map) {
+			error("IPC: ring event before ring memory");
+			exit(EXIT_FAILURE);
+		}
+
+		ring_event = fd;
+		ring = ring_map;
+
+		info("IPC notification ring enabled");
+		break;
+	default:
+		error("IPC: invalid notification ring type (0x%x)", ev->type);
+		exit(EXIT_FAILURE);
+	}
+
+	return true;
+}
+
 static void *notification_handler(void *data)
 {
 	struct msghdr msg;
@@ -129,6 +266,25 @@ static void *notification_handler(void *data)
 	bt_thread_associate();
 
 	while (true) {
+		if (ring) {
+			struct ipc_hdr *hdr = (void *) buf;
+
+			ret = ring_recv(buf, sizeof(buf));
+			if (ret < 0)
+				goto failed;
+
+			if (ret > 0 && hdr->opcode != IPC_OP_STATUS) {
+				if (!handle_msg(buf, ret, -1))
+					goto failed;
+
+				continue;
+			}
+
+			/* marker records make us read from the socket */
+			if (ret == 0 && !ring_wait())
+				continue;
+		}
+
 		memset(&msg, 0, sizeof(msg));
 		memset(buf, 0, sizeof(buf));
 		memset(cmsgbuf, 0, sizeof(cmsgbuf));
@@ -174,6 +330,9 @@ static void *notification_handler(void *data)
 			}
 		}
 
+		if (handle_notif_ring(buf, ret, fd))
+			continue;
+
 		if (!handle_msg(buf, ret, fd))
 			goto failed;
 	}
@@ -181,6 +340,8 @@ static void *notification_handler(void *data)
 	close(notif_sk);
 	notif_sk = -1;
 
+	ring_cleanup();
+
 	bt_thread_disassociate();
 
 	DBG("exit");
@@ -252,6 +413,11 @@ bool hal_ipc_accept(void)
 
 	info("IPC connected");
 
+	/* Notifications keep using the socket if the ring is not available */
+	if (hal_ipc_cmd(HAL_SERVICE_ID_CORE, HAL_OP_SETUP_NOTIF_RING, 0, NULL,
+					NULL, NULL, NULL) != HAL_STATUS_SUCCESS)
+		info("IPC notification ring not available");
+
 	return true;
 }
 
@@ -82,6 +82,16 @@ struct hal_cmd_configuration {
 	struct hal_config_prop props[0];
 } __attribute__((packed));
 
+#define HAL_OP_SETUP_NOTIF_RING		0x04
+
+#define HAL_NOTIF_RING_MEMORY		IPC_RING_MEMORY
+#define HAL_NOTIF_RING_EVENT		IPC_RING_EVENT
+
+#define HAL_EV_NOTIF_RING		0x81
+struct hal_ev_notif_ring {
+	uint8_t type;
+} __attribute__((packed));
+
 /* Bluetooth Core HAL API */
 
 #define HAL_OP_ENABLE			0x01
@@ -2091,6 +2101,12 @@ struct hal_ev_gatt_server_mtu_changed {
 	int32_t mtu;
 } __attribute__((packed));
 
+#define HAL_EV_GATT_CLIENT_NOTIFY_BATCH		0xb1
+struct hal_ev_gatt_client_notify_batch {
+	uint8_t num;
+	uint8_t data[0];
+} __attribute__((packed));
+
 #define HAL_GATT_PERMISSION_READ			0x0001
 #define HAL_GATT_PERMISSION_READ_ENCRYPTED		0x0002
 #define HAL_GATT_PERMISSION_READ_ENCRYPTED_MITM		0x0004
@@ -23,3 +23,22 @@ struct ipc_hdr {
 struct ipc_status {
 	uint8_t code;
 } __attribute__((packed));
+
+/*
+ * Optional shared memory ring for notifications. Records are an ipc_hdr
+ * followed by its payload, with head and tail running freely over the
+ * power of two sized data area. A record with IPC_OP_STATUS opcode marks
+ * that the next notification was sent over the socket instead.
+ */
+#define IPC_RING_SIZE		(64 * 1024)
+#define IPC_RING_MASK		(IPC_RING_SIZE - 1)
+
+#define IPC_RING_MEMORY		0x00
+#define IPC_RING_EVENT		0x01
+
+struct ipc_ring {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t waiting;
+	uint8_t  data[IPC_RING_SIZE];
+};
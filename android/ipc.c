@@ -20,6 +20,9 @@
 #include <stdbool.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <glib.h>
 
@@ -46,6 +49,9 @@ struct ipc {
 	GIOChannel *notif_io;
 	guint notif_watch;
 
+	struct ipc_ring *ring;
+	int ring_event;
+
 	ipc_disconnect_cb disconnect_cb;
 	void *disconnect_cb_data;
 };
@@ -74,6 +80,12 @@ static void ipc_disconnect(struct ipc *ipc, bool in_cleanup)
 		ipc->notif_io = NULL;
 	}
 
+	if (ipc->ring) {
+		munmap(ipc->ring, sizeof(*ipc->ring));
+		ipc->ring = NULL;
+		close(ipc->ring_event);
+	}
+
 	if (in_cleanup)
 		return;
 
@@ -388,6 +400,71 @@ void ipc_send_rsp_full(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 								param, fd);
 }
 
+static void ring_copy(struct ipc_ring *ring, uint32_t pos, const void *buf,
+								size_t len)
+{
+	size_t off = pos & IPC_RING_MASK;
+	size_t n = MIN(len, IPC_RING_SIZE - off);
+
+	memcpy(ring->data + off, buf, n);
+	memcpy(ring->data, (const uint8_t *) buf + n, len - n);
+}
+
+/*
+ * Returns false if the notification has to be sent over the socket, in
+ * which case a marker record keeps the ordering for the HAL.
+ */
+static bool ring_send(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
+					uint16_t len, void *param, int fd)
+{
+	struct ipc_ring *ring = ipc->ring;
+	struct ipc_hdr m;
+	uint32_t head, avail;
+	bool marker;
+
+	head = ring->head;
+	avail = IPC_RING_SIZE - (head - __atomic_load_n(&ring->tail,
+							__ATOMIC_ACQUIRE));
+
+	memset(&m, 0, sizeof(m));
+
+	/* Always leave room for a marker record */
+	marker = fd >= 0 || avail < 2 * sizeof(m) + len;
+	if (marker) {
+		if (avail < sizeof(m)) {
+			error("IPC notification ring overflow");
+			raise(SIGTERM);
+			return true;
+		}
+
+		m.opcode = IPC_OP_STATUS;
+	} else {
+		m.service_id = service_id;
+		m.opcode = opcode;
+		m.len = len;
+	}
+
+	ring_copy(ring, head, &m, sizeof(m));
+	head += sizeof(m);
+
+	if (m.len) {
+		ring_copy(ring, head, param, len);
+		head += len;
+	}
+
+	__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED)) {
+		uint64_t val = 1;
+
+		if (write(ipc->ring_event, &val, sizeof(val)) < 0)
+			error("IPC ring signal failed: %s", strerror(errno));
+	}
+
+	return !marker;
+}
+
 void ipc_send_notif(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 						uint16_t len, void *param)
 {
@@ -400,10 +477,80 @@ void ipc_send_notif_with_fd(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 	if (!ipc || !ipc->notif_io)
 		return;
 
+	if (ipc->ring && ring_send(ipc, service_id, opcode, len, param, fd))
+		return;
+
 	ipc_send(g_io_channel_unix_get_fd(ipc->notif_io), service_id, opcode,
 								len, param, fd);
 }
 
+static int ring_memfd(void)
+{
+#ifdef __NR_memfd_create
+	return syscall(__NR_memfd_create, "bluetooth-ipc", 0x0001U);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+bool ipc_enable_notif_ring(struct ipc *ipc, uint8_t service_id,
+								uint8_t opcode)
+{
+	struct ipc_ring *ring;
+	uint8_t type;
+	int mem_fd, event_fd, sk;
+
+	if (!ipc->notif_io || ipc->ring)
+		return false;
+
+	mem_fd = ring_memfd();
+	if (mem_fd < 0) {
+		error("IPC: failed to create ring memory: %s",
+							strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(mem_fd, sizeof(*ring)) < 0) {
+		error("IPC: failed to size ring memory: %s", strerror(errno));
+		close(mem_fd);
+		return false;
+	}
+
+	ring = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED,
+								mem_fd, 0);
+	if (ring == MAP_FAILED) {
+		error("IPC: failed to map ring memory: %s", strerror(errno));
+		close(mem_fd);
+		return false;
+	}
+
+	event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (event_fd < 0) {
+		error("IPC: failed to create ring event: %s", strerror(errno));
+		munmap(ring, sizeof(*ring));
+		close(mem_fd);
+		return false;
+	}
+
+	sk = g_io_channel_unix_get_fd(ipc->notif_io);
+
+	type = IPC_RING_MEMORY;
+	ipc_send(sk, service_id, opcode, sizeof(type), &type, mem_fd);
+
+	type = IPC_RING_EVENT;
+	ipc_send(sk, service_id, opcode, sizeof(type), &type, event_fd);
+
+	close(mem_fd);
+
+	ipc->ring = ring;
+	ipc->ring_event = event_fd;
+
+	info("IPC: notification ring enabled");
+
+	return true;
+}
+
 void ipc_register(struct ipc *ipc, uint8_t service,
 			const struct ipc_handler *handlers, uint8_t size)
 {
@@ -32,6 +32,9 @@ void ipc_send_notif(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 void ipc_send_notif_with_fd(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 					uint16_t len, void *param, int fd);
 
+bool ipc_enable_notif_ring(struct ipc *ipc, uint8_t service_id,
+								uint8_t opcode);
+
 void ipc_register(struct ipc *ipc, uint8_t service,
 			const struct ipc_handler *handlers, uint8_t size);
 void ipc_unregister(struct ipc *ipc, uint8_t service);
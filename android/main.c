@@ -461,6 +461,22 @@ static void configuration(const void *buf, uint16_t len)
 							HAL_STATUS_SUCCESS);
 }
 
+static void setup_notif_ring(const void *buf, uint16_t len)
+{
+	uint8_t status;
+
+	DBG("");
+
+	if (ipc_enable_notif_ring(hal_ipc, HAL_SERVICE_ID_CORE,
+							HAL_EV_NOTIF_RING))
+		status = HAL_STATUS_SUCCESS;
+	else
+		status = HAL_STATUS_FAILED;
+
+	ipc_send_rsp(hal_ipc, HAL_SERVICE_ID_CORE, HAL_OP_SETUP_NOTIF_RING,
+									status);
+}
+
 static const struct ipc_handler cmd_handlers[] = {
 	/* HAL_OP_REGISTER_MODULE */
 	{ service_register, false, sizeof(struct hal_cmd_register_module) },
@@ -468,6 +484,8 @@ static const struct ipc_handler cmd_handlers[] = {
 	{ service_unregister, false, sizeof(struct hal_cmd_unregister_module) },
 	/* HAL_OP_CONFIGURATION */
 	{ configuration, true, sizeof(struct hal_cmd_configuration) },
+	/* HAL_OP_SETUP_NOTIF_RING */
+	{ setup_notif_ring, false, 0 },
 };
 
 static void bluetooth_stopped(void)
@@ -44,7 +44,6 @@ struct _GAttrib {
 	struct queue *callbacks;
 	uint8_t *buf;
 	int buflen;
-	struct queue *track_ids;
 };
 
 struct attrib_callbacks {
@@ -92,10 +91,6 @@ GAttrib *g_attrib_new(GIOChannel *io, guint16 mtu, bool ext_signed)
 	if (!attr->callbacks)
 		goto fail;
 
-	attr->track_ids = queue_new();
-	if (!attr->track_ids)
-		goto fail;
-
 	return g_attrib_ref(attr);
 
 fail:
@@ -155,7 +150,6 @@ void g_attrib_unref(GAttrib *attrib)
 	bt_att_unref(attrib->att);
 
 	queue_destroy(attrib->callbacks, attrib_callbacks_destroy);
-	queue_destroy(attrib->track_ids, NULL);
 
 	free(attrib->buf);
 
@@ -180,6 +174,14 @@ struct bt_att *g_attrib_get_att(GAttrib *attrib)
 	return attrib->att;
 }
 
+struct bt_gatt_client *g_attrib_get_client(GAttrib *attrib)
+{
+	if (!attrib)
+		return NULL;
+
+	return attrib->client;
+}
+
 gboolean g_attrib_set_destroy_function(GAttrib *attrib, GDestroyNotify destroy,
 							gpointer user_data)
 {
@@ -193,35 +195,34 @@ gboolean g_attrib_set_destroy_function(GAttrib *attrib, GDestroyNotify destroy,
 }
 
 
-static uint8_t *construct_full_pdu(uint8_t opcode, const void *pdu,
-								uint16_t length)
+/*
+ * bt_att hands out received PDUs right after their opcode, so the full PDU
+ * the GAttrib callbacks expect can be passed through without copying. Only
+ * responses synthesized by bt_att itself (pdu is NULL) need the opcode.
+ */
+static const uint8_t *full_pdu(uint8_t opcode, const void *pdu,
+							uint8_t *opcode_buf)
 {
-	uint8_t *buf = malloc0(length + 1);
-
-	if (!buf)
-		return NULL;
+	if (pdu && ((const uint8_t *) pdu)[-1] == opcode)
+		return (const uint8_t *) pdu - 1;
 
-	buf[0] = opcode;
+	*opcode_buf = opcode;
 
-	if (pdu && length)
-		memcpy(buf + 1, pdu, length);
-
-	return buf;
+	return opcode_buf;
 }
 
 static void attrib_callback_result(uint8_t opcode, const void *pdu,
 					uint16_t length, void *user_data)
 {
-	uint8_t *buf;
 	struct attrib_callbacks *cb = user_data;
 	guint8 status = 0;
+	uint8_t opcode_buf;
+	const uint8_t *buf;
 
 	if (!cb)
 		return;
 
-	buf = construct_full_pdu(opcode, pdu, length);
-	if (!buf)
-		return;
+	buf = full_pdu(opcode, pdu, &opcode_buf);
 
 	if (opcode == BT_ATT_OP_ERROR_RSP) {
 		/* Error code is the third byte of the PDU data */
@@ -233,16 +234,14 @@ static void attrib_callback_result(uint8_t opcode, const void *pdu,
 
 	if (cb->result_func)
 		cb->result_func(status, buf, length + 1, cb->user_data);
-
-	free(buf);
 }
 
 static void attrib_callback_notify(struct bt_att_chan *chan, uint16_t mtu,
 					uint8_t opcode, const void *pdu,
 					uint16_t length, void *user_data)
 {
-	uint8_t *buf;
 	struct attrib_callbacks *cb = user_data;
+	uint8_t opcode_buf;
 
 	if (!cb || !cb->notify_func)
 		return;
@@ -254,13 +253,8 @@ static void attrib_callback_notify(struct bt_att_chan *chan, uint16_t mtu,
 					cb->notify_handle != get_le16(pdu))
 		return;
 
-	buf = construct_full_pdu(opcode, pdu, length);
-	if (!buf)
-		return;
-
-	cb->notify_func(buf, length + 1, cb->user_data);
-
-	free(buf);
+	cb->notify_func(full_pdu(opcode, pdu, &opcode_buf), length + 1,
+							cb->user_data);
 }
 
 guint g_attrib_send(GAttrib *attrib, guint id, const guint8 *pdu, guint16 len,
@@ -307,13 +301,11 @@ guint g_attrib_send(GAttrib *attrib, guint id, const guint8 *pdu, guint16 len,
 		return id;
 
 	/*
-	 * If user what us to use given id, lets keep track on that so we give
-	 * user a possibility to cancel ongoing request.
+	 * Pending requests are tracked by bt_att itself, remembering the id in
+	 * the callbacks is enough for g_attrib_cancel_all to find them again.
 	 */
-	if (cb) {
+	if (cb)
 		cb->id = id;
-		queue_push_tail(attrib->track_ids, UINT_TO_PTR(id));
-	}
 
 	return id;
 }
@@ -326,21 +318,28 @@ gboolean g_attrib_cancel(GAttrib *attrib, guint id)
 	return bt_att_cancel(attrib->att, id);
 }
 
-static void cancel_request(void *data, void *user_data)
+static bool match_request(const void *data, const void *user_data)
 {
-	unsigned int id = PTR_TO_UINT(data);
-	GAttrib *attrib = user_data;
+	const struct attrib_callbacks *cb = data;
 
-	bt_att_cancel(attrib->att, id);
+	return cb->id;
 }
 
 gboolean g_attrib_cancel_all(GAttrib *attrib)
 {
+	struct attrib_callbacks *cb;
+
 	if (!attrib)
 		return FALSE;
 
-	queue_foreach(attrib->track_ids, cancel_request, attrib);
-	queue_remove_all(attrib->track_ids, NULL, NULL, NULL);
+	/* Cancelling a request removes its callbacks through the destroy */
+	while ((cb = queue_find(attrib->callbacks, match_request, NULL))) {
+		if (bt_att_cancel(attrib->att, cb->id))
+			continue;
+
+		queue_remove(attrib->callbacks, cb);
+		attrib_callbacks_destroy(cb);
+	}
 
 	return TRUE;
 }
@@ -348,15 +347,17 @@ gboolean g_attrib_cancel_all(GAttrib *attrib)
 static void client_notify_cb(uint16_t value_handle, const uint8_t *value,
 				uint16_t length, void *user_data)
 {
-	uint8_t *buf = newa(uint8_t, length + 2);
+	uint8_t *buf = newa(uint8_t, length + 3);
 
-	put_le16(value_handle, buf);
+	/* Lead with the opcode so the notify callback needs no copy */
+	buf[0] = ATT_OP_HANDLE_NOTIFY;
+	put_le16(value_handle, buf + 1);
 
 	if (length)
-		memcpy(buf + 2, value, length);
+		memcpy(buf + 3, value, length);
 
-	attrib_callback_notify(NULL, 0, ATT_OP_HANDLE_NOTIFY, buf, length + 2,
-							user_data);
+	attrib_callback_notify(NULL, 0, ATT_OP_HANDLE_NOTIFY, buf + 1,
+						length + 2, user_data);
 }
 
 guint g_attrib_register(GAttrib *attrib, guint8 opcode, guint16 handle,
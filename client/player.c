@@ -27,6 +27,9 @@
 #include <wordexp.h>
 #include <sys/timerfd.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 
 #include <glib.h>
 
@@ -146,6 +149,8 @@ struct transport {
 	uint32_t seq;
 	struct io *timer_io;
 	int num;
+	uint8_t *buf;
+	bool tstamp;
 };
 
 struct transport_select_args {
@@ -4778,6 +4783,7 @@ static void transport_free(void *data)
 
 	io_destroy(transport->timer_io);
 	io_destroy(transport->io);
+	free(transport->buf);
 	free(transport);
 }
 
@@ -4797,6 +4803,11 @@ static bool transport_recv(struct io *io, void *user_data)
 {
 	struct transport *transport = user_data;
 	uint8_t buf[1024];
+	unsigned char control[128];
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	struct timespec *ts = NULL;
 	int ret, len;
 
 	ret = io_get_fd(io);
@@ -4805,14 +4816,37 @@ static bool transport_recv(struct io *io, void *user_data)
 		return true;
 	}
 
-	ret = read(ret, buf, sizeof(buf));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ret = recvmsg(ret, &msg, 0);
 	if (ret < 0) {
 		bt_shell_printf("Failed to read: %s (%d)\n", strerror(errno),
 								-errno);
 		return true;
 	}
 
-	bt_shell_echo("[seq %d] recv: %u bytes", transport->seq, ret);
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg && transport->tstamp;
+					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+					cmsg->cmsg_type == SCM_TIMESTAMPING) {
+			ts = ((struct scm_timestamping *) CMSG_DATA(cmsg))->ts;
+			break;
+		}
+	}
+
+	if (ts)
+		bt_shell_echo("[seq %d %ld.%06lds] recv: %u bytes",
+				transport->seq, (long) ts->tv_sec,
+				ts->tv_nsec / 1000, ret);
+	else
+		bt_shell_echo("[seq %d] recv: %u bytes", transport->seq, ret);
 
 	transport->seq++;
 
@@ -4829,6 +4863,8 @@ static bool transport_recv(struct io *io, void *user_data)
 static void transport_new(GDBusProxy *proxy, int sk, uint16_t mtu[2])
 {
 	struct transport *transport;
+	uint32_t flags = SOF_TIMESTAMPING_SOFTWARE |
+				SOF_TIMESTAMPING_RX_SOFTWARE;
 
 	transport = new0(struct transport, 1);
 	transport->proxy = proxy;
@@ -4838,6 +4874,13 @@ static void transport_new(GDBusProxy *proxy, int sk, uint16_t mtu[2])
 	transport->io = io_new(sk);
 	transport->fd = -1;
 
+	/* Kernel receive timestamps, so SDU arrival is not skewed by
+	 * the shell's scheduling.
+	 */
+	if (!setsockopt(sk, SOL_SOCKET, SO_TIMESTAMPING, &flags,
+							sizeof(flags)))
+		transport->tstamp = true;
+
 	io_set_disconnect_handler(transport->io, transport_disconnected,
 							transport, NULL);
 	io_set_read_handler(transport->io, transport_recv, transport, NULL);
@@ -5538,9 +5581,14 @@ static int transport_send_seq(struct transport *transport, int fd, uint32_t num)
 	if (!num)
 		return 0;
 
-	buf = malloc(transport->mtu[1]);
-	if (!buf)
-		return -ENOMEM;
+	/* Reused for every burst rather than allocated per timer tick */
+	if (!transport->buf) {
+		transport->buf = malloc(transport->mtu[1]);
+		if (!transport->buf)
+			return -ENOMEM;
+	}
+
+	buf = transport->buf;
 
 	for (i = 0; i < num; i++, transport->seq++) {
 		ssize_t ret;
@@ -5552,7 +5600,6 @@ static int transport_send_seq(struct transport *transport, int fd, uint32_t num)
 			if (ret < 0)
 				bt_shell_printf("read failed: %s (%d)",
 						strerror(errno), errno);
-			free(buf);
 			return ret;
 		}
 
@@ -5560,7 +5607,6 @@ static int transport_send_seq(struct transport *transport, int fd, uint32_t num)
 		if (ret <= 0) {
 			bt_shell_printf("send failed: %s (%d)",
 							strerror(errno), errno);
-			free(buf);
 			return -errno;
 		}
 
@@ -5569,7 +5615,6 @@ static int transport_send_seq(struct transport *transport, int fd, uint32_t num)
 		if (!transport->seq && fstat(fd, &transport->stat) < 0) {
 			bt_shell_printf("fstat failed: %s (%d)",
 							strerror(errno), errno);
-			free(buf);
 			return -errno;
 		}
 
@@ -5582,8 +5627,6 @@ static int transport_send_seq(struct transport *transport, int fd, uint32_t num)
 				(long long)transport->stat.st_size);
 	}
 
-	free(buf);
-
 	return i;
 }
 
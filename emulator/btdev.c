@@ -74,6 +74,12 @@ struct btdev_conn {
 	void *data;
 };
 
+struct link_pkt {
+	struct btdev_conn *conn;
+	uint16_t len;
+	uint8_t data[];
+};
+
 struct btdev_al {
 	uint8_t type;
 	bdaddr_t addr;
@@ -129,6 +135,7 @@ struct le_cig {
 struct btdev {
 	enum btdev_type type;
 	uint16_t id;
+	struct btdev *hash_next;
 
 	struct queue *conns;
 
@@ -232,6 +239,13 @@ struct btdev {
 	struct le_cig le_cig[CIG_SIZE];
 	uint8_t  le_iso_path[2];
 
+	struct btdev_link_model link_model;
+	struct queue *link_tx;
+	unsigned int link_id;
+	uint64_t link_credit;
+	uint16_t link_acl_pending;
+	uint16_t link_iso_pending;
+
 	/* Real time length of AL array */
 	uint8_t le_al_len;
 	/* Real time length of RL array */
@@ -270,13 +284,19 @@ struct inquiry_data {
 
 #define DEFAULT_INQUIRY_INTERVAL 100 /* 100 miliseconds */
 
-#define MAX_BTDEV_ENTRIES 16
+#define BTDEV_LIST_MIN 16
+#define BTDEV_HASH_SIZE 256
 
 static const uint8_t LINK_KEY_NONE[16] = { 0 };
 static const uint8_t LINK_KEY_DUMMY[16] = {	0, 1, 2, 3, 4, 5, 6, 7,
 						8, 9, 0, 1, 2, 3, 4, 5 };
 
-static struct btdev *btdev_list[MAX_BTDEV_ENTRIES] = { };
+static struct btdev **btdev_list;
+static int btdev_list_size;
+static int btdev_count;
+
+/* Public address lookups, chained through btdev->hash_next */
+static struct btdev *btdev_hash[BTDEV_HASH_SIZE];
 
 static int get_hook_index(struct btdev *btdev, enum btdev_hook_type type,
 								uint16_t opcode)
@@ -306,26 +326,74 @@ static bool run_hooks(struct btdev *btdev, enum btdev_hook_type type,
 					btdev->hook_list[index]->user_data);
 }
 
+static unsigned int bdaddr_hash(const uint8_t *bdaddr)
+{
+	unsigned int i, hash = 0;
+
+	for (i = 0; i < 6; i++)
+		hash = hash * 31 + bdaddr[i];
+
+	return hash % BTDEV_HASH_SIZE;
+}
+
+static void hash_add_btdev(struct btdev *btdev)
+{
+	struct btdev **head = &btdev_hash[bdaddr_hash(btdev->bdaddr)];
+
+	btdev->hash_next = *head;
+	*head = btdev;
+}
+
+static void hash_del_btdev(struct btdev *btdev)
+{
+	struct btdev **entry = &btdev_hash[bdaddr_hash(btdev->bdaddr)];
+
+	for (; *entry; entry = &(*entry)->hash_next) {
+		if (*entry == btdev) {
+			*entry = btdev->hash_next;
+			btdev->hash_next = NULL;
+			return;
+		}
+	}
+}
+
 static inline int add_btdev(struct btdev *btdev)
 {
-	int i, index = -1;
+	struct btdev **list;
+	int i, size;
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		if (btdev_list[i] == NULL) {
-			index = i;
-			btdev_list[index] = btdev;
-			break;
+			btdev_list[i] = btdev;
+			btdev_count++;
+			return i;
 		}
 	}
 
-	return index;
+	size = btdev_list_size ? btdev_list_size * 2 : BTDEV_LIST_MIN;
+
+	list = realloc(btdev_list, size * sizeof(*list));
+	if (!list)
+		return -1;
+
+	memset(list + btdev_list_size, 0,
+				(size - btdev_list_size) * sizeof(*list));
+
+	i = btdev_list_size;
+	list[i] = btdev;
+
+	btdev_list = list;
+	btdev_list_size = size;
+	btdev_count++;
+
+	return i;
 }
 
 static inline int del_btdev(struct btdev *btdev)
 {
 	int i, index = -1;
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		if (btdev_list[i] == btdev) {
 			index = i;
 			btdev_list[index] = NULL;
@@ -333,6 +401,15 @@ static inline int del_btdev(struct btdev *btdev)
 		}
 	}
 
+	if (index < 0)
+		return index;
+
+	if (!--btdev_count) {
+		free(btdev_list);
+		btdev_list = NULL;
+		btdev_list_size = 0;
+	}
+
 	return index;
 }
 
@@ -340,7 +417,7 @@ static inline bool valid_btdev(struct btdev *btdev)
 {
 	int i;
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		if (btdev_list[i] == btdev)
 			return true;
 	}
@@ -350,11 +427,11 @@ static inline bool valid_btdev(struct btdev *btdev)
 
 static inline struct btdev *find_btdev_by_bdaddr(const uint8_t *bdaddr)
 {
-	int i;
+	struct btdev *dev;
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
-		if (btdev_list[i] && !memcmp(btdev_list[i]->bdaddr, bdaddr, 6))
-			return btdev_list[i];
+	for (dev = btdev_hash[bdaddr_hash(bdaddr)]; dev; dev = dev->hash_next) {
+		if (!memcmp(dev->bdaddr, bdaddr, 6))
+			return dev;
 	}
 
 	return NULL;
@@ -373,7 +450,10 @@ static inline struct btdev *find_btdev_by_bdaddr_type(const uint8_t *bdaddr,
 {
 	int i;
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	if (bdaddr_type != 0x01)
+		return find_btdev_by_bdaddr(bdaddr);
+
+	for (i = 0; i < btdev_list_size; i++) {
 		struct btdev *dev = btdev_list[i];
 		int cmp;
 		struct le_ext_adv *adv;
@@ -401,12 +481,12 @@ static inline struct btdev *find_btdev_by_bdaddr_type(const uint8_t *bdaddr,
 	return NULL;
 }
 
-static void get_bdaddr(uint16_t id, uint8_t index, uint8_t *bdaddr)
+static void get_bdaddr(uint16_t id, int index, uint8_t *bdaddr)
 {
 	bdaddr[0] = id & 0xff;
 	bdaddr[1] = id >> 8;
-	bdaddr[2] = index;
-	bdaddr[3] = 0x01;
+	bdaddr[2] = index & 0xff;
+	bdaddr[3] = 0x01 + (index >> 8);
 	bdaddr[4] = 0xaa;
 	bdaddr[5] = 0x00;
 }
@@ -554,10 +634,33 @@ static void conn_unlink(struct btdev_conn *conn1, struct btdev_conn *conn2)
 	conn2->link = NULL;
 }
 
+static void link_pkt_free(void *data)
+{
+	struct link_pkt *pkt = data;
+	struct btdev *dev = pkt->conn->dev;
+
+	if (pkt->data[0] == BT_H4_ISO_PKT)
+		dev->link_iso_pending--;
+	else
+		dev->link_acl_pending--;
+
+	free(pkt);
+}
+
+static bool match_pkt_conn(const void *data, const void *match_data)
+{
+	const struct link_pkt *pkt = data;
+
+	return pkt->conn == match_data;
+}
+
 static void conn_remove(void *data)
 {
 	struct btdev_conn *conn = data;
 
+	queue_remove_all(conn->dev->link_tx, match_pkt_conn, conn,
+							link_pkt_free);
+
 	if (conn->link) {
 		struct btdev_conn *link = conn->link;
 
@@ -934,10 +1037,10 @@ static bool inquiry_callback(void *user_data)
 	int i;
 
 	/*Report devices only once and wait for inquiry timeout*/
-	if (data->iter == MAX_BTDEV_ENTRIES)
+	if (data->iter >= btdev_list_size)
 		return true;
 
-	for (i = data->iter; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = data->iter; i < btdev_list_size; i++) {
 		/*Lets sent 10 inquiry results at once */
 		if (sent + 10 == data->sent_count)
 			break;
@@ -3584,7 +3687,7 @@ static void le_set_adv_enable_complete(struct btdev *btdev)
 
 	report_type = get_adv_report_type(btdev->le_adv_type);
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		if (!btdev_list[i] || btdev_list[i] == btdev)
 			continue;
 
@@ -3741,7 +3844,7 @@ static int cmd_set_scan_enable_complete(struct btdev *dev, const void *data,
 	if (!dev->le_scan_enable || !cmd->enable)
 		return 0;
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		uint8_t report_type;
 
 		if (!btdev_list[i] || btdev_list[i] == dev)
@@ -5044,7 +5147,7 @@ static bool ext_adv_broadcast(void *user_data)
 
 	report_type = get_ext_adv_type(ext_adv->type);
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		if (!btdev_list[i] || btdev_list[i] == btdev)
 			continue;
 
@@ -5475,7 +5578,7 @@ static int cmd_set_pa_enable(struct btdev *dev, const void *data, uint8_t len)
 	cmd_complete(dev, BT_HCI_CMD_LE_SET_PA_ENABLE, &status,
 							sizeof(status));
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		struct btdev *remote = btdev_list[i];
 
 		if (!remote || remote == dev)
@@ -5576,7 +5679,7 @@ static int cmd_set_ext_scan_enable_complete(struct btdev *dev, const void *data,
 	if (!dev->le_scan_enable || !cmd->enable)
 		return 0;
 
-	for (i = 0; i < MAX_BTDEV_ENTRIES; i++) {
+	for (i = 0; i < btdev_list_size; i++) {
 		if (!btdev_list[i] || btdev_list[i] == dev)
 			continue;
 
@@ -7340,6 +7443,7 @@ struct btdev *btdev_create(enum btdev_type type, uint16_t id)
 	}
 
 	get_bdaddr(id, index, btdev->bdaddr);
+	hash_add_btdev(btdev);
 
 	btdev->conns = queue_new();
 	btdev->le_ext_adv = queue_new();
@@ -7359,9 +7463,16 @@ void btdev_destroy(struct btdev *btdev)
 	if (btdev->inquiry_id > 0)
 		timeout_remove(btdev->inquiry_id);
 
+	if (btdev->link_id)
+		timeout_remove(btdev->link_id);
+
 	bt_crypto_unref(btdev->crypto);
+	hash_del_btdev(btdev);
 	del_btdev(btdev);
 
+	queue_destroy(btdev->link_tx, link_pkt_free);
+	btdev->link_tx = NULL;
+
 	queue_destroy(btdev->conns, conn_remove);
 	queue_destroy(btdev->le_ext_adv, le_ext_adv_free);
 	queue_destroy(btdev->le_per_adv, free);
@@ -7396,7 +7507,9 @@ bool btdev_set_bdaddr(struct btdev *btdev, const uint8_t *bdaddr)
 	if (!btdev || !bdaddr)
 		return false;
 
+	hash_del_btdev(btdev);
 	memcpy(btdev->bdaddr, bdaddr, sizeof(btdev->bdaddr));
+	hash_add_btdev(btdev);
 
 	return true;
 }
@@ -7648,6 +7761,117 @@ static void process_cmd(struct btdev *btdev, const void *data, uint16_t len)
 	}
 }
 
+/* Per packet air overhead: preamble, access address, header, MIC and CRC */
+#define LINK_PKT_OVERHEAD	14
+
+static unsigned int link_period(struct btdev *dev)
+{
+	/* Connection interval is in 1.25 ms units */
+	unsigned int ms = dev->link_model.conn_interval * 5 / 4;
+
+	return ms ? ms : 1;
+}
+
+static void link_deliver(struct btdev *dev, struct link_pkt *pkt)
+{
+	struct btdev_conn *conn = pkt->conn;
+	struct iovec iov;
+
+	num_completed_packets(dev, conn);
+
+	iov.iov_base = pkt->data;
+	iov.iov_len = pkt->len;
+
+	if (conn->link)
+		send_packet(conn->link->dev, &iov, 1);
+
+	link_pkt_free(pkt);
+}
+
+static bool link_event(void *user_data)
+{
+	struct btdev *dev = user_data;
+	struct link_pkt *pkt;
+
+	/* kbit/s multiplied by ms gives the bits available in this event */
+	dev->link_credit += (uint64_t) dev->link_model.phy_rate *
+							link_period(dev);
+
+	while ((pkt = queue_peek_head(dev->link_tx))) {
+		uint64_t bits = (pkt->len + LINK_PKT_OVERHEAD) * 8;
+
+		if (dev->link_model.phy_rate) {
+			if (dev->link_credit < bits)
+				break;
+
+			dev->link_credit -= bits;
+		}
+
+		queue_pop_head(dev->link_tx);
+		link_deliver(dev, pkt);
+	}
+
+	if (!queue_isempty(dev->link_tx))
+		return true;
+
+	dev->link_id = 0;
+	dev->link_credit = 0;
+
+	return false;
+}
+
+static bool link_enqueue(struct btdev *dev, struct btdev_conn *conn,
+				const struct iovec *iov, int iovlen)
+{
+	struct link_pkt *pkt;
+	uint16_t *pending, max_pkt;
+	size_t len = 0;
+	int i;
+
+	if (!dev->link_tx)
+		return false;
+
+	if (*((uint8_t *) iov[0].iov_base) == BT_H4_ISO_PKT) {
+		pending = &dev->link_iso_pending;
+		max_pkt = dev->iso_max_pkt;
+	} else {
+		pending = &dev->link_acl_pending;
+		max_pkt = dev->acl_max_pkt;
+	}
+
+	/* The host must not send more packets than there are buffers */
+	if (*pending >= max_pkt) {
+		util_debug(dev->debug_callback, dev->debug_data,
+				"Controller buffer overflow on handle 0x%4.4x",
+				conn->handle);
+		return true;
+	}
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+
+	pkt = malloc(sizeof(*pkt) + len);
+	if (!pkt)
+		return true;
+
+	pkt->conn = conn;
+	pkt->len = len;
+
+	for (i = 0, len = 0; i < iovlen; i++) {
+		memcpy(pkt->data + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+
+	queue_push_tail(dev->link_tx, pkt);
+	(*pending)++;
+
+	if (!dev->link_id)
+		dev->link_id = timeout_add(link_period(dev), link_event, dev,
+									NULL);
+
+	return true;
+}
+
 static void send_acl(struct btdev *dev, const void *data, uint16_t len)
 {
 	struct bt_hci_acl_hdr hdr;
@@ -7666,8 +7890,6 @@ static void send_acl(struct btdev *dev, const void *data, uint16_t len)
 	if (!conn)
 		return;
 
-	num_completed_packets(dev, conn);
-
 	/* ACL_START_NO_FLUSH is only allowed from host to controller.
 	 * From controller to host this should be converted to ACL_START.
 	 */
@@ -7680,6 +7902,11 @@ static void send_acl(struct btdev *dev, const void *data, uint16_t len)
 	iov[2].iov_base = (void *) (data + sizeof(hdr));
 	iov[2].iov_len = len - sizeof(hdr);
 
+	if (link_enqueue(dev, conn, iov, 3))
+		return;
+
+	num_completed_packets(dev, conn);
+
 	send_packet(conn->link->dev, iov, 3);
 }
 
@@ -7728,12 +7955,57 @@ static void send_iso(struct btdev *dev, const void *data, uint16_t len)
 	if (!conn)
 		return;
 
+	if (link_enqueue(dev, conn, iov, 2))
+		return;
+
 	num_completed_packets(dev, conn);
 
 	if (conn->link)
 		send_packet(conn->link->dev, iov, 2);
 }
 
+bool btdev_set_link_model(struct btdev *btdev,
+				const struct btdev_link_model *model)
+{
+	struct link_pkt *pkt;
+
+	if (!btdev)
+		return false;
+
+	if (!model) {
+		if (btdev->link_id) {
+			timeout_remove(btdev->link_id);
+			btdev->link_id = 0;
+		}
+
+		while ((pkt = queue_pop_head(btdev->link_tx)))
+			link_deliver(btdev, pkt);
+
+		queue_destroy(btdev->link_tx, NULL);
+		btdev->link_tx = NULL;
+		btdev->link_credit = 0;
+		memset(&btdev->link_model, 0, sizeof(btdev->link_model));
+
+		return true;
+	}
+
+	btdev->link_model = *model;
+
+	if (model->acl_mtu)
+		btdev->acl_mtu = model->acl_mtu;
+	if (model->acl_max_pkt)
+		btdev->acl_max_pkt = model->acl_max_pkt;
+	if (model->iso_mtu)
+		btdev->iso_mtu = model->iso_mtu;
+	if (model->iso_max_pkt)
+		btdev->iso_max_pkt = model->iso_max_pkt;
+
+	if (!btdev->link_tx)
+		btdev->link_tx = queue_new();
+
+	return true;
+}
+
 void btdev_receive_h4(struct btdev *btdev, const void *data, uint16_t len)
 {
 	uint8_t pkt_type;
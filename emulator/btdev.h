@@ -90,6 +90,18 @@ void btdev_set_al_len(struct btdev *btdev, uint8_t len);
 
 void btdev_set_rl_len(struct btdev *btdev, uint8_t len);
 
+struct btdev_link_model {
+	uint16_t acl_mtu;
+	uint16_t acl_max_pkt;
+	uint16_t iso_mtu;
+	uint16_t iso_max_pkt;
+	uint32_t phy_rate;		/* kbit/s, 0 for unlimited */
+	uint16_t conn_interval;		/* 1.25 ms units */
+};
+
+bool btdev_set_link_model(struct btdev *btdev,
+				const struct btdev_link_model *model);
+
 void btdev_set_command_handler(struct btdev *btdev, btdev_command_func handler,
 							void *user_data);
 
@@ -50,6 +50,8 @@ struct hciemu {
 	enum btdev_type btdev_type;
 	struct vhci *vhci;
 	struct queue *clients;
+	struct queue *crowd;
+	uint16_t crowd_id;
 	struct queue *post_command_hooks;
 	char bdaddr_str[18];
 
@@ -240,6 +242,14 @@ struct vhci *hciemu_get_vhci(struct hciemu *hciemu)
 	return hciemu->vhci;
 }
 
+uint16_t hciemu_get_index(struct hciemu *hciemu)
+{
+	if (!hciemu)
+		return 0xffff;
+
+	return vhci_get_index(hciemu->vhci);
+}
+
 struct hciemu_client *hciemu_get_client(struct hciemu *hciemu, int num)
 {
 	const struct queue_entry *entry;
@@ -424,6 +434,11 @@ struct hciemu *hciemu_ref(struct hciemu *hciemu)
 	return hciemu;
 }
 
+static void crowd_destroy(void *data)
+{
+	btdev_destroy(data);
+}
+
 void hciemu_unref(struct hciemu *hciemu)
 {
 	if (!hciemu)
@@ -434,6 +449,7 @@ void hciemu_unref(struct hciemu *hciemu)
 
 	queue_destroy(hciemu->post_command_hooks, destroy_command_hook);
 	queue_destroy(hciemu->clients, hciemu_client_destroy);
+	queue_destroy(hciemu->crowd, crowd_destroy);
 
 	if (hciemu->flush_id)
 		g_source_remove(hciemu->flush_id);
@@ -628,6 +644,28 @@ void hciemu_set_central_le_states(struct hciemu *hciemu,
 	btdev_set_le_states(dev, le_states);
 }
 
+static void client_set_link_model(void *data, void *user_data)
+{
+	struct hciemu_client *client = data;
+
+	btdev_set_link_model(client->dev, user_data);
+}
+
+void hciemu_set_link_model(struct hciemu *hciemu,
+				const struct btdev_link_model *model)
+{
+	struct btdev *dev;
+
+	if (!hciemu || !hciemu->vhci)
+		return;
+
+	dev = vhci_get_btdev(hciemu->vhci);
+	if (dev)
+		btdev_set_link_model(dev, model);
+
+	queue_foreach(hciemu->clients, client_set_link_model, (void *) model);
+}
+
 void hciemu_set_central_le_al_len(struct hciemu *hciemu, uint8_t len)
 {
 	struct btdev *dev;
@@ -814,3 +852,93 @@ void hciemu_flush_client_events(struct hciemu *hciemu)
 	vhci_pause_input(hciemu->vhci, true);
 	hciemu->flush_id = g_idle_add(flush_client_events, hciemu);
 }
+
+/* Crowd members are bare controllers without a bthost or socket, driven
+ * with a handful of HCI commands so that they advertise. Their events are
+ * dropped since nothing reads them.
+ */
+#define CROWD_ID_BASE 0x1000
+
+static void crowd_send_cmd(struct btdev *dev, uint16_t opcode,
+					const void *data, uint8_t len)
+{
+	uint8_t buf[4 + 255];
+
+	buf[0] = BT_H4_CMD_PKT;
+	put_le16(opcode, buf + 1);
+	buf[3] = len;
+	memcpy(buf + 4, data, len);
+
+	btdev_receive_h4(dev, buf, 4 + len);
+}
+
+bool hciemu_add_crowd(struct hciemu *hciemu, unsigned int num,
+				const uint8_t *adv_data, uint8_t adv_len)
+{
+	struct bt_hci_cmd_le_set_adv_data ad;
+	struct bt_hci_cmd_le_set_adv_enable enable;
+	unsigned int i;
+
+	if (!hciemu || !num || adv_len > sizeof(ad.data))
+		return false;
+
+	switch (hciemu->btdev_type) {
+	case BTDEV_TYPE_BREDR:
+	case BTDEV_TYPE_BREDR20:
+	case BTDEV_TYPE_AMP:
+		return false;
+	default:
+		break;
+	}
+
+	if (!hciemu->crowd)
+		hciemu->crowd = queue_new();
+
+	for (i = 0; i < num; i++) {
+		uint16_t id = CROWD_ID_BASE + hciemu->crowd_id++;
+		struct btdev *dev;
+
+		dev = btdev_create(hciemu->btdev_type, id);
+		if (!dev)
+			return false;
+
+		memset(&ad, 0, sizeof(ad));
+
+		if (adv_data) {
+			ad.len = adv_len;
+			memcpy(ad.data, adv_data, adv_len);
+		} else {
+			/* Flags followed by a unique Complete Local Name */
+			ad.data[0] = 0x02;
+			ad.data[1] = 0x01;
+			ad.data[2] = 0x06;
+			ad.data[4] = 0x09;
+			ad.data[3] = 1 + snprintf((char *) ad.data + 5,
+					sizeof(ad.data) - 5, "crowd-%u", id);
+			ad.len = 4 + ad.data[3];
+		}
+
+		crowd_send_cmd(dev, BT_HCI_CMD_LE_SET_ADV_DATA, &ad,
+								sizeof(ad));
+
+		enable.enable = 0x01;
+		crowd_send_cmd(dev, BT_HCI_CMD_LE_SET_ADV_ENABLE, &enable,
+							sizeof(enable));
+
+		queue_push_tail(hciemu->crowd, dev);
+	}
+
+	util_debug(hciemu->debug_callback, hciemu->debug_data,
+			"crowd: %u advertisers", queue_length(hciemu->crowd));
+
+	return true;
+}
+
+void hciemu_clear_crowd(struct hciemu *hciemu)
+{
+	if (!hciemu)
+		return;
+
+	queue_destroy(hciemu->crowd, crowd_destroy);
+	hciemu->crowd = NULL;
+}
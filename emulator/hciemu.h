@@ -48,6 +48,7 @@ bool hciemu_set_debug(struct hciemu *hciemu, hciemu_debug_func_t callback,
 			void *user_data, hciemu_destroy_func_t destroy);
 
 struct vhci *hciemu_get_vhci(struct hciemu *hciemu);
+uint16_t hciemu_get_index(struct hciemu *hciemu);
 struct bthost *hciemu_client_get_host(struct hciemu *hciemu);
 
 /* Process pending client events before new VHCI events */
@@ -69,6 +70,11 @@ void hciemu_set_central_le_states(struct hciemu *hciemu,
 
 void hciemu_set_central_le_al_len(struct hciemu *hciemu, uint8_t len);
 
+struct btdev_link_model;
+
+void hciemu_set_link_model(struct hciemu *hciemu,
+				const struct btdev_link_model *model);
+
 void hciemu_set_central_le_rl_len(struct hciemu *hciemu, uint8_t len);
 
 const uint8_t *hciemu_get_central_adv_addr(struct hciemu *hciemu,
@@ -91,3 +97,7 @@ int hciemu_add_hook(struct hciemu *hciemu, enum hciemu_hook_type type,
 
 bool hciemu_del_hook(struct hciemu *hciemu, enum hciemu_hook_type type,
 							uint16_t opcode);
+
+bool hciemu_add_crowd(struct hciemu *hciemu, unsigned int num,
+				const uint8_t *adv_data, uint8_t adv_len);
+void hciemu_clear_crowd(struct hciemu *hciemu);
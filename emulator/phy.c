@@ -29,11 +29,13 @@
 #include "phy.h"
 
 #define BT_PHY_PORT 45023
+#define BT_PHY_RX_BATCH 16
 
 struct bt_phy {
 	volatile int ref_count;
 	int rx_fd;
 	int tx_fd;
+	struct sockaddr_in tx_addr;
 	uint64_t id;
 	bt_phy_callback_func_t callback;
 	void *user_data;
@@ -68,42 +70,54 @@ static bool get_random_bytes(void *buf, size_t num_bytes)
 static void phy_rx_callback(int fd, uint32_t events, void *user_data)
 {
 	struct bt_phy *phy = user_data;
-	struct msghdr msg;
-	struct iovec iov[2];
-	struct bt_phy_hdr hdr;
-	unsigned char buf[4096];
-	ssize_t len;
+	static struct bt_phy_hdr hdr[BT_PHY_RX_BATCH];
+	static unsigned char buf[BT_PHY_RX_BATCH][4096];
+	struct mmsghdr msg[BT_PHY_RX_BATCH];
+	struct iovec iov[BT_PHY_RX_BATCH][2];
+	int i, count;
 
 	if (events & (EPOLLERR | EPOLLHUP)) {
 		mainloop_remove_fd(fd);
 		return;
 	}
 
-	iov[0].iov_base = &hdr;
-	iov[0].iov_len = sizeof(hdr);
-	iov[1].iov_base = buf;
-	iov[1].iov_len = sizeof(buf);
+	memset(msg, 0, sizeof(msg));
 
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 2;
+	for (i = 0; i < BT_PHY_RX_BATCH; i++) {
+		iov[i][0].iov_base = &hdr[i];
+		iov[i][0].iov_len = sizeof(hdr[i]);
+		iov[i][1].iov_base = buf[i];
+		iov[i][1].iov_len = sizeof(buf[i]);
 
-	len = recvmsg(phy->rx_fd, &msg, MSG_DONTWAIT);
-	if (len < 0)
-		return;
+		msg[i].msg_hdr.msg_iov = iov[i];
+		msg[i].msg_hdr.msg_iovlen = 2;
+	}
 
-	if ((size_t) len < sizeof(hdr))
+	/* Drain all datagrams queued since the last wakeup at once */
+	count = recvmmsg(phy->rx_fd, msg, BT_PHY_RX_BATCH, MSG_DONTWAIT, NULL);
+	if (count < 0)
 		return;
 
-	if (le64_to_cpu(hdr.id) == phy->id)
-		return;
+	bt_phy_ref(phy);
 
-	if (len - sizeof(hdr) != le16_to_cpu(hdr.len))
-		return;
+	for (i = 0; i < count; i++) {
+		size_t len = msg[i].msg_len;
+
+		if (len < sizeof(hdr[i]))
+			continue;
 
-	if (phy->callback)
-		phy->callback(le16_to_cpu(hdr.type),
-				buf, len - sizeof(hdr), phy->user_data);
+		if (le64_to_cpu(hdr[i].id) == phy->id)
+			continue;
+
+		if (len - sizeof(hdr[i]) != le16_to_cpu(hdr[i].len))
+			continue;
+
+		if (phy->callback)
+			phy->callback(le16_to_cpu(hdr[i].type), buf[i],
+					len - sizeof(hdr[i]), phy->user_data);
+	}
+
+	bt_phy_unref(phy);
 }
 
 static int create_rx_socket(void)
@@ -170,6 +184,10 @@ struct bt_phy *bt_phy_new(void)
 		return NULL;
 	}
 
+	phy->tx_addr.sin_family = AF_INET;
+	phy->tx_addr.sin_port = htons(BT_PHY_PORT);
+	phy->tx_addr.sin_addr.s_addr = INADDR_BROADCAST;
+
 	mainloop_add_fd(phy->rx_fd, EPOLLIN, phy_rx_callback, phy, NULL);
 
 	if (!get_random_bytes(&phy->id, sizeof(phy->id))) {
@@ -225,7 +243,6 @@ bool bt_phy_send_vector(struct bt_phy *phy, uint16_t type,
 					const void *data3, size_t size3)
 {
 	struct bt_phy_hdr hdr;
-	struct sockaddr_in addr;
 	struct msghdr msg;
 	struct iovec iov[4];
 	ssize_t len;
@@ -233,14 +250,9 @@ bool bt_phy_send_vector(struct bt_phy *phy, uint16_t type,
 	if (!phy)
 		return false;
 
-	memset(&addr, 0, sizeof(addr));
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(BT_PHY_PORT);
-	addr.sin_addr.s_addr = INADDR_BROADCAST;
-
 	memset(&msg, 0, sizeof(msg));
-	msg.msg_name = &addr;
-	msg.msg_namelen = sizeof(addr);
+	msg.msg_name = &phy->tx_addr;
+	msg.msg_namelen = sizeof(phy->tx_addr);
 	msg.msg_iov = iov;
 	msg.msg_iovlen = 0;
 
@@ -272,11 +284,6 @@ bool bt_phy_send_vector(struct bt_phy *phy, uint16_t type,
 		msg.msg_iovlen++;
 	}
 
-	memset(&addr, 0, sizeof(addr));
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(BT_PHY_PORT);
-	addr.sin_addr.s_addr = INADDR_BROADCAST;
-
 	len = sendmsg(phy->tx_fd, &msg, MSG_DONTWAIT);
 	if (len < 0)
 		return false;
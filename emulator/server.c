@@ -35,6 +35,8 @@
 
 #define uninitialized_var(x) x = x
 
+#define CLIENT_OUT_MAX	(1024 * 1024)
+
 struct server {
 	enum server_type type;
 	uint16_t id;
@@ -49,6 +51,10 @@ struct client {
 	uint16_t pkt_expect;
 	uint16_t pkt_len;
 	uint16_t pkt_offset;
+	uint8_t *out_buf;
+	size_t out_len;
+	size_t out_size;
+	bool out_pending;
 };
 
 static void server_destroy(void *user_data)
@@ -68,24 +74,78 @@ static void client_destroy(void *user_data)
 
 	close(client->fd);
 
+	free(client->out_buf);
 	free(client);
 }
 
+static void client_flush(struct client *client)
+{
+	ssize_t written;
+
+	if (!client->out_len)
+		return;
+
+	written = send(client->fd, client->out_buf, client->out_len,
+							MSG_DONTWAIT);
+	if (written > 0) {
+		client->out_len -= written;
+		memmove(client->out_buf, client->out_buf + written,
+							client->out_len);
+	}
+
+	if (client->out_len && !client->out_pending) {
+		mainloop_modify_fd(client->fd, EPOLLIN | EPOLLOUT);
+		client->out_pending = true;
+	} else if (!client->out_len && client->out_pending) {
+		mainloop_modify_fd(client->fd, EPOLLIN);
+		client->out_pending = false;
+	}
+}
+
+/*
+ * Frames are collected per client and written out in one go once the
+ * socket is reported as writable, so a burst of events and data only
+ * costs one system call per client and main loop iteration.
+ */
 static void client_write_callback(const struct iovec *iov, int iovlen,
 							void *user_data)
 {
 	struct client *client = user_data;
-	struct msghdr msg;
-	ssize_t written;
+	size_t len = 0;
+	int i;
 
-	memset(&msg, 0, sizeof(msg));
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
 
-	msg.msg_iov = (struct iovec *) iov;
-	msg.msg_iovlen = iovlen;
+	if (client->out_len + len > client->out_size) {
+		size_t size = client->out_size ? client->out_size : 4096;
+		uint8_t *buf;
 
-	written = sendmsg(client->fd, &msg, MSG_DONTWAIT);
-	if (written < 0)
-		return;
+		while (size < client->out_len + len)
+			size *= 2;
+
+		/* Drop whole frames rather than corrupting the stream */
+		if (size > CLIENT_OUT_MAX)
+			return;
+
+		buf = realloc(client->out_buf, size);
+		if (!buf)
+			return;
+
+		client->out_buf = buf;
+		client->out_size = size;
+	}
+
+	for (i = 0; i < iovlen; i++) {
+		memcpy(client->out_buf + client->out_len, iov[i].iov_base,
+							iov[i].iov_len);
+		client->out_len += iov[i].iov_len;
+	}
+
+	if (!client->out_pending) {
+		mainloop_modify_fd(client->fd, EPOLLIN | EPOLLOUT);
+		client->out_pending = true;
+	}
 }
 
 static void client_read_callback(int fd, uint32_t events, void *user_data)
@@ -101,6 +161,12 @@ static void client_read_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
+	if (events & EPOLLOUT)
+		client_flush(client);
+
+	if (!(events & EPOLLIN))
+		return;
+
 again:
 	len = recv(fd, buf + client->pkt_offset,
 			sizeof(buf) - client->pkt_offset, MSG_DONTWAIT);
@@ -131,14 +197,10 @@ again:
 				cmd_hdr = (hci_command_hdr *) (ptr + 1);
 				client->pkt_expect = HCI_COMMAND_HDR_SIZE +
 							cmd_hdr->plen + 1;
-				client->pkt_data = malloc(client->pkt_expect);
-				client->pkt_len = 0;
 				break;
 			case HCI_ACLDATA_PKT:
 				acl_hdr = (hci_acl_hdr*)(ptr + 1);
 				client->pkt_expect = HCI_ACL_HDR_SIZE + acl_hdr->dlen + 1;
-				client->pkt_data = malloc(client->pkt_expect);
-				client->pkt_len = 0;
 				break;
 			default:
 				printf("packet error\n");
@@ -146,6 +208,18 @@ again:
 			}
 
 			client->pkt_offset = 0;
+
+			/* Complete packets are handled in place */
+			if (count >= client->pkt_expect) {
+				btdev_receive_h4(client->btdev, ptr,
+							client->pkt_expect);
+				ptr += client->pkt_expect;
+				count -= client->pkt_expect;
+				continue;
+			}
+
+			client->pkt_data = malloc(client->pkt_expect);
+			client->pkt_len = 0;
 		}
 
 		if (count >= client->pkt_expect) {
@@ -54,6 +54,9 @@ struct GDBusClient {
 	GDBusPropertyFunction property_changed;
 	void *user_data;
 	GList *proxy_list;
+	GSList *filter_interfaces;
+	char *filter_path;
+	gboolean lazy_properties;
 };
 
 struct GDBusProxy {
@@ -69,6 +72,7 @@ struct GDBusProxy {
 	void *removed_data;
 	DBusPendingCall *get_all_call;
 	gboolean pending;
+	DBusMessage *lazy_props;
 };
 
 struct prop_entry {
@@ -248,48 +252,6 @@ static void append_dict_variant(DBusMessageIter *iter, char *entry, int type,
 	dbus_message_iter_close_container(iter, &variant);
 }
 
-static void iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter)
-{
-	int type;
-
-	type = dbus_message_iter_get_arg_type(iter);
-
-	if (dbus_type_is_basic(type)) {
-		const void *value;
-
-		dbus_message_iter_get_basic(iter, &value);
-		dbus_message_iter_append_basic(base, type, &value);
-	} else if (dbus_type_is_container(type)) {
-		DBusMessageIter iter_sub, base_sub;
-		char *sig;
-
-		dbus_message_iter_recurse(iter, &iter_sub);
-
-		switch (type) {
-		case DBUS_TYPE_ARRAY:
-		case DBUS_TYPE_VARIANT:
-			sig = dbus_message_iter_get_signature(&iter_sub);
-			break;
-		default:
-			sig = NULL;
-			break;
-		}
-
-		dbus_message_iter_open_container(base, type, sig, &base_sub);
-
-		if (sig != NULL)
-			dbus_free(sig);
-
-		while (dbus_message_iter_get_arg_type(&iter_sub) !=
-							DBUS_TYPE_INVALID) {
-			iter_append_iter(&base_sub, &iter_sub);
-			dbus_message_iter_next(&iter_sub);
-		}
-
-		dbus_message_iter_close_container(base, &base_sub);
-	}
-}
-
 static void prop_entry_update(struct prop_entry *prop, DBusMessageIter *iter)
 {
 	DBusMessage *msg;
@@ -300,7 +262,7 @@ static void prop_entry_update(struct prop_entry *prop, DBusMessageIter *iter)
 		return;
 
 	dbus_message_iter_init_append(msg, &base);
-	iter_append_iter(&base, iter);
+	g_dbus_iter_append_iter(&base, iter);
 
 	if (prop->msg != NULL)
 		dbus_message_unref(prop->msg);
@@ -402,6 +364,48 @@ static void update_properties(GDBusProxy *proxy, DBusMessageIter *iter,
 	}
 }
 
+static void set_lazy_properties(GDBusProxy *proxy, DBusMessageIter *iter)
+{
+	DBusMessageIter base;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+		return;
+
+	if (proxy->lazy_props != NULL)
+		dbus_message_unref(proxy->lazy_props);
+
+	proxy->lazy_props = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+	if (proxy->lazy_props == NULL) {
+		update_properties(proxy, iter, FALSE);
+		return;
+	}
+
+	dbus_message_iter_init_append(proxy->lazy_props, &base);
+	g_dbus_iter_append_iter(&base, iter);
+}
+
+static void load_properties(GDBusProxy *proxy)
+{
+	DBusMessage *msg = proxy->lazy_props;
+	GDBusPropertyFunction func = proxy->prop_func;
+	DBusMessageIter iter;
+
+	if (msg == NULL)
+		return;
+
+	proxy->lazy_props = NULL;
+
+	/* Values loaded on demand are not changes, don't notify them */
+	proxy->prop_func = NULL;
+
+	if (dbus_message_iter_init(msg, &iter))
+		update_properties(proxy, &iter, FALSE);
+
+	proxy->prop_func = func;
+
+	dbus_message_unref(msg);
+}
+
 static void proxy_added(GDBusClient *client, GDBusProxy *proxy)
 {
 	if (!proxy->pending)
@@ -534,6 +538,8 @@ static gboolean properties_changed(DBusConnection *conn, DBusMessage *msg,
 	dbus_message_iter_get_basic(&iter, &interface);
 	dbus_message_iter_next(&iter);
 
+	load_properties(proxy);
+
 	update_properties(proxy, &iter, TRUE);
 
 	dbus_message_iter_next(&iter);
@@ -611,6 +617,11 @@ static void proxy_free(gpointer data)
 
 		g_hash_table_remove_all(proxy->prop_list);
 
+		if (proxy->lazy_props != NULL) {
+			dbus_message_unref(proxy->lazy_props);
+			proxy->lazy_props = NULL;
+		}
+
 		proxy->client = NULL;
 	}
 
@@ -714,6 +725,9 @@ void g_dbus_proxy_unref(GDBusProxy *proxy)
 
 	g_hash_table_destroy(proxy->prop_list);
 
+	if (proxy->lazy_props != NULL)
+		dbus_message_unref(proxy->lazy_props);
+
 	g_free(proxy->obj_path);
 	g_free(proxy->interface);
 
@@ -744,6 +758,8 @@ gboolean g_dbus_proxy_get_property(GDBusProxy *proxy, const char *name,
 	if (proxy == NULL || name == NULL)
 		return FALSE;
 
+	load_properties(proxy);
+
 	prop = g_hash_table_lookup(proxy->prop_list, name);
 	if (prop == NULL)
 		return FALSE;
@@ -783,6 +799,7 @@ static void refresh_property_reply(DBusPendingCall *call, void *user_data)
 
 		dbus_message_iter_init(reply, &iter);
 
+		load_properties(data->proxy);
 		add_property(data->proxy, data->name, &iter, TRUE);
 	} else
 		dbus_error_free(&error);
@@ -1165,13 +1182,39 @@ static void refresh_properties(GList *list)
 	GList *l;
 
 	for (l = g_list_first(list); l; l = g_list_next(l)) {
-		GDBusProxy *proxy = list->data;
+		GDBusProxy *proxy = l->data;
 
 		if (proxy->pending)
 			get_all_properties(proxy);
         }
 }
 
+static gboolean filter_match(GDBusClient *client, const char *path,
+						const char *interface)
+{
+	GSList *l;
+
+	if (client->filter_path) {
+		size_t len = strlen(client->filter_path);
+
+		/* Match the path itself and the objects below it only */
+		if (strncmp(path, client->filter_path, len) ||
+				(len > 1 && path[len] != '\0' &&
+				path[len] != '/'))
+			return FALSE;
+	}
+
+	if (client->filter_interfaces == NULL)
+		return TRUE;
+
+	for (l = client->filter_interfaces; l; l = g_slist_next(l)) {
+		if (g_str_equal(l->data, interface) == TRUE)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 static void parse_properties(GDBusClient *client, const char *path,
 				const char *interface, DBusMessageIter *iter)
 {
@@ -1186,17 +1229,24 @@ static void parse_properties(GDBusClient *client, const char *path,
 	proxy = g_dbus_proxy_lookup(client->proxy_list, NULL,
 						path, interface);
 	if (proxy && !proxy->pending) {
+		load_properties(proxy);
 		update_properties(proxy, iter, FALSE);
 		return;
 	}
 
 	if (!proxy) {
+		if (!filter_match(client, path, interface))
+			return;
+
 		proxy = proxy_new(client, path, interface);
 		if (proxy == NULL)
 			return;
 	}
 
-	update_properties(proxy, iter, FALSE);
+	if (client->lazy_properties)
+		set_lazy_properties(proxy, iter);
+	else
+		update_properties(proxy, iter, FALSE);
 
 	proxy_added(client, proxy);
 }
@@ -1556,6 +1606,7 @@ void g_dbus_client_unref(GDBusClient *client)
 						message_filter, client);
 
 	g_list_free_full(client->proxy_list, proxy_free);
+	g_slist_free_full(client->filter_interfaces, g_free);
 
 	/*
 	 * Don't call disconn_func twice if disconnection
@@ -1573,6 +1624,7 @@ void g_dbus_client_unref(GDBusClient *client)
 	g_free(client->service_name);
 	g_free(client->base_path);
 	g_free(client->root_path);
+	g_free(client->filter_path);
 
 	g_free(client);
 }
@@ -1644,3 +1696,38 @@ gboolean g_dbus_client_set_proxy_handlers(GDBusClient *client,
 
 	return TRUE;
 }
+
+gboolean g_dbus_client_add_interface_filter(GDBusClient *client,
+						const char *interface)
+{
+	if (client == NULL || interface == NULL)
+		return FALSE;
+
+	client->filter_interfaces = g_slist_prepend(client->filter_interfaces,
+							g_strdup(interface));
+
+	return TRUE;
+}
+
+gboolean g_dbus_client_set_path_filter(GDBusClient *client,
+							const char *path)
+{
+	if (client == NULL)
+		return FALSE;
+
+	g_free(client->filter_path);
+	client->filter_path = g_strdup(path);
+
+	return TRUE;
+}
+
+gboolean g_dbus_client_set_lazy_properties(GDBusClient *client,
+							gboolean enable)
+{
+	if (client == NULL)
+		return FALSE;
+
+	client->lazy_properties = enable;
+
+	return TRUE;
+}
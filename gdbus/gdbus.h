@@ -233,6 +233,7 @@ struct GDBusSecurityTable {
 
 void g_dbus_set_flags(int flags);
 int g_dbus_get_flags(void);
+dbus_uint64_t g_dbus_get_signal_count(void);
 
 typedef void (*g_dbus_destroy_func_t)(void *user_data);
 typedef void (*g_dbus_debug_func_t)(const char *str, void *user_data);
@@ -338,6 +339,7 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 				GDbusPropertyChangedFlags flags);
 gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 				const char *interface, DBusMessageIter *iter);
+void g_dbus_iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter);
 
 gboolean g_dbus_attach_object_manager(DBusConnection *connection);
 gboolean g_dbus_detach_object_manager(DBusConnection *connection);
@@ -432,6 +434,17 @@ gboolean g_dbus_client_set_proxy_handlers(GDBusClient *client,
 					GDBusPropertyFunction property_changed,
 					void *user_data);
 
+/*
+ * Filters and lazy properties only apply to objects reported by the
+ * ObjectManager, so they need to be set before the proxy handlers.
+ */
+gboolean g_dbus_client_add_interface_filter(GDBusClient *client,
+						const char *interface);
+gboolean g_dbus_client_set_path_filter(GDBusClient *client,
+							const char *path);
+gboolean g_dbus_client_set_lazy_properties(GDBusClient *client,
+							gboolean enable);
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,7 +50,7 @@ struct generic_data {
 	GSList *objects;
 	GSList *added;
 	GSList *removed;
-	guint process_id;
+	gboolean queued;
 	gboolean pending_prop;
 	char *introspect;
 	struct generic_data *parent;
@@ -62,6 +62,8 @@ struct interface_data {
 	const GDBusSignalTable *signals;
 	const GDBusPropertyTable *properties;
 	GSList *pending_prop;
+	DBusMessage *props_cache;
+	int props_hidden;
 	void *user_data;
 	GDBusDestroyFunction destroy;
 };
@@ -87,10 +89,11 @@ struct debug_data {
 
 static int global_flags = 0;
 static struct generic_data *root;
-static GSList *pending = NULL;
+static GQueue pending = G_QUEUE_INIT;
+static guint pending_id = 0;
 static struct debug_data debug = { NULL, NULL, NULL };
 
-static gboolean process_changes(gpointer user_data);
+static void process_changes(struct generic_data *data);
 static void process_properties_from_interface(struct generic_data *data,
 						struct interface_data *iface);
 static void process_property_changes(struct generic_data *data);
@@ -565,11 +568,25 @@ static void append_property(struct interface_data *iface,
 	dbus_message_iter_close_container(dict, &entry);
 }
 
+static int hidden_property_flags(void)
+{
+	int flags = 0;
+
+	if (!(global_flags & G_DBUS_FLAG_ENABLE_EXPERIMENTAL))
+		flags |= G_DBUS_PROPERTY_FLAG_EXPERIMENTAL;
+
+	if (!(global_flags & G_DBUS_FLAG_ENABLE_TESTING))
+		flags |= G_DBUS_PROPERTY_FLAG_TESTING;
+
+	return flags;
+}
+
 static void append_properties(struct interface_data *data,
 							DBusMessageIter *iter)
 {
 	DBusMessageIter dict;
 	const GDBusPropertyTable *p;
+	int hidden = hidden_property_flags();
 
 	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
 				DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
@@ -578,14 +595,7 @@ static void append_properties(struct interface_data *data,
 				DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
 	for (p = data->properties; p && p->name; p++) {
-		if (check_experimental(p->flags,
-					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL))
-			continue;
-
-		if (check_testing(p->flags, G_DBUS_PROPERTY_FLAG_TESTING))
-			continue;
-
-		if (p->get == NULL)
+		if (p->flags & hidden || p->get == NULL)
 			continue;
 
 		if (p->exists != NULL && !p->exists(p, data->user_data))
@@ -597,6 +607,88 @@ static void append_properties(struct interface_data *data,
 	dbus_message_iter_close_container(iter, &dict);
 }
 
+void g_dbus_iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter)
+{
+	int type;
+
+	type = dbus_message_iter_get_arg_type(iter);
+
+	if (dbus_type_is_basic(type)) {
+		const void *value;
+
+		dbus_message_iter_get_basic(iter, &value);
+		dbus_message_iter_append_basic(base, type, &value);
+	} else if (dbus_type_is_container(type)) {
+		DBusMessageIter iter_sub, base_sub;
+		char *sig;
+
+		dbus_message_iter_recurse(iter, &iter_sub);
+
+		switch (type) {
+		case DBUS_TYPE_ARRAY:
+		case DBUS_TYPE_VARIANT:
+			sig = dbus_message_iter_get_signature(&iter_sub);
+			break;
+		default:
+			sig = NULL;
+			break;
+		}
+
+		dbus_message_iter_open_container(base, type, sig, &base_sub);
+
+		if (sig != NULL)
+			dbus_free(sig);
+
+		while (dbus_message_iter_get_arg_type(&iter_sub) !=
+							DBUS_TYPE_INVALID) {
+			g_dbus_iter_append_iter(&base_sub, &iter_sub);
+			dbus_message_iter_next(&iter_sub);
+		}
+
+		dbus_message_iter_close_container(base, &base_sub);
+	}
+}
+
+static void invalidate_properties(struct interface_data *iface)
+{
+	if (iface->props_cache == NULL)
+		return;
+
+	dbus_message_unref(iface->props_cache);
+	iface->props_cache = NULL;
+}
+
+/*
+ * Serialized properties are kept per interface until one of them is
+ * signalled as changed, so replies covering many objects, e.g.
+ * GetManagedObjects, don't need to call every getter again.
+ */
+static void append_cached_properties(struct interface_data *iface,
+							DBusMessageIter *iter)
+{
+	DBusMessageIter cache;
+	int hidden = hidden_property_flags();
+
+	if (iface->props_cache != NULL && iface->props_hidden != hidden)
+		invalidate_properties(iface);
+
+	if (iface->props_cache == NULL) {
+		iface->props_cache = dbus_message_new(
+					DBUS_MESSAGE_TYPE_METHOD_RETURN);
+		if (iface->props_cache == NULL) {
+			append_properties(iface, iter);
+			return;
+		}
+
+		iface->props_hidden = hidden;
+		dbus_message_iter_init_append(iface->props_cache, &cache);
+		append_properties(iface, &cache);
+	}
+
+	dbus_message_iter_init(iface->props_cache, &cache);
+	g_dbus_iter_append_iter(iter, &cache);
+}
+
 static void append_interface(gpointer data, gpointer user_data)
 {
 	struct interface_data *iface = data;
@@ -606,7 +698,7 @@ static void append_interface(gpointer data, gpointer user_data)
 	dbus_message_iter_open_container(array, DBUS_TYPE_DICT_ENTRY, NULL,
 								&entry);
 	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &iface->name);
-	append_properties(data, &entry);
+	append_cached_properties(iface, &entry);
 	dbus_message_iter_close_container(array, &entry);
 }
 
@@ -615,8 +707,18 @@ static const char *dbus_message_type_string(DBusMessage *msg)
 	return dbus_message_type_to_string(dbus_message_get_type(msg));
 }
 
+static dbus_uint64_t signal_count;
+
+dbus_uint64_t g_dbus_get_signal_count(void)
+{
+	return signal_count;
+}
+
 static void g_dbus_send_unref(DBusConnection *conn, DBusMessage *msg)
 {
+	if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_SIGNAL)
+		signal_count++;
+
 	g_dbus_debug("[%s] %s.%s",
 			dbus_message_type_string(msg),
 			dbus_message_get_interface(msg),
@@ -708,22 +810,32 @@ static gboolean g_dbus_args_have_signature(const GDBusArgInfo *args,
 	return TRUE;
 }
 
-static void add_pending(struct generic_data *data)
+static gboolean process_pending(gpointer user_data)
 {
-	guint old_id = data->process_id;
+	struct generic_data *data;
+
+	pending_id = 0;
 
-	data->process_id = g_idle_add(process_changes, data);
+	/*
+	 * Flush every object with changes in a single idle so bursts of
+	 * objects being registered don't require one source per object.
+	 */
+	while ((data = g_queue_peek_head(&pending)))
+		process_changes(data);
 
-	if (old_id > 0) {
-		/*
-		 * If the element already had an old idler, remove the old one,
-		 * no need to re-add it to the pending list.
-		 */
-		g_source_remove(old_id);
+	return FALSE;
+}
+
+static void add_pending(struct generic_data *data)
+{
+	if (pending_id == 0)
+		pending_id = g_idle_add(process_pending, NULL);
+
+	if (data->queued)
 		return;
-	}
 
-	pending = g_slist_append(pending, data);
+	data->queued = TRUE;
+	g_queue_push_tail(&pending, data);
 }
 
 static gboolean remove_interface(struct generic_data *data, const char *name)
@@ -735,6 +847,7 @@ static gboolean remove_interface(struct generic_data *data, const char *name)
 		return FALSE;
 
 	process_properties_from_interface(data, iface);
+	invalidate_properties(iface);
 
 	data->interfaces = g_slist_remove(data->interfaces, iface);
 
@@ -921,7 +1034,7 @@ static DBusMessage *properties_get_all(DBusConnection *connection,
 
 	dbus_message_iter_init_append(reply, &iter);
 
-	append_properties(iface, &iter);
+	append_cached_properties(iface, &iter);
 
 	return reply;
 }
@@ -1071,18 +1184,20 @@ static void emit_interfaces_removed(struct generic_data *data)
 
 static void remove_pending(struct generic_data *data)
 {
-	if (data->process_id > 0) {
-		g_source_remove(data->process_id);
-		data->process_id = 0;
-	}
+	if (!data->queued)
+		return;
+
+	data->queued = FALSE;
+	g_queue_remove(&pending, data);
 
-	pending = g_slist_remove(pending, data);
+	if (g_queue_is_empty(&pending) && pending_id > 0) {
+		g_source_remove(pending_id);
+		pending_id = 0;
+	}
 }
 
-static gboolean process_changes(gpointer user_data)
+static void process_changes(struct generic_data *data)
 {
-	struct generic_data *data = user_data;
-
 	remove_pending(data);
 
 	if (data->added != NULL)
@@ -1094,10 +1209,6 @@ static gboolean process_changes(gpointer user_data)
 
 	if (data->removed != NULL)
 		emit_interfaces_removed(data);
-
-	data->process_id = 0;
-
-	return FALSE;
 }
 
 static void generic_unregister(DBusConnection *connection, void *user_data)
@@ -1108,11 +1219,8 @@ static void generic_unregister(DBusConnection *connection, void *user_data)
 	if (parent != NULL)
 		parent->objects = g_slist_remove(parent->objects, data);
 
-	if (data->process_id > 0) {
-		g_source_remove(data->process_id);
-		data->process_id = 0;
+	if (data->queued)
 		process_changes(data);
-	}
 
 	g_slist_foreach(data->objects, reset_parent, data->parent);
 	g_slist_free(data->objects);
@@ -1593,9 +1701,9 @@ DBusMessage *g_dbus_create_reply(DBusMessage *message, int type, ...)
 
 static void g_dbus_flush(DBusConnection *connection)
 {
-	GSList *l;
+	GList *l;
 
-	for (l = pending; l;) {
+	for (l = pending.head; l;) {
 		struct generic_data *data = l->data;
 
 		l = l->next;
@@ -1643,6 +1751,7 @@ gboolean g_dbus_send_message(DBusConnection *connection, DBusMessage *message)
 				dbus_message_get_reply_serial(message));
 		break;
 	case DBUS_MESSAGE_TYPE_SIGNAL:
+		signal_count++;
 		g_dbus_debug("[%s] %s.%s",
 				dbus_message_type_string(message),
 				dbus_message_get_interface(message),
@@ -1897,6 +2006,8 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 	if (iface == NULL)
 		return;
 
+	invalidate_properties(iface);
+
 	/*
 	 * If ObjectManager is attached, don't emit property changed if
 	 * interface is not yet published
@@ -30,6 +30,22 @@ static DBusHandlerResult message_filter(DBusConnection *connection,
 static guint listener_id = 0;
 static GSList *listeners = NULL;
 
+/* Listeners indexed by path and argument, the most selective match keys,
+ * and by bus name for owner updates.
+ */
+static GHashTable *listener_index = NULL;
+static GHashTable *name_index = NULL;
+static guint listener_serial = 0;
+
+/* Listeners left to process by message_filter() */
+static GSList **dispatching = NULL;
+
+struct filter_bucket {
+	char *path;
+	char *argument;
+	GSList *filters;
+};
+
 struct service_data {
 	DBusConnection *conn;
 	DBusPendingCall *call;
@@ -63,8 +79,125 @@ struct filter_data {
 	guint name_watch;
 	gboolean lock;
 	gboolean registered;
+	guint serial;
+	struct filter_bucket *bucket;
 };
 
+static guint filter_bucket_hash(gconstpointer key)
+{
+	const struct filter_bucket *bucket = key;
+	guint hash = 0;
+
+	if (bucket->path)
+		hash = g_str_hash(bucket->path);
+
+	if (bucket->argument)
+		hash = hash * 31 + g_str_hash(bucket->argument);
+
+	return hash;
+}
+
+static gboolean filter_bucket_equal(gconstpointer a, gconstpointer b)
+{
+	const struct filter_bucket *bucket_a = a;
+	const struct filter_bucket *bucket_b = b;
+
+	return g_strcmp0(bucket_a->path, bucket_b->path) == 0 &&
+		g_strcmp0(bucket_a->argument, bucket_b->argument) == 0;
+}
+
+static void filter_bucket_free(gpointer data)
+{
+	struct filter_bucket *bucket = data;
+
+	g_slist_free(bucket->filters);
+	g_free(bucket->path);
+	g_free(bucket->argument);
+	g_free(bucket);
+}
+
+static struct filter_bucket *filter_bucket_find(const char *path,
+							const char *argument)
+{
+	struct filter_bucket key;
+
+	if (listener_index == NULL)
+		return NULL;
+
+	key.path = (char *) path;
+	key.argument = (char *) argument;
+
+	return g_hash_table_lookup(listener_index, &key);
+}
+
+static void listener_add(struct filter_data *data)
+{
+	struct filter_bucket *bucket;
+	GSList *list;
+
+	if (listener_index == NULL) {
+		listener_index = g_hash_table_new_full(filter_bucket_hash,
+							filter_bucket_equal,
+							filter_bucket_free,
+							NULL);
+		name_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+								g_free, NULL);
+	}
+
+	listeners = g_slist_append(listeners, data);
+	data->serial = ++listener_serial;
+
+	bucket = filter_bucket_find(data->path, data->argument);
+	if (bucket == NULL) {
+		bucket = g_new0(struct filter_bucket, 1);
+		bucket->path = g_strdup(data->path);
+		bucket->argument = g_strdup(data->argument);
+		g_hash_table_add(listener_index, bucket);
+	}
+
+	bucket->filters = g_slist_append(bucket->filters, data);
+	data->bucket = bucket;
+
+	if (data->name == NULL)
+		return;
+
+	list = g_hash_table_lookup(name_index, data->name);
+	if (list == NULL)
+		g_hash_table_insert(name_index, g_strdup(data->name),
+					g_slist_append(NULL, data));
+	else
+		list = g_slist_append(list, data);
+}
+
+static void listener_remove(struct filter_data *data)
+{
+	struct filter_bucket *bucket = data->bucket;
+	GSList *list;
+
+	listeners = g_slist_remove(listeners, data);
+
+	if (dispatching)
+		*dispatching = g_slist_remove(*dispatching, data);
+
+	if (bucket) {
+		bucket->filters = g_slist_remove(bucket->filters, data);
+		if (bucket->filters == NULL)
+			g_hash_table_remove(listener_index, bucket);
+
+		data->bucket = NULL;
+	}
+
+	if (data->name == NULL)
+		return;
+
+	list = g_hash_table_lookup(name_index, data->name);
+	list = g_slist_remove(list, data);
+	if (list == NULL)
+		g_hash_table_remove(name_index, data->name);
+	else
+		g_hash_table_insert(name_index, g_strdup(data->name), list);
+}
+
 static struct filter_data *filter_data_find_match(DBusConnection *connection,
 							const char *name,
 							const char *owner,
@@ -73,9 +206,14 @@ static struct filter_data *filter_data_find_match(DBusConnection *connection,
 							const char *member,
 							const char *argument)
 {
+	struct filter_bucket *bucket;
 	GSList *current;
 
-	for (current = listeners;
+	bucket = filter_bucket_find(path, argument);
+	if (bucket == NULL)
+		return NULL;
+
+	for (current = bucket->filters;
 			current != NULL; current = current->next) {
 		struct filter_data *data = current->data;
 
@@ -88,18 +226,12 @@ static struct filter_data *filter_data_find_match(DBusConnection *connection,
 		if (g_strcmp0(owner, data->owner) != 0)
 			continue;
 
-		if (g_strcmp0(path, data->path) != 0)
-			continue;
-
 		if (g_strcmp0(interface, data->interface) != 0)
 			continue;
 
 		if (g_strcmp0(member, data->member) != 0)
 			continue;
 
-		if (g_strcmp0(argument, data->argument) != 0)
-			continue;
-
 		return data;
 	}
 
@@ -285,7 +417,7 @@ proceed:
 		return NULL;
 	}
 
-	listeners = g_slist_append(listeners, data);
+	listener_add(data);
 
 	return data;
 }
@@ -398,7 +530,7 @@ static gboolean filter_data_remove_callback(struct filter_data *data,
 	if (data->registered && !remove_match(data))
 		return FALSE;
 
-	listeners = g_slist_remove(listeners, data);
+	listener_remove(data);
 	filter_data_free(data);
 
 	return TRUE;
@@ -437,11 +569,13 @@ static void update_name_cache(const char *name, const char *owner)
 {
 	GSList *l;
 
-	for (l = listeners; l != NULL; l = l->next) {
-		struct filter_data *data = l->data;
+	if (name_index == NULL)
+		return;
 
-		if (g_strcmp0(data->name, name) != 0)
-			continue;
+	l = g_hash_table_lookup(name_index, name);
+
+	for (; l != NULL; l = l->next) {
+		struct filter_data *data = l->data;
 
 		g_free(data->owner);
 		data->owner = g_strdup(owner);
@@ -452,16 +586,14 @@ static const char *check_name_cache(const char *name)
 {
 	GSList *l;
 
-	for (l = listeners; l != NULL; l = l->next) {
-		struct filter_data *data = l->data;
-
-		if (g_strcmp0(data->name, name) != 0)
-			continue;
+	if (name_index == NULL)
+		return NULL;
 
-		return data->owner;
-	}
+	l = g_hash_table_lookup(name_index, name);
+	if (l == NULL)
+		return NULL;
 
-	return NULL;
+	return ((struct filter_data *) l->data)->owner;
 }
 
 static DBusHandlerResult service_filter(DBusConnection *connection,
@@ -515,27 +647,29 @@ static DBusHandlerResult service_filter(DBusConnection *connection,
 }
 
 
-static DBusHandlerResult message_filter(DBusConnection *connection,
-					DBusMessage *message, void *user_data)
+static gint filter_data_cmp(gconstpointer a, gconstpointer b)
 {
-	struct filter_data *data;
-	const char *sender, *path, *iface, *member, *arg = NULL;
-	GSList *current, *delete_listener = NULL;
+	const struct filter_data *data_a = a;
+	const struct filter_data *data_b = b;
 
-	/* Only filter signals */
-	if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_SIGNAL)
-		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	return data_a->serial < data_b->serial ? -1 :
+					data_a->serial > data_b->serial;
+}
 
-	sender = dbus_message_get_sender(message);
-	path = dbus_message_get_path(message);
-	iface = dbus_message_get_interface(message);
-	member = dbus_message_get_member(message);
-	dbus_message_get_args(message, NULL, DBUS_TYPE_STRING, &arg, DBUS_TYPE_INVALID);
+static GSList *filter_bucket_match(GSList *matches, DBusConnection *connection,
+					const char *path, const char *argument,
+					const char *sender, const char *iface,
+					const char *member)
+{
+	struct filter_bucket *bucket;
+	GSList *current;
 
-	/* If sender != NULL it is always the owner */
+	bucket = filter_bucket_find(path, argument);
+	if (bucket == NULL)
+		return matches;
 
-	for (current = listeners; current != NULL; current = current->next) {
-		data = current->data;
+	for (current = bucket->filters; current; current = current->next) {
+		struct filter_data *data = current->data;
 
 		if (connection != data->connection)
 			continue;
@@ -546,19 +680,61 @@ static DBusHandlerResult message_filter(DBusConnection *connection,
 		if (data->owner && g_str_equal(sender, data->owner) == FALSE)
 			continue;
 
-		if (data->path && g_str_equal(path, data->path) == FALSE)
+		if (data->interface && g_strcmp0(iface,
+						data->interface) != 0)
 			continue;
 
-		if (data->interface && g_str_equal(iface,
-						data->interface) == FALSE)
+		if (data->member && g_strcmp0(member, data->member) != 0)
 			continue;
 
-		if (data->member && g_str_equal(member, data->member) == FALSE)
-			continue;
+		/* Keep the registration order across buckets */
+		matches = g_slist_insert_sorted(matches, data,
+							filter_data_cmp);
+	}
 
-		if (data->argument && g_str_equal(arg,
-						data->argument) == FALSE)
-			continue;
+	return matches;
+}
+
+static DBusHandlerResult message_filter(DBusConnection *connection,
+					DBusMessage *message, void *user_data)
+{
+	struct filter_data *data;
+	const char *sender, *path, *iface, *member, *arg = NULL;
+	GSList *matches = NULL, **prev;
+
+	/* Only filter signals */
+	if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_SIGNAL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	sender = dbus_message_get_sender(message);
+	path = dbus_message_get_path(message);
+	iface = dbus_message_get_interface(message);
+	member = dbus_message_get_member(message);
+	dbus_message_get_args(message, NULL, DBUS_TYPE_STRING, &arg, DBUS_TYPE_INVALID);
+
+	/* If sender != NULL it is always the owner */
+
+	/* Only look up the buckets of listeners which could match, either
+	 * on the exact path and argument or not filtering on them.
+	 */
+	matches = filter_bucket_match(matches, connection, path, NULL, sender,
+							iface, member);
+	matches = filter_bucket_match(matches, connection, NULL, NULL, sender,
+							iface, member);
+	if (arg) {
+		matches = filter_bucket_match(matches, connection, path, arg,
+							sender, iface, member);
+		matches = filter_bucket_match(matches, connection, NULL, arg,
+							sender, iface, member);
+	}
+
+	/* Listeners freed by a callback are dropped from matches */
+	prev = dispatching;
+	dispatching = &matches;
+
+	while (matches) {
+		data = matches->data;
+		matches = g_slist_delete_link(matches, matches);
 
 		if (data->handle_func) {
 			data->lock = TRUE;
@@ -570,31 +746,16 @@ static DBusHandlerResult message_filter(DBusConnection *connection,
 			data->lock = FALSE;
 		}
 
-		if (!data->callbacks)
-			delete_listener = g_slist_prepend(delete_listener,
-								current);
-	}
-
-	if (delete_listener == NULL)
-		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-
-	for (current = delete_listener; current != NULL;
-					current = delete_listener->next) {
-		GSList *l = current->data;
-
-		data = l->data;
-
-		/* Has any other callback added callbacks back to this data? */
-		if (data->callbacks != NULL)
+		if (data->callbacks)
 			continue;
 
 		remove_match(data);
-		listeners = g_slist_delete_link(listeners, l);
+		listener_remove(data);
 
 		filter_data_free(data);
 	}
 
-	g_slist_free(delete_listener);
+	dispatching = prev;
 
 	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
@@ -821,7 +982,7 @@ void g_dbus_remove_all_watches(DBusConnection *connection)
 	struct filter_data *data;
 
 	while ((data = filter_data_find(connection))) {
-		listeners = g_slist_remove(listeners, data);
+		listener_remove(data);
 		filter_data_call_and_free(data);
 	}
 }
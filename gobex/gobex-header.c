@@ -25,6 +25,8 @@
 
 #define G_OBEX_HDR_ENC(id)	((id) & 0xc0)
 
+#define HEADER_POOL_MAX		16
+
 struct _GObexHeader {
 	guint8 id;
 	gboolean extdata;
@@ -39,6 +41,33 @@ struct _GObexHeader {
 	} v;
 };
 
+/* Headers are decoded and freed for every packet, so keep a few around */
+static GObexHeader *header_pool[HEADER_POOL_MAX];
+static guint header_pool_len;
+
+static GObexHeader *header_new(void)
+{
+	GObexHeader *header;
+
+	if (!header_pool_len)
+		return g_new0(GObexHeader, 1);
+
+	header = header_pool[--header_pool_len];
+	memset(header, 0, sizeof(*header));
+
+	return header;
+}
+
+static void header_release(GObexHeader *header)
+{
+	if (header_pool_len < HEADER_POOL_MAX) {
+		header_pool[header_pool_len++] = header;
+		return;
+	}
+
+	g_free(header);
+}
+
 static glong utf8_to_utf16(gunichar2 **utf16, const char *utf8) {
 	glong utf16_len;
 	int i;
@@ -170,7 +199,7 @@ GObexHeader *g_obex_header_decode(const void *data, gsize len,
 		return NULL;
 	}
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	ptr = get_bytes(&header->id, ptr, sizeof(header->id));
 
@@ -321,7 +350,7 @@ void g_obex_header_free(GObexHeader *header)
 		g_assert_not_reached();
 	}
 
-	g_free(header);
+	header_release(header);
 }
 
 gboolean g_obex_header_get_unicode(GObexHeader *header, const char **str)
@@ -411,7 +440,7 @@ GObexHeader *g_obex_header_new_unicode(guint8 id, const char *str)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_UNICODE)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 
@@ -435,7 +464,7 @@ GObexHeader *g_obex_header_new_bytes(guint8 id, const void *data, gsize len)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_BYTES)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 	header->vlen = len;
@@ -471,7 +500,7 @@ GObexHeader *g_obex_header_new_uint8(guint8 id, guint8 val)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_UINT8)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 	header->vlen = 1;
@@ -492,7 +521,7 @@ GObexHeader *g_obex_header_new_uint32(guint8 id, guint32 val)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_UINT32)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 	header->vlen = 4;
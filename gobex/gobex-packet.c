@@ -21,6 +21,9 @@
 
 #define FINAL_BIT 0x80
 
+#define PACKET_POOL_MAX 8
+#define NODE_POOL_MAX 32
+
 struct _GObexPacket {
 	guint8 opcode;
 	gboolean final;
@@ -40,6 +43,71 @@ struct _GObexPacket {
 	gpointer get_body_data;
 };
 
+/*
+ * Packets and their header list nodes are allocated and freed for every
+ * request and response, so recycle them instead of going to the allocator.
+ */
+static GObexPacket *packet_pool[PACKET_POOL_MAX];
+static guint packet_pool_len;
+
+static GSList *node_pool;
+static guint node_pool_len;
+
+static GObexPacket *packet_alloc(void)
+{
+	GObexPacket *pkt;
+
+	if (!packet_pool_len)
+		return g_new0(GObexPacket, 1);
+
+	pkt = packet_pool[--packet_pool_len];
+	memset(pkt, 0, sizeof(*pkt));
+
+	return pkt;
+}
+
+static void packet_release(GObexPacket *pkt)
+{
+	if (packet_pool_len < PACKET_POOL_MAX) {
+		packet_pool[packet_pool_len++] = pkt;
+		return;
+	}
+
+	g_free(pkt);
+}
+
+static GSList *node_alloc(gpointer data)
+{
+	GSList *node = node_pool;
+
+	if (node) {
+		node_pool = node->next;
+		node_pool_len--;
+	} else
+		node = g_slist_alloc();
+
+	node->data = data;
+	node->next = NULL;
+
+	return node;
+}
+
+static void nodes_release(GSList *list)
+{
+	while (list) {
+		GSList *next = list->next;
+
+		if (node_pool_len < NODE_POOL_MAX) {
+			list->next = node_pool;
+			node_pool = list;
+			node_pool_len++;
+		} else
+			g_slist_free_1(list);
+
+		list = next;
+	}
+}
+
 GObexHeader *g_obex_packet_get_header(GObexPacket *pkt, guint8 id)
 {
 	GSList *l;
@@ -81,9 +149,12 @@ guint8 g_obex_packet_get_operation(GObexPacket *pkt, gboolean *final)
 
 gboolean g_obex_packet_prepend_header(GObexPacket *pkt, GObexHeader *header)
 {
+	GSList *node = node_alloc(header);
+
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
-	pkt->headers = g_slist_prepend(pkt->headers, header);
+	node->next = pkt->headers;
+	pkt->headers = node;
 	pkt->hlen += g_obex_header_get_length(header);
 
 	return TRUE;
@@ -93,7 +164,7 @@ gboolean g_obex_packet_add_header(GObexPacket *pkt, GObexHeader *header)
 {
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
-	pkt->headers = g_slist_append(pkt->headers, header);
+	pkt->headers = g_slist_concat(pkt->headers, node_alloc(header));
 	pkt->hlen += g_obex_header_get_length(header);
 
 	return TRUE;
@@ -222,7 +293,7 @@ GObexPacket *g_obex_packet_new_valist(guint8 opcode, gboolean final,
 
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", opcode);
 
-	pkt = g_new0(GObexPacket, 1);
+	pkt = packet_alloc();
 
 	pkt->opcode = opcode;
 	pkt->final = final;
@@ -267,8 +338,8 @@ void g_obex_packet_free(GObexPacket *pkt)
 	}
 
 	g_slist_foreach(pkt->headers, header_free, NULL);
-	g_slist_free(pkt->headers);
-	g_free(pkt);
+	nodes_release(pkt->headers);
+	packet_release(pkt);
 }
 
 static gboolean parse_headers(GObexPacket *pkt, const void *data, gsize len,
@@ -276,9 +347,13 @@ static gboolean parse_headers(GObexPacket *pkt, const void *data, gsize len,
 						GError **err)
 {
 	const guint8 *buf = data;
+	GSList **tail = &pkt->headers;
 
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
+	while (*tail)
+		tail = &(*tail)->next;
+
 	while (len > 0) {
 		GObexHeader *header;
 		gsize parsed;
@@ -288,7 +363,8 @@ static gboolean parse_headers(GObexPacket *pkt, const void *data, gsize len,
 		if (header == NULL)
 			return FALSE;
 
-		pkt->headers = g_slist_append(pkt->headers, header);
+		*tail = node_alloc(header);
+		tail = &(*tail)->next;
 		pkt->hlen += parsed;
 
 		len -= parsed;
@@ -14,6 +14,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
 
 #include "gobex.h"
 #include "gobex-debug.h"
@@ -27,6 +28,8 @@
 
 #define G_OBEX_OP_NONE		0xff
 
+#define WRITE_BURST		8
+
 #define FINAL_BIT		0x80
 
 #define CONNID_INVALID		0xffffffff
@@ -424,12 +427,27 @@ static void setup_srm(GObex *obex, GObexPacket *pkt, gboolean outgoing)
 		check_srm_final(obex, op);
 }
 
+static gboolean tx_writable(GObex *obex)
+{
+	struct pollfd pfd;
+
+	pfd.fd = g_io_channel_unix_get_fd(obex->io);
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, 0) <= 0)
+		return FALSE;
+
+	return pfd.revents == POLLOUT;
+}
+
 static gboolean write_data(GIOChannel *io, GIOCondition cond,
 							gpointer user_data)
 {
 	GObex *obex = user_data;
 	struct pending_pkt *p = NULL;
 	GError *err = NULL;
+	unsigned int burst = 0;
 
 	if (cond & G_IO_NVAL)
 		return FALSE;
@@ -437,6 +455,7 @@ static gboolean write_data(GIOChannel *io, GIOCondition cond,
 	if (cond & (G_IO_HUP | G_IO_ERR))
 		goto stop_tx;
 
+next:
 	if (obex->tx_data == 0) {
 		ssize_t len;
 
@@ -508,6 +527,17 @@ encode:
 	}
 
 done:
+	/* With SRM the next packet is queued while encoding the current one,
+	 * so keep the pipeline full while the socket can take more instead
+	 * of waiting for another main loop iteration per packet.
+	 */
+	if (obex->tx_data == 0 && g_queue_get_length(obex->tx_queue) > 0 &&
+			++burst < WRITE_BURST && g_obex_srm_active(obex) &&
+			tx_writable(obex)) {
+		p = NULL;
+		goto next;
+	}
+
 	if (obex->tx_data > 0 || g_queue_get_length(obex->tx_queue) > 0)
 		return TRUE;
 
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <poll.h>
+#include <time.h>
 
 #include <sys/param.h>
 #include <sys/uio.h>
@@ -1269,6 +1270,343 @@ done:
 	return 0;
 }
 
+/*
+ * Asynchronous requests allow several commands to be in flight on one
+ * socket. The caller polls the socket and calls hci_async_process() when
+ * it is readable or when hci_async_timeout() expires.
+ */
+struct hci_async_req {
+	int id;
+	uint16_t opcode;
+	struct hci_request *req;
+	int pending;
+	long expire;
+	hci_async_cb cb;
+	void *user_data;
+	struct hci_async_req *next;
+};
+
+struct hci_async {
+	int dd;
+	int next_id;
+	struct hci_filter of;
+	struct hci_filter nf;
+	struct hci_async_req *reqs;
+};
+
+static long async_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+struct hci_async *hci_async_new(int dd)
+{
+	struct hci_async *async;
+	socklen_t olen;
+
+	async = malloc(sizeof(*async));
+	if (!async)
+		return NULL;
+
+	memset(async, 0, sizeof(*async));
+	async->dd = dd;
+
+	olen = sizeof(async->of);
+	if (getsockopt(dd, SOL_HCI, HCI_FILTER, &async->of, &olen) < 0)
+		goto failed;
+
+	/* Responses of all opcodes are needed with several requests queued */
+	hci_filter_clear(&async->nf);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &async->nf);
+	hci_filter_set_event(EVT_CMD_STATUS, &async->nf);
+	hci_filter_set_event(EVT_CMD_COMPLETE, &async->nf);
+	hci_filter_set_event(EVT_LE_META_EVENT, &async->nf);
+	if (setsockopt(dd, SOL_HCI, HCI_FILTER, &async->nf,
+						sizeof(async->nf)) < 0)
+		goto failed;
+
+	return async;
+
+failed:
+	free(async);
+	return NULL;
+}
+
+void hci_async_free(struct hci_async *async)
+{
+	struct hci_async_req *r;
+
+	if (!async)
+		return;
+
+	while ((r = async->reqs)) {
+		async->reqs = r->next;
+		free(r);
+	}
+
+	setsockopt(async->dd, SOL_HCI, HCI_FILTER, &async->of,
+						sizeof(async->of));
+	free(async);
+}
+
+int hci_async_send_req(struct hci_async *async, struct hci_request *req,
+			int to, hci_async_cb cb, void *user_data)
+{
+	struct hci_async_req *r, **tail;
+
+	if (!async || !req || !cb) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!hci_filter_test_event(req->event, &async->nf)) {
+		hci_filter_set_event(req->event, &async->nf);
+		if (setsockopt(async->dd, SOL_HCI, HCI_FILTER, &async->nf,
+						sizeof(async->nf)) < 0)
+			return -1;
+	}
+
+	r = malloc(sizeof(*r));
+	if (!r) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	memset(r, 0, sizeof(*r));
+	r->opcode = htobs(cmd_opcode_pack(req->ogf, req->ocf));
+	r->req = req;
+	r->expire = to > 0 ? async_now() + to : 0;
+	r->cb = cb;
+	r->user_data = user_data;
+
+	if (hci_send_cmd(async->dd, req->ogf, req->ocf, req->clen,
+							req->cparam) < 0) {
+		free(r);
+		return -1;
+	}
+
+	if (++async->next_id <= 0)
+		async->next_id = 1;
+
+	r->id = async->next_id;
+
+	/* Keep submission order so identical events resolve oldest first */
+	for (tail = &async->reqs; *tail; tail = &(*tail)->next)
+		;
+
+	*tail = r;
+
+	return r->id;
+}
+
+int hci_async_cancel(struct hci_async *async, int id)
+{
+	struct hci_async_req *r, **prev;
+
+	if (!async)
+		return -1;
+
+	for (prev = &async->reqs; (r = *prev); prev = &r->next) {
+		if (r->id != id)
+			continue;
+
+		*prev = r->next;
+		free(r);
+		return 0;
+	}
+
+	errno = ENOENT;
+	return -1;
+}
+
+int hci_async_timeout(struct hci_async *async)
+{
+	struct hci_async_req *r;
+	long now, next = -1;
+
+	if (!async)
+		return -1;
+
+	now = async_now();
+
+	for (r = async->reqs; r; r = r->next) {
+		if (!r->expire)
+			continue;
+
+		if (r->expire <= now)
+			return 0;
+
+		if (next < 0 || r->expire - now < next)
+			next = r->expire - now;
+	}
+
+	return next;
+}
+
+static void async_complete(struct hci_async *async, struct hci_async_req *r,
+					int err, const void *data, int len)
+{
+	struct hci_async_req **prev;
+
+	for (prev = &async->reqs; *prev != r; prev = &(*prev)->next)
+		;
+
+	*prev = r->next;
+
+	if (len < 0)
+		len = 0;
+
+	if (!err) {
+		r->req->rlen = MIN(len, r->req->rlen);
+		memcpy(r->req->rparam, data, r->req->rlen);
+	}
+
+	r->cb(err, r->req, r->user_data);
+	free(r);
+}
+
+static struct hci_async_req *async_find_event(struct hci_async *async,
+					int event, const bdaddr_t *bdaddr)
+{
+	struct hci_async_req *r;
+
+	/* Completion events always follow a successful command status */
+	for (r = async->reqs; r; r = r->next) {
+		remote_name_req_cp *cp = r->req->cparam;
+
+		if (!r->pending || r->req->event != event)
+			continue;
+
+		if (bdaddr && bacmp(bdaddr, &cp->bdaddr))
+			continue;
+
+		return r;
+	}
+
+	return NULL;
+}
+
+static void async_event(struct hci_async *async, uint8_t *buf, int len)
+{
+	hci_event_hdr *hdr = (void *) (buf + 1);
+	uint8_t *ptr = buf + (1 + HCI_EVENT_HDR_SIZE);
+	struct hci_async_req *r;
+	evt_cmd_complete *cc;
+	evt_cmd_status *cs;
+	evt_remote_name_req_complete *rn;
+	evt_le_meta_event *me;
+
+	len -= (1 + HCI_EVENT_HDR_SIZE);
+	if (len < 0)
+		return;
+
+	switch (hdr->evt) {
+	case EVT_CMD_STATUS:
+		cs = (void *) ptr;
+
+		for (r = async->reqs; r; r = r->next) {
+			if (r->opcode == cs->opcode && !r->pending)
+				break;
+		}
+
+		if (!r)
+			return;
+
+		if (r->req->event == EVT_CMD_STATUS)
+			async_complete(async, r, 0, ptr, len);
+		else if (cs->status)
+			async_complete(async, r, EIO, NULL, 0);
+		else
+			r->pending = 1;
+
+		return;
+
+	case EVT_CMD_COMPLETE:
+		cc = (void *) ptr;
+
+		for (r = async->reqs; r; r = r->next) {
+			if (r->opcode == cc->opcode && !r->pending)
+				break;
+		}
+
+		if (r)
+			async_complete(async, r, 0, ptr + EVT_CMD_COMPLETE_SIZE,
+						len - EVT_CMD_COMPLETE_SIZE);
+
+		return;
+
+	case EVT_LE_META_EVENT:
+		me = (void *) ptr;
+
+		r = async_find_event(async, me->subevent, NULL);
+		if (r)
+			async_complete(async, r, 0, me->data, len - 1);
+
+		return;
+
+	case EVT_REMOTE_NAME_REQ_COMPLETE:
+		rn = (void *) ptr;
+
+		r = async_find_event(async, hdr->evt, &rn->bdaddr);
+		if (r)
+			async_complete(async, r, 0, ptr, len);
+
+		return;
+
+	default:
+		r = async_find_event(async, hdr->evt, NULL);
+		if (r)
+			async_complete(async, r, 0, ptr, len);
+
+		return;
+	}
+}
+
+int hci_async_process(struct hci_async *async)
+{
+	unsigned char buf[HCI_MAX_EVENT_SIZE];
+	struct hci_async_req *r;
+	long now;
+	int len;
+
+	if (!async) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	while ((len = recv(async->dd, buf, sizeof(buf), MSG_DONTWAIT)) < 0) {
+		if (errno == EINTR)
+			continue;
+
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			return -1;
+
+		break;
+	}
+
+	if (len > 0)
+		async_event(async, buf, len);
+
+	now = async_now();
+
+	/* Callbacks may cancel other requests so rescan after each one */
+	for (r = async->reqs; r;) {
+		if (!r->expire || r->expire > now) {
+			r = r->next;
+			continue;
+		}
+
+		async_complete(async, r, ETIMEDOUT, NULL, 0);
+		r = async->reqs;
+	}
+
+	return 0;
+}
+
 int hci_create_connection(int dd, const bdaddr_t *bdaddr, uint16_t ptype,
 				uint16_t clkoffset, uint8_t rswitch,
 				uint16_t *handle, int to)
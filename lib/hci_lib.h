@@ -40,6 +40,18 @@ int hci_close_dev(int dd);
 int hci_send_cmd(int dd, uint16_t ogf, uint16_t ocf, uint8_t plen, void *param);
 int hci_send_req(int dd, struct hci_request *req, int timeout);
 
+struct hci_async;
+typedef void (*hci_async_cb)(int err, struct hci_request *req,
+							void *user_data);
+
+struct hci_async *hci_async_new(int dd);
+void hci_async_free(struct hci_async *async);
+int hci_async_send_req(struct hci_async *async, struct hci_request *req,
+			int timeout, hci_async_cb cb, void *user_data);
+int hci_async_cancel(struct hci_async *async, int id);
+int hci_async_timeout(struct hci_async *async);
+int hci_async_process(struct hci_async *async);
+
 int hci_create_connection(int dd, const bdaddr_t *bdaddr, uint16_t ptype, uint16_t clkoffset, uint8_t rswitch, uint16_t *handle, int to);
 int hci_disconnect(int dd, uint16_t handle, uint8_t reason, int to);
 
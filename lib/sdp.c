@@ -799,9 +799,19 @@ recalculate:
 
 	data_size = sdp_get_data_size(buf, d);
 	if (data_size > UCHAR_MAX && d->dtd == SDP_SEQ8) {
-		buf->data_size = orig_data_size;
 		d->dtd = SDP_SEQ16;
-		goto recalculate;
+
+		/* Shift the encoded elements instead of encoding them again */
+		if (buf->data_size == orig_data_size + pdu_size + data_size &&
+				buf->data_size < buf->buf_size) {
+			memmove(seqp + pdu_size + 1, seqp + pdu_size,
+								data_size);
+			pdu_size += sizeof(uint8_t);
+			buf->data_size += sizeof(uint8_t);
+		} else {
+			buf->data_size = orig_data_size;
+			goto recalculate;
+		}
 	}
 
 	*seqp = d->dtd;
@@ -1395,6 +1405,7 @@ sdp_record_t *sdp_extract_pdu(const uint8_t *buf, int bufsize, int *scanned)
 	uint8_t dtd;
 	uint16_t attr;
 	sdp_record_t *rec = sdp_record_alloc();
+	sdp_list_t *tail = NULL;
 	const uint8_t *p = buf;
 
 	*scanned = sdp_extract_seqtype(buf, bufsize, &dtd, &seqlen);
@@ -1439,8 +1450,26 @@ sdp_record_t *sdp_extract_pdu(const uint8_t *buf, int bufsize, int *scanned)
 		extracted += n;
 		p += n;
 		bufsize -= n;
+
+		/* Attributes are normally sorted so avoid the sorted insert */
+		if (tail && attr > ((sdp_data_t *) tail->data)->attrId) {
+			data->attrId = attr;
+			tail->next = sdp_list_append(NULL, data);
+			if (!tail->next) {
+				sdp_data_free(data);
+				break;
+			}
+
+			tail = tail->next;
+			continue;
+		}
+
 		sdp_attr_replace(rec, attr, data);
 
+		for (tail = rec->attrlist; tail && tail->next;
+							tail = tail->next)
+			;
+
 		SDPDBG("Extract PDU, seqLength: %d localExtractedLength: %d",
 							seqlen, extracted);
 	}
@@ -2751,13 +2780,8 @@ void sdp_uuid32_to_uuid128(uuid_t *uuid128, const uuid_t *uuid32)
 	memcpy(&uuid128->value.uuid128.data[0], &data0, 4);
 }
 
-uuid_t *sdp_uuid_to_uuid128(const uuid_t *uuid)
+static void uuid_to_uuid128(const uuid_t *uuid, uuid_t *uuid128)
 {
-	uuid_t *uuid128 = bt_malloc0(sizeof(uuid_t));
-
-	if (!uuid128)
-		return NULL;
-
 	switch (uuid->type) {
 	case SDP_UUID128:
 		*uuid128 = *uuid;
@@ -2769,6 +2793,17 @@ uuid_t *sdp_uuid_to_uuid128(const uuid_t *uuid)
 		sdp_uuid16_to_uuid128(uuid128, uuid);
 		break;
 	}
+}
+
+uuid_t *sdp_uuid_to_uuid128(const uuid_t *uuid)
+{
+	uuid_t *uuid128 = bt_malloc0(sizeof(uuid_t));
+
+	if (!uuid128)
+		return NULL;
+
+	uuid_to_uuid128(uuid, uuid128);
+
 	return uuid128;
 }
 
@@ -2825,32 +2860,24 @@ int sdp_uuid_to_proto(uuid_t *uuid)
  * Should the PDU length exceed 2^8, then sequence type is
  * set accordingly and the data is memmove()'d.
  */
-void sdp_append_to_buf(sdp_buf_t *dst, uint8_t *data, uint32_t len)
+static void append_seq_init(sdp_buf_t *dst)
 {
 	uint8_t *p = dst->data;
-	uint8_t dtd = *p;
 
-	SDPDBG("Append src size: %d", len);
-	SDPDBG("Append dst size: %d", dst->data_size);
-	SDPDBG("Dst buffer size: %d", dst->buf_size);
-
-	if (dst->data_size + len > dst->buf_size) {
-		SDPERR("Cannot append");
-		return;
-	}
-
-	if (dst->data_size == 0 && dtd == 0) {
+	if (dst->data_size == 0 && *p == 0) {
 		/* create initial sequence */
 		*p = SDP_SEQ8;
 		dst->data_size += sizeof(uint8_t);
 		/* reserve space for sequence size */
 		dst->data_size += sizeof(uint8_t);
 	}
+}
 
-	memcpy(dst->data + dst->data_size, data, len);
-	dst->data_size += len;
+static void append_seq_update(sdp_buf_t *dst)
+{
+	uint8_t *p = dst->data;
+	uint8_t dtd = *p;
 
-	dtd = *(uint8_t *) dst->data;
 	if (dst->data_size > UCHAR_MAX && dtd == SDP_SEQ8) {
 		short offset = sizeof(uint8_t) + sizeof(uint8_t);
 		memmove(dst->data + offset + 1, dst->data + offset,
@@ -2873,12 +2900,52 @@ void sdp_append_to_buf(sdp_buf_t *dst, uint8_t *data, uint32_t len)
 	}
 }
 
+void sdp_append_to_buf(sdp_buf_t *dst, uint8_t *data, uint32_t len)
+{
+	SDPDBG("Append src size: %d", len);
+	SDPDBG("Append dst size: %d", dst->data_size);
+	SDPDBG("Dst buffer size: %d", dst->buf_size);
+
+	if (dst->data_size + len > dst->buf_size) {
+		SDPERR("Cannot append");
+		return;
+	}
+
+	append_seq_init(dst);
+
+	memcpy(dst->data + dst->data_size, data, len);
+	dst->data_size += len;
+
+	append_seq_update(dst);
+}
+
 void sdp_append_to_pdu(sdp_buf_t *pdu, sdp_data_t *d)
 {
 	sdp_buf_t append;
+	uint32_t head = 0;
 
 	memset(&append, 0, sizeof(sdp_buf_t));
 	sdp_gen_buffer(&append, d);
+
+	if (pdu->data_size == 0 && *pdu->data == 0)
+		head = 2 * sizeof(uint8_t);
+
+	/* Encode in place when the worst case size fits the destination */
+	if (pdu->data_size + head + append.buf_size <= pdu->buf_size) {
+		append_seq_init(pdu);
+
+		append.data = pdu->data + pdu->data_size;
+		append.buf_size = pdu->buf_size - pdu->data_size;
+		append.data_size = 0;
+
+		sdp_set_attrid(&append, d->attrId);
+		sdp_gen_pdu(&append, d);
+
+		pdu->data_size += append.data_size;
+		append_seq_update(pdu);
+		return;
+	}
+
 	append.data = malloc(append.buf_size);
 	if (!append.data)
 		return;
@@ -3224,15 +3291,26 @@ void sdp_record_free(sdp_record_t *rec)
 
 void sdp_pattern_add_uuid(sdp_record_t *rec, uuid_t *uuid)
 {
-	uuid_t *uuid128 = sdp_uuid_to_uuid128(uuid);
+	uuid_t tmp, *uuid128;
 
 	SDPDBG("Elements in target pattern : %d", sdp_list_len(rec->pattern));
+
+	/* Only allocate for UUIDs that are not part of the pattern yet */
+	memset(&tmp, 0, sizeof(tmp));
+	uuid_to_uuid128(uuid, &tmp);
+	if (sdp_list_find(rec->pattern, &tmp, sdp_uuid128_cmp))
+		return;
+
+	uuid128 = bt_malloc(sizeof(uuid_t));
+	if (!uuid128)
+		return;
+
+	*uuid128 = tmp;
+
 	SDPDBG("Trying to add : 0x%lx", (unsigned long) uuid128);
 
-	if (sdp_list_find(rec->pattern, uuid128, sdp_uuid128_cmp) == NULL)
-		rec->pattern = sdp_list_insert_sorted(rec->pattern, uuid128, sdp_uuid128_cmp);
-	else
-		bt_free(uuid128);
+	rec->pattern = sdp_list_insert_sorted(rec->pattern, uuid128,
+							sdp_uuid128_cmp);
 
 	SDPDBG("Elements in target pattern : %d", sdp_list_len(rec->pattern));
 }
@@ -110,9 +110,67 @@ int bt_uuid128_create(bt_uuid_t *btuuid, uint128_t value)
 	return 0;
 }
 
+static int value_cmp(uint32_t v1, uint32_t v2)
+{
+	return v1 < v2 ? -1 : v1 > v2;
+}
+
+/* Compares a 128-bit UUID against a BASE_UUID based 16/32-bit value */
+static int bt_uuid128_base_cmp(const uint128_t *u128, uint32_t value)
+{
+	uint32_t be32 = htonl(value);
+	int ret;
+
+	ret = memcmp(&u128->data[BASE_UUID32_OFFSET], &be32, sizeof(be32));
+	if (ret)
+		return ret;
+
+	return memcmp(&u128->data[sizeof(be32)],
+			&bluetooth_base_uuid.data[sizeof(be32)],
+			sizeof(uint128_t) - sizeof(be32));
+}
+
+static int uuid_base_value(const bt_uuid_t *uuid, uint32_t *value)
+{
+	switch (uuid->type) {
+	case BT_UUID16:
+		*value = uuid->value.u16;
+		return 1;
+	case BT_UUID32:
+		*value = uuid->value.u32;
+		return 1;
+	case BT_UUID128:
+	case BT_UUID_UNSPEC:
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Orders UUIDs as their 128-bit forms would, without converting them:
+ * 16-bit and 32-bit UUIDs only differ in the first 4 bytes of the base
+ * UUID so they compare as numbers.
+ */
 int bt_uuid_cmp(const bt_uuid_t *uuid1, const bt_uuid_t *uuid2)
 {
 	bt_uuid_t u1, u2;
+	uint32_t v1, v2;
+	int base1, base2;
+
+	base1 = uuid_base_value(uuid1, &v1);
+	base2 = uuid_base_value(uuid2, &v2);
+
+	if (base1 && base2)
+		return value_cmp(v1, v2);
+
+	if (base1 && uuid2->type == BT_UUID128)
+		return -bt_uuid128_base_cmp(&uuid2->value.u128, v1);
+
+	if (base2 && uuid1->type == BT_UUID128)
+		return bt_uuid128_base_cmp(&uuid1->value.u128, v2);
+
+	if (uuid1->type == BT_UUID128 && uuid2->type == BT_UUID128)
+		return bt_uuid128_cmp(uuid1, uuid2);
 
 	bt_uuid_to_uuid128(uuid1, &u1);
 	bt_uuid_to_uuid128(uuid2, &u2);
@@ -120,6 +178,29 @@ int bt_uuid_cmp(const bt_uuid_t *uuid1, const bt_uuid_t *uuid2)
 	return bt_uuid128_cmp(&u1, &u2);
 }
 
+int bt_uuid128_find(const uint128_t *set, size_t count,
+						const uint128_t *uuid)
+{
+	uint64_t a0, a1;
+	size_t i;
+
+	memcpy(&a0, &uuid->data[0], sizeof(a0));
+	memcpy(&a1, &uuid->data[8], sizeof(a1));
+
+	/* Branch free 16 byte compare so the loop can be vectorized */
+	for (i = 0; i < count; i++) {
+		uint64_t b0, b1;
+
+		memcpy(&b0, &set[i].data[0], sizeof(b0));
+		memcpy(&b1, &set[i].data[8], sizeof(b1));
+
+		if (!((a0 ^ b0) | (a1 ^ b1)))
+			return i;
+	}
+
+	return -1;
+}
+
 int bt_uuid16_cmp(const bt_uuid_t *uuid1, uint16_t uuid2)
 {
 
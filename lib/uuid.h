@@ -268,6 +268,8 @@ int bt_uuid128_create(bt_uuid_t *btuuid, uint128_t value);
 int bt_uuid_cmp(const bt_uuid_t *uuid1, const bt_uuid_t *uuid2);
 int bt_uuid16_cmp(const bt_uuid_t *uuid1, uint16_t uuid2);
 void bt_uuid_to_uuid128(const bt_uuid_t *src, bt_uuid_t *dst);
+int bt_uuid128_find(const uint128_t *set, size_t count,
+						const uint128_t *uuid);
 
 #define MAX_LEN_UUID_STR 37
 
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "src/shared/aes.h"
+
+#include "mesh/aes.h"
+
+/*
+ * CCM (RFC 3610) with L = 2 as used by Mesh, on top of the in-process
+ * AES-128 so that each network PDU does not cost a round trip through
+ * AF_ALG.
+ */
+
+#define CCM_BATCH		8
+
+static inline void xor_block(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] ^= src[i];
+}
+
+static void ccm_mac_data(const struct bt_aes *aes, uint8_t x[16],
+				const uint8_t *data, size_t len, size_t used)
+{
+	while (len) {
+		size_t n = 16 - used;
+
+		if (n > len)
+			n = len;
+
+		xor_block(x + used, data, n);
+		data += n;
+		len -= n;
+		used += n;
+
+		if (used == 16 || !len) {
+			bt_aes_encrypt(aes, x, x);
+			used = 0;
+		}
+	}
+}
+
+static void ccm_mac(const struct bt_aes *aes, const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const uint8_t *msg, uint16_t msg_len,
+				size_t mic_size, uint8_t x[16])
+{
+	x[0] = (aad_len ? 0x40 : 0x00) | ((mic_size - 2) / 2) << 3 | 0x01;
+	memcpy(x + 1, nonce, 13);
+	x[14] = msg_len >> 8;
+	x[15] = msg_len;
+	bt_aes_encrypt(aes, x, x);
+
+	if (aad_len) {
+		x[0] ^= aad_len >> 8;
+		x[1] ^= aad_len;
+		ccm_mac_data(aes, x, aad, aad_len, 2);
+	}
+
+	ccm_mac_data(aes, x, msg, msg_len, 0);
+}
+
+/*
+ * Generates the CTR keystream CCM_BATCH blocks at a time and applies it to
+ * in. The first keystream block (counter 0) is returned in s0 for the MIC.
+ */
+static void ccm_ctr(const struct bt_aes *aes, const uint8_t nonce[13],
+				const uint8_t *in, uint8_t *out, size_t len,
+				uint8_t s0[16])
+{
+	uint8_t a[CCM_BATCH * 16], s[CCM_BATCH * 16];
+	uint16_t ctr = 0;
+	bool first = true;
+	size_t i;
+
+	for (i = 0; i < CCM_BATCH; i++) {
+		a[i * 16] = 0x01;
+		memcpy(a + i * 16 + 1, nonce, 13);
+	}
+
+	while (first || len) {
+		size_t blocks = first + (len + 15) / 16;
+		size_t off = first ? 16 : 0;
+		size_t n;
+
+		if (blocks > CCM_BATCH)
+			blocks = CCM_BATCH;
+
+		for (i = 0; i < blocks; i++, ctr++) {
+			a[i * 16 + 14] = ctr >> 8;
+			a[i * 16 + 15] = ctr;
+		}
+
+		bt_aes_encrypt_blocks(aes, a, s, blocks);
+
+		if (first) {
+			memcpy(s0, s, 16);
+			first = false;
+		}
+
+		n = blocks * 16 - off;
+		if (n > len)
+			n = len;
+
+		for (i = 0; i < n; i++)
+			out[i] = in[i] ^ s[off + i];
+
+		in += n;
+		out += n;
+		len -= n;
+	}
+}
+
+bool mesh_aes_ccm_encrypt_aes(const struct bt_aes *aes,
+				const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const uint8_t *msg, uint16_t msg_len,
+				uint8_t *out, size_t mic_size)
+{
+	uint8_t x[16], s0[16];
+
+	if (mic_size < 4 || mic_size > 16 || mic_size & 1 ||
+					aad_len >= 0xff00)
+		return false;
+
+	ccm_mac(aes, nonce, aad, aad_len, msg, msg_len, mic_size, x);
+	ccm_ctr(aes, nonce, msg, out, msg_len, s0);
+
+	xor_block(x, s0, mic_size);
+	memcpy(out + msg_len, x, mic_size);
+
+	return true;
+}
+
+bool mesh_aes_ccm_encrypt(const uint8_t key[16], const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const uint8_t *msg, uint16_t msg_len,
+				uint8_t *out, size_t mic_size)
+{
+	struct bt_aes aes;
+
+	bt_aes_set_key(&aes, key);
+
+	return mesh_aes_ccm_encrypt_aes(&aes, nonce, aad, aad_len, msg,
+						msg_len, out, mic_size);
+}
+
+bool mesh_aes_ccm_decrypt(const uint8_t key[16], const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const uint8_t *enc, uint16_t enc_len,
+				uint8_t *out, size_t mic_size)
+{
+	struct bt_aes aes;
+	uint8_t x[16], s0[16], diff = 0;
+	uint16_t msg_len;
+	size_t i;
+
+	if (mic_size < 4 || mic_size > 16 || mic_size & 1 ||
+				aad_len >= 0xff00 || enc_len < mic_size)
+		return false;
+
+	msg_len = enc_len - mic_size;
+
+	bt_aes_set_key(&aes, key);
+
+	ccm_ctr(&aes, nonce, enc, out, msg_len, s0);
+	ccm_mac(&aes, nonce, aad, aad_len, out, msg_len, mic_size, x);
+
+
+	for (i = 0; i < mic_size; i++)
+		diff |= x[i] ^ s0[i] ^ enc[msg_len + i];
+
+	if (diff) {
+		memset(out, 0, msg_len);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+struct bt_aes;
+
+bool mesh_aes_ccm_encrypt_aes(const struct bt_aes *aes,
+				const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const uint8_t *msg, uint16_t msg_len,
+				uint8_t *out, size_t mic_size);
+bool mesh_aes_ccm_encrypt(const uint8_t key[16], const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const uint8_t *msg, uint16_t msg_len,
+				uint8_t *out, size_t mic_size);
+bool mesh_aes_ccm_decrypt(const uint8_t key[16], const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const uint8_t *enc, uint16_t enc_len,
+				uint8_t *out, size_t mic_size);
@@ -18,9 +18,12 @@
 #include <time.h>
 #include <ell/ell.h>
 
+#include "src/shared/aes.h"
+
 #include "mesh/mesh-defs.h"
 #include "mesh/net.h"
 #include "mesh/crypto.h"
+#include "mesh/aes.h"
 
 /* Multiply used Zero array */
 static const uint8_t zero[16] = { 0, };
@@ -28,17 +31,12 @@ static const uint8_t zero[16] = { 0, };
 static bool aes_ecb_one(const uint8_t key[16], const uint8_t in[16],
 								uint8_t out[16])
 {
-	void *cipher;
-	bool result = false;
-
-	cipher = l_cipher_new(L_CIPHER_AES, key, 16);
+	struct bt_aes aes;
 
-	if (cipher) {
-		result = l_cipher_encrypt(cipher, in, out, 16);
-		l_cipher_free(cipher);
-	}
+	bt_aes_set_key(&aes, key);
+	bt_aes_encrypt(&aes, in, out);
 
-	return result;
+	return true;
 }
 
 static bool aes_cmac(void *checksum, const uint8_t *msg,
@@ -87,17 +85,8 @@ bool mesh_crypto_aes_ccm_encrypt(const uint8_t nonce[13], const uint8_t key[16],
 					void *out_msg,
 					void *out_mic, size_t mic_size)
 {
-	void *cipher;
-	bool result;
-
-	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, key, 16, mic_size);
-
-	result = l_aead_cipher_encrypt(cipher, msg, msg_len, aad, aad_len,
-					nonce, 13, out_msg, msg_len + mic_size);
-
-	l_aead_cipher_free(cipher);
-
-	return result;
+	return mesh_aes_ccm_encrypt(key, nonce, aad, aad_len, msg, msg_len,
+							out_msg, mic_size);
 }
 
 bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
@@ -106,15 +95,10 @@ bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
 				void *out_msg,
 				void *out_mic, size_t mic_size)
 {
-	void *cipher;
 	bool result;
-	size_t out_msg_len = enc_msg_len - mic_size;
 
-	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, key, 16, mic_size);
-
-	result = l_aead_cipher_decrypt(cipher, enc_msg, enc_msg_len,
-							aad, aad_len, nonce, 13,
-							out_msg, out_msg_len);
+	result = mesh_aes_ccm_decrypt(key, nonce, aad, aad_len, enc_msg,
+					enc_msg_len, out_msg, mic_size);
 
 	if (result && out_mic) {
 		if (mic_size == 4)
@@ -125,8 +109,6 @@ bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
 				l_get_be64(enc_msg + enc_msg_len - mic_size);
 	}
 
-	l_aead_cipher_free(cipher);
-
 	return result;
 }
 
@@ -711,12 +693,12 @@ bool mesh_crypto_packet_parse(const uint8_t *packet, uint8_t packet_len,
 	return true;
 }
 
-bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
+bool mesh_crypto_payload_encrypt_aes(uint8_t *aad, const uint8_t *payload,
 				uint8_t *out, uint16_t payload_len,
 				uint16_t src, uint16_t dst, uint8_t key_aid,
 				uint32_t seq, uint32_t iv_index,
 				bool aszmic,
-				const uint8_t app_key[16])
+				const struct bt_aes *aes)
 {
 	uint8_t nonce[13];
 
@@ -730,14 +712,25 @@ bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
 		mesh_crypto_application_nonce(seq, src, dst, iv_index, aszmic,
 									nonce);
 
-	if (!mesh_crypto_aes_ccm_encrypt(nonce, app_key,
-							aad, aad ? 16 : 0,
-							payload, payload_len,
-							out, NULL,
-							aszmic ? 8 : 4))
-		return false;
+	return mesh_aes_ccm_encrypt_aes(aes, nonce, aad, aad ? 16 : 0,
+						payload, payload_len, out,
+						aszmic ? 8 : 4);
+}
 
-	return true;
+bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
+				uint8_t *out, uint16_t payload_len,
+				uint16_t src, uint16_t dst, uint8_t key_aid,
+				uint32_t seq, uint32_t iv_index,
+				bool aszmic,
+				const uint8_t app_key[16])
+{
+	struct bt_aes aes;
+
+	bt_aes_set_key(&aes, app_key);
+
+	return mesh_crypto_payload_encrypt_aes(aad, payload, out,
+						payload_len, src, dst, key_aid,
+						seq, iv_index, aszmic, &aes);
 }
 
 bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
@@ -1002,10 +995,9 @@ bool mesh_crypto_check_fcs(const uint8_t *packet, uint8_t packet_len,
 	return fcs == 0xcf;
 }
 
-/* This function performs a quick-check of ELL and Kernel AEAD encryption.
- * Some kernel versions before v4.9 have a known AEAD bug. If the system
- * running this test is using a v4.8 or earlier kernel, a failure here is
- * likely unless AEAD encryption has been backported.
+/* This function performs a quick-check of the AES-CCM implementation used
+ * for network and transport PDUs. CCM runs in process (see mesh/aes.c), so
+ * only the CMAC based key derivation still goes through ELL and the kernel.
  */
 static const uint8_t crypto_test_result[] = {
 	0x75, 0x03, 0x7e, 0xe2, 0x89, 0x81, 0xbe, 0x59,
@@ -1016,7 +1008,6 @@ static const uint8_t crypto_test_result[] = {
 
 bool mesh_crypto_check_avail(void)
 {
-	void *cipher;
 	bool result;
 	uint8_t i;
 	union {
@@ -1031,27 +1022,18 @@ bool mesh_crypto_check_avail(void)
 	} u;
 	uint8_t out_msg[sizeof(u.crypto.data) + sizeof(u.crypto.mic)];
 
-	l_debug("Testing Crypto");
+	l_debug("Testing Crypto (%s)", bt_aes_impl());
 	for (i = 0; i < sizeof(u); i++) {
 		u.bytes[i] = 0x60 + i;
 	}
 
-	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, u.crypto.key,
-				sizeof(u.crypto.key), sizeof(u.crypto.mic));
-
-	if (!cipher)
-		return false;
-
-	result = l_aead_cipher_encrypt(cipher,
-				u.crypto.data, sizeof(u.crypto.data),
+	result = mesh_aes_ccm_encrypt(u.crypto.key, u.crypto.nonce,
 				u.crypto.aad, sizeof(u.crypto.aad),
-				u.crypto.nonce, sizeof(u.crypto.nonce),
-				out_msg, sizeof(out_msg));
+				u.crypto.data, sizeof(u.crypto.data),
+				out_msg, sizeof(u.crypto.mic));
 
 	if (result)
 		result = !memcmp(out_msg, crypto_test_result, sizeof(out_msg));
 
-	l_aead_cipher_free(cipher);
-
 	return result;
 }
@@ -12,6 +12,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+struct bt_aes;
+
 bool mesh_crypto_aes_ccm_encrypt(const uint8_t nonce[13], const uint8_t key[16],
 					const uint8_t *aad, uint16_t aad_len,
 					const void *msg, uint16_t msg_len,
@@ -83,6 +85,12 @@ bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
 				uint32_t seq_num, uint32_t iv_index,
 				bool aszmic,
 				const uint8_t application_key[16]);
+bool mesh_crypto_payload_encrypt_aes(uint8_t *aad, const uint8_t *payload,
+				uint8_t *out, uint16_t payload_len,
+				uint16_t src, uint16_t dst, uint8_t key_aid,
+				uint32_t seq_num, uint32_t iv_index,
+				bool aszmic,
+				const struct bt_aes *aes);
 bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 				const uint8_t *payload, uint16_t payload_len,
 				bool szmict,
@@ -506,14 +506,16 @@ void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
 	if (frnd->u.active.seq != frnd->u.active.last &&
 						frnd->u.active.seq != seq) {
 		pkt = l_queue_peek_head(frnd->pkt_cache);
-		if (pkt->cnt_out < pkt->cnt_in) {
+		if (pkt->cnt_out < pkt->cnt_in)
 			pkt->cnt_out++;
-		} else {
-			pkt = l_queue_pop_head(frnd->pkt_cache);
-			l_free(pkt);
-		}
+		else
+			mesh_friend_queue_pop(frnd);
 	}
 
+	l_debug("Friend queue %4.4x: %u PDUs, %u bytes, %u dropped",
+				frnd->lp_addr, mesh_friend_queue_pdus(frnd),
+				frnd->pkt_bytes, frnd->pkt_dropped);
+
 	pkt = l_queue_peek_head(frnd->pkt_cache);
 
 	if (!pkt)
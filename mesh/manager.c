@@ -56,7 +56,7 @@ struct scan_req {
 };
 
 static struct l_queue *scans;
-static struct prov_remote_data *prov_pending;
+static struct l_queue *prov_pending;
 static const uint8_t prvb[2] = {MESH_AD_TYPE_BEACON, 0x00};
 
 static bool by_scan(const void *a, const void *b)
@@ -112,31 +112,46 @@ static void scan_cancel(struct l_timeout *timeout, void *user_data)
 	l_free(req);
 }
 
-static void free_pending_add_call(void)
+static bool match_pending(const void *a, const void *b)
 {
-	if (!prov_pending)
+	return a == b;
+}
+
+static bool pending_valid(struct prov_remote_data *pending)
+{
+	return l_queue_find(prov_pending, match_pending, pending);
+}
+
+static void free_pending_add_call(struct prov_remote_data *pending)
+{
+	if (!l_queue_remove(prov_pending, pending))
 		return;
 
-	if (prov_pending->disc_watch)
-		l_dbus_remove_watch(dbus_get_bus(),
-						prov_pending->disc_watch);
+	if (pending->disc_watch)
+		l_dbus_remove_watch(dbus_get_bus(), pending->disc_watch);
+
+	if (pending->msg)
+		l_dbus_message_unref(pending->msg);
 
-	if (prov_pending->msg)
-		l_dbus_message_unref(prov_pending->msg);
+	l_free(pending);
 
-	l_free(prov_pending);
-	prov_pending = NULL;
+	if (l_queue_isempty(prov_pending)) {
+		l_queue_destroy(prov_pending, NULL);
+		prov_pending = NULL;
+	}
 }
 
 static void prov_disc_cb(struct l_dbus *bus, void *user_data)
 {
-	if (!prov_pending)
+	struct prov_remote_data *pending = user_data;
+
+	if (!pending_valid(pending))
 		return;
 
-	initiator_cancel(prov_pending);
-	prov_pending->disc_watch = 0;
+	initiator_cancel(pending);
+	pending->disc_watch = 0;
 
-	free_pending_add_call();
+	free_pending_add_call(pending);
 }
 
 static void append_dict_entry_basic(struct l_dbus_message_builder *builder,
@@ -154,8 +169,9 @@ static void append_dict_entry_basic(struct l_dbus_message_builder *builder,
 	l_dbus_message_builder_leave_dict(builder);
 }
 
-static void send_add_failed(const char *owner, const char *path,
-							uint8_t status)
+static void send_add_failed(struct prov_remote_data *pending,
+				const char *owner, const char *path,
+				uint8_t status)
 {
 	struct l_dbus *dbus = dbus_get_bus();
 	struct l_dbus_message_builder *builder;
@@ -166,14 +182,14 @@ static void send_add_failed(const char *owner, const char *path,
 						"AddNodeFailed");
 
 	builder = l_dbus_message_builder_new(msg);
-	dbus_append_byte_array(builder, prov_pending->uuid, 16);
+	dbus_append_byte_array(builder, pending->uuid, 16);
 	l_dbus_message_builder_append_basic(builder, 's',
 						mesh_prov_status_str(status));
 	l_dbus_message_builder_finalize(builder);
 	l_dbus_message_builder_destroy(builder);
 	l_dbus_send(dbus, msg);
 
-	free_pending_add_call();
+	free_pending_add_call(pending);
 }
 
 static bool add_cmplt(void *user_data, uint8_t status,
@@ -186,12 +202,12 @@ static bool add_cmplt(void *user_data, uint8_t status,
 	struct l_dbus_message *msg;
 	bool result;
 
-	if (pending != prov_pending)
+	if (!pending_valid(pending))
 		return false;
 
 	if (status != PROV_ERR_SUCCESS) {
-		send_add_failed(node_get_owner(node), node_get_app_path(node),
-									status);
+		send_add_failed(pending, node_get_owner(node),
+					node_get_app_path(node), status);
 		return false;
 	}
 
@@ -204,8 +220,9 @@ static bool add_cmplt(void *user_data, uint8_t status,
 					info->num_ele, info->device_key);
 
 	if (!result) {
-		send_add_failed(node_get_owner(node), node_get_app_path(node),
-						PROV_ERR_CANT_ASSIGN_ADDR);
+		send_add_failed(pending, node_get_owner(node),
+					node_get_app_path(node),
+					PROV_ERR_CANT_ASSIGN_ADDR);
 		return false;
 	}
 
@@ -239,7 +256,7 @@ static bool add_cmplt(void *user_data, uint8_t status,
 
 	l_dbus_send(dbus, msg);
 
-	free_pending_add_call();
+	free_pending_add_call(pending);
 
 	return true;
 }
@@ -250,7 +267,7 @@ static void mgr_prov_data (struct l_dbus_message *reply, void *user_data)
 	uint16_t net_idx;
 	uint16_t primary;
 
-	if (pending != prov_pending)
+	if (!pending_valid(pending))
 		return;
 
 	if (l_dbus_message_is_error(reply))
@@ -280,7 +297,7 @@ static bool add_data_get(void *user_data, uint8_t num_ele)
 	const char *app_path;
 	const char *sender;
 
-	if (pending != prov_pending)
+	if (!pending_valid(pending))
 		return false;
 
 	dbus = dbus_get_bus();
@@ -312,20 +329,60 @@ static bool add_data_get(void *user_data, uint8_t num_ele)
 
 static void add_start(void *user_data, int err)
 {
+	struct prov_remote_data *pending = user_data;
 	struct l_dbus_message *reply;
 
 	l_debug("Start callback");
 
+	if (!pending_valid(pending) || !pending->msg)
+		return;
+
 	if (err == MESH_ERROR_NONE)
-		reply = l_dbus_message_new_method_return(prov_pending->msg);
+		reply = l_dbus_message_new_method_return(pending->msg);
 	else
-		reply = dbus_error(prov_pending->msg, MESH_ERROR_FAILED,
+		reply = dbus_error(pending->msg, MESH_ERROR_FAILED,
 				"Failed to start provisioning initiator");
 
 	l_dbus_send(dbus_get_bus(), reply);
-	l_dbus_message_unref(prov_pending->msg);
+	l_dbus_message_unref(pending->msg);
+
+	pending->msg = NULL;
 
-	prov_pending->msg = NULL;
+	if (err != MESH_ERROR_NONE)
+		free_pending_add_call(pending);
+}
+
+static struct l_dbus_message *start_pending(struct l_dbus *dbus,
+					struct l_dbus_message *msg,
+					struct prov_remote_data *pending,
+					uint16_t server, uint16_t subidx,
+					uint8_t *uuid, uint32_t sec)
+{
+	struct mesh_node *node = pending->node;
+
+	if (!prov_pending)
+		prov_pending = l_queue_new();
+
+	l_queue_push_tail(prov_pending, pending);
+	pending->msg = l_dbus_message_ref(msg);
+
+	if (!initiator_start(pending->transport, server, subidx, uuid, 99, sec,
+					pending->agent, add_start,
+					add_data_get, add_cmplt, node,
+					pending)) {
+		free_pending_add_call(pending);
+		return dbus_error(msg, MESH_ERROR_BUSY, NULL);
+	}
+
+	/* The start callback may already have failed the request */
+	if (!pending_valid(pending))
+		return NULL;
+
+	pending->disc_watch = l_dbus_add_disconnect_watch(dbus,
+						node_get_owner(node),
+						prov_disc_cb, pending, NULL);
+
+	return NULL;
 }
 
 static struct l_dbus_message *reprovision_call(struct l_dbus *dbus,
@@ -334,7 +391,7 @@ static struct l_dbus_message *reprovision_call(struct l_dbus *dbus,
 {
 	struct mesh_node *node = user_data;
 	struct l_dbus_message_iter options, var;
-	struct l_dbus_message *reply;
+	struct prov_remote_data *pending;
 	struct mesh_net *net = node_get_net(node);
 	const char *key;
 	uint16_t subidx;
@@ -378,34 +435,20 @@ static struct l_dbus_message *reprovision_call(struct l_dbus *dbus,
 	manager_scan_cancel(node);
 
 	/* Invoke Prov Initiator */
-	prov_pending = l_new(struct prov_remote_data, 1);
+	pending = l_new(struct prov_remote_data, 1);
 
-	prov_pending->transport = nppi;
-	prov_pending->node = node;
-	prov_pending->original = server;
-	prov_pending->agent = node_get_agent(node);
+	pending->transport = nppi;
+	pending->node = node;
+	pending->original = server;
+	pending->agent = node_get_agent(node);
 
-	if (!node_is_provisioner(node) || (prov_pending->agent == NULL)) {
-		reply = dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED,
+	if (!node_is_provisioner(node) || (pending->agent == NULL)) {
+		l_free(pending);
+		return dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED,
 							"Missing Interfaces");
-		goto fail;
 	}
 
-	prov_pending->msg = l_dbus_message_ref(msg);
-	initiator_start(prov_pending->transport, server, subidx, NULL, 99, 60,
-					prov_pending->agent, add_start,
-					add_data_get, add_cmplt, node,
-					prov_pending);
-
-	prov_pending->disc_watch = l_dbus_add_disconnect_watch(dbus,
-						node_get_owner(node),
-						prov_disc_cb, NULL, NULL);
-
-	return NULL;
-fail:
-	l_free(prov_pending);
-	prov_pending = NULL;
-	return reply;
+	return start_pending(dbus, msg, pending, server, subidx, NULL, 60);
 }
 
 static struct l_dbus_message *add_node_call(struct l_dbus *dbus,
@@ -414,7 +457,7 @@ static struct l_dbus_message *add_node_call(struct l_dbus *dbus,
 {
 	struct mesh_node *node = user_data;
 	struct l_dbus_message_iter iter_uuid, options, var;
-	struct l_dbus_message *reply;
+	struct prov_remote_data *pending;
 	struct mesh_net *net = node_get_net(node);
 	const char *key;
 	uint8_t *uuid;
@@ -467,48 +510,36 @@ static struct l_dbus_message *add_node_call(struct l_dbus *dbus,
 		return dbus_error(msg, MESH_ERROR_INVALID_ARGS,
 							"Invalid options");
 
-	/* If no server specified, use local */
-	if (!server)
-		server = node_get_primary(node);
+	/*
+	 * If no server specified, open PB-ADV directly rather than through
+	 * the local Remote Provisioning Server, which only has a single link
+	 * and would serialize concurrent AddNode requests.
+	 */
 
 	/* AddNode cancels all outstanding Scanning from node */
 	manager_scan_cancel(node);
 
 	/* Invoke Prov Initiator */
-	prov_pending = l_new(struct prov_remote_data, 1);
+	pending = l_new(struct prov_remote_data, 1);
 
 	if (n)
-		memcpy(prov_pending->uuid, uuid, 16);
+		memcpy(pending->uuid, uuid, 16);
 	else
 		uuid = NULL;
 
-	prov_pending->transport = PB_ADV;
-	prov_pending->node = node;
-	prov_pending->agent = node_get_agent(node);
+	pending->transport = PB_ADV;
+	pending->node = node;
+	pending->agent = node_get_agent(node);
 
-	if (!node_is_provisioner(node) || (prov_pending->agent == NULL)) {
+	if (!node_is_provisioner(node) || (pending->agent == NULL)) {
 		l_debug("Provisioner: %d", node_is_provisioner(node));
-		l_debug("Agent: %p", prov_pending->agent);
-		reply = dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED,
+		l_debug("Agent: %p", pending->agent);
+		l_free(pending);
+		return dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED,
 							"Missing Interfaces");
-		goto fail;
 	}
 
-	prov_pending->msg = l_dbus_message_ref(msg);
-	initiator_start(PB_ADV, server, subidx, uuid, 99, sec,
-					prov_pending->agent, add_start,
-					add_data_get, add_cmplt, node,
-					prov_pending);
-
-	prov_pending->disc_watch = l_dbus_add_disconnect_watch(dbus,
-						node_get_owner(node),
-						prov_disc_cb, NULL, NULL);
-
-	return NULL;
-fail:
-	l_free(prov_pending);
-	prov_pending = NULL;
-	return reply;
+	return start_pending(dbus, msg, pending, server, subidx, uuid, sec);
 }
 
 
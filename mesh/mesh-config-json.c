@@ -40,9 +40,14 @@
 
 #define CHECK_KEY_IDX_RANGE(x) ((x) <= 4095)
 
+/* Journal records kept before the whole configuration is rewritten */
+#define JOURNAL_MAX	256
+
 struct mesh_config {
 	json_object *jnode;
 	char *node_dir_path;
+	char *journal_path;
+	unsigned int journal_len;
 	uint8_t uuid[16];
 	uint32_t write_seq;
 	struct timeval write_time;
@@ -58,6 +63,7 @@ struct write_info {
 static const char *cfgnode_name = "/node.json";
 static const char *bak_ext = ".bak";
 static const char *tmp_ext = ".tmp";
+static const char *journal_name = "/node.journal";
 
 /* JSON key words */
 static const char *unicastAddress = "unicastAddress";
@@ -65,6 +71,9 @@ static const char *deviceCan = "deviceCan";
 static const char *deviceKey = "deviceKey";
 static const char *defaultTTL = "defaultTTL";
 static const char *sequenceNumber = "sequenceNumber";
+
+/* Top level values that are saved incrementally */
+static const char **journal_keys[] = { &sequenceNumber, &defaultTTL };
 static const char *netKeys = "netKeys";
 static const char *appKeys = "appKeys";
 static const char *elements = "elements";
@@ -110,6 +119,14 @@ static bool save_config(json_object *jnode, const char *fname)
 	return result;
 }
 
+static char *get_journal_path(const char *fname)
+{
+	const char *sep = strrchr(fname, '/');
+
+	return l_strdup_printf("%.*s%s", sep ? (int) (sep - fname) : 0, fname,
+								journal_name);
+}
+
 static bool get_int(json_object *jobj, const char *keyword, int *value)
 {
 	json_object *jvalue;
@@ -1846,6 +1863,7 @@ static struct mesh_config *create_config(const char *cfg_path,
 	cfg->jnode = jnode;
 	memcpy(cfg->uuid, uuid, 16);
 	cfg->node_dir_path = l_strdup(cfg_path);
+	cfg->journal_path = get_journal_path(cfg_path);
 	cfg->write_seq = node->seq_number;
 	cfg->idles = l_queue_new();
 	gettimeofday(&cfg->write_time, NULL);
@@ -2346,6 +2364,66 @@ bool mesh_config_model_sub_enable(struct mesh_config *cfg, uint16_t ele_addr,
 	return save_config(cfg->jnode, cfg->node_dir_path);
 }
 
+static unsigned int apply_journal(json_object *jnode, const char *fname)
+{
+	unsigned int count = 0;
+	char key[32];
+	FILE *infile;
+	size_t i;
+	int val;
+
+	infile = fopen(fname, "r");
+	if (!infile)
+		return 0;
+
+	/* Later records override earlier ones */
+	while (fscanf(infile, "%31s %d\n", key, &val) == 2) {
+		for (i = 0; i < L_ARRAY_SIZE(journal_keys); i++) {
+			if (!strcmp(key, *journal_keys[i]))
+				write_int(jnode, *journal_keys[i], val);
+		}
+
+		count++;
+	}
+
+	fclose(infile);
+
+	return count;
+}
+
+/*
+ * Append a top level value to the journal instead of rewriting the whole
+ * configuration. The journal is removed after the next full save.
+ */
+static bool write_journal(struct mesh_config *cfg, const char *desc, int val)
+{
+	char line[64];
+	int fd, len;
+	bool result;
+
+	if (!write_int(cfg->jnode, desc, val))
+		return false;
+
+	if (cfg->journal_len++ >= JOURNAL_MAX) {
+		cfg->journal_len = 0;
+		return mesh_config_save(cfg, false, NULL, NULL);
+	}
+
+	len = snprintf(line, sizeof(line), "%s %d\n", desc, val);
+
+	fd = open(cfg->journal_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+	if (fd < 0)
+		return mesh_config_save(cfg, false, NULL, NULL);
+
+	result = write(fd, line, len) == len;
+	close(fd);
+
+	if (!result)
+		return mesh_config_save(cfg, false, NULL, NULL);
+
+	return true;
+}
+
 bool mesh_config_write_seq_number(struct mesh_config *cfg, uint32_t seq,
 								bool cache)
 {
@@ -2355,12 +2433,8 @@ bool mesh_config_write_seq_number(struct mesh_config *cfg, uint32_t seq,
 	if (!cfg)
 		return false;
 
-	if (!cache) {
-		if (!write_int(cfg->jnode, sequenceNumber, seq))
-			return false;
-
-		return mesh_config_save(cfg, true, NULL, NULL);
-	}
+	if (!cache)
+		return write_journal(cfg, sequenceNumber, seq);
 
 	/* If resetting seq to Zero, make sure cached value reset as well */
 	if (seq && get_int(cfg->jnode, sequenceNumber, &value))
@@ -2413,10 +2487,9 @@ bool mesh_config_write_seq_number(struct mesh_config *cfg, uint32_t seq,
 
 		l_debug("Seq Cache: %d -> %d", seq, cached);
 
-		if (!write_int(cfg->jnode, sequenceNumber, cached))
-			return false;
+		gettimeofday(&cfg->write_time, NULL);
 
-		return mesh_config_save(cfg, false, NULL, NULL);
+		return write_journal(cfg, sequenceNumber, cached);
 	}
 
 	return true;
@@ -2424,10 +2497,10 @@ bool mesh_config_write_seq_number(struct mesh_config *cfg, uint32_t seq,
 
 bool mesh_config_write_ttl(struct mesh_config *cfg, uint8_t ttl)
 {
-	if (!cfg || !write_int(cfg->jnode, defaultTTL, ttl))
+	if (!cfg)
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return write_journal(cfg, defaultTTL, ttl);
 }
 
 bool mesh_config_update_company_id(struct mesh_config *cfg, uint16_t cid)
@@ -2472,6 +2545,8 @@ static bool load_node(const char *fname, const uint8_t uuid[16],
 	bool result = false;
 	json_object *jnode;
 	struct mesh_config_node node;
+	unsigned int journal_len;
+	char *journal;
 
 	if (!cb) {
 		l_info("Node read callback is required");
@@ -2505,6 +2580,9 @@ static bool load_node(const char *fname, const uint8_t uuid[16],
 	if (!jnode)
 		goto done;
 
+	journal = get_journal_path(fname);
+	journal_len = apply_journal(jnode, journal);
+
 	memset(&node, 0, sizeof(node));
 
 	node.elements = l_queue_new();
@@ -2520,6 +2598,8 @@ static bool load_node(const char *fname, const uint8_t uuid[16],
 		cfg->jnode = jnode;
 		memcpy(cfg->uuid, uuid, 16);
 		cfg->node_dir_path = l_strdup(fname);
+		cfg->journal_path = journal;
+		cfg->journal_len = journal_len;
 		cfg->write_seq = node.seq_number;
 		cfg->idles = l_queue_new();
 		gettimeofday(&cfg->write_time, NULL);
@@ -2529,9 +2609,11 @@ static bool load_node(const char *fname, const uint8_t uuid[16],
 		if (!result) {
 			l_free(cfg->idles);
 			l_free(cfg->node_dir_path);
+			l_free(cfg->journal_path);
 			l_free(cfg);
 		}
-	}
+	} else
+		l_free(journal);
 
 	/* Done with the node: free resources */
 	l_free(node.net_transmit);
@@ -2566,6 +2648,7 @@ void mesh_config_release(struct mesh_config *cfg)
 	l_queue_destroy(cfg->idles, release_idle);
 
 	l_free(cfg->node_dir_path);
+	l_free(cfg->journal_path);
 	json_object_put(cfg->jnode);
 	l_free(cfg);
 }
@@ -2591,6 +2674,12 @@ static void idle_save_config(struct l_idle *idle, void *user_data)
 			result = false;
 	}
 
+	/* Everything journaled so far is part of the saved configuration */
+	if (result) {
+		remove(info->cfg->journal_path);
+		info->cfg->journal_len = 0;
+	}
+
 	remove(fname_tmp);
 
 	l_free(fname_tmp);
@@ -23,6 +23,9 @@ typedef bool (*mesh_io_deregister_t)(struct mesh_io *io, const uint8_t *filter,
 								uint8_t len);
 typedef bool (*mesh_io_tx_cancel_t)(struct mesh_io *io, const uint8_t *pattern,
 								uint8_t len);
+typedef bool (*mesh_io_tx_stats_t)(struct mesh_io *io,
+					enum mesh_io_priority priority,
+					struct mesh_io_tx_stats *stats);
 
 struct mesh_io_api {
 	mesh_io_init_t		init;
@@ -32,6 +35,7 @@ struct mesh_io_api {
 	mesh_io_register_t	reg;
 	mesh_io_deregister_t	dereg;
 	mesh_io_tx_cancel_t	cancel;
+	mesh_io_tx_stats_t	tx_stats;
 };
 
 struct mesh_io_reg {
@@ -36,9 +36,11 @@ struct mesh_io_private {
 	struct mesh_io *io;
 	void *user_data;
 	struct l_timeout *tx_timeout;
-	struct l_timeout *dup_timeout;
-	struct l_queue *dup_filters;
-	struct l_queue *tx_pkts;
+	struct dup_table *dup_cur;
+	struct dup_table *dup_prev;
+	uint32_t dup_start;
+	struct l_queue *tx_pkts[MESH_IO_PRIORITY_MAX];
+	struct mesh_io_tx_stats tx_stats[MESH_IO_PRIORITY_MAX];
 	struct tx_pkt *tx;
 	unsigned int tx_id;
 	unsigned int rx_id;
@@ -58,7 +60,10 @@ struct process_data {
 
 struct tx_pkt {
 	struct mesh_io_send_info	info;
+	uint32_t			queued;
+	uint32_t			deadline;
 	bool				delete;
+	bool				sent;
 	uint8_t				len;
 	uint8_t				pkt[30];
 };
@@ -69,15 +74,36 @@ struct tx_pattern {
 };
 
 #define DUP_FILTER_TIME        1000
+#define DUP_TABLE_MIN          64
 /* Accept one instance of unique message a second */
 struct dup_filter {
 	uint64_t data;
 	uint32_t instant;
 	uint8_t addr[6];
+	uint8_t used;
 } __packed;
 
+/*
+ * Filters live in two generations of DUP_FILTER_TIME each. Lookups check
+ * the current generation, then the previous one. Rotating drops the whole
+ * previous generation at once, so no per entry expiry is needed.
+ */
+struct dup_table {
+	struct dup_filter *entries;
+	unsigned int size;
+	unsigned int count;
+};
+
 static const uint8_t zero_addr[] = {0, 0, 0, 0, 0, 0};
 
+/* Longest time (ms) each priority class waits behind higher classes */
+static const uint16_t tx_budget[MESH_IO_PRIORITY_MAX] = {
+	[MESH_IO_PRIORITY_CONTROL - 1] = 30,
+	[MESH_IO_PRIORITY_ACCESS - 1] = 100,
+	[MESH_IO_PRIORITY_RELAY - 1] = 250,
+	[MESH_IO_PRIORITY_BEACON - 1] = 1000,
+};
+
 static struct mesh_io_private *pvt;
 
 static uint32_t get_instant(void)
@@ -99,94 +125,170 @@ static uint32_t instant_remaining_ms(uint32_t instant)
 	return instant;
 }
 
-static bool find_by_addr(const void *a, const void *b)
+static uint32_t dup_hash(const uint8_t *addr, uint64_t data)
 {
-	const struct dup_filter *filter = a;
+	uint32_t hash = 2166136261u;
+	unsigned int i;
+
+	for (i = 0; i < 6; i++)
+		hash = (hash ^ addr[i]) * 16777619u;
 
-	return !memcmp(filter->addr, b, 6);
+	hash = (hash ^ (uint32_t) data) * 16777619u;
+	hash = (hash ^ (uint32_t) (data >> 32)) * 16777619u;
+
+	return hash;
 }
 
-static bool find_by_adv(const void *a, const void *b)
+/*
+ * Advertisers are keyed by address alone. Entries without an address,
+ * the Provisioning PDUs we sent ourselves, are keyed by their data.
+ */
+static struct dup_filter *dup_slot(struct dup_table *table,
+					const uint8_t *addr, uint64_t data)
 {
-	const struct dup_filter *filter = a;
-	uint64_t data = l_get_be64(b);
+	bool by_data = !memcmp(addr, zero_addr, 6);
+	unsigned int mask = table->size - 1;
+	unsigned int i;
+
+	if (!by_data)
+		data = 0;
+
+	i = dup_hash(addr, data) & mask;
+
+	while (table->entries[i].used) {
+		struct dup_filter *filter = &table->entries[i];
+
+		if (!memcmp(filter->addr, addr, 6) &&
+					(!by_data || filter->data == data))
+			return filter;
 
-	return !memcmp(filter->addr, zero_addr, 6) && filter->data == data;
+		i = (i + 1) & mask;
+	}
+
+	return &table->entries[i];
 }
 
-static void filter_timeout(struct l_timeout *timeout, void *user_data)
+static struct dup_filter *dup_find(struct dup_table *table,
+					const uint8_t *addr, uint64_t data)
 {
 	struct dup_filter *filter;
-	uint32_t instant, delta;
 
-	if (!pvt)
-		goto done;
+	if (!table->count)
+		return NULL;
 
-	instant = get_instant();
+	filter = dup_slot(table, addr, data);
 
-	filter = l_queue_peek_tail(pvt->dup_filters);
-	while (filter) {
-		delta = instant - filter->instant;
-		if (delta >= DUP_FILTER_TIME) {
-			l_queue_remove(pvt->dup_filters, filter);
-			l_free(filter);
-		} else {
-			l_timeout_modify(timeout, 1);
-			return;
-		}
+	return filter->used ? filter : NULL;
+}
+
+static void dup_grow(struct dup_table *table)
+{
+	struct dup_filter *old = table->entries;
+	unsigned int old_size = table->size;
+	unsigned int i;
+
+	if ((table->count + 1) * 4 <= table->size * 3)
+		return;
+
+	table->size = old_size ? old_size * 2 : DUP_TABLE_MIN;
+	table->entries = l_new(struct dup_filter, table->size);
 
-		filter = l_queue_peek_tail(pvt->dup_filters);
+	for (i = 0; i < old_size; i++) {
+		if (old[i].used)
+			*dup_slot(table, old[i].addr, old[i].data) = old[i];
 	}
 
-done:
-	l_timeout_remove(timeout);
-	pvt->dup_timeout = NULL;
+	l_free(old);
+}
+
+static void dup_clear(struct dup_table *table)
+{
+	if (table->entries)
+		memset(table->entries, 0,
+				table->size * sizeof(struct dup_filter));
+
+	table->count = 0;
+}
+
+static void dup_free(struct dup_table *table)
+{
+	if (!table)
+		return;
+
+	l_free(table->entries);
+	l_free(table);
+}
+
+static void dup_rotate(uint32_t instant)
+{
+	uint32_t delta = instant - pvt->dup_start;
+	struct dup_table *table;
+
+	if (delta < DUP_FILTER_TIME)
+		return;
+
+	table = pvt->dup_prev;
+	dup_clear(table);
+	pvt->dup_prev = pvt->dup_cur;
+	pvt->dup_cur = table;
+
+	if (delta >= 2 * DUP_FILTER_TIME)
+		dup_clear(pvt->dup_prev);
+
+	pvt->dup_start = instant;
 }
 
 /* Ignore consequtive duplicate advertisements within timeout period */
 static bool filter_dups(const uint8_t *addr, const uint8_t *adv,
 							uint32_t instant)
 {
-	struct dup_filter *filter;
-	uint32_t instant_delta;
+	struct dup_filter *filter, *slot;
 	uint64_t data = l_get_be64(adv);
+	const uint8_t *key = addr;
+	bool dup;
 
 	if (!addr)
-		addr = zero_addr;
+		addr = key = zero_addr;
 
-	if (adv[1] == MESH_AD_TYPE_PROVISION) {
-		filter = l_queue_find(pvt->dup_filters, find_by_adv, adv);
+	dup_rotate(instant);
+	dup_grow(pvt->dup_cur);
 
-		if (!filter && addr != zero_addr)
-			return false;
+	/* Provisioning PDUs are only checked against our own */
+	if (adv[1] == MESH_AD_TYPE_PROVISION)
+		key = zero_addr;
 
-		l_queue_remove(pvt->dup_filters, filter);
+	filter = dup_find(pvt->dup_cur, key, data);
+	if (!filter)
+		filter = dup_find(pvt->dup_prev, key, data);
 
-	} else {
-		filter = l_queue_remove_if(pvt->dup_filters, find_by_addr,
-									addr);
-	}
+	if (filter && instant - filter->instant >= DUP_FILTER_TIME &&
+							key != addr)
+		filter = NULL;
 
-	if (!filter) {
-		filter = l_new(struct dup_filter, 1);
-		memcpy(filter->addr, addr, 6);
-	}
+	if (!filter && key != addr)
+		return false;
 
-	/* Start filter expiration timer */
-	if (!l_queue_length(pvt->dup_filters))
-		pvt->dup_timeout = l_timeout_create(1, filter_timeout, NULL,
-									NULL);
+	dup = filter && instant - filter->instant < DUP_FILTER_TIME &&
+							filter->data == data;
 
-	l_queue_push_head(pvt->dup_filters, filter);
-	instant_delta = instant - filter->instant;
+	slot = dup_slot(pvt->dup_cur, key, data);
 
-	if (instant_delta >= DUP_FILTER_TIME || data != filter->data) {
-		filter->instant = instant;
-		filter->data = data;
-		return false;
+	if (!slot->used) {
+		if (filter)
+			*slot = *filter;
+		else
+			memcpy(slot->addr, key, 6);
+
+		slot->used = 1;
+		pvt->dup_cur->count++;
 	}
 
-	return true;
+	if (!dup) {
+		slot->instant = instant;
+		slot->data = data;
+	}
+
+	return dup;
 }
 
 static void process_rx_callbacks(void *v_reg, void *v_rx)
@@ -294,6 +396,77 @@ static bool find_by_pattern(const void *a, const void *b)
 	return (!memcmp(tx->pkt, pattern->data, pattern->len));
 }
 
+static struct l_queue *tx_queue(struct mesh_io_private *pvt,
+							struct tx_pkt *tx)
+{
+	return pvt->tx_pkts[tx->info.priority - 1];
+}
+
+static bool tx_empty(struct mesh_io_private *pvt)
+{
+	unsigned int i;
+
+	for (i = 0; i < MESH_IO_PRIORITY_MAX; i++)
+		if (!l_queue_isempty(pvt->tx_pkts[i]))
+			return false;
+
+	return true;
+}
+
+static enum mesh_io_priority tx_classify(const struct mesh_io_send_info *info,
+							const uint8_t *data)
+{
+	if (info->priority != MESH_IO_PRIORITY_AUTO &&
+				info->priority <= MESH_IO_PRIORITY_MAX)
+		return info->priority;
+
+	if (info->type != MESH_IO_TIMING_TYPE_GENERAL)
+		return MESH_IO_PRIORITY_CONTROL;
+
+	if (data[0] == MESH_AD_TYPE_BEACON)
+		return MESH_IO_PRIORITY_BEACON;
+
+	return MESH_IO_PRIORITY_ACCESS;
+}
+
+/*
+ * Classes are served in strict priority order, except that the head of a
+ * lower class which has waited past its deadline goes first. Among several
+ * late packets the earliest deadline wins.
+ */
+static struct tx_pkt *tx_next(struct mesh_io_private *pvt, bool remove)
+{
+	struct tx_pkt *next = NULL;
+	uint32_t now = get_instant();
+	unsigned int i, q = 0;
+	bool late = false;
+
+	for (i = 0; i < MESH_IO_PRIORITY_MAX; i++) {
+		struct tx_pkt *tx = l_queue_peek_head(pvt->tx_pkts[i]);
+
+		if (!tx)
+			continue;
+
+		if ((int32_t) (now - tx->deadline) > 0) {
+			if (!late || (int32_t) (tx->deadline -
+							next->deadline) < 0) {
+				next = tx;
+				q = i;
+			}
+
+			late = true;
+		} else if (!next) {
+			next = tx;
+			q = i;
+		}
+	}
+
+	if (next && remove)
+		l_queue_pop_head(pvt->tx_pkts[q]);
+
+	return next;
+}
+
 static bool find_active(const void *a, const void *b)
 {
 	const struct mesh_io_reg *rx_reg = a;
@@ -428,6 +601,7 @@ static void read_info_cb(uint8_t status, uint16_t length,
 static bool dev_init(struct mesh_io *io, void *opts, void *user_data)
 {
 	uint16_t index = *(int *)opts;
+	unsigned int i;
 
 	if (!io || pvt)
 		return false;
@@ -439,8 +613,12 @@ static bool dev_init(struct mesh_io *io, void *opts, void *user_data)
 	mesh_mgmt_send(MGMT_OP_READ_INFO, index, 0, NULL,
 				read_info_cb, L_UINT_TO_PTR(index), NULL);
 
-	pvt->dup_filters = l_queue_new();
-	pvt->tx_pkts = l_queue_new();
+	pvt->dup_cur = l_new(struct dup_table, 1);
+	pvt->dup_prev = l_new(struct dup_table, 1);
+	pvt->dup_start = get_instant();
+
+	for (i = 0; i < MESH_IO_PRIORITY_MAX; i++)
+		pvt->tx_pkts[i] = l_queue_new();
 
 	pvt->io = io;
 	io->pvt = pvt;
@@ -451,6 +629,7 @@ static bool dev_init(struct mesh_io *io, void *opts, void *user_data)
 static bool dev_destroy(struct mesh_io *io)
 {
 	unsigned char param[] = { 0x00 };
+	unsigned int i;
 
 	if (io->pvt != pvt)
 		return true;
@@ -461,9 +640,12 @@ static bool dev_destroy(struct mesh_io *io)
 	mesh_mgmt_unregister(pvt->rx_id);
 	mesh_mgmt_unregister(pvt->tx_id);
 	l_timeout_remove(pvt->tx_timeout);
-	l_timeout_remove(pvt->dup_timeout);
-	l_queue_destroy(pvt->dup_filters, l_free);
-	l_queue_destroy(pvt->tx_pkts, l_free);
+	dup_free(pvt->dup_cur);
+	dup_free(pvt->dup_prev);
+
+	for (i = 0; i < MESH_IO_PRIORITY_MAX; i++)
+		l_queue_destroy(pvt->tx_pkts[i], l_free);
+
 	io->pvt = NULL;
 	l_free(pvt);
 	pvt = NULL;
@@ -512,7 +694,7 @@ static void send_queued(uint8_t status, uint16_t length,
 		pvt->handle = *(uint8_t *) param;
 
 	if (tx->delete) {
-		l_queue_remove_if(pvt->tx_pkts, simple_match, tx);
+		l_queue_remove_if(tx_queue(pvt, tx), simple_match, tx);
 		l_free(tx);
 		pvt->tx = NULL;
 	}
@@ -554,14 +736,16 @@ static void send_pkt(struct mesh_io_private *pvt, struct tx_pkt *tx,
 static void tx_to(struct l_timeout *timeout, void *user_data)
 {
 	struct mesh_io_private *pvt = user_data;
+	struct mesh_io_tx_stats *stats;
 	struct tx_pkt *tx;
+	uint32_t now;
 	uint16_t ms;
 	uint8_t count;
 
 	if (!pvt)
 		return;
 
-	tx = l_queue_pop_head(pvt->tx_pkts);
+	tx = tx_next(pvt, true);
 	if (!tx) {
 		l_timeout_remove(timeout);
 		pvt->tx_timeout = NULL;
@@ -582,18 +766,38 @@ static void tx_to(struct l_timeout *timeout, void *user_data)
 
 	tx->delete = !!(count == 1);
 
+	now = get_instant();
+	stats = &pvt->tx_stats[tx->info.priority - 1];
+	stats->sent++;
+
+	if (!tx->sent) {
+		uint32_t wait = now - tx->queued;
+
+		if ((int32_t) (now - tx->deadline) > 0)
+			stats->late++;
+
+		if (wait > stats->max_wait)
+			stats->max_wait = wait;
+
+		stats->total_wait += wait;
+		stats->serviced++;
+		tx->sent = true;
+	}
+
 	send_pkt(pvt, tx, ms);
 
 	if (count == 1) {
 		/* Recalculate wakeup if we are responding to POLL */
-		tx = l_queue_peek_head(pvt->tx_pkts);
+		tx = tx_next(pvt, false);
 
 		if (tx && tx->info.type == MESH_IO_TIMING_TYPE_POLL_RSP) {
 			ms = instant_remaining_ms(tx->info.u.poll_rsp.instant +
 						tx->info.u.poll_rsp.delay);
 		}
-	} else
-		l_queue_push_tail(pvt->tx_pkts, tx);
+	} else {
+		tx->deadline = now + ms + tx_budget[tx->info.priority - 1];
+		l_queue_push_tail(tx_queue(pvt, tx), tx);
+	}
 
 	if (timeout) {
 		pvt->tx_timeout = timeout;
@@ -608,7 +812,7 @@ static void tx_worker(void *user_data)
 	struct tx_pkt *tx;
 	uint32_t delay;
 
-	tx = l_queue_peek_head(pvt->tx_pkts);
+	tx = tx_next(pvt, false);
 	if (!tx)
 		return;
 
@@ -669,16 +873,21 @@ static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
 	memcpy(&tx->info, info, sizeof(tx->info));
 	memcpy(&tx->pkt, data, len);
 	tx->len = len;
+	tx->info.priority = tx_classify(info, data);
+	tx->queued = get_instant();
+	tx->deadline = tx->queued + tx_budget[tx->info.priority - 1];
+
+	pvt->tx_stats[tx->info.priority - 1].queued++;
 
 	if (info->type == MESH_IO_TIMING_TYPE_POLL_RSP)
-		l_queue_push_head(pvt->tx_pkts, tx);
+		l_queue_push_head(tx_queue(pvt, tx), tx);
 	else {
 		if (pvt->tx)
 			sending = true;
 		else
-			sending = !l_queue_isempty(pvt->tx_pkts);
+			sending = !tx_empty(pvt);
 
-		l_queue_push_tail(pvt->tx_pkts, tx);
+		l_queue_push_tail(tx_queue(pvt, tx), tx);
 	}
 
 	if (!sending) {
@@ -693,30 +902,31 @@ static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
 static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 {
 	struct mesh_io_private *pvt = io->pvt;
+	struct tx_pattern pattern = {
+		.data = data,
+		.len = len
+	};
 	struct tx_pkt *tx;
+	unsigned int i;
 
 	if (!data)
 		return false;
 
-	if (len == 1) {
+	for (i = 0; i < MESH_IO_PRIORITY_MAX; i++) {
 		do {
-			tx = l_queue_remove_if(pvt->tx_pkts, find_by_ad_type,
+			if (len == 1)
+				tx = l_queue_remove_if(pvt->tx_pkts[i],
+							find_by_ad_type,
 							L_UINT_TO_PTR(data[0]));
-			l_free(tx);
+			else
+				tx = l_queue_remove_if(pvt->tx_pkts[i],
+							find_by_pattern,
+							&pattern);
 
-			if (tx == pvt->tx)
-				pvt->tx = NULL;
+			if (!tx)
+				break;
 
-		} while (tx);
-	} else {
-		struct tx_pattern pattern = {
-			.data = data,
-			.len = len
-		};
-
-		do {
-			tx = l_queue_remove_if(pvt->tx_pkts, find_by_pattern,
-								&pattern);
+			pvt->tx_stats[i].cancelled++;
 			l_free(tx);
 
 			if (tx == pvt->tx)
@@ -725,7 +935,7 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		} while (tx);
 	}
 
-	if (l_queue_isempty(pvt->tx_pkts)) {
+	if (tx_empty(pvt)) {
 		send_cancel(pvt);
 		l_timeout_remove(pvt->tx_timeout);
 		pvt->tx_timeout = NULL;
@@ -734,6 +944,20 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 	return true;
 }
 
+static bool tx_stats(struct mesh_io *io, enum mesh_io_priority priority,
+					struct mesh_io_tx_stats *stats)
+{
+	struct mesh_io_private *pvt = io->pvt;
+
+	if (!pvt)
+		return false;
+
+	*stats = pvt->tx_stats[priority - 1];
+	stats->pending = l_queue_length(pvt->tx_pkts[priority - 1]);
+
+	return true;
+}
+
 static bool recv_register(struct mesh_io *io, const uint8_t *filter,
 			uint8_t len, mesh_io_recv_func_t cb, void *user_data)
 {
@@ -782,4 +1006,5 @@ const struct mesh_io_api mesh_io_mgmt = {
 	.reg = recv_register,
 	.dereg = recv_deregister,
 	.cancel = tx_cancel,
+	.tx_stats = tx_stats,
 };
@@ -203,6 +203,25 @@ bool mesh_io_get_caps(struct mesh_io *io, struct mesh_io_caps *caps)
 	return false;
 }
 
+bool mesh_io_get_tx_stats(struct mesh_io *io, enum mesh_io_priority priority,
+					struct mesh_io_tx_stats *stats)
+{
+	if (!io)
+		io = default_io;
+
+	if (io != default_io || !stats)
+		return false;
+
+	if (priority == MESH_IO_PRIORITY_AUTO ||
+					priority > MESH_IO_PRIORITY_MAX)
+		return false;
+
+	if (io && io->api && io->api->tx_stats)
+		return io->api->tx_stats(io, priority, stats);
+
+	return false;
+}
+
 bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
 				uint8_t len, mesh_io_recv_func_t cb,
 				void *user_data)
@@ -18,6 +18,17 @@ enum mesh_io_type {
 	MESH_IO_TYPE_GENERIC,
 };
 
+/* Transmit classes, highest priority first. AUTO classifies by AD type */
+enum mesh_io_priority {
+	MESH_IO_PRIORITY_AUTO = 0,
+	MESH_IO_PRIORITY_CONTROL,
+	MESH_IO_PRIORITY_ACCESS,
+	MESH_IO_PRIORITY_RELAY,
+	MESH_IO_PRIORITY_BEACON,
+};
+
+#define MESH_IO_PRIORITY_MAX	MESH_IO_PRIORITY_BEACON
+
 enum mesh_io_timing_type {
 	MESH_IO_TIMING_TYPE_GENERAL = 1,
 	MESH_IO_TIMING_TYPE_POLL,
@@ -55,6 +66,18 @@ struct mesh_io_send_info {
 		} poll_rsp;
 
 	} u;
+	enum mesh_io_priority priority;
+};
+
+struct mesh_io_tx_stats {
+	uint32_t queued;
+	uint32_t sent;
+	uint32_t cancelled;
+	uint32_t late;
+	uint32_t serviced;
+	uint32_t pending;
+	uint32_t max_wait;
+	uint64_t total_wait;
 };
 
 struct mesh_io_caps {
@@ -78,6 +101,8 @@ struct mesh_io *mesh_io_new(enum mesh_io_type type, void *opts,
 void mesh_io_destroy(struct mesh_io *io);
 
 bool mesh_io_get_caps(struct mesh_io *io, struct mesh_io_caps *caps);
+bool mesh_io_get_tx_stats(struct mesh_io *io, enum mesh_io_priority priority,
+					struct mesh_io_tx_stats *stats);
 
 bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
 					uint8_t len, mesh_io_recv_func_t cb,
@@ -890,6 +890,64 @@ static struct l_dbus_message *import_call(struct l_dbus *dbus,
 	return NULL;
 }
 
+static const char *const tx_priority_names[] = {
+	[MESH_IO_PRIORITY_CONTROL] = "Control",
+	[MESH_IO_PRIORITY_ACCESS] = "Access",
+	[MESH_IO_PRIORITY_RELAY] = "Relay",
+	[MESH_IO_PRIORITY_BEACON] = "Beacon",
+};
+
+static struct l_dbus_message *tx_stats_call(struct l_dbus *dbus,
+						struct l_dbus_message *msg,
+						void *user_data)
+{
+	struct l_dbus_message *reply;
+	struct l_dbus_message_builder *builder;
+	unsigned int prio;
+
+	reply = l_dbus_message_new_method_return(msg);
+	builder = l_dbus_message_builder_new(reply);
+
+	l_dbus_message_builder_enter_array(builder, "{sa{sv}}");
+
+	for (prio = MESH_IO_PRIORITY_CONTROL; prio <= MESH_IO_PRIORITY_MAX;
+								prio++) {
+		struct mesh_io_tx_stats stats;
+		uint32_t avg_wait = 0;
+
+		if (!mesh_io_get_tx_stats(mesh.io, prio, &stats))
+			continue;
+
+		if (stats.serviced)
+			avg_wait = stats.total_wait / stats.serviced;
+
+		l_dbus_message_builder_enter_dict(builder, "sa{sv}");
+		l_dbus_message_builder_append_basic(builder, 's',
+						tx_priority_names[prio]);
+		l_dbus_message_builder_enter_array(builder, "{sv}");
+		dbus_append_dict_entry_basic(builder, "Queued", "u",
+								&stats.queued);
+		dbus_append_dict_entry_basic(builder, "Sent", "u", &stats.sent);
+		dbus_append_dict_entry_basic(builder, "Cancelled", "u",
+							&stats.cancelled);
+		dbus_append_dict_entry_basic(builder, "Late", "u", &stats.late);
+		dbus_append_dict_entry_basic(builder, "Pending", "u",
+							&stats.pending);
+		dbus_append_dict_entry_basic(builder, "MaxWait", "u",
+							&stats.max_wait);
+		dbus_append_dict_entry_basic(builder, "AverageWait", "u",
+								&avg_wait);
+		l_dbus_message_builder_leave_array(builder);
+		l_dbus_message_builder_leave_dict(builder);
+	}
+
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_finalize(builder);
+	l_dbus_message_builder_destroy(builder);
+
+	return reply;
+}
+
 static void setup_network_interface(struct l_dbus_interface *iface)
 {
 	l_dbus_interface_method(iface, "Join", 0, join_network_call, "",
@@ -913,6 +971,10 @@ static void setup_network_interface(struct l_dbus_interface *iface)
 					"app", "uuid", "dev_key", "net_key",
 					"net_index", "flags", "iv_index",
 					"unicast");
+
+	l_dbus_interface_method(iface, "GetTransmitStatistics", 0,
+					tx_stats_call, "a{sa{sv}}", "",
+					"statistics");
 }
 
 bool mesh_dbus_init(struct l_dbus *dbus)
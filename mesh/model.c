@@ -16,6 +16,8 @@
 #include <time.h>
 #include <ell/ell.h>
 
+#include "src/shared/aes.h"
+
 #include "mesh/mesh-defs.h"
 
 #include "mesh/mesh.h"
@@ -39,6 +41,23 @@
 
 #define VIRTUAL_BASE			0x10000
 
+/* Periodic publications are spread by up to this much random delay */
+#define PUB_JITTER_MS			20
+
+/* Publications due within this window are encrypted and sent together */
+#define PUB_COALESCE_MS			10
+
+struct mesh_model_pub_stats {
+	uint32_t queued;
+	uint32_t sent;
+	uint32_t failed;
+	uint32_t coalesced;
+	uint32_t max_delay;
+	uint64_t total_delay;
+	uint64_t first_sent;
+	uint64_t last_sent;
+};
+
 struct mesh_model {
 	const struct mesh_model_ops *cbs;
 	void *user_data;
@@ -46,11 +65,34 @@ struct mesh_model {
 	struct l_queue *subs;
 	struct l_queue *virtuals;
 	struct mesh_model_pub *pub;
+	struct l_queue *pub_msgs;
+	struct mesh_model_pub_stats pub_stats;
 	bool sub_enabled;
 	bool pub_enabled;
 	uint32_t id;
 };
 
+struct pub_msg {
+	struct mesh_node *node;
+	struct mesh_model *mod;
+	uint64_t queued;
+	uint64_t due;
+	uint32_t order;
+	uint16_t src;
+	uint16_t dst;
+	uint16_t app_idx;
+	uint16_t net_idx;
+	uint16_t interval;
+	uint8_t ttl;
+	uint8_t cnt;
+	uint8_t label[16];
+	bool virt;
+	bool cred;
+	bool segmented;
+	uint16_t len;
+	uint8_t data[];
+};
+
 struct mesh_virtual {
 	uint16_t ref_cnt;
 	uint16_t addr; /* 16-bit virtual address, used in messages */
@@ -74,6 +116,8 @@ struct mod_forward {
 };
 
 static struct l_queue *mesh_virtuals;
+static struct l_queue *pub_models;
+static struct l_timeout *pub_timer;
 
 static bool is_internal(uint32_t id)
 {
@@ -519,17 +563,40 @@ static int virt_packet_decrypt(struct mesh_net *net, const uint8_t *data,
 	return -1;
 }
 
-static bool msg_send(struct mesh_node *node, bool cred, uint16_t src,
-			uint16_t dst, uint16_t app_idx, uint16_t net_idx,
+static const uint8_t *msg_key(struct mesh_node *node, uint16_t app_idx,
+					uint16_t dst, uint8_t dev_key[16],
+					uint8_t *key_aid)
+{
+	const uint8_t *key;
+
+	*key_aid = APP_AID_DEV;
+
+	if (app_idx == APP_IDX_DEV_LOCAL)
+		return node_get_device_key(node);
+
+	if (app_idx == APP_IDX_DEV_REMOTE) {
+		if (!keyring_get_remote_dev_key(node, dst, dev_key))
+			return NULL;
+
+		return dev_key;
+	}
+
+	key = appkey_get_key(node_get_net(node), app_idx, key_aid);
+	if (!key)
+		l_debug("no app key for (%x)", app_idx);
+
+	return key;
+}
+
+static bool msg_send_aes(struct mesh_node *node, bool cred, uint16_t src,
+			uint16_t dst, uint8_t key_aid,
+			const struct bt_aes *aes, uint16_t net_idx,
 			uint8_t *label, uint8_t ttl, uint8_t cnt,
 			uint16_t interval, bool segmented, const void *msg,
 			uint16_t msg_len)
 {
-	uint8_t dev_key[16];
 	uint32_t iv_index, seq_num;
-	const uint8_t *key;
 	uint8_t *out;
-	uint8_t key_aid = APP_AID_DEV;
 	bool szmic = false;
 	bool ret = false;
 	uint16_t out_len = msg_len + sizeof(uint32_t);
@@ -543,31 +610,15 @@ static bool msg_send(struct mesh_node *node, bool cred, uint16_t src,
 		}
 	}
 
-	if (app_idx == APP_IDX_DEV_LOCAL) {
-		key = node_get_device_key(node);
-		if (!key)
-			return false;
-	} else if (app_idx == APP_IDX_DEV_REMOTE) {
-		if (!keyring_get_remote_dev_key(node, dst, dev_key))
-			return false;
-
-		key = dev_key;
-	} else {
-		key = appkey_get_key(node_get_net(node), app_idx, &key_aid);
-		if (!key) {
-			l_debug("no app key for (%x)", app_idx);
-			return false;
-		}
-	}
-
 	out = l_malloc(out_len);
 
 	iv_index = mesh_net_get_iv_index(net);
 
 	seq_num = mesh_net_next_seq_num(net);
 
-	if (!mesh_crypto_payload_encrypt(label, msg, out, msg_len, src, dst,
-				key_aid, seq_num, iv_index, szmic, key)) {
+	if (!mesh_crypto_payload_encrypt_aes(label, msg, out, msg_len, src,
+					dst, key_aid, seq_num, iv_index,
+					szmic, aes)) {
 		l_error("Failed to Encrypt Payload");
 		goto done;
 	}
@@ -580,9 +631,251 @@ done:
 	return ret;
 }
 
+static bool msg_send(struct mesh_node *node, bool cred, uint16_t src,
+			uint16_t dst, uint16_t app_idx, uint16_t net_idx,
+			uint8_t *label, uint8_t ttl, uint8_t cnt,
+			uint16_t interval, bool segmented, const void *msg,
+			uint16_t msg_len)
+{
+	uint8_t dev_key[16];
+	const uint8_t *key;
+	uint8_t key_aid;
+	struct bt_aes aes;
+
+	key = msg_key(node, app_idx, dst, dev_key, &key_aid);
+	if (!key)
+		return false;
+
+	bt_aes_set_key(&aes, key);
+
+	return msg_send_aes(node, cred, src, dst, key_aid, &aes, net_idx,
+					label, ttl, cnt, interval, segmented,
+					msg, msg_len);
+}
+
+static uint64_t pub_now_ms(void)
+{
+	return l_time_now() / 1000;
+}
+
+static int compare_pub_msg(const void *a, const void *b, void *user_data)
+{
+	const struct pub_msg *msg_a = a;
+	const struct pub_msg *msg_b = b;
+
+	/* Group by key so that one key schedule serves the whole run */
+	if (msg_a->node != msg_b->node)
+		return msg_a->node < msg_b->node ? -1 : 1;
+
+	if (msg_a->app_idx != msg_b->app_idx)
+		return msg_a->app_idx < msg_b->app_idx ? -1 : 1;
+
+	if (msg_a->order != msg_b->order)
+		return msg_a->order < msg_b->order ? -1 : 1;
+
+	return 0;
+}
+
+static void pub_msg_send(struct pub_msg *msg, bool coalesced,
+				struct bt_aes *aes, uint8_t aes_key[16],
+				bool *have_key, uint64_t now)
+{
+	struct mesh_model_pub_stats *stats = &msg->mod->pub_stats;
+	uint8_t dev_key[16];
+	const uint8_t *key;
+	uint8_t key_aid;
+	uint32_t delay;
+
+	key = msg_key(msg->node, msg->app_idx, msg->dst, dev_key, &key_aid);
+	if (!key)
+		goto failed;
+
+	if (!*have_key || memcmp(aes_key, key, 16)) {
+		bt_aes_set_key(aes, key);
+		memcpy(aes_key, key, 16);
+		*have_key = true;
+	}
+
+	if (!msg_send_aes(msg->node, msg->cred, msg->src, msg->dst, key_aid,
+				aes, msg->net_idx,
+				msg->virt ? msg->label : NULL, msg->ttl,
+				msg->cnt, msg->interval, msg->segmented,
+				msg->data, msg->len))
+		goto failed;
+
+	delay = now > msg->queued ? now - msg->queued : 0;
+
+	stats->sent++;
+	stats->total_delay += delay;
+
+	if (delay > stats->max_delay)
+		stats->max_delay = delay;
+
+	if (coalesced)
+		stats->coalesced++;
+
+	if (!stats->first_sent)
+		stats->first_sent = now;
+
+	stats->last_sent = now;
+	return;
+
+failed:
+	l_error("Failed to publish (model %8.8x)", msg->mod->id);
+	stats->failed++;
+}
+
+static void pub_schedule(void);
+
+static void pub_timeout(struct l_timeout *timeout, void *user_data)
+{
+	const struct l_queue_entry *entry;
+	struct l_queue *batch = l_queue_new();
+	struct pub_msg *msg;
+	struct bt_aes aes;
+	uint8_t aes_key[16];
+	bool have_key = false;
+	bool coalesced;
+	uint64_t now = pub_now_ms();
+
+	/* Collect everything due now or within the coalescing window */
+	for (entry = l_queue_get_entries(pub_models); entry;
+							entry = entry->next) {
+		struct mesh_model *mod = entry->data;
+
+		while ((msg = l_queue_peek_head(mod->pub_msgs)) &&
+					msg->due <= now + PUB_COALESCE_MS) {
+			l_queue_pop_head(mod->pub_msgs);
+			l_queue_insert(batch, msg, compare_pub_msg, NULL);
+		}
+	}
+
+	coalesced = l_queue_length(batch) > 1;
+
+	while ((msg = l_queue_pop_head(batch))) {
+		pub_msg_send(msg, coalesced, &aes, aes_key, &have_key, now);
+		l_free(msg);
+	}
+
+	l_queue_destroy(batch, NULL);
+	pub_schedule();
+}
+
+static bool pub_idle(void *data, void *user_data)
+{
+	struct mesh_model *mod = data;
+
+	return l_queue_isempty(mod->pub_msgs);
+}
+
+static void pub_schedule(void)
+{
+	const struct l_queue_entry *entry;
+	uint64_t due = UINT64_MAX;
+	uint64_t now;
+	unsigned int ms;
+
+	l_queue_foreach_remove(pub_models, pub_idle, NULL);
+
+	for (entry = l_queue_get_entries(pub_models); entry;
+							entry = entry->next) {
+		struct mesh_model *mod = entry->data;
+		struct pub_msg *msg = l_queue_peek_head(mod->pub_msgs);
+
+		if (msg->due < due)
+			due = msg->due;
+	}
+
+	if (due == UINT64_MAX) {
+		l_timeout_remove(pub_timer);
+		pub_timer = NULL;
+		return;
+	}
+
+	now = pub_now_ms();
+	ms = due > now ? due - now : 1;
+
+	if (pub_timer)
+		l_timeout_modify_ms(pub_timer, ms);
+	else
+		pub_timer = l_timeout_create_ms(ms, pub_timeout, NULL, NULL);
+}
+
+static void pub_cancel(struct mesh_model *mod)
+{
+	if (!mod->pub_msgs)
+		return;
+
+	l_queue_destroy(mod->pub_msgs, l_free);
+	mod->pub_msgs = NULL;
+	l_queue_remove(pub_models, mod);
+	pub_schedule();
+}
+
+static void pub_queue(struct mesh_node *node, struct mesh_model *mod,
+				uint16_t src, uint16_t net_idx, bool segmented,
+				const void *data, uint16_t len)
+{
+	static uint32_t order;
+	struct mesh_model_pub *pub = mod->pub;
+	struct pub_msg *msg, *last;
+	uint64_t now = pub_now_ms();
+
+	msg = l_malloc(sizeof(*msg) + len);
+	memset(msg, 0, sizeof(*msg));
+	msg->node = node;
+	msg->mod = mod;
+	msg->queued = now;
+	msg->due = now;
+	msg->order = order++;
+	msg->src = src;
+	msg->dst = pub->addr;
+	msg->app_idx = pub->idx;
+	msg->net_idx = net_idx;
+	msg->ttl = pub->ttl;
+	msg->cnt = pub->rtx.cnt;
+	msg->interval = pub->rtx.interval;
+	msg->cred = pub->credential != 0;
+	msg->segmented = segmented;
+	msg->len = len;
+	memcpy(msg->data, data, len);
+
+	if (pub->virt) {
+		memcpy(msg->label, pub->virt->label, 16);
+		msg->virt = true;
+	}
+
+	/*
+	 * Periodic publications of many models tend to fire together, so
+	 * spread them out. Publications of one model stay in order.
+	 */
+	if (pub->period)
+		msg->due += l_getrandom_uint32() % (PUB_JITTER_MS + 1);
+
+	if (!mod->pub_msgs)
+		mod->pub_msgs = l_queue_new();
+
+	last = l_queue_peek_tail(mod->pub_msgs);
+	if (last && last->due > msg->due)
+		msg->due = last->due;
+
+	l_queue_push_tail(mod->pub_msgs, msg);
+	mod->pub_stats.queued++;
+
+	if (!pub_models)
+		pub_models = l_queue_new();
+
+	if (!l_queue_find(pub_models, simple_match, mod))
+		l_queue_push_tail(pub_models, mod);
+
+	pub_schedule();
+}
+
 static void remove_pub(struct mesh_node *node, uint16_t ele_idx,
 							struct mesh_model *mod)
 {
+	pub_cancel(mod);
+
 	if (mod->pub) {
 		if (mod->pub->virt)
 			unref_virt(mod->pub->virt);
@@ -1007,12 +1300,12 @@ int mesh_model_publish(struct mesh_node *node, uint32_t id, uint16_t src,
 {
 	struct mesh_net *net = node_get_net(node);
 	struct mesh_model *mod;
-	uint8_t *label = NULL;
+	uint8_t dev_key[16];
+	uint8_t key_aid;
 	uint16_t net_idx;
-	bool result;
 	int ele_idx;
 
-	if (!net || msg_len > 380)
+	if (!net || !msg_len || msg_len > 380)
 		return MESH_ERROR_INVALID_ARGS;
 
 	/* If SRC is 0, use the Primary Element */
@@ -1035,17 +1328,15 @@ int mesh_model_publish(struct mesh_node *node, uint32_t id, uint16_t src,
 	if (IS_UNASSIGNED(mod->pub->addr))
 		return MESH_ERROR_DOES_NOT_EXIST;
 
-	if (mod->pub->virt)
-		label = mod->pub->virt->label;
+	if (!msg_key(node, mod->pub->idx, mod->pub->addr, dev_key, &key_aid))
+		return MESH_ERROR_FAILED;
 
 	net_idx = appkey_net_idx(net, mod->pub->idx);
 
-	result = msg_send(node, mod->pub->credential != 0, src, mod->pub->addr,
-				mod->pub->idx, net_idx, label, mod->pub->ttl,
-				mod->pub->rtx.cnt, mod->pub->rtx.interval,
-				segmented, msg, msg_len);
+	/* Encryption and sending is deferred to the publication scheduler */
+	pub_queue(node, mod, src, net_idx, segmented, msg, msg_len);
 
-	return result ? MESH_ERROR_NONE : MESH_ERROR_FAILED;
+	return MESH_ERROR_NONE;
 }
 
 bool mesh_model_send(struct mesh_node *node, uint16_t src, uint16_t dst,
@@ -1164,6 +1455,7 @@ void mesh_model_free(void *data)
 {
 	struct mesh_model *mod = data;
 
+	pub_cancel(mod);
 	l_queue_destroy(mod->bindings, NULL);
 	l_queue_destroy(mod->subs, NULL);
 	l_queue_destroy(mod->virtuals, unref_virt);
@@ -1982,6 +2274,51 @@ done:
 	return n;
 }
 
+void mesh_model_build_pub_stats(void *model, void *msg_builder)
+{
+	struct l_dbus_message_builder *builder = msg_builder;
+	struct mesh_model *mod = model;
+	struct mesh_model_pub_stats *stats = &mod->pub_stats;
+	uint32_t avg_delay = 0, rate = 0;
+	uint16_t id;
+
+	if (is_internal(mod->id) || !stats->queued)
+		return;
+
+	if (stats->sent)
+		avg_delay = stats->total_delay / stats->sent;
+
+	/* Publications per minute over the span of sent publications */
+	if (stats->sent > 1 && stats->last_sent > stats->first_sent)
+		rate = (uint64_t) (stats->sent - 1) * 60000 /
+				(stats->last_sent - stats->first_sent);
+
+	l_dbus_message_builder_enter_struct(builder, "qa{sv}");
+
+	id = MODEL_ID(mod->id);
+	l_dbus_message_builder_append_basic(builder, 'q', &id);
+
+	l_dbus_message_builder_enter_array(builder, "{sv}");
+
+	if (IS_VENDOR(mod->id)) {
+		uint16_t vendor = VENDOR_ID(mod->id);
+		dbus_append_dict_entry_basic(builder, "Vendor", "q", &vendor);
+	}
+
+	dbus_append_dict_entry_basic(builder, "Queued", "u", &stats->queued);
+	dbus_append_dict_entry_basic(builder, "Sent", "u", &stats->sent);
+	dbus_append_dict_entry_basic(builder, "Failed", "u", &stats->failed);
+	dbus_append_dict_entry_basic(builder, "Coalesced", "u",
+							&stats->coalesced);
+	dbus_append_dict_entry_basic(builder, "MaxDelay", "u",
+							&stats->max_delay);
+	dbus_append_dict_entry_basic(builder, "AverageDelay", "u", &avg_delay);
+	dbus_append_dict_entry_basic(builder, "Rate", "u", &rate);
+
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_leave_struct(builder);
+}
+
 void mesh_model_init(void)
 {
 	mesh_virtuals = l_queue_new();
@@ -1989,6 +2326,11 @@ void mesh_model_init(void)
 
 void mesh_model_cleanup(void)
 {
+	l_timeout_remove(pub_timer);
+	pub_timer = NULL;
+	l_queue_destroy(pub_models, NULL);
+	pub_models = NULL;
+
 	l_queue_destroy(mesh_virtuals, l_free);
 	mesh_virtuals = NULL;
 }
@@ -117,6 +117,7 @@ uint16_t mesh_model_opcode_set(uint32_t opcode, uint8_t *buf);
 bool mesh_model_opcode_get(const uint8_t *buf, uint16_t size, uint32_t *opcode,
 								uint16_t *n);
 void mesh_model_build_config(void *model, void *msg_builder);
+void mesh_model_build_pub_stats(void *model, void *msg_builder);
 void mesh_model_update_opts(struct mesh_node *node, uint8_t ele_idx,
 				struct l_queue *curr, struct l_queue *updated);
 uint16_t mesh_model_generate_composition(struct l_queue *mods, uint16_t buf_sz,
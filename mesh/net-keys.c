@@ -29,6 +29,11 @@
 /* This allows daemon to skip decryption on recently seen beacons */
 #define BEACON_CACHE_MAX	10
 
+/* Recently decrypted network PDUs, so relays seen again are not decrypted */
+#define NET_CACHE_MAX		8
+
+#define NID_MAX			0x80
+
 struct beacon_rx {
 	uint8_t data[28];
 	uint32_t id;
@@ -69,17 +74,57 @@ struct net_key {
 	bool ivu;
 };
 
+struct net_pkt_cache {
+	uint8_t pkt[29];
+	uint8_t plain[29];
+	size_t len;
+	size_t plainlen;
+	uint32_t id;
+	uint32_t iv_index;
+};
+
 static struct l_queue *beacons;
 static struct l_queue *keys;
 static uint32_t last_flooding_id;
 
+/* Keys by NID, so only candidate keys are tried on a received PDU */
+static struct l_queue *nid_keys[NID_MAX];
+
 /* To avoid re-decrypting same packet for multiple nodes, cache and check */
-static uint8_t cache_pkt[29];
-static uint8_t cache_plain[29];
-static size_t cache_len;
-static size_t cache_plainlen;
-static uint32_t cache_id;
-static uint32_t cache_iv_index;
+static struct net_pkt_cache pkt_cache[NET_CACHE_MAX];
+static unsigned int pkt_cache_next;
+
+static void nid_add(struct net_key *key)
+{
+	if (!nid_keys[key->nid])
+		nid_keys[key->nid] = l_queue_new();
+
+	/* Friend credentials are tried first, same as in the key list */
+	if (key->friend_key)
+		l_queue_push_head(nid_keys[key->nid], key);
+	else
+		l_queue_push_tail(nid_keys[key->nid], key);
+}
+
+static void nid_remove(struct net_key *key)
+{
+	l_queue_remove(nid_keys[key->nid], key);
+
+	if (l_queue_isempty(nid_keys[key->nid])) {
+		l_queue_destroy(nid_keys[key->nid], NULL);
+		nid_keys[key->nid] = NULL;
+	}
+}
+
+static void pkt_cache_flush(uint32_t id)
+{
+	unsigned int i;
+
+	for (i = 0; i < NET_CACHE_MAX; i++) {
+		if (pkt_cache[i].id == id)
+			pkt_cache[i].id = 0;
+	}
+}
 
 static bool match_flooding(const void *a, const void *b)
 {
@@ -145,6 +190,7 @@ uint32_t net_key_add(const uint8_t flooding[16])
 
 	key->id = ++last_flooding_id;
 	l_queue_push_tail(keys, key);
+	nid_add(key);
 	return key->id;
 
 fail:
@@ -183,6 +229,7 @@ uint32_t net_key_frnd_add(uint32_t flooding_id, uint16_t lpn, uint16_t frnd,
 	frnd_key->ref_cnt++;
 	frnd_key->id = ++last_flooding_id;
 	l_queue_push_head(keys, frnd_key);
+	nid_add(frnd_key);
 
 	return frnd_key->id;
 }
@@ -195,6 +242,8 @@ void net_key_unref(uint32_t id)
 		if (--key->ref_cnt == 0) {
 			l_timeout_remove(key->observe.timeout);
 			l_queue_remove(keys, key);
+			nid_remove(key);
+			pkt_cache_flush(key->id);
 			l_free(key);
 		}
 	}
@@ -222,54 +271,70 @@ bool net_key_retrieve(uint32_t id, uint8_t *flooding)
 	return false;
 }
 
-static void decrypt_net_pkt(void *a, void *b)
+uint32_t net_key_decrypt(uint32_t iv_index, const uint8_t *pkt, size_t len,
+					uint8_t **plain, size_t *plain_len)
 {
-	const struct net_key *key = a;
-	bool result;
+	const struct l_queue_entry *entry;
+	struct net_pkt_cache *cache;
+	unsigned int i;
 
-	if (cache_id || !key->ref_cnt || (cache_pkt[0] & 0x7f) != key->nid)
-		return;
+	if (!len || len > sizeof(cache->pkt))
+		return 0;
 
-	result = mesh_crypto_packet_decode(cache_pkt, cache_len, false,
-						cache_plain, cache_iv_index,
-						key->enc_key, key->prv_key);
+	/* If we already successfully decrypted this packet, use cached data */
+	for (i = 0; i < NET_CACHE_MAX; i++) {
+		cache = &pkt_cache[i];
 
-	if (result) {
-		cache_id = key->id;
-		if (cache_plain[1] & 0x80)
-			cache_plainlen = cache_len - 8;
-		else
-			cache_plainlen = cache_len - 4;
-	}
-}
+		if (!cache->id || cache->len != len ||
+						memcmp(pkt, cache->pkt, len))
+			continue;
 
-uint32_t net_key_decrypt(uint32_t iv_index, const uint8_t *pkt, size_t len,
-					uint8_t **plain, size_t *plain_len)
-{
-	/* If we already successfully decrypted this packet, use cached data */
-	if (cache_id && cache_len == len && !memcmp(pkt, cache_pkt, len)) {
 		/* IV Index must match what was used to decrypt */
-		if (cache_iv_index != iv_index)
+		if (cache->iv_index != iv_index)
 			return 0;
 
 		goto done;
 	}
 
-	cache_id = 0;
-	memcpy(cache_pkt, pkt, len);
-	cache_len = len;
-	cache_iv_index = iv_index;
+	cache = &pkt_cache[pkt_cache_next];
+	cache->id = 0;
+	memcpy(cache->pkt, pkt, len);
+	cache->len = len;
+	cache->iv_index = iv_index;
 
-	/* Try all network keys known to us */
-	l_queue_foreach(keys, decrypt_net_pkt, NULL);
+	/* Try the network keys known to us with a matching NID */
+	entry = l_queue_get_entries(nid_keys[pkt[0] & 0x7f]);
 
-done:
-	if (cache_id) {
-		*plain = cache_plain;
-		*plain_len = cache_plainlen;
+	for (; entry; entry = entry->next) {
+		const struct net_key *key = entry->data;
+
+		if (!key->ref_cnt)
+			continue;
+
+		if (!mesh_crypto_packet_decode(cache->pkt, cache->len, false,
+						cache->plain, cache->iv_index,
+						key->enc_key, key->prv_key))
+			continue;
+
+		cache->id = key->id;
+		if (cache->plain[1] & 0x80)
+			cache->plainlen = cache->len - 8;
+		else
+			cache->plainlen = cache->len - 4;
+
+		break;
 	}
 
-	return cache_id;
+	if (!cache->id)
+		return 0;
+
+	pkt_cache_next = (pkt_cache_next + 1) % NET_CACHE_MAX;
+
+done:
+	*plain = cache->plain;
+	*plain_len = cache->plainlen;
+
+	return cache->id;
 }
 
 bool net_key_encrypt(uint32_t id, uint32_t iv_index, uint8_t *pkt, size_t len)
@@ -793,6 +858,16 @@ static void free_key(void *data)
 
 void net_key_cleanup(void)
 {
+	unsigned int i;
+
+	for (i = 0; i < NID_MAX; i++) {
+		l_queue_destroy(nid_keys[i], NULL);
+		nid_keys[i] = NULL;
+	}
+
+	memset(pkt_cache, 0, sizeof(pkt_cache));
+	pkt_cache_next = 0;
+
 	l_queue_destroy(keys, free_key);
 	keys = NULL;
 	l_queue_destroy(beacons, l_free);
@@ -32,6 +32,8 @@
 #include "mesh/appkey.h"
 #include "mesh/rpl.h"
 
+#include "src/shared/trace.h"
+
 #define abs_diff(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
 
 #define IV_IDX_DIFF_RANGE	42
@@ -49,6 +51,15 @@
 #define MSG_TO	60
 #define SAR_DEL	10
 
+/* MshPRFv1.0.1 3.5.3.3 and 3.5.3.4, capped by the legacy fixed timer */
+#define SAR_TTL_MS(base, ttl)	((base) + 50 * (ttl) < SEG_TO * 1000 ? \
+					(base) + 50 * (ttl) : SEG_TO * 1000)
+#define SAR_ACK_TO_MS(ttl)	SAR_TTL_MS(150, ttl)
+#define SAR_SEG_TO_MS(ttl)	SAR_TTL_MS(200, ttl)
+#define SAR_RTO_MAX_MS		10000
+#define SAR_BACKOFF_MAX		4
+#define SAR_RTT_ENTRIES		16
+
 #define DEFAULT_TRANSMIT_COUNT		1
 #define DEFAULT_TRANSMIT_INTERVAL	100
 
@@ -56,6 +67,14 @@
 
 #define FAST_CACHE_SIZE 8
 
+/* Open addressed, at most half full for MSG_CACHE_SIZE entries */
+#define MSG_CACHE_BITS	8
+#define MSG_CACHE_SLOTS	(1 << MSG_CACHE_BITS)
+
+#define REPLAY_CACHE_MIN	64
+
+#define HASH_MULT	0x9e3779b1u
+
 enum _relay_advice {
 	RELAY_NONE,		/* Relay not enabled in node */
 	RELAY_ALLOWED,		/* Relay enabled, msg not to node's unicast */
@@ -135,11 +154,12 @@ struct mesh_net {
 	uint16_t features;
 
 	struct l_queue *subnets;
-	struct l_queue *msg_cache;
-	struct l_queue *replay_cache;
+	struct msg_cache *msg_cache;
+	struct replay_cache *replay_cache;
 	struct l_queue *sar_in;
 	struct l_queue *sar_out;
 	struct l_queue *sar_queue;
+	struct l_queue *sar_rtt;
 	struct l_queue *frnd_msgs;
 	struct l_queue *friends;
 	struct l_queue *negotiations;
@@ -152,10 +172,26 @@ struct mesh_msg {
 	uint32_t mic;
 };
 
+/* Most recent messages in a ring, indexed by a linear probing table */
+struct msg_cache {
+	struct mesh_msg msgs[MSG_CACHE_SIZE];
+	uint8_t slots[MSG_CACHE_SLOTS];
+	unsigned int next;
+	unsigned int count;
+};
+
+/* Replay protection list, open addressed by source (0 marks a free slot) */
+struct replay_cache {
+	struct mesh_rpl *entries;
+	unsigned int size;
+	unsigned int count;
+};
+
 struct mesh_sar {
 	unsigned int id;
 	struct l_timeout *seg_timeout;
 	struct l_timeout *msg_timeout;
+	uint64_t tx_time;
 	uint32_t flags;
 	uint32_t last_nak;
 	uint32_t iv_index;
@@ -171,12 +207,21 @@ struct mesh_sar {
 	bool frnd;
 	bool frnd_cred;
 	bool delete;
+	bool rtx;
+	uint8_t backoff;
 	uint8_t ttl;
 	uint8_t last_seg;
 	uint8_t key_aid;
 	uint8_t buf[4]; /* Large enough for ACK-Flags and MIC */
 };
 
+/* Smoothed segment round trip time to a destination, in milliseconds */
+struct sar_rtt {
+	uint16_t dst;
+	uint32_t srtt;
+	uint32_t rttvar;
+};
+
 struct mesh_destination {
 	uint16_t dst;
 	uint16_t ref_cnt;
@@ -208,6 +253,7 @@ struct net_queue_data {
 
 struct oneshot_tx {
 	struct mesh_net *net;
+	enum mesh_io_priority priority;
 	uint16_t interval;
 	uint8_t cnt;
 	uint8_t size;
@@ -223,7 +269,13 @@ struct net_beacon_data {
 	bool local;
 };
 
-static struct l_queue *fast_cache;
+/* Hashes of the last few received network PDUs, shared by all networks */
+static struct {
+	uint64_t hash[FAST_CACHE_SIZE];
+	unsigned int len;
+	unsigned int next;
+} fast_cache;
+
 static struct l_queue *nets;
 
 static void net_rx(void *net_ptr, void *user_data);
@@ -314,6 +366,8 @@ static void free_friend_internals(struct mesh_friend *frnd)
 	if (frnd->pkt_cache)
 		l_queue_destroy(frnd->pkt_cache, l_free);
 
+	frnd->pkt_bytes = 0;
+
 	l_free(frnd->u.active.grp_list);
 	frnd->u.active.grp_list = NULL;
 	frnd->pkt_cache = NULL;
@@ -643,21 +697,19 @@ struct mesh_net *mesh_net_new(struct mesh_node *node)
 	net->tx_interval = DEFAULT_TRANSMIT_INTERVAL;
 
 	net->subnets = l_queue_new();
-	net->msg_cache = l_queue_new();
+	net->msg_cache = l_new(struct msg_cache, 1);
 	net->sar_in = l_queue_new();
 	net->sar_out = l_queue_new();
 	net->sar_queue = l_queue_new();
+	net->sar_rtt = l_queue_new();
 	net->frnd_msgs = l_queue_new();
 	net->destinations = l_queue_new();
 	net->app_keys = l_queue_new();
-	net->replay_cache = l_queue_new();
+	net->replay_cache = l_new(struct replay_cache, 1);
 
 	if (!nets)
 		nets = l_queue_new();
 
-	if (!fast_cache)
-		fast_cache = l_queue_new();
-
 	return net;
 }
 
@@ -669,11 +721,14 @@ void mesh_net_free(void *user_data)
 		return;
 
 	l_queue_destroy(net->subnets, subnet_free);
-	l_queue_destroy(net->msg_cache, l_free);
-	l_queue_destroy(net->replay_cache, l_free);
+	l_free(net->msg_cache);
+	if (net->replay_cache)
+		l_free(net->replay_cache->entries);
+	l_free(net->replay_cache);
 	l_queue_destroy(net->sar_in, mesh_sar_free);
 	l_queue_destroy(net->sar_out, mesh_sar_free);
 	l_queue_destroy(net->sar_queue, mesh_sar_free);
+	l_queue_destroy(net->sar_rtt, l_free);
 	l_queue_destroy(net->frnd_msgs, l_free);
 	l_queue_destroy(net->friends, mesh_friend_free);
 	l_queue_destroy(net->negotiations, mesh_friend_free);
@@ -685,8 +740,7 @@ void mesh_net_free(void *user_data)
 
 void mesh_net_cleanup(void)
 {
-	l_queue_destroy(fast_cache, l_free);
-	fast_cache = NULL;
+	memset(&fast_cache, 0, sizeof(fast_cache));
 	l_queue_destroy(nets, mesh_net_free);
 	nets = NULL;
 }
@@ -1034,11 +1088,19 @@ void mesh_net_set_frnd_seq(struct mesh_net *net, bool seq)
 	net->friend_seq = seq;
 }
 
-static bool match_cache(const void *a, const void *b)
+static unsigned int msg_hash(const struct mesh_msg *msg)
 {
-	const struct mesh_msg *msg = a;
-	const struct mesh_msg *tst = b;
+	uint32_t hash = msg->src;
+
+	hash = (hash * HASH_MULT) ^ msg->seq;
+	hash = (hash * HASH_MULT) ^ msg->mic;
+
+	return (hash * HASH_MULT) >> (32 - MSG_CACHE_BITS);
+}
 
+static bool match_cache(const struct mesh_msg *msg,
+						const struct mesh_msg *tst)
+{
 	if (msg->seq != tst->seq || msg->mic != tst->mic ||
 					msg->src != tst->src)
 		return false;
@@ -1046,37 +1108,85 @@ static bool match_cache(const void *a, const void *b)
 	return true;
 }
 
+static unsigned int msg_cache_lookup(struct msg_cache *cache,
+						const struct mesh_msg *tst)
+{
+	unsigned int i = msg_hash(tst);
+
+	while (cache->slots[i]) {
+		if (match_cache(&cache->msgs[cache->slots[i] - 1], tst))
+			break;
+
+		i = (i + 1) & (MSG_CACHE_SLOTS - 1);
+	}
+
+	return i;
+}
+
+static void msg_cache_unlink(struct msg_cache *cache, unsigned int i)
+{
+	unsigned int j = i;
+
+	/* Shift back entries that would no longer be reachable */
+	for (;;) {
+		unsigned int k;
+
+		j = (j + 1) & (MSG_CACHE_SLOTS - 1);
+		if (!cache->slots[j])
+			break;
+
+		k = msg_hash(&cache->msgs[cache->slots[j] - 1]);
+
+		if ((j > i && (k <= i || k > j)) ||
+					(j < i && k <= i && k > j)) {
+			cache->slots[i] = cache->slots[j];
+			i = j;
+		}
+	}
+
+	cache->slots[i] = 0;
+}
+
+static void msg_cache_clear(struct msg_cache *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+}
+
 static bool msg_in_cache(struct mesh_net *net, uint16_t src, uint32_t seq,
 								uint32_t mic)
 {
+	struct msg_cache *cache = net->msg_cache;
 	struct mesh_msg *msg;
+	unsigned int i;
 	struct mesh_msg tst = {
 		.src = src,
 		.seq = seq,
 		.mic = mic,
 	};
 
-	msg = l_queue_find(net->msg_cache, match_cache, &tst);
+	i = msg_cache_lookup(cache, &tst);
 
-	if (msg) {
+	if (cache->slots[i]) {
 		l_debug("Supressing duplicate %4.4x + %6.6x + %8.8x",
 							src, seq, mic);
 		return true;
 	}
 
-	msg = l_new(struct mesh_msg, 1);
-	*msg = tst;
-	l_queue_push_head(net->msg_cache, msg);
-	l_debug("Add %4.4x + %6.6x + %8.8x", src, seq, mic);
+	msg = &cache->msgs[cache->next];
 
-	if (l_queue_length(net->msg_cache) > MSG_CACHE_SIZE) {
-		msg = l_queue_peek_tail(net->msg_cache);
-		/* Remove Tail (oldest msg in cache) */
+	if (cache->count == MSG_CACHE_SIZE) {
+		/* Remove oldest msg in cache */
 		l_debug("Remove %4.4x + %6.6x + %8.8x",
 						msg->src, msg->seq, msg->mic);
-		if (l_queue_remove(net->msg_cache, msg))
-			l_free(msg);
-	}
+		msg_cache_unlink(cache, msg_cache_lookup(cache, msg));
+		i = msg_cache_lookup(cache, &tst);
+	} else
+		cache->count++;
+
+	*msg = tst;
+	cache->slots[i] = cache->next + 1;
+	cache->next = (cache->next + 1) % MSG_CACHE_SIZE;
+	l_debug("Add %4.4x + %6.6x + %8.8x", src, seq, mic);
 
 	return false;
 }
@@ -1203,6 +1313,96 @@ static struct mesh_friend_msg *mesh_friend_msg_new(uint8_t seg_max)
 }
 
 
+static size_t friend_msg_size(const struct mesh_friend_msg *msg)
+{
+	size_t size;
+
+	if (!msg->cnt_in)
+		return sizeof(struct mesh_friend_msg);
+
+	size = sizeof(struct mesh_friend_msg) -
+				sizeof(struct mesh_friend_seg_one);
+
+	return size + (msg->cnt_in + 1) * sizeof(struct mesh_friend_seg_12);
+}
+
+/* Each segment still to be delivered is one Friend Queue entry */
+static unsigned int friend_msg_pdus(const struct mesh_friend_msg *msg)
+{
+	return msg->cnt_in - msg->cnt_out + 1;
+}
+
+static void count_pdus(void *a, void *b)
+{
+	unsigned int *pdus = b;
+
+	*pdus += friend_msg_pdus(a);
+}
+
+unsigned int mesh_friend_queue_pdus(struct mesh_friend *frnd)
+{
+	unsigned int pdus = 0;
+
+	l_queue_foreach(frnd->pkt_cache, count_pdus, &pdus);
+
+	return pdus;
+}
+
+static void friend_msg_remove(struct mesh_friend *frnd,
+					struct mesh_friend_msg *msg)
+{
+	/* If we are discarding head for any reason, reset FRND SEQ */
+	if (l_queue_peek_head(frnd->pkt_cache) == msg)
+		frnd->u.active.last = frnd->u.active.seq;
+
+	l_queue_remove(frnd->pkt_cache, msg);
+	frnd->pkt_bytes -= friend_msg_size(msg);
+	l_free(msg);
+}
+
+void mesh_friend_queue_pop(struct mesh_friend *frnd)
+{
+	struct mesh_friend_msg *msg = l_queue_pop_head(frnd->pkt_cache);
+
+	if (!msg)
+		return;
+
+	frnd->pkt_bytes -= friend_msg_size(msg);
+	l_free(msg);
+}
+
+static bool match_not_update(const void *a, const void *b)
+{
+	const struct mesh_friend_msg *msg = a;
+
+	if (!msg->ctl || msg->cnt_in)
+		return true;
+
+	return ((msg->u.one[0].hdr >> OPCODE_HDR_SHIFT) & OPCODE_MASK) !=
+							NET_OP_FRND_UPDATE;
+}
+
+/*
+ * Make room for pdus new entries. When the Friend Queue is full the
+ * oldest entries are discarded, other than Friend Update messages.
+ */
+static void friend_queue_trim(struct mesh_friend *frnd, unsigned int pdus)
+{
+	unsigned int queued = mesh_friend_queue_pdus(frnd);
+
+	while (queued + pdus > FRND_CACHE_MAX) {
+		struct mesh_friend_msg *old;
+
+		old = l_queue_find(frnd->pkt_cache, match_not_update, NULL);
+		if (!old)
+			break;
+
+		queued -= friend_msg_pdus(old);
+		friend_msg_remove(frnd, old);
+		frnd->pkt_dropped++;
+	}
+}
+
 static bool match_ack(const void *a, const void *b)
 {
 	const struct mesh_friend_msg *old = a;
@@ -1256,52 +1456,25 @@ enqueue:
 	/* Special handling for Seg Ack -- Only one per message queue */
 	if (((rx->u.one[0].hdr >> OPCODE_HDR_SHIFT) & OPCODE_MASK) ==
 						NET_OP_SEG_ACKNOWLEDGE) {
-		void *old_head = l_queue_peek_head(frnd->pkt_cache);
-		/* Suppress duplicate ACKs */
-		do {
-			void *old = l_queue_remove_if(frnd->pkt_cache,
-							match_ack, rx);
-
-			if (!old)
-				break;
-
-			if (old_head == old)
-				/*
-				 * If we are discarding head for any
-				 * reason, reset FRND SEQ
-				 */
-				frnd->u.active.last = frnd->u.active.seq;
-
-			l_free(old);
+		struct mesh_friend_msg *old;
 
-		} while (true);
+		/* Suppress duplicate ACKs */
+		while ((old = l_queue_find(frnd->pkt_cache, match_ack, rx)))
+			friend_msg_remove(frnd, old);
 	}
 
 	l_debug("%s for %4.4x from %4.4x ttl: %2.2x (seq: %6.6x) (ctl: %d)",
 			__func__, frnd->lp_addr, rx->src, rx->ttl,
 			rx->u.one[0].seq, rx->ctl);
 
-	if (rx->cnt_in) {
-		size = sizeof(struct mesh_friend_msg) -
-				sizeof(struct mesh_friend_seg_one);
-		size += (rx->cnt_in + 1) * sizeof(struct mesh_friend_seg_12);
-	} else
-		size = sizeof(struct mesh_friend_msg);
+	friend_queue_trim(frnd, friend_msg_pdus(rx));
 
+	size = friend_msg_size(rx);
 	pkt = l_malloc(size);
 	memcpy(pkt, rx, size);
 
 	l_queue_push_tail(frnd->pkt_cache, pkt);
-
-	if (l_queue_length(frnd->pkt_cache) > FRND_CACHE_MAX) {
-		/*
-		 * TODO: Guard against popping UPDATE packets
-		 * (disallowed per spec)
-		 */
-		pkt = l_queue_pop_head(frnd->pkt_cache);
-		l_free(pkt);
-		frnd->u.active.last = frnd->u.active.seq;
-	}
+	frnd->pkt_bytes += size;
 }
 
 static void enqueue_update(void *a, void *b)
@@ -1516,7 +1689,8 @@ static void inseg_to(struct l_timeout *seg_timeout, void *user_data)
 	l_debug("Timeout %p %3.3x", sar, sar->app_idx);
 	send_net_ack(net, sar, sar->flags);
 
-	sar->seg_timeout = l_timeout_create(SEG_TO, inseg_to, net, NULL);
+	sar->seg_timeout = l_timeout_create_ms(SAR_ACK_TO_MS(sar->ttl),
+							inseg_to, net, NULL);
 }
 
 static void inmsg_to(struct l_timeout *msg_timeout, void *user_data)
@@ -1562,6 +1736,80 @@ static void outmsg_to(struct l_timeout *msg_timeout, void *user_data)
 
 static void outseg_to(struct l_timeout *seg_timeout, void *user_data);
 
+static uint64_t sar_now_ms(void)
+{
+	return l_time_now() / 1000;
+}
+
+static bool match_rtt_dst(const void *a, const void *b)
+{
+	const struct sar_rtt *rtt = a;
+
+	return rtt->dst == L_PTR_TO_UINT(b);
+}
+
+static void sar_rtt_sample(struct mesh_net *net, uint16_t dst, uint32_t ms)
+{
+	struct sar_rtt *rtt;
+	uint32_t diff;
+
+	rtt = l_queue_remove_if(net->sar_rtt, match_rtt_dst,
+							L_UINT_TO_PTR(dst));
+	if (!rtt) {
+		/* Keep the most recently used destinations only */
+		if (l_queue_length(net->sar_rtt) >= SAR_RTT_ENTRIES) {
+			const struct l_queue_entry *entry;
+
+			entry = l_queue_get_entries(net->sar_rtt);
+			while (entry->next)
+				entry = entry->next;
+
+			rtt = entry->data;
+			l_queue_remove(net->sar_rtt, rtt);
+		} else
+			rtt = l_new(struct sar_rtt, 1);
+
+		rtt->dst = dst;
+		rtt->srtt = ms;
+		rtt->rttvar = ms / 2;
+	} else {
+		/* RFC 6298 smoothing, alpha = 1/8 and beta = 1/4 */
+		diff = rtt->srtt > ms ? rtt->srtt - ms : ms - rtt->srtt;
+		rtt->rttvar = (3 * rtt->rttvar + diff) / 4;
+		rtt->srtt = (7 * rtt->srtt + ms) / 8;
+	}
+
+	l_queue_push_head(net->sar_rtt, rtt);
+}
+
+static unsigned int sar_rto(struct mesh_net *net, struct mesh_sar *sar)
+{
+	struct sar_rtt *rtt;
+	unsigned int rto = SAR_SEG_TO_MS(sar->ttl);
+
+	rtt = l_queue_find(net->sar_rtt, match_rtt_dst,
+						L_UINT_TO_PTR(sar->remote));
+	if (rtt) {
+		if (rtt->srtt + 4 * rtt->rttvar > rto)
+			rto = rtt->srtt + 4 * rtt->rttvar;
+	} else {
+		/* No sample yet, allow for the segments still being sent */
+		rto += (SEG_MAX(true, sar->len) + 1) * (net->tx_cnt + 1) *
+							net->tx_interval;
+	}
+
+	rto <<= sar->backoff;
+
+	return rto < SAR_RTO_MAX_MS ? rto : SAR_RTO_MAX_MS;
+}
+
+static void sar_arm(struct mesh_net *net, struct mesh_sar *sar)
+{
+	l_timeout_remove(sar->seg_timeout);
+	sar->seg_timeout = l_timeout_create_ms(sar_rto(net, sar), outseg_to,
+								net, NULL);
+}
+
 static void send_queued_sar(struct mesh_net *net, uint16_t dst)
 {
 	struct mesh_sar *sar = l_queue_remove_if(net->sar_queue,
@@ -1584,6 +1832,9 @@ static void ack_received(struct mesh_net *net, bool timeout,
 	struct mesh_sar *outgoing;
 	uint32_t seg_flag = 0x00000001;
 	uint32_t ack_copy = ack_flag;
+	uint32_t window;
+	uint64_t now;
+	bool progress, resent = false;
 	uint16_t i;
 
 	l_debug("ACK Rxed (%x) (to:%d): %8.8x", seq0, timeout, ack_flag);
@@ -1614,6 +1865,34 @@ static void ack_received(struct mesh_net *net, bool timeout,
 		return;
 	}
 
+	now = sar_now_ms();
+	progress = !timeout && (ack_flag & ~outgoing->last_nak);
+
+	if (progress) {
+		/* Karn: only sample RTT of segments sent exactly once */
+		if (!outgoing->rtx && outgoing->tx_time) {
+			sar_rtt_sample(net, outgoing->remote,
+						now - outgoing->tx_time);
+			outgoing->rtx = true;
+		}
+
+		outgoing->backoff = 0;
+
+		/*
+		 * Segments above the highest one acknowledged may still be
+		 * on the air, so only fill the holes below it and leave the
+		 * rest to the retransmission timer.
+		 */
+		for (window = 1; window < ack_flag && window != 0xffffffff;)
+			window = (window << 1) | 1;
+	} else {
+		if (timeout && outgoing->tx_time &&
+				outgoing->backoff < SAR_BACKOFF_MAX)
+			outgoing->backoff++;
+
+		window = 0xffffffff;
+	}
+
 	outgoing->last_nak |= ack_flag;
 
 	ack_copy &= outgoing->flags;
@@ -1625,16 +1904,27 @@ static void ack_received(struct mesh_net *net, bool timeout,
 			continue;
 		}
 
+		if (!(seg_flag & window))
+			break;
+
 		ack_copy |= seg_flag;
 
 		l_debug("Resend Seg %d net:%p dst:%x app_idx:%3.3x",
 				i, net, outgoing->remote, outgoing->app_idx);
 
 		send_seg(net, net->tx_cnt, net->tx_interval, outgoing, i);
+		resent = true;
 	}
 
-	l_timeout_remove(outgoing->seg_timeout);
-	outgoing->seg_timeout = l_timeout_create(SEG_TO, outseg_to, net, NULL);
+	if (resent) {
+		/* Never sent before when started from the SAR queue */
+		if (outgoing->tx_time)
+			outgoing->rtx = true;
+
+		outgoing->tx_time = now;
+	}
+
+	sar_arm(net, outgoing);
 }
 
 static void outseg_to(struct l_timeout *seg_timeout, void *user_data)
@@ -1654,28 +1944,91 @@ static void outseg_to(struct l_timeout *seg_timeout, void *user_data)
 					sar->seqZero, sar->last_nak);
 }
 
-static bool match_replay_cache(const void *a, const void *b)
+static struct mesh_rpl *replay_slot(struct mesh_rpl *entries,
+					unsigned int size, uint16_t src)
 {
-	const struct mesh_rpl *rpe = a;
-	uint16_t src = L_PTR_TO_UINT(b);
+	unsigned int i = ((src * HASH_MULT) >> 16) & (size - 1);
+
+	while (entries[i].src && entries[i].src != src)
+		i = (i + 1) & (size - 1);
 
-	return src == rpe->src;
+	return &entries[i];
 }
 
-static bool clean_old_iv_index(void *a, void *b)
+static struct mesh_rpl *replay_find(struct replay_cache *cache, uint16_t src)
 {
-	struct mesh_rpl *rpe = a;
-	uint32_t iv_index = L_PTR_TO_UINT(b);
+	struct mesh_rpl *rpe;
 
-	if (iv_index < 2)
-		return false;
+	if (!cache->size || !src)
+		return NULL;
 
-	if (rpe->iv_index < iv_index - 1) {
-		l_free(rpe);
-		return true;
+	rpe = replay_slot(cache->entries, cache->size, src);
+
+	return rpe->src ? rpe : NULL;
+}
+
+/* Rebuild the table, dropping entries with an IV Index below min_iv_index */
+static unsigned int replay_rehash(struct replay_cache *cache,
+				unsigned int size, uint32_t min_iv_index)
+{
+	struct mesh_rpl *entries = l_new(struct mesh_rpl, size);
+	unsigned int removed = 0;
+	unsigned int i;
+
+	for (i = 0; i < cache->size; i++) {
+		struct mesh_rpl *rpe = &cache->entries[i];
+
+		if (!rpe->src)
+			continue;
+
+		if (rpe->iv_index < min_iv_index) {
+			removed++;
+			continue;
+		}
+
+		*replay_slot(entries, size, rpe->src) = *rpe;
 	}
 
-	return false;
+	l_free(cache->entries);
+	cache->entries = entries;
+	cache->size = size;
+	cache->count -= removed;
+
+	return removed;
+}
+
+static struct mesh_rpl *replay_insert(struct replay_cache *cache,
+								uint16_t src)
+{
+	struct mesh_rpl *rpe;
+
+	if (!cache->size)
+		replay_rehash(cache, REPLAY_CACHE_MIN, 0);
+	else if ((cache->count + 1) * 2 > cache->size)
+		replay_rehash(cache, cache->size * 2, 0);
+
+	rpe = replay_slot(cache->entries, cache->size, src);
+
+	if (!rpe->src) {
+		rpe->src = src;
+		cache->count++;
+	}
+
+	return rpe;
+}
+
+static void replay_load(void *data, void *user_data)
+{
+	struct mesh_rpl *entry = data;
+	struct replay_cache *cache = user_data;
+	struct mesh_rpl *rpe;
+
+	if (!entry->src)
+		return;
+
+	rpe = replay_insert(cache, entry->src);
+	rpe->seq = entry->seq;
+	rpe->iv_index = entry->iv_index;
 }
 
 static bool msg_check_replay_cache(struct mesh_net *net, uint16_t src,
@@ -1687,8 +2040,7 @@ static bool msg_check_replay_cache(struct mesh_net *net, uint16_t src,
 	if (!net || !net->node)
 		return true;
 
-	rpe = l_queue_find(net->replay_cache, match_replay_cache,
-						L_UINT_TO_PTR(src));
+	rpe = replay_find(net->replay_cache, src);
 
 	if (rpe) {
 		if (iv_index > rpe->iv_index)
@@ -1699,11 +2051,13 @@ static bool msg_check_replay_cache(struct mesh_net *net, uint16_t src,
 			l_debug("Ignoring replayed packet");
 			return true;
 		}
-	} else if (l_queue_length(net->replay_cache) >= crpl) {
+	} else if (net->replay_cache->count >= crpl) {
 		/* SRC not in Replay Cache... see if there is space for it */
+		struct replay_cache *cache = net->replay_cache;
+		unsigned int ret = 0;
 
-		int ret = l_queue_foreach_remove(net->replay_cache,
-				clean_old_iv_index, L_UINT_TO_PTR(iv_index));
+		if (iv_index >= 2)
+			ret = replay_rehash(cache, cache->size, iv_index - 1);
 
 		/* Return true if no space could be freed */
 		if (!ret) {
@@ -1723,20 +2077,10 @@ static void msg_add_replay_cache(struct mesh_net *net, uint16_t src,
 	if (!net || !net->replay_cache)
 		return;
 
-	rpe = l_queue_remove_if(net->replay_cache, match_replay_cache,
-						L_UINT_TO_PTR(src));
-
-	if (!rpe) {
-		rpe = l_new(struct mesh_rpl, 1);
-		rpe->src = src;
-	}
-
+	rpe = replay_insert(net->replay_cache, src);
 	rpe->seq = seq;
 	rpe->iv_index = iv_index;
 	rpl_put_entry(net->node, src, iv_index, seq);
-
-	/* Optimize so that most recent conversations stay earliest in cache */
-	l_queue_push_head(net->replay_cache, rpe);
 }
 
 static bool msg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
@@ -2074,8 +2418,8 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 		if ((largest & sar_in->flags) == largest)
 			send_net_ack(net, sar_in, sar_in->flags);
 
-		sar_in->seg_timeout = l_timeout_create(SEG_TO,
-				inseg_to, net, NULL);
+		sar_in->seg_timeout = l_timeout_create_ms(SAR_ACK_TO_MS(ttl),
+							inseg_to, net, NULL);
 	} else
 		largest = 0;
 
@@ -2217,29 +2561,24 @@ static bool ctl_received(struct mesh_net *net, uint32_t net_key_id,
 	return true;
 }
 
-static bool find_fast_hash(const void *a, const void *b)
+static void add_fast_cache(uint64_t hash)
 {
-	const uint64_t *entry = a;
-	const uint64_t *test = b;
+	fast_cache.hash[fast_cache.next] = hash;
+	fast_cache.next = (fast_cache.next + 1) % FAST_CACHE_SIZE;
 
-	return *entry == *test;
+	if (fast_cache.len < FAST_CACHE_SIZE)
+		fast_cache.len++;
 }
 
 static bool check_fast_cache(uint64_t hash)
 {
-	void *found = l_queue_find(fast_cache, find_fast_hash, &hash);
-	uint64_t *new_hash;
+	unsigned int i;
 
-	if (found)
-		return false;
-
-	if (l_queue_length(fast_cache) >= FAST_CACHE_SIZE)
-		new_hash = l_queue_pop_head(fast_cache);
-	else
-		new_hash = l_malloc(sizeof(hash));
+	for (i = 0; i < fast_cache.len; i++)
+		if (fast_cache.hash[i] == hash)
+			return false;
 
-	*new_hash = hash;
-	l_queue_push_tail(fast_cache, new_hash);
+	add_fast_cache(hash);
 
 	return true;
 }
@@ -2261,7 +2600,8 @@ static void send_relay_pkt(struct mesh_net *net, uint8_t *data, uint8_t size)
 		.u.gen.interval = net->relay.interval,
 		.u.gen.cnt = net->relay.count,
 		.u.gen.min_delay = DEFAULT_MIN_DELAY,
-		.u.gen.max_delay = DEFAULT_MAX_DELAY
+		.u.gen.max_delay = DEFAULT_MAX_DELAY,
+		.priority = MESH_IO_PRIORITY_RELAY
 	};
 
 	packet[0] = MESH_AD_TYPE_NETWORK;
@@ -2305,17 +2645,20 @@ static void send_msg_pkt_oneshot(void *user_data)
 	info.u.gen.min_delay = DEFAULT_MIN_DELAY;
 	/* No extra randomization when sending regular mesh messages */
 	info.u.gen.max_delay = DEFAULT_MIN_DELAY;
+	info.priority = tx->priority;
 
 	mesh_io_send(net->io, &info, tx->packet, tx->size);
 	l_free(tx);
 }
 
-static void send_msg_pkt(struct mesh_net *net, uint8_t cnt, uint16_t interval,
-						uint8_t *packet, uint8_t size)
+static void send_msg_pkt(struct mesh_net *net, enum mesh_io_priority priority,
+				uint8_t cnt, uint16_t interval,
+				uint8_t *packet, uint8_t size)
 {
 	struct oneshot_tx *tx = l_new(struct oneshot_tx, 1);
 
 	tx->net = net;
+	tx->priority = priority;
 	tx->interval = interval;
 	tx->cnt = cnt;
 	tx->size = size;
@@ -2324,6 +2667,78 @@ static void send_msg_pkt(struct mesh_net *net, uint8_t cnt, uint16_t interval,
 	l_idle_oneshot(send_msg_pkt_oneshot, tx, NULL);
 }
 
+static enum _relay_advice relay_advice(struct mesh_net *net, bool frnd,
+						uint8_t ttl, uint16_t dst)
+{
+	/*
+	 * Messages that are encrypted with friendship credentials
+	 * should *always* be relayed
+	 */
+	if (frnd)
+		return RELAY_ALWAYS;
+
+	/* If relay not enable, or no more hops allowed */
+	if (!net->relay.enable || ttl < 0x02)
+		return RELAY_NONE;
+
+	/* Group or Virtual destinations should *always* be relayed */
+	if (IS_GROUP(dst) || IS_VIRTUAL(dst))
+		return RELAY_ALWAYS;
+
+	/* Unicast destinations for other nodes *may* be relayed */
+	else if (IS_UNICAST(dst))
+		return RELAY_ALLOWED;
+
+	/* Otherwise, do not make a relay decision */
+	else
+		return RELAY_NONE;
+}
+
+/*
+ * Traffic that is neither addressed to this node nor a Heartbeat only needs
+ * a relay decision, so the transport header is never parsed or logged.
+ */
+static bool relay_only(struct mesh_net *net, bool frnd, const uint8_t *pkt,
+				uint8_t size, enum _relay_advice *advice)
+{
+	bool ctl;
+	uint8_t ttl;
+	uint16_t src, dst;
+	uint32_t seq, cookie;
+
+	if (size < 10)
+		return false;
+
+	dst = l_get_be16(pkt + 7);
+	if (!dst || is_us(net, dst, false))
+		return false;
+
+	ctl = !!(pkt[1] & CTL);
+	if (ctl && (pkt[9] & OPCODE_MASK) == NET_OP_HEARTBEAT)
+		return false;
+
+	ttl = pkt[1] & TTL_MASK;
+	seq = l_get_be32(pkt + 1) & SEQ_MASK;
+	src = l_get_be16(pkt + 5);
+
+	if (is_us(net, src, true)) {
+		*advice = RELAY_NONE;
+		return true;
+	}
+
+	if (ctl)
+		cookie = l_get_be32(pkt + 2) ^ pkt[6];
+	else
+		cookie = l_get_be32(pkt + size - 8);
+
+	if (msg_in_cache(net, src, seq, cookie))
+		*advice = RELAY_NONE;
+	else
+		*advice = relay_advice(net, frnd, ttl, dst);
+
+	return true;
+}
+
 static enum _relay_advice packet_received(void *user_data,
 				uint32_t net_key_id, uint16_t net_idx,
 				bool frnd, uint32_t iv_index,
@@ -2337,6 +2752,10 @@ static enum _relay_advice packet_received(void *user_data,
 	uint16_t net_src, net_dst, net_seqZero;
 	uint8_t packet[31];
 	bool net_ctl, net_segmented, net_szmic, net_relay;
+	enum _relay_advice advice;
+
+	if (relay_only(net, frnd, data, size, &advice))
+		return advice;
 
 	memcpy(packet + 2, data, size);
 
@@ -2441,28 +2860,7 @@ static enum _relay_advice packet_received(void *user_data,
 			return RELAY_DISALLOWED;
 	}
 
-	/*
-	 * Messages that are encrypted with friendship credentials
-	 * should *always* be relayed
-	 */
-	if (frnd)
-		return RELAY_ALWAYS;
-
-	/* If relay not enable, or no more hops allowed */
-	if (!net->relay.enable || net_ttl < 0x02)
-		return RELAY_NONE;
-
-	/* Group or Virtual destinations should *always* be relayed */
-	if (IS_GROUP(net_dst) || IS_VIRTUAL(net_dst))
-		return RELAY_ALWAYS;
-
-	/* Unicast destinations for other nodes *may* be relayed */
-	else if (IS_UNICAST(net_dst))
-		return RELAY_ALLOWED;
-
-	/* Otherwise, do not make a relay decision */
-	else
-		return RELAY_NONE;
+	return relay_advice(net, frnd, net_ttl, net_dst);
 }
 
 static void net_rx(void *net_ptr, void *user_data)
@@ -2501,6 +2899,8 @@ static void net_rx(void *net_ptr, void *user_data)
 
 	net_idx = key_id_to_net_idx(net, net_key_id, &frnd);
 
+	BT_TRACE3(mesh_net_rx, net_idx, data->len, rssi);
+
 	if (net_idx == NET_IDX_INVALID)
 		return;
 
@@ -2523,6 +2923,23 @@ static void net_rx(void *net_ptr, void *user_data)
 	}
 }
 
+static void relay_pkt(struct net_queue_data *data)
+{
+	uint8_t ttl = data->out[1] & TTL_MASK;
+
+	data->out[1] &= ~TTL_MASK;
+	data->out[1] |= ttl - 1;
+
+	if (!net_key_encrypt(data->net_key_id, data->iv_index, data->out,
+							data->out_size))
+		return;
+
+	/* Drop our own relayed copy should it be heard again */
+	add_fast_cache(l_get_le64(data->out));
+
+	send_relay_pkt(data->net, data->out, data->out_size);
+}
+
 static void net_msg_recv(void *user_data, struct mesh_io_recv_info *info,
 					const uint8_t *data, uint16_t len)
 {
@@ -2549,15 +2966,8 @@ static void net_msg_recv(void *user_data, struct mesh_io_recv_info *info,
 	l_queue_foreach(nets, net_rx, &net_data);
 
 	if (net_data.relay_advice == RELAY_ALWAYS ||
-			net_data.relay_advice == RELAY_ALLOWED) {
-		uint8_t ttl = net_data.out[1] & TTL_MASK;
-
-		net_data.out[1] &=  ~TTL_MASK;
-		net_data.out[1] |= ttl - 1;
-		net_key_encrypt(net_data.net_key_id, net_data.iv_index,
-					net_data.out, net_data.out_size);
-		send_relay_pkt(net_data.net, net_data.out, net_data.out_size);
-	}
+			net_data.relay_advice == RELAY_ALLOWED)
+		relay_pkt(&net_data);
 }
 
 static void iv_upd_to(struct l_timeout *upd_timeout, void *user_data)
@@ -2585,7 +2995,7 @@ static void iv_upd_to(struct l_timeout *upd_timeout, void *user_data)
 							net->iv_index, false);
 		l_queue_foreach(net->subnets, refresh_beacon, net);
 		queue_friend_update(net);
-		l_queue_clear(net->msg_cache, l_free);
+		msg_cache_clear(net->msg_cache);
 		break;
 
 	case IV_UPD_INIT:
@@ -3020,9 +3430,6 @@ bool mesh_net_attach(struct mesh_net *net, struct mesh_io *io)
 		if (!nets)
 			nets = l_queue_new();
 
-		if (!fast_cache)
-			fast_cache = l_queue_new();
-
 		mesh_io_register_recv_cb(io, snb, sizeof(snb),
 							beacon_recv, NULL);
 		mesh_io_register_recv_cb(io, mpb, sizeof(mpb),
@@ -3075,7 +3482,7 @@ bool mesh_net_iv_index_update(struct mesh_net *net)
 		return false;
 
 	l_debug("iv_upd_state = IV_UPD_UPDATING");
-	l_queue_clear(net->msg_cache, l_free);
+	msg_cache_clear(net->msg_cache);
 
 	if (!mesh_config_write_iv_index(node_config_get(net->node),
 						net->iv_index + 1, true))
@@ -3193,7 +3600,8 @@ static bool send_seg(struct mesh_net *net, uint8_t cnt, uint16_t interval,
 		return false;
 	}
 
-	send_msg_pkt(net, cnt, interval, packet, packet_len + 1);
+	send_msg_pkt(net, MESH_IO_PRIORITY_ACCESS, cnt, interval, packet,
+								packet_len + 1);
 
 	msg->last_seg = segO;
 
@@ -3240,8 +3648,8 @@ void mesh_net_send_seg(struct mesh_net *net, uint32_t net_key_id,
 		return;
 	}
 
-	send_msg_pkt(net, net->tx_cnt, net->tx_interval, packet,
-								packet_len + 1);
+	send_msg_pkt(net, MESH_IO_PRIORITY_ACCESS, net->tx_cnt,
+				net->tx_interval, packet, packet_len + 1);
 
 	l_debug("TX: Friend Seg-%d %04x -> %04x : len %u) : TTL %d : SEQ %06x",
 					segO, src, dst, packet_len, ttl, seq);
@@ -3346,8 +3754,8 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 	/* Reliable: Cache; Unreliable: Flush*/
 	if (result && segmented && IS_UNICAST(dst)) {
 		l_queue_push_head(net->sar_out, payload);
-		payload->seg_timeout =
-			l_timeout_create(SEG_TO, outseg_to, net, NULL);
+		payload->tx_time = sar_now_ms();
+		sar_arm(net, payload);
 		payload->msg_timeout =
 			l_timeout_create(MSG_TO, outmsg_to, net, NULL);
 		payload->id = ++net->sar_id_next;
@@ -3398,7 +3806,8 @@ void mesh_net_ack_send(struct mesh_net *net, uint32_t net_key_id,
 		return;
 	}
 
-	send_msg_pkt(net, net->tx_cnt, net->tx_interval, pkt, pkt_len + 1);
+	send_msg_pkt(net, MESH_IO_PRIORITY_CONTROL, net->tx_cnt,
+					net->tx_interval, pkt, pkt_len + 1);
 
 	l_debug("TX: Friend ACK %04x -> %04x : len %u : TTL %d : SEQ %06x",
 					src, dst, pkt_len, ttl, seq);
@@ -3480,8 +3889,8 @@ void mesh_net_transport_send(struct mesh_net *net, uint32_t net_key_id,
 	}
 
 	if (!(IS_UNASSIGNED(dst)))
-		send_msg_pkt(net, net->tx_cnt, net->tx_interval, pkt,
-								pkt_len + 1);
+		send_msg_pkt(net, MESH_IO_PRIORITY_CONTROL, net->tx_cnt,
+					net->tx_interval, pkt, pkt_len + 1);
 }
 
 int mesh_net_key_refresh_phase_set(struct mesh_net *net, uint16_t idx,
@@ -3874,5 +4283,12 @@ int mesh_net_set_heartbeat_pub(struct mesh_net *net, uint16_t dst,
 
 bool mesh_net_load_rpl(struct mesh_net *net)
 {
-	return rpl_get_list(net->node, net->replay_cache);
+	struct l_queue *rpl_list = l_queue_new();
+	bool result;
+
+	result = rpl_get_list(net->node, rpl_list);
+	l_queue_foreach(rpl_list, replay_load, net->replay_cache);
+	l_queue_destroy(rpl_list, l_free);
+
+	return result;
 }
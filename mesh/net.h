@@ -167,6 +167,8 @@ struct mesh_friend {
 	struct mesh_net *net;
 	struct l_timeout *timeout;
 	struct l_queue *pkt_cache;
+	uint32_t pkt_bytes;
+	uint32_t pkt_dropped;
 	void *pkt;
 	uint32_t poll_timeout;
 	uint32_t net_key_cur;
@@ -284,6 +286,8 @@ struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
 					uint8_t frw, uint32_t fpt,
 					uint16_t fn_cnt, uint16_t lp_cnt);
 void mesh_friend_free(void *frnd);
+unsigned int mesh_friend_queue_pdus(struct mesh_friend *frnd);
+void mesh_friend_queue_pop(struct mesh_friend *frnd);
 bool mesh_friend_clear(struct mesh_net *net, struct mesh_friend *frnd);
 void mesh_friend_sub_add(struct mesh_net *net, uint16_t lpn, uint8_t ele_cnt,
 							uint8_t grp_cnt,
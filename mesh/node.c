@@ -301,6 +301,7 @@ static void free_node_resources(void *data)
 	l_queue_destroy(node->elements, element_free);
 	l_queue_destroy(node->pages, l_free);
 	mesh_agent_remove(node->agent);
+	rpl_release(node, true);
 	mesh_config_release(node->cfg);
 	mesh_net_free(node->net);
 	l_free(node->storage_dir);
@@ -318,6 +319,7 @@ void node_remove(struct mesh_node *node)
 
 	l_queue_remove(nodes, node);
 
+	rpl_release(node, false);
 	mesh_config_destroy_nvm(node->cfg);
 
 	free_node_resources(node);
@@ -2289,6 +2291,42 @@ static struct l_dbus_message *publish_call(struct l_dbus *dbus,
 	return l_dbus_message_new_method_return(msg);
 }
 
+static void build_element_pub_stats(void *a, void *b)
+{
+	struct node_element *ele = a;
+	struct l_dbus_message_builder *builder = b;
+
+	l_dbus_message_builder_enter_struct(builder, "ya(qa{sv})");
+	l_dbus_message_builder_append_basic(builder, 'y', &ele->idx);
+	l_dbus_message_builder_enter_array(builder, "(qa{sv})");
+	l_queue_foreach(ele->models, mesh_model_build_pub_stats, builder);
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_leave_struct(builder);
+}
+
+static struct l_dbus_message *pub_stats_call(struct l_dbus *dbus,
+						struct l_dbus_message *msg,
+						void *user_data)
+{
+	struct mesh_node *node = user_data;
+	struct l_dbus_message_builder *builder;
+	struct l_dbus_message *reply;
+
+	if (strcmp(l_dbus_message_get_sender(msg), node->owner))
+		return dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED, NULL);
+
+	reply = l_dbus_message_new_method_return(msg);
+	builder = l_dbus_message_builder_new(reply);
+
+	l_dbus_message_builder_enter_array(builder, "(ya(qa{sv}))");
+	l_queue_foreach(node->elements, build_element_pub_stats, builder);
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_finalize(builder);
+	l_dbus_message_builder_destroy(builder);
+
+	return reply;
+}
+
 static bool features_getter(struct l_dbus *dbus, struct l_dbus_message *msg,
 					struct l_dbus_message_builder *builder,
 					void *user_data)
@@ -2439,6 +2477,9 @@ static void setup_node_interface(struct l_dbus_interface *iface)
 	l_dbus_interface_method(iface, "Publish", 0, publish_call, "",
 					"oqa{sv}ay", "element_path", "model_id",
 							"options", "data");
+	l_dbus_interface_method(iface, "GetPublicationStatistics", 0,
+					pub_stats_call, "a(ya(qa{sv}))", "",
+					"statistics");
 	l_dbus_interface_property(iface, "Features", 0, "a{sv}",
 							features_getter, NULL);
 	l_dbus_interface_property(iface, "Beacon", 0, "b", beacon_getter, NULL);
@@ -97,10 +97,20 @@ struct idle_rx {
 
 static struct l_queue *pb_sessions = NULL;
 
-static const uint8_t filter[1] = { MESH_AD_TYPE_PROVISION };
-
 static void pb_adv_packet(void *user_data, const uint8_t *pkt, uint16_t len);
 
+/* Only cancel the packets sent on this session's link */
+static void cancel_link(struct pb_adv_session *session)
+{
+	uint8_t filter[5] = { MESH_AD_TYPE_PROVISION };
+
+	if (session->loop)
+		return;
+
+	l_put_be32(session->link_id, filter + 1);
+	mesh_send_cancel(filter, sizeof(filter));
+}
+
 static void idle_rx_adv(void *user_data)
 {
 	struct idle_rx *rx = user_data;
@@ -138,7 +148,7 @@ static void send_adv_segs(struct pb_adv_session *session, const uint8_t *data,
 	if (!size)
 		return;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	cancel_link(session);
 
 	l_put_be32(session->link_id, buf + 1);
 	buf[1 + 4] = ++session->local_trans_num;
@@ -205,6 +215,20 @@ static bool user_match (const void *a, const void *b)
 	return session->user_data == b;
 }
 
+static bool link_match(const void *a, const void *b)
+{
+	const struct pb_adv_session *session = a;
+
+	return !session->loop && session->link_id == L_PTR_TO_UINT(b);
+}
+
+static bool acceptor_match(const void *a, const void *b)
+{
+	const struct pb_adv_session *session = a;
+
+	return !session->loop && !session->initiator && !session->link_id;
+}
+
 static void tx_timeout(struct l_timeout *timeout, void *user_data)
 {
 	struct pb_adv_session *session = user_data;
@@ -213,7 +237,7 @@ static void tx_timeout(struct l_timeout *timeout, void *user_data)
 	if (!l_queue_find(pb_sessions, session_match, session))
 		return;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	cancel_link(session);
 
 	l_debug("TX timeout");
 	cb = session->close_cb;
@@ -243,7 +267,7 @@ static void send_open_req(struct pb_adv_session *session)
 	open_req.opcode = PB_ADV_OPEN_REQ;
 	memcpy(open_req.uuid, session->uuid, 16);
 
-	mesh_send_cancel(filter, sizeof(filter));
+	cancel_link(session);
 
 	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, 500, &open_req,
 							sizeof(open_req));
@@ -257,7 +281,7 @@ static void send_open_cfm(struct pb_adv_session *session)
 	open_cfm.trans_num = 0;
 	open_cfm.opcode = PB_ADV_OPEN_CFM;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	cancel_link(session);
 
 	pb_adv_send(session, MESH_IO_TX_COUNT_UNLIMITED, 500, &open_cfm,
 							sizeof(open_cfm));
@@ -290,7 +314,7 @@ static void send_close_ind(struct pb_adv_session *session, uint8_t reason)
 	close_ind.opcode = PB_ADV_CLOSE;
 	close_ind.reason = reason;
 
-	mesh_send_cancel(filter, sizeof(filter));
+	cancel_link(session);
 
 	pb_adv_send(session, 10, 100, &close_ind, sizeof(close_ind));
 }
@@ -393,7 +417,7 @@ static void pb_adv_packet(void *user_data, const uint8_t *pkt, uint16_t len)
 		if (session->local_acked > trans_num)
 			return;
 
-		mesh_send_cancel(filter, sizeof(filter));
+		cancel_link(session);
 		session->local_acked = trans_num;
 		session->ack_cb(session->user_data, trans_num);
 		break;
@@ -477,6 +501,44 @@ static void pb_adv_packet(void *user_data, const uint8_t *pkt, uint16_t len)
 	}
 }
 
+static void pb_adv_rx(void *user_data, const uint8_t *pkt, uint16_t len)
+{
+	struct pb_adv_session *session;
+	uint32_t link_id;
+
+	if (len < 7)
+		return;
+
+	link_id = l_get_be32(pkt + 1);
+	if (!link_id)
+		return;
+
+	session = l_queue_find(pb_sessions, link_match,
+						L_UINT_TO_PTR(link_id));
+
+	/* Unknown link may be an Open Request for the waiting acceptor */
+	if (!session)
+		session = l_queue_find(pb_sessions, acceptor_match, NULL);
+
+	if (session)
+		pb_adv_packet(session, pkt, len);
+}
+
+static bool over_air(const void *a, const void *b)
+{
+	const struct pb_adv_session *session = a;
+
+	return !session->loop;
+}
+
+static void update_prov_rx(void)
+{
+	if (l_queue_find(pb_sessions, over_air, NULL))
+		mesh_reg_prov_rx(pb_adv_rx, NULL);
+	else
+		mesh_unreg_prov_rx(pb_adv_rx);
+}
+
 bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 		mesh_prov_close_func_t close_cb,
 		mesh_prov_receive_func_t rx_cb, mesh_prov_ack_func_t ack_cb,
@@ -489,15 +551,16 @@ bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 
 	old_session = l_queue_find(pb_sessions, uuid_match, uuid);
 
-	/* Reject 2nd session if not looping back */
-	if (l_queue_length(pb_sessions) && !old_session)
-		return false;
-
 	/* Reject looping to more than one session or with same role*/
 	if (old_session && (old_session->loop ||
 					old_session->initiator == initiator))
 		return false;
 
+	/* Only one acceptor may wait for an Open Request at a time */
+	if (!old_session && !initiator &&
+			l_queue_find(pb_sessions, acceptor_match, NULL))
+		return false;
+
 	session = l_new(struct pb_adv_session, 1);
 	session->open_cb = open_cb;
 	session->close_cb = close_cb;
@@ -519,7 +582,7 @@ bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 	if (old_session) {
 		session->loop = old_session;
 		old_session->loop = session;
-		mesh_unreg_prov_rx(pb_adv_packet);
+		update_prov_rx();
 
 		if (initiator)
 			send_open_req(session);
@@ -529,7 +592,7 @@ bool pb_adv_reg(bool initiator, mesh_prov_open_func_t open_cb,
 		return true;
 	}
 
-	mesh_reg_prov_rx(pb_adv_packet, session);
+	update_prov_rx();
 
 	if (initiator)
 		send_open_req(session);
@@ -549,7 +612,9 @@ void pb_adv_unreg(void *user_data)
 	session->tx_timeout = NULL;
 	send_close_ind(session, 0);
 	l_queue_remove(pb_sessions, session);
+
 	l_free(session);
+	update_prov_rx();
 
 	if (!l_queue_length(pb_sessions)) {
 		l_queue_destroy(pb_sessions, l_free);
@@ -51,8 +51,6 @@ static const uint16_t expected_pdu_size[] = {
 
 #define BEACON_TYPE_UNPROVISIONED		0x00
 
-static const uint8_t pkt_filter = MESH_AD_TYPE_PROVISION;
-
 enum int_state {
 	INT_PROV_IDLE = 0,
 	INT_PROV_INVITE_SENT,
@@ -114,22 +112,57 @@ struct scan_req {
 	int count;
 };
 
-static struct mesh_prov_initiator *prov = NULL;
+static struct l_queue *provs;
 static struct l_queue *scans;
 
-static void initiator_free(void)
+static bool match_prov(const void *a, const void *b)
+{
+	return a == b;
+}
+
+static bool match_caller(const void *a, const void *b)
+{
+	const struct mesh_prov_initiator *prov = a;
+
+	return prov->caller_data == b;
+}
+
+static bool prov_valid(struct mesh_prov_initiator *prov)
+{
+	return prov && l_queue_find(provs, match_prov, prov);
+}
+
+static struct mesh_prov_initiator *find_by_server(uint16_t server,
+							struct mesh_node *node)
 {
-	if (prov) {
-		l_timeout_remove(prov->timeout);
+	const struct l_queue_entry *entry;
+
+	for (entry = l_queue_get_entries(provs); entry; entry = entry->next) {
+		struct mesh_prov_initiator *prov = entry->data;
 
-		if (!prov->server)
-			mesh_send_cancel(&pkt_filter, sizeof(pkt_filter));
+		if (prov->server == server && prov->node == node)
+			return prov;
 	}
 
+	return NULL;
+}
+
+static void initiator_free(struct mesh_prov_initiator *prov)
+{
+	if (!l_queue_remove(provs, prov))
+		return;
+
+	l_timeout_remove(prov->timeout);
+
+	/* Cancels only the packets of this session's link */
 	pb_adv_unreg(prov);
 
 	l_free(prov);
-	prov = NULL;
+
+	if (l_queue_isempty(provs)) {
+		l_queue_destroy(provs, NULL);
+		provs = NULL;
+	}
 }
 
 static void int_prov_close(void *user_data, uint8_t reason)
@@ -148,7 +181,7 @@ static void int_prov_close(void *user_data, uint8_t reason)
 
 	if (reason != PROV_ERR_SUCCESS) {
 		prov->complete_cb(prov->caller_data, reason, NULL);
-		initiator_free();
+		initiator_free(prov);
 		return;
 	}
 
@@ -158,7 +191,7 @@ static void int_prov_close(void *user_data, uint8_t reason)
 	info.num_ele = prov->conf_inputs.caps.num_ele;
 
 	prov->complete_cb(prov->caller_data, PROV_ERR_SUCCESS, &info);
-	initiator_free();
+	initiator_free(prov);
 }
 
 static void swap_u256_bytes(uint8_t *u256)
@@ -176,11 +209,10 @@ static void swap_u256_bytes(uint8_t *u256)
 static void int_prov_open(void *user_data, prov_trans_tx_t trans_tx,
 				void *trans_data, uint8_t transport)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 	struct prov_invite_msg msg = { PROV_INVITE, { 30 }};
 
-	/* Only one provisioning session may be open at a time */
-	if (rx_prov != prov)
+	if (!prov_valid(prov))
 		return;
 
 	/* Only one provisioning session may be open at a time */
@@ -287,7 +319,8 @@ static uint32_t digit_mod(uint8_t power)
 	return ret;
 }
 
-static void calc_local_material(const uint8_t *random)
+static void calc_local_material(struct mesh_prov_initiator *prov,
+							const uint8_t *random)
 {
 	/* Calculate SessionKey while the data is fresh */
 	mesh_crypto_prov_prov_salt(prov->salt,
@@ -316,10 +349,10 @@ static void send_confirm(struct mesh_prov_initiator *prov)
 
 static void number_cb(void *user_data, int err, uint32_t number)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 	struct prov_fail_msg msg;
 
-	if (prov != rx_prov)
+	if (!prov_valid(prov))
 		return;
 
 	if (err) {
@@ -338,10 +371,10 @@ static void number_cb(void *user_data, int err, uint32_t number)
 
 static void static_cb(void *user_data, int err, uint8_t *key, uint32_t len)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 	struct prov_fail_msg msg;
 
-	if (prov != rx_prov)
+	if (!prov_valid(prov))
 		return;
 
 	if (err || !key || len != 16) {
@@ -369,11 +402,11 @@ static void send_pub_key(struct mesh_prov_initiator *prov)
 
 static void pub_key_cb(void *user_data, int err, uint8_t *key, uint32_t len)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 	struct prov_fail_msg msg;
 	uint8_t fail_code[2];
 
-	if (prov != rx_prov)
+	if (!prov_valid(prov))
 		return;
 
 	if (err || !key || len != 64) {
@@ -412,6 +445,7 @@ static void send_random(struct mesh_prov_initiator *prov)
 
 void initiator_prov_data(uint16_t net_idx, uint16_t primary, void *caller_data)
 {
+	struct mesh_prov_initiator *prov;
 	struct prov_data_msg prov_data;
 	struct prov_fail_msg prov_fail;
 	struct keyring_net_key key;
@@ -419,7 +453,8 @@ void initiator_prov_data(uint16_t net_idx, uint16_t primary, void *caller_data)
 	uint32_t iv_index;
 	uint8_t snb_flags;
 
-	if (!prov || caller_data != prov->caller_data)
+	prov = l_queue_find(provs, match_caller, caller_data);
+	if (!prov)
 		return;
 
 	if (prov->state != INT_PROV_RAND_ACKED)
@@ -527,7 +562,7 @@ static void get_random_key(struct mesh_prov_initiator *prov, uint8_t action,
 	l_put_be32(oob_key, prov->rand_auth_workspace + 44);
 }
 
-static void int_prov_auth(void)
+static void int_prov_auth(struct mesh_prov_initiator *prov)
 {
 	uint8_t fail_code[2];
 	uint32_t oob_key;
@@ -654,13 +689,13 @@ static void int_prov_start_auth(const struct mesh_agent_prov_caps *prov_caps,
 
 static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 	const uint8_t *data = dptr;
 	uint8_t *out;
 	uint8_t type = *data++;
 	uint8_t fail_code[2];
 
-	if (rx_prov != prov || !prov->trans_tx)
+	if (!prov_valid(prov) || !prov->trans_tx)
 		return;
 
 	l_debug("Provisioning packet received type: %2.2x (%u octets)",
@@ -756,7 +791,7 @@ static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 			goto failure;
 		}
 
-		int_prov_auth();
+		int_prov_auth(prov);
 		break;
 
 	case PROV_INP_CMPLT: /* Provisioning Input Complete */
@@ -790,7 +825,7 @@ static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 		}
 
 		/* RXed Device Confirmation */
-		calc_local_material(data);
+		calc_local_material(prov, data);
 		memcpy(prov->rand_auth_workspace + 16, data, 16);
 		print_packet("RandomDevice", data, 16);
 
@@ -836,7 +871,8 @@ static void int_prov_rx(void *user_data, const void *dptr, uint16_t len)
 		goto failure;
 	}
 
-	if (prov)
+	/* The session may have been closed while handling the PDU */
+	if (prov_valid(prov))
 		prov->previous = type;
 
 	return;
@@ -850,9 +886,9 @@ failure:
 
 static void int_prov_ack(void *user_data, uint8_t msg_num)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 
-	if (rx_prov != prov || !prov->trans_tx)
+	if (!prov_valid(prov) || !prov->trans_tx)
 		return;
 
 	switch (prov->state) {
@@ -868,7 +904,7 @@ static void int_prov_ack(void *user_data, uint8_t msg_num)
 
 	case INT_PROV_KEY_SENT:
 		if (prov->conf_inputs.start.pub_key)
-			int_prov_auth();
+			int_prov_auth(prov);
 		break;
 
 	case INT_PROV_IDLE:
@@ -888,11 +924,12 @@ static void int_prov_ack(void *user_data, uint8_t msg_num)
 
 static void initiator_open_cb(void *user_data, int err)
 {
+	struct mesh_prov_initiator *prov = user_data;
 	uint8_t msg[20];
 	int n;
 	bool result;
 
-	if (!prov)
+	if (!prov_valid(prov))
 		return;
 
 	if (err != MESH_ERROR_NONE)
@@ -926,19 +963,19 @@ static void initiator_open_cb(void *user_data, int err)
 	return;
 fail:
 	prov->start_cb(prov->caller_data, err);
-	initiator_free();
+	initiator_free(prov);
 }
 
 static void initiate_to(struct l_timeout *timeout, void *user_data)
 {
-	struct mesh_prov_initiator *rx_prov = user_data;
+	struct mesh_prov_initiator *prov = user_data;
 
-	if (rx_prov != prov) {
+	if (!prov_valid(prov)) {
 		l_timeout_remove(timeout);
 		return;
 	}
 
-	int_prov_close(user_data, PROV_ERR_TIMEOUT);
+	int_prov_close(prov, PROV_ERR_TIMEOUT);
 }
 
 bool initiator_start(uint8_t transport, uint16_t server, uint16_t svr_idx,
@@ -949,12 +986,27 @@ bool initiator_start(uint8_t transport, uint16_t server, uint16_t svr_idx,
 		mesh_prov_initiator_complete_func_t complete_cb,
 		void *node, void *caller_data)
 {
+	struct mesh_prov_initiator *prov;
+	const struct l_queue_entry *entry;
+
 	/* Invoked from Add() method in mesh-api.txt, to add a
 	 * remote unprovisioned device network.
 	 */
 
-	if (prov)
-		return false;
+	/*
+	 * Sessions run in parallel as long as they use separate PB-ADV
+	 * links, a Remote Provisioning Server only has a single link.
+	 */
+	for (entry = l_queue_get_entries(provs); entry; entry = entry->next) {
+		const struct mesh_prov_initiator *old = entry->data;
+
+		if (server && old->server == server && old->node == node)
+			return false;
+
+		if (!server && !old->server && uuid &&
+						!memcmp(old->uuid, uuid, 16))
+			return false;
+	}
 
 	prov = l_new(struct mesh_prov_initiator, 1);
 	prov->to_secs = timeout;
@@ -971,6 +1023,11 @@ bool initiator_start(uint8_t transport, uint16_t server, uint16_t svr_idx,
 	prov->timeout = l_timeout_create(timeout, initiate_to, prov, NULL);
 	memcpy(prov->uuid, uuid, 16);
 
+	if (!provs)
+		provs = l_queue_new();
+
+	l_queue_push_tail(provs, prov);
+
 	mesh_agent_refresh(prov->agent, initiator_open_cb, prov);
 
 	return true;
@@ -978,7 +1035,7 @@ bool initiator_start(uint8_t transport, uint16_t server, uint16_t svr_idx,
 
 void initiator_cancel(void *user_data)
 {
-	initiator_free();
+	initiator_free(l_queue_find(provs, match_caller, user_data));
 }
 
 static void rpr_tx(void *user_data, const void *data, uint16_t len)
@@ -1011,6 +1068,7 @@ static bool remprv_cli_pkt(uint16_t src, uint16_t unicast, uint16_t app_idx,
 					uint16_t size, const void *user_data)
 {
 	struct mesh_node *node = (struct mesh_node *) user_data;
+	struct mesh_prov_initiator *prov;
 	const uint8_t *pkt = data;
 	struct scan_req *req;
 	uint32_t opcode;
@@ -1033,8 +1091,7 @@ static bool remprv_cli_pkt(uint16_t src, uint16_t unicast, uint16_t app_idx,
 	if (app_idx == APP_IDX_DEV_LOCAL && unicast != src)
 		return true;
 
-	if (prov && (prov->server != src || prov->node != node))
-		return true;
+	prov = find_by_server(src, node);
 
 	n = 0;
 
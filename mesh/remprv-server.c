@@ -94,7 +94,6 @@ struct rem_prov_data {
 static struct rem_prov_data *rpb_prov;
 
 static const uint8_t prvb[2] = {BT_AD_MESH_BEACON, 0x00};
-static const uint8_t pkt_filter = BT_AD_MESH_PROV;
 static const char *name = "Test Name";
 
 static const uint8_t zero[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -846,7 +845,6 @@ static bool remprv_srv_pkt(uint16_t src, uint16_t unicast, uint16_t app_idx,
 
 		old_state = prov->state;
 		prov->state = PB_REMOTE_STATE_LINK_CLOSING;
-		mesh_io_send_cancel(NULL, &pkt_filter, sizeof(pkt_filter));
 		send_prov_status(prov, PB_REM_ERR_SUCCESS);
 		if (pkt[0] == 0x02 &&
 				old_state >= PB_REMOTE_STATE_LINK_ACTIVE) {
@@ -33,58 +33,200 @@
 #include "mesh/rpl.h"
 
 static const char *rpl_dir = "/rpl";
+static const char *rpl_file = "/rpl/entries";
+static const char *tmp_ext = ".tmp";
 
-bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
-								uint32_t seq)
+/* Dirty entries are written out together after this many seconds */
+#define RPL_FLUSH_TIMEOUT	10
+
+/*
+ * Sequence numbers a source may advance past its stored entry before the
+ * store is written right away. Loaded entries are raised by this margin,
+ * so nothing accepted before a crash can be replayed after a restart.
+ */
+#define RPL_SEQ_MARGIN		64
+
+struct rpl_entry {
+	struct mesh_rpl rpl;
+	uint32_t saved_iv_index;
+	uint32_t saved_seq;
+	bool saved;
+	bool margin;
+};
+
+struct rpl_store {
+	struct mesh_node *node;
+	struct l_hashmap *entries;
+	struct l_timeout *timeout;
+	bool legacy;
+};
+
+static struct l_queue *stores;
+
+static bool match_node(const void *a, const void *b)
 {
-	const char *node_path;
-	char src_file[PATH_MAX];
-	char seq_txt[7];
-	bool result = false;
+	const struct rpl_store *store = a;
+
+	return store->node == b;
+}
+
+static struct rpl_store *store_get(struct mesh_node *node)
+{
+	struct rpl_store *store;
+
+	store = l_queue_find(stores, match_node, node);
+	if (store)
+		return store;
+
+	if (!stores)
+		stores = l_queue_new();
+
+	store = l_new(struct rpl_store, 1);
+	store->node = node;
+	store->entries = l_hashmap_new();
+	l_queue_push_tail(stores, store);
+
+	return store;
+}
+
+static void store_free(void *data)
+{
+	struct rpl_store *store = data;
+
+	l_timeout_remove(store->timeout);
+	l_hashmap_destroy(store->entries, l_free);
+	l_free(store);
+}
+
+static void write_entry(const void *key, void *value, void *user_data)
+{
+	struct rpl_entry *entry = value;
+	FILE *outfile = user_data;
+
+	fprintf(outfile, "%8.8x %4.4x %6.6x\n", entry->rpl.iv_index,
+					entry->rpl.src, entry->rpl.seq);
+}
+
+static void mark_saved(const void *key, void *value, void *user_data)
+{
+	struct rpl_entry *entry = value;
+
+	entry->saved_iv_index = entry->rpl.iv_index;
+	entry->saved_seq = entry->rpl.seq;
+	entry->saved = true;
+}
+
+static void remove_legacy(const char *node_path)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
 	DIR *dir;
-	int fd;
 
-	if (!IS_UNICAST(src))
+	snprintf(path, PATH_MAX, "%s%s", node_path, rpl_dir);
+	dir = opendir(path);
+	if (!dir)
+		return;
+
+	/* Entries from the per source files now live in the store */
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
+			snprintf(path, PATH_MAX, "%s%s/%s", node_path, rpl_dir,
+								entry->d_name);
+			del_path(path);
+		}
+	}
+
+	closedir(dir);
+}
+
+static bool store_flush(struct rpl_store *store)
+{
+	const char *node_path;
+	char fname[PATH_MAX];
+	char fname_tmp[PATH_MAX];
+	FILE *outfile;
+	bool result;
+
+	l_timeout_remove(store->timeout);
+	store->timeout = NULL;
+
+	node_path = node_get_storage_dir(store->node);
+	if (!node_path)
 		return false;
 
-	node_path = node_get_storage_dir(node);
+	if (strlen(node_path) + strlen(rpl_file) + 5 >= PATH_MAX)
+		return false;
 
-	if (strlen(node_path) + strlen(rpl_dir) + 15 >= PATH_MAX)
+	snprintf(fname, PATH_MAX, "%s%s", node_path, rpl_file);
+	snprintf(fname_tmp, PATH_MAX, "%s%s", fname, tmp_ext);
+
+	outfile = fopen(fname_tmp, "w");
+	if (!outfile) {
+		l_error("Failed to save RPL to %s", fname_tmp);
 		return false;
+	}
 
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x", node_path, rpl_dir,
-								iv_index);
-	dir = opendir(src_file);
+	l_hashmap_foreach(store->entries, write_entry, outfile);
 
-	if (!dir) {
-		if (mkdir(src_file, 0755) != 0)
-			l_error("Failed to create dir: %s", src_file);
-	} else
-		closedir(dir);
+	result = !fflush(outfile) && !fsync(fileno(outfile));
 
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x/%4.4x", node_path, rpl_dir,
-								iv_index, src);
+	if (fclose(outfile) || !result || rename(fname_tmp, fname) < 0) {
+		l_error("Failed to save RPL to %s", fname);
+		remove(fname_tmp);
+		return false;
+	}
 
-	fd = open(src_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-	if (fd >= 0) {
-		snprintf(seq_txt, 7, "%6.6x", seq);
-		if (write(fd, seq_txt, 6) == 6)
-			result = true;
+	l_hashmap_foreach(store->entries, mark_saved, NULL);
 
-		close(fd);
+	if (store->legacy) {
+		remove_legacy(node_path);
+		store->legacy = false;
 	}
 
-	if (!result)
+	return true;
+}
+
+static void flush_timeout(struct l_timeout *timeout, void *user_data)
+{
+	store_flush(user_data);
+}
+
+static void store_schedule(struct rpl_store *store)
+{
+	if (!store->timeout)
+		store->timeout = l_timeout_create(RPL_FLUSH_TIMEOUT,
+						flush_timeout, store, NULL);
+}
+
+bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
+								uint32_t seq)
+{
+	struct rpl_store *store;
+	struct rpl_entry *entry;
+
+	if (!IS_UNICAST(src))
 		return false;
 
-	/* Delete RPL entry from old iv_index (if it exists) */
-	iv_index--;
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x/%4.4x", node_path, rpl_dir,
-								iv_index, src);
-	if (remove(src_file) < 0 && errno != ENOENT)
-		l_error("Failed to remove(%d): %s", errno, src_file);
+	store = store_get(node);
 
-	return result;
+	entry = l_hashmap_lookup(store->entries, L_UINT_TO_PTR(src));
+	if (!entry) {
+		entry = l_new(struct rpl_entry, 1);
+		entry->rpl.src = src;
+		l_hashmap_insert(store->entries, L_UINT_TO_PTR(src), entry);
+	}
+
+	entry->rpl.iv_index = iv_index;
+	entry->rpl.seq = seq;
+
+	/* Write through when a restart could otherwise accept a replay */
+	if (!entry->saved || entry->saved_iv_index != iv_index ||
+				seq > entry->saved_seq + RPL_SEQ_MARGIN)
+		return store_flush(store);
+
+	store_schedule(store);
+
+	return true;
 }
 
 void rpl_del_entry(struct mesh_node *node, uint16_t src)
@@ -92,11 +234,18 @@ void rpl_del_entry(struct mesh_node *node, uint16_t src)
 	const char *node_path;
 	char rpl_path[PATH_MAX];
 	struct dirent *entry;
+	struct rpl_store *store;
 	DIR *dir;
 
 	if (!IS_UNICAST(src))
 		return;
 
+	store = l_queue_find(stores, match_node, node);
+	if (store) {
+		l_free(l_hashmap_remove(store->entries, L_UINT_TO_PTR(src)));
+		store_flush(store);
+	}
+
 	node_path = node_get_storage_dir(node);
 
 	if (strlen(node_path) + strlen(rpl_dir) + 15 >= PATH_MAX)
@@ -122,17 +271,48 @@ void rpl_del_entry(struct mesh_node *node, uint16_t src)
 	closedir(dir);
 }
 
-static bool match_src(const void *a, const void *b)
+static uint32_t entry_seq(const struct rpl_entry *entry)
 {
-	const struct mesh_rpl *rpl = a;
-	uint16_t src = L_PTR_TO_UINT(b);
+	if (!entry->margin)
+		return entry->rpl.seq;
 
-	return rpl->src == src;
+	return entry->rpl.seq + RPL_SEQ_MARGIN > SEQ_MASK ? SEQ_MASK :
+					entry->rpl.seq + RPL_SEQ_MARGIN;
 }
 
-static void get_entries(const char *iv_path, struct l_queue *rpl_list)
+static struct rpl_entry *store_load(struct rpl_store *store, uint16_t src,
+				uint32_t iv_index, uint32_t seq, bool margin)
+{
+	struct rpl_entry *entry;
+	struct rpl_entry tst = {
+		.rpl = { .iv_index = iv_index, .seq = seq, .src = src },
+		.margin = margin,
+	};
+
+	if (seq > SEQ_MASK || !IS_UNICAST(src))
+		return NULL;
+
+	entry = l_hashmap_lookup(store->entries, L_UINT_TO_PTR(src));
+	if (entry) {
+		/* Keep whichever entry rejects more */
+		if (iv_index < entry->rpl.iv_index)
+			return NULL;
+
+		if (iv_index == entry->rpl.iv_index &&
+					entry_seq(&tst) <= entry_seq(entry))
+			return NULL;
+	} else {
+		entry = l_new(struct rpl_entry, 1);
+		l_hashmap_insert(store->entries, L_UINT_TO_PTR(src), entry);
+	}
+
+	*entry = tst;
+
+	return entry;
+}
+
+static void get_entries(const char *iv_path, struct rpl_store *store)
 {
-	struct mesh_rpl *rpl;
 	struct dirent *entry;
 	DIR *dir;
 	int fd;
@@ -168,26 +348,9 @@ static void get_entries(const char *iv_path, struct l_queue *rpl_list)
 				continue;
 
 			if (read(fd, seq_txt, 6) == 6 &&
-					sscanf(seq_txt, "%06x", &seq) == 1) {
-
-				rpl = l_queue_find(rpl_list, match_src,
-						L_UINT_TO_PTR(src));
-
-				if (rpl) {
-					/* Replace older entries */
-					if (rpl->iv_index < iv_index) {
-						rpl->iv_index = iv_index;
-						rpl->seq = seq;
-					}
-				} else if (seq <= SEQ_MASK && IS_UNICAST(src)) {
-					rpl = l_new(struct mesh_rpl, 1);
-					rpl->src = src;
-					rpl->iv_index = iv_index;
-					rpl->seq = seq;
-
-					l_queue_push_head(rpl_list, rpl);
-				}
-			}
+					sscanf(seq_txt, "%06x", &seq) == 1)
+				store_load(store, src, iv_index, seq, false);
+
 			close(fd);
 		}
 	}
@@ -195,8 +358,48 @@ static void get_entries(const char *iv_path, struct l_queue *rpl_list)
 	closedir(dir);
 }
 
+static void get_store_entries(const char *fname, struct rpl_store *store)
+{
+	struct rpl_entry *entry;
+	uint32_t iv_index, seq;
+	uint16_t src;
+	FILE *infile;
+
+	infile = fopen(fname, "r");
+	if (!infile)
+		return;
+
+	while (fscanf(infile, "%08x %04hx %06x\n", &iv_index, &src,
+								&seq) == 3) {
+		entry = store_load(store, src, iv_index, seq, true);
+		if (!entry)
+			continue;
+
+		entry->saved_iv_index = iv_index;
+		entry->saved_seq = seq;
+		entry->saved = true;
+	}
+
+	fclose(infile);
+}
+
+static void copy_entry(const void *key, void *value, void *user_data)
+{
+	struct rpl_entry *entry = value;
+	struct l_queue *rpl_list = user_data;
+	struct mesh_rpl *rpl;
+
+	rpl = l_new(struct mesh_rpl, 1);
+	rpl->src = entry->rpl.src;
+	rpl->iv_index = entry->rpl.iv_index;
+	rpl->seq = entry_seq(entry);
+
+	l_queue_push_head(rpl_list, rpl);
+}
+
 bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
 {
+	struct rpl_store *store;
 	const char *node_path;
 	struct dirent *entry;
 	char *rpl_path;
@@ -208,7 +411,7 @@ bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
 
 	node_path = node_get_storage_dir(node);
 
-	len = strlen(node_path) + strlen(rpl_dir) + 15;
+	len = strlen(node_path) + strlen(rpl_file) + 15;
 
 	if (len > PATH_MAX)
 		return false;
@@ -224,24 +427,49 @@ bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
 		return false;
 	}
 
+	store = store_get(node);
+
 	while ((entry = readdir(dir)) != NULL) {
-		/* RPL sequences are stored in files under iv_indexs */
+		/* Older versions stored sequences in files under iv_indexs */
 		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
 			snprintf(rpl_path, len, "%s%s/%s",
 					node_path, rpl_dir, entry->d_name);
-			get_entries(rpl_path, rpl_list);
+			get_entries(rpl_path, store);
+			store->legacy = true;
 		}
 	}
 
+	snprintf(rpl_path, len, "%s%s", node_path, rpl_file);
+	get_store_entries(rpl_path, store);
+
 	l_free(rpl_path);
 	closedir(dir);
 
+	l_hashmap_foreach(store->entries, copy_entry, rpl_list);
+
+	/* Move entries only found in the old layout into the store */
+	if (store->legacy)
+		store_schedule(store);
+
+	return true;
+}
+
+static bool remove_stale(const void *key, void *value, void *user_data)
+{
+	struct rpl_entry *entry = value;
+	uint32_t cur = L_PTR_TO_UINT(user_data);
+
+	if (entry->rpl.iv_index == cur || entry->rpl.iv_index == cur - 1)
+		return false;
+
+	l_free(entry);
 	return true;
 }
 
 void rpl_update(struct mesh_node *node, uint32_t cur)
 {
 	uint32_t old = cur - 1;
+	struct rpl_store *store;
 	const char *node_path;
 	struct dirent *entry;
 	char path[PATH_MAX];
@@ -284,6 +512,32 @@ void rpl_update(struct mesh_node *node, uint32_t cur)
 	}
 
 	closedir(dir);
+
+	store = l_queue_find(stores, match_node, node);
+	if (store) {
+		l_hashmap_foreach_remove(store->entries, remove_stale,
+							L_UINT_TO_PTR(cur));
+		store_flush(store);
+	}
+}
+
+void rpl_release(struct mesh_node *node, bool flush)
+{
+	struct rpl_store *store;
+
+	store = l_queue_remove_if(stores, match_node, node);
+	if (!store)
+		return;
+
+	if (flush && store->timeout)
+		store_flush(store);
+
+	store_free(store);
+
+	if (l_queue_isempty(stores)) {
+		l_queue_destroy(stores, NULL);
+		stores = NULL;
+	}
 }
 
 bool rpl_init(const char *node_path)
@@ -15,7 +15,11 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -24,6 +28,7 @@
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
 #include "src/shared/btsnoop.h"
+#include "src/shared/mainloop.h"
 #include "monitor/bt.h"
 #include "monitor/display.h"
 #include "monitor/packet.h"
@@ -32,7 +37,16 @@
 #define TIMEVAL_MSEC(_tv) \
 	(long long)((_tv)->tv_sec * 1000 + (_tv)->tv_usec / 1000)
 
+#define EXPORT_INTERVAL	1000
+#define LIVE_INTERVAL	1000
+
+#define WORKERS_MAX	8
+#define BATCH_SIZE	(256 * 1024)
+#define BATCH_QUEUE_MAX	8
+
 struct hci_dev {
+	uint64_t seq_added;
+	uint64_t seq_removed;
 	uint16_t index;
 	uint8_t type;
 	uint8_t bdaddr[6];
@@ -50,6 +64,8 @@ struct hci_dev {
 	unsigned long ctrl_msg;
 	unsigned long unknown;
 	uint16_t manufacturer;
+	uint16_t acl_max_pkt;
+	uint16_t le_max_pkt;
 	struct queue *conn_list;
 };
 
@@ -63,13 +79,42 @@ struct hci_stats {
 	size_t bytes;
 	size_t num;
 	size_t num_comp;
+	size_t num_att;
 	struct packet_latency latency;
 	struct queue *plot;
 	uint16_t min;
 	uint16_t max;
 };
 
+struct export_row {
+	long long msec;
+	size_t tx_bytes;
+	size_t rx_bytes;
+	size_t tx_num;
+	size_t rx_num;
+	size_t lat_num;
+	uint32_t lat_p50;
+	uint32_t lat_p90;
+	uint32_t lat_p99;
+	bool has_jitter;
+	uint32_t jitter;
+};
+
+/* Per connection time series, bucketed by EXPORT_INTERVAL */
+struct export_series {
+	struct queue *rows;
+	struct export_row cur;
+	uint32_t *lat;
+	size_t lat_len;
+	size_t lat_size;
+	struct timeval last_rx;
+	bool has_delta;
+	long long last_delta;
+	double jitter;
+};
+
 struct hci_conn {
+	uint16_t index;
 	uint16_t handle;
 	uint16_t link;
 	uint8_t type;
@@ -81,6 +126,10 @@ struct hci_conn {
 	struct queue *chan_list;
 	struct hci_stats rx;
 	struct hci_stats tx;
+	struct export_series *export;
+	size_t live_rx_bytes;
+	size_t live_tx_bytes;
+	size_t live_att;
 };
 
 struct hci_conn_tx {
@@ -102,7 +151,312 @@ struct l2cap_chan {
 	struct hci_stats tx;
 };
 
-static struct queue *dev_list;
+struct record {
+	struct timeval tv;
+	uint64_t seq;
+	uint16_t index;
+	uint16_t opcode;
+	uint16_t size;
+	uint8_t data[];
+};
+
+struct batch {
+	size_t len;
+	uint8_t buf[BATCH_SIZE];
+};
+
+struct worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct batch *queue[BATCH_QUEUE_MAX];
+	unsigned int head;
+	unsigned int count;
+	bool done;
+	struct batch *batch;
+	struct queue *dev_list;
+	struct queue *removed_list;
+};
+
+/* Each worker keeps the state of the controllers it was handed */
+static __thread struct queue *dev_list;
+static __thread struct queue *removed_list;
+static __thread uint64_t cur_seq;
+
+/* Set up before any worker starts and only read afterwards */
+static FILE *export_file;
+static bool export_json;
+static bool export_first;
+
+static int live_id = -1;
+static struct timespec live_ts;
+
+static int lat_cmp(const void *a, const void *b)
+{
+	uint32_t lat_a = *(const uint32_t *) a;
+	uint32_t lat_b = *(const uint32_t *) b;
+
+	return lat_a < lat_b ? -1 : lat_a > lat_b;
+}
+
+static uint32_t lat_percentile(struct export_series *series,
+							unsigned int p)
+{
+	size_t rank = (series->lat_len * p + 99) / 100;
+
+	return series->lat[rank ? rank - 1 : 0];
+}
+
+static void export_flush(struct export_series *series)
+{
+	struct export_row *row;
+
+	if (series->cur.msec < 0)
+		return;
+
+	if (series->lat_len) {
+		qsort(series->lat, series->lat_len, sizeof(*series->lat),
+								lat_cmp);
+		series->cur.lat_num = series->lat_len;
+		series->cur.lat_p50 = lat_percentile(series, 50);
+		series->cur.lat_p90 = lat_percentile(series, 90);
+		series->cur.lat_p99 = lat_percentile(series, 99);
+	}
+
+	if (series->has_delta) {
+		series->cur.has_jitter = true;
+		series->cur.jitter = series->jitter;
+	}
+
+	row = util_memdup(&series->cur, sizeof(*row));
+	queue_push_tail(series->rows, row);
+
+	memset(&series->cur, 0, sizeof(series->cur));
+	series->cur.msec = -1;
+	series->lat_len = 0;
+}
+
+static struct export_row *export_row(struct export_series *series,
+						const struct timeval *tv)
+{
+	long long msec = TIMEVAL_MSEC(tv) / EXPORT_INTERVAL * EXPORT_INTERVAL;
+
+	if (series->cur.msec != msec) {
+		export_flush(series);
+		series->cur.msec = msec;
+	}
+
+	return &series->cur;
+}
+
+static void export_tx(struct hci_conn *conn, const struct timeval *tv,
+								uint16_t size)
+{
+	struct export_row *row;
+
+	if (!conn->export)
+		return;
+
+	row = export_row(conn->export, tv);
+	row->tx_bytes += size;
+	row->tx_num++;
+}
+
+static void export_rx(struct hci_conn *conn, const struct timeval *tv,
+								uint16_t size)
+{
+	struct export_series *series = conn->export;
+	struct export_row *row;
+	struct timeval res;
+	long long delta;
+
+	if (!series)
+		return;
+
+	row = export_row(series, tv);
+	row->rx_bytes += size;
+	row->rx_num++;
+
+	if (conn->type != CONN_BR_SCO && conn->type != CONN_BR_ESCO &&
+						conn->type != CONN_LE_ISO)
+		return;
+
+	/* Interarrival jitter as in RFC 3550 */
+	if (timerisset(&series->last_rx)) {
+		timersub(tv, &series->last_rx, &res);
+		delta = res.tv_sec * 1000000ll + res.tv_usec;
+
+		if (series->has_delta) {
+			long long d = delta - series->last_delta;
+
+			if (d < 0)
+				d = -d;
+
+			series->jitter += (d - series->jitter) / 16;
+		}
+
+		series->last_delta = delta;
+		series->has_delta = true;
+	}
+
+	series->last_rx = *tv;
+}
+
+static void export_latency(struct hci_conn *conn, const struct timeval *tv,
+						const struct timeval *latency)
+{
+	struct export_series *series = conn->export;
+	long long usec;
+
+	if (!series)
+		return;
+
+	export_row(series, tv);
+
+	if (series->lat_len == series->lat_size) {
+		size_t size = series->lat_size ? series->lat_size * 2 : 64;
+		uint32_t *lat;
+
+		lat = reallocarray(series->lat, size, sizeof(*lat));
+		if (!lat)
+			return;
+
+		series->lat = lat;
+		series->lat_size = size;
+	}
+
+	usec = latency->tv_sec * 1000000ll + latency->tv_usec;
+	series->lat[series->lat_len++] = usec < 0 ? 0 :
+				(usec > UINT32_MAX ? UINT32_MAX : usec);
+}
+
+static const char *conn_type_str(uint8_t type)
+{
+	switch (type) {
+	case CONN_BR_ACL:
+		return "BR-ACL";
+	case CONN_BR_SCO:
+		return "BR-SCO";
+	case CONN_BR_ESCO:
+		return "BR-ESCO";
+	case CONN_LE_ACL:
+		return "LE-ACL";
+	case CONN_LE_ISO:
+		return "LE-ISO";
+	}
+
+	return "unknown";
+}
+
+static void export_write_row(void *data, void *user_data)
+{
+	struct export_row *row = data;
+	struct hci_conn *conn = user_data;
+	const uint8_t *a = conn->bdaddr;
+
+	if (export_json) {
+		fprintf(export_file, "%s\n      { \"time\": %lld, "
+			"\"tx_bytes\": %zu, \"rx_bytes\": %zu, "
+			"\"tx_packets\": %zu, \"rx_packets\": %zu",
+			export_first ? "" : ",", row->msec,
+			row->tx_bytes, row->rx_bytes, row->tx_num, row->rx_num);
+
+		if (row->lat_num)
+			fprintf(export_file, ", \"latency_p50\": %u, "
+				"\"latency_p90\": %u, \"latency_p99\": %u",
+				row->lat_p50, row->lat_p90, row->lat_p99);
+
+		if (row->has_jitter)
+			fprintf(export_file, ", \"jitter\": %u", row->jitter);
+
+		fprintf(export_file, " }");
+		export_first = false;
+		return;
+	}
+
+	fprintf(export_file, "%u,%u,%s,%2.2X:%2.2X:%2.2X:%2.2X:%2.2X:%2.2X,"
+			"%lld,%zu,%zu,%zu,%zu,", conn->index, conn->handle,
+			conn_type_str(conn->type), a[5], a[4], a[3], a[2],
+			a[1], a[0], row->msec, row->tx_bytes, row->rx_bytes,
+			row->tx_num, row->rx_num);
+
+	if (row->lat_num)
+		fprintf(export_file, "%u,%u,%u,", row->lat_p50, row->lat_p90,
+							row->lat_p99);
+	else
+		fprintf(export_file, ",,,");
+
+	if (row->has_jitter)
+		fprintf(export_file, "%u\n", row->jitter);
+	else
+		fprintf(export_file, "\n");
+}
+
+static void export_conn(struct hci_conn *conn)
+{
+	struct export_series *series = conn->export;
+	const uint8_t *a = conn->bdaddr;
+	static bool first = true;
+
+	export_flush(series);
+
+	if (queue_isempty(series->rows))
+		return;
+
+	if (export_json) {
+		fprintf(export_file, "%s\n  { \"index\": %u, \"handle\": %u, "
+			"\"type\": \"%s\", \"address\": "
+			"\"%2.2X:%2.2X:%2.2X:%2.2X:%2.2X:%2.2X\",\n"
+			"    \"interval\": %u, \"samples\": [",
+			first ? "" : ",", conn->index, conn->handle,
+			conn_type_str(conn->type), a[5], a[4], a[3], a[2],
+			a[1], a[0], EXPORT_INTERVAL);
+		export_first = true;
+	}
+
+	queue_foreach(series->rows, export_write_row, conn);
+
+	if (export_json)
+		fprintf(export_file, "\n    ] }");
+
+	first = false;
+}
+
+static bool export_open(const char *path)
+{
+	const char *ext;
+
+	export_file = fopen(path, "w");
+	if (!export_file) {
+		perror("Failed to open export file");
+		return false;
+	}
+
+	ext = strrchr(path, '.');
+	export_json = ext && !strcasecmp(ext, ".json");
+
+	if (export_json)
+		fprintf(export_file, "{ \"connections\": [");
+	else
+		fprintf(export_file, "index,handle,type,address,time,"
+				"tx_bytes,rx_bytes,tx_packets,rx_packets,"
+				"latency_p50,latency_p90,latency_p99,"
+				"jitter\n");
+
+	return true;
+}
+
+static void export_close(void)
+{
+	if (!export_file)
+		return;
+
+	if (export_json)
+		fprintf(export_file, "\n] }\n");
+
+	fclose(export_file);
+	export_file = NULL;
+}
 
 static void tmp_write(void *data, void *user_data)
 {
@@ -151,6 +505,9 @@ static void print_stats(struct hci_stats *stats, const char *label)
 	print_field("%s size: %u-%u octets (~%zd octets)", label,
 			stats->min, stats->max, stats->bytes / stats->num);
 
+	if (stats->num_att)
+		print_field("%s ATT PDUs: %zu", label, stats->num_att);
+
 	if (TV_MSEC(stats->latency.total))
 		print_field("%s speed: ~%lld Kb/s", label,
 			stats->bytes * 8 / TV_MSEC(stats->latency.total));
@@ -158,6 +515,15 @@ static void print_stats(struct hci_stats *stats, const char *label)
 	plot_draw(stats->plot, label);
 }
 
+static void chan_free(void *data)
+{
+	struct l2cap_chan *chan = data;
+
+	queue_destroy(chan->rx.plot, free);
+	queue_destroy(chan->tx.plot, free);
+	free(chan);
+}
+
 static void chan_destroy(void *data)
 {
 	struct l2cap_chan *chan = data;
@@ -174,7 +540,7 @@ static void chan_destroy(void *data)
 	print_stats(&chan->tx, "TX");
 
 done:
-	free(chan);
+	chan_free(chan);
 }
 
 static struct l2cap_chan *chan_alloc(struct hci_conn *conn, uint16_t cid,
@@ -202,13 +568,21 @@ static bool chan_match_cid(const void *a, const void *b)
 	return chan->cid == cid && chan->out == out;
 }
 
+static unsigned int chan_hash(const void *data)
+{
+	const struct l2cap_chan *chan = data;
+
+	return chan->cid | (chan->out ? 0x10000 : 0);
+}
+
 static struct l2cap_chan *chan_lookup(struct hci_conn *conn, uint16_t cid,
 								bool out)
 {
 	struct l2cap_chan *chan;
 	uint32_t val = cid | (out ? 0x10000 : 0);
 
-	chan = queue_find(conn->chan_list, chan_match_cid, UINT_TO_PTR(val));
+	chan = queue_find_hash(conn->chan_list, val, chan_match_cid,
+							UINT_TO_PTR(val));
 	if (!chan) {
 		chan = chan_alloc(conn, cid, out);
 		queue_push_tail(conn->chan_list, chan);
@@ -217,33 +591,31 @@ static struct l2cap_chan *chan_lookup(struct hci_conn *conn, uint16_t cid,
 	return chan;
 }
 
-static void conn_destroy(void *data)
+static void conn_free(void *data)
 {
 	struct hci_conn *conn = data;
-	const char *str;
 
-	switch (conn->type) {
-	case CONN_BR_ACL:
-		str = "BR-ACL";
-		break;
-	case CONN_BR_SCO:
-		str = "BR-SCO";
-		break;
-	case CONN_BR_ESCO:
-		str = "BR-ESCO";
-		break;
-	case CONN_LE_ACL:
-		str = "LE-ACL";
-		break;
-	case CONN_LE_ISO:
-		str = "LE-ISO";
-		break;
-	default:
-		str = "unknown";
-		break;
+	queue_destroy(conn->rx.plot, free);
+	queue_destroy(conn->tx.plot, free);
+	queue_destroy(conn->chan_list, chan_free);
+
+	queue_destroy(conn->tx_queue, free);
+
+	if (conn->export) {
+		queue_destroy(conn->export->rows, free);
+		free(conn->export->lat);
+		free(conn->export);
 	}
 
-	printf("  Found %s connection with handle %u\n", str, conn->handle);
+	free(conn);
+}
+
+static void conn_destroy(void *data)
+{
+	struct hci_conn *conn = data;
+
+	printf("  Found %s connection with handle %u\n",
+				conn_type_str(conn->type), conn->handle);
 	/* TODO: Store address type */
 	packet_print_addr("Address", conn->bdaddr, 0x00);
 	if (!conn->setup_seen)
@@ -251,12 +623,13 @@ static void conn_destroy(void *data)
 	print_stats(&conn->rx, "RX");
 	print_stats(&conn->tx, "TX");
 
-	queue_destroy(conn->rx.plot, free);
-	queue_destroy(conn->tx.plot, free);
 	queue_destroy(conn->chan_list, chan_destroy);
+	conn->chan_list = NULL;
 
-	queue_destroy(conn->tx_queue, free);
-	free(conn);
+	if (conn->export)
+		export_conn(conn);
+
+	conn_free(conn);
 }
 
 static struct hci_conn *conn_alloc(struct hci_dev *dev, uint16_t handle,
@@ -266,6 +639,7 @@ static struct hci_conn *conn_alloc(struct hci_dev *dev, uint16_t handle,
 
 	conn = new0(struct hci_conn, 1);
 
+	conn->index = dev->index;
 	conn->handle = handle;
 	conn->type = type;
 	conn->tx_queue = queue_new();
@@ -273,6 +647,13 @@ static struct hci_conn *conn_alloc(struct hci_dev *dev, uint16_t handle,
 	conn->rx.plot = queue_new();
 
 	conn->chan_list = queue_new();
+	queue_set_hash(conn->chan_list, chan_hash);
+
+	if (export_file) {
+		conn->export = new0(struct export_series, 1);
+		conn->export->rows = queue_new();
+		conn->export->cur.msec = -1;
+	}
 
 	return conn;
 }
@@ -285,9 +666,16 @@ static bool conn_match_handle(const void *a, const void *b)
 	return (conn->handle == handle && !conn->terminated);
 }
 
+static unsigned int conn_hash(const void *data)
+{
+	const struct hci_conn *conn = data;
+
+	return conn->handle;
+}
+
 static struct hci_conn *conn_lookup(struct hci_dev *dev, uint16_t handle)
 {
-	return queue_find(dev->conn_list, conn_match_handle,
+	return queue_find_hash(dev->conn_list, handle, conn_match_handle,
 						UINT_TO_PTR(handle));
 }
 
@@ -310,8 +698,7 @@ static struct hci_conn *conn_lookup_type(struct hci_dev *dev, uint16_t handle,
 {
 	struct hci_conn *conn;
 
-	conn = queue_find(dev->conn_list, conn_match_handle,
-						UINT_TO_PTR(handle));
+	conn = conn_lookup(dev, handle);
 	if (!conn || (type && conn->type != type)) {
 		conn = conn_alloc(dev, handle, type);
 		queue_push_tail(dev->conn_list, conn);
@@ -368,10 +755,13 @@ static struct hci_dev *dev_alloc(uint16_t index)
 
 	dev = new0(struct hci_dev, 1);
 
+	dev->seq_added = cur_seq;
+	dev->seq_removed = UINT64_MAX;
 	dev->index = index;
 	dev->manufacturer = 0xffff;
 
 	dev->conn_list = queue_new();
+	queue_set_hash(dev->conn_list, conn_hash);
 
 	return dev;
 }
@@ -451,6 +841,13 @@ static void del_index(struct timeval *tv, uint16_t index,
 		return;
 	}
 
+	/* Workers report removed controllers in order once they are done */
+	if (removed_list) {
+		dev->seq_removed = cur_seq;
+		queue_push_tail(removed_list, dev);
+		return;
+	}
+
 	dev_destroy(dev);
 }
 
@@ -511,6 +908,28 @@ static void rsp_read_bd_addr(struct hci_dev *dev, struct timeval *tv,
 	memcpy(dev->bdaddr, rsp->bdaddr, 6);
 }
 
+static void rsp_read_buffer_size(struct hci_dev *dev, struct timeval *tv,
+					const void *data, uint16_t size)
+{
+	const struct bt_hci_rsp_read_buffer_size *rsp = data;
+
+	if (size < sizeof(*rsp) || rsp->status)
+		return;
+
+	dev->acl_max_pkt = le16_to_cpu(rsp->acl_max_pkt);
+}
+
+static void rsp_le_read_buffer_size(struct hci_dev *dev, struct timeval *tv,
+					const void *data, uint16_t size)
+{
+	const struct bt_hci_rsp_le_read_buffer_size *rsp = data;
+
+	if (size < sizeof(*rsp) || rsp->status)
+		return;
+
+	dev->le_max_pkt = rsp->le_max_pkt;
+}
+
 static void evt_cmd_complete(struct hci_dev *dev, struct timeval *tv,
 					const void *data, uint16_t size)
 {
@@ -526,6 +945,12 @@ static void evt_cmd_complete(struct hci_dev *dev, struct timeval *tv,
 	case BT_HCI_CMD_READ_BD_ADDR:
 		rsp_read_bd_addr(dev, tv, data, size);
 		break;
+	case BT_HCI_CMD_READ_BUFFER_SIZE:
+		rsp_read_buffer_size(dev, tv, data, size);
+		break;
+	case BT_HCI_CMD_LE_READ_BUFFER_SIZE:
+		rsp_le_read_buffer_size(dev, tv, data, size);
+		break;
 	}
 }
 
@@ -628,6 +1053,7 @@ static void evt_num_completed_packets(struct hci_dev *dev, struct timeval *tv,
 
 				packet_latency_add(&conn->tx.latency, &res);
 				plot_add(conn->tx.plot, &res, 1);
+				export_latency(conn, tv, &res);
 
 				if (chan) {
 					chan->tx.num_comp += count;
@@ -838,6 +1264,7 @@ static void conn_pkt_tx(struct hci_conn *conn, struct timeval *tv,
 	queue_push_tail(conn->tx_queue, last_tx);
 
 	stats_add(&conn->tx, size);
+	export_tx(conn, tv, size);
 
 	if (chan)
 		stats_add(&chan->tx, size);
@@ -858,6 +1285,7 @@ static void conn_pkt_rx(struct hci_conn *conn, struct timeval *tv,
 
 	stats_add(&conn->rx, size);
 	conn->rx.num_comp++;
+	export_rx(conn, tv, size);
 
 	if (chan) {
 		if (timerisset(&chan->last_rx)) {
@@ -881,6 +1309,7 @@ static void acl_pkt(struct timeval *tv, uint16_t index, bool out,
 	struct hci_conn *conn;
 	struct l2cap_chan *chan = NULL;
 	uint16_t cid;
+	bool att = false;
 
 	data += sizeof(*hdr);
 	size -= sizeof(*hdr);
@@ -899,24 +1328,37 @@ static void acl_pkt(struct timeval *tv, uint16_t index, bool out,
 	switch (le16_to_cpu(hdr->handle) >> 12) {
 	case 0x00:
 	case 0x02:
+		if (size < 4)
+			break;
+
 		cid = get_le16(data + 2);
 		chan = chan_lookup(conn, cid, out);
 		if (cid == 1)
 			l2cap_sig(conn, out, data + 4, size - 4);
+
+		att = cid == 0x0004 || chan->psm == 0x001f;
 		break;
 	}
 
+	if (att) {
+		if (out)
+			conn->tx.num_att++;
+		else
+			conn->rx.num_att++;
+	}
+
+	/* Account the header length so truncated captures add up */
 	if (out) {
-		conn_pkt_tx(conn, tv, size, chan);
+		conn_pkt_tx(conn, tv, le16_to_cpu(hdr->dlen), chan);
 	} else {
-		conn_pkt_rx(conn, tv, size, chan);
+		conn_pkt_rx(conn, tv, le16_to_cpu(hdr->dlen), chan);
 	}
 }
 
 static void sco_pkt(struct timeval *tv, uint16_t index, bool out,
 					const void *data, uint16_t size)
 {
-	const struct bt_hci_acl_hdr *hdr = data;
+	const struct bt_hci_sco_hdr *hdr = data;
 	struct hci_dev *dev;
 	struct hci_conn *conn;
 
@@ -933,9 +1375,9 @@ static void sco_pkt(struct timeval *tv, uint16_t index, bool out,
 		return;
 
 	if (out) {
-		conn_pkt_tx(conn, tv, size - sizeof(*hdr), NULL);
+		conn_pkt_tx(conn, tv, hdr->dlen, NULL);
 	} else {
-		conn_pkt_rx(conn, tv, size - sizeof(*hdr), NULL);
+		conn_pkt_rx(conn, tv, hdr->dlen, NULL);
 	}
 }
 
@@ -1020,9 +1462,9 @@ static void iso_pkt(struct timeval *tv, uint16_t index, bool out,
 		return;
 
 	if (out) {
-		conn_pkt_tx(conn, tv, size - sizeof(*hdr), NULL);
+		conn_pkt_tx(conn, tv, le16_to_cpu(hdr->dlen) & 0x3fff, NULL);
 	} else {
-		conn_pkt_rx(conn, tv, size - sizeof(*hdr), NULL);
+		conn_pkt_rx(conn, tv, le16_to_cpu(hdr->dlen) & 0x3fff, NULL);
 	}
 }
 
@@ -1038,10 +1480,405 @@ static void unknown_opcode(struct timeval *tv, uint16_t index,
 	dev->unknown++;
 }
 
-void analyze_trace(const char *path)
+static void process_record(struct timeval *tv, uint16_t index,
+				uint16_t opcode, const void *data, uint16_t size)
+{
+	switch (opcode) {
+	case BTSNOOP_OPCODE_NEW_INDEX:
+		new_index(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_DEL_INDEX:
+		del_index(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		command_pkt(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		event_pkt(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+		acl_pkt(tv, index, true, data, size);
+		break;
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+		acl_pkt(tv, index, false, data, size);
+		break;
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+		sco_pkt(tv, index, true, data, size);
+		break;
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+		sco_pkt(tv, index, false, data, size);
+		break;
+	case BTSNOOP_OPCODE_OPEN_INDEX:
+	case BTSNOOP_OPCODE_CLOSE_INDEX:
+		break;
+	case BTSNOOP_OPCODE_INDEX_INFO:
+		info_index(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_VENDOR_DIAG:
+		vendor_diag(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_SYSTEM_NOTE:
+		system_note(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_USER_LOGGING:
+		user_log(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_CTRL_OPEN:
+	case BTSNOOP_OPCODE_CTRL_CLOSE:
+	case BTSNOOP_OPCODE_CTRL_COMMAND:
+	case BTSNOOP_OPCODE_CTRL_EVENT:
+		ctrl_msg(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+		iso_pkt(tv, index, true, data, size);
+		break;
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		iso_pkt(tv, index, false, data, size);
+		break;
+	default:
+		unknown_opcode(tv, index, data, size);
+		break;
+	}
+}
+
+static size_t record_len(uint16_t size)
+{
+	return (sizeof(struct record) + size + 7) & ~7;
+}
+
+static void worker_push(struct worker *worker, struct batch *batch)
+{
+	pthread_mutex_lock(&worker->lock);
+
+	while (worker->count == BATCH_QUEUE_MAX)
+		pthread_cond_wait(&worker->cond, &worker->lock);
+
+	worker->queue[(worker->head + worker->count) % BATCH_QUEUE_MAX] = batch;
+	worker->count++;
+
+	pthread_cond_broadcast(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+}
+
+static struct batch *worker_pop(struct worker *worker)
+{
+	struct batch *batch = NULL;
+
+	pthread_mutex_lock(&worker->lock);
+
+	while (!worker->count && !worker->done)
+		pthread_cond_wait(&worker->cond, &worker->lock);
+
+	if (worker->count) {
+		batch = worker->queue[worker->head];
+		worker->head = (worker->head + 1) % BATCH_QUEUE_MAX;
+		worker->count--;
+		pthread_cond_broadcast(&worker->cond);
+	}
+
+	pthread_mutex_unlock(&worker->lock);
+
+	return batch;
+}
+
+static void *worker_run(void *user_data)
+{
+	struct worker *worker = user_data;
+	struct batch *batch;
+
+	dev_list = queue_new();
+	removed_list = queue_new();
+
+	while ((batch = worker_pop(worker))) {
+		size_t offset = 0;
+
+		while (offset < batch->len) {
+			struct record *rec = (void *) (batch->buf + offset);
+
+			cur_seq = rec->seq;
+			process_record(&rec->tv, rec->index, rec->opcode,
+							rec->data, rec->size);
+			offset += record_len(rec->size);
+		}
+
+		free(batch);
+	}
+
+	worker->dev_list = dev_list;
+	worker->removed_list = removed_list;
+
+	return NULL;
+}
+
+static void worker_add(struct worker *worker, struct timeval *tv,
+				uint64_t seq, uint16_t index, uint16_t opcode,
+				const void *data, uint16_t size)
+{
+	struct record *rec;
+
+	if (worker->batch && worker->batch->len + record_len(size) >
+								BATCH_SIZE) {
+		worker_push(worker, worker->batch);
+		worker->batch = NULL;
+	}
+
+	if (!worker->batch)
+		worker->batch = new0(struct batch, 1);
+
+	rec = (void *) (worker->batch->buf + worker->batch->len);
+	rec->tv = *tv;
+	rec->seq = seq;
+	rec->index = index;
+	rec->opcode = opcode;
+	rec->size = size;
+	memcpy(rec->data, data, size);
+
+	worker->batch->len += record_len(size);
+}
+
+static void worker_done(struct worker *worker)
+{
+	if (worker->batch) {
+		worker_push(worker, worker->batch);
+		worker->batch = NULL;
+	}
+
+	pthread_mutex_lock(&worker->lock);
+	worker->done = true;
+	pthread_cond_broadcast(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+
+	pthread_join(worker->thread, NULL);
+
+	pthread_cond_destroy(&worker->cond);
+	pthread_mutex_destroy(&worker->lock);
+}
+
+static int dev_cmp(const void *a, const void *b)
+{
+	const struct hci_dev *dev_a = *(struct hci_dev * const *) a;
+	const struct hci_dev *dev_b = *(struct hci_dev * const *) b;
+
+	if (dev_a->seq_removed != dev_b->seq_removed)
+		return dev_a->seq_removed < dev_b->seq_removed ? -1 : 1;
+
+	if (dev_a->seq_added != dev_b->seq_added)
+		return dev_a->seq_added < dev_b->seq_added ? -1 : 1;
+
+	return 0;
+}
+
+static void dev_collect(void *data, void *user_data)
+{
+	struct hci_dev ***ptr = user_data;
+
+	*(*ptr)++ = data;
+}
+
+static unsigned int get_num_workers(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* One CPU is left for reading the trace */
+	if (cpus <= 2)
+		return 0;
+
+	return cpus - 1 < WORKERS_MAX ? cpus - 1 : WORKERS_MAX;
+}
+
+/* Controllers are independent of each other, so records are sharded by
+ * controller index and each worker owns the controllers it sees. The
+ * results are printed in the same order as a sequential run would.
+ */
+static void analyze_parallel(struct btsnoop *btsnoop_file,
+						unsigned int num_workers)
+{
+	struct worker workers[WORKERS_MAX];
+	struct hci_dev **devs, **ptr;
+	unsigned long num_packets = 0;
+	size_t num_devs = 0, i, n;
+
+	memset(workers, 0, sizeof(workers));
+
+	for (i = 0; i < num_workers; i++) {
+		pthread_mutex_init(&workers[i].lock, NULL);
+		pthread_cond_init(&workers[i].cond, NULL);
+		pthread_create(&workers[i].thread, NULL, worker_run,
+								&workers[i]);
+	}
+
+	while (1) {
+		unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
+		struct timeval tv;
+		uint16_t index, opcode, pktlen;
+
+		if (!btsnoop_read_hci(btsnoop_file, &tv, &index, &opcode,
+								buf, &pktlen))
+			break;
+
+		worker_add(&workers[index % num_workers], &tv, num_packets,
+						index, opcode, buf, pktlen);
+
+		num_packets++;
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		worker_done(&workers[i]);
+		num_devs += queue_length(workers[i].dev_list);
+		num_devs += queue_length(workers[i].removed_list);
+	}
+
+	devs = new0(struct hci_dev *, num_devs + 1);
+	ptr = devs;
+
+	for (i = 0; i < num_workers; i++) {
+		queue_foreach(workers[i].removed_list, dev_collect, &ptr);
+		queue_foreach(workers[i].dev_list, dev_collect, &ptr);
+		queue_destroy(workers[i].removed_list, NULL);
+		queue_destroy(workers[i].dev_list, NULL);
+	}
+
+	qsort(devs, num_devs, sizeof(*devs), dev_cmp);
+
+	for (n = 0; n < num_devs && devs[n]->seq_removed != UINT64_MAX; n++)
+		dev_destroy(devs[n]);
+
+	printf("Trace contains %lu packets\n\n", num_packets);
+
+	for (; n < num_devs; n++)
+		dev_destroy(devs[n]);
+
+	free(devs);
+}
+
+static bool conn_match_terminated(const void *data, const void *user_data)
+{
+	const struct hci_conn *conn = data;
+
+	return conn->terminated;
+}
+
+static void live_print_conn(void *data, void *user_data)
+{
+	struct hci_conn *conn = data;
+	long long msec = *(long long *) user_data;
+	const uint8_t *a = conn->bdaddr;
+	size_t att = conn->rx.num_att + conn->tx.num_att;
+
+	printf("  %-7s %6u  %2.2X:%2.2X:%2.2X:%2.2X:%2.2X:%2.2X"
+			"  %10zu %10zu %8u %8zu\n",
+			conn_type_str(conn->type), conn->handle,
+			a[5], a[4], a[3], a[2], a[1], a[0],
+			(conn->rx.bytes - conn->live_rx_bytes) * 1000 / msec,
+			(conn->tx.bytes - conn->live_tx_bytes) * 1000 / msec,
+			queue_length(conn->tx_queue),
+			(att - conn->live_att) * 1000 / msec);
+
+	conn->live_rx_bytes = conn->rx.bytes;
+	conn->live_tx_bytes = conn->tx.bytes;
+	conn->live_att = att;
+}
+
+static void live_count_pending(void *data, void *user_data)
+{
+	struct hci_conn *conn = data;
+	unsigned int *pending = user_data;
+
+	switch (conn->type) {
+	case CONN_LE_ACL:
+		pending[1] += queue_length(conn->tx_queue);
+		break;
+	case CONN_BR_ACL:
+	case 0x00:
+		pending[0] += queue_length(conn->tx_queue);
+		break;
+	}
+}
+
+static void live_print_dev(void *data, void *user_data)
+{
+	struct hci_dev *dev = data;
+	unsigned int pending[2] = { 0, 0 };
+
+	/* Connections are only kept for as long as they are shown */
+	queue_remove_all(dev->conn_list, conn_match_terminated, NULL,
+								conn_free);
+
+	queue_foreach(dev->conn_list, live_count_pending, pending);
+
+	/* Without dedicated LE buffers the ACL ones are shared */
+	if (!dev->le_max_pkt) {
+		pending[0] += pending[1];
+		pending[1] = 0;
+	}
+
+	printf("hci%u  %2.2X:%2.2X:%2.2X:%2.2X:%2.2X:%2.2X"
+			"  ACL buffers %u/%u", dev->index,
+			dev->bdaddr[5], dev->bdaddr[4], dev->bdaddr[3],
+			dev->bdaddr[2], dev->bdaddr[1], dev->bdaddr[0],
+			pending[0], dev->acl_max_pkt);
+	if (dev->le_max_pkt)
+		printf("  LE buffers %u/%u", pending[1], dev->le_max_pkt);
+	printf("\n");
+
+	if (queue_isempty(dev->conn_list))
+		return;
+
+	printf("  %-7s %6s  %-17s  %10s %10s %8s %8s\n", "Type", "Handle",
+			"Address", "RX B/s", "TX B/s", "Pending", "ATT/s");
+	queue_foreach(dev->conn_list, live_print_conn, user_data);
+}
+
+static void live_timeout(int id, void *user_data)
+{
+	struct timespec ts;
+	long long msec;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	msec = (ts.tv_sec - live_ts.tv_sec) * 1000 +
+				(ts.tv_nsec - live_ts.tv_nsec) / 1000000;
+	live_ts = ts;
+
+	if (msec <= 0)
+		msec = 1;
+
+	if (isatty(STDOUT_FILENO))
+		printf("\x1b[H\x1b[2J");
+
+	queue_foreach(dev_list, live_print_dev, &msec);
+	printf("\n");
+	fflush(stdout);
+
+	mainloop_modify_timeout(id, LIVE_INTERVAL);
+}
+
+bool analyze_live(void)
+{
+	if (live_id >= 0)
+		return true;
+
+	clock_gettime(CLOCK_MONOTONIC, &live_ts);
+	live_id = mainloop_add_timeout(LIVE_INTERVAL, live_timeout,
+								NULL, NULL);
+	if (live_id < 0)
+		return false;
+
+	dev_list = queue_new();
+
+	return true;
+}
+
+void analyze_packet(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size)
+{
+	process_record(tv, index, opcode, data, size);
+}
+
+void analyze_trace(const char *path, const char *export_path)
 {
 	struct btsnoop *btsnoop_file;
 	unsigned long num_packets = 0;
+	unsigned int num_workers;
 	uint32_t format;
 
 	btsnoop_file = btsnoop_open(path, BTSNOOP_FLAG_PKLG_SUPPORT);
@@ -1060,6 +1897,15 @@ void analyze_trace(const char *path)
 		goto done;
 	}
 
+	if (export_path && !export_open(export_path))
+		goto done;
+
+	num_workers = get_num_workers();
+	if (num_workers) {
+		analyze_parallel(btsnoop_file, num_workers);
+		goto done;
+	}
+
 	dev_list = queue_new();
 
 	while (1) {
@@ -1071,62 +1917,7 @@ void analyze_trace(const char *path)
 								buf, &pktlen))
 			break;
 
-		switch (opcode) {
-		case BTSNOOP_OPCODE_NEW_INDEX:
-			new_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_DEL_INDEX:
-			del_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_COMMAND_PKT:
-			command_pkt(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_EVENT_PKT:
-			event_pkt(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ACL_TX_PKT:
-			acl_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ACL_RX_PKT:
-			acl_pkt(&tv, index, false, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SCO_TX_PKT:
-			sco_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SCO_RX_PKT:
-			sco_pkt(&tv, index, false, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_OPEN_INDEX:
-		case BTSNOOP_OPCODE_CLOSE_INDEX:
-			break;
-		case BTSNOOP_OPCODE_INDEX_INFO:
-			info_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_VENDOR_DIAG:
-			vendor_diag(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SYSTEM_NOTE:
-			system_note(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_USER_LOGGING:
-			user_log(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_CTRL_OPEN:
-		case BTSNOOP_OPCODE_CTRL_CLOSE:
-		case BTSNOOP_OPCODE_CTRL_COMMAND:
-		case BTSNOOP_OPCODE_CTRL_EVENT:
-			ctrl_msg(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ISO_TX_PKT:
-			iso_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ISO_RX_PKT:
-			iso_pkt(&tv, index, false, buf, pktlen);
-			break;
-		default:
-			unknown_opcode(&tv, index, buf, pktlen);
-			break;
-		}
+		process_record(&tv, index, opcode, buf, pktlen);
 
 		num_packets++;
 	}
@@ -1136,5 +1927,6 @@ void analyze_trace(const char *path)
 	queue_destroy(dev_list, dev_destroy);
 
 done:
+	export_close();
 	btsnoop_unref(btsnoop_file);
 }
@@ -9,4 +9,7 @@
  *
  */
 
-void analyze_trace(const char *path);
+void analyze_trace(const char *path, const char *export_path);
+bool analyze_live(void);
+void analyze_packet(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size);
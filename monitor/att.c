@@ -23,6 +23,8 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <limits.h>
+#include <unistd.h>
+#include <time.h>
 #include <sys/stat.h>
 
 #include <glib.h>
@@ -56,19 +58,28 @@ struct att_read {
 
 struct att_conn_data {
 	struct gatt_db *ldb;
-	struct timespec ldb_mtim;
+	char *lfile;
 	struct gatt_db *rdb;
-	struct timespec rdb_mtim;
+	char *rfile;
 	struct queue *reads;
 	uint16_t mtu;
 };
 
 struct gatt_cache {
+	bdaddr_t src;
 	bdaddr_t id;
 	struct gatt_db *db;
 };
 
+struct gatt_file {
+	char *filename;
+	struct timespec mtim;
+	time_t checked;
+	struct gatt_db *db;
+};
+
 static struct queue *cache_list;
+static struct queue *file_list;
 
 static void print_uuid(const char *label, const void *data, uint16_t size)
 {
@@ -407,28 +418,38 @@ static const struct bitfield_data chrc_prop_table[] = {
 static bool match_cache_id(const void *data, const void *match_data)
 {
 	const struct gatt_cache *cache = data;
-	const bdaddr_t *id = match_data;
+	const struct gatt_cache *match = match_data;
 
-	return !bacmp(&cache->id, id);
+	return !bacmp(&cache->src, &match->src) &&
+					!bacmp(&cache->id, &match->id);
 }
 
-static void gatt_cache_add(struct packet_conn_data *conn, struct gatt_db *db)
+static void gatt_cache_key(struct packet_conn_data *conn,
+						struct gatt_cache *key)
 {
-	struct gatt_cache *cache;
-	bdaddr_t id;
 	uint8_t id_type;
 
-	if (!keys_resolve_identity(conn->dst, id.b, &id_type))
-		bacpy(&id, (bdaddr_t *)conn->dst);
+	bacpy(&key->src, (bdaddr_t *)conn->src);
+
+	if (!keys_resolve_identity(conn->dst, key->id.b, &id_type))
+		bacpy(&key->id, (bdaddr_t *)conn->dst);
+}
+
+static void gatt_cache_add(struct packet_conn_data *conn, struct gatt_db *db)
+{
+	struct gatt_cache *cache, key;
+
+	gatt_cache_key(conn, &key);
 
-	if (queue_find(cache_list, match_cache_id, &id))
+	if (queue_find(cache_list, match_cache_id, &key))
 		return;
 
 	if (!cache_list)
 		cache_list = queue_new();
 
 	cache = new0(struct gatt_cache, 1);
-	bacpy(&cache->id, &id);
+	bacpy(&cache->src, &key.src);
+	bacpy(&cache->id, &key.id);
 	cache->db = gatt_db_ref(db);
 	queue_push_tail(cache_list, cache);
 }
@@ -442,6 +463,8 @@ static void att_conn_data_free(struct packet_conn_data *conn, void *data)
 
 	gatt_db_unref(att_data->rdb);
 	gatt_db_unref(att_data->ldb);
+	free(att_data->rfile);
+	free(att_data->lfile);
 	queue_destroy(att_data->reads, free);
 	free(att_data);
 }
@@ -467,26 +490,66 @@ static struct att_conn_data *att_get_conn_data(struct packet_conn_data *conn)
 	return data;
 }
 
-static void gatt_load_db(struct gatt_db *db, const char *filename,
-						struct timespec *mtim)
+static bool match_file(const void *data, const void *match_data)
+{
+	const struct gatt_file *file = data;
+
+	return !strcmp(file->filename, match_data);
+}
+
+/*
+ * Files are loaded once and shared by every connection to the same devices,
+ * they are only reloaded if modified which is checked at most once a second.
+ */
+static struct gatt_db *gatt_load_db(const char *filename)
 {
+	struct gatt_file *file;
+	struct timespec now;
 	struct stat st;
 
-	if (lstat(filename, &st))
-		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	if (!gatt_db_isempty(db)) {
-		/* Check if file has been modified since last time */
-		if (st.st_mtim.tv_sec == mtim->tv_sec &&
-				    st.st_mtim.tv_nsec == mtim->tv_nsec)
-			return;
-		/* Clear db before reloading */
-		gatt_db_clear(db);
+	file = queue_find(file_list, match_file, filename);
+	if (file && file->checked == now.tv_sec)
+		return file->db;
+
+	if (!file) {
+		if (!file_list)
+			file_list = queue_new();
+
+		file = new0(struct gatt_file, 1);
+		file->filename = strdup(filename);
+		queue_push_tail(file_list, file);
 	}
 
-	*mtim = st.st_mtim;
+	file->checked = now.tv_sec;
+
+	if (lstat(filename, &st))
+		return file->db;
+
+	/* Check if file has been modified since last time */
+	if (file->db && st.st_mtim.tv_sec == file->mtim.tv_sec &&
+				st.st_mtim.tv_nsec == file->mtim.tv_nsec)
+		return file->db;
+
+	file->mtim = st.st_mtim;
+
+	gatt_db_unref(file->db);
+	file->db = gatt_db_new();
+
+	if (btd_settings_gatt_db_load_cache(file->db, filename) < 0)
+		btd_settings_gatt_db_load(file->db, filename);
+
+	return file->db;
+}
+
+static void set_db(struct gatt_db **dst, struct gatt_db *db)
+{
+	if (!db || *dst == db || gatt_db_isempty(db))
+		return;
 
-	btd_settings_gatt_db_load(db, filename);
+	gatt_db_unref(*dst);
+	*dst = gatt_db_ref(db);
 }
 
 static void load_gatt_db(struct packet_conn_data *conn)
@@ -495,31 +558,38 @@ static void load_gatt_db(struct packet_conn_data *conn)
 	char filename[PATH_MAX];
 	char local[18];
 	char peer[18];
-	bdaddr_t id;
-	uint8_t id_type;
 
-	ba2str((bdaddr_t *)conn->src, local);
+	/* Resolve file names only once per connection */
+	if (!data->lfile) {
+		struct gatt_cache key;
 
-	if (keys_resolve_identity(conn->dst, id.b, &id_type)) {
-		ba2str(&id, peer);
-	} else {
-		bacpy(&id, (bdaddr_t *)conn->dst);
-		ba2str((bdaddr_t *)conn->dst, peer);
-	}
+		gatt_cache_key(conn, &key);
+		ba2str(&key.src, local);
+		ba2str(&key.id, peer);
 
-	create_filename(filename, PATH_MAX, "/%s/attributes", local);
-	gatt_load_db(data->ldb, filename, &data->ldb_mtim);
+		create_filename(filename, PATH_MAX, "/%s/attributes", local);
+		data->lfile = strdup(filename);
 
-	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
-	gatt_load_db(data->rdb, filename, &data->rdb_mtim);
+		create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt", local,
+									peer);
+		if (access(filename, F_OK) < 0)
+			create_filename(filename, PATH_MAX, "/%s/cache/%s",
+								local, peer);
+		data->rfile = strdup(filename);
+	}
+
+	set_db(&data->ldb, gatt_load_db(data->lfile));
+	set_db(&data->rdb, gatt_load_db(data->rfile));
 
 	/* If rdb cannot be loaded from file try local cache */
 	if (gatt_db_isempty(data->rdb)) {
-		struct gatt_cache *cache;
+		struct gatt_cache *cache, key;
+
+		gatt_cache_key(conn, &key);
 
-		cache = queue_find(cache_list, match_cache_id, &id);
+		cache = queue_find(cache_list, match_cache_id, &key);
 		if (cache)
-			data->rdb = gatt_db_ref(cache->db);
+			set_db(&data->rdb, cache->db);
 	}
 }
 
@@ -26,9 +26,11 @@
 #include <sys/un.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
 #include <termios.h>
 #include <fcntl.h>
-#include <linux/filter.h>
+#include <signal.h>
+#include <pthread.h>
 
 #include "lib/bluetooth.h"
 #include "lib/hci.h"
@@ -37,11 +39,14 @@
 #include "src/shared/util.h"
 #include "src/shared/btsnoop.h"
 #include "src/shared/mainloop.h"
+#include "src/shared/ringbuf.h"
+#include "src/shared/monitor-filter.h"
 
 #include "display.h"
 #include "packet.h"
 #include "hcidump.h"
 #include "ellisys.h"
+#include "analyze.h"
 #include "tty.h"
 #include "control.h"
 #include "jlink.h"
@@ -50,6 +55,10 @@ static struct btsnoop *btsnoop_file = NULL;
 static bool hcidump_fallback = false;
 static bool decode_control = true;
 static uint16_t filter_index = HCI_DEV_NONE;
+static size_t capture_size;
+static bool live_stats = false;
+
+#define CAPTURE_BATCH 256
 
 struct control_data {
 	uint16_t channel;
@@ -58,6 +67,27 @@ struct control_data {
 	uint16_t offset;
 };
 
+struct capture_frame {
+	struct timeval tv;
+	struct ucred cred;
+	uint16_t opcode;
+	uint16_t index;
+	uint16_t len;
+	uint8_t has_tv:1;
+	uint8_t has_cred:1;
+};
+
+struct capture_data {
+	int fd;
+	int event_fd;
+	struct ringbuf *ring;
+	pthread_t thread;
+	bool running;
+	unsigned int drops;
+	unsigned int total_drops;
+	unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
+};
+
 static void free_data(void *user_data)
 {
 	struct control_data *data = user_data;
@@ -900,6 +930,25 @@ void control_message(uint16_t opcode, const void *data, uint16_t size)
 	}
 }
 
+static void monitor_packet(struct timeval *tv, struct ucred *cred,
+				uint16_t index, uint16_t opcode,
+				const void *data, uint16_t size)
+{
+	struct timeval now;
+
+	if (live_stats) {
+		if (!tv) {
+			gettimeofday(&now, NULL);
+			tv = &now;
+		}
+
+		analyze_packet(tv, index, opcode, data, size);
+		return;
+	}
+
+	packet_monitor(tv, cred, index, opcode, data, size);
+}
+
 static void data_callback(int fd, uint32_t events, void *user_data)
 {
 	struct control_data *data = user_data;
@@ -970,7 +1019,7 @@ static void data_callback(int fd, uint32_t events, void *user_data)
 							data->buf, pktlen);
 			ellisys_inject_hci(tv, index, opcode,
 							data->buf, pktlen);
-			packet_monitor(tv, cred, index, opcode,
+			monitor_packet(tv, cred, index, opcode,
 							data->buf, pktlen);
 			break;
 		}
@@ -1020,35 +1069,202 @@ static int open_socket(uint16_t channel)
 	return fd;
 }
 
-static void attach_index_filter(int fd, uint16_t index)
+static void *capture_thread(void *user_data)
 {
-	struct sock_filter filters[] = {
-		/* Load MGMT index:
-		 * A <- MGMT index
-		 */
-		BPF_STMT(BPF_LD + BPF_B + BPF_ABS,
-					offsetof(struct mgmt_hdr, index)),
-		/* Accept if index is HCI_DEV_NONE:
-		 * A == HCI_DEV_NONE
-		 */
-		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, HCI_DEV_NONE, 0, 1),
-		/* return */
-		BPF_STMT(BPF_RET|BPF_K, 0x0fffffff), /* pass */
-		/* Accept if index match:
-		 * A == index
-		 */
-		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, index, 0, 1),
-		/* returns */
-		BPF_STMT(BPF_RET|BPF_K, 0x0fffffff), /* pass */
-		BPF_STMT(BPF_RET|BPF_K, 0), /* reject */
-	};
-	struct sock_fprog fprog = {
-		.len = sizeof(filters) / sizeof(filters[0]),
-		/* casting const away: */
-		.filter = filters,
-	};
+	struct capture_data *data = user_data;
+	unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
+	unsigned char control[64];
+	struct capture_frame frame;
+	struct mgmt_hdr hdr;
+	struct msghdr msg;
+	struct iovec iov[2];
+	uint64_t event = 1;
+
+	while (1) {
+		struct cmsghdr *cmsg;
+		ssize_t len;
+
+		iov[0].iov_base = &hdr;
+		iov[0].iov_len = MGMT_HDR_SIZE;
+		iov[1].iov_base = buf;
+		iov[1].iov_len = sizeof(buf);
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = 2;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		len = recvmsg(data->fd, &msg, 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (len < MGMT_HDR_SIZE)
+			continue;
+
+		memset(&frame, 0, sizeof(frame));
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET)
+				continue;
+
+			if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+				memcpy(&frame.tv, CMSG_DATA(cmsg),
+							sizeof(frame.tv));
+				frame.has_tv = 1;
+			}
+
+			if (cmsg->cmsg_type == SCM_CREDENTIALS) {
+				memcpy(&frame.cred, CMSG_DATA(cmsg),
+							sizeof(frame.cred));
+				frame.has_cred = 1;
+			}
+		}
+
+		frame.opcode = le16_to_cpu(hdr.opcode);
+		frame.index = le16_to_cpu(hdr.index);
+		frame.len = le16_to_cpu(hdr.len);
+		if (frame.len > len - MGMT_HDR_SIZE)
+			frame.len = len - MGMT_HDR_SIZE;
+
+		iov[0].iov_base = &frame;
+		iov[0].iov_len = sizeof(frame);
+		iov[1].iov_len = frame.len;
+
+		if (!ringbuf_pushv(data->ring, iov, 2)) {
+			__atomic_add_fetch(&data->drops, 1, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		/* Only wake up the decoder if it may have seen an empty ring */
+		if (ringbuf_len(data->ring) == sizeof(frame) + frame.len)
+			if (write(data->event_fd, &event, sizeof(event)) < 0)
+				break;
+	}
+
+	/* Let the decoder notice that the channel is gone */
+	close(data->fd);
+	__atomic_store_n(&data->fd, -1, __ATOMIC_SEQ_CST);
+
+	if (write(data->event_fd, &event, sizeof(event)) < 0)
+		return NULL;
+
+	return NULL;
+}
+
+static void capture_callback(int fd, uint32_t events, void *user_data)
+{
+	struct capture_data *data = user_data;
+	struct capture_frame frame;
+	unsigned int count = 0;
+	uint64_t event;
+
+	if (read(data->event_fd, &event, sizeof(event)) < 0 &&
+							errno != EAGAIN) {
+		mainloop_remove_fd(data->event_fd);
+		return;
+	}
+
+	while (count++ < CAPTURE_BATCH &&
+			ringbuf_pull(data->ring, &frame, sizeof(frame))) {
+		struct timeval *tv = frame.has_tv ? &frame.tv : NULL;
+		struct ucred *cred = frame.has_cred ? &frame.cred : NULL;
+		unsigned int drops;
+		char str[64];
+
+		if (ringbuf_pull(data->ring, data->buf, frame.len) != frame.len)
+			break;
+
+		drops = __atomic_exchange_n(&data->drops, 0, __ATOMIC_SEQ_CST);
+		if (drops) {
+			data->total_drops += drops;
+			snprintf(str, sizeof(str), "Dropped %u frames "
+					"(%u in total)", drops,
+					data->total_drops);
+			packet_system_note(tv, NULL, HCI_DEV_NONE, str);
+		}
+
+		btsnoop_write_hci(btsnoop_file, tv, frame.index, frame.opcode,
+					drops, data->buf, frame.len);
+		ellisys_inject_hci(tv, frame.index, frame.opcode,
+					data->buf, frame.len);
+		monitor_packet(tv, cred, frame.index, frame.opcode,
+					data->buf, frame.len);
+	}
+
+	if (ringbuf_len(data->ring)) {
+		/* Give other sources a chance before the next batch */
+		event = 1;
+		if (write(data->event_fd, &event, sizeof(event)) < 0)
+			mainloop_remove_fd(data->event_fd);
+		return;
+	}
+
+	if (__atomic_load_n(&data->fd, __ATOMIC_SEQ_CST) < 0)
+		mainloop_remove_fd(data->event_fd);
+}
+
+static void free_capture(void *user_data)
+{
+	struct capture_data *data = user_data;
+
+	if (data->running)
+		pthread_join(data->thread, NULL);
+	else
+		close(data->fd);
 
-	setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+	close(data->event_fd);
+	ringbuf_free(data->ring);
+	free(data);
+}
+
+static int open_capture(int fd)
+{
+	struct capture_data *data;
+	sigset_t mask, old;
+	int err;
+
+	data = new0(struct capture_data, 1);
+	data->fd = fd;
+
+	data->ring = ringbuf_new(capture_size);
+	if (!data->ring)
+		goto failed;
+
+	data->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (data->event_fd < 0)
+		goto failed;
+
+	if (mainloop_add_fd(data->event_fd, EPOLLIN, capture_callback,
+						data, free_capture) < 0) {
+		close(data->event_fd);
+		goto failed;
+	}
+
+	/* Signals are handled by the mainloop, not the capture thread */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &old);
+	err = pthread_create(&data->thread, NULL, capture_thread, data);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (err) {
+		mainloop_remove_fd(data->event_fd);
+		return -1;
+	}
+
+	data->running = true;
+
+	return 0;
+
+failed:
+	ringbuf_free(data->ring);
+	free(data);
+	close(fd);
+	return -1;
 }
 
 static int open_channel(uint16_t channel)
@@ -1069,7 +1285,15 @@ static int open_channel(uint16_t channel)
 	}
 
 	if (filter_index != HCI_DEV_NONE)
-		attach_index_filter(data->fd, filter_index);
+		monitor_filter_attach(data->fd, filter_index,
+						MONITOR_FILTER_ALL, 0);
+
+	if (channel == HCI_CHANNEL_MONITOR && capture_size) {
+		int fd = data->fd;
+
+		free(data);
+		return open_capture(fd);
+	}
 
 	if (mainloop_add_fd(data->fd, EPOLLIN, data_callback,
 						data, free_data) < 0) {
@@ -1327,7 +1551,7 @@ static void process_data(struct control_data *data)
 					hdr->ext_hdr + hdr->hdr_len, pktlen);
 		ellisys_inject_hci(tv, 0, opcode, hdr->ext_hdr + hdr->hdr_len,
 					pktlen);
-		packet_monitor(tv, NULL, 0, opcode,
+		monitor_packet(tv, NULL, 0, opcode,
 					hdr->ext_hdr + hdr->hdr_len, pktlen);
 
 		data->offset -= 2 + data_len;
@@ -1465,19 +1689,109 @@ int control_rtt(char *jlink, char *rtt)
 	return 0;
 }
 
-bool control_writer(const char *path)
+bool control_writer(const char *path, uint16_t snaplen)
 {
 	btsnoop_file = btsnoop_create(path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	if (!btsnoop_file)
+		return false;
+
+	return btsnoop_set_snaplen(btsnoop_file, snaplen);
+}
+
+static void seconds_to_timeval(double seconds, struct timeval *tv)
+{
+	tv->tv_sec = seconds;
+	tv->tv_usec = (seconds - tv->tv_sec) * 1000000;
+}
+
+static bool parse_seek(const char *seek, size_t *frame, struct timeval *delta,
+							double *duration)
+{
+	const char *start;
+	char *ptr;
+
+	start = seek[0] == '#' || seek[0] == '-' ? seek + 1 : seek;
+
+	*frame = 0;
+	*duration = 0;
+	timerclear(delta);
+
+	if (seek[0] == '#') {
+		*frame = strtoul(start, &ptr, 10);
+		if (*frame)
+			(*frame)--;
+	} else
+		seconds_to_timeval(strtod(start, &ptr), delta);
+
+	if (*ptr == ',')
+		*duration = strtod(ptr + 1, &ptr);
+
+	if (ptr == start || *ptr != '\0' || *duration < 0) {
+		fprintf(stderr, "Invalid seek position %s\n", seek);
+		return false;
+	}
+
+	return true;
+}
+
+static bool reader_seek(const char *seek, const char *index_path,
+						struct timeval *end)
+{
+	struct timeval tv, delta;
+	double duration;
+	size_t count, frame;
 
-	return !!btsnoop_file;
+	if (seek && !parse_seek(seek, &frame, &delta, &duration))
+		return false;
+
+	if (!index_path || !btsnoop_load_index(btsnoop_file, index_path)) {
+		if (!btsnoop_build_index(btsnoop_file))
+			return false;
+
+		if (index_path && !btsnoop_save_index(btsnoop_file, index_path))
+			fprintf(stderr, "Failed to save index to %s\n",
+								index_path);
+	}
+
+	if (!seek)
+		return true;
+
+	count = btsnoop_get_count(btsnoop_file);
+	if (!count)
+		return false;
+
+	if (seek[0] == '-') {
+		btsnoop_get_time(btsnoop_file, count - 1, &tv);
+		timersub(&tv, &delta, &tv);
+		frame = btsnoop_find_time(btsnoop_file, &tv);
+	} else if (seek[0] != '#') {
+		btsnoop_get_time(btsnoop_file, 0, &tv);
+		timeradd(&tv, &delta, &tv);
+		frame = btsnoop_find_time(btsnoop_file, &tv);
+	}
+
+	if (!btsnoop_seek_frame(btsnoop_file, frame))
+		return false;
+
+	if (duration > 0) {
+		btsnoop_get_time(btsnoop_file, frame, end);
+		seconds_to_timeval(duration, &delta);
+		timeradd(end, &delta, end);
+	}
+
+	return true;
 }
 
-void control_reader(const char *path, bool pager)
+void control_reader(const char *path, bool pager, const char *seek,
+						const char *index_path)
 {
 	unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
 	uint16_t pktlen;
 	uint32_t format;
-	struct timeval tv;
+	struct timeval tv, end, start, delta;
+	size_t frame = 0, skip = 0;
+	double duration = 0;
+	bool streaming = false;
 
 	btsnoop_file = btsnoop_open(path, BTSNOOP_FLAG_PKLG_SUPPORT);
 	if (!btsnoop_file)
@@ -1485,6 +1799,28 @@ void control_reader(const char *path, bool pager)
 
 	format = btsnoop_get_format(btsnoop_file);
 
+	timerclear(&end);
+	timerclear(&start);
+
+	/*
+	 * Seeking forward from the start of the capture does not need the
+	 * index, so skip up to the position while decoding instead of
+	 * scanning the whole file before the first frame is shown.
+	 */
+	if (seek && !index_path && seek[0] != '-' &&
+					format != BTSNOOP_FORMAT_SIMULATOR) {
+		if (!parse_seek(seek, &skip, &delta, &duration)) {
+			btsnoop_unref(btsnoop_file);
+			return;
+		}
+
+		streaming = true;
+	} else if ((seek || index_path) &&
+				!reader_seek(seek, index_path, &end)) {
+		btsnoop_unref(btsnoop_file);
+		return;
+	}
+
 	switch (format) {
 	case BTSNOOP_FORMAT_HCI:
 	case BTSNOOP_FORMAT_UART:
@@ -1500,6 +1836,8 @@ void control_reader(const char *path, bool pager)
 	if (pager)
 		open_pager();
 
+	set_buffered_output();
+
 	switch (format) {
 	case BTSNOOP_FORMAT_HCI:
 	case BTSNOOP_FORMAT_UART:
@@ -1511,9 +1849,30 @@ void control_reader(const char *path, bool pager)
 							&opcode, buf, &pktlen))
 				break;
 
+			if (streaming) {
+				if (!timerisset(&start))
+					timeradd(&tv, &delta, &start);
+
+				if (frame++ < skip)
+					continue;
+
+				if (seek[0] != '#' && timercmp(&tv, &start, <))
+					continue;
+
+				if (duration > 0) {
+					seconds_to_timeval(duration, &delta);
+					timeradd(&tv, &delta, &end);
+				}
+
+				streaming = false;
+			}
+
 			if (opcode == 0xffff)
 				continue;
 
+			if (timerisset(&end) && timercmp(&tv, &end, >))
+				break;
+
 			packet_monitor(&tv, NULL, index, opcode, buf, pktlen);
 			ellisys_inject_hci(&tv, index, opcode, buf, pktlen);
 		}
@@ -1568,3 +1927,13 @@ void control_filter_index(uint16_t index)
 {
 	filter_index = index;
 }
+
+void control_capture_queue(size_t size)
+{
+	capture_size = size;
+}
+
+void control_live_stats(void)
+{
+	live_stats = true;
+}
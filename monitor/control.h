@@ -11,13 +11,16 @@
 
 #include <stdint.h>
 
-bool control_writer(const char *path);
-void control_reader(const char *path, bool pager);
+bool control_writer(const char *path, uint16_t snaplen);
+void control_reader(const char *path, bool pager, const char *seek,
+						const char *index_path);
 void control_server(const char *path);
 int control_tty(const char *path, unsigned int speed);
 int control_rtt(char *jlink, char *rtt);
 int control_tracing(void);
 void control_disable_decoding(void);
 void control_filter_index(uint16_t index);
+void control_capture_queue(size_t size);
+void control_live_stats(void);
 
 void control_message(uint16_t opcode, const void *data, uint16_t size);
@@ -27,7 +27,11 @@
 
 #include "display.h"
 
+#define OUTPUT_BUFFER_SIZE	(256 * 1024)
+
 static pid_t pager_pid = 0;
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static bool output_buffered = false;
 int default_pager_num_columns = FALLBACK_TERMINAL_WIDTH;
 enum monitor_color setting_monitor_color = COLOR_AUTO;
 
@@ -72,6 +76,19 @@ int num_columns(void)
 	return cached_num_columns;
 }
 
+void set_buffered_output(void)
+{
+	if (output_buffered)
+		return;
+
+	/* Collect output into large writes instead of one per line */
+	fflush(stdout);
+	if (setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer)))
+		return;
+
+	output_buffered = true;
+}
+
 static void close_pipe(int p[])
 {
 	if (p[0] >= 0)
@@ -79,13 +79,16 @@ static inline uint64_t print_bitfield(int indent, uint64_t val,
 static inline void print_hex_field(const char *label, const uint8_t *data,
 								uint8_t len)
 {
+	static const char hexdigits[] = "0123456789abcdef";
 	char str[len * 2 + 1];
 	uint8_t i;
 
-	str[0] = '\0';
+	for (i = 0; i < len; i++) {
+		str[(i * 2) + 0] = hexdigits[data[i] >> 4];
+		str[(i * 2) + 1] = hexdigits[data[i] & 0xf];
+	}
 
-	for (i = 0; i < len; i++)
-		sprintf(str + (i * 2), "%2.2x", data[i]);
+	str[len * 2] = '\0';
 
 	print_field("%s[%u]: %s", label, len, str);
 }
@@ -93,5 +96,7 @@ static inline void print_hex_field(const char *label, const uint8_t *data,
 void set_default_pager_num_columns(int num_columns);
 int num_columns(void);
 
+void set_buffered_output(void);
+
 void open_pager(void);
 void close_pager(void);
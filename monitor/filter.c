@@ -0,0 +1,789 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2011-2014  Intel Corporation
+ *  Copyright (C) 2002-2010  Marcel Holtmann <marcel@holtmann.org>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "lib/bluetooth.h"
+
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/btsnoop.h"
+#include "src/shared/att-types.h"
+
+#include "bt.h"
+#include "filter.h"
+
+enum {
+	NODE_AND,
+	NODE_OR,
+	NODE_NOT,
+	NODE_TYPE,
+	NODE_INDEX,
+	NODE_HANDLE,
+	NODE_ADDR,
+	NODE_OPCODE,
+	NODE_EVENT,
+	NODE_SUBEVENT,
+	NODE_CID,
+	NODE_ATT,
+};
+
+enum {
+	FRAME_CMD	= 1 << 0,
+	FRAME_EVT	= 1 << 1,
+	FRAME_ACL	= 1 << 2,
+	FRAME_SCO	= 1 << 3,
+	FRAME_ISO	= 1 << 4,
+};
+
+struct filter_node {
+	int type;
+	struct filter_node *left;
+	struct filter_node *right;
+	uint16_t value;
+	uint8_t addr[6];
+};
+
+/* Fields of a raw frame the expression can refer to */
+struct filter_frame {
+	uint16_t index;
+	uint8_t type;
+	bool has_opcode;
+	uint16_t opcode;
+	bool has_event;
+	uint8_t event;
+	bool has_subevent;
+	uint8_t subevent;
+	bool has_handle;
+	uint16_t handle;
+	const uint8_t *handles;
+	uint8_t num_handles;
+	const uint8_t *addr;
+	bool has_cid;
+	uint16_t cid;
+	bool has_att;
+	uint16_t att_start;
+	uint16_t att_end;
+};
+
+struct filter_conn {
+	uint16_t index;
+	uint16_t handle;
+	bool has_addr;
+	uint8_t addr[6];
+	bool result;
+};
+
+static struct filter_node *filter_root;
+static struct queue *conn_list;
+static bool need_conn;
+
+static const struct {
+	const char *str;
+	uint8_t type;
+} type_table[] = {
+	{ "cmd", FRAME_CMD },
+	{ "evt", FRAME_EVT },
+	{ "acl", FRAME_ACL },
+	{ "sco", FRAME_SCO },
+	{ "iso", FRAME_ISO },
+	{ }
+};
+
+static const struct {
+	const char *str;
+	int type;
+} field_table[] = {
+	{ "index",	NODE_INDEX	},
+	{ "handle",	NODE_HANDLE	},
+	{ "addr",	NODE_ADDR	},
+	{ "opcode",	NODE_OPCODE	},
+	{ "event",	NODE_EVENT	},
+	{ "subevent",	NODE_SUBEVENT	},
+	{ "cid",	NODE_CID	},
+	{ "att",	NODE_ATT	},
+	{ }
+};
+
+/* Commands carrying a connection handle or an address at an offset */
+static const struct {
+	uint16_t opcode;
+	int8_t handle;
+	int8_t addr;
+} cmd_table[] = {
+	{ BT_HCI_CMD_CREATE_CONN,		-1,  0 },
+	{ BT_HCI_CMD_DISCONNECT,		 0, -1 },
+	{ BT_HCI_CMD_ACCEPT_CONN_REQUEST,	-1,  0 },
+	{ BT_HCI_CMD_AUTH_REQUESTED,		 0, -1 },
+	{ BT_HCI_CMD_SET_CONN_ENCRYPT,		 0, -1 },
+	{ BT_HCI_CMD_READ_REMOTE_FEATURES,	 0, -1 },
+	{ BT_HCI_CMD_READ_REMOTE_VERSION,	 0, -1 },
+	{ BT_HCI_CMD_READ_RSSI,			 0, -1 },
+	{ BT_HCI_CMD_LE_CREATE_CONN,		-1,  6 },
+	{ BT_HCI_CMD_LE_CONN_UPDATE,		 0, -1 },
+	{ BT_HCI_CMD_LE_READ_REMOTE_FEATURES,	 0, -1 },
+	{ BT_HCI_CMD_LE_START_ENCRYPT,		 0, -1 },
+	{ BT_HCI_CMD_LE_LTK_REQ_REPLY,		 0, -1 },
+	{ BT_HCI_CMD_LE_LTK_REQ_NEG_REPLY,	 0, -1 },
+	{ BT_HCI_CMD_LE_SET_DATA_LENGTH,	 0, -1 },
+	{ BT_HCI_CMD_LE_READ_PHY,		 0, -1 },
+	{ BT_HCI_CMD_LE_SET_PHY,		 0, -1 },
+	{ BT_HCI_CMD_LE_EXT_CREATE_CONN,	-1,  2 },
+	{ }
+};
+
+/* Events carrying a connection handle or an address at an offset */
+static const struct {
+	uint8_t event;
+	int8_t handle;
+	int8_t addr;
+} evt_table[] = {
+	{ BT_HCI_EVT_CONN_COMPLETE,			 1,  3 },
+	{ BT_HCI_EVT_DISCONNECT_COMPLETE,		 1, -1 },
+	{ BT_HCI_EVT_AUTH_COMPLETE,			 1, -1 },
+	{ BT_HCI_EVT_ENCRYPT_CHANGE,			 1, -1 },
+	{ BT_HCI_EVT_REMOTE_FEATURES_COMPLETE,		 1, -1 },
+	{ BT_HCI_EVT_REMOTE_VERSION_COMPLETE,		 1, -1 },
+	{ BT_HCI_EVT_MODE_CHANGE,			 1, -1 },
+	{ BT_HCI_EVT_REMOTE_EXT_FEATURES_COMPLETE,	 1, -1 },
+	{ BT_HCI_EVT_SYNC_CONN_COMPLETE,		 1,  3 },
+	{ BT_HCI_EVT_ENCRYPT_KEY_REFRESH_COMPLETE,	 1, -1 },
+	{ }
+};
+
+/* LE subevents, offsets include the subevent code */
+static const struct {
+	uint8_t subevent;
+	int8_t handle;
+	int8_t addr;
+} le_table[] = {
+	{ BT_HCI_EVT_LE_CONN_COMPLETE,			 2,  6 },
+	{ BT_HCI_EVT_LE_CONN_UPDATE_COMPLETE,		 2, -1 },
+	{ BT_HCI_EVT_LE_REMOTE_FEATURES_COMPLETE,	 2, -1 },
+	{ BT_HCI_EVT_LE_LONG_TERM_KEY_REQUEST,		 1, -1 },
+	{ BT_HCI_EVT_LE_CONN_PARAM_REQUEST,		 1, -1 },
+	{ BT_HCI_EVT_LE_DATA_LENGTH_CHANGE,		 1, -1 },
+	{ BT_HCI_EVT_LE_ENHANCED_CONN_COMPLETE,		 2,  6 },
+	{ BT_HCI_EVT_LE_PHY_UPDATE_COMPLETE,		 2, -1 },
+	/* LE Enhanced Connection Complete v2 */
+	{ 0x29,						 2,  6 },
+	{ }
+};
+
+static void node_free(struct filter_node *node)
+{
+	if (!node)
+		return;
+
+	node_free(node->left);
+	node_free(node->right);
+	free(node);
+}
+
+static struct filter_node *node_new(int type, struct filter_node *left,
+						struct filter_node *right)
+{
+	struct filter_node *node;
+
+	node = new0(struct filter_node, 1);
+	node->type = type;
+	node->left = left;
+	node->right = right;
+
+	return node;
+}
+
+struct parser {
+	char **tokens;
+	int pos;
+	int count;
+};
+
+static const char *peek_token(struct parser *p)
+{
+	if (p->pos >= p->count)
+		return NULL;
+
+	return p->tokens[p->pos];
+}
+
+static const char *next_token(struct parser *p)
+{
+	if (p->pos >= p->count)
+		return NULL;
+
+	return p->tokens[p->pos++];
+}
+
+static bool parse_value(const char *str, uint16_t *value)
+{
+	unsigned long val;
+	char *endptr;
+
+	if (!str || !isdigit(*str))
+		return false;
+
+	val = strtoul(str, &endptr, 0);
+	if (*endptr != '\0' || val > UINT16_MAX)
+		return false;
+
+	*value = val;
+
+	return true;
+}
+
+static struct filter_node *parse_or(struct parser *p);
+
+static struct filter_node *parse_primitive(struct parser *p)
+{
+	struct filter_node *node;
+	const char *str, *arg;
+	bdaddr_t bdaddr;
+	int i;
+
+	str = next_token(p);
+	if (!str)
+		return NULL;
+
+	if (!strcmp(str, "not") || !strcmp(str, "!")) {
+		node = parse_primitive(p);
+		if (!node)
+			return NULL;
+
+		return node_new(NODE_NOT, node, NULL);
+	}
+
+	if (!strcmp(str, "(")) {
+		node = parse_or(p);
+		str = next_token(p);
+		if (!node || !str || strcmp(str, ")")) {
+			node_free(node);
+			return NULL;
+		}
+
+		return node;
+	}
+
+	for (i = 0; type_table[i].str; i++) {
+		if (strcmp(str, type_table[i].str))
+			continue;
+
+		node = node_new(NODE_TYPE, NULL, NULL);
+		node->value = type_table[i].type;
+		return node;
+	}
+
+	for (i = 0; field_table[i].str; i++) {
+		if (!strcmp(str, field_table[i].str))
+			break;
+	}
+
+	if (!field_table[i].str) {
+		fprintf(stderr, "Unknown filter primitive: %s\n", str);
+		return NULL;
+	}
+
+	arg = next_token(p);
+	node = node_new(field_table[i].type, NULL, NULL);
+
+	if (node->type == NODE_ADDR) {
+		if (!arg || bachk(arg) < 0)
+			goto invalid;
+
+		str2ba(arg, &bdaddr);
+		memcpy(node->addr, &bdaddr, 6);
+		need_conn = true;
+		return node;
+	}
+
+	if (node->type == NODE_INDEX && arg && !strncmp(arg, "hci", 3) &&
+							isdigit(arg[3]))
+		arg += 3;
+
+	if (!parse_value(arg, &node->value))
+		goto invalid;
+
+	if (node->type == NODE_CID || node->type == NODE_ATT)
+		need_conn = true;
+
+	return node;
+
+invalid:
+	fprintf(stderr, "Invalid filter value for %s: %s\n", str,
+							arg ? arg : "");
+	node_free(node);
+	return NULL;
+}
+
+static struct filter_node *parse_and(struct parser *p)
+{
+	struct filter_node *node, *right;
+	const char *str;
+
+	node = parse_primitive(p);
+	if (!node)
+		return NULL;
+
+	/* Adjacent primitives are implicitly combined with and */
+	while ((str = peek_token(p)) && strcmp(str, "or") &&
+				strcmp(str, "||") && strcmp(str, ")")) {
+		if (!strcmp(str, "and") || !strcmp(str, "&&"))
+			p->pos++;
+
+		right = parse_primitive(p);
+		if (!right) {
+			node_free(node);
+			return NULL;
+		}
+
+		node = node_new(NODE_AND, node, right);
+	}
+
+	return node;
+}
+
+static struct filter_node *parse_or(struct parser *p)
+{
+	struct filter_node *node, *right;
+	const char *str;
+
+	node = parse_and(p);
+	if (!node)
+		return NULL;
+
+	while ((str = peek_token(p)) && (!strcmp(str, "or") ||
+						!strcmp(str, "||"))) {
+		p->pos++;
+
+		right = parse_and(p);
+		if (!right) {
+			node_free(node);
+			return NULL;
+		}
+
+		node = node_new(NODE_OR, node, right);
+	}
+
+	return node;
+}
+
+static int tokenize(const char *expr, char ***tokens)
+{
+	char **list = NULL;
+	int count = 0;
+	const char *ptr = expr;
+
+	while (*ptr) {
+		const char *start;
+
+		if (isspace(*ptr)) {
+			ptr++;
+			continue;
+		}
+
+		start = ptr;
+
+		if (*ptr == '(' || *ptr == ')' || *ptr == '!')
+			ptr++;
+		else
+			while (*ptr && !isspace(*ptr) && *ptr != '(' &&
+								*ptr != ')')
+				ptr++;
+
+		list = realloc(list, sizeof(char *) * (count + 1));
+		list[count++] = strndup(start, ptr - start);
+	}
+
+	*tokens = list;
+
+	return count;
+}
+
+bool filter_parse(const char *expr)
+{
+	struct parser p;
+	int i;
+
+	filter_cleanup();
+
+	memset(&p, 0, sizeof(p));
+	p.count = tokenize(expr, &p.tokens);
+
+	filter_root = parse_or(&p);
+	if (filter_root && p.pos < p.count) {
+		fprintf(stderr, "Unexpected filter token: %s\n",
+							p.tokens[p.pos]);
+		node_free(filter_root);
+		filter_root = NULL;
+	}
+
+	for (i = 0; i < p.count; i++)
+		free(p.tokens[i]);
+
+	free(p.tokens);
+
+	if (!filter_root) {
+		fprintf(stderr, "Invalid filter expression: %s\n", expr);
+		return false;
+	}
+
+	if (need_conn)
+		conn_list = queue_new();
+
+	return true;
+}
+
+void filter_cleanup(void)
+{
+	node_free(filter_root);
+	filter_root = NULL;
+
+	queue_destroy(conn_list, free);
+	conn_list = NULL;
+	need_conn = false;
+}
+
+static bool match_conn(const void *data, const void *user_data)
+{
+	const struct filter_conn *conn = data;
+	const struct filter_frame *frame = user_data;
+
+	return conn->index == frame->index && conn->handle == frame->handle;
+}
+
+static struct filter_conn *conn_lookup(const struct filter_frame *frame,
+								bool create)
+{
+	struct filter_conn *conn;
+
+	if (!conn_list || !frame->has_handle)
+		return NULL;
+
+	conn = queue_find(conn_list, match_conn, frame);
+	if (conn || !create)
+		return conn;
+
+	conn = new0(struct filter_conn, 1);
+	conn->index = frame->index;
+	conn->handle = frame->handle;
+	queue_push_tail(conn_list, conn);
+
+	return conn;
+}
+
+static void parse_offsets(struct filter_frame *frame, const uint8_t *data,
+				uint16_t size, int8_t handle, int8_t addr)
+{
+	if (handle >= 0 && size >= handle + 2) {
+		frame->has_handle = true;
+		frame->handle = get_le16(data + handle) & 0x0fff;
+	}
+
+	if (addr >= 0 && size >= addr + 6)
+		frame->addr = data + addr;
+}
+
+static void parse_cmd(struct filter_frame *frame, const uint8_t *data,
+								uint16_t size)
+{
+	int i;
+
+	if (size < 3)
+		return;
+
+	frame->has_opcode = true;
+	frame->opcode = get_le16(data);
+
+	for (i = 0; cmd_table[i].opcode; i++) {
+		if (cmd_table[i].opcode != frame->opcode)
+			continue;
+
+		parse_offsets(frame, data + 3, size - 3, cmd_table[i].handle,
+							cmd_table[i].addr);
+		break;
+	}
+}
+
+static void parse_evt(struct filter_frame *frame, const uint8_t *data,
+								uint16_t size)
+{
+	int i;
+
+	if (size < 2)
+		return;
+
+	frame->has_event = true;
+	frame->event = data[0];
+
+	data += 2;
+	size -= 2;
+
+	switch (frame->event) {
+	case BT_HCI_EVT_CMD_COMPLETE:
+		if (size >= 3) {
+			frame->has_opcode = true;
+			frame->opcode = get_le16(data + 1);
+		}
+		return;
+	case BT_HCI_EVT_CMD_STATUS:
+		if (size >= 4) {
+			frame->has_opcode = true;
+			frame->opcode = get_le16(data + 2);
+		}
+		return;
+	case BT_HCI_EVT_NUM_COMPLETED_PACKETS:
+		if (size >= 1 && size >= 1 + data[0] * 4) {
+			frame->handles = data + 1;
+			frame->num_handles = data[0];
+		}
+		return;
+	case BT_HCI_EVT_LE_META_EVENT:
+		if (size < 1)
+			return;
+
+		frame->has_subevent = true;
+		frame->subevent = data[0];
+
+		for (i = 0; le_table[i].subevent; i++) {
+			if (le_table[i].subevent != frame->subevent)
+				continue;
+
+			parse_offsets(frame, data, size, le_table[i].handle,
+							le_table[i].addr);
+			break;
+		}
+		return;
+	}
+
+	for (i = 0; evt_table[i].event; i++) {
+		if (evt_table[i].event != frame->event)
+			continue;
+
+		parse_offsets(frame, data, size, evt_table[i].handle,
+							evt_table[i].addr);
+		break;
+	}
+}
+
+static void parse_att(struct filter_frame *frame, const uint8_t *data,
+								uint16_t size)
+{
+	if (size < 3)
+		return;
+
+	switch (data[0]) {
+	case BT_ATT_OP_READ_REQ:
+	case BT_ATT_OP_READ_BLOB_REQ:
+	case BT_ATT_OP_WRITE_REQ:
+	case BT_ATT_OP_WRITE_CMD:
+	case BT_ATT_OP_SIGNED_WRITE_CMD:
+	case BT_ATT_OP_PREP_WRITE_REQ:
+	case BT_ATT_OP_PREP_WRITE_RSP:
+	case BT_ATT_OP_HANDLE_NFY:
+	case BT_ATT_OP_HANDLE_IND:
+		frame->has_att = true;
+		frame->att_start = get_le16(data + 1);
+		frame->att_end = frame->att_start;
+		break;
+	case BT_ATT_OP_ERROR_RSP:
+		if (size < 4)
+			return;
+
+		frame->has_att = true;
+		frame->att_start = get_le16(data + 2);
+		frame->att_end = frame->att_start;
+		break;
+	case BT_ATT_OP_FIND_INFO_REQ:
+	case BT_ATT_OP_FIND_BY_TYPE_REQ:
+	case BT_ATT_OP_READ_BY_TYPE_REQ:
+	case BT_ATT_OP_READ_BY_GRP_TYPE_REQ:
+		if (size < 5)
+			return;
+
+		frame->has_att = true;
+		frame->att_start = get_le16(data + 1);
+		frame->att_end = get_le16(data + 3);
+		break;
+	}
+}
+
+static bool match_handle(const struct filter_frame *frame, uint16_t handle)
+{
+	int i;
+
+	if (frame->has_handle)
+		return frame->handle == handle;
+
+	for (i = 0; i < frame->num_handles; i++) {
+		if ((get_le16(frame->handles + i * 4) & 0x0fff) == handle)
+			return true;
+	}
+
+	return false;
+}
+
+static bool match_addr(const struct filter_frame *frame, const uint8_t *addr)
+{
+	struct filter_conn *conn;
+
+	if (frame->addr)
+		return !memcmp(frame->addr, addr, 6);
+
+	conn = conn_lookup(frame, false);
+
+	return conn && conn->has_addr && !memcmp(conn->addr, addr, 6);
+}
+
+static bool node_match(const struct filter_node *node,
+					const struct filter_frame *frame)
+{
+	switch (node->type) {
+	case NODE_AND:
+		return node_match(node->left, frame) &&
+					node_match(node->right, frame);
+	case NODE_OR:
+		return node_match(node->left, frame) ||
+					node_match(node->right, frame);
+	case NODE_NOT:
+		return !node_match(node->left, frame);
+	case NODE_TYPE:
+		return frame->type & node->value;
+	case NODE_INDEX:
+		return frame->index == node->value;
+	case NODE_HANDLE:
+		return match_handle(frame, node->value);
+	case NODE_ADDR:
+		return match_addr(frame, node->addr);
+	case NODE_OPCODE:
+		return frame->has_opcode && frame->opcode == node->value;
+	case NODE_EVENT:
+		return frame->has_event && frame->event == node->value;
+	case NODE_SUBEVENT:
+		return frame->has_subevent && frame->subevent == node->value;
+	case NODE_CID:
+		return frame->has_cid && frame->cid == node->value;
+	case NODE_ATT:
+		return frame->has_att && frame->att_start <= node->value &&
+						frame->att_end >= node->value;
+	}
+
+	return false;
+}
+
+static void update_conn(struct filter_frame *frame)
+{
+	struct filter_conn *conn;
+
+	if (!frame->has_event || !frame->has_handle)
+		return;
+
+	switch (frame->event) {
+	case BT_HCI_EVT_CONN_COMPLETE:
+	case BT_HCI_EVT_SYNC_CONN_COMPLETE:
+	case BT_HCI_EVT_LE_META_EVENT:
+		if (!frame->addr)
+			return;
+
+		conn = conn_lookup(frame, true);
+		conn->has_addr = true;
+		memcpy(conn->addr, frame->addr, 6);
+		break;
+	case BT_HCI_EVT_DISCONNECT_COMPLETE:
+		conn = conn_lookup(frame, false);
+		if (conn) {
+			queue_remove(conn_list, conn);
+			free(conn);
+		}
+		break;
+	}
+}
+
+bool filter_match(uint16_t index, uint16_t opcode, const void *data,
+								uint16_t size)
+{
+	struct filter_frame frame;
+	struct filter_conn *conn = NULL;
+	const uint8_t *ptr = data;
+	bool result;
+
+	if (!filter_root)
+		return true;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.index = index;
+
+	switch (opcode) {
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		frame.type = FRAME_CMD;
+		parse_cmd(&frame, ptr, size);
+		break;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		frame.type = FRAME_EVT;
+		parse_evt(&frame, ptr, size);
+		break;
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+		frame.type = FRAME_ACL;
+		if (size < 4)
+			break;
+
+		frame.has_handle = true;
+		frame.handle = get_le16(ptr) & 0x0fff;
+
+		/* Continuation fragments follow their start fragment */
+		if (need_conn && (get_le16(ptr) & 0x3000) == 0x1000) {
+			conn = conn_lookup(&frame, false);
+			return conn ? conn->result : false;
+		}
+
+		if (size >= 8) {
+			frame.has_cid = true;
+			frame.cid = get_le16(ptr + 6);
+
+			if (frame.cid == BT_ATT_CID)
+				parse_att(&frame, ptr + 8, size - 8);
+		}
+
+		if (need_conn)
+			conn = conn_lookup(&frame, true);
+		break;
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+		frame.type = FRAME_SCO;
+		parse_offsets(&frame, ptr, size, 0, -1);
+		break;
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		frame.type = FRAME_ISO;
+		parse_offsets(&frame, ptr, size, 0, -1);
+		break;
+	default:
+		/* Index and logging frames keep the decoder state sane */
+		return true;
+	}
+
+	result = node_match(filter_root, &frame);
+
+	if (need_conn && frame.type == FRAME_EVT)
+		update_conn(&frame);
+
+	if (conn)
+		conn->result = result;
+
+	return result;
+}
@@ -24,8 +24,6 @@
 static const uint8_t empty_key[16] = { 0x00, };
 static const uint8_t empty_addr[6] = { 0x00, };
 
-static struct bt_crypto *crypto;
-
 struct irk_data {
 	uint8_t key[16];
 	uint8_t addr[6];
@@ -33,17 +31,27 @@ struct irk_data {
 };
 
 static struct queue *irk_list;
+/* Kept in sync with irk_list so that adding keys never rebuilds it */
+static struct bt_crypto_resolver *resolver;
+
+static void resolver_add(struct irk_data *irk)
+{
+	/* The identity address is read at resolution time */
+	if (memcmp(irk->key, empty_key, 16))
+		bt_crypto_resolver_add(resolver, irk->key, irk);
+}
 
 void keys_setup(void)
 {
-	crypto = bt_crypto_new();
+	resolver = bt_crypto_resolver_new();
 
 	irk_list = queue_new();
 }
 
 void keys_cleanup(void)
 {
-	bt_crypto_unref(crypto);
+	bt_crypto_resolver_free(resolver);
+	resolver = NULL;
 
 	queue_destroy(irk_list, free);
 }
@@ -55,14 +63,19 @@ void keys_update_identity_key(const uint8_t key[16])
 	irk = queue_peek_tail(irk_list);
 	if (irk && !memcmp(irk->key, empty_key, 16)) {
 		memcpy(irk->key, key, 16);
+		resolver_add(irk);
 		return;
 	}
 
 	irk = new0(struct irk_data, 1);
 	if (irk) {
 		memcpy(irk->key, key, 16);
-		if (!queue_push_tail(irk_list, irk))
+		if (!queue_push_tail(irk_list, irk)) {
 			free(irk);
+			return;
+		}
+
+		resolver_add(irk);
 	}
 }
 
@@ -86,23 +99,12 @@ void keys_update_identity_addr(const uint8_t addr[6], uint8_t addr_type)
 	}
 }
 
-static bool match_resolve_irk(const void *data, const void *match_data)
-{
-	const struct irk_data *irk = data;
-	const uint8_t *addr = match_data;
-	uint8_t local_hash[3];
-
-	bt_crypto_ah(crypto, irk->key, addr + 3, local_hash);
-
-	return !memcmp(addr, local_hash, 3);
-}
-
 bool keys_resolve_identity(const uint8_t addr[6], uint8_t ident[6],
 							uint8_t *ident_type)
 {
 	struct irk_data *irk;
 
-	irk = queue_find(irk_list, match_resolve_irk, addr);
+	irk = bt_crypto_resolver_resolve(resolver, addr);
 
 	if (irk) {
 		memcpy(ident, irk->addr, 6);
@@ -131,6 +133,7 @@ bool keys_add_identity(const uint8_t addr[6], uint8_t addr_type,
 		irk = new0(struct irk_data, 1);
 		memcpy(irk->key, key, 16);
 		queue_push_tail(irk_list, irk);
+		resolver_add(irk);
 	}
 
 	memcpy(irk->addr, addr, 6);
@@ -86,7 +86,8 @@
 #define L2CAP_SAR_END		0x02
 #define L2CAP_SAR_CONTINUE	0x03
 
-#define MAX_CHAN 64
+#define MAX_CHAN 4096
+#define CHAN_HASH_SIZE 64
 
 struct chan_data {
 	uint16_t index;
@@ -101,25 +102,102 @@ struct chan_data {
 	uint8_t  seq_num;
 	uint16_t sdu;
 	struct packet_latency tx_l;
+	int next;
 };
 
-static struct chan_data chan_list[MAX_CHAN];
+/*
+ * Channels live in a table that grows on demand, so that frame->chan stays
+ * a valid index, and are chained by connection handle. Channels are only
+ * ever looked up for a given handle, which keeps every lookup independent
+ * of the number of connections seen so far.
+ */
+static struct chan_data *chan_list;
+static int chan_size;
+static int chan_unused = -1;
+static int chan_head[CHAN_HASH_SIZE] = {
+	[0 ... CHAN_HASH_SIZE - 1] = -1
+};
+
+static int chan_first(uint16_t handle)
+{
+	return chan_head[handle % CHAN_HASH_SIZE];
+}
+
+static int chan_new(uint16_t handle)
+{
+	int i;
+
+	if (chan_unused < 0) {
+		struct chan_data *list;
+		int size = chan_size ? chan_size * 2 : 64;
+
+		if (size > MAX_CHAN)
+			return -1;
+
+		list = realloc(chan_list, size * sizeof(*list));
+		if (!list)
+			return -1;
+
+		chan_list = list;
+
+		for (i = size - 1; i >= chan_size; i--) {
+			chan_list[i].next = chan_unused;
+			chan_unused = i;
+		}
+
+		chan_size = size;
+	}
+
+	i = chan_unused;
+	chan_unused = chan_list[i].next;
+
+	memset(&chan_list[i], 0, sizeof(chan_list[i]));
+	chan_list[i].handle = handle;
+	chan_list[i].next = chan_head[handle % CHAN_HASH_SIZE];
+	chan_head[handle % CHAN_HASH_SIZE] = i;
+
+	return i;
+}
+
+static void chan_free(int n)
+{
+	int *i;
+
+	for (i = &chan_head[chan_list[n].handle % CHAN_HASH_SIZE]; *i >= 0;
+						i = &chan_list[*i].next) {
+		if (*i == n) {
+			*i = chan_list[n].next;
+			break;
+		}
+	}
+
+	chan_list[n].next = chan_unused;
+	chan_unused = n;
+}
+
+void l2cap_release_handle(uint16_t index, uint16_t handle)
+{
+	int i, next;
+
+	for (i = chan_first(handle); i >= 0; i = next) {
+		next = chan_list[i].next;
+
+		if (chan_list[i].index == index &&
+					chan_list[i].handle == handle)
+			chan_free(i);
+	}
+}
 
 static void assign_scid(const struct l2cap_frame *frame, uint16_t scid,
 			uint16_t psm, uint8_t mode, uint8_t ctrlid)
 {
-	int i, n = -1;
+	int i, n = -1, next;
 	uint8_t seq_num = 1;
 
 	if (!scid)
 		return;
 
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (n < 0 && chan_list[i].handle == 0x0000) {
-			n = i;
-			continue;
-		}
-
+	for (i = chan_first(frame->handle); i >= 0; i = chan_list[i].next) {
 		if (chan_list[i].index != frame->index)
 			continue;
 
@@ -141,10 +219,15 @@ static void assign_scid(const struct l2cap_frame *frame, uint16_t scid,
 		}
 	}
 
+	if (n < 0)
+		n = chan_new(frame->handle);
+
 	if (n < 0)
 		return;
 
+	next = chan_list[n].next;
 	memset(&chan_list[n], 0, sizeof(chan_list[n]));
+	chan_list[n].next = next;
 	chan_list[n].index = frame->index;
 	chan_list[n].handle = frame->handle;
 	chan_list[n].ident = frame->ident;
@@ -165,7 +248,7 @@ static void release_scid(const struct l2cap_frame *frame, uint16_t scid)
 {
 	int i;
 
-	for (i = 0; i < MAX_CHAN; i++) {
+	for (i = chan_first(frame->handle); i >= 0; i = chan_list[i].next) {
 		if (chan_list[i].index != frame->index)
 			continue;
 
@@ -174,12 +257,12 @@ static void release_scid(const struct l2cap_frame *frame, uint16_t scid)
 
 		if (frame->in) {
 			if (chan_list[i].scid == scid) {
-				chan_list[i].handle = 0;
+				chan_free(i);
 				break;
 			}
 		} else {
 			if (chan_list[i].dcid == scid) {
-				chan_list[i].handle = 0;
+				chan_free(i);
 				break;
 			}
 		}
@@ -191,7 +274,7 @@ static void assign_dcid(const struct l2cap_frame *frame, uint16_t dcid,
 {
 	int i;
 
-	for (i = 0; i < MAX_CHAN; i++) {
+	for (i = chan_first(frame->handle); i >= 0; i = chan_list[i].next) {
 		if (chan_list[i].index != frame->index)
 			continue;
 
@@ -234,7 +317,7 @@ static void assign_mode(const struct l2cap_frame *frame,
 {
 	int i;
 
-	for (i = 0; i < MAX_CHAN; i++) {
+	for (i = chan_first(frame->handle); i >= 0; i = chan_list[i].next) {
 		if (chan_list[i].index != frame->index)
 			continue;
 
@@ -259,7 +342,7 @@ static int get_chan_data_index(const struct l2cap_frame *frame)
 {
 	int i;
 
-	for (i = 0; i < MAX_CHAN; i++) {
+	for (i = chan_first(frame->handle); i >= 0; i = chan_list[i].next) {
 		if (chan_list[i].index != frame->index &&
 					chan_list[i].ctrlid == 0)
 			continue;
@@ -287,7 +370,7 @@ static struct chan_data *get_chan(const struct l2cap_frame *frame)
 {
 	int i;
 
-	if (frame->chan != UINT16_MAX)
+	if (frame->chan < chan_size)
 		return &chan_list[frame->chan];
 
 	i = get_chan_data_index(frame);
@@ -332,7 +415,7 @@ static void assign_ext_ctrl(const struct l2cap_frame *frame,
 {
 	int i;
 
-	for (i = 0; i < MAX_CHAN; i++) {
+	for (i = chan_first(frame->handle); i >= 0; i = chan_list[i].next) {
 		if (chan_list[i].index != frame->index)
 			continue;
 
@@ -18,6 +18,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <getopt.h>
 #include <sys/un.h>
 
@@ -31,6 +32,7 @@
 #include "ellisys.h"
 #include "control.h"
 #include "display.h"
+#include "filter.h"
 
 static void signal_callback(int signum, void *user_data)
 {
@@ -50,17 +52,30 @@ static void usage(void)
 	printf("options:\n"
 		"\t-r, --read <file>      Read traces in btsnoop format\n"
 		"\t-w, --write <file>     Save traces in btsnoop format\n"
+		"\t-L, --snaplen <len>    Save only len bytes of data packets\n"
+		"\t-k, --seek <pos>[,<duration>]\n"
+		"\t                       Start reading at #frame, seconds\n"
+		"\t                       from the start or -seconds before\n"
+		"\t                       the end of the file\n"
+		"\t-x, --index-file <file> Load or save the frame index\n"
 		"\t-a, --analyze <file>   Analyze traces in btsnoop format\n"
 		"\t                       If gnuplot is installed on the\n"
                 "\t                       system it will also attempt to plot\n"
 		"\t                       packet latency graph.\n"
+		"\t-X, --export <file>    Export per connection time series\n"
+		"\t                       of analyze as CSV or JSON (.json)\n"
 		"\t-s, --server <socket>  Start monitor server socket\n"
 		"\t-p, --priority <level> Show only priority or lower\n"
 		"\t-i, --index <num>      Show only specified controller\n"
+		"\t-F, --filter <expr>    Show only frames matching expr\n"
 		"\t-d, --tty <tty>        Read data from TTY\n"
 		"\t-B, --tty-speed <rate> Set TTY speed (default 115200)\n"
 		"\t-V, --vendor <compid>  Set default company identifier\n"
 		"\t-M, --mgmt             Open channel for mgmt events\n"
+		"\t-D, --stats            Show live per connection statistics\n"
+		"\t                       instead of decoding packets\n"
+		"\t-Q, --queue <size>     Capture in a separate thread using\n"
+		"\t                       a queue of size bytes (K/M suffix)\n"
 		"\t-t, --time             Show time instead of time offset\n"
 		"\t-T, --date             Show time and date information\n"
 		"\t-S, --sco              Dump SCO traffic\n"
@@ -80,14 +95,21 @@ static void usage(void)
 static const struct option main_options[] = {
 	{ "read",      required_argument, NULL, 'r' },
 	{ "write",     required_argument, NULL, 'w' },
+	{ "snaplen",   required_argument, NULL, 'L' },
+	{ "seek",      required_argument, NULL, 'k' },
+	{ "index-file", required_argument, NULL, 'x' },
 	{ "analyze",   required_argument, NULL, 'a' },
+	{ "export",    required_argument, NULL, 'X' },
 	{ "server",    required_argument, NULL, 's' },
 	{ "priority",  required_argument, NULL, 'p' },
 	{ "index",     required_argument, NULL, 'i' },
+	{ "filter",    required_argument, NULL, 'F' },
 	{ "tty",       required_argument, NULL, 'd' },
 	{ "tty-speed", required_argument, NULL, 'B' },
 	{ "vendor",    required_argument, NULL, 'V' },
 	{ "mgmt",      no_argument,       NULL, 'M' },
+	{ "stats",     no_argument,       NULL, 'D' },
+	{ "queue",     required_argument, NULL, 'Q' },
 	{ "no-time",   no_argument,       NULL, 'N' },
 	{ "time",      no_argument,       NULL, 't' },
 	{ "date",      no_argument,       NULL, 'T' },
@@ -112,12 +134,19 @@ int main(int argc, char *argv[])
 	bool use_pager = true;
 	const char *reader_path = NULL;
 	const char *writer_path = NULL;
+	const char *seek = NULL;
+	const char *index_path = NULL;
 	const char *analyze_path = NULL;
+	const char *export_path = NULL;
+	bool live_stats = false;
 	const char *ellisys_server = NULL;
 	const char *tty = NULL;
 	unsigned int tty_speed = B115200;
 	unsigned short ellisys_port = 0;
 	const char *str;
+	char *endptr;
+	size_t queue_size;
+	unsigned long snaplen = 0;
 	char *jlink = NULL;
 	char *rtt = NULL;
 	int exit_status;
@@ -131,7 +160,7 @@ int main(int argc, char *argv[])
 		struct sockaddr_un addr;
 
 		opt = getopt_long(argc, argv,
-				"r:w:a:s:p:i:d:B:V:MNtTSAIE:PJ:R:C:c:vh",
+				"r:w:L:k:x:a:X:s:p:i:F:d:B:V:MDQ:NtTSAIE:PJ:R:C:c:vh",
 				main_options, NULL);
 		if (opt < 0)
 			break;
@@ -143,9 +172,27 @@ int main(int argc, char *argv[])
 		case 'w':
 			writer_path = optarg;
 			break;
+		case 'L':
+			snaplen = strtoul(optarg, &endptr, 10);
+			if (*endptr != '\0' || snaplen < 4 ||
+						snaplen > UINT16_MAX) {
+				fprintf(stderr, "Invalid snaplen: %s\n",
+								optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'k':
+			seek = optarg;
+			break;
+		case 'x':
+			index_path = optarg;
+			break;
 		case 'a':
 			analyze_path = optarg;
 			break;
+		case 'X':
+			export_path = optarg;
+			break;
 		case 's':
 			if (strlen(optarg) > sizeof(addr.sun_path) - 1) {
 				fprintf(stderr, "Socket name too long\n");
@@ -167,6 +214,10 @@ int main(int argc, char *argv[])
 			}
 			packet_select_index(atoi(str));
 			break;
+		case 'F':
+			if (!filter_parse(optarg))
+				return EXIT_FAILURE;
+			break;
 		case 'd':
 			tty = optarg;
 			break;
@@ -184,6 +235,28 @@ int main(int argc, char *argv[])
 		case 'M':
 			filter_mask |= PACKET_FILTER_SHOW_MGMT_SOCKET;
 			break;
+		case 'D':
+			live_stats = true;
+			break;
+		case 'Q':
+			queue_size = strtoul(optarg, &endptr, 10);
+			if (*endptr == 'K' || *endptr == 'k') {
+				queue_size *= 1024;
+				endptr++;
+			} else if (*endptr == 'M' || *endptr == 'm') {
+				queue_size *= 1024 * 1024;
+				endptr++;
+			}
+
+			if (*endptr != '\0' || queue_size < 65536 ||
+						queue_size > UINT_MAX) {
+				fprintf(stderr, "Invalid queue size: %s\n",
+								optarg);
+				return EXIT_FAILURE;
+			}
+
+			control_capture_queue(queue_size);
+			break;
 		case 'N':
 			filter_mask &= ~PACKET_FILTER_SHOW_TIME_OFFSET;
 			break;
@@ -259,6 +332,11 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (live_stats && (reader_path || analyze_path)) {
+		fprintf(stderr, "Stats can only be shown for live traces\n");
+		return EXIT_FAILURE;
+	}
+
 	printf("Bluetooth monitor ver %s\n", VERSION);
 
 	keys_setup();
@@ -266,7 +344,7 @@ int main(int argc, char *argv[])
 	packet_set_filter(filter_mask);
 
 	if (analyze_path) {
-		analyze_trace(analyze_path);
+		analyze_trace(analyze_path, export_path);
 		return EXIT_SUCCESS;
 	}
 
@@ -274,11 +352,11 @@ int main(int argc, char *argv[])
 		if (ellisys_server)
 			ellisys_enable(ellisys_server, ellisys_port);
 
-		control_reader(reader_path, use_pager);
+		control_reader(reader_path, use_pager, seek, index_path);
 		return EXIT_SUCCESS;
 	}
 
-	if (writer_path && !control_writer(writer_path)) {
+	if (writer_path && !control_writer(writer_path, snaplen)) {
 		printf("Failed to open '%s'\n", writer_path);
 		return EXIT_FAILURE;
 	}
@@ -286,6 +364,15 @@ int main(int argc, char *argv[])
 	if (ellisys_server)
 		ellisys_enable(ellisys_server, ellisys_port);
 
+	if (live_stats) {
+		if (!analyze_live()) {
+			fprintf(stderr, "Failed to start statistics\n");
+			return EXIT_FAILURE;
+		}
+
+		control_live_stats();
+	}
+
 	if (!tty && !jlink && control_tracing() < 0)
 		return EXIT_FAILURE;
 
@@ -298,6 +385,7 @@ int main(int argc, char *argv[])
 	exit_status = mainloop_run_with_signal(signal_callback, NULL);
 
 	keys_cleanup();
+	filter_cleanup();
 
 	return exit_status;
 }
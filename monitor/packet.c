@@ -45,6 +45,7 @@
 #include "packet.h"
 #include "l2cap.h"
 #include "control.h"
+#include "filter.h"
 #include "vendor.h"
 #include "msft.h"
 #include "intel.h"
@@ -172,68 +173,105 @@ static uint16_t get_format(uint32_t cookie)
 	return 0xffff;
 }
 
-#define MAX_CONN 16
+/*
+ * Connections are hashed by handle. Captures that miss a disconnection
+ * would otherwise keep the entry forever, so once the table is full the
+ * least recently used connection makes room for the new one.
+ */
+#define MAX_CONN 1024
 
-static struct packet_conn_data conn_list[MAX_CONN] = {
-	 [0 ... MAX_CONN - 1].handle = 0xffff
-};
+static struct queue *conn_list;
+static unsigned int conn_used;
+
+static unsigned int conn_hash(const void *data)
+{
+	const struct packet_conn_data *conn = data;
+
+	return conn->handle;
+}
+
+static bool match_conn_handle(const void *a, const void *b)
+{
+	const struct packet_conn_data *conn = a;
+
+	return conn->handle == PTR_TO_UINT(b);
+}
+
+static bool match_conn_link(const void *a, const void *b)
+{
+	const struct packet_conn_data *conn = a;
+
+	return conn->link == PTR_TO_UINT(b);
+}
 
 static struct packet_conn_data *lookup_parent(uint16_t handle)
 {
-	int i;
+	return queue_find(conn_list, match_conn_link, UINT_TO_PTR(handle));
+}
 
-	for (i = 0; i < MAX_CONN; i++) {
-		if (conn_list[i].link == handle)
-			return &conn_list[i];
-	}
+static void conn_free(void *data)
+{
+	struct packet_conn_data *conn = data;
 
-	return NULL;
+	if (conn->destroy)
+		conn->destroy(conn, conn->data);
+
+	l2cap_release_handle(conn->index, conn->handle);
+
+	queue_destroy(conn->tx_q, free);
+	queue_destroy(conn->chan_q, free);
+	free(conn);
 }
 
-static struct packet_conn_data *release_handle(uint16_t handle)
+static void release_handle(uint16_t handle)
 {
-	int i;
+	struct packet_conn_data *conn;
 
-	for (i = 0; i < MAX_CONN; i++) {
-		struct packet_conn_data *conn = &conn_list[i];
+	conn = queue_find_hash(conn_list, handle, match_conn_handle,
+							UINT_TO_PTR(handle));
+	if (!conn)
+		return;
 
-		if (conn->handle == handle) {
-			if (conn->destroy)
-				conn->destroy(conn, conn->data);
+	queue_remove(conn_list, conn);
+	conn_free(conn);
+}
 
-			queue_destroy(conn->tx_q, free);
-			queue_destroy(conn->chan_q, free);
-			memset(conn, 0, sizeof(*conn));
-			conn->handle = 0xffff;
-			return conn;
-		}
-	}
+static void find_lru(void *data, void *user_data)
+{
+	struct packet_conn_data *conn = data;
+	struct packet_conn_data **lru = user_data;
 
-	return NULL;
+	if (!*lru || conn->last_used < (*lru)->last_used)
+		*lru = conn;
 }
 
 static void assign_handle(uint16_t index, uint16_t handle, uint8_t type,
 					uint8_t *dst, uint8_t dst_type)
 {
-	struct packet_conn_data *conn = release_handle(handle);
-	int i;
+	struct packet_conn_data *conn;
 
-	if (!conn) {
-		for (i = 0; i < MAX_CONN; i++) {
-			if (conn_list[i].handle == 0xffff) {
-				conn = &conn_list[i];
-				break;
-			}
-		}
+	if (!conn_list) {
+		conn_list = queue_new();
+		queue_set_hash(conn_list, conn_hash);
 	}
 
-	if (!conn)
-		return;
+	release_handle(handle);
+
+	if (queue_length(conn_list) >= MAX_CONN) {
+		conn = NULL;
+		queue_foreach(conn_list, find_lru, &conn);
+		queue_remove(conn_list, conn);
+		conn_free(conn);
+	}
+
+	conn = new0(struct packet_conn_data, 1);
+	conn->handle = handle;
+	conn->last_used = ++conn_used;
+	queue_push_tail(conn_list, conn);
 
 	hci_devba(index, (bdaddr_t *)conn->src);
 
 	conn->index = index;
-	conn->handle = handle;
 	conn->type = type;
 
 	if (!dst) {
@@ -255,14 +293,14 @@ static void assign_handle(uint16_t index, uint16_t handle, uint8_t type,
 
 struct packet_conn_data *packet_get_conn_data(uint16_t handle)
 {
-	int i;
+	struct packet_conn_data *conn;
 
-	for (i = 0; i < MAX_CONN; i++) {
-		if (conn_list[i].handle == handle)
-			return &conn_list[i];
-	}
+	conn = queue_find_hash(conn_list, handle, match_conn_handle,
+							UINT_TO_PTR(handle));
+	if (conn)
+		conn->last_used = ++conn_used;
 
-	return NULL;
+	return conn;
 }
 
 static uint8_t get_type(uint16_t handle)
@@ -4148,43 +4186,52 @@ static void print_3d_broadcast(const void *data, uint8_t size)
 						period, period_frac);
 }
 
+#define HEXDUMP_LINE_MAX	96
+#define HEXDUMP_LINES		32
+
 void packet_hexdump(const unsigned char *buf, uint16_t len)
 {
 	static const char hexdigits[] = "0123456789abcdef";
-	char str[68];
-	uint16_t i;
+	char out[HEXDUMP_LINE_MAX * HEXDUMP_LINES];
+	const char *prefix = use_color() ? COLOR_OFF COLOR_WHITE : "";
+	const char *suffix = use_color() ? COLOR_OFF : "";
+	size_t prefix_len = strlen(prefix);
+	size_t suffix_len = strlen(suffix);
+	size_t pos = 0;
+	unsigned int i, j;
+
+	/* Assemble the same lines as print_text() and write them in bulk */
+	for (i = 0; i < len; i += 16) {
+		unsigned int count = len - i < 16 ? len - i : 16;
+		char *str;
+
+		if (pos + HEXDUMP_LINE_MAX > sizeof(out)) {
+			fwrite(out, 1, pos, stdout);
+			pos = 0;
+		}
 
-	if (!len)
-		return;
+		memset(out + pos, ' ', 8);
+		pos += 8;
+		memcpy(out + pos, prefix, prefix_len);
+		pos += prefix_len;
 
-	for (i = 0; i < len; i++) {
-		str[((i % 16) * 3) + 0] = hexdigits[buf[i] >> 4];
-		str[((i % 16) * 3) + 1] = hexdigits[buf[i] & 0xf];
-		str[((i % 16) * 3) + 2] = ' ';
-		str[(i % 16) + 49] = isprint(buf[i]) ? buf[i] : '.';
-
-		if ((i + 1) % 16 == 0) {
-			str[47] = ' ';
-			str[48] = ' ';
-			str[65] = '\0';
-			print_text(COLOR_WHITE, "%s", str);
-			str[0] = ' ';
-		}
-	}
+		str = out + pos;
+		memset(str, ' ', 65);
 
-	if (i % 16 > 0) {
-		uint16_t j;
-		for (j = (i % 16); j < 16; j++) {
-			str[(j * 3) + 0] = ' ';
-			str[(j * 3) + 1] = ' ';
-			str[(j * 3) + 2] = ' ';
-			str[j + 49] = ' ';
+		for (j = 0; j < count; j++) {
+			str[(j * 3) + 0] = hexdigits[buf[i + j] >> 4];
+			str[(j * 3) + 1] = hexdigits[buf[i + j] & 0xf];
+			str[j + 49] = isprint(buf[i + j]) ? buf[i + j] : '.';
 		}
-		str[47] = ' ';
-		str[48] = ' ';
-		str[65] = '\0';
-		print_text(COLOR_WHITE, "%s", str);
+
+		pos += 65;
+		memcpy(out + pos, suffix, suffix_len);
+		pos += suffix_len;
+		out[pos++] = '\n';
 	}
+
+	if (pos)
+		fwrite(out, 1, pos, stdout);
 }
 
 void packet_control(struct timeval *tv, struct ucred *cred,
@@ -4223,6 +4270,9 @@ void packet_monitor(struct timeval *tv, struct ucred *cred,
 	if (tv && time_offset == ((time_t) -1))
 		time_offset = tv->tv_sec;
 
+	if (!filter_match(index, opcode, data, size))
+		return;
+
 	switch (opcode) {
 	case BTSNOOP_OPCODE_NEW_INDEX:
 		ni = data;
@@ -51,6 +51,7 @@ struct packet_conn_data {
 	struct packet_latency tx_l;
 	void     *data;
 	void     (*destroy)(struct packet_conn_data *conn, void *data);
+	unsigned int last_used;
 };
 
 struct packet_conn_data *packet_get_conn_data(uint16_t handle);
@@ -27,12 +27,10 @@
 #include "btio/btio.h"
 
 #include "obexd/src/log.h"
+#include "obexd/src/obexd.h"
 #include "transport.h"
 #include "bluetooth.h"
 
-#define BT_RX_MTU 32767
-#define BT_TX_MTU 32767
-
 #define OBC_BT_ERROR obc_bt_error_quark()
 
 struct bluetooth_session {
@@ -108,8 +106,8 @@ static GIOChannel *transport_connect(const bdaddr_t *src, const bdaddr_t *dst,
 				BT_IO_OPT_DEST_BDADDR, dst,
 				BT_IO_OPT_PSM, port,
 				BT_IO_OPT_MODE, BT_IO_MODE_ERTM,
-				BT_IO_OPT_OMTU, BT_TX_MTU,
-				BT_IO_OPT_IMTU, BT_RX_MTU,
+				BT_IO_OPT_OMTU, obex_option_mtu(),
+				BT_IO_OPT_IMTU, obex_option_mtu(),
 				BT_IO_OPT_SEC_LEVEL, BT_IO_SEC_LOW,
 				BT_IO_OPT_INVALID);
 	} else {
@@ -432,8 +430,8 @@ static int bluetooth_getpacketopt(GIOChannel *io, int *tx_mtu, int *rx_mtu)
 {
 	int sk = g_io_channel_unix_get_fd(io);
 	int type;
-	uint16_t omtu = BT_TX_MTU;
-	uint16_t imtu = BT_RX_MTU;
+	uint16_t omtu = obex_option_mtu();
+	uint16_t imtu = obex_option_mtu();
 	socklen_t len = sizeof(int);
 
 	DBG("");
@@ -450,10 +448,10 @@ static int bluetooth_getpacketopt(GIOChannel *io, int *tx_mtu, int *rx_mtu)
 		return -EINVAL;
 
 	if (tx_mtu)
-		*tx_mtu = omtu;
+		*tx_mtu = MIN(omtu, obex_option_mtu());
 
 	if (rx_mtu)
-		*rx_mtu = imtu;
+		*rx_mtu = MIN(imtu, obex_option_mtu());
 
 	return 0;
 }
@@ -8,11 +8,16 @@
  *
  */
 
+/* Busy sessions preempt lower priority ones to the same device */
+#define OBC_PRIORITY_BULK		0
+#define OBC_PRIORITY_INTERACTIVE	1
+
 struct obc_driver {
 	const char *service;
 	const char *uuid;
 	void *target;
 	gsize target_len;
+	int priority;
 	void *(*supported_features) (struct obc_session *session);
 	int (*probe) (struct obc_session *session);
 	void (*remove) (struct obc_session *session);
@@ -2309,6 +2309,7 @@ static struct obc_driver map = {
 	.uuid = MAS_UUID,
 	.target = OBEX_MAS_UUID,
 	.target_len = OBEX_MAS_UUID_LEN,
+	.priority = OBC_PRIORITY_INTERACTIVE,
 	.supported_features = map_supported_features,
 	.probe = map_probe,
 	.remove = map_remove
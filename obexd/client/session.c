@@ -37,6 +37,14 @@
 #define ERROR_INTERFACE "org.bluez.obex.Error"
 #define SESSION_BASEPATH "/org/bluez/obex/client"
 
+/*
+ * While a higher priority session to the same device is busy, transfers
+ * of lower priority sessions only run during one of every SCHED_PERIOD
+ * slices.
+ */
+#define SCHED_SLICE 100		/* ms */
+#define SCHED_PERIOD 4
+
 #define OBEX_IO_ERROR obex_io_error_quark()
 #define OBEX_IO_ERROR_FIRST (0xff + 1)
 
@@ -105,6 +113,8 @@ struct obc_session {
 };
 
 static GSList *sessions = NULL;
+static guint sched_id = 0;
+static guint sched_tick = 0;
 
 static void session_process_queue(struct obc_session *session);
 static void session_terminate_transfer(struct obc_session *session,
@@ -370,8 +380,11 @@ static void transport_func(GIOChannel *io, GError *err, gpointer user_data)
 	if (transport->getpacketopt &&
 			transport->getpacketopt(io, &tx_mtu, &rx_mtu) == 0)
 		type = G_OBEX_TRANSPORT_PACKET;
-	else
+	else {
 		type = G_OBEX_TRANSPORT_STREAM;
+		tx_mtu = obex_option_mtu();
+		rx_mtu = obex_option_mtu();
+	}
 
 	obex = g_obex_new(io, type, tx_mtu, rx_mtu);
 	if (obex == NULL)
@@ -820,6 +833,82 @@ static const GDBusPropertyTable session_properties[] = {
 	{ }
 };
 
+static gboolean session_busy(struct obc_session *session)
+{
+	if (session->p != NULL)
+		return TRUE;
+
+	return session->queue != NULL && !g_queue_is_empty(session->queue);
+}
+
+static gboolean session_preempted(struct obc_session *session)
+{
+	GSList *l;
+
+	for (l = sessions; l; l = l->next) {
+		struct obc_session *s = l->data;
+
+		if (s == session || s->driver->priority <=
+						session->driver->priority)
+			continue;
+
+		if (g_strcmp0(s->destination, session->destination) ||
+				g_strcmp0(s->source, session->source))
+			continue;
+
+		if (session_busy(s))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean session_schedule(gpointer data)
+{
+	gboolean preempted = FALSE;
+	GSList *l;
+
+	sched_tick++;
+
+	for (l = sessions; l; l = l->next) {
+		struct obc_session *session = l->data;
+		struct obc_transfer *transfer;
+
+		if (session->p == NULL || session->p->transfer == NULL)
+			continue;
+
+		transfer = session->p->transfer;
+
+		if (!session_preempted(session)) {
+			obc_transfer_throttle(transfer, FALSE);
+			continue;
+		}
+
+		preempted = TRUE;
+		obc_transfer_throttle(transfer, sched_tick % SCHED_PERIOD);
+	}
+
+	if (!preempted) {
+		sched_id = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void session_schedule_update(void)
+{
+	if (sched_id > 0)
+		return;
+
+	if (!session_schedule(NULL))
+		return;
+
+	DBG("preempting lower priority sessions");
+
+	sched_id = g_timeout_add(SCHED_SLICE, session_schedule, NULL);
+}
+
 static gboolean session_process(gpointer data)
 {
 	struct obc_session *session = data;
@@ -838,6 +927,8 @@ static void session_queue(struct pending_request *p)
 	if (p->session->process_id == 0)
 		p->session->process_id = g_idle_add(session_process,
 								p->session);
+
+	session_schedule_update();
 }
 
 static int session_process_transfer(struct pending_request *p, GError **err)
@@ -847,6 +938,10 @@ static int session_process_transfer(struct pending_request *p, GError **err)
 
 	DBG("Tranfer(%p) started", p->transfer);
 	p->session->p = p;
+
+	/* Throttle right away if a higher priority session is busy */
+	session_schedule_update();
+
 	return 0;
 }
 
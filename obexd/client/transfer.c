@@ -71,6 +71,7 @@ struct obc_transfer {
 	int fd;
 	guint req;
 	guint xfer;
+	gboolean throttled;	/* Suspended by the session scheduler */
 	gint64 size;
 	gint64 transferred;
 	gint64 progress;
@@ -148,9 +149,12 @@ static DBusMessage *obc_transfer_cancel(DBusConnection *connection,
 				ERROR_INTERFACE ".InProgress",
 				"Cancellation already in progress");
 
-	if (transfer->status == TRANSFER_STATUS_SUSPENDED)
+	if (transfer->status == TRANSFER_STATUS_SUSPENDED ||
+							transfer->throttled)
 		g_obex_resume(transfer->obex);
 
+	transfer->throttled = FALSE;
+
 	if (transfer->req > 0) {
 		if (!g_obex_cancel_req(transfer->obex, transfer->req, TRUE))
 			return g_dbus_create_error(message,
@@ -218,7 +222,9 @@ static DBusMessage *obc_transfer_suspend(DBusConnection *connection,
 		status = TRANSFER_STATUS_SUSPENDED_QUEUED;
 		break;
 	case TRANSFER_STATUS_ACTIVE:
-		if (transfer->xfer)
+		if (transfer->throttled)
+			transfer->throttled = FALSE;
+		else if (transfer->xfer)
 			g_obex_suspend(transfer->obex);
 		status = TRANSFER_STATUS_SUSPENDED;
 		break;
@@ -410,9 +416,12 @@ static void obc_transfer_free(struct obc_transfer *transfer)
 {
 	DBG("%p", transfer);
 
-	if (transfer->status == TRANSFER_STATUS_SUSPENDED)
+	if (transfer->status == TRANSFER_STATUS_SUSPENDED ||
+							transfer->throttled)
 		g_obex_resume(transfer->obex);
 
+	transfer->throttled = FALSE;
+
 	if (transfer->req > 0)
 		g_obex_cancel_req(transfer->obex, transfer->req, TRUE);
 
@@ -522,6 +531,10 @@ static gboolean transfer_open(struct obc_transfer *transfer, int flags,
 							"Unable to open file");
 			return FALSE;
 		}
+
+		if ((flags & O_ACCMODE) == O_RDONLY)
+			posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
 		goto done;
 	}
 
@@ -666,9 +679,12 @@ static void xfer_complete(GObex *obex, GError *err, gpointer user_data)
 		transfer->progress_id = 0;
 	}
 
-	if (transfer->status == TRANSFER_STATUS_SUSPENDED)
+	if (transfer->status == TRANSFER_STATUS_SUSPENDED ||
+							transfer->throttled)
 		g_obex_resume(transfer->obex);
 
+	transfer->throttled = FALSE;
+
 	if (err)
 		transfer_set_status(transfer, TRANSFER_STATUS_ERROR);
 	else
@@ -927,6 +943,28 @@ guint8 obc_transfer_get_operation(struct obc_transfer *transfer)
 	return transfer->op;
 }
 
+void obc_transfer_throttle(struct obc_transfer *transfer, gboolean throttle)
+{
+	if (!throttle) {
+		if (!transfer->throttled)
+			return;
+
+		transfer->throttled = FALSE;
+
+		if (transfer->status == TRANSFER_STATUS_ACTIVE)
+			g_obex_resume(transfer->obex);
+
+		return;
+	}
+
+	if (transfer->throttled || !transfer->xfer ||
+				transfer->status != TRANSFER_STATUS_ACTIVE)
+		return;
+
+	g_obex_suspend(transfer->obex);
+	transfer->throttled = TRUE;
+}
+
 void obc_transfer_set_apparam(struct obc_transfer *transfer, void *data)
 {
 	if (transfer->apparam != NULL)
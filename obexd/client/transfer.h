@@ -36,6 +36,7 @@ gboolean obc_transfer_set_callback(struct obc_transfer *transfer,
 gboolean obc_transfer_start(struct obc_transfer *transfer, void *obex,
 								GError **err);
 guint8 obc_transfer_get_operation(struct obc_transfer *transfer);
+void obc_transfer_throttle(struct obc_transfer *transfer, gboolean throttle);
 
 void obc_transfer_set_apparam(struct obc_transfer *transfer, void *data);
 void *obc_transfer_get_apparam(struct obc_transfer *transfer);
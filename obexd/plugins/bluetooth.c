@@ -36,9 +36,6 @@
 #include "obexd/src/service.h"
 #include "obexd/src/log.h"
 
-#define BT_RX_MTU 32767
-#define BT_TX_MTU 32767
-
 struct bluetooth_profile {
 	struct obex_server *server;
 	const struct obex_service_driver *driver;
@@ -62,8 +59,8 @@ static void connect_event(GIOChannel *io, GError *err, void *user_data)
 	struct bluetooth_profile *profile = user_data;
 	struct obex_server *server = profile->server;
 	int type;
-	uint16_t omtu = BT_TX_MTU;
-	uint16_t imtu = BT_RX_MTU;
+	uint16_t omtu = obex_option_mtu();
+	uint16_t imtu = obex_option_mtu();
 	gboolean stream = TRUE;
 	socklen_t len = sizeof(int);
 
@@ -82,6 +79,9 @@ static void connect_event(GIOChannel *io, GError *err, void *user_data)
 	bt_io_get(io, NULL, BT_IO_OPT_OMTU, &omtu, BT_IO_OPT_IMTU, &imtu,
 							BT_IO_OPT_INVALID);
 
+	omtu = MIN(omtu, obex_option_mtu());
+	imtu = MIN(imtu, obex_option_mtu());
+
 done:
 	if (obex_server_new_connection(server, io, omtu, imtu, stream) < 0)
 		g_io_channel_shutdown(io, TRUE, NULL);
@@ -189,6 +189,9 @@ static void *filesystem_open(const char *name, int oflag, mode_t mode,
 	if (oflag == O_RDONLY) {
 		if (size)
 			*size = stats.st_size;
+
+		/* Bodies are read front to back in MTU sized chunks */
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 		goto done;
 	}
 
@@ -227,24 +230,275 @@ static int filesystem_close(void *object)
 	return 0;
 }
 
-static ssize_t filesystem_read(void *object, void *buf, size_t count)
+/* Files are read ahead and written behind by a worker thread so slow storage
+ * does not stall the main loop, the session is resumed through
+ * obex_object_set_io_flags once data or buffer space is available.
+ */
+#define FILE_IO_BUFFER	(256 * 1024)
+
+struct file_io {
+	int fd;
+	gboolean writing;
+	GThread *thread;
+	GMutex lock;
+	GCond cond;
+	uint8_t *buf;
+	size_t start;
+	size_t len;
+	int err;
+	gboolean eof;
+	gboolean stop;
+	gboolean blocked;
+	guint notify_id;
+};
+
+static gboolean file_io_notify(gpointer user_data)
+{
+	struct file_io *io = user_data;
+
+	g_mutex_lock(&io->lock);
+	io->notify_id = 0;
+	g_mutex_unlock(&io->lock);
+
+	obex_object_set_io_flags(io, io->writing ? G_IO_OUT : G_IO_IN, 0);
+
+	return FALSE;
+}
+
+/* Called with lock held */
+static void file_io_wakeup(struct file_io *io)
+{
+	if (!io->blocked || io->notify_id)
+		return;
+
+	io->blocked = FALSE;
+	io->notify_id = g_idle_add(file_io_notify, io);
+}
+
+static void file_io_read_ahead(struct file_io *io)
+{
+	while (!io->stop) {
+		size_t pos, chunk;
+		ssize_t ret;
+
+		if (io->len == FILE_IO_BUFFER) {
+			g_cond_wait(&io->cond, &io->lock);
+			continue;
+		}
+
+		pos = (io->start + io->len) % FILE_IO_BUFFER;
+		chunk = MIN(FILE_IO_BUFFER - io->len, FILE_IO_BUFFER - pos);
+
+		g_mutex_unlock(&io->lock);
+		ret = read(io->fd, io->buf + pos, chunk);
+		g_mutex_lock(&io->lock);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			io->err = -errno;
+			break;
+		}
+
+		if (ret == 0) {
+			io->eof = TRUE;
+			break;
+		}
+
+		io->len += ret;
+		file_io_wakeup(io);
+	}
+}
+
+static void file_io_write_behind(struct file_io *io)
+{
+	for (;;) {
+		size_t chunk;
+		ssize_t ret;
+
+		if (io->len == 0) {
+			if (io->stop)
+				break;
+
+			g_cond_wait(&io->cond, &io->lock);
+			continue;
+		}
+
+		chunk = MIN(io->len, FILE_IO_BUFFER - io->start);
+
+		g_mutex_unlock(&io->lock);
+		ret = write(io->fd, io->buf + io->start, chunk);
+		g_mutex_lock(&io->lock);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			io->err = -errno;
+			break;
+		}
+
+		io->start = (io->start + ret) % FILE_IO_BUFFER;
+		io->len -= ret;
+		file_io_wakeup(io);
+	}
+}
+
+static gpointer file_io_thread(gpointer user_data)
+{
+	struct file_io *io = user_data;
+
+	g_mutex_lock(&io->lock);
+
+	if (io->writing)
+		file_io_write_behind(io);
+	else
+		file_io_read_ahead(io);
+
+	/* Let a blocked session see EOF or the error */
+	file_io_wakeup(io);
+
+	g_mutex_unlock(&io->lock);
+
+	return NULL;
+}
+
+static void file_io_free(struct file_io *io)
+{
+	if (io->notify_id)
+		g_source_remove(io->notify_id);
+
+	g_mutex_clear(&io->lock);
+	g_cond_clear(&io->cond);
+	g_free(io->buf);
+	g_free(io);
+}
+
+static void *file_open(const char *name, int oflag, mode_t mode,
+					void *context, size_t *size, int *err)
 {
+	struct file_io *io;
+	GError *gerr = NULL;
+	void *object;
+
+	object = filesystem_open(name, oflag, mode, context, size, err);
+	if (object == NULL)
+		return NULL;
+
+	io = g_new0(struct file_io, 1);
+	io->fd = GPOINTER_TO_INT(object);
+	io->writing = (oflag & O_ACCMODE) != O_RDONLY;
+	io->buf = g_malloc(FILE_IO_BUFFER);
+	g_mutex_init(&io->lock);
+	g_cond_init(&io->cond);
+
+	io->thread = g_thread_try_new("obexd-file", file_io_thread, io, &gerr);
+	if (io->thread == NULL) {
+		error("Unable to start file thread: %s", gerr->message);
+		g_error_free(gerr);
+		file_io_free(io);
+		filesystem_close(object);
+		if (err)
+			*err = -EIO;
+		return NULL;
+	}
+
+	return io;
+}
+
+static int file_close(void *object)
+{
+	struct file_io *io = object;
+	int err;
+
+	/* Pending writes are flushed before the thread exits */
+	g_mutex_lock(&io->lock);
+	io->stop = TRUE;
+	g_cond_signal(&io->cond);
+	g_mutex_unlock(&io->lock);
+
+	g_thread_join(io->thread);
+
+	err = filesystem_close(GINT_TO_POINTER(io->fd));
+	if (io->err < 0)
+		err = io->err;
+
+	file_io_free(io);
+
+	return err;
+}
+
+static ssize_t file_read(void *object, void *buf, size_t count)
+{
+	struct file_io *io = object;
+	size_t chunk;
 	ssize_t ret;
 
-	ret = read(GPOINTER_TO_INT(object), buf, count);
-	if (ret < 0)
-		return -errno;
+	g_mutex_lock(&io->lock);
+
+	if (io->len == 0) {
+		if (io->err < 0)
+			ret = io->err;
+		else if (io->eof)
+			ret = 0;
+		else {
+			io->blocked = TRUE;
+			ret = -EAGAIN;
+		}
+
+		goto done;
+	}
+
+	ret = MIN(count, io->len);
+
+	chunk = MIN((size_t) ret, FILE_IO_BUFFER - io->start);
+	memcpy(buf, io->buf + io->start, chunk);
+	memcpy((uint8_t *) buf + chunk, io->buf, ret - chunk);
+
+	io->start = (io->start + ret) % FILE_IO_BUFFER;
+	io->len -= ret;
+
+	g_cond_signal(&io->cond);
+
+done:
+	g_mutex_unlock(&io->lock);
 
 	return ret;
 }
 
-static ssize_t filesystem_write(void *object, const void *buf, size_t count)
+static ssize_t file_write(void *object, const void *buf, size_t count)
 {
+	struct file_io *io = object;
+	size_t pos, chunk;
 	ssize_t ret;
 
-	ret = write(GPOINTER_TO_INT(object), buf, count);
-	if (ret < 0)
-		return -errno;
+	g_mutex_lock(&io->lock);
+
+	if (io->err < 0) {
+		ret = io->err;
+		goto done;
+	}
+
+	if (io->len == FILE_IO_BUFFER) {
+		io->blocked = TRUE;
+		ret = -EAGAIN;
+		goto done;
+	}
+
+	ret = MIN(count, FILE_IO_BUFFER - io->len);
+
+	pos = (io->start + io->len) % FILE_IO_BUFFER;
+	chunk = MIN((size_t) ret, FILE_IO_BUFFER - pos);
+	memcpy(io->buf + pos, buf, chunk);
+	memcpy(io->buf, (const uint8_t *) buf + chunk, ret - chunk);
+
+	io->len += ret;
+
+	g_cond_signal(&io->cond);
+
+done:
+	g_mutex_unlock(&io->lock);
 
 	return ret;
 }
@@ -652,10 +906,10 @@ done:
 }
 
 static const struct obex_mime_type_driver file = {
-	.open = filesystem_open,
-	.close = filesystem_close,
-	.read = filesystem_read,
-	.write = filesystem_write,
+	.open = file_open,
+	.close = file_close,
+	.read = file_read,
+	.write = file_write,
 	.remove = remove,
 	.move = filesystem_rename,
 	.copy = filesystem_copy,
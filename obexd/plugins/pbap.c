@@ -52,6 +52,9 @@
 #define PHONEBOOKSIZE_TAG	0X08
 #define NEWMISSEDCALLS_TAG	0X09
 
+/* Upper bound of the memory used by cached PullPhoneBook responses */
+#define PULL_CACHE_MAX		(4 * 1024 * 1024)
+
 struct cache {
 	gboolean valid;
 	uint32_t index;
@@ -81,8 +84,27 @@ struct pbap_object {
 	gboolean lastpart;
 	struct pbap_session *session;
 	void *request;
+	char *name;
+	uint32_t version;
+	GString *capture;
+};
+
+/* PullPhoneBook responses shared by all sessions, valid while the backend
+ * reports the same version for the phonebook object.
+ */
+struct pull_cache {
+	char *name;
+	uint32_t version;
+	uint64_t filter;
+	uint8_t format;
+	uint16_t maxlistcount;
+	uint16_t liststartoffset;
+	GString *data;
 };
 
+static GSList *pull_cache_list = NULL;
+static size_t pull_cache_size = 0;
+
 static const uint8_t PBAP_TARGET[TARGET_SIZE] = {
 			0x79, 0x61, 0x35, 0xF0,  0xF0, 0xC5, 0x11, 0xD8,
 			0x09, 0x66, 0x08, 0x00,  0x20, 0x0C, 0x9A, 0x66  };
@@ -158,6 +180,107 @@ static void cache_clear(struct cache *cache)
 	cache->entries = NULL;
 }
 
+static void pull_cache_free(void *data)
+{
+	struct pull_cache *cache = data;
+
+	pull_cache_size -= cache->data->len;
+
+	g_free(cache->name);
+	g_string_free(cache->data, TRUE);
+	g_free(cache);
+}
+
+static gboolean pull_cache_match(const struct pull_cache *cache,
+					const char *name,
+					const struct apparam_field *params)
+{
+	return cache->filter == params->filter &&
+			cache->format == params->format &&
+			cache->maxlistcount == params->maxlistcount &&
+			cache->liststartoffset == params->liststartoffset &&
+			g_strcmp0(cache->name, name) == 0;
+}
+
+static struct pull_cache *pull_cache_find(const char *name,
+					const struct apparam_field *params,
+					uint32_t version)
+{
+	GSList *l;
+
+	for (l = pull_cache_list; l; l = l->next) {
+		struct pull_cache *cache = l->data;
+
+		if (!pull_cache_match(cache, name, params))
+			continue;
+
+		if (cache->version == version)
+			return cache;
+
+		/* Phonebook changed since the response was generated */
+		pull_cache_list = g_slist_delete_link(pull_cache_list, l);
+		pull_cache_free(cache);
+
+		return NULL;
+	}
+
+	return NULL;
+}
+
+static void pull_cache_store(struct pbap_object *obj)
+{
+	struct apparam_field *params = obj->session->params;
+	struct pull_cache *cache;
+	GSList *last;
+
+	cache = pull_cache_find(obj->name, params, obj->version);
+	if (cache) {
+		g_string_free(obj->capture, TRUE);
+		obj->capture = NULL;
+		return;
+	}
+
+	cache = g_new0(struct pull_cache, 1);
+	cache->name = g_strdup(obj->name);
+	cache->version = obj->version;
+	cache->filter = params->filter;
+	cache->format = params->format;
+	cache->maxlistcount = params->maxlistcount;
+	cache->liststartoffset = params->liststartoffset;
+	cache->data = obj->capture;
+	obj->capture = NULL;
+
+	pull_cache_size += cache->data->len;
+	pull_cache_list = g_slist_prepend(pull_cache_list, cache);
+
+	/* Evict the least recently used responses */
+	while (pull_cache_size > PULL_CACHE_MAX) {
+		last = g_slist_last(pull_cache_list);
+		pull_cache_free(last->data);
+		pull_cache_list = g_slist_delete_link(pull_cache_list, last);
+	}
+}
+
+static void pull_cache_capture(struct pbap_object *obj, const char *buffer,
+					size_t bufsize, int missed,
+					gboolean lastpart)
+{
+	if (!obj->capture)
+		return;
+
+	/* New missed calls are only reported once */
+	if (missed > 0 || obj->capture->len + bufsize > PULL_CACHE_MAX) {
+		g_string_free(obj->capture, TRUE);
+		obj->capture = NULL;
+		return;
+	}
+
+	g_string_append_len(obj->capture, buffer, bufsize);
+
+	if (lastpart)
+		pull_cache_store(obj);
+}
+
 static void phonebook_size_result(const char *buffer, size_t bufsize,
 					int vcards, int missed,
 					gboolean lastpart, void *user_data)
@@ -212,6 +335,8 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 		return;
 	}
 
+	pull_cache_capture(pbap->obj, buffer, bufsize, missed, lastpart);
+
 	if (!pbap->obj->buffer)
 		pbap->obj->buffer = g_string_new_len(buffer, bufsize);
 	else
@@ -660,7 +785,10 @@ static void *vobject_pull_open(const char *name, int oflag, mode_t mode,
 				void *context, size_t *size, int *err)
 {
 	struct pbap_session *pbap = context;
+	struct pbap_object *obj;
+	struct pull_cache *cache;
 	phonebook_cb cb;
+	uint32_t version;
 	int ret;
 	void *request;
 
@@ -677,10 +805,36 @@ static void *vobject_pull_open(const char *name, int oflag, mode_t mode,
 		goto fail;
 	}
 
-	if (pbap->params->maxlistcount == 0)
+	if (pbap->params->maxlistcount == 0) {
 		cb = phonebook_size_result;
-	else
+		version = 0;
+	} else {
 		cb = query_result;
+		version = phonebook_get_version(name);
+	}
+
+	if (version) {
+		cache = pull_cache_find(name, pbap->params, version);
+		if (cache) {
+			DBG("%s served from cache", name);
+
+			/* Move to the front so it is evicted last */
+			pull_cache_list = g_slist_remove(pull_cache_list,
+								cache);
+			pull_cache_list = g_slist_prepend(pull_cache_list,
+								cache);
+
+			obj = vobject_create(pbap, NULL);
+			obj->buffer = g_string_new_len(cache->data->str,
+							cache->data->len);
+			obj->lastpart = TRUE;
+
+			if (err)
+				*err = 0;
+
+			return obj;
+		}
+	}
 
 	request = phonebook_pull(name, pbap->params, cb, pbap, &ret);
 
@@ -695,7 +849,15 @@ static void *vobject_pull_open(const char *name, int oflag, mode_t mode,
 	if (err)
 		*err = 0;
 
-	return vobject_create(pbap, request);
+	obj = vobject_create(pbap, request);
+
+	if (version) {
+		obj->name = g_strdup(name);
+		obj->version = version;
+		obj->capture = g_string_new(NULL);
+	}
+
+	return obj;
 
 fail:
 	if (err)
@@ -722,6 +884,10 @@ static int vobject_close(void *object)
 	if (obj->request)
 		phonebook_req_finalize(obj->request);
 
+	if (obj->capture)
+		g_string_free(obj->capture, TRUE);
+
+	g_free(obj->name);
 	g_free(obj);
 
 	return 0;
@@ -999,6 +1165,8 @@ static void pbap_exit(void)
 	obex_mime_type_driver_unregister(&mime_pull);
 	obex_mime_type_driver_unregister(&mime_list);
 	obex_mime_type_driver_unregister(&mime_vcard);
+	g_slist_free_full(pull_cache_list, pull_cache_free);
+	pull_cache_list = NULL;
 	phonebook_exit();
 }
 
@@ -435,6 +435,49 @@ done:
 	return relative;
 }
 
+uint32_t phonebook_get_version(const char *name)
+{
+	char *filename, *folder;
+	struct dirent *ep;
+	struct stat st;
+	uint32_t version;
+	DIR *dp;
+
+	filename = g_build_filename(root_folder, name, NULL);
+	if (!g_str_has_suffix(filename, ".vcf")) {
+		g_free(filename);
+		return 0;
+	}
+
+	folder = g_strndup(filename, strlen(filename) - 4);
+	g_free(filename);
+
+	dp = opendir(folder);
+	if (dp == NULL) {
+		g_free(folder);
+		return 0;
+	}
+
+	/* Each vCard is a file, so combine their size and modification time */
+	version = 5381;
+
+	while ((ep = readdir(dp))) {
+		if (fstatat(dirfd(dp), ep->d_name, &st, 0) < 0 ||
+						!S_ISREG(st.st_mode))
+			continue;
+
+		version = version * 33 + g_str_hash(ep->d_name);
+		version = version * 33 + st.st_size;
+		version = version * 33 + st.st_mtim.tv_sec;
+		version = version * 33 + st.st_mtim.tv_nsec;
+	}
+
+	closedir(dp);
+	g_free(folder);
+
+	return version ? version : 1;
+}
+
 void phonebook_req_finalize(void *request)
 {
 	struct dummy_data *dummy = request;
@@ -37,9 +37,14 @@
 #define PB_FORMAT_VCARD30	1
 #define PB_FORMAT_NONE		2
 
+/* Number of contacts converted to vCards per part delivered to PBAP */
+#define VCARDS_PER_PART		64
+
 ESourceRegistry *registry;
 ESource *address_book;
 EBookClient *book_client;
+static EBookClientView *book_view;
+static uint32_t book_version = 1;
 
 struct query_context {
 	const struct apparam_field *params;
@@ -53,6 +58,9 @@ struct query_context {
 	unsigned queued_calls;
 	void *user_data;
 	gboolean canceled;
+	GSList *contacts;
+	GSList *next;
+	guint part_id;
 };
 
 static const char *attribute_mask[] = {
@@ -92,6 +100,11 @@ static void free_query_context(struct query_context *data)
 {
 	g_free(data->uid);
 
+	if (data->part_id)
+		g_source_remove(data->part_id);
+
+	g_slist_free_full(data->contacts, (GDestroyNotify) g_object_unref);
+
 	if (data->buf != NULL)
 		g_string_free(data->buf, TRUE);
 
@@ -265,14 +278,77 @@ void *phonebook_pull(const char *name, const struct apparam_field *params,
 	return data;
 }
 
+static void pull_part(struct query_context *data)
+{
+	GString *buf = data->buf;
+	unsigned int count, maxcount = data->params->maxlistcount;
+	gboolean lastpart;
+
+	/*
+	 * Convert the next contacts to vCards so the buffer handed to the
+	 * PBAP core is bounded by the part size, not by the phonebook size.
+	 */
+	for (count = 0; data->next && count < VCARDS_PER_PART &&
+				data->count < maxcount;
+				data->next = g_slist_next(data->next)) {
+		EContact *contact = E_CONTACT(data->next->data);
+		EVCard *evcard = E_VCARD(contact);
+		char *vcard;
+
+		if (data->params->format == PB_FORMAT_VCARD30)
+			vcard = evcard_to_string(evcard, EVC_FORMAT_VCARD_30,
+							 data->params->filter);
+		else if (data->params->format == PB_FORMAT_VCARD21)
+			vcard = evcard_to_string(evcard, EVC_FORMAT_VCARD_21,
+							 data->params->filter);
+		else {
+			error("unknown format: %d", data->params->format);
+			continue;
+		}
+
+		buf = g_string_append(buf, vcard);
+		buf = g_string_append(buf, "\r\n");
+		g_free(vcard);
+
+		count++;
+		data->count++;
+	}
+
+	DBG("collected %d contacts", count);
+
+	lastpart = !data->next || data->count >= maxcount;
+	if (!lastpart) {
+		data->contacts_cb(buf->str, buf->len, data->count, 0, FALSE,
+							data->user_data);
+		g_string_truncate(buf, 0);
+		return;
+	}
+
+	/* The request may be finalized from the callback */
+	data->buf = NULL;
+
+	data->contacts_cb(buf->str, buf->len, data->count, 0, TRUE,
+							data->user_data);
+	g_string_free(buf, TRUE);
+}
+
+static gboolean pull_part_idle(gpointer user_data)
+{
+	struct query_context *data = user_data;
+
+	data->part_id = 0;
+
+	pull_part(data);
+
+	return FALSE;
+}
+
 static void phonebook_pull_read_ready(GObject *source_object,
 				      GAsyncResult *result, gpointer user_data)
 {
 	struct query_context *data = user_data;
-	GSList *l = NULL;
 	GSList *contacts = NULL;
 	GError *gerr = NULL;
-	unsigned int count, maxcount;
 
 	/* Finish async call to retrieve contacts */
 	data->queued_calls--;
@@ -294,55 +370,24 @@ static void phonebook_pull_read_ready(GObject *source_object,
 	 * indexes in the phonebook of interest. All other parameters that
 	 * may be present in the request shall be ignored.
 	 */
-	maxcount = data->params->maxlistcount;
-	if (maxcount == 0) {
+	if (data->params->maxlistcount == 0) {
 		data->count += g_slist_length(contacts);
+		g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
 		goto done;
 	}
 
-	/*
-	 * Convert each contact to a vCard and append the card to
-	 * the buffer string.
-	 */
-	l = g_slist_nth(contacts, data->params->liststartoffset);
-	for (count = 0; l && count + data->count < maxcount;
-						l = g_slist_next(l), count++) {
-		EContact *contact = E_CONTACT(l->data);
-		EVCard *evcard = E_VCARD(contact);
-		char *vcard;
-
-		if (data->params->format == PB_FORMAT_VCARD30)
-			vcard = evcard_to_string(evcard, EVC_FORMAT_VCARD_30,
-							 data->params->filter);
-		else if (data->params->format == PB_FORMAT_VCARD21)
-			vcard = evcard_to_string(evcard, EVC_FORMAT_VCARD_21,
-							 data->params->filter);
-		else
-			error("unknown format: %d", data->params->format);
-
-		data->buf = g_string_append(data->buf, vcard);
-		data->buf = g_string_append(data->buf, "\r\n");
-		g_free(vcard);
-	}
-
-	DBG("collected %d contacts", count);
-
-	data->count += count;
-	g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
+	data->contacts = contacts;
+	data->next = g_slist_nth(contacts, data->params->liststartoffset);
 
 done:
-	if (data->queued_calls == 0) {
-		GString *buf = data->buf;
-		data->buf = NULL;
-
-		data->contacts_cb(buf->str, buf->len, data->count, 0, TRUE,
-							      data->user_data);
-		g_string_free(buf, TRUE);
-	}
+	if (data->queued_calls == 0)
+		pull_part(data);
 
 	return;
 
 canceled:
+	g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
+
 	if (data->queued_calls == 0)
 		free_query_context(data);
 }
@@ -350,13 +395,22 @@ canceled:
 int phonebook_pull_read(void *request)
 {
 	struct query_context *data = request;
-	GError *gerr = NULL;
 
 	if (!data) {
 		error("Request data is empty");
 		return -ENOENT;
 	}
 
+	/*
+	 * Contacts were already retrieved, the next part is generated from
+	 * the main loop since the PBAP core waits for it asynchronously.
+	 */
+	if (data->contacts) {
+		if (!data->part_id)
+			data->part_id = g_idle_add(pull_part_idle, data);
+		return 0;
+	}
+
 	DBG("retrieving all contacts");
 
 	/* Fetch async contacts from default address book */
@@ -622,6 +676,59 @@ next:
 	return data;
 }
 
+static void book_changed(EBookClientView *view, const GSList *objects,
+							gpointer user_data)
+{
+	if (++book_version == 0)
+		book_version = 1;
+}
+
+static void book_view_start(void)
+{
+	EBookQuery *query;
+	GError *gerr = NULL;
+	char *sexp;
+
+	query = e_book_query_any_field_contains("");
+	sexp = e_book_query_to_string(query);
+	e_book_query_unref(query);
+
+	e_book_client_get_view_sync(book_client, sexp, &book_view, NULL,
+									&gerr);
+	g_free(sexp);
+
+	if (gerr != NULL) {
+		error("Unable to create book view: %s", gerr->message);
+		g_error_free(gerr);
+		book_view = NULL;
+		return;
+	}
+
+	g_signal_connect(book_view, "objects-added",
+					G_CALLBACK(book_changed), NULL);
+	g_signal_connect(book_view, "objects-modified",
+					G_CALLBACK(book_changed), NULL);
+	g_signal_connect(book_view, "objects-removed",
+					G_CALLBACK(book_changed), NULL);
+
+	e_book_client_view_start(book_view, &gerr);
+	if (gerr != NULL) {
+		error("Unable to start book view: %s", gerr->message);
+		g_error_free(gerr);
+		g_object_unref(book_view);
+		book_view = NULL;
+	}
+}
+
+uint32_t phonebook_get_version(const char *name)
+{
+	/* Without change notifications the contacts can't be cached */
+	if (book_view == NULL || g_strcmp0(PB_CONTACTS, name) != 0)
+		return 0;
+
+	return book_version;
+}
+
 int phonebook_init(void)
 {
 	EClient *client;
@@ -656,11 +763,18 @@ int phonebook_init(void)
 
 	DBG("created address book client");
 
+	book_view_start();
+
 	return 0;
 }
 
 void phonebook_exit(void)
 {
+	if (book_view) {
+		e_book_client_view_stop(book_view, NULL);
+		g_object_unref(book_view);
+	}
+
 	g_object_unref(book_client);
 	g_object_unref(address_book);
 	g_object_unref(registry);
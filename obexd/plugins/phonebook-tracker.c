@@ -1430,6 +1430,12 @@ void phonebook_exit(void)
 {
 }
 
+uint32_t phonebook_get_version(const char *name)
+{
+	/* Call history reads reset the missed calls, never cache */
+	return 0;
+}
+
 char *phonebook_set_folder(const char *current_folder, const char *new_folder,
 						uint8_t flags, int *err)
 {
@@ -151,3 +151,11 @@ void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
  * phonebook_get_entry, and phonebook_create_cache.
  */
 void phonebook_req_finalize(void *request);
+
+/*
+ * Returns a change counter for the given phonebook object (e.g.
+ * "/telecom/pb.vcf"). The value MUST change whenever the content that
+ * phonebook_pull would return changes. PBAP core uses it to serve repeated
+ * pulls from memory, returning 0 disables caching for the object.
+ */
+uint32_t phonebook_get_version(const char *name);
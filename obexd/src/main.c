@@ -129,6 +129,7 @@ static char *option_noplugin = NULL;
 static gboolean option_autoaccept = FALSE;
 static gboolean option_symlinks = FALSE;
 static gboolean option_system_bus = FALSE;
+static int option_mtu = OBEX_DEFAULT_MTU;
 
 static gboolean parse_debug(const char *key, const char *value,
 				gpointer user_data, GError **error)
@@ -169,6 +170,9 @@ static const GOptionEntry options[] = {
 				"Automatically accept push requests" },
 	{ "system-bus", 's', 0, G_OPTION_ARG_NONE, &option_system_bus,
 				"Use System bus "},
+	{ "mtu", 'm', 0, G_OPTION_ARG_INT, &option_mtu,
+				"Specify maximum OBEX packet size, limited by "
+				"the transport MTU. Default 32767", "SIZE" },
 	{ NULL },
 };
 
@@ -192,6 +196,11 @@ const char *obex_option_capability(void)
 	return option_capability;
 }
 
+uint16_t obex_option_mtu(void)
+{
+	return option_mtu;
+}
+
 static gboolean is_dir(const char *dir)
 {
 	struct stat st;
@@ -273,6 +282,13 @@ int main(int argc, char *argv[])
 
 	g_option_context_free(context);
 
+	if (option_mtu < OBEX_MINIMUM_MTU || option_mtu > OBEX_MAXIMUM_MTU) {
+		g_printerr("Invalid MTU %d, must be between %u and %u\n",
+					option_mtu, OBEX_MINIMUM_MTU,
+					OBEX_MAXIMUM_MTU);
+		exit(EXIT_FAILURE);
+	}
+
 	__obex_log_init(option_debug, option_detach);
 
 	DBG("Entering main loop");
@@ -322,7 +322,7 @@ static ssize_t driver_write(struct obex_session *os)
 			error("write(): %s (%zd)", strerror(-w), -w);
 			if (w == -EINTR)
 				continue;
-			else if (w == -EINVAL)
+			else if (w == -EINVAL || w == -EAGAIN)
 				memmove(os->buf, os->buf + len, os->pending);
 
 			return w;
@@ -359,6 +359,7 @@ static gssize driver_read(struct obex_session *os, void *buf, gsize size)
 		if (len == -EAGAIN)
 			obex_object_set_io_watch(os->object, handle_async_io,
 									os);
+		return len;
 	}
 
 	os->offset += len;
@@ -20,6 +20,10 @@
 #define OBEX_MAS	(1 << 8)
 #define OBEX_MNS	(1 << 9)
 
+#define OBEX_MINIMUM_MTU	255
+#define OBEX_DEFAULT_MTU	32767
+#define OBEX_MAXIMUM_MTU	65535
+
 void plugin_init(const char *pattern, const char *exclude);
 void plugin_cleanup(void);
 
@@ -30,6 +34,7 @@ gboolean obex_option_auto_accept(void);
 const char *obex_option_root_folder(void);
 gboolean obex_option_symlinks(void);
 const char *obex_option_capability(void);
+uint16_t obex_option_mtu(void);
 DBusConnection *obex_get_dbus_connection(void);
 DBusConnection *obex_setup_dbus_connection(const char *name,
 					DBusError *error);
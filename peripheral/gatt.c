@@ -33,6 +33,21 @@
 #define ATT_CID 4
 
 #define UUID_GAP 0x1800
+#define UUID_DEVINFO 0x180a
+
+struct static_chrc {
+	uint16_t uuid;
+	uint32_t permissions;
+	uint8_t properties;
+	gatt_db_read_t read_func;
+};
+
+struct static_service {
+	uint16_t uuid;
+	uint16_t num_handles;
+	const struct static_chrc *chrcs;
+	size_t num_chrcs;
+};
 
 struct gatt_conn {
 	struct bt_att *att;
@@ -199,32 +214,47 @@ static void gap_device_name_read(struct gatt_db_attribute *attrib,
 	gatt_db_attribute_read_result(attrib, id, error, value, len);
 }
 
-static void populate_gap_service(struct gatt_db *db)
-{
-	struct gatt_db_attribute *service;
-	bt_uuid_t uuid;
-
-	bt_uuid16_create(&uuid, UUID_GAP);
-	service = gatt_db_add_service(db, &uuid, true, 6);
-
-	bt_uuid16_create(&uuid, GATT_CHARAC_DEVICE_NAME);
-	gatt_db_service_add_characteristic(service, &uuid,
-					BT_ATT_PERM_READ,
-					BT_GATT_CHRC_PROP_READ,
-					gap_device_name_read, NULL, NULL);
+static const struct static_chrc gap_chrcs[] = {
+	{ GATT_CHARAC_DEVICE_NAME, BT_ATT_PERM_READ, BT_GATT_CHRC_PROP_READ,
+						gap_device_name_read },
+};
 
-	gatt_db_service_set_active(service, true);
-}
+/*
+ * The layout of the local database is fixed at build time, so it is kept
+ * as a constant table and the database is populated from it in one pass.
+ */
+static const struct static_service static_services[] = {
+	{ UUID_GAP, 6, gap_chrcs, ARRAY_SIZE(gap_chrcs) },
+	{ UUID_DEVINFO, 17, NULL, 0 },
+};
 
-static void populate_devinfo_service(struct gatt_db *db)
+static void populate_static_services(struct gatt_db *db)
 {
-	struct gatt_db_attribute *service;
-	bt_uuid_t uuid;
-
-	bt_uuid16_create(&uuid, 0x180a);
-	service = gatt_db_add_service(db, &uuid, true, 17);
-
-	gatt_db_service_set_active(service, true);
+	size_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(static_services); i++) {
+		const struct static_service *s = &static_services[i];
+		struct gatt_db_attribute *service;
+		bt_uuid_t uuid;
+
+		bt_uuid16_create(&uuid, s->uuid);
+		service = gatt_db_add_service(db, &uuid, true, s->num_handles);
+		if (!service)
+			continue;
+
+		for (j = 0; j < s->num_chrcs; j++) {
+			const struct static_chrc *c = &s->chrcs[j];
+
+			bt_uuid16_create(&uuid, c->uuid);
+			gatt_db_service_add_characteristic(service, &uuid,
+							c->permissions,
+							c->properties,
+							c->read_func, NULL,
+							NULL);
+		}
+
+		gatt_db_service_set_active(service, true);
+	}
 }
 
 void gatt_server_start(void)
@@ -268,8 +298,7 @@ void gatt_server_start(void)
 		return;
 	}
 
-	populate_gap_service(gatt_db);
-	populate_devinfo_service(gatt_db);
+	populate_static_services(gatt_db);
 
 	gatt_cache = gatt_db_new();
 
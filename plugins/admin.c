@@ -97,12 +97,18 @@ static void admin_policy_destroy(struct btd_admin_policy *admin_policy)
 	admin_policy_free(admin_policy);
 }
 
-static bool uuid_match(const void *data, const void *match_data)
+static guint uuid_hash(gconstpointer key)
 {
-	const bt_uuid_t *uuid = data;
-	const bt_uuid_t *match_uuid = match_data;
+	uint64_t uuid_128[2];
 
-	return bt_uuid_cmp(uuid, match_uuid) == 0;
+	bt_uuid_to_uuid128(key, (bt_uuid_t *) uuid_128);
+
+	return g_int64_hash(uuid_128) ^ g_int64_hash(uuid_128 + 1);
+}
+
+static gboolean uuid_equal(gconstpointer v1, gconstpointer v2)
+{
+	return bt_uuid_cmp(v1, v2) == 0;
 }
 
 static struct queue *parse_allow_service_list(struct btd_adapter *adapter,
@@ -110,11 +116,14 @@ static struct queue *parse_allow_service_list(struct btd_adapter *adapter,
 {
 	DBusMessageIter iter, arr_iter;
 	struct queue *uuid_list = NULL;
+	GHashTable *uuid_set;
 
 	dbus_message_iter_init(msg, &iter);
 	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
 		return NULL;
 
+	/* Only used to drop duplicates without rescanning the list */
+	uuid_set = g_hash_table_new(uuid_hash, uuid_equal);
 	uuid_list = queue_new();
 	dbus_message_iter_recurse(&iter, &arr_iter);
 	do {
@@ -141,18 +150,22 @@ static struct queue *parse_allow_service_list(struct btd_adapter *adapter,
 
 		dbus_message_iter_next(&arr_iter);
 
-		if (queue_find(uuid_list, uuid_match, uuid)) {
+		if (g_hash_table_contains(uuid_set, uuid)) {
 			g_free(uuid);
 			continue;
 		}
 
+		g_hash_table_add(uuid_set, uuid);
 		queue_push_head(uuid_list, uuid);
 
 	} while (true);
 
+	g_hash_table_destroy(uuid_set);
+
 	return uuid_list;
 
 failed:
+	g_hash_table_destroy(uuid_set);
 	queue_destroy(uuid_list, g_free);
 	return NULL;
 }
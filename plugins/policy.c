@@ -16,6 +16,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <limits.h>
 
 #include <glib.h>
 
@@ -31,6 +32,8 @@
 #include "src/service.h"
 #include "src/profile.h"
 #include "src/btd.h"
+#include "src/storage.h"
+#include "src/textfile.h"
 #include "src/shared/timeout.h"
 #include "src/shared/util.h"
 
@@ -46,6 +49,21 @@
 #define CT_RETRIES 1
 #define TG_RETRIES CT_RETRIES
 
+enum reconnect_class {
+	RECONNECT_AUDIO,
+	RECONNECT_HID,
+	RECONNECT_OTHER,
+	RECONNECT_CLASSES
+};
+
+static const char *reconnect_class_str[] = { "audio", "hid", "other" };
+
+struct reconnect_stats {
+	unsigned int attempts;
+	unsigned int connected;
+	unsigned int failed;
+};
+
 struct reconnect_data {
 	struct btd_device *dev;
 	bool reconnect;
@@ -54,12 +72,18 @@ struct reconnect_data {
 	bool active;
 	unsigned int attempt;
 	bool on_resume;
+	enum reconnect_class class;
+	bool queued;
+	bool connecting;
+	bool stored;
 };
 
 static const char *default_reconnect[] = {
 			HSP_AG_UUID, HFP_AG_UUID, A2DP_SOURCE_UUID,
 			A2DP_SINK_UUID, NULL };
 static char **reconnect_uuids = NULL;
+static bt_uuid_t *reconnect_uuid_set = NULL;
+static size_t reconnect_uuid_count = 0;
 
 static const size_t default_attempts = 7;
 static size_t reconnect_attempts = 0;
@@ -71,10 +95,25 @@ static size_t reconnect_intervals_len = 0;
 static const int default_resume_delay = 2;
 static int resume_delay;
 
+static const int default_reconnect_spacing = 500;
+static int reconnect_spacing;
+
+static const int default_reconnect_jitter = 20;
+static int reconnect_jitter;
+
+static int reconnect_concurrency;
+static int reconnect_connecting;
+
 static GSList *reconnects = NULL;
+static GHashTable *reconnect_table = NULL;	/* Indexed by btd_device */
+
+/* Reconnections due, ordered by class, started one per adapter at a time */
+static GSList *reconnect_queue = NULL;
+static unsigned int reconnect_queue_timer = 0;
+static struct reconnect_stats reconnect_stats[RECONNECT_CLASSES];
 
 static unsigned int service_id = 0;
-static GSList *devices = NULL;
+static GHashTable *devices = NULL;	/* Indexed by btd_device */
 
 static const bool default_auto_enable = true;
 static bool auto_enable = false;
@@ -96,16 +135,7 @@ struct policy_data {
 
 static struct reconnect_data *reconnect_find(struct btd_device *dev)
 {
-	GSList *l;
-
-	for (l = reconnects; l; l = g_slist_next(l)) {
-		struct reconnect_data *reconnect = l->data;
-
-		if (reconnect->dev == dev)
-			return reconnect;
-	}
-
-	return NULL;
+	return g_hash_table_lookup(reconnect_table, dev);
 }
 
 static void policy_connect(struct policy_data *data,
@@ -159,16 +189,7 @@ static void policy_set_ct_timer(struct policy_data *data, int timeout)
 
 static struct policy_data *find_data(struct btd_device *dev)
 {
-	GSList *l;
-
-	for (l = devices; l; l = l->next) {
-		struct policy_data *data = l->data;
-
-		if (data->dev == dev)
-			return data;
-	}
-
-	return NULL;
+	return g_hash_table_lookup(devices, dev);
 }
 
 static void policy_remove(void *user_data)
@@ -204,7 +225,7 @@ static struct policy_data *policy_get_data(struct btd_device *dev)
 	data = g_new0(struct policy_data, 1);
 	data->dev = dev;
 
-	devices = g_slist_prepend(devices, data);
+	g_hash_table_insert(devices, dev, data);
 
 	return data;
 }
@@ -606,8 +627,121 @@ static void target_cb(struct btd_service *service,
 	}
 }
 
+static void reconnect_dequeue(struct reconnect_data *reconnect);
+
+static void reconnect_filename(struct btd_device *dev, char *filename)
+{
+	char dst_addr[18];
+
+	ba2str(device_get_address(dev), dst_addr);
+
+	create_filename(filename, PATH_MAX, "/%s/cache/%s",
+			btd_adapter_get_storage_dir(device_get_adapter(dev)),
+			dst_addr);
+}
+
+static void reconnect_save(struct btd_device *dev, GKeyFile *key_file)
+{
+	char filename[PATH_MAX];
+	GError *gerr = NULL;
+	char *data;
+	gsize length = 0;
+
+	reconnect_filename(dev, filename);
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	if (!btd_storage_save(filename, data, length, &gerr)) {
+		error("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+
+	g_free(data);
+}
+
+static GKeyFile *reconnect_load(struct btd_device *dev)
+{
+	char filename[PATH_MAX];
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+
+	reconnect_filename(dev, filename);
+
+	key_file = g_key_file_new();
+	if (!btd_storage_load(key_file, filename, &gerr))
+		g_clear_error(&gerr);
+
+	return key_file;
+}
+
+/* Keep the backoff state across restarts so that a reconnection resumes
+ * with the interval it had reached.
+ */
+static void reconnect_store(struct reconnect_data *reconnect)
+{
+	struct btd_device *dev = reconnect->dev;
+	GKeyFile *key_file;
+
+	if (!device_is_bonded(dev, btd_device_get_bdaddr_type(dev)))
+		return;
+
+	key_file = reconnect_load(dev);
+	g_key_file_set_integer(key_file, "Reconnect", "Attempt",
+							reconnect->attempt);
+	reconnect_save(dev, key_file);
+	g_key_file_free(key_file);
+
+	reconnect->stored = true;
+}
+
+static void reconnect_clear(struct reconnect_data *reconnect)
+{
+	GKeyFile *key_file;
+
+	if (!reconnect->stored)
+		return;
+
+	reconnect->stored = false;
+
+	key_file = reconnect_load(reconnect->dev);
+	if (g_key_file_remove_group(key_file, "Reconnect", NULL))
+		reconnect_save(reconnect->dev, key_file);
+	g_key_file_free(key_file);
+}
+
+static int reconnect_stored_attempt(struct btd_device *dev)
+{
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+	int attempt;
+
+	key_file = reconnect_load(dev);
+	attempt = g_key_file_get_integer(key_file, "Reconnect", "Attempt",
+									&gerr);
+	if (gerr) {
+		g_error_free(gerr);
+		attempt = -1;
+	}
+
+	g_key_file_free(key_file);
+
+	return attempt;
+}
+
+static void reconnect_set_connecting(struct reconnect_data *reconnect,
+							bool connecting)
+{
+	if (reconnect->connecting == connecting)
+		return;
+
+	reconnect->connecting = connecting;
+	reconnect_connecting += connecting ? 1 : -1;
+}
+
 static void reconnect_reset(struct reconnect_data *reconnect)
 {
+	reconnect_dequeue(reconnect);
+
 	reconnect->attempt = 0;
 	reconnect->active = false;
 
@@ -617,21 +751,69 @@ static void reconnect_reset(struct reconnect_data *reconnect)
 	}
 }
 
+static void reconnect_uuids_compile(void)
+{
+	size_t i, len;
+
+	len = reconnect_uuids ? g_strv_length(reconnect_uuids) : 0;
+	reconnect_uuid_set = new0(bt_uuid_t, len);
+
+	for (i = 0; i < len; i++) {
+		bt_uuid_t *uuid = &reconnect_uuid_set[reconnect_uuid_count];
+
+		if (bt_string_to_uuid(uuid, reconnect_uuids[i]) < 0) {
+			error("Invalid ReconnectUUIDs entry: %s",
+						reconnect_uuids[i]);
+			continue;
+		}
+
+		reconnect_uuid_count++;
+	}
+}
+
 static bool reconnect_match(const char *uuid)
 {
-	char **str;
+	bt_uuid_t u;
+	size_t i;
 
-	if (!reconnect_uuids)
+	if (bt_string_to_uuid(&u, uuid) < 0)
 		return false;
 
-	for (str = reconnect_uuids; *str; str++) {
-		if (!bt_uuid_strcmp(uuid, *str))
+	for (i = 0; i < reconnect_uuid_count; i++) {
+		if (!bt_uuid_cmp(&u, &reconnect_uuid_set[i]))
 			return true;
 	}
 
 	return false;
 }
 
+static enum reconnect_class reconnect_get_class(
+					struct reconnect_data *reconnect)
+{
+	enum reconnect_class class = RECONNECT_OTHER;
+	GSList *l;
+
+	for (l = reconnect->services; l; l = g_slist_next(l)) {
+		struct btd_profile *p = btd_service_get_profile(l->data);
+
+		if (!p->remote_uuid)
+			continue;
+
+		if (g_str_equal(p->remote_uuid, A2DP_SINK_UUID) ||
+				g_str_equal(p->remote_uuid, A2DP_SOURCE_UUID) ||
+				g_str_equal(p->remote_uuid, HFP_AG_UUID) ||
+				g_str_equal(p->remote_uuid, HFP_HS_UUID) ||
+				g_str_equal(p->remote_uuid, HSP_AG_UUID) ||
+				g_str_equal(p->remote_uuid, HSP_HS_UUID))
+			return RECONNECT_AUDIO;
+
+		if (g_str_equal(p->remote_uuid, HID_UUID))
+			class = RECONNECT_HID;
+	}
+
+	return class;
+}
+
 static struct reconnect_data *reconnect_add(struct btd_service *service)
 {
 	struct btd_device *dev = btd_service_get_device(service);
@@ -642,6 +824,7 @@ static struct reconnect_data *reconnect_add(struct btd_service *service)
 		reconnect = g_new0(struct reconnect_data, 1);
 		reconnect->dev = dev;
 		reconnects = g_slist_append(reconnects, reconnect);
+		g_hash_table_insert(reconnect_table, dev, reconnect);
 	}
 
 	if (g_slist_find(reconnect->services, service))
@@ -650,6 +833,8 @@ static struct reconnect_data *reconnect_add(struct btd_service *service)
 	reconnect->services = g_slist_append(reconnect->services,
 						btd_service_ref(service));
 
+	reconnect->class = reconnect_get_class(reconnect);
+
 	return reconnect;
 }
 
@@ -657,6 +842,8 @@ static void reconnect_destroy(gpointer data)
 {
 	struct reconnect_data *reconnect = data;
 
+	reconnect_dequeue(reconnect);
+
 	if (reconnect->timer > 0)
 		timeout_remove(reconnect->timer);
 
@@ -686,6 +873,9 @@ static void reconnect_remove(struct btd_service *service)
 		return;
 
 	reconnects = g_slist_remove(reconnects, reconnect);
+	g_hash_table_remove(reconnect_table, dev);
+
+	reconnect_dequeue(reconnect);
 
 	if (reconnect->timer > 0)
 		timeout_remove(reconnect->timer);
@@ -693,6 +883,184 @@ static void reconnect_remove(struct btd_service *service)
 	g_free(reconnect);
 }
 
+static bool reconnect_adapter_busy(struct btd_adapter *adapter)
+{
+	GSList *l;
+
+	for (l = reconnects; l; l = g_slist_next(l)) {
+		struct reconnect_data *reconnect = l->data;
+
+		if (reconnect->connecting &&
+				device_get_adapter(reconnect->dev) == adapter)
+			return true;
+	}
+
+	return false;
+}
+
+static void reconnect_start(struct reconnect_data *reconnect)
+{
+	struct reconnect_stats *stats = &reconnect_stats[reconnect->class];
+	int err;
+
+	DBG("Reconnecting %s profiles of %s",
+			reconnect_class_str[reconnect->class],
+			device_get_path(reconnect->dev));
+
+	err = btd_device_connect_services(reconnect->dev, reconnect->services);
+	if (err < 0) {
+		error("Reconnecting services failed: %s (%d)",
+							strerror(-err), -err);
+		reconnect_reset(reconnect);
+		return;
+	}
+
+	reconnect_set_connecting(reconnect, true);
+	reconnect->attempt++;
+	stats->attempts++;
+}
+
+static void reconnect_dispatch(void)
+{
+	GSList *l, *next;
+
+	for (l = reconnect_queue; l; l = next) {
+		struct reconnect_data *reconnect = l->data;
+
+		next = g_slist_next(l);
+
+		if (reconnect_concurrency > 0 &&
+				reconnect_connecting >= reconnect_concurrency)
+			break;
+
+		/* Paging is serialized by the controller anyway, and each
+		 * attempt holds off LE connections while it lasts.
+		 */
+		if (reconnect_adapter_busy(device_get_adapter(reconnect->dev)))
+			continue;
+
+		reconnect_queue = g_slist_delete_link(reconnect_queue, l);
+		reconnect->queued = false;
+
+		reconnect_start(reconnect);
+	}
+}
+
+static bool reconnect_queue_timeout(gpointer user_data)
+{
+	reconnect_queue_timer = 0;
+
+	reconnect_dispatch();
+
+	return FALSE;
+}
+
+static gint reconnect_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct reconnect_data *ra = a;
+	const struct reconnect_data *rb = b;
+
+	return ra->class - rb->class;
+}
+
+static void reconnect_enqueue(struct reconnect_data *reconnect)
+{
+	if (reconnect->queued || reconnect->connecting)
+		return;
+
+	reconnect->queued = true;
+	reconnect_queue = g_slist_insert_sorted(reconnect_queue, reconnect,
+								reconnect_cmp);
+
+	if (!reconnect_queue_timer)
+		reconnect_dispatch();
+}
+
+static void reconnect_dequeue(struct reconnect_data *reconnect)
+{
+	if (reconnect->queued) {
+		reconnect_queue = g_slist_remove(reconnect_queue, reconnect);
+		reconnect->queued = false;
+	}
+
+	if (!reconnect->connecting)
+		return;
+
+	reconnect_set_connecting(reconnect, false);
+
+	if (!reconnect_queue_timer)
+		reconnect_dispatch();
+}
+
+static void reconnect_complete(struct reconnect_data *reconnect,
+								bool success)
+{
+	struct reconnect_stats *stats = &reconnect_stats[reconnect->class];
+
+	reconnect_set_connecting(reconnect, false);
+
+	if (success)
+		stats->connected++;
+	else
+		stats->failed++;
+
+	DBG("%s: attempts %u connected %u failed %u",
+			reconnect_class_str[reconnect->class], stats->attempts,
+			stats->connected, stats->failed);
+
+	if (!reconnect_queue)
+		return;
+
+	/* Leave the radio to LE scanning and connections for a while */
+	if (reconnect_spacing > 0) {
+		if (!reconnect_queue_timer)
+			reconnect_queue_timer = timeout_add(reconnect_spacing,
+						reconnect_queue_timeout,
+						NULL, NULL);
+		return;
+	}
+
+	reconnect_dispatch();
+}
+
+static void reconnect_set_timer(struct reconnect_data *reconnect,
+								int timeout);
+
+static void reconnect_resume(struct btd_service *service)
+{
+	struct btd_profile *profile = btd_service_get_profile(service);
+	struct btd_device *dev = btd_service_get_device(service);
+	struct reconnect_data *reconnect;
+	int attempt;
+
+	reconnect = reconnect_find(dev);
+	if (reconnect) {
+		reconnect_add(service);
+		return;
+	}
+
+	if (!reconnect_match(profile->remote_uuid))
+		return;
+
+	attempt = reconnect_stored_attempt(dev);
+	if (attempt < 0)
+		return;
+
+	reconnect = reconnect_add(service);
+	reconnect->reconnect = true;
+	reconnect->stored = true;
+
+	if ((size_t) attempt >= reconnect_attempts) {
+		reconnect_clear(reconnect);
+		return;
+	}
+
+	DBG("Resuming reconnection of %s", device_get_path(dev));
+
+	reconnect->attempt = attempt;
+	reconnect_set_timer(reconnect, -1);
+}
+
 static void service_cb(struct btd_service *service,
 						btd_service_state_t old_state,
 						btd_service_state_t new_state,
@@ -737,6 +1105,21 @@ static void service_cb(struct btd_service *service,
 		return;
 	}
 
+	/* Pick up a reconnection interrupted by a restart */
+	if (old_state == BTD_SERVICE_STATE_UNAVAILABLE) {
+		reconnect_resume(service);
+		return;
+	}
+
+	/* A scheduled reconnection failing at profile level */
+	if (old_state == BTD_SERVICE_STATE_CONNECTING &&
+			new_state == BTD_SERVICE_STATE_DISCONNECTED) {
+		reconnect = reconnect_find(btd_service_get_device(service));
+		if (reconnect && reconnect->connecting)
+			reconnect_complete(reconnect, false);
+		return;
+	}
+
 	if (new_state != BTD_SERVICE_STATE_CONNECTED)
 		return;
 
@@ -746,7 +1129,11 @@ static void service_cb(struct btd_service *service,
 	 */
 	reconnect = reconnect_add(service);
 
+	if (reconnect->connecting)
+		reconnect_complete(reconnect, true);
+
 	reconnect->active = false;
+	reconnect_clear(reconnect);
 
 	/*
 	 * Should this device be reconnected? A matching UUID might not
@@ -762,7 +1149,6 @@ static void service_cb(struct btd_service *service,
 static bool reconnect_timeout(gpointer data)
 {
 	struct reconnect_data *reconnect = data;
-	int err;
 
 	DBG("Reconnecting profiles");
 
@@ -772,15 +1158,7 @@ static bool reconnect_timeout(gpointer data)
 	/* Mark any reconnect on resume as handled */
 	reconnect->on_resume = false;
 
-	err = btd_device_connect_services(reconnect->dev, reconnect->services);
-	if (err < 0) {
-		error("Reconnecting services failed: %s (%d)",
-							strerror(-err), -err);
-		reconnect_reset(reconnect);
-		return FALSE;
-	}
-
-	reconnect->attempt++;
+	reconnect_enqueue(reconnect);
 
 	return FALSE;
 }
@@ -788,6 +1166,7 @@ static bool reconnect_timeout(gpointer data)
 static void reconnect_set_timer(struct reconnect_data *reconnect, int timeout)
 {
 	static int interval_timeout = 0;
+	unsigned int ms, jitter = 0;
 
 	reconnect->active = true;
 
@@ -797,11 +1176,18 @@ static void reconnect_set_timer(struct reconnect_data *reconnect, int timeout)
 	if (timeout < 0)
 		timeout = interval_timeout;
 
-	DBG("attempt %u/%zu %d seconds", reconnect->attempt + 1,
-						reconnect_attempts, timeout);
+	ms = timeout * 1000;
+
+	if (reconnect_jitter > 0 &&
+			util_getrandom(&jitter, sizeof(jitter), 0) > 0)
+		ms += jitter % (ms / 100 * reconnect_jitter + 1);
+
+	DBG("attempt %u/%zu %u ms", reconnect->attempt + 1,
+						reconnect_attempts, ms);
 
-	reconnect->timer = timeout_add_seconds(timeout, reconnect_timeout,
-						reconnect, NULL);
+	reconnect_store(reconnect);
+
+	reconnect->timer = timeout_add(ms, reconnect_timeout, reconnect, NULL);
 }
 
 static void disconnect_cb(struct btd_device *dev, uint8_t reason)
@@ -876,6 +1262,9 @@ static void conn_fail_cb(struct btd_device *dev, uint8_t status)
 	if (!reconnect->active)
 		return;
 
+	if (reconnect->connecting)
+		reconnect_complete(reconnect, false);
+
 	/* Give up if we were powered off */
 	if (status == MGMT_STATUS_NOT_POWERED) {
 		reconnect_reset(reconnect);
@@ -885,6 +1274,7 @@ static void conn_fail_cb(struct btd_device *dev, uint8_t status)
 	/* Reset if ReconnectAttempts was reached */
 	if (reconnect->attempt == reconnect_attempts) {
 		reconnect_reset(reconnect);
+		reconnect_clear(reconnect);
 		return;
 	}
 
@@ -912,6 +1302,9 @@ static int policy_init(void)
 	GError *gerr = NULL;
 	GKeyFile *conf;
 
+	reconnect_table = g_hash_table_new(NULL, NULL);
+	devices = g_hash_table_new_full(NULL, NULL, NULL, policy_remove);
+
 	service_id = btd_service_add_state_cb(service_cb, NULL);
 
 	conf = btd_get_main_conf();
@@ -923,6 +1316,8 @@ static int policy_init(void)
 		reconnect_intervals = util_memdup(default_intervals,
 						sizeof(default_intervals));
 		auto_enable = default_auto_enable;
+		reconnect_spacing = default_reconnect_spacing;
+		reconnect_jitter = default_reconnect_jitter;
 		goto done;
 	}
 
@@ -970,7 +1365,26 @@ static int policy_init(void)
 		g_clear_error(&gerr);
 		resume_delay = default_resume_delay;
 	}
+
+	reconnect_spacing = g_key_file_get_integer(conf, "Policy",
+						"ReconnectSpacing", &gerr);
+	if (gerr) {
+		g_clear_error(&gerr);
+		reconnect_spacing = default_reconnect_spacing;
+	}
+
+	reconnect_jitter = g_key_file_get_integer(conf, "Policy",
+						"ReconnectJitter", &gerr);
+	if (gerr) {
+		g_clear_error(&gerr);
+		reconnect_jitter = default_reconnect_jitter;
+	}
+
+	reconnect_concurrency = g_key_file_get_integer(conf, "Policy",
+						"ReconnectConcurrency", NULL);
 done:
+	reconnect_uuids_compile();
+
 	if (reconnect_uuids && reconnect_uuids[0] && reconnect_attempts) {
 		btd_add_disconnect_cb(disconnect_cb);
 		btd_add_conn_fail_cb(conn_fail_cb);
@@ -989,11 +1403,26 @@ static void policy_exit(void)
 	if (reconnect_uuids)
 		g_strfreev(reconnect_uuids);
 
+	free(reconnect_uuid_set);
+	reconnect_uuid_set = NULL;
+	reconnect_uuid_count = 0;
+
 	free(reconnect_intervals);
 
+	if (reconnect_queue_timer)
+		timeout_remove(reconnect_queue_timer);
+
+	g_slist_free(reconnect_queue);
+	reconnect_queue = NULL;
+
+	g_hash_table_destroy(reconnect_table);
+	reconnect_table = NULL;
+
 	g_slist_free_full(reconnects, reconnect_destroy);
+	reconnects = NULL;
 
-	g_slist_free_full(devices, policy_remove);
+	g_hash_table_destroy(devices);
+	devices = NULL;
 
 	btd_service_remove_state_cb(service_id);
 
@@ -58,6 +58,9 @@ static struct udev_monitor *monitor = NULL;
 static guint watch_id = 0;
 /* key = sysfs_path (const str), value = auth_closure */
 static GHashTable *pending_auths = NULL;
+/* Handled auths, destroyed together once the agent replies are processed */
+static GSList *finished_auths = NULL;
+static guint finished_id = 0;
 
 #define SIXAXIS_HID_SDP_RECORD "3601920900000A000100000900013503191124090004"\
 	"350D35061901000900113503190011090006350909656E09006A090100090009350"\
@@ -253,14 +256,24 @@ static bool is_auth_pending(struct authentication_closure *closure)
 	return false;
 }
 
-static gboolean auth_closure_destroy_idle(gpointer user_data)
+static void finished_auth_destroy(gpointer data)
 {
-	struct authentication_destroy_closure *destroy = user_data;
+	struct authentication_destroy_closure *destroy = data;
 
 	auth_closure_destroy(destroy->closure, destroy->remove_device);
 	g_free(destroy);
+}
 
-	return false;
+static gboolean finished_auths_idle(gpointer user_data)
+{
+	GSList *list = g_slist_reverse(finished_auths);
+
+	finished_auths = NULL;
+	finished_id = 0;
+
+	g_slist_free_full(list, finished_auth_destroy);
+
+	return FALSE;
 }
 
 static void agent_auth_cb(DBusError *derr, void *user_data)
@@ -316,7 +329,10 @@ out:
 	destroy = g_new0(struct authentication_destroy_closure, 1);
 	destroy->closure = closure;
 	destroy->remove_device = remove_device;
-	g_idle_add(auth_closure_destroy_idle, destroy);
+	finished_auths = g_slist_prepend(finished_auths, destroy);
+
+	if (!finished_id)
+		finished_id = g_idle_add(finished_auths_idle, NULL);
 }
 
 static bool setup_device(int fd, const char *sysfs_path,
@@ -474,16 +490,18 @@ static gboolean monitor_watch(GIOChannel *source, GIOCondition condition,
 {
 	struct udev_device *udevice;
 
-	udevice = udev_monitor_receive_device(monitor);
-	if (!udevice)
-		return TRUE;
-
-	if (!g_strcmp0(udev_device_get_action(udevice), "add"))
-		device_added(udevice);
-	else if (!g_strcmp0(udev_device_get_action(udevice), "remove"))
-		device_removed(udevice);
-
-	udev_device_unref(udevice);
+	/*
+	 * Plugging in many controllers at once queues up a burst of events,
+	 * handle all of them in one go since the monitor is non-blocking.
+	 */
+	while ((udevice = udev_monitor_receive_device(monitor))) {
+		if (!g_strcmp0(udev_device_get_action(udevice), "add"))
+			device_added(udevice);
+		else if (!g_strcmp0(udev_device_get_action(udevice), "remove"))
+			device_removed(udevice);
+
+		udev_device_unref(udevice);
+	}
 
 	return TRUE;
 }
@@ -536,6 +554,11 @@ static void sixaxis_exit(void)
 	g_hash_table_destroy(pending_auths);
 	pending_auths = NULL;
 
+	if (finished_id) {
+		g_source_remove(finished_id);
+		finished_auths_idle(NULL);
+	}
+
 	g_source_remove(watch_id);
 	watch_id = 0;
 
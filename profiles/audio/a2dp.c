@@ -41,6 +41,7 @@
 #include "src/service.h"
 #include "src/log.h"
 #include "src/sdpd.h"
+#include "src/storage.h"
 #include "src/textfile.h"
 #include "src/shared/queue.h"
 #include "src/shared/timeout.h"
@@ -147,6 +148,7 @@ struct a2dp_channel {
 	struct avdtp *session;
 	struct queue *seps;
 	struct a2dp_last_used *last_used;
+	unsigned int discover_time;
 };
 
 static GSList *servers = NULL;
@@ -849,7 +851,7 @@ static void store_remote_seps(struct a2dp_channel *chan)
 			dst_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -869,8 +871,15 @@ static void store_remote_seps(struct a2dp_channel *chan)
 		g_free(data);
 	}
 
+	if (chan->session && avdtp_get_discover_time(chan->session))
+		chan->discover_time = avdtp_get_discover_time(chan->session);
+
+	if (chan->discover_time)
+		g_key_file_set_integer(key_file, "Endpoints", "DiscoverTime",
+							chan->discover_time);
+
 	data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, data, length, &gerr)) {
+	if (!btd_storage_save(filename, data, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -891,6 +900,7 @@ static void invalidate_remote_cache(struct a2dp_setup *setup,
 	 */
 	if (setup->rsep && setup->rsep->from_cache) {
 		warn("Invalidating Remote SEP from cache");
+		avdtp_invalidate_cache(setup->session);
 		avdtp_unregister_remote_sep(setup->session, setup->rsep->sep);
 		/* Update cache */
 		store_remote_seps(setup->chan);
@@ -1022,7 +1032,7 @@ static void store_last_used(struct a2dp_channel *chan, uint8_t lseid,
 		dst_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -1033,7 +1043,7 @@ static void store_last_used(struct a2dp_channel *chan, uint8_t lseid,
 	g_key_file_set_string(key_file, "Endpoints", "LastUsed", value);
 
 	data = g_key_file_to_data(key_file, &len, NULL);
-	if (!g_file_set_contents(filename, data, len, &gerr)) {
+	if (!btd_storage_save(filename, data, len, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -2189,6 +2199,10 @@ static void load_remote_sep(struct a2dp_channel *chan, GKeyFile *key_file,
 		uint8_t data[128];
 		int i, size;
 
+		/* DiscoverTime would otherwise parse as seid 0x0d */
+		if (!strcmp(*seids, "DiscoverTime"))
+			continue;
+
 		if (sscanf(*seids, "%02hhx", &rseid) != 1)
 			continue;
 
@@ -2292,13 +2306,16 @@ static void load_remote_seps(struct a2dp_channel *chan)
 			dst_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
 	}
 	keys = g_key_file_get_keys(key_file, "Endpoints", NULL, NULL);
 
+	chan->discover_time = g_key_file_get_integer(key_file, "Endpoints",
+						"DiscoverTime", NULL);
+
 	load_remote_sep(chan, key_file, keys);
 
 	g_strfreev(keys);
@@ -2903,6 +2920,10 @@ static void discover_cb(struct avdtp *session, GSList *seps,
 	if (err)
 		setup_error_set(setup, err);
 
+	if (!err && avdtp_discover_cached(session) && setup->chan)
+		info("a2dp: used cached endpoints, skipped discovery (%u ms)",
+						setup->chan->discover_time);
+
 	if (!err) {
 		g_slist_foreach(seps, foreach_register_remote_sep, setup->chan);
 
@@ -406,6 +406,10 @@ struct avdtp {
 	char *buf;
 
 	struct discover_callback *discover;
+	gint64 discover_start;
+	unsigned int discover_time;	/* Last full discovery in ms */
+	bool discover_cached;		/* Last discovery used cached SEPs */
+	bool cache_invalid;
 	struct pending_req *req;
 
 	unsigned int dc_timer;
@@ -1089,6 +1093,12 @@ static void finalize_discovery(struct avdtp *session, int err)
 	if (!err)
 		g_slist_foreach(session->seps, remove_disappeared, session);
 
+	if (!err && !session->discover_cached && session->discover_start)
+		session->discover_time = (g_get_monotonic_time() -
+					session->discover_start) / 1000;
+
+	session->discover_start = 0;
+
 	if (discover->cb)
 		discover->cb(session, session->seps, err ? &avdtp_err : NULL,
 							discover->user_data);
@@ -3426,6 +3436,52 @@ static gboolean process_discover(gpointer data)
 	return FALSE;
 }
 
+static gint sep_no_codec(gconstpointer a, gconstpointer b)
+{
+	const struct avdtp_remote_sep *sep = a;
+
+	return sep->codec ? 1 : 0;
+}
+
+static void sep_set_discovered(gpointer data, gpointer user_data)
+{
+	struct avdtp_remote_sep *sep = data;
+
+	sep->discovered = true;
+}
+
+static void sep_clear_discovered(gpointer data, gpointer user_data)
+{
+	struct avdtp_remote_sep *sep = data;
+
+	sep->discovered = false;
+}
+
+void avdtp_invalidate_cache(struct avdtp *session)
+{
+	if (!session->discover_cached)
+		return;
+
+	DBG("Cached SEPs invalidated");
+
+	/* Next discovery goes to the remote and drops SEPs it no longer
+	 * reports.
+	 */
+	g_slist_foreach(session->seps, sep_clear_discovered, NULL);
+	session->discover_cached = false;
+	session->cache_invalid = true;
+}
+
+bool avdtp_discover_cached(struct avdtp *session)
+{
+	return session->discover_cached;
+}
+
+unsigned int avdtp_get_discover_time(struct avdtp *session)
+{
+	return session->discover_time;
+}
+
 int avdtp_discover(struct avdtp *session, avdtp_discover_cb_t cb,
 			void *user_data)
 {
@@ -3439,6 +3495,19 @@ int avdtp_discover(struct avdtp *session, avdtp_discover_cb_t cb,
 	if (session->seps) {
 		struct avdtp_remote_sep *sep = session->seps->data;
 
+		/* SEPs loaded from cache are trusted as they are, instead of
+		 * discovering them again, until a configuration using them
+		 * fails.
+		 */
+		if (!sep->discovered && !session->cache_invalid &&
+				g_slist_find_custom(session->seps, NULL,
+						sep_no_codec) == NULL) {
+			DBG("Using cached SEPs");
+			g_slist_foreach(session->seps, sep_set_discovered,
+									NULL);
+			session->discover_cached = true;
+		}
+
 		/* Check that SEP have been discovered as it may be loaded from
 		 * cache.
 		 */
@@ -3451,6 +3520,9 @@ int avdtp_discover(struct avdtp *session, avdtp_discover_cb_t cb,
 		}
 	}
 
+	session->discover_cached = false;
+	session->discover_start = g_get_monotonic_time();
+
 	err = send_request(session, FALSE, NULL, AVDTP_DISCOVER, NULL, 0);
 	if (err == 0) {
 		session->discover->cb = cb;
@@ -233,6 +233,9 @@ bool avdtp_get_delay_reporting(struct avdtp_remote_sep *sep);
 
 int avdtp_discover(struct avdtp *session, avdtp_discover_cb_t cb,
 			void *user_data);
+bool avdtp_discover_cached(struct avdtp *session);
+void avdtp_invalidate_cache(struct avdtp *session);
+unsigned int avdtp_get_discover_time(struct avdtp *session);
 
 gboolean avdtp_has_stream(struct avdtp *session, struct avdtp_stream *stream);
 
@@ -2650,6 +2650,19 @@ static struct media_item *parse_media_folder(struct avrcp *session,
 
 static void avrcp_list_items(struct avrcp *session, uint32_t start,
 								uint32_t end);
+
+/* Items listed before the UID counter changed can no longer be trusted */
+static void ct_set_uid_counter(struct avrcp_player *player,
+							uint16_t uid_counter)
+{
+	if (player->uid_counter == uid_counter)
+		return;
+
+	player->uid_counter = uid_counter;
+
+	if (player->user_data != NULL)
+		media_player_clear_cache(player->user_data);
+}
 static gboolean avrcp_list_items_rsp(struct avctp *conn, uint8_t *operands,
 					size_t operand_count, void *user_data)
 {
@@ -2685,6 +2698,8 @@ static gboolean avrcp_list_items_rsp(struct avctp *conn, uint8_t *operands,
 		goto done;
 	}
 
+	ct_set_uid_counter(player, get_be16(&pdu->params[1]));
+
 	count = get_be16(&operands[6]);
 	if (count == 0)
 		goto done;
@@ -2730,11 +2745,13 @@ static gboolean avrcp_list_items_rsp(struct avctp *conn, uint8_t *operands,
 	}
 
 done:
+	/* Detach first so the completion can issue the next request */
+	player->p = NULL;
+
 	media_player_list_complete(player->user_data, p->items, err);
 
 	g_slist_free(p->items);
 	g_free(p);
-	player->p = NULL;
 
 	return FALSE;
 }
@@ -3296,7 +3313,7 @@ static gboolean avrcp_search_rsp(struct avctp *conn, uint8_t *operands,
 		goto done;
 	}
 
-	player->uid_counter = get_be16(&pdu->params[1]);
+	ct_set_uid_counter(player, get_be16(&pdu->params[1]));
 	ret = get_be32(&pdu->params[3]);
 
 done:
@@ -3490,7 +3507,7 @@ static gboolean avrcp_get_total_numberofitems_rsp(struct avctp *conn,
 	if (pdu->params[0] == AVRCP_STATUS_OUT_OF_BOUNDS)
 		goto done;
 
-	player->uid_counter = get_be16(&pdu->params[1]);
+	ct_set_uid_counter(player, get_be16(&pdu->params[1]));
 	num_of_items = get_be32(&pdu->params[3]);
 
 	if (!num_of_items)
@@ -3919,6 +3936,9 @@ static void avrcp_uids_changed(struct avrcp *session, struct avrcp_header *pdu)
 	struct avrcp_player *player = session->controller->player;
 
 	player->uid_counter = get_be16(&pdu->params[1]);
+
+	/* Database unaware players signal changes without a new counter */
+	media_player_clear_cache(player->user_data);
 }
 
 static gboolean avrcp_handle_event(struct avctp *conn, uint8_t code,
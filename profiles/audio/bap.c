@@ -1490,7 +1490,7 @@ static bool pac_select(struct bt_bap_pac *lpac, struct bt_bap_pac *rpac,
 		return true;
 	}
 
-	/* TODO: Cache LRU? */
+	/* Media endpoints cache the selection for the same remote PAC */
 	if (btd_service_is_initiator(service))
 		bt_bap_select(lpac, rpac, &ep->data->selecting, select_cb, ep);
 
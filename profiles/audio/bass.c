@@ -1107,6 +1107,71 @@ static struct bass_assistant *assistant_new(struct btd_adapter *adapter,
 	return assistant;
 }
 
+struct assistant_match {
+	struct btd_device *device;
+	struct bass_data *data;
+	uint8_t bis;
+};
+
+static bool match_assistant(const void *data, const void *match_data)
+{
+	const struct bass_assistant *assistant = data;
+	const struct assistant_match *match = match_data;
+
+	return assistant->device == match->device &&
+				assistant->data == match->data &&
+				assistant->bis == match->bis;
+}
+
+/* BIG Info of an already known source is reported again each time the PA
+ * is resynced, so refresh the existing object instead of recreating it.
+ */
+static void assistant_update(struct bass_assistant *assistant, uint8_t sgrp,
+		struct bt_bap_qos *qos, struct iovec *meta, struct iovec *caps)
+{
+	struct bt_bap_qos tmp;
+
+	assistant->sgrp = sgrp;
+
+	if (util_iov_memcmp(assistant->caps, caps)) {
+		util_iov_free(assistant->caps, 1);
+		assistant->caps = util_iov_dup(caps, 1);
+	}
+
+	if (util_iov_memcmp(assistant->meta, meta)) {
+		util_iov_free(assistant->meta, 1);
+		assistant->meta = util_iov_dup(meta, 1);
+
+		g_dbus_emit_property_changed(btd_get_dbus_connection(),
+						assistant->path,
+						MEDIA_ASSISTANT_INTERFACE,
+						"Metadata");
+	}
+
+	/* Keep the QoS and Broadcast Code in use once the assistant has been
+	 * pushed to the peer.
+	 */
+	if (assistant->state != ASSISTANT_STATE_IDLE)
+		return;
+
+	tmp = *qos;
+	tmp.bcast.bcode = assistant->qos.bcast.bcode;
+
+	if (!memcmp(&tmp, &assistant->qos, sizeof(tmp)) &&
+			!util_iov_memcmp(assistant->qos.bcast.bcode,
+						qos->bcast.bcode))
+		return;
+
+	util_iov_free(assistant->qos.bcast.bcode, 1);
+	assistant->qos = *qos;
+	assistant->qos.bcast.bcode = util_iov_dup(qos->bcast.bcode, 1);
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(),
+						assistant->path,
+						MEDIA_ASSISTANT_INTERFACE,
+						"QoS");
+}
+
 static void bis_probe(uint8_t bis, uint8_t sgrp, struct iovec *caps,
 	struct iovec *meta, struct bt_bap_qos *qos, void *user_data)
 {
@@ -1115,6 +1180,7 @@ static void bis_probe(uint8_t bis, uint8_t sgrp, struct iovec *caps,
 	struct bt_bap *bap;
 	struct bt_bap_pac *pac;
 	struct bass_assistant *assistant;
+	struct assistant_match match;
 	char addr[18];
 
 	for (entry = queue_get_entries(sessions); entry; entry = entry->next) {
@@ -1140,6 +1206,16 @@ static void bis_probe(uint8_t bis, uint8_t sgrp, struct iovec *caps,
 
 		DBG("%s data %p BIS %d", addr, data, bis);
 
+		match.device = device;
+		match.data = data;
+		match.bis = bis;
+
+		assistant = queue_find(assistants, match_assistant, &match);
+		if (assistant) {
+			assistant_update(assistant, sgrp, qos, meta, caps);
+			continue;
+		}
+
 		assistant = assistant_new(adapter, device, data, sgrp,
 							bis, qos, meta, caps);
 
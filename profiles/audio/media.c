@@ -38,6 +38,7 @@
 #include "src/log.h"
 #include "src/error.h"
 #include "src/gatt-database.h"
+#include "src/btd.h"
 #include "src/shared/asha.h"
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
@@ -60,6 +61,9 @@
 
 #define REQUEST_TIMEOUT (3 * 1000)		/* 3 seconds */
 
+#define PAC_SELECT_CACHE_MAX 16
+#define A2DP_SELECT_CACHE_MAX 8
+
 struct media_app {
 	struct media_adapter	*adapter;
 	GDBusClient		*client;
@@ -104,6 +108,7 @@ struct media_endpoint {
 	uint16_t                cid;            /* Endpoint company ID */
 	uint16_t                vid;            /* Endpoint vendor codec ID */
 	bool			delay_reporting;/* Endpoint delay_reporting */
+	bool			dynamic_select;	/* Endpoint dynamic selection */
 	struct bt_bap_pac_qos	qos;		/* Endpoint qos */
 	uint8_t			*capabilities;	/* Endpoint property capabilities */
 	size_t			size;		/* Endpoint capabilities size */
@@ -113,6 +118,10 @@ struct media_endpoint {
 	guint			ag_watch;
 	guint			watch;
 	GSList			*requests;
+	struct queue		*selections;	/* Selection cache */
+	struct queue		*cached_selects;
+	struct queue		*configs;	/* A2DP selection cache */
+	struct queue		*cached_configs;
 	struct media_adapter	*adapter;
 	GSList			*transports;
 };
@@ -132,6 +141,8 @@ struct media_player {
 	uint32_t		duration;
 	int8_t			volume;
 	GTimer			*timer;
+	guint			seek_id;
+	const char		*seek_status;
 	bool			play;
 	bool			pause;
 	bool			next;
@@ -180,11 +191,24 @@ static void media_endpoint_cancel_all(struct media_endpoint *endpoint)
 		media_endpoint_cancel(endpoint->requests->data);
 }
 
+static void pac_cancel_cached(struct media_endpoint *endpoint,
+					struct bt_bap_pac *lpac,
+					bt_bap_pac_select_t cb, void *cb_data);
+static void pac_selection_free(void *data);
+static void a2dp_cancel_cached(struct media_endpoint *endpoint);
+static void a2dp_selection_free(void *data);
+
 static void media_endpoint_destroy(struct media_endpoint *endpoint)
 {
 	DBG("sender=%s path=%s", endpoint->sender, endpoint->path);
 
 	media_endpoint_cancel_all(endpoint);
+	pac_cancel_cached(endpoint, NULL, NULL, NULL);
+	queue_destroy(endpoint->cached_selects, NULL);
+	queue_destroy(endpoint->selections, pac_selection_free);
+	a2dp_cancel_cached(endpoint);
+	queue_destroy(endpoint->cached_configs, NULL);
+	queue_destroy(endpoint->configs, a2dp_selection_free);
 
 	g_slist_free_full(endpoint->transports,
 				(GDestroyNotify) media_transport_destroy);
@@ -618,35 +642,145 @@ static size_t get_capabilities(struct a2dp_sep *sep, uint8_t **capabilities,
 	return endpoint->size;
 }
 
+/* SelectConfiguration reply for the given remote SEP capabilities */
+struct a2dp_selection {
+	struct iovec *caps;
+	struct iovec *config;
+};
+
 struct a2dp_select_data {
+	struct media_endpoint *endpoint;
 	struct a2dp_setup *setup;
+	struct a2dp_selection *sel;
+	guint id;
 	a2dp_endpoint_select_t cb;
 };
 
+static void a2dp_selection_free(void *data)
+{
+	struct a2dp_selection *sel = data;
+
+	if (!sel)
+		return;
+
+	util_iov_free(sel->caps, 1);
+	util_iov_free(sel->config, 1);
+	free(sel);
+}
+
+static void a2dp_select_data_free(void *user_data)
+{
+	struct a2dp_select_data *data = user_data;
+
+	a2dp_selection_free(data->sel);
+	g_free(data);
+}
+
+static bool match_a2dp_selection(const void *data, const void *match_data)
+{
+	const struct a2dp_selection *sel = data;
+
+	return !util_iov_memcmp(sel->caps, match_data);
+}
+
 static void select_cb(struct media_endpoint *endpoint, void *ret, int size,
 							void *user_data)
 {
 	struct a2dp_select_data *data = user_data;
 
+	if (data->sel && ret && size >= 0) {
+		data->sel->config = new0(struct iovec, 1);
+		util_iov_memcpy(data->sel->config, ret, size);
+
+		queue_push_tail(endpoint->configs, data->sel);
+		data->sel = NULL;
+
+		if (queue_length(endpoint->configs) > A2DP_SELECT_CACHE_MAX)
+			a2dp_selection_free(queue_pop_head(endpoint->configs));
+	}
+
 	data->cb(data->setup, ret, size);
 }
 
+static gboolean select_cached(void *user_data)
+{
+	struct a2dp_select_data *data = user_data;
+	struct iovec *config = data->sel->config;
+
+	data->id = 0;
+	queue_remove(data->endpoint->cached_configs, data);
+
+	DBG("Using cached configuration for %s", data->endpoint->path);
+
+	data->cb(data->setup, config->iov_base, config->iov_len);
+
+	a2dp_select_data_free(data);
+
+	return FALSE;
+}
+
+static bool select_from_cache(struct media_endpoint *endpoint,
+					const struct iovec *caps,
+					struct a2dp_select_data *data)
+{
+	struct a2dp_selection *sel;
+
+	sel = queue_remove_if(endpoint->configs, match_a2dp_selection,
+							(void *) caps);
+	if (!sel)
+		return false;
+
+	queue_push_tail(endpoint->configs, sel);
+
+	data->sel = new0(struct a2dp_selection, 1);
+	data->sel->config = util_iov_dup(sel->config, 1);
+
+	data->id = g_idle_add(select_cached, data);
+	queue_push_tail(endpoint->cached_configs, data);
+
+	return true;
+}
+
+static void a2dp_cancel_cached(struct media_endpoint *endpoint)
+{
+	struct a2dp_select_data *data;
+
+	while ((data = queue_pop_head(endpoint->cached_configs))) {
+		g_source_remove(data->id);
+		data->cb(data->setup, NULL, -1);
+		a2dp_select_data_free(data);
+	}
+}
+
 static int select_config(struct a2dp_sep *sep, uint8_t *capabilities,
 				size_t length, struct a2dp_setup *setup,
 				a2dp_endpoint_select_t cb, void *user_data)
 {
 	struct media_endpoint *endpoint = user_data;
 	struct a2dp_select_data *data;
+	struct iovec caps = {
+		.iov_base = capabilities,
+		.iov_len = length,
+	};
 
 	data = g_new0(struct a2dp_select_data, 1);
+	data->endpoint = endpoint;
 	data->setup = setup;
 	data->cb = cb;
 
+	if (!endpoint->dynamic_select) {
+		if (select_from_cache(endpoint, &caps, data))
+			return 0;
+
+		data->sel = new0(struct a2dp_selection, 1);
+		data->sel->caps = util_iov_dup(&caps, 1);
+	}
+
 	if (select_configuration(endpoint, capabilities, length,
-					select_cb, data, g_free) == TRUE)
+				select_cb, data, a2dp_select_data_free) == TRUE)
 		return 0;
 
-	g_free(data);
+	a2dp_select_data_free(data);
 	return -ENOMEM;
 }
 
@@ -741,12 +875,163 @@ static bool endpoint_init_a2dp_sink(struct media_endpoint *endpoint, int *err)
 	return true;
 }
 
+/* SelectProperties reply for a remote PAC, the remote endpoint path
+ * identifies the device and PAC while the rest of the arguments are
+ * compared so a change on either side results in a new call.
+ */
+struct pac_selection {
+	char *path;
+	uint32_t location;
+	struct bt_bap_pac_qos pqos;
+	struct iovec *rcaps;
+	struct iovec *rmeta;
+	struct iovec *caps;
+	struct iovec *meta;
+	struct bt_bap_qos qos;
+};
+
 struct pac_select_data {
+	struct media_endpoint *endpoint;
 	struct bt_bap_pac *pac;
+	struct pac_selection *sel;
+	guint id;
 	bt_bap_pac_select_t cb;
 	void *user_data;
 };
 
+static void pac_selection_free(void *data)
+{
+	struct pac_selection *sel = data;
+
+	if (!sel)
+		return;
+
+	free(sel->path);
+	util_iov_free(sel->rcaps, 1);
+	util_iov_free(sel->rmeta, 1);
+	util_iov_free(sel->caps, 1);
+	util_iov_free(sel->meta, 1);
+	free(sel);
+}
+
+static void pac_select_data_free(void *user_data)
+{
+	struct pac_select_data *data = user_data;
+
+	pac_selection_free(data->sel);
+	free(data);
+}
+
+static bool iov_equal(const struct iovec *iov1, const struct iovec *iov2)
+{
+	if (!iov1 || !iov2)
+		return iov1 == iov2;
+
+	return !util_iov_memcmp(iov1, iov2);
+}
+
+struct pac_selection_match {
+	const char *path;
+	uint32_t location;
+	struct bt_bap_pac_qos pqos;
+	const struct iovec *caps;
+	const struct iovec *meta;
+};
+
+static bool match_pac_selection(const void *data, const void *match_data)
+{
+	const struct pac_selection *sel = data;
+	const struct pac_selection_match *match = match_data;
+
+	return !strcmp(sel->path, match->path) &&
+			sel->location == match->location &&
+			!memcmp(&sel->pqos, &match->pqos, sizeof(sel->pqos)) &&
+			iov_equal(sel->rcaps, match->caps) &&
+			iov_equal(sel->rmeta, match->meta);
+}
+
+static void pac_selection_store(struct media_endpoint *endpoint,
+					struct pac_selection *sel,
+					struct iovec *caps, struct iovec *meta,
+					struct bt_bap_qos *qos)
+{
+	sel->caps = util_iov_dup(caps, 1);
+	sel->meta = util_iov_dup(meta, 1);
+	sel->qos = *qos;
+
+	queue_push_tail(endpoint->selections, sel);
+
+	if (queue_length(endpoint->selections) > PAC_SELECT_CACHE_MAX)
+		pac_selection_free(queue_pop_head(endpoint->selections));
+}
+
+static gboolean pac_select_cached(void *user_data)
+{
+	struct pac_select_data *data = user_data;
+	struct pac_selection *sel = data->sel;
+
+	data->id = 0;
+	queue_remove(data->endpoint->cached_selects, data);
+
+	DBG("Using cached properties for %s", sel->path);
+
+	data->cb(data->pac, 0, sel->caps, sel->meta, &sel->qos,
+							data->user_data);
+
+	pac_select_data_free(data);
+
+	return FALSE;
+}
+
+static bool pac_select_from_cache(struct media_endpoint *endpoint,
+					const struct pac_selection_match *match,
+					struct pac_select_data *data)
+{
+	struct pac_selection *sel;
+
+	sel = queue_remove_if(endpoint->selections, match_pac_selection,
+							(void *) match);
+	if (!sel)
+		return false;
+
+	/* Keep the most recently used selections at the tail */
+	queue_push_tail(endpoint->selections, sel);
+
+	data->sel = new0(struct pac_selection, 1);
+	data->sel->path = strdup(sel->path);
+	data->sel->caps = util_iov_dup(sel->caps, 1);
+	data->sel->meta = util_iov_dup(sel->meta, 1);
+	data->sel->qos = sel->qos;
+
+	data->id = g_idle_add(pac_select_cached, data);
+	queue_push_tail(endpoint->cached_selects, data);
+
+	return true;
+}
+
+static void pac_cancel_cached(struct media_endpoint *endpoint,
+					struct bt_bap_pac *lpac,
+					bt_bap_pac_select_t cb, void *cb_data)
+{
+	const struct queue_entry *entry;
+
+	for (entry = queue_get_entries(endpoint->cached_selects); entry;) {
+		struct pac_select_data *data = entry->data;
+
+		entry = entry->next;
+
+		if (lpac && (data->pac != lpac || data->cb != cb ||
+						data->user_data != cb_data))
+			continue;
+
+		queue_remove(endpoint->cached_selects, data);
+		g_source_remove(data->id);
+
+		data->cb(data->pac, -EPERM, NULL, NULL, NULL, data->user_data);
+		pac_select_data_free(data);
+	}
+}
+
 static int parse_array(DBusMessageIter *iter, struct iovec *iov)
 {
 	DBusMessageIter array;
@@ -931,6 +1216,10 @@ static void pac_select_cb(struct media_endpoint *endpoint, void *ret, int size,
 	err = parse_select_properties(iter, &caps, &meta, &qos);
 	if (err < 0)
 		DBG("Unable to parse properties");
+	else if (data->sel) {
+		pac_selection_store(endpoint, data->sel, &caps, &meta, &qos);
+		data->sel = NULL;
+	}
 
 done:
 	data->cb(data->pac, err, &caps, &meta, &qos, data->user_data);
@@ -945,6 +1234,7 @@ static int pac_select(struct bt_bap_pac *lpac, struct bt_bap_pac *rpac,
 	struct iovec *metadata;
 	const char *endpoint_path;
 	struct pac_select_data *data;
+	struct pac_selection_match match;
 	DBusMessage *msg;
 	DBusMessageIter iter, dict;
 	const char *key = "Capabilities";
@@ -954,24 +1244,46 @@ static int pac_select(struct bt_bap_pac *lpac, struct bt_bap_pac *rpac,
 	if (!caps)
 		return -EINVAL;
 
+	data = new0(struct pac_select_data, 1);
+	data->endpoint = endpoint;
+	data->pac = lpac;
+	data->cb = cb;
+	data->user_data = cb_data;
+
+	endpoint_path = bt_bap_pac_get_user_data(rpac);
+	if (endpoint_path && !endpoint->dynamic_select) {
+		memset(&match, 0, sizeof(match));
+		match.path = endpoint_path;
+		match.location = location;
+		if (qos)
+			match.pqos = *qos;
+		match.caps = caps;
+		match.meta = metadata;
+
+		if (pac_select_from_cache(endpoint, &match, data))
+			return 0;
+
+		data->sel = new0(struct pac_selection, 1);
+		data->sel->path = strdup(endpoint_path);
+		data->sel->location = location;
+		data->sel->pqos = match.pqos;
+		data->sel->rcaps = util_iov_dup(caps, 1);
+		data->sel->rmeta = util_iov_dup(metadata, 1);
+	}
+
 	msg = dbus_message_new_method_call(endpoint->sender, endpoint->path,
 						MEDIA_ENDPOINT_INTERFACE,
 						"SelectProperties");
 	if (msg == NULL) {
 		error("Couldn't allocate D-Bus message");
+		pac_select_data_free(data);
 		return -ENOMEM;
 	}
 
-	data = new0(struct pac_select_data, 1);
-	data->pac = lpac;
-	data->cb = cb;
-	data->user_data = cb_data;
-
 	dbus_message_iter_init_append(msg, &iter);
 
 	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
 
-	endpoint_path = bt_bap_pac_get_user_data(rpac);
 	if (endpoint_path)
 		g_dbus_dict_append_entry(&dict, "Endpoint",
 					DBUS_TYPE_OBJECT_PATH, &endpoint_path);
@@ -1041,7 +1353,7 @@ static int pac_select(struct bt_bap_pac *lpac, struct bt_bap_pac *rpac,
 	dbus_message_iter_close_container(&iter, &dict);
 
 	return media_endpoint_async_call(msg, endpoint, NULL, pac_select_cb,
-								data, free);
+						data, pac_select_data_free);
 }
 
 static void pac_cancel_select(struct bt_bap_pac *lpac, bt_bap_pac_select_t cb,
@@ -1050,6 +1362,8 @@ static void pac_cancel_select(struct bt_bap_pac *lpac, bt_bap_pac_select_t cb,
 	struct media_endpoint *endpoint = user_data;
 	GSList *l = endpoint->requests;
 
+	pac_cancel_cached(endpoint, lpac, cb, cb_data);
+
 	while (l) {
 		struct endpoint_request *req = l->data;
 		struct pac_select_data *data;
@@ -1504,6 +1818,7 @@ media_endpoint_create(struct media_adapter *adapter,
 						const char *path,
 						const char *uuid,
 						gboolean delay_reporting,
+						gboolean dynamic_select,
 						uint8_t codec,
 						uint16_t cid,
 						uint16_t vid,
@@ -1520,6 +1835,10 @@ media_endpoint_create(struct media_adapter *adapter,
 	bool succeeded = false;
 
 	endpoint = g_new0(struct media_endpoint, 1);
+	endpoint->selections = queue_new();
+	endpoint->cached_selects = queue_new();
+	endpoint->configs = queue_new();
+	endpoint->cached_configs = queue_new();
 	endpoint->sender = g_strdup(sender);
 	endpoint->path = g_strdup(path);
 	endpoint->uuid = g_strdup(uuid);
@@ -1527,6 +1846,7 @@ media_endpoint_create(struct media_adapter *adapter,
 	endpoint->cid = cid;
 	endpoint->vid = vid;
 	endpoint->delay_reporting = delay_reporting;
+	endpoint->dynamic_select = dynamic_select;
 
 	if (qos)
 		endpoint->qos = *qos;
@@ -1588,7 +1908,8 @@ struct vendor {
 } __packed;
 
 static int parse_properties(DBusMessageIter *props, const char **uuid,
-				gboolean *delay_reporting, uint8_t *codec,
+				gboolean *delay_reporting,
+				gboolean *dynamic_select, uint8_t *codec,
 				uint16_t *cid, uint16_t *vid,
 				struct bt_bap_pac_qos *qos,
 				uint8_t **capabilities, int *size,
@@ -1630,6 +1951,10 @@ static int parse_properties(DBusMessageIter *props, const char **uuid,
 			if (var != DBUS_TYPE_BOOLEAN)
 				return -EINVAL;
 			dbus_message_iter_get_basic(&value, delay_reporting);
+		} else if (strcasecmp(key, "DynamicSelection") == 0) {
+			if (var != DBUS_TYPE_BOOLEAN)
+				return -EINVAL;
+			dbus_message_iter_get_basic(&value, dynamic_select);
 		} else if (strcasecmp(key, "Capabilities") == 0) {
 			DBusMessageIter array;
 
@@ -1704,6 +2029,7 @@ static DBusMessage *register_endpoint(DBusConnection *conn, DBusMessage *msg,
 	DBusMessageIter args, props;
 	const char *sender, *path, *uuid;
 	gboolean delay_reporting = FALSE;
+	gboolean dynamic_select = FALSE;
 	uint8_t codec = 0;
 	uint16_t cid = 0;
 	uint16_t vid = 0;
@@ -1728,15 +2054,15 @@ static DBusMessage *register_endpoint(DBusConnection *conn, DBusMessage *msg,
 	if (dbus_message_iter_get_arg_type(&props) != DBUS_TYPE_DICT_ENTRY)
 		return btd_error_invalid_args(msg);
 
-	if (parse_properties(&props, &uuid, &delay_reporting, &codec, &cid,
-			&vid, &qos, &capabilities, &size, &metadata,
-			&metadata_size) < 0)
+	if (parse_properties(&props, &uuid, &delay_reporting, &dynamic_select,
+			&codec, &cid, &vid, &qos, &capabilities, &size,
+			&metadata, &metadata_size) < 0)
 		return btd_error_invalid_args(msg);
 
 	if (media_endpoint_create(adapter, sender, path, uuid, delay_reporting,
-					codec, cid, vid, &qos, capabilities,
-					size, metadata, metadata_size,
-					&err) == NULL) {
+					dynamic_select, codec, cid, vid, &qos,
+					capabilities, size, metadata,
+					metadata_size, &err) == NULL) {
 		if (err == -EPROTONOSUPPORT)
 			return btd_error_not_supported(msg);
 		else
@@ -1824,6 +2150,9 @@ static void media_player_free(gpointer data)
 	g_dbus_remove_watch(conn, mp->properties_watch);
 	g_dbus_remove_watch(conn, mp->seek_watch);
 
+	if (mp->seek_id)
+		g_source_remove(mp->seek_id);
+
 	if (mp->track)
 		g_hash_table_unref(mp->track);
 
@@ -2174,6 +2503,9 @@ static gboolean set_status(struct media_player *mp, DBusMessageIter *iter)
 	mp->position = media_player_get_position(mp);
 	g_timer_start(mp->timer);
 
+	/* The status change resyncs the position as well */
+	mp->seek_status = NULL;
+
 	g_free(mp->status);
 	mp->status = g_strdup(value);
 
@@ -2182,9 +2514,45 @@ static gboolean set_status(struct media_player *mp, DBusMessageIter *iter)
 	return TRUE;
 }
 
+static gboolean seek_timeout(gpointer user_data)
+{
+	struct media_player *mp = user_data;
+	const char *status = mp->seek_status;
+
+	mp->seek_id = 0;
+
+	if (status == NULL)
+		return FALSE;
+
+	mp->seek_status = NULL;
+
+	avrcp_player_event(mp->player, AVRCP_EVENT_STATUS_CHANGED, status);
+
+	mp->seek_id = g_timeout_add(btd_opts.avrcp.position_interval,
+							seek_timeout, mp);
+
+	return FALSE;
+}
+
+static void player_seek(struct media_player *mp, const char *status)
+{
+	/* Coalesce seeks until the previous resync interval has passed */
+	if (mp->seek_id) {
+		mp->seek_status = status;
+		return;
+	}
+
+	avrcp_player_event(mp->player, AVRCP_EVENT_STATUS_CHANGED, status);
+
+	if (btd_opts.avrcp.position_interval)
+		mp->seek_id = g_timeout_add(btd_opts.avrcp.position_interval,
+							seek_timeout, mp);
+}
+
 static gboolean set_position(struct media_player *mp, DBusMessageIter *iter)
 {
 	uint64_t value;
+	uint32_t current, delta;
 	const char *status;
 
 	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_INT64)
@@ -2194,10 +2562,14 @@ static gboolean set_position(struct media_player *mp, DBusMessageIter *iter)
 
 	value /= 1000;
 
-	if (value > media_player_get_position(mp))
+	current = media_player_get_position(mp);
+	if (value > current) {
 		status = "forward-seek";
-	else
+		delta = value - current;
+	} else {
 		status = "reverse-seek";
+		delta = current - value;
+	}
 
 	mp->position = value;
 	g_timer_start(mp->timer);
@@ -2220,8 +2592,15 @@ static gboolean set_position(struct media_player *mp, DBusMessageIter *iter)
 		return TRUE;
 	}
 
+	/*
+	 * Players updating the position periodically while playing only
+	 * confirm what is already interpolated locally, so skip the resync.
+	 */
+	if (delta < btd_opts.avrcp.position_interval)
+		return TRUE;
+
 	/* Send a status change to force resync the position */
-	avrcp_player_event(mp->player, AVRCP_EVENT_STATUS_CHANGED, status);
+	player_seek(mp, status);
 
 	return TRUE;
 }
@@ -2321,12 +2700,31 @@ static gboolean parse_int32_metadata(struct media_player *mp, const char *key,
 	return TRUE;
 }
 
+static gboolean track_equal(GHashTable *a, GHashTable *b)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (g_hash_table_size(a) != g_hash_table_size(b))
+		return FALSE;
+
+	g_hash_table_iter_init(&iter, a);
+
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		if (g_strcmp0(value, g_hash_table_lookup(b, key)) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 static gboolean parse_player_metadata(struct media_player *mp,
 							DBusMessageIter *iter)
 {
 	DBusMessageIter dict;
 	DBusMessageIter var;
 	int ctype;
+	GHashTable *track = mp->track;
 	gboolean title = FALSE;
 	uint64_t uid;
 
@@ -2336,9 +2734,6 @@ static gboolean parse_player_metadata(struct media_player *mp,
 
 	dbus_message_iter_recurse(iter, &dict);
 
-	if (mp->track != NULL)
-		g_hash_table_unref(mp->track);
-
 	mp->track = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
 								g_free);
 
@@ -2348,39 +2743,39 @@ static gboolean parse_player_metadata(struct media_player *mp,
 		const char *key;
 
 		if (ctype != DBUS_TYPE_DICT_ENTRY)
-			return FALSE;
+			goto fail;
 
 		dbus_message_iter_recurse(&dict, &entry);
 		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING)
-			return FALSE;
+			goto fail;
 
 		dbus_message_iter_get_basic(&entry, &key);
 		dbus_message_iter_next(&entry);
 
 		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_VARIANT)
-			return FALSE;
+			goto fail;
 
 		dbus_message_iter_recurse(&entry, &var);
 
 		if (strcasecmp(key, "xesam:title") == 0) {
 			if (!parse_string_metadata(mp, "Title", &var))
-				return FALSE;
+				goto fail;
 			title = TRUE;
 		} else if (strcasecmp(key, "xesam:artist") == 0) {
 			if (!parse_array_metadata(mp, "Artist", &var))
-				return FALSE;
+				goto fail;
 		} else if (strcasecmp(key, "xesam:album") == 0) {
 			if (!parse_string_metadata(mp, "Album", &var))
-				return FALSE;
+				goto fail;
 		} else if (strcasecmp(key, "xesam:genre") == 0) {
 			if (!parse_array_metadata(mp, "Genre", &var))
-				return FALSE;
+				goto fail;
 		} else if (strcasecmp(key, "mpris:length") == 0) {
 			if (!parse_int64_metadata(mp, "Duration", &var))
-				return FALSE;
+				goto fail;
 		} else if (strcasecmp(key, "xesam:trackNumber") == 0) {
 			if (!parse_int32_metadata(mp, "TrackNumber", &var))
-				return FALSE;
+				goto fail;
 		} else
 			DBG("%s not supported, ignoring", key);
 
@@ -2391,6 +2786,16 @@ static gboolean parse_player_metadata(struct media_player *mp,
 		g_hash_table_insert(mp->track, g_strdup("Title"),
 								g_strdup(""));
 
+	/* Players may resend unchanged metadata along with other updates */
+	if (track != NULL && track_equal(track, mp->track)) {
+		g_hash_table_unref(mp->track);
+		mp->track = track;
+		return TRUE;
+	}
+
+	if (track != NULL)
+		g_hash_table_unref(track);
+
 	mp->position = 0;
 	g_timer_start(mp->timer);
 	uid = media_player_get_uid(mp);
@@ -2399,6 +2804,12 @@ static gboolean parse_player_metadata(struct media_player *mp,
 	avrcp_player_event(mp->player, AVRCP_EVENT_TRACK_REACHED_START, NULL);
 
 	return TRUE;
+
+fail:
+	if (track != NULL)
+		g_hash_table_unref(track);
+
+	return FALSE;
 }
 
 static gboolean set_property(struct media_player *mp, const char *key,
@@ -2773,6 +3184,7 @@ static void app_register_endpoint(void *data, void *user_data)
 	const char *path = g_dbus_proxy_get_path(proxy);
 	const char *uuid;
 	gboolean delay_reporting = FALSE;
+	gboolean dynamic_select = FALSE;
 	uint8_t codec;
 	struct vendor vendor;
 	struct bt_bap_pac_qos qos;
@@ -2823,6 +3235,13 @@ static void app_register_endpoint(void *data, void *user_data)
 		dbus_message_iter_get_basic(&iter, &delay_reporting);
 	}
 
+	if (g_dbus_proxy_get_property(proxy, "DynamicSelection", &iter)) {
+		if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_BOOLEAN)
+			goto fail;
+
+		dbus_message_iter_get_basic(&iter, &dynamic_select);
+	}
+
 	if (g_dbus_proxy_get_property(proxy, "Capabilities", &iter)) {
 		if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
 			goto fail;
@@ -2913,8 +3332,9 @@ static void app_register_endpoint(void *data, void *user_data)
 	}
 
 	endpoint = media_endpoint_create(app->adapter, app->sender, path, uuid,
-						delay_reporting, codec,
-						vendor.cid, vendor.vid, &qos,
+						delay_reporting, dynamic_select,
+						codec, vendor.cid, vendor.vid,
+						&qos,
 						capabilities, size,
 						metadata, metadata_size,
 						&app->err);
@@ -30,6 +30,7 @@
 #include "src/log.h"
 #include "src/dbus-common.h"
 #include "src/error.h"
+#include "src/btd.h"
 
 #include "player.h"
 
@@ -65,6 +66,11 @@ struct media_folder {
 	uint32_t		number_of_items;/* Number of items */
 	GSList			*subfolders;
 	GSList			*items;
+	GPtrArray		*cache;		/* Items by index */
+	uint32_t		list_start;	/* Range being listed */
+	uint32_t		msg_start;	/* Range requested by msg */
+	uint32_t		msg_end;
+	bool			prefetch;
 	DBusMessage		*msg;
 };
 
@@ -658,22 +664,12 @@ static void parse_folder_list(gpointer data, gpointer user_data)
 	dbus_message_iter_close_container(array, &entry);
 }
 
-void media_player_list_complete(struct media_player *mp, GSList *items,
-								int err)
+static DBusMessage *list_items_reply(DBusMessage *msg, GSList *items)
 {
-	struct media_folder *folder = mp->scope;
 	DBusMessage *reply;
 	DBusMessageIter iter, array;
 
-	if (folder == NULL || folder->msg == NULL)
-		return;
-
-	if (err < 0) {
-		reply = btd_error_failed(folder->msg, strerror(-err));
-		goto done;
-	}
-
-	reply = dbus_message_new_method_return(folder->msg);
+	reply = dbus_message_new_method_return(msg);
 
 	dbus_message_iter_init_append(reply, &iter);
 
@@ -691,12 +687,195 @@ void media_player_list_complete(struct media_player *mp, GSList *items,
 	g_slist_foreach(items, parse_folder_list, &array);
 	dbus_message_iter_close_container(&iter, &array);
 
+	return reply;
+}
+
+static void folder_cache_clear(struct media_folder *folder)
+{
+	if (folder->cache == NULL)
+		return;
+
+	g_ptr_array_free(folder->cache, TRUE);
+	folder->cache = NULL;
+}
+
+static void folder_cache_store(struct media_folder *folder, uint32_t start,
+								GSList *items)
+{
+	GSList *l;
+	uint32_t i;
+
+	if (folder->cache == NULL)
+		folder->cache = g_ptr_array_new();
+
+	for (l = items, i = start; l; l = l->next, i++) {
+		if (i >= folder->cache->len)
+			g_ptr_array_set_size(folder->cache, i + 1);
+
+		folder->cache->pdata[i] = l->data;
+	}
+}
+
+static uint32_t folder_last_index(struct media_folder *folder, uint32_t end)
+{
+	if (folder->number_of_items > 0 && end >= folder->number_of_items)
+		return folder->number_of_items - 1;
+
+	return end;
+}
+
+static bool folder_cache_lookup(struct media_folder *folder, uint32_t start,
+					uint32_t end, GSList **items)
+{
+	GSList *list = NULL;
+	uint32_t i;
+
+	/* Without a known folder size the end of the listing is unknown */
+	if (folder->cache == NULL || folder->number_of_items == 0)
+		return false;
+
+	end = folder_last_index(folder, end);
+	if (start > end || end >= folder->cache->len)
+		return false;
+
+	for (i = start; i <= end; i++) {
+		if (folder->cache->pdata[i] == NULL)
+			return false;
+	}
+
+	if (items == NULL)
+		return true;
+
+	for (i = end + 1; i > start; i--)
+		list = g_slist_prepend(list, folder->cache->pdata[i - 1]);
+
+	*items = list;
+
+	return true;
+}
+
+static int folder_list_items(struct media_player *mp,
+					struct media_folder *folder,
+					uint32_t start, uint32_t end)
+{
+	struct player_callback *cb = mp->cb;
+	int err;
+
+	err = cb->cbs->list_items(mp, folder->item->name, start, end,
+							cb->user_data);
+	if (err < 0)
+		return err;
+
+	folder->list_start = start;
+
+	return 0;
+}
+
+/* Fetch the page following start-end so scrolling forward is served from
+ * the cache.
+ */
+static void folder_prefetch(struct media_player *mp,
+					struct media_folder *folder,
+					uint32_t start, uint32_t end)
+{
+	uint32_t next_start, next_end;
+
+	if (folder->number_of_items == 0 || folder->prefetch)
+		return;
+
+	end = folder_last_index(folder, end);
+	if (start > end || end + 1 >= folder->number_of_items)
+		return;
+
+	next_start = end + 1;
+	next_end = folder_last_index(folder, next_start + (end - start));
+
+	if (folder_cache_lookup(folder, next_start, next_end, NULL))
+		return;
+
+	DBG("start %u end %u", next_start, next_end);
+
+	if (folder_list_items(mp, folder, next_start, next_end) == 0)
+		folder->prefetch = true;
+}
+
+static void folder_list_reply(struct media_player *mp,
+					struct media_folder *folder, int err)
+{
+	DBusMessage *reply;
+	GSList *items;
+
+	if (err < 0) {
+		reply = btd_error_failed(folder->msg, strerror(-err));
+		goto done;
+	}
+
+	if (folder_cache_lookup(folder, folder->msg_start, folder->msg_end,
+								&items)) {
+		reply = list_items_reply(folder->msg, items);
+		g_slist_free(items);
+		goto done;
+	}
+
+	err = folder_list_items(mp, folder, folder->msg_start,
+							folder->msg_end);
+	if (err == 0)
+		return;
+
+	reply = btd_error_failed(folder->msg, strerror(-err));
+
 done:
 	g_dbus_send_message(btd_get_dbus_connection(), reply);
 	dbus_message_unref(folder->msg);
 	folder->msg = NULL;
 }
 
+void media_player_list_complete(struct media_player *mp, GSList *items,
+								int err)
+{
+	struct media_folder *folder = mp->scope;
+	DBusMessage *reply;
+
+	if (folder == NULL || (folder->msg == NULL && !folder->prefetch))
+		return;
+
+	if (err == 0)
+		folder_cache_store(folder, folder->list_start, items);
+
+	if (folder->prefetch) {
+		folder->prefetch = false;
+
+		/* A request arrived while prefetching, serve it now */
+		if (folder->msg != NULL)
+			folder_list_reply(mp, folder, 0);
+
+		return;
+	}
+
+	if (err < 0)
+		reply = btd_error_failed(folder->msg, strerror(-err));
+	else
+		reply = list_items_reply(folder->msg, items);
+
+	g_dbus_send_message(btd_get_dbus_connection(), reply);
+	dbus_message_unref(folder->msg);
+	folder->msg = NULL;
+
+	if (err == 0)
+		folder_prefetch(mp, folder, folder->msg_start, folder->msg_end);
+}
+
+void media_player_clear_cache(struct media_player *mp)
+{
+	DBG("");
+
+	if (mp->scope != NULL)
+		folder_cache_clear(mp->scope);
+
+	if (mp->playlist != NULL)
+		folder_cache_clear(mp->playlist);
+}
+
 static struct media_item *
 media_player_create_subfolder(struct media_player *mp, const char *name,
 								uint64_t uid)
@@ -759,6 +938,7 @@ void media_player_total_items_complete(struct media_player *mp,
 
 	if (folder->number_of_items != num_of_items) {
 		folder->number_of_items = num_of_items;
+		folder_cache_clear(folder);
 
 		g_dbus_emit_property_changed(btd_get_dbus_connection(),
 				mp->path, MEDIA_FOLDER_INTERFACE,
@@ -899,6 +1079,8 @@ static DBusMessage *media_folder_list_items(DBusConnection *conn,
 	struct media_folder *folder = mp->scope;
 	struct player_callback *cb = mp->cb;
 	DBusMessageIter iter;
+	DBusMessage *reply;
+	GSList *items;
 	uint32_t start, end;
 	int err;
 
@@ -913,12 +1095,23 @@ static DBusMessage *media_folder_list_items(DBusConnection *conn,
 	if (folder->msg != NULL)
 		return btd_error_failed(msg, strerror(EBUSY));
 
-	err = cb->cbs->list_items(mp, folder->item->name, start, end,
-							cb->user_data);
-	if (err < 0)
-		return btd_error_failed(msg, strerror(-err));
+	if (folder_cache_lookup(folder, start, end, &items)) {
+		reply = list_items_reply(msg, items);
+		g_slist_free(items);
+		folder_prefetch(mp, folder, start, end);
+		return reply;
+	}
+
+	/* Wait for the prefetch to complete, it may cover this range */
+	if (!folder->prefetch) {
+		err = folder_list_items(mp, folder, start, end);
+		if (err < 0)
+			return btd_error_failed(msg, strerror(-err));
+	}
 
 	folder->msg = dbus_message_ref(msg);
+	folder->msg_start = start;
+	folder->msg_end = end;
 
 	return NULL;
 }
@@ -949,6 +1142,7 @@ static void media_folder_destroy(void *data)
 {
 	struct media_folder *folder = data;
 
+	folder_cache_clear(folder);
 	g_slist_free_full(folder->subfolders, media_folder_destroy);
 	g_slist_free_full(folder->items, media_item_destroy);
 
@@ -970,6 +1164,9 @@ static void media_player_change_scope(struct media_player *mp,
 
 	DBG("%s", folder->item->name);
 
+	/* Drop any prefetch in progress, its results belong to the old scope */
+	mp->scope->prefetch = false;
+
 	/* Skip setting current folder if folder is current playlist/search */
 	if (folder == mp->playlist || folder == mp->search)
 		goto cleanup;
@@ -981,6 +1178,7 @@ static void media_player_change_scope(struct media_player *mp,
 		goto done;
 
 cleanup:
+	folder_cache_clear(mp->scope);
 	g_slist_free_full(mp->scope->items, media_item_destroy);
 	mp->scope->items = NULL;
 
@@ -1337,15 +1535,24 @@ void media_player_set_duration(struct media_player *mp, uint32_t duration)
 
 void media_player_set_position(struct media_player *mp, uint32_t position)
 {
+	uint32_t current, delta;
+
 	DBG("%u", position);
 
 	/* Only update duration if track exists */
 	if (g_hash_table_size(mp->track) == 0)
 		return;
 
+	current = media_player_get_position(mp);
+	delta = position > current ? position - current : current - position;
+
 	mp->position = position;
 	g_timer_start(mp->progress);
 
+	/* Position is interpolated on read, only signal actual jumps */
+	if (delta < btd_opts.avrcp.position_interval)
+		return;
+
 	g_dbus_emit_property_changed(btd_get_dbus_connection(), mp->path,
 					MEDIA_PLAYER_INTERFACE, "Position");
 }
@@ -2027,6 +2234,7 @@ struct media_item *media_player_set_playlist_item(struct media_player *mp,
 void media_player_clear_playlist(struct media_player *mp)
 {
 	if (mp->playlist) {
+		folder_cache_clear(mp->playlist);
 		g_slist_free_full(mp->playlist->items, media_item_destroy);
 		mp->playlist->items = NULL;
 	}
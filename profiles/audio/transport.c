@@ -16,6 +16,9 @@
 
 #define _GNU_SOURCE
 #include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
 
 #include <glib.h>
 
@@ -37,6 +40,7 @@
 #include "src/shared/bap.h"
 #include "src/shared/bass.h"
 #include "src/shared/io.h"
+#include "src/shared/trace.h"
 
 #ifdef HAVE_A2DP
 #include "avdtp.h"
@@ -109,6 +113,21 @@ struct bap_transport {
 	guint			resume_id;
 };
 
+struct media_fanout {
+	struct media_transport	*transport;	/* Transport Fanout was called on */
+	struct queue		*links;		/* Transports fed by io */
+	struct io		*io;		/* Daemon end of the socket pair */
+	uint16_t		mtu;
+	uint8_t			*buf;
+};
+
+struct media_latency {
+	uint32_t		queued;		/* Bytes in socket send queue */
+	uint32_t		queue;		/* Queue delay (us) */
+	uint32_t		controller;	/* Controller delay (us) */
+	uint32_t		presentation;	/* Presentation delay (us) */
+};
+
 struct media_transport_ops {
 	const char *uuid;
 	const GDBusPropertyTable *properties;
@@ -128,6 +147,8 @@ struct media_transport_ops {
 	int (*get_volume)(struct media_transport *transport);
 	int (*set_volume)(struct media_transport *transport, int level);
 	int (*set_delay)(struct media_transport *transport, uint16_t delay);
+	void (*get_latency)(struct media_transport *transport,
+				struct media_latency *latency);
 	void (*update_links)(const struct media_transport *transport);
 	GDestroyNotify destroy;
 };
@@ -144,8 +165,10 @@ struct media_transport {
 	int			fd;		/* Transport file descriptor */
 	uint16_t		imtu;		/* Transport input mtu */
 	uint16_t		omtu;		/* Transport output mtu */
+	uint32_t		budget;		/* Latency budget (us) */
 	transport_state_t	state;
 	const struct media_transport_ops *ops;
+	struct media_fanout	*fanout;	/* Transport fanout group */
 	void			*data;
 };
 
@@ -209,6 +232,25 @@ find_transport_by_bap_stream(const struct bt_bap_stream *stream)
 	return NULL;
 }
 
+static void fanout_free(struct media_fanout *fanout);
+
+static void fanout_remove(struct media_transport *transport)
+{
+	struct media_fanout *fanout = transport->fanout;
+
+	if (!fanout)
+		return;
+
+	DBG("%s removed from fanout of %s", transport->path,
+						fanout->transport->path);
+
+	queue_remove(fanout->links, transport);
+	transport->fanout = NULL;
+
+	if (transport == fanout->transport || queue_isempty(fanout->links))
+		fanout_free(fanout);
+}
+
 static void transport_set_state(struct media_transport *transport,
 							transport_state_t state)
 {
@@ -220,6 +262,10 @@ static void transport_set_state(struct media_transport *transport,
 
 	transport->state = state;
 
+	/* Stream fds stop being valid once a transport leaves active */
+	if (old_state == TRANSPORT_STATE_ACTIVE)
+		fanout_remove(transport);
+
 	DBG("State changed %s: %s -> %s", transport->path, str_state[old_state],
 							str_state[state]);
 
@@ -268,6 +314,8 @@ static void media_request_reply(struct media_request *req, int err)
 	DBG("Request %s Reply %s", dbus_message_get_member(req->msg),
 							strerror(err));
 
+	BT_TRACE2(transport_reply, req->msg, err);
+
 	if (!err)
 		reply = g_dbus_create_reply(req->msg, DBUS_TYPE_INVALID);
 	else
@@ -661,6 +709,17 @@ static int transport_a2dp_snk_set_volume(struct media_transport *transport,
 }
 #endif
 
+static void transport_a2dp_get_latency(struct media_transport *transport,
+					struct media_latency *latency)
+{
+	struct a2dp_transport *a2dp = transport->data;
+
+	/* Delay is in 1/10 of millisecond and covers the whole sink path,
+	 * the link and controller delays cannot be told apart.
+	 */
+	latency->presentation = a2dp->delay * 100;
+}
+
 static int transport_a2dp_snk_set_delay(struct media_transport *transport,
 					uint16_t delay)
 {
@@ -800,6 +859,8 @@ static DBusMessage *acquire(DBusConnection *conn, DBusMessage *msg,
 	if (transport->state >= TRANSPORT_STATE_REQUESTING)
 		return btd_error_not_authorized(msg);
 
+	BT_TRACE2(transport_acquire, transport->path, msg);
+
 	owner = media_owner_create(msg);
 
 	if (!strcmp(media_endpoint_get_uuid(transport->endpoint),
@@ -844,6 +905,8 @@ static DBusMessage *try_acquire(DBusConnection *conn, DBusMessage *msg,
 		(transport->state != TRANSPORT_STATE_BROADCASTING))
 		return btd_error_not_available(msg);
 
+	BT_TRACE2(transport_acquire, transport->path, msg);
+
 	owner = media_owner_create(msg);
 	id = media_transport_resume(transport, owner);
 	if (id == 0) {
@@ -922,6 +985,8 @@ static DBusMessage *release(DBusConnection *conn, DBusMessage *msg,
 		}
 	}
 
+	BT_TRACE2(transport_release, transport->path, msg);
+
 	transport_set_state(transport, TRANSPORT_STATE_SUSPENDING);
 
 	id = media_transport_suspend(transport, owner);
@@ -1187,12 +1252,329 @@ static gboolean get_endpoint(const GDBusPropertyTable *property,
 	return TRUE;
 }
 
+static uint32_t transport_queued(struct media_transport *transport)
+{
+	int sndbuf, outq;
+	socklen_t len = sizeof(sndbuf);
+
+	if (transport->fd < 0)
+		return 0;
+
+	/* Bluetooth sockets report the free space of the send buffer */
+	if (getsockopt(transport->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+							&len) < 0)
+		return 0;
+
+	if (ioctl(transport->fd, TIOCOUTQ, &outq) < 0 || outq > sndbuf)
+		return 0;
+
+	return sndbuf - outq;
+}
+
+static void media_transport_get_latency(struct media_transport *transport,
+					struct media_latency *latency)
+{
+	memset(latency, 0, sizeof(*latency));
+
+	if (!transport->ops || !transport->ops->get_latency)
+		return;
+
+	if (transport->state == TRANSPORT_STATE_ACTIVE)
+		latency->queued = transport_queued(transport);
+
+	transport->ops->get_latency(transport, latency);
+}
+
+static gboolean get_latency(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct media_transport *transport = data;
+	struct media_latency latency;
+	DBusMessageIter dict;
+	uint32_t total;
+
+	media_transport_get_latency(transport, &latency);
+
+	total = latency.queue + latency.controller + latency.presentation;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+
+	dict_append_entry(&dict, "Queued", DBUS_TYPE_UINT32, &latency.queued);
+	dict_append_entry(&dict, "QueueDelay", DBUS_TYPE_UINT32,
+							&latency.queue);
+	dict_append_entry(&dict, "ControllerDelay", DBUS_TYPE_UINT32,
+							&latency.controller);
+	dict_append_entry(&dict, "PresentationDelay", DBUS_TYPE_UINT32,
+							&latency.presentation);
+	dict_append_entry(&dict, "Total", DBUS_TYPE_UINT32, &total);
+
+	if (transport->budget) {
+		dbus_bool_t over = total > transport->budget;
+
+		if (over)
+			DBG("Transport %s latency %u over budget %u",
+					transport->path, total,
+					transport->budget);
+
+		dict_append_entry(&dict, "OverBudget", DBUS_TYPE_BOOLEAN,
+								&over);
+	}
+
+	dbus_message_iter_close_container(iter, &dict);
+
+	return TRUE;
+}
+
+static gboolean get_latency_budget(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct media_transport *transport = data;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32,
+							&transport->budget);
+
+	return TRUE;
+}
+
+static void set_latency_budget(const GDBusPropertyTable *property,
+				DBusMessageIter *iter,
+				GDBusPendingPropertySet id,
+				void *data)
+{
+	struct media_transport *transport = data;
+	struct media_owner *owner = transport->owner;
+	const char *sender;
+	uint32_t arg;
+
+	if (owner != NULL) {
+		sender = g_dbus_pending_property_get_sender(id);
+		if (g_strcmp0(owner->name, sender) != 0) {
+			g_dbus_pending_property_error(id,
+					ERROR_INTERFACE ".NotAuthorized",
+					"Operation Not Authorized");
+			return;
+		}
+	}
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_UINT32) {
+		g_dbus_pending_property_error(id,
+				ERROR_INTERFACE ".InvalidArguments",
+				"Expected UINT32");
+		return;
+	}
+
+	dbus_message_iter_get_basic(iter, &arg);
+
+	g_dbus_pending_property_success(id);
+
+	if (transport->budget == arg)
+		return;
+
+	DBG("Transport %s latency budget %u", transport->path, arg);
+
+	transport->budget = arg;
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(),
+					transport->path,
+					MEDIA_TRANSPORT_INTERFACE,
+					"LatencyBudget");
+}
+
 static DBusMessage *select_transport(DBusConnection *conn, DBusMessage *msg,
 					void *data);
 
 static DBusMessage *unselect_transport(DBusConnection *conn, DBusMessage *msg,
 					void *data);
 
+static struct media_transport *find_transport_by_path(const char *path);
+
+static void fanout_unlink(void *data)
+{
+	struct media_transport *transport = data;
+
+	transport->fanout = NULL;
+}
+
+static void fanout_free(struct media_fanout *fanout)
+{
+	DBG("Fanout of %s destroyed", fanout->transport->path);
+
+	queue_destroy(fanout->links, fanout_unlink);
+	io_destroy(fanout->io);
+	free(fanout->buf);
+	free(fanout);
+}
+
+static void fanout_link(void *data, void *user_data)
+{
+	struct media_transport *transport = data;
+
+	transport->fanout = user_data;
+}
+
+static void fanout_send(void *data, void *user_data)
+{
+	struct media_transport *transport = data;
+	struct iovec *iov = user_data;
+
+	/* A sink that cannot keep up loses this packet rather than stalling
+	 * every other sink behind it.
+	 */
+	if (send(transport->fd, iov->iov_base, iov->iov_len,
+					MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		DBG("%s: send failed: %s (%d)", transport->path,
+						strerror(errno), errno);
+}
+
+static bool fanout_recv(struct io *io, void *user_data)
+{
+	struct media_fanout *fanout = user_data;
+	struct iovec iov;
+	ssize_t len;
+
+	len = read(io_get_fd(io), fanout->buf, fanout->mtu);
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return true;
+
+		error("Fanout read failed: %s (%d)", strerror(errno), errno);
+		return true;
+	}
+
+	iov.iov_base = fanout->buf;
+	iov.iov_len = len;
+
+	queue_foreach(fanout->links, fanout_send, &iov);
+
+	return true;
+}
+
+static bool fanout_disconnected(struct io *io, void *user_data)
+{
+	struct media_fanout *fanout = user_data;
+
+	fanout_free(fanout);
+
+	return false;
+}
+
+static bool fanout_can_link(struct media_transport *transport,
+					struct media_transport *link,
+					const char *sender)
+{
+	if (link == transport || link->fanout)
+		return false;
+
+	if (link->state != TRANSPORT_STATE_ACTIVE || link->fd < 0)
+		return false;
+
+	if (!link->owner || g_strcmp0(link->owner->name, sender))
+		return false;
+
+	if (strcasecmp(media_endpoint_get_uuid(link->endpoint),
+					media_endpoint_get_uuid(transport->endpoint)))
+		return false;
+
+	if (media_endpoint_get_codec(link->endpoint) !=
+				media_endpoint_get_codec(transport->endpoint))
+		return false;
+
+	return link->size == transport->size &&
+			!memcmp(link->configuration, transport->configuration,
+							transport->size);
+}
+
+static DBusMessage *fanout(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	struct media_transport *transport = data;
+	const char *sender = dbus_message_get_sender(msg);
+	struct media_fanout *fanout;
+	DBusMessageIter args, array;
+	struct queue *links;
+	uint16_t mtu;
+	int sv[2];
+
+	if (!transport->owner || g_strcmp0(transport->owner->name, sender))
+		return btd_error_not_authorized(msg);
+
+	if (transport->state != TRANSPORT_STATE_ACTIVE || transport->fanout ||
+			strcasecmp(media_endpoint_get_uuid(transport->endpoint),
+							A2DP_SOURCE_UUID))
+		return btd_error_not_authorized(msg);
+
+	dbus_message_iter_init(msg, &args);
+
+	if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY)
+		return btd_error_invalid_args(msg);
+
+	dbus_message_iter_recurse(&args, &array);
+
+	links = queue_new();
+	queue_push_tail(links, transport);
+	mtu = transport->omtu;
+
+	while (dbus_message_iter_get_arg_type(&array) ==
+						DBUS_TYPE_OBJECT_PATH) {
+		struct media_transport *link;
+		const char *path;
+
+		dbus_message_iter_get_basic(&array, &path);
+
+		link = find_transport_by_path(path);
+		if (!link || queue_find(links, NULL, link) ||
+				!fanout_can_link(transport, link, sender)) {
+			queue_destroy(links, NULL);
+			return btd_error_invalid_args(msg);
+		}
+
+		queue_push_tail(links, link);
+		mtu = MIN(mtu, link->omtu);
+
+		dbus_message_iter_next(&array);
+	}
+
+	if (queue_length(links) < 2) {
+		queue_destroy(links, NULL);
+		return btd_error_invalid_args(msg);
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		queue_destroy(links, NULL);
+		return btd_error_failed(msg, strerror(errno));
+	}
+
+	fanout = new0(struct media_fanout, 1);
+	fanout->transport = transport;
+	fanout->links = links;
+	fanout->mtu = mtu;
+	fanout->buf = malloc(mtu);
+	fanout->io = io_new(sv[0]);
+	io_set_close_on_destroy(fanout->io, true);
+	io_set_read_handler(fanout->io, fanout_recv, fanout, NULL);
+	io_set_disconnect_handler(fanout->io, fanout_disconnected, fanout,
+									NULL);
+
+	queue_foreach(links, fanout_link, fanout);
+
+	DBG("%s: feeding %u transports mtu %u", transport->path,
+						queue_length(links), mtu);
+
+	g_dbus_send_reply(conn, msg, DBUS_TYPE_UNIX_FD, &sv[1],
+					DBUS_TYPE_UINT16, &transport->imtu,
+					DBUS_TYPE_UINT16, &mtu,
+					DBUS_TYPE_INVALID);
+
+	close(sv[1]);
+
+	return NULL;
+}
+
 static const GDBusMethodTable transport_methods[] = {
 	{ GDBUS_ASYNC_METHOD("Acquire",
 			NULL,
@@ -1209,6 +1591,11 @@ static const GDBusMethodTable transport_methods[] = {
 			NULL, NULL, select_transport) },
 	{ GDBUS_ASYNC_METHOD("Unselect",
 			NULL, NULL, unselect_transport) },
+	{ GDBUS_EXPERIMENTAL_ASYNC_METHOD("Fanout",
+			GDBUS_ARGS({ "transports", "ao" }),
+			GDBUS_ARGS({ "fd", "h" }, { "mtu_r", "q" },
+							{ "mtu_w", "q" }),
+			fanout) },
 	{ },
 };
 
@@ -1224,6 +1611,10 @@ static const GDBusPropertyTable transport_a2dp_properties[] = {
 	{ "Volume", "q", get_volume, set_volume, volume_exists },
 	{ "Endpoint", "o", get_endpoint, NULL, endpoint_exists,
 				G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ "Latency", "a{sv}", get_latency, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ "LatencyBudget", "u", get_latency_budget, set_latency_budget,
+				NULL, G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
 	{ }
 };
 #endif /* HAVE_A2DP */
@@ -1424,6 +1815,10 @@ static const GDBusPropertyTable transport_bap_uc_properties[] = {
 	{ "Metadata", "ay", get_metadata },
 	{ "Links", "ao", get_links, NULL, links_exists },
 	{ "Volume", "q", get_volume, set_volume, volume_exists },
+	{ "Latency", "a{sv}", get_latency, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ "LatencyBudget", "u", get_latency_budget, set_latency_budget,
+				NULL, G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
 	{ }
 };
 
@@ -1559,6 +1954,10 @@ static const GDBusPropertyTable transport_bap_bc_properties[] = {
 	{ "Location", "u", get_location },
 	{ "Metadata", "ay", get_metadata },
 	{ "Links", "ao", get_links, set_links, NULL },
+	{ "Latency", "a{sv}", get_latency, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ "LatencyBudget", "u", get_latency_budget, set_latency_budget,
+				NULL, G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
 	{ }
 };
 
@@ -1628,6 +2027,8 @@ static void media_transport_free(void *data)
 
 	transports = g_slist_remove(transports, transport);
 
+	fanout_remove(transport);
+
 	if (transport->owner)
 		media_transport_remove_owner(transport);
 
@@ -2192,6 +2593,27 @@ static void bap_connecting(struct bt_bap_stream *stream, bool state, int fd,
 	bap_update_links(transport);
 }
 
+static void transport_bap_get_latency(struct media_transport *transport,
+					struct media_latency *latency)
+{
+	struct bap_transport *bap = transport->data;
+	struct bt_bap_io_qos *io_qos;
+
+	if (media_endpoint_is_broadcast(transport->endpoint)) {
+		io_qos = &bap->qos.bcast.io_qos;
+		latency->presentation = bap->qos.bcast.delay;
+	} else {
+		io_qos = &bap->qos.ucast.io_qos;
+		latency->presentation = bap->qos.ucast.delay;
+	}
+
+	if (io_qos->sdu)
+		latency->queue = (latency->queued + io_qos->sdu - 1) /
+					io_qos->sdu * io_qos->interval;
+
+	latency->controller = io_qos->latency * 1000;
+}
+
 static int transport_bap_get_volume(struct media_transport *transport)
 {
 	return bt_audio_vcp_get_volume(transport->device);
@@ -2398,8 +2820,8 @@ static void *transport_asha_init(struct media_transport *transport, void *data)
 
 #define TRANSPORT_OPS(_uuid, _props, _set_owner, _remove_owner, _init, \
 		      _resume, _suspend, _cancel, _set_state, _get_stream, \
-		      _get_volume, _set_volume, _set_delay, _update_links, \
-		      _destroy) \
+		      _get_volume, _set_volume, _set_delay, _get_latency, \
+		      _update_links, _destroy) \
 { \
 	.uuid = _uuid, \
 	.properties = _props, \
@@ -2414,6 +2836,7 @@ static void *transport_asha_init(struct media_transport *transport, void *data)
 	.get_volume = _get_volume, \
 	.set_volume = _set_volume, \
 	.set_delay = _set_delay, \
+	.get_latency = _get_latency, \
 	.update_links = _update_links, \
 	.destroy = _destroy \
 }
@@ -2424,7 +2847,8 @@ static void *transport_asha_init(struct media_transport *transport, void *data)
 			transport_a2dp_resume, transport_a2dp_suspend, \
 			transport_a2dp_cancel, NULL, \
 			transport_a2dp_get_stream, transport_a2dp_get_volume, \
-			_set_volume, _set_delay, NULL, _destroy)
+			_set_volume, _set_delay, transport_a2dp_get_latency, \
+			NULL, _destroy)
 
 #define BAP_OPS(_uuid, _props, _set_owner, _remove_owner, _update_links, \
 		_set_state) \
@@ -2434,7 +2858,8 @@ static void *transport_asha_init(struct media_transport *transport, void *data)
 			transport_bap_cancel, _set_state, \
 			transport_bap_get_stream, transport_bap_get_volume, \
 			transport_bap_set_volume, NULL, \
-			_update_links, transport_bap_destroy)
+			transport_bap_get_latency, _update_links, \
+			transport_bap_destroy)
 
 #define BAP_UC_OPS(_uuid) \
 	BAP_OPS(_uuid, transport_bap_uc_properties, \
@@ -2451,7 +2876,7 @@ static void *transport_asha_init(struct media_transport *transport, void *data)
 			transport_asha_resume, transport_asha_suspend, \
 			transport_asha_cancel, NULL, NULL, \
 			transport_asha_get_volume, transport_asha_set_volume, \
-			NULL, NULL, NULL)
+			NULL, NULL, NULL, NULL)
 
 static const struct media_transport_ops transport_ops[] = {
 #ifdef HAVE_A2DP
@@ -25,6 +25,9 @@
 
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
+#include "src/shared/att.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/gatt-client.h"
 
 #include "attrib/gattrib.h"
 #include "attrib/att.h"
@@ -43,6 +46,9 @@ struct bt_bas {
 	uint16_t ccc_handle;
 	guint id;
 	struct queue *gatt_op;
+	struct bt_gatt_client *client;
+	unsigned int read_id;
+	unsigned int notify_id;
 };
 
 struct gatt_request {
@@ -288,11 +294,126 @@ static void bas_discovered_cb(uint8_t status, GSList *chars, void *user_data)
 						discover_descriptor_cb, bas);
 }
 
+bool bt_bas_update_level(struct bt_bas *bas, const uint8_t *value,
+							uint16_t len)
+{
+	if (!bas || len < BAS_LEVEL_SIZE)
+		return false;
+
+	DBG("Battery Level at %u", value[0]);
+
+	return true;
+}
+
+static void level_read_cb(bool success, uint8_t att_ecode,
+					const uint8_t *value, uint16_t length,
+					void *user_data)
+{
+	struct bt_bas *bas = user_data;
+
+	bas->read_id = 0;
+
+	if (!success) {
+		error("Error reading Battery Level: %s",
+						att_ecode2str(att_ecode));
+		return;
+	}
+
+	bt_bas_update_level(bas, value, length);
+}
+
+static void level_notify_cb(uint16_t value_handle, const uint8_t *value,
+					uint16_t length, void *user_data)
+{
+	bt_bas_update_level(user_data, value, length);
+}
+
+static void level_register_cb(uint16_t att_ecode, void *user_data)
+{
+	if (att_ecode) {
+		error("Write Battery Level CCC failed: %s",
+						att_ecode2str(att_ecode));
+		return;
+	}
+
+	DBG("Battery Level: notification enabled");
+}
+
+static void foreach_bas_char(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct bt_bas *bas = user_data;
+	uint16_t value_handle;
+	bt_uuid_t uuid, level_uuid;
+
+	if (bas->handle)
+		return;
+
+	if (!gatt_db_attribute_get_char_data(attr, NULL, &value_handle, NULL,
+								NULL, &uuid))
+		return;
+
+	bt_uuid16_create(&level_uuid, GATT_CHARAC_BATTERY_LEVEL);
+	if (!bt_uuid_cmp(&level_uuid, &uuid))
+		bas->handle = value_handle;
+}
+
+/*
+ * With a GATT client the Battery Level handle comes from its database and
+ * the client takes care of the CCC, so nothing needs to be discovered.
+ */
+bool bt_bas_attach_client(struct bt_bas *bas, struct bt_gatt_client *client)
+{
+	struct gatt_db_attribute *attr;
+
+	if (!bas || !client || bas->attrib || bas->client || !bas->primary)
+		return false;
+
+	if (!bas->handle) {
+		attr = gatt_db_get_service(bt_gatt_client_get_db(client),
+						bas->primary->range.start);
+		if (attr)
+			gatt_db_service_foreach_char(attr, foreach_bas_char,
+									bas);
+	}
+
+	if (!bas->handle)
+		return false;
+
+	bas->client = bt_gatt_client_ref(client);
+	bas->notify_id = bt_gatt_client_register_notify(client, bas->handle,
+						level_register_cb,
+						level_notify_cb, bas, NULL);
+
+	return true;
+}
+
+uint16_t bt_bas_get_handle(struct bt_bas *bas)
+{
+	if (!bas || !bas->client)
+		return 0;
+
+	return bas->handle;
+}
+
+bool bt_bas_read(struct bt_bas *bas)
+{
+	if (!bas || !bas->client || bas->read_id)
+		return false;
+
+	bas->read_id = bt_gatt_client_read_value(bas->client, bas->handle,
+						level_read_cb, bas, NULL);
+
+	return bas->read_id != 0;
+}
+
 bool bt_bas_attach(struct bt_bas *bas, void *attrib)
 {
-	if (!bas || bas->attrib || !bas->primary)
+	if (!bas || bas->attrib || bas->client || !bas->primary)
 		return false;
 
+	if (bt_bas_attach_client(bas, g_attrib_get_client(attrib)))
+		return bt_bas_read(bas);
+
 	bas->attrib = g_attrib_ref(attrib);
 
 	if (bas->handle > 0)
@@ -313,7 +434,21 @@ static void cancel_gatt_req(struct gatt_request *req)
 
 void bt_bas_detach(struct bt_bas *bas)
 {
-	if (!bas || !bas->attrib)
+	if (!bas)
+		return;
+
+	if (bas->client) {
+		if (bas->read_id)
+			bt_gatt_client_cancel(bas->client, bas->read_id);
+
+		bt_gatt_client_unregister_notify(bas->client, bas->notify_id);
+		bas->read_id = 0;
+		bas->notify_id = 0;
+		bt_gatt_client_unref(bas->client);
+		bas->client = NULL;
+	}
+
+	if (!bas->attrib)
 		return;
 
 	if (bas->id > 0) {
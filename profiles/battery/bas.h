@@ -8,7 +8,10 @@
  *
  */
 
+#define BAS_LEVEL_SIZE 1
+
 struct bt_bas;
+struct bt_gatt_client;
 
 struct bt_bas *bt_bas_new(void *primary);
 
@@ -16,4 +19,10 @@ struct bt_bas *bt_bas_ref(struct bt_bas *bas);
 void bt_bas_unref(struct bt_bas *bas);
 
 bool bt_bas_attach(struct bt_bas *bas, void *gatt);
+bool bt_bas_attach_client(struct bt_bas *bas, struct bt_gatt_client *client);
 void bt_bas_detach(struct bt_bas *bas);
+
+uint16_t bt_bas_get_handle(struct bt_bas *bas);
+bool bt_bas_read(struct bt_bas *bas);
+bool bt_bas_update_level(struct bt_bas *bas, const uint8_t *value,
+							uint16_t len);
@@ -26,6 +26,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
+#include "src/shared/gatt-client.h"
 
 #include "attrib/gattrib.h"
 #include "attrib/att.h"
@@ -34,7 +35,6 @@
 #include "profiles/deviceinfo/dis.h"
 
 #define DIS_UUID16	0x180a
-#define PNP_ID_SIZE	7
 
 struct bt_dis {
 	int			ref_count;
@@ -44,6 +44,8 @@ struct bt_dis {
 	uint16_t		product;
 	uint16_t		version;
 	GAttrib			*attrib;	/* GATT connection */
+	struct bt_gatt_client	*client;
+	unsigned int		read_id;
 	struct gatt_primary	*primary;	/* Primary details */
 	bt_dis_notify		notify;
 	void			*notify_data;
@@ -189,12 +191,38 @@ static bool set_and_store_gatt_req(struct bt_dis *dis,
 	return queue_push_head(dis->gatt_op, req);
 }
 
+bool bt_dis_update_pnpid(struct bt_dis *dis, const uint8_t *value,
+							uint16_t len)
+{
+	if (!dis)
+		return false;
+
+	if (len < DIS_PNP_ID_SIZE) {
+		error("Error reading PNP_ID: Invalid pdu length received");
+		return false;
+	}
+
+	dis->source = value[0];
+	dis->vendor = get_le16(&value[1]);
+	dis->product = get_le16(&value[3]);
+	dis->version = get_le16(&value[5]);
+
+	DBG("source: 0x%02X vendor: 0x%04X product: 0x%04X version: 0x%04X",
+			dis->source, dis->vendor, dis->product, dis->version);
+
+	if (dis->notify)
+		dis->notify(dis->source, dis->vendor, dis->product,
+						dis->version, dis->notify_data);
+
+	return true;
+}
+
 static void read_pnpid_cb(guint8 status, const guint8 *pdu, guint16 len,
 							gpointer user_data)
 {
 	struct gatt_request *req = user_data;
 	struct bt_dis *dis = req->user_data;
-	uint8_t value[PNP_ID_SIZE];
+	uint8_t value[DIS_PNP_ID_SIZE];
 	ssize_t vlen;
 
 	destroy_gatt_req(req);
@@ -210,22 +238,24 @@ static void read_pnpid_cb(guint8 status, const guint8 *pdu, guint16 len,
 		return;
 	}
 
-	if (vlen < 7) {
-		error("Error reading PNP_ID: Invalid pdu length received");
-		return;
-	}
+	bt_dis_update_pnpid(dis, value, vlen);
+}
 
-	dis->source = value[0];
-	dis->vendor = get_le16(&value[1]);
-	dis->product = get_le16(&value[3]);
-	dis->version = get_le16(&value[5]);
+static void read_pnpid_value_cb(bool success, uint8_t att_ecode,
+					const uint8_t *value, uint16_t length,
+					void *user_data)
+{
+	struct bt_dis *dis = user_data;
 
-	DBG("source: 0x%02X vendor: 0x%04X product: 0x%04X version: 0x%04X",
-			dis->source, dis->vendor, dis->product, dis->version);
+	dis->read_id = 0;
 
-	if (dis->notify)
-		dis->notify(dis->source, dis->vendor, dis->product,
-						dis->version, dis->notify_data);
+	if (!success) {
+		error("Error reading PNP_ID value: %s",
+						att_ecode2str(att_ecode));
+		return;
+	}
+
+	bt_dis_update_pnpid(dis, value, length);
 }
 
 static void read_char(struct bt_dis *dis, GAttrib *attrib, uint16_t handle,
@@ -292,13 +322,62 @@ static void configure_deviceinfo_cb(uint8_t status, GSList *characteristics,
 	}
 }
 
+/*
+ * With a GATT client the PNP_ID handle comes from its database, so there is
+ * nothing to discover and the value can be read together with others.
+ */
+bool bt_dis_attach_client(struct bt_dis *dis, struct bt_gatt_client *client)
+{
+	struct gatt_db_attribute *attr;
+
+	if (!dis || !client || dis->attrib || dis->client)
+		return false;
+
+	if (!dis->handle && dis->primary) {
+		attr = gatt_db_get_service(bt_gatt_client_get_db(client),
+						dis->primary->range.start);
+		if (attr)
+			gatt_db_service_foreach_char(attr, foreach_dis_char,
+									dis);
+	}
+
+	if (!dis->handle)
+		return false;
+
+	dis->client = bt_gatt_client_ref(client);
+
+	return true;
+}
+
+uint16_t bt_dis_get_handle(struct bt_dis *dis)
+{
+	if (!dis || !dis->client)
+		return 0;
+
+	return dis->handle;
+}
+
+bool bt_dis_read(struct bt_dis *dis)
+{
+	if (!dis || !dis->client || dis->read_id)
+		return false;
+
+	dis->read_id = bt_gatt_client_read_value(dis->client, dis->handle,
+						read_pnpid_value_cb, dis, NULL);
+
+	return dis->read_id != 0;
+}
+
 bool bt_dis_attach(struct bt_dis *dis, void *attrib)
 {
 	struct gatt_primary *primary = dis->primary;
 
-	if (dis->attrib)
+	if (dis->attrib || dis->client)
 		return false;
 
+	if (bt_dis_attach_client(dis, g_attrib_get_client(attrib)))
+		return bt_dis_read(dis);
+
 	dis->attrib = g_attrib_ref(attrib);
 
 	if (!dis->handle)
@@ -319,6 +398,15 @@ static void cancel_gatt_req(struct gatt_request *req)
 
 void bt_dis_detach(struct bt_dis *dis)
 {
+	if (dis->client) {
+		if (dis->read_id)
+			bt_gatt_client_cancel(dis->client, dis->read_id);
+
+		dis->read_id = 0;
+		bt_gatt_client_unref(dis->client);
+		dis->client = NULL;
+	}
+
 	if (!dis->attrib)
 		return;
 
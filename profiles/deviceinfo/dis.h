@@ -8,7 +8,10 @@
  *
  */
 
+#define DIS_PNP_ID_SIZE	7
+
 struct bt_dis;
+struct bt_gatt_client;
 
 struct bt_dis *bt_dis_new(struct gatt_db *db);
 struct bt_dis *bt_dis_new_primary(void *primary);
@@ -17,8 +20,14 @@ struct bt_dis *bt_dis_ref(struct bt_dis *dis);
 void bt_dis_unref(struct bt_dis *dis);
 
 bool bt_dis_attach(struct bt_dis *dis, void *gatt);
+bool bt_dis_attach_client(struct bt_dis *dis, struct bt_gatt_client *client);
 void bt_dis_detach(struct bt_dis *dis);
 
+uint16_t bt_dis_get_handle(struct bt_dis *dis);
+bool bt_dis_read(struct bt_dis *dis);
+bool bt_dis_update_pnpid(struct bt_dis *dis, const uint8_t *value,
+							uint16_t len);
+
 typedef void (*bt_dis_notify) (uint8_t source, uint16_t vendor,
 					uint16_t product, uint16_t version,
 					void *user_data);
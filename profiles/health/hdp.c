@@ -1328,6 +1328,38 @@ static void release_adapter_instance(struct hdp_adapter *hdp_adapter)
 	hdp_adapter->mi = NULL;
 }
 
+static void clock_info_cb(int err, uint32_t local_clock,
+				uint32_t piconet_clock, uint16_t accuracy,
+				void *user_data)
+{
+	struct mcap_mcl *mcl = user_data;
+
+	if (err < 0)
+		piconet_clock = MCAP_BTCLOCK_IMMEDIATE;
+
+	mcap_sync_clock_update(mcl, piconet_clock, accuracy);
+}
+
+static void clock_info_free(void *user_data)
+{
+	mcap_mcl_unref(user_data);
+}
+
+static void clock_req(struct mcap_mcl *mcl, gpointer data)
+{
+	struct hdp_adapter *hdp_adapter = data;
+	bdaddr_t addr;
+
+	mcap_mcl_get_addr(mcl, &addr);
+
+	if (btd_adapter_get_clock_info(hdp_adapter->btd_adapter, &addr,
+					clock_info_cb, mcap_mcl_ref(mcl),
+					clock_info_free) < 0) {
+		mcap_sync_clock_update(mcl, MCAP_BTCLOCK_IMMEDIATE, 0);
+		mcap_mcl_unref(mcl);
+	}
+}
+
 static gboolean update_adapter(struct hdp_adapter *hdp_adapter)
 {
 	GError *err = NULL;
@@ -1355,6 +1387,8 @@ static gboolean update_adapter(struct hdp_adapter *hdp_adapter)
 		return FALSE;
 	}
 
+	mcap_set_clock_source(hdp_adapter->mi, clock_req, hdp_adapter);
+
 	hdp_adapter->ccpsm = mcap_get_ctrl_psm(hdp_adapter->mi, &err);
 	if (err != NULL) {
 		error("Error getting MCAP control PSM: %s", err->message);
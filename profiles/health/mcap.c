@@ -38,6 +38,9 @@
 #define MAX_RETRIES	10
 #define SAMPLE_COUNT	20
 
+#define CLOCK_REFRESH	500	/* ms before reading BT clock again */
+#define CLOCK_EXPIRE	2000	/* ms a BT clock reading can be used */
+
 #define RESPONSE_TIMER	6	/* seconds */
 #define MAX_CACHED	10	/* 10 devices */
 
@@ -62,6 +65,12 @@ struct mcap_csp {
 	guint		set_timer;	/* CSP-Perip: delayed set timer */
 	void		*set_data;	/* CSP-Perip: delayed set data */
 	void		*csp_priv_data;	/* CSP-Cent.: In-flight request data */
+	uint32_t	clk_anchor;	/* CSP: last BT clock reading */
+	uint16_t	clk_acc;	/* CSP: accuracy of the reading */
+	struct timespec	clk_time;	/* CSP: time of the reading */
+	struct timespec	clk_req;	/* CSP: time of the request */
+	gboolean	clk_valid;	/* CSP: clock anchor available */
+	gboolean	clk_pending;	/* CSP: clock read in progress */
 };
 
 struct mcap_sync_cap_cbdata {
@@ -2330,6 +2339,8 @@ static void reset_tmstamp(struct mcap_csp *csp, struct timespec *base_time,
 		clock_gettime(CLK, &csp->base_time);
 }
 
+static void request_btclock(struct mcap_mcl *mcl);
+
 void mcap_sync_init(struct mcap_mcl *mcl)
 {
 	if (!mcl->mi->csp_enabled) {
@@ -2344,6 +2355,9 @@ void mcap_sync_init(struct mcap_mcl *mcl)
 	mcl->csp->csp_priv_data = NULL;
 
 	reset_tmstamp(mcl->csp, NULL, 0);
+
+	/* Have a clock reading ready by the time a sync request comes in */
+	request_btclock(mcl);
 }
 
 void mcap_sync_stop(struct mcap_mcl *mcl)
@@ -2409,17 +2423,74 @@ static gboolean valid_btclock(uint32_t btclk)
 	return btclk <= MCAP_BTCLOCK_MAX;
 }
 
-/* This call may fail; either deal with retry or use read_btclock_retry */
+static void request_btclock(struct mcap_mcl *mcl)
+{
+	struct mcap_csp *csp = mcl->csp;
+
+	if (!mcl->mi->clock_req_cb || csp->clk_pending)
+		return;
+
+	if (clock_gettime(CLK, &csp->clk_req) < 0)
+		return;
+
+	csp->clk_pending = TRUE;
+	mcl->mi->clock_req_cb(mcl, mcl->mi->clock_data);
+}
+
+void mcap_sync_clock_update(struct mcap_mcl *mcl, uint32_t btclock,
+							uint16_t accuracy)
+{
+	struct mcap_csp *csp = mcl->csp;
+	struct timespec now;
+	uint64_t req, mid;
+
+	if (!csp || !csp->clk_pending)
+		return;
+
+	csp->clk_pending = FALSE;
+
+	if (!valid_btclock(btclock) || clock_gettime(CLK, &now) < 0)
+		return;
+
+	/* The controller sampled the clock somewhere within the round trip */
+	req = time_us(&csp->clk_req);
+	mid = req + (time_us(&now) - req) / 2;
+
+	csp->clk_anchor = btclock;
+	csp->clk_acc = accuracy;
+	csp->clk_time.tv_sec = mid / 1000000;
+	csp->clk_time.tv_nsec = (mid % 1000000) * 1000;
+	csp->clk_valid = TRUE;
+}
+
+/*
+ * The BT clock is extrapolated from the last reading of the controller, so
+ * reading it is cheap and a new reading is only requested once in a while.
+ * This call may fail; either deal with retry or use read_btclock_retry.
+ */
 static gboolean read_btclock(struct mcap_mcl *mcl, uint32_t *btclock,
 							uint16_t *btaccuracy)
 {
-	/*
-	 * FIXME: btd_adapter_read_clock(...) always return FALSE, current
-	 * code doesn't support CSP (Clock Synchronization Protocol). To avoid
-	 * build dependancy on struct 'btd_adapter', removing this code.
-	 */
+	struct mcap_csp *csp = mcl->csp;
+	struct timespec now;
+	int64_t age;
 
-	return FALSE;
+	if (!csp || clock_gettime(CLK, &now) < 0)
+		return FALSE;
+
+	age = time_us(&now) - time_us(&csp->clk_time);
+
+	if (!csp->clk_valid || age > CLOCK_REFRESH * 1000)
+		request_btclock(mcl);
+
+	if (!csp->clk_valid || age < 0 || age > CLOCK_EXPIRE * 1000)
+		return FALSE;
+
+	/* One BT clock tick every 312.5 us */
+	*btclock = (csp->clk_anchor + age * 2 / 625) & MCAP_BTCLOCK_MAX;
+	*btaccuracy = csp->clk_acc;
+
+	return TRUE;
 }
 
 static gboolean read_btclock_retry(struct mcap_mcl *mcl, uint32_t *btclock,
@@ -2548,6 +2619,10 @@ static gboolean initialize_caps(struct mcap_mcl *mcl)
 	}
 	latency /= SAMPLE_COUNT;
 
+	/* Extrapolated readings can take less than the timer resolution */
+	if (latency < 1)
+		latency = 1;
+
 	_caps.latency = latency;
 	_caps.preempt_thresh = latency * 4;
 	_caps.syncleadtime_ms = latency * 50 / 1000;
@@ -3204,3 +3279,11 @@ void mcap_disable_csp(struct mcap_instance *mi)
 {
 	mi->csp_enabled = FALSE;
 }
+
+/* The callback shall report the reading with mcap_sync_clock_update */
+void mcap_set_clock_source(struct mcap_instance *mi, mcap_clock_req_cb cb,
+							gpointer user_data)
+{
+	mi->clock_req_cb = cb;
+	mi->clock_data = user_data;
+}
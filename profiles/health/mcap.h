@@ -232,6 +232,8 @@ typedef void (* mcap_mcl_connect_cb) (struct mcap_mcl *mcl, GError *err,
 typedef void (* mcap_info_ind_event_cb) (struct mcap_mcl *mcl,
 					struct sync_info_ind_data *data);
 
+typedef void (* mcap_clock_req_cb) (struct mcap_mcl *mcl, gpointer data);
+
 typedef void (* mcap_sync_cap_cb) (struct mcap_mcl *mcl,
 					uint8_t mcap_err,
 					uint8_t btclockres,
@@ -275,6 +277,8 @@ struct mcap_instance {
 	int			ref;			/* Reference counter */
 
 	gboolean		csp_enabled;		/* CSP: functionality enabled */
+	mcap_clock_req_cb	clock_req_cb;		/* CSP: read BT clock */
+	gpointer		clock_data;		/* CSP: clock user data */
 };
 
 struct mcap_mcl {
@@ -376,6 +380,10 @@ void mcap_mcl_unref(struct mcap_mcl *mcl);
 
 void mcap_enable_csp(struct mcap_instance *mi);
 void mcap_disable_csp(struct mcap_instance *mi);
+void mcap_set_clock_source(struct mcap_instance *mi, mcap_clock_req_cb cb,
+							gpointer user_data);
+void mcap_sync_clock_update(struct mcap_mcl *mcl, uint32_t btclock,
+							uint16_t accuracy);
 uint64_t mcap_get_timestamp(struct mcap_mcl *mcl,
 				struct timespec *given_time);
 uint32_t mcap_get_btclock(struct mcap_mcl *mcl);
@@ -36,6 +36,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
+#include "src/shared/gatt-client.h"
 #include "src/log.h"
 
 #include "attrib/att.h"
@@ -65,6 +66,7 @@
 #define HOG_PROTO_MODE_REPORT  1
 
 #define HID_INFO_SIZE			4
+#define SERVICES_READ_MAX		8
 #define ATT_NOTIFICATION_HEADER_SIZE	3
 
 struct bt_hog {
@@ -77,6 +79,7 @@ struct bt_hog {
 	struct gatt_db_attribute *attr;
 	struct gatt_primary	*primary;
 	GAttrib			*attrib;
+	struct bt_gatt_client	*client;
 	GSList			*reports;
 	struct bt_uhid		*uhid;
 	int			uhid_fd;
@@ -91,15 +94,32 @@ struct bt_hog {
 	unsigned int		setrep_att;
 	uint16_t		setrep_id;
 	unsigned int		report_map_id;
+	bool			report_map_valid;
 	struct bt_scpp		*scpp;
 	struct bt_dis		*dis;
 	struct queue		*bas;
+	struct services_read	*services_read;
 	GSList			*instances;
 	struct queue		*gatt_op;
 	struct gatt_db		*gatt_db;
 	struct gatt_db_attribute	*report_map_attr;
 };
 
+/* Initial values of the DIS and BAS instances, fetched in a single request */
+struct services_read {
+	struct bt_hog		*hog;
+	unsigned int		id;
+	bool			cancelled;
+	struct bt_dis		*dis;
+	struct queue		*bas;
+	uint16_t		handles[SERVICES_READ_MAX];
+	uint8_t			num_handles;
+	uint8_t			value[DIS_PNP_ID_SIZE +
+				(SERVICES_READ_MAX - 1) * BAS_LEVEL_SIZE];
+	uint16_t		len;
+	uint16_t		offset;
+};
+
 struct report {
 	struct bt_hog		*hog;
 	bool			numbered;
@@ -109,6 +129,7 @@ struct report {
 	uint16_t		value_handle;
 	uint8_t			properties;
 	uint16_t		ccc_handle;
+	struct gatt_db_attribute *ref_attr;
 	guint			notifyid;
 	uint16_t		len;
 	uint8_t			*value;
@@ -340,6 +361,19 @@ static void report_value_cb(const guint8 *pdu, guint16 len, gpointer user_data)
 		error("bt_uhid_input: %s (%d)", strerror(-err), -err);
 }
 
+static void report_notify_cb(uint16_t value_handle, const uint8_t *value,
+					uint16_t length, void *user_data)
+{
+	struct report *report = user_data;
+	struct bt_hog *hog = report->hog;
+	int err;
+
+	err = bt_uhid_input(hog->uhid, report->numbered ? report->id : 0,
+							value, length);
+	if (err < 0)
+		error("bt_uhid_input: %s (%d)", strerror(-err), -err);
+}
+
 static void report_notify_destroy(void *user_data)
 {
 	struct report *report = user_data;
@@ -349,6 +383,80 @@ static void report_notify_destroy(void *user_data)
 	report->notifyid = 0;
 }
 
+static void report_register_cb(uint16_t att_ecode, void *user_data)
+{
+	struct report *report = user_data;
+
+	if (att_ecode) {
+		error("Enable report notifications failed: %s",
+						att_ecode2str(att_ecode));
+		return;
+	}
+
+	DBG("Report 0x%04x: notifications enabled", report->value_handle);
+}
+
+static void report_register_notify(struct bt_hog *hog, struct report *report)
+{
+	if (report->notifyid)
+		return;
+
+	/* bt_gatt_client takes care of the CCC and delivers the value
+	 * without the ATT header, so prefer it whenever available.
+	 */
+	if (hog->client)
+		report->notifyid = bt_gatt_client_register_notify(hog->client,
+						report->value_handle,
+						report_register_cb,
+						report_notify_cb, report,
+						report_notify_destroy);
+	else
+		report->notifyid = g_attrib_register(hog->attrib,
+						ATT_OP_HANDLE_NOTIFY,
+						report->value_handle,
+						report_value_cb, report,
+						report_notify_destroy);
+
+	if (!report->notifyid)
+		error("Unable to register report notification: handle 0x%04x",
+						report->value_handle);
+}
+
+static void report_unregister_notify(struct bt_hog *hog,
+						struct report *report)
+{
+	if (!report->notifyid)
+		return;
+
+	if (hog->client)
+		bt_gatt_client_unregister_notify(hog->client,
+							report->notifyid);
+	else
+		g_attrib_unregister(hog->attrib, report->notifyid);
+
+	report->notifyid = 0;
+}
+
+static void write_cmd(struct bt_hog *hog, uint16_t handle, const void *value,
+								size_t vlen)
+{
+	if (hog->client) {
+		bt_gatt_client_write_without_response(hog->client, handle,
+							false, value, vlen);
+		return;
+	}
+
+	gatt_write_cmd(hog->attrib, handle, value, vlen, NULL, NULL);
+}
+
+static void cancel_report_req(struct bt_hog *hog, unsigned int id)
+{
+	if (hog->client)
+		bt_gatt_client_cancel(hog->client, id);
+	else
+		g_attrib_cancel(hog->attrib, id);
+}
+
 static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 					guint16 plen, gpointer user_data)
 {
@@ -365,16 +473,9 @@ static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 	if (report->notifyid)
 		goto remove;
 
-	report->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					report->value_handle,
-					report_value_cb, report,
-					report_notify_destroy);
-	if (!report->notifyid) {
-		error("Unable to register report notification: handle 0x%04x",
-					report->value_handle);
+	report_register_notify(hog, report);
+	if (!report->notifyid)
 		goto remove;
-	}
 
 	DBG("Report characteristic descriptor written: notifications enabled");
 
@@ -424,6 +525,13 @@ static const char *type_to_string(uint8_t type)
 	return NULL;
 }
 
+static void db_report_ref_write_value_cb(struct gatt_db_attribute *attr,
+						int err, void *user_data)
+{
+	if (err)
+		error("Error writing report reference value to gatt db");
+}
+
 static void report_reference_cb(guint8 status, const guint8 *pdu,
 					guint16 plen, gpointer user_data)
 {
@@ -447,8 +555,19 @@ static void report_reference_cb(guint8 status, const guint8 *pdu,
 	DBG("Report 0x%04x: id 0x%02x type %s", report->value_handle,
 				report->id, type_to_string(report->type));
 
+	/* Cache the reference so the next connection can skip waiting on it */
+	if (report->ref_attr)
+		gatt_db_attribute_write(report->ref_attr, 0, &pdu[1], 2, 0,
+					NULL, db_report_ref_write_value_cb,
+					NULL);
+
 	/* Enable notifications only for Input Reports */
-	if (report->type == HOG_REPORT_TYPE_INPUT)
+	if (report->type != HOG_REPORT_TYPE_INPUT || report->notifyid)
+		goto remove;
+
+	if (report->hog->client)
+		report_register_notify(report->hog, report);
+	else
 		read_char(report->hog, report->hog->attrib, report->ccc_handle,
 							ccc_read_cb, report);
 
@@ -743,6 +862,26 @@ static void output_written_cb(guint8 status, const guint8 *pdu,
 	remove_gatt_req(req, status);
 }
 
+static void output_write_cb(bool success, uint8_t att_ecode, void *user_data)
+{
+	if (!success)
+		error("Write output report failed: %s",
+						att_ecode2str(att_ecode));
+}
+
+static void write_output(struct bt_hog *hog, uint16_t handle,
+					const void *value, size_t vlen)
+{
+	if (hog->client) {
+		bt_gatt_client_write_value(hog->client, handle, value, vlen,
+						output_write_cb, NULL, NULL);
+		return;
+	}
+
+	write_char(hog, hog->attrib, handle, value, vlen, output_written_cb,
+									hog);
+}
+
 static void forward_report(struct uhid_event *ev, void *user_data)
 {
 	struct bt_hog *hog = user_data;
@@ -770,11 +909,9 @@ static void forward_report(struct uhid_event *ev, void *user_data)
 		return;
 
 	if (report->properties & GATT_CHR_PROP_WRITE)
-		write_char(hog, hog->attrib, report->value_handle,
-				data, size, output_written_cb, hog);
+		write_output(hog, report->value_handle, data, size);
 	else if (report->properties & GATT_CHR_PROP_WRITE_WITHOUT_RESP)
-		gatt_write_cmd(hog->attrib, report->value_handle,
-						data, size, NULL, NULL);
+		write_cmd(hog, report->value_handle, data, size);
 }
 
 static void set_numbered(void *data, void *user_data)
@@ -826,6 +963,17 @@ static void set_report_cb(guint8 status, const guint8 *pdu,
 		error("bt_uhid_set_report_reply: %s", strerror(-err));
 }
 
+static void set_report_write_cb(bool success, uint8_t att_ecode,
+							void *user_data)
+{
+	if (success)
+		att_ecode = 0;
+	else if (!att_ecode)
+		att_ecode = BT_ATT_ERROR_UNLIKELY;
+
+	set_report_cb(att_ecode, NULL, 0, user_data);
+}
+
 static void uhid_destroy(struct bt_hog *hog, bool force)
 {
 	int err;
@@ -860,7 +1008,7 @@ static void set_report(struct uhid_event *ev, void *user_data)
 
 	/* uhid never sends reqs in parallel; if there's a req, it timed out */
 	if (hog->setrep_att) {
-		g_attrib_cancel(hog->attrib, hog->setrep_att);
+		cancel_report_req(hog, hog->setrep_att);
 		hog->setrep_att = 0;
 	}
 
@@ -884,7 +1032,14 @@ static void set_report(struct uhid_event *ev, void *user_data)
 	DBG("Sending report type %d ID %d to handle 0x%X", report->type,
 				report->id, report->value_handle);
 
-	hog->setrep_att = gatt_write_char(hog->attrib,
+	if (hog->client)
+		hog->setrep_att = bt_gatt_client_write_value(hog->client,
+						report->value_handle,
+						data, size,
+						set_report_write_cb, hog,
+						NULL);
+	else
+		hog->setrep_att = gatt_write_char(hog->attrib,
 						report->value_handle,
 						data, size, set_report_cb,
 						hog);
@@ -942,6 +1097,24 @@ exit:
 	report_reply(hog, status, report->numbered ? report->id : 0, len, pdu);
 }
 
+static void get_report_read_cb(bool success, uint8_t att_ecode,
+					const uint8_t *value, uint16_t length,
+					void *user_data)
+{
+	struct report *report = user_data;
+	struct bt_hog *hog = report->hog;
+
+	if (!success) {
+		error("Error reading Report value: %s",
+						att_ecode2str(att_ecode));
+		report_reply(hog, att_ecode ? att_ecode : EIO, 0, 0, NULL);
+		return;
+	}
+
+	report_reply(hog, 0, report->numbered ? report->id : 0, length,
+									value);
+}
+
 static void get_report(struct uhid_event *ev, void *user_data)
 {
 	struct bt_hog *hog = user_data;
@@ -958,7 +1131,7 @@ static void get_report(struct uhid_event *ev, void *user_data)
 
 	/* uhid never sends reqs in parallel; if there's a req, it timed out */
 	if (hog->getrep_att) {
-		g_attrib_cancel(hog->attrib, hog->getrep_att);
+		cancel_report_req(hog, hog->getrep_att);
 		hog->getrep_att = 0;
 	}
 
@@ -971,7 +1144,13 @@ static void get_report(struct uhid_event *ev, void *user_data)
 		goto fail;
 	}
 
-	hog->getrep_att = gatt_read_char(hog->attrib,
+	if (hog->client)
+		hog->getrep_att = bt_gatt_client_read_value(hog->client,
+						report->value_handle,
+						get_report_read_cb, report,
+						NULL);
+	else
+		hog->getrep_att = gatt_read_char(hog->attrib,
 						report->value_handle,
 						get_report_cb, report);
 	if (!hog->getrep_att) {
@@ -1028,6 +1207,25 @@ static void db_report_map_write_value_cb(struct gatt_db_attribute *attr,
 		error("Error writing report map value to gatt db");
 }
 
+static void db_report_map_read_value_cb(struct gatt_db_attribute *attrib,
+						int err, const uint8_t *value,
+						size_t length, void *user_data);
+
+static bool report_map_changed(struct bt_hog *hog, const uint8_t *value,
+								size_t vlen)
+{
+	struct iovec map = {};
+
+	if (!hog->report_map_attr)
+		return true;
+
+	gatt_db_attribute_read(hog->report_map_attr, 0, BT_ATT_OP_READ_REQ,
+					NULL, db_report_map_read_value_cb,
+					&map);
+
+	return map.iov_len != vlen || memcmp(map.iov_base, value, vlen);
+}
+
 static void report_map_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 							gpointer user_data)
 {
@@ -1038,6 +1236,8 @@ static void report_map_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 
 	remove_gatt_req(req, status);
 
+	hog->report_map_id = 0;
+
 	if (status != 0) {
 		error("Report Map read failed: %s", att_ecode2str(status));
 		return;
@@ -1051,6 +1251,16 @@ static void report_map_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 		goto done;
 	}
 
+	hog->report_map_valid = true;
+
+	if (bt_uhid_created(hog->uhid)) {
+		if (!report_map_changed(hog, value, vlen))
+			goto done;
+
+		DBG("HoG Report Map changed, recreating uHID device");
+		uhid_destroy(hog, true);
+	}
+
 	uhid_create(hog, value, vlen);
 
 	/* Cache the report map if gatt_db is available  */
@@ -1068,7 +1278,10 @@ static void read_report_map(struct bt_hog *hog)
 {
 	uint16_t handle;
 
-	if (!hog->report_map_attr || bt_uhid_created(hog->uhid) ||
+	/* A Report Map loaded from the cache is still read once to validate
+	 * it, but only after the device is already usable.
+	 */
+	if (!hog->report_map_attr || hog->report_map_valid ||
 			hog->report_map_id)
 		return;
 
@@ -1134,8 +1347,7 @@ static void proto_mode_read_cb(guint8 status, const guint8 *pdu, guint16 plen,
 
 		DBG("HoG is operating in Boot Procotol Mode");
 
-		gatt_write_cmd(hog->attrib, hog->proto_mode_handle, &nval,
-						sizeof(nval), NULL, NULL);
+		write_cmd(hog, hog->proto_mode_handle, &nval, sizeof(nval));
 	} else if (value == HOG_PROTO_MODE_REPORT)
 		DBG("HoG is operating in Report Protocol Mode");
 
@@ -1261,6 +1473,29 @@ struct bt_hog *bt_hog_new_default(const char *name, uint16_t vendor,
 	return bt_hog_new(-1, name, vendor, product, version, type, db);
 }
 
+static void db_report_ref_read_value_cb(struct gatt_db_attribute *attrib,
+						int err, const uint8_t *value,
+						size_t length, void *user_data)
+{
+	struct report *report = user_data;
+	struct bt_hog *hog = report->hog;
+
+	if (err || length != 2)
+		return;
+
+	report->id = value[0];
+	report->type = value[1];
+
+	DBG("Report 0x%04x: cached id 0x%02x type %s", report->value_handle,
+				report->id, type_to_string(report->type));
+
+	/* bt_gatt_client locates the CCC on its own so notifications can be
+	 * enabled before the descriptors are read again.
+	 */
+	if (report->type == HOG_REPORT_TYPE_INPUT && hog->client)
+		report_register_notify(hog, report);
+}
+
 static void foreach_hog_report(struct gatt_db_attribute *attr, void *user_data)
 {
 	struct report *report = user_data;
@@ -1274,6 +1509,14 @@ static void foreach_hog_report(struct gatt_db_attribute *attr, void *user_data)
 
 	bt_uuid16_create(&ref_uuid, GATT_REPORT_REFERENCE);
 	if (!bt_uuid_cmp(&ref_uuid, uuid)) {
+		report->ref_attr = attr;
+
+		/* Use the cached reference right away and validate it with
+		 * a read in the background.
+		 */
+		gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
+					db_report_ref_read_value_cb, report);
+
 		read_char(hog, hog->attrib, handle, report_reference_cb,
 								report);
 		return;
@@ -1592,17 +1835,163 @@ static void hog_attach_scpp(struct bt_hog *hog, struct gatt_primary *primary)
 		bt_scpp_attach(hog->scpp, hog->attrib);
 }
 
+static void services_read_cb(bool success, uint8_t att_ecode,
+					const uint8_t *value, uint16_t length,
+					void *user_data)
+{
+	struct services_read *read = user_data;
+
+	if (!success) {
+		DBG("Read Multiple failed: %s", att_ecode2str(att_ecode));
+		return;
+	}
+
+	/* Values are all of fixed size, so each one is at a known offset */
+	if (length > sizeof(read->value) - read->len)
+		length = sizeof(read->value) - read->len;
+
+	memcpy(read->value + read->len, value, length);
+	read->len += length;
+}
+
+static void services_read_bas(void *data, void *user_data)
+{
+	struct bt_bas *bas = data;
+	struct services_read *read = user_data;
+
+	if (read->offset + BAS_LEVEL_SIZE <= read->len)
+		bt_bas_update_level(bas, read->value + read->offset,
+							BAS_LEVEL_SIZE);
+	else
+		bt_bas_read(bas);
+
+	read->offset += BAS_LEVEL_SIZE;
+}
+
+static void services_read_destroy(void *user_data)
+{
+	struct services_read *read = user_data;
+
+	/* Anything the response did not cover is read on its own */
+	if (!read->cancelled) {
+		read->hog->services_read = NULL;
+
+		if (read->dis) {
+			if (read->len >= DIS_PNP_ID_SIZE)
+				bt_dis_update_pnpid(read->dis, read->value,
+							DIS_PNP_ID_SIZE);
+			else
+				bt_dis_read(read->dis);
+
+			read->offset = DIS_PNP_ID_SIZE;
+		}
+
+		queue_foreach(read->bas, services_read_bas, read);
+	}
+
+	bt_dis_unref(read->dis);
+	queue_destroy(read->bas, (void *) bt_bas_unref);
+	free(read);
+}
+
+static void services_read_add_bas(void *data, void *user_data)
+{
+	struct bt_bas *bas = data;
+	struct services_read *read = user_data;
+	uint16_t handle = bt_bas_get_handle(bas);
+
+	if (!handle)
+		return;
+
+	if (read->num_handles == SERVICES_READ_MAX) {
+		bt_bas_read(bas);
+		return;
+	}
+
+	read->handles[read->num_handles++] = handle;
+	queue_push_tail(read->bas, bt_bas_ref(bas));
+}
+
+/*
+ * Read the fixed size values of DIS and BAS that are attached through the
+ * GATT client with one Read Multiple request, saving a round trip for each
+ * of them on every reconnection.
+ */
+static void hog_read_services(struct bt_hog *hog)
+{
+	struct services_read *read;
+	uint16_t handle;
+
+	if (!hog->client || hog->services_read)
+		return;
+
+	read = new0(struct services_read, 1);
+	read->hog = hog;
+	read->bas = queue_new();
+
+	handle = bt_dis_get_handle(hog->dis);
+	if (handle) {
+		read->dis = bt_dis_ref(hog->dis);
+		read->handles[read->num_handles++] = handle;
+	}
+
+	queue_foreach(hog->bas, services_read_add_bas, read);
+
+	if (read->num_handles > 1)
+		read->id = bt_gatt_client_read_multiple(hog->client,
+						read->handles,
+						read->num_handles,
+						services_read_cb, read,
+						services_read_destroy);
+
+	if (!read->id) {
+		services_read_destroy(read);
+		return;
+	}
+
+	hog->services_read = read;
+}
+
+static void hog_cancel_services_read(struct bt_hog *hog)
+{
+	struct services_read *read = hog->services_read;
+
+	if (!read)
+		return;
+
+	hog->services_read = NULL;
+	read->cancelled = true;
+
+	/* The destroy callback frees it once the request is gone */
+	bt_gatt_client_cancel(hog->client, read->id);
+}
+
+static void attach_dis(struct bt_hog *hog)
+{
+	if (!bt_dis_attach_client(hog->dis, hog->client))
+		bt_dis_attach(hog->dis, hog->attrib);
+}
+
+static void attach_bas(void *data, void *user_data)
+{
+	struct bt_bas *bas = data;
+	struct bt_hog *hog = user_data;
+
+	if (!bt_bas_attach_client(bas, hog->client))
+		bt_bas_attach(bas, hog->attrib);
+}
+
 static void hog_attach_dis(struct bt_hog *hog, struct gatt_primary *primary)
 {
 	if (hog->dis) {
-		bt_dis_attach(hog->dis, hog->attrib);
+		attach_dis(hog);
 		return;
 	}
 
 	hog->dis = bt_dis_new_primary(primary);
 	if (hog->dis) {
 		bt_dis_set_notification(hog->dis, dis_notify, hog);
-		bt_dis_attach(hog->dis, hog->attrib);
+		attach_dis(hog);
 	}
 }
 
@@ -1612,7 +2001,7 @@ static void hog_attach_bas(struct bt_hog *hog, struct gatt_primary *primary)
 
 	instance = bt_bas_new(primary);
 
-	bt_bas_attach(instance, hog->attrib);
+	attach_bas(instance, hog);
 	queue_push_head(hog->bas, instance);
 }
 
@@ -1685,6 +2074,8 @@ static void primary_cb(uint8_t status, GSList *services, void *user_data)
 			hog_attach_hog(hog, primary);
 	}
 
+	hog_read_services(hog);
+
 remove:
 	remove_gatt_req(req, status);
 }
@@ -1697,6 +2088,7 @@ bool bt_hog_attach(struct bt_hog *hog, void *gatt)
 		return false;
 
 	hog->attrib = g_attrib_ref(gatt);
+	hog->client = bt_gatt_client_ref(g_attrib_get_client(gatt));
 
 	if (!hog->attr && !hog->primary) {
 		discover_primary(hog, hog->attrib, NULL, primary_cb, hog);
@@ -1707,9 +2099,11 @@ bool bt_hog_attach(struct bt_hog *hog, void *gatt)
 		bt_scpp_attach(hog->scpp, gatt);
 
 	if (hog->dis)
-		bt_dis_attach(hog->dis, gatt);
+		attach_dis(hog);
+
+	queue_foreach(hog->bas, attach_bas, hog);
 
-	queue_foreach(hog->bas, (void *) bt_bas_attach, gatt);
+	hog_read_services(hog);
 
 	for (l = hog->instances; l; l = l->next) {
 		struct bt_hog *instance = l->data;
@@ -1735,21 +2129,8 @@ bool bt_hog_attach(struct bt_hog *hog, void *gatt)
 	/* If UHID is already created, set up the report value handlers to
 	 * optimize reconnection.
 	 */
-	for (l = hog->reports; l; l = l->next) {
-		struct report *r = l->data;
-
-		if (r->notifyid)
-			continue;
-
-		r->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					r->value_handle,
-					report_value_cb, r,
-					report_notify_destroy);
-		if (!r->notifyid)
-			error("Unable to register report notification: "
-				"handle 0x%04x", r->value_handle);
-	}
+	for (l = hog->reports; l; l = l->next)
+		report_register_notify(hog, l->data);
 
 	/* Attempt to replay get/set report messages since the driver might not
 	 * be aware the device has been disconnected in the meantime.
@@ -1769,6 +2150,8 @@ void bt_hog_detach(struct bt_hog *hog, bool force)
 	if (!hog->attrib)
 		goto done;
 
+	hog_cancel_services_read(hog);
+
 	queue_foreach(hog->bas, (void *) bt_bas_detach, NULL);
 
 	for (l = hog->instances; l; l = l->next) {
@@ -1777,14 +2160,8 @@ void bt_hog_detach(struct bt_hog *hog, bool force)
 		bt_hog_detach(instance, force);
 	}
 
-	for (l = hog->reports; l; l = l->next) {
-		struct report *r = l->data;
-
-		if (r->notifyid > 0) {
-			g_attrib_unregister(hog->attrib, r->notifyid);
-			r->notifyid = 0;
-		}
-	}
+	for (l = hog->reports; l; l = l->next)
+		report_unregister_notify(hog, l->data);
 
 	if (hog->scpp)
 		bt_scpp_detach(hog->scpp);
@@ -1793,6 +2170,19 @@ void bt_hog_detach(struct bt_hog *hog, bool force)
 		bt_dis_detach(hog->dis);
 
 	queue_remove_all(hog->gatt_op, cancel_gatt_req, hog, destroy_gatt_req);
+
+	if (hog->getrep_att) {
+		cancel_report_req(hog, hog->getrep_att);
+		hog->getrep_att = 0;
+	}
+
+	if (hog->setrep_att) {
+		cancel_report_req(hog, hog->setrep_att);
+		hog->setrep_att = 0;
+	}
+
+	bt_gatt_client_unref(hog->client);
+	hog->client = NULL;
 	g_attrib_unref(hog->attrib);
 	hog->attrib = NULL;
 
@@ -1810,8 +2200,7 @@ int bt_hog_set_control_point(struct bt_hog *hog, bool suspend)
 	if (hog->ctrlpt_handle == 0)
 		return -ENOTSUP;
 
-	gatt_write_cmd(hog->attrib, hog->ctrlpt_handle, &value,
-					sizeof(value), NULL, NULL);
+	write_cmd(hog, hog->ctrlpt_handle, &value, sizeof(value));
 
 	return 0;
 }
@@ -1834,12 +2223,10 @@ int bt_hog_send_report(struct bt_hog *hog, void *data, size_t size, int type)
 	DBG("hog: Write report, handle 0x%X", report->value_handle);
 
 	if (report->properties & GATT_CHR_PROP_WRITE)
-		write_char(hog, hog->attrib, report->value_handle,
-				data, size, output_written_cb, hog);
+		write_output(hog, report->value_handle, data, size);
 
 	if (report->properties & GATT_CHR_PROP_WRITE_WITHOUT_RESP)
-		gatt_write_cmd(hog->attrib, report->value_handle,
-						data, size, NULL, NULL);
+		write_cmd(hog, report->value_handle, data, size);
 
 	for (l = hog->instances; l; l = l->next) {
 		struct bt_hog *instance = l->data;
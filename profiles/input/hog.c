@@ -21,6 +21,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include <glib.h>
 
@@ -33,10 +34,13 @@
 #include "src/device.h"
 #include "src/profile.h"
 #include "src/service.h"
+#include "src/storage.h"
+#include "src/textfile.h"
 #include "src/shared/util.h"
 #include "src/shared/uhid.h"
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
+#include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
 #include "src/plugin.h"
 
@@ -47,6 +51,9 @@
 #include "attrib/gatt.h"
 #include "hog-lib.h"
 
+#define HOG_REPORT_MAP_UUID	0x2A4B
+#define HOG_REPORT_MAP_MAX	512
+
 struct hog_device {
 	struct btd_device	*device;
 	struct bt_hog		*hog;
@@ -62,6 +69,165 @@ void input_set_auto_sec(bool state)
 	auto_sec = state;
 }
 
+static void report_map_read_value(struct gatt_db_attribute *attrib, int err,
+					const uint8_t *value, size_t length,
+					void *user_data)
+{
+	struct iovec *map = user_data;
+
+	if (err || !length)
+		return;
+
+	map->iov_base = (void *) value;
+	map->iov_len = length;
+}
+
+static void store_report_map(struct gatt_db_attribute *attr, void *user_data)
+{
+	GKeyFile *key_file = user_data;
+	struct iovec map = {};
+	const uint8_t *value;
+	char handle[5], *str;
+	size_t i;
+
+	gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
+					report_map_read_value, &map);
+	if (!map.iov_len)
+		return;
+
+	sprintf(handle, "%04hx", gatt_db_attribute_get_handle(attr));
+
+	value = map.iov_base;
+	str = g_malloc0(map.iov_len * 2 + 1);
+	for (i = 0; i < map.iov_len; i++)
+		sprintf(str + i * 2, "%02hhx", value[i]);
+
+	g_key_file_set_string(key_file, "ReportMap", handle, str);
+	g_free(str);
+}
+
+static void hog_cache_filename(struct btd_device *device, char *filename)
+{
+	char dst_addr[18];
+
+	ba2str(device_get_address(device), dst_addr);
+
+	create_filename(filename, PATH_MAX, "/%s/cache/%s",
+			btd_adapter_get_storage_dir(device_get_adapter(device)),
+			dst_addr);
+}
+
+/* Store the Report Maps read by hog-lib so the uHID device can be created
+ * right away after bluetoothd restarts, the Report References are kept
+ * along with the GATT cache.
+ */
+static void hog_store_cache(struct hog_device *dev)
+{
+	struct btd_device *device = dev->device;
+	char filename[PATH_MAX];
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+	bt_uuid_t uuid;
+	char *data;
+	gsize length = 0;
+
+	if (!device_is_bonded(device, btd_device_get_bdaddr_type(device)))
+		return;
+
+	hog_cache_filename(device, filename);
+
+	key_file = g_key_file_new();
+	if (!btd_storage_load(key_file, filename, &gerr))
+		g_clear_error(&gerr);
+
+	g_key_file_remove_group(key_file, "ReportMap", NULL);
+
+	bt_uuid16_create(&uuid, HOG_REPORT_MAP_UUID);
+	gatt_db_find_by_type(btd_device_get_gatt_db(device), 0x0001, 0xffff,
+					&uuid, store_report_map, key_file);
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	if (!btd_storage_save(filename, data, length, &gerr)) {
+		error("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+
+	g_free(data);
+	g_key_file_free(key_file);
+}
+
+static void load_report_map(struct gatt_db *db, GKeyFile *key_file,
+							const char *key)
+{
+	struct gatt_db_attribute *attr;
+	uint8_t value[HOG_REPORT_MAP_MAX];
+	struct iovec map = {};
+	bt_uuid_t uuid;
+	uint16_t handle;
+	size_t i, len;
+	char *str;
+
+	if (sscanf(key, "%04hx", &handle) != 1)
+		return;
+
+	attr = gatt_db_get_attribute(db, handle);
+	if (!attr)
+		return;
+
+	bt_uuid16_create(&uuid, HOG_REPORT_MAP_UUID);
+	if (bt_uuid_cmp(&uuid, gatt_db_attribute_get_type(attr)))
+		return;
+
+	/* Don't override a value read during this session */
+	gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
+					report_map_read_value, &map);
+	if (map.iov_len)
+		return;
+
+	str = g_key_file_get_string(key_file, "ReportMap", key, NULL);
+	if (!str)
+		return;
+
+	len = strlen(str);
+	if (!len || len % 2 || len / 2 > sizeof(value))
+		goto done;
+
+	for (i = 0; i < len; i += 2) {
+		if (sscanf(str + i, "%02hhx", &value[i / 2]) != 1)
+			goto done;
+	}
+
+	DBG("Report Map 0x%04x loaded from cache", handle);
+
+	gatt_db_attribute_write(attr, 0, value, len / 2, 0, NULL, NULL, NULL);
+
+done:
+	g_free(str);
+}
+
+static void hog_load_cache(struct hog_device *dev, struct gatt_db *db)
+{
+	char filename[PATH_MAX];
+	GKeyFile *key_file;
+	char **keys, **key;
+
+	hog_cache_filename(dev->device, filename);
+
+	key_file = g_key_file_new();
+	if (!btd_storage_load(key_file, filename, NULL)) {
+		g_key_file_free(key_file);
+		return;
+	}
+
+	keys = g_key_file_get_keys(key_file, "ReportMap", NULL, NULL);
+	for (key = keys; key && *key; key++)
+		load_report_map(db, key_file, *key);
+
+	g_strfreev(keys);
+	g_key_file_free(key_file);
+}
+
 static void hog_device_accept(struct hog_device *dev, struct gatt_db *db)
 {
 	char name[248];
@@ -83,6 +249,8 @@ static void hog_device_accept(struct hog_device *dev, struct gatt_db *db)
 	DBG("name=%s vendor=0x%X, product=0x%X, version=0x%X", name, vendor,
 							product, version);
 
+	hog_load_cache(dev, db);
+
 	dev->hog = bt_hog_new_default(name, vendor, product, version, type, db);
 }
 
@@ -208,6 +376,8 @@ static int hog_disconnect(struct btd_service *service)
 {
 	struct hog_device *dev = btd_service_get_user_data(service);
 
+	hog_store_cache(dev);
+
 	if (input_get_userspace_hid() == UHID_PERSIST)
 		bt_hog_detach(dev->hog, false);
 	else
@@ -17,12 +17,15 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <sys/param.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <net/if.h>
 #include <linux/sockios.h>
+#include <linux/ethtool.h>
 
 #include <glib.h>
 
@@ -43,6 +46,10 @@
 
 static int ctl;
 
+/* Interface options applied on setup, -1 keeps the kernel defaults */
+static int if_txqueuelen = -1;
+static int if_gro = -1;
+
 struct __service_16 {
 	uint16_t dst;
 	uint16_t src;
@@ -87,6 +94,12 @@ int bnep_cleanup(void)
 	return 0;
 }
 
+void bnep_set_if_options(int txqueuelen, int gro)
+{
+	if_txqueuelen = txqueuelen;
+	if_gro = gro;
+}
+
 static int bnep_conndel(const bdaddr_t *dst)
 {
 	struct bnep_conndel_req req;
@@ -137,6 +150,33 @@ static uint32_t bnep_getsuppfeat(void)
 	return feat;
 }
 
+static void bnep_if_set_options(int sk, const char *devname)
+{
+	struct ethtool_value ev;
+	struct ifreq ifr;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, devname, IF_NAMESIZE - 1);
+
+	if (if_txqueuelen >= 0) {
+		ifr.ifr_qlen = if_txqueuelen;
+
+		if (ioctl(sk, SIOCSIFTXQLEN, (void *) &ifr) < 0)
+			warn("bnep: Could not set %s queue length: %s(%d)",
+					devname, strerror(errno), errno);
+	}
+
+	if (if_gro >= 0) {
+		ev.cmd = ETHTOOL_SGRO;
+		ev.data = if_gro;
+		ifr.ifr_data = (void *) &ev;
+
+		if (ioctl(sk, SIOCETHTOOL, (void *) &ifr) < 0)
+			warn("bnep: Could not set %s GRO: %s(%d)",
+					devname, strerror(errno), errno);
+	}
+}
+
 static int bnep_if_up(const char *devname)
 {
 	struct ifreq ifr;
@@ -144,6 +184,8 @@ static int bnep_if_up(const char *devname)
 
 	sk = socket(AF_INET, SOCK_DGRAM, 0);
 
+	bnep_if_set_options(sk, devname);
+
 	memset(&ifr, 0, sizeof(ifr));
 	strncpy(ifr.ifr_name, devname, IF_NAMESIZE - 1);
 
@@ -161,6 +203,42 @@ static int bnep_if_up(const char *devname)
 	return err;
 }
 
+static uint64_t bnep_if_read_stat(const char *devname, const char *stat)
+{
+	char path[PATH_MAX];
+	unsigned long long val = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s",
+							devname, stat);
+
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+
+	if (fscanf(f, "%llu", &val) != 1)
+		val = 0;
+
+	fclose(f);
+
+	return val;
+}
+
+/* Logs the traffic of a connection before its interface goes away */
+static void bnep_if_log_stats(const char *devname, const bdaddr_t *addr)
+{
+	char str[18];
+
+	ba2str(addr, str);
+
+	info("bnep: %s (%s) rx %" PRIu64 " bytes %" PRIu64 " packets, "
+			"tx %" PRIu64 " bytes %" PRIu64 " packets", devname,
+			str, bnep_if_read_stat(devname, "rx_bytes"),
+			bnep_if_read_stat(devname, "rx_packets"),
+			bnep_if_read_stat(devname, "tx_bytes"),
+			bnep_if_read_stat(devname, "tx_packets"));
+}
+
 static int bnep_if_down(const char *devname)
 {
 	struct ifreq ifr;
@@ -424,6 +502,7 @@ void bnep_disconnect(struct bnep *session)
 		session->io = NULL;
 	}
 
+	bnep_if_log_stats(session->iface, &session->dst_addr);
 	bnep_if_down(session->iface);
 	bnep_conndel(&session->dst_addr);
 }
@@ -722,6 +801,7 @@ void bnep_server_delete(char *bridge, char *iface, const bdaddr_t *addr)
 	if (!bridge || !iface || !addr)
 		return;
 
+	bnep_if_log_stats(iface, addr);
 	bnep_del_from_bridge(iface, bridge);
 	bnep_if_down(iface);
 	bnep_conndel(addr);
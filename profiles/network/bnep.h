@@ -12,6 +12,7 @@ struct bnep;
 
 int bnep_init(void);
 int bnep_cleanup(void);
+void bnep_set_if_options(int txqueuelen, int gro);
 
 struct bnep *bnep_new(int sk, uint16_t local_role, uint16_t remote_role,
 								char *iface);
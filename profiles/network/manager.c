@@ -34,6 +34,8 @@
 #include "server.h"
 
 static gboolean conf_security = TRUE;
+static int conf_txqueuelen = -1;
+static int conf_gro = -1;
 
 static void read_config(const char *file)
 {
@@ -54,11 +56,33 @@ static void read_config(const char *file)
 		g_clear_error(&err);
 	}
 
+	if (g_key_file_has_key(keyfile, "General", "TxQueueLength", NULL)) {
+		conf_txqueuelen = g_key_file_get_integer(keyfile, "General",
+							"TxQueueLength", &err);
+		if (err) {
+			DBG("%s: %s", file, err->message);
+			g_clear_error(&err);
+			conf_txqueuelen = -1;
+		}
+	}
+
+	if (g_key_file_has_key(keyfile, "General", "GenericReceiveOffload",
+								NULL)) {
+		conf_gro = g_key_file_get_boolean(keyfile, "General",
+						"GenericReceiveOffload", &err);
+		if (err) {
+			DBG("%s: %s", file, err->message);
+			g_clear_error(&err);
+			conf_gro = -1;
+		}
+	}
+
 done:
 	g_key_file_free(keyfile);
 
-	DBG("Config options: Security=%s",
-				conf_security ? "true" : "false");
+	DBG("Config options: Security=%s TxQueueLength=%d GRO=%d",
+				conf_security ? "true" : "false",
+				conf_txqueuelen, conf_gro);
 }
 
 static int panu_server_probe(struct btd_profile *p, struct btd_adapter *adapter)
@@ -167,6 +191,8 @@ static int network_init(void)
 		return err;
 	}
 
+	bnep_set_if_options(conf_txqueuelen, conf_gro);
+
 	/*
 	 * There is one socket to handle the incoming connections. NAP,
 	 * GN and PANU servers share the same PSM. The initial BNEP message
@@ -22,9 +22,14 @@
 #include <stdbool.h>
 #include <sys/ioctl.h>
 #include <sys/file.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
 #include <dirent.h>
 #include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include <glib.h>
 #include <dbus/dbus.h>
@@ -48,6 +53,8 @@
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
 #include "src/shared/timeout.h"
+#include "src/shared/io.h"
+#include "src/shared/trace.h"
 
 #include "btio/btio.h"
 #include "btd.h"
@@ -87,6 +94,15 @@
 #define DISTANCE_VAL_INVALID	0x7FFF
 #define PATHLOSS_MAX		137
 
+#define PENDING_DEVICES_MAX	128
+
+#define LOAD_DEVICES_BATCH	16
+
+#define REPORTS_MTU		4096
+#define REPORTS_TIMEOUT		100	/* ms */
+
+#define MGMT_PIPELINE_WINDOW	8
+
 /*
  * These are known security keys that have been compromised.
  * If this grows or there are needs to be platform specific, it is
@@ -212,6 +228,8 @@ struct discovery_filter {
 	uint16_t pathloss;
 	int16_t rssi;
 	GSList *uuids;
+	uint128_t *uuid128;
+	size_t uuid_count;
 	bool duplicate;
 	bool discoverable;
 };
@@ -224,6 +242,41 @@ struct discovery_client {
 	struct discovery_filter *discovery_filter;
 };
 
+/* Stored device whose object is created after the keys are loaded */
+struct device_load {
+	char address[18];
+	bdaddr_t bdaddr;
+	GKeyFile *key_file;
+	bool rpa;
+	bool bonded;
+};
+
+/* Last report of an LE device not promoted to a device object yet */
+struct pending_device {
+	bdaddr_t bdaddr;
+	uint8_t bdaddr_type;
+	uint32_t flags;
+	uint8_t data_len;
+	uint8_t data[UINT8_MAX];
+};
+
+struct report_client {
+	struct btd_adapter *adapter;
+	char *owner;
+	guint watch;
+	struct io *io;
+};
+
+/* Record format of the AcquireReports stream */
+struct adapter_report {
+	bdaddr_t bdaddr;
+	uint8_t bdaddr_type;
+	int8_t rssi;
+	uint32_t flags;
+	uint8_t data_len;
+	uint8_t data[];
+} __packed;
+
 struct service_auth {
 	guint id;
 	unsigned int svc_id;
@@ -259,6 +312,7 @@ struct btd_adapter {
 
 	uint16_t dev_id;
 	struct mgmt *mgmt;
+	struct adapter_worker *worker;	/* device found reader thread */
 
 	bdaddr_t bdaddr;		/* controller Bluetooth address */
 	uint8_t bdaddr_type;		/* address type */
@@ -270,6 +324,7 @@ struct btd_adapter {
 	uint32_t pending_settings;	/* pending controller settings */
 	uint32_t power_state;		/* the power state */
 	uint32_t current_settings;	/* current controller settings */
+	uint64_t device_found_count;	/* advertising/inquiry reports */
 
 	char *path;			/* adapter object path */
 	uint16_t manufacturer;		/* adapter manufacturer */
@@ -311,7 +366,7 @@ struct btd_adapter {
 	GQueue *auths;			/* Ongoing and pending auths */
 	bool pincode_requested;		/* PIN requested during last bonding */
 	GSList *connections;		/* Connected devices */
-	GSList *devices;		/* Devices structure pointers */
+	struct queue *devices;		/* Devices structure pointers */
 	GSList *connect_list;		/* Devices to connect when found */
 	struct btd_device *connect_le;	/* LE device waiting to be connected */
 	sdp_list_t *services;		/* Services associated to adapter */
@@ -341,6 +396,18 @@ struct btd_adapter {
 
 	struct queue *exp_pending;
 	struct queue *exps;
+
+	struct queue *pending_devices;	/* Devices seen but not reported */
+
+	struct queue *load_queue;	/* Stored devices not created yet */
+	guint load_id;
+
+	struct queue *conn_params;	/* Parameters loaded into kernel */
+
+	struct queue *report_clients;	/* AcquireReports clients */
+	uint8_t *reports;		/* Batch of pending reports */
+	uint16_t reports_len;
+	unsigned int reports_timer;
 };
 
 static char *adapter_power_state_str(uint32_t power_state)
@@ -583,7 +650,7 @@ static void store_adapter_info(struct btd_adapter *adapter)
 	create_file(filename, 0600);
 
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -741,17 +808,18 @@ static void set_mode_complete(uint8_t status, uint16_t length,
 	new_settings_callback(adapter->dev_id, length, param, adapter);
 }
 
-static void remove_temporary_devices(struct btd_adapter *adapter)
+static void remove_temporary_device(void *data, void *user_data)
 {
-	GSList *l, *next;
+	struct btd_device *dev = data;
+	struct btd_adapter *adapter = user_data;
 
-	for (l = adapter->devices; l; l = next) {
-		struct btd_device *dev = l->data;
+	if (device_is_temporary(dev))
+		btd_adapter_remove_device(adapter, dev);
+}
 
-		next = g_slist_next(l);
-		if (device_is_temporary(dev))
-			btd_adapter_remove_device(adapter, dev);
-	}
+static void remove_temporary_devices(struct btd_adapter *adapter)
+{
+	queue_foreach(adapter->devices, remove_temporary_device, adapter);
 }
 
 static bool set_mode(struct btd_adapter *adapter, uint16_t opcode,
@@ -1005,6 +1073,32 @@ int adapter_set_name(struct btd_adapter *adapter, const char *name)
 	return set_name(adapter, name);
 }
 
+static unsigned int bdaddr_hash(const bdaddr_t *bdaddr)
+{
+	return bdaddr->b[0] | bdaddr->b[1] << 8 | bdaddr->b[2] << 16 |
+			(bdaddr->b[3] ^ bdaddr->b[4] ^ bdaddr->b[5]) << 24;
+}
+
+static unsigned int device_hash(const void *data)
+{
+	struct btd_device *device = (struct btd_device *) data;
+
+	return bdaddr_hash(device_get_address(device));
+}
+
+static bool device_addr_type_match(const void *data, const void *match_data)
+{
+	return !device_addr_type_cmp(data, match_data);
+}
+
+static bool device_bdaddr_match(const void *data, const void *match_data)
+{
+	return !device_bdaddr_cmp(data, match_data);
+}
+
+static bool load_device_now(struct btd_adapter *adapter,
+						const bdaddr_t *bdaddr);
+
 struct btd_device *btd_adapter_find_device(struct btd_adapter *adapter,
 							const bdaddr_t *dst,
 							uint8_t bdaddr_type)
@@ -1019,12 +1113,25 @@ struct btd_device *btd_adapter_find_device(struct btd_adapter *adapter,
 	bacpy(&addr.bdaddr, dst);
 	addr.bdaddr_type = bdaddr_type;
 
-	list = g_slist_find_custom(adapter->devices, &addr,
+	device = queue_find_hash(adapter->devices, bdaddr_hash(dst),
+					device_addr_type_match, &addr);
+	if (!device && load_device_now(adapter, dst))
+		device = queue_find_hash(adapter->devices, bdaddr_hash(dst),
+					device_addr_type_match, &addr);
+	if (!device) {
+		/*
+		 * The index is keyed by the current device address, so a
+		 * connected device whose identity got resolved can only be
+		 * matched by its connection address through a lookup of the
+		 * (short) list of connections.
+		 */
+		list = g_slist_find_custom(adapter->connections, &addr,
 							device_addr_type_cmp);
-	if (!list)
-		return NULL;
+		if (!list)
+			return NULL;
 
-	device = list->data;
+		device = list->data;
+	}
 
 	/*
 	 * If we're looking up based on public address and the address
@@ -1039,28 +1146,22 @@ struct btd_device *btd_adapter_find_device(struct btd_adapter *adapter,
 	return device;
 }
 
-static int device_path_cmp(gconstpointer a, gconstpointer b)
+static bool device_path_match(const void *data, const void *match_data)
 {
-	const struct btd_device *device = a;
-	const char *path = b;
+	const struct btd_device *device = data;
+	const char *path = match_data;
 	const char *dev_path = device_get_path(device);
 
-	return strcasecmp(dev_path, path);
+	return !strcasecmp(dev_path, path);
 }
 
 struct btd_device *btd_adapter_find_device_by_path(struct btd_adapter *adapter,
 						   const char *path)
 {
-	GSList *list;
-
 	if (!adapter)
 		return NULL;
 
-	list = g_slist_find_custom(adapter->devices, path, device_path_cmp);
-	if (!list)
-		return NULL;
-
-	return list->data;
+	return queue_find(adapter->devices, device_path_match, path);
 }
 
 static void uuid_to_uuid128(uuid_t *uuid128, const uuid_t *uuid)
@@ -1420,11 +1521,17 @@ static void service_auth_cancel(struct service_auth *auth)
 static void adapter_remove_device(struct btd_adapter *adapter,
 						struct btd_device *device);
 
+static void conn_param_remove(struct btd_adapter *adapter,
+				const bdaddr_t *bdaddr, uint8_t bdaddr_type);
+
 void btd_adapter_remove_device(struct btd_adapter *adapter,
 				struct btd_device *dev)
 {
 	adapter->connect_list = g_slist_remove(adapter->connect_list, dev);
 
+	conn_param_remove(adapter, device_get_address(dev),
+					btd_device_get_bdaddr_type(dev));
+
 	adapter_remove_device(adapter, dev);
 	btd_adv_monitor_device_remove(adapter->adv_monitor_manager, dev);
 
@@ -1685,6 +1792,7 @@ static void free_discovery_filter(struct discovery_filter *discovery_filter)
 		return;
 
 	g_slist_free_full(discovery_filter->uuids, free);
+	g_free(discovery_filter->uuid128);
 	free(discovery_filter->pattern);
 	g_free(discovery_filter);
 }
@@ -1697,10 +1805,18 @@ static void invalidate_rssi_and_tx_power(gpointer a)
 	device_set_tx_power(dev, 127);
 }
 
-static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
+static void remove_undiscoverable_device(void *data, void *user_data)
 {
-	GSList *l, *next;
+	struct btd_device *dev = data;
+	struct btd_adapter *adapter = user_data;
 
+	if (device_is_temporary(dev) && !device_is_connectable(dev)
+			&& !btd_device_is_connected(dev))
+		btd_adapter_remove_device(adapter, dev);
+}
+
+static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
+{
 	adapter->discovery_type = 0x00;
 
 	if (adapter->discovery_idle_timeout > 0) {
@@ -1712,18 +1828,9 @@ static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
 						invalidate_rssi_and_tx_power);
 	adapter->discovery_found = NULL;
 
-	if (!adapter->devices)
-		return;
-
-	for (l = adapter->devices; l != NULL; l = next) {
-		struct btd_device *dev = l->data;
-
-		next = g_slist_next(l);
+	queue_remove_all(adapter->pending_devices, NULL, NULL, free);
 
-		if (device_is_temporary(dev) && !device_is_connectable(dev)
-			&& !btd_device_is_connected(dev))
-			btd_adapter_remove_device(adapter, dev);
-	}
+	queue_foreach(adapter->devices, remove_undiscoverable_device, adapter);
 }
 
 static void discovery_free(void *user_data)
@@ -2583,6 +2690,11 @@ static bool parse_uuids(DBusMessageIter *value, struct discovery_filter *filter)
 
 		filter->uuids = g_slist_prepend(filter->uuids, strdup(uuidstr));
 
+		/* Binary copy used to match advertising data directly */
+		filter->uuid128 = g_renew(uint128_t, filter->uuid128,
+						filter->uuid_count + 1);
+		filter->uuid128[filter->uuid_count++] = u128.value.u128;
+
 		dbus_message_iter_next(&arriter);
 	}
 
@@ -2726,6 +2838,8 @@ static bool parse_discovery_filter_dict(struct btd_adapter *adapter,
 		return false;
 
 	(*filter)->uuids = NULL;
+	(*filter)->uuid128 = NULL;
+	(*filter)->uuid_count = 0;
 	(*filter)->pathloss = DISTANCE_VAL_INVALID;
 	(*filter)->rssi = DISTANCE_VAL_INVALID;
 	(*filter)->type = get_scan_type(adapter);
@@ -2787,6 +2901,7 @@ static bool parse_discovery_filter_dict(struct btd_adapter *adapter,
 
 invalid_args:
 	g_slist_free_full((*filter)->uuids, g_free);
+	g_free((*filter)->uuid128);
 	g_free(*filter);
 	*filter = NULL;
 	return false;
@@ -3592,21 +3707,18 @@ static DBusMessage *remove_device(DBusConnection *conn,
 	struct btd_adapter *adapter = user_data;
 	struct btd_device *device;
 	const char *path;
-	GSList *list;
 
 	if (dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
 						DBUS_TYPE_INVALID) == FALSE)
 		return btd_error_invalid_args(msg);
 
-	list = g_slist_find_custom(adapter->devices, path, device_path_cmp);
-	if (!list)
+	device = queue_find(adapter->devices, device_path_match, path);
+	if (!device)
 		return btd_error_does_not_exist(msg);
 
 	if (!btd_adapter_get_powered(adapter))
 		return btd_error_not_ready(msg);
 
-	device = list->data;
-
 	btd_device_set_temporary(device, true);
 
 	if (!btd_device_is_connected(device)) {
@@ -3819,6 +3931,339 @@ static DBusMessage *connect_device(DBusConnection *conn,
 	return NULL;
 }
 
+struct device_import {
+	bdaddr_t bdaddr;
+	uint8_t bdaddr_type;
+	GKeyFile *key_file;
+};
+
+static void device_import_free(void *data)
+{
+	struct device_import *import = data;
+
+	g_key_file_free(import->key_file);
+	free(import);
+}
+
+static bool parse_import_key(DBusMessageIter *value, uint8_t key[16])
+{
+	DBusMessageIter array;
+	uint8_t *val;
+	int len;
+
+	if (dbus_message_iter_get_arg_type(value) != DBUS_TYPE_ARRAY ||
+			dbus_message_iter_get_element_type(value) !=
+							DBUS_TYPE_BYTE)
+		return false;
+
+	dbus_message_iter_recurse(value, &array);
+	dbus_message_iter_get_fixed_array(&array, &val, &len);
+	if (len != 16)
+		return false;
+
+	memcpy(key, val, 16);
+
+	return true;
+}
+
+static void import_set_key(GKeyFile *key_file, const char *group,
+							const uint8_t key[16])
+{
+	char key_str[33];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(key_str + (i * 2), "%2.2X", key[i]);
+
+	g_key_file_set_string(key_file, group, "Key", key_str);
+}
+
+static struct device_import *parse_import_device(DBusMessageIter *iter)
+{
+	struct device_import *import;
+	DBusMessageIter subiter, dictiter, value;
+	uint8_t link_key[16], ltk[16], irk[16];
+	bool has_link_key = false, has_ltk = false, has_irk = false;
+	uint8_t link_key_type = 0, pin_len = 0;
+	uint8_t authenticated = 0, enc_size = 16;
+	uint16_t ediv = 0;
+	uint64_t rand = 0;
+	const char *name = NULL;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY ||
+	    dbus_message_iter_get_element_type(iter) != DBUS_TYPE_DICT_ENTRY)
+		return NULL;
+
+	import = new0(struct device_import, 1);
+	import->bdaddr_type = BDADDR_BREDR;
+	import->key_file = g_key_file_new();
+
+	dbus_message_iter_recurse(iter, &subiter);
+	while (dbus_message_iter_get_arg_type(&subiter) ==
+						DBUS_TYPE_DICT_ENTRY) {
+		const char *key;
+		const char *str;
+		int type;
+
+		dbus_message_iter_recurse(&subiter, &dictiter);
+		dbus_message_iter_get_basic(&dictiter, &key);
+		dbus_message_iter_next(&dictiter);
+		dbus_message_iter_recurse(&dictiter, &value);
+		type = dbus_message_iter_get_arg_type(&value);
+
+		if (!strcmp(key, "Address")) {
+			if (type != DBUS_TYPE_STRING)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &str);
+			if (str2ba(str, &import->bdaddr) < 0)
+				goto fail;
+		} else if (!strcmp(key, "AddressType")) {
+			if (type != DBUS_TYPE_STRING)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &str);
+			if (!strcmp(str, "public"))
+				import->bdaddr_type = BDADDR_LE_PUBLIC;
+			else if (!strcmp(str, "random"))
+				import->bdaddr_type = BDADDR_LE_RANDOM;
+			else
+				goto fail;
+		} else if (!strcmp(key, "Name")) {
+			if (type != DBUS_TYPE_STRING)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &name);
+		} else if (!strcmp(key, "LinkKey")) {
+			if (!parse_import_key(&value, link_key))
+				goto fail;
+
+			has_link_key = true;
+		} else if (!strcmp(key, "LinkKeyType")) {
+			if (type != DBUS_TYPE_BYTE)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &link_key_type);
+		} else if (!strcmp(key, "PINLength")) {
+			if (type != DBUS_TYPE_BYTE)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &pin_len);
+		} else if (!strcmp(key, "LongTermKey")) {
+			if (!parse_import_key(&value, ltk))
+				goto fail;
+
+			has_ltk = true;
+		} else if (!strcmp(key, "Authenticated")) {
+			if (type != DBUS_TYPE_BYTE)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &authenticated);
+		} else if (!strcmp(key, "EncSize")) {
+			if (type != DBUS_TYPE_BYTE)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &enc_size);
+		} else if (!strcmp(key, "EDiv")) {
+			if (type != DBUS_TYPE_UINT16)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &ediv);
+		} else if (!strcmp(key, "Rand")) {
+			if (type != DBUS_TYPE_UINT64)
+				goto fail;
+
+			dbus_message_iter_get_basic(&value, &rand);
+		} else if (!strcmp(key, "IdentityResolvingKey")) {
+			if (!parse_import_key(&value, irk))
+				goto fail;
+
+			has_irk = true;
+		} else {
+			goto fail;
+		}
+
+		dbus_message_iter_next(&subiter);
+	}
+
+	if (!bacmp(&import->bdaddr, BDADDR_ANY))
+		goto fail;
+
+	/* Keys of LE devices are only valid for identity addresses */
+	if (import->bdaddr_type == BDADDR_LE_RANDOM &&
+				(import->bdaddr.b[5] & 0xc0) != 0xc0)
+		goto fail;
+
+	if (import->bdaddr_type == BDADDR_BREDR) {
+		if (has_ltk || has_irk)
+			goto fail;
+
+		g_key_file_set_string(import->key_file, "General",
+					"SupportedTechnologies", "BR/EDR;");
+	} else {
+		if (has_link_key)
+			goto fail;
+
+		g_key_file_set_string(import->key_file, "General",
+					"SupportedTechnologies", "LE;");
+		g_key_file_set_string(import->key_file, "General",
+				"AddressType",
+				import->bdaddr_type == BDADDR_LE_PUBLIC ?
+							"public" : "static");
+	}
+
+	if (name)
+		g_key_file_set_string(import->key_file, "General", "Name",
+									name);
+
+	if (has_link_key) {
+		import_set_key(import->key_file, "LinkKey", link_key);
+		g_key_file_set_integer(import->key_file, "LinkKey", "Type",
+								link_key_type);
+		g_key_file_set_integer(import->key_file, "LinkKey",
+							"PINLength", pin_len);
+	}
+
+	if (has_ltk) {
+		import_set_key(import->key_file, "LongTermKey", ltk);
+		g_key_file_set_integer(import->key_file, "LongTermKey",
+					"Authenticated", authenticated);
+		g_key_file_set_integer(import->key_file, "LongTermKey",
+					"EncSize", enc_size);
+		g_key_file_set_integer(import->key_file, "LongTermKey",
+					"EDiv", ediv);
+		g_key_file_set_uint64(import->key_file, "LongTermKey",
+					"Rand", rand);
+	}
+
+	if (has_irk)
+		import_set_key(import->key_file, "IdentityResolvingKey", irk);
+
+	return import;
+
+fail:
+	device_import_free(import);
+	return NULL;
+}
+
+static void import_filename(struct btd_adapter *adapter,
+				struct device_import *import,
+				char *filename, size_t size)
+{
+	char addr[18];
+
+	ba2str(&import->bdaddr, addr);
+	create_filename(filename, size, "/%s/%s/info",
+				btd_adapter_get_storage_dir(adapter), addr);
+}
+
+static bool import_store(struct btd_adapter *adapter,
+					struct device_import *import)
+{
+	char filename[PATH_MAX];
+	GError *gerr = NULL;
+	gsize length = 0;
+	char *str;
+	bool ret;
+
+	import_filename(adapter, import, filename, sizeof(filename));
+	create_file(filename, 0600);
+
+	str = g_key_file_to_data(import->key_file, &length, NULL);
+	ret = btd_storage_save(filename, str, length, &gerr);
+	if (!ret) {
+		error("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+	g_free(str);
+
+	return ret;
+}
+
+static void import_unstore(void *data, void *user_data)
+{
+	struct device_import *import = data;
+	struct btd_adapter *adapter = user_data;
+	char filename[PATH_MAX];
+
+	import_filename(adapter, import, filename, sizeof(filename));
+	unlink(filename);
+}
+
+static void load_devices(struct btd_adapter *adapter);
+
+/*
+ * All records are validated before any of them is written, and the keys of
+ * every bonded device are then handed to the kernel with a single Load Link
+ * Keys, Load Long Term Keys and Load IRKs command each.
+ */
+static DBusMessage *import_devices(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	struct queue *imports;
+	const struct queue_entry *entry;
+	struct queue *stored;
+	DBusMessageIter iter, array;
+
+	DBG("sender %s", dbus_message_get_sender(msg));
+
+	dbus_message_iter_init(msg, &iter);
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+			dbus_message_iter_get_element_type(&iter) !=
+							DBUS_TYPE_ARRAY)
+		return btd_error_invalid_args(msg);
+
+	imports = queue_new();
+
+	dbus_message_iter_recurse(&iter, &array);
+	while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_ARRAY) {
+		struct device_import *import;
+
+		import = parse_import_device(&array);
+		if (!import) {
+			queue_destroy(imports, device_import_free);
+			return btd_error_invalid_args(msg);
+		}
+
+		queue_push_tail(imports, import);
+
+		if (btd_adapter_find_device(adapter, &import->bdaddr,
+							import->bdaddr_type)) {
+			queue_destroy(imports, device_import_free);
+			return btd_error_already_exists(msg);
+		}
+
+		dbus_message_iter_next(&array);
+	}
+
+	stored = queue_new();
+
+	for (entry = queue_get_entries(imports); entry; entry = entry->next) {
+		struct device_import *import = entry->data;
+
+		if (!import_store(adapter, import)) {
+			queue_foreach(stored, import_unstore, adapter);
+			queue_destroy(stored, NULL);
+			queue_destroy(imports, device_import_free);
+			return btd_error_failed(msg, "Unable to store devices");
+		}
+
+		queue_push_tail(stored, import);
+	}
+
+	DBG("hci%u imported %u devices", adapter->dev_id,
+						queue_length(imports));
+
+	queue_destroy(stored, NULL);
+	queue_destroy(imports, device_import_free);
+
+	load_devices(adapter);
+
+	return dbus_message_new_method_return(msg);
+}
+
 static void update_device_allowed_services(void *data, void *user_data)
 {
 	struct btd_device *device = data;
@@ -3881,7 +4326,7 @@ bool btd_adapter_set_allowed_uuids(struct btd_adapter *adapter,
 	}
 
 	queue_foreach(uuids, add_uuid_to_uuid_set, adapter->allowed_uuid_set);
-	g_slist_foreach(adapter->devices, update_device_allowed_services, NULL);
+	queue_foreach(adapter->devices, update_device_allowed_services, NULL);
 
 	return true;
 }
@@ -3904,6 +4349,168 @@ bool btd_adapter_is_uuid_allowed(struct btd_adapter *adapter,
 		g_hash_table_contains(adapter->allowed_uuid_set, &uuid);
 }
 
+static void reports_send(void *data, void *user_data)
+{
+	struct report_client *client = data;
+	struct btd_adapter *adapter = user_data;
+
+	/* Batches are dropped rather than queued for clients lagging behind */
+	if (send(io_get_fd(client->io), adapter->reports, adapter->reports_len,
+					MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		DBG("Unable to send reports to %s: %s", client->owner,
+							strerror(errno));
+}
+
+static void reports_flush(struct btd_adapter *adapter)
+{
+	if (!adapter->reports_len)
+		return;
+
+	queue_foreach(adapter->report_clients, reports_send, adapter);
+	adapter->reports_len = 0;
+}
+
+static bool reports_timeout(gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+
+	adapter->reports_timer = 0;
+	reports_flush(adapter);
+
+	return false;
+}
+
+static void adapter_report(struct btd_adapter *adapter,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type, int8_t rssi,
+					uint32_t flags,
+					const uint8_t *data, uint8_t data_len)
+{
+	struct adapter_report *rp;
+	size_t len = sizeof(*rp) + data_len;
+
+	if (queue_isempty(adapter->report_clients))
+		return;
+
+	if (adapter->reports_len + len > REPORTS_MTU)
+		reports_flush(adapter);
+
+	rp = (void *) adapter->reports + adapter->reports_len;
+	bacpy(&rp->bdaddr, bdaddr);
+	rp->bdaddr_type = bdaddr_type;
+	rp->rssi = rssi;
+	rp->flags = cpu_to_le32(flags);
+	rp->data_len = data_len;
+	if (data_len)
+		memcpy(rp->data, data, data_len);
+
+	adapter->reports_len += len;
+
+	if (!adapter->reports_timer)
+		adapter->reports_timer = timeout_add(REPORTS_TIMEOUT,
+							reports_timeout,
+							adapter, NULL);
+}
+
+static void reports_stop(struct btd_adapter *adapter)
+{
+	if (adapter->reports_timer) {
+		timeout_remove(adapter->reports_timer);
+		adapter->reports_timer = 0;
+	}
+
+	free(adapter->reports);
+	adapter->reports = NULL;
+	adapter->reports_len = 0;
+}
+
+static void report_client_free(void *data)
+{
+	struct report_client *client = data;
+
+	if (client->watch)
+		g_dbus_remove_watch(dbus_conn, client->watch);
+
+	io_destroy(client->io);
+	g_free(client->owner);
+	free(client);
+}
+
+static void report_client_remove(struct report_client *client)
+{
+	struct btd_adapter *adapter = client->adapter;
+
+	DBG("owner %s", client->owner);
+
+	queue_remove(adapter->report_clients, client);
+	report_client_free(client);
+
+	if (queue_isempty(adapter->report_clients))
+		reports_stop(adapter);
+}
+
+static void report_client_disconnect(DBusConnection *conn, void *user_data)
+{
+	struct report_client *client = user_data;
+
+	client->watch = 0;
+	report_client_remove(client);
+}
+
+static bool report_client_hup(struct io *io, void *user_data)
+{
+	report_client_remove(user_data);
+
+	return false;
+}
+
+static DBusMessage *acquire_reports(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	struct report_client *client;
+	uint16_t mtu = REPORTS_MTU;
+	DBusMessage *reply;
+	int fds[2];
+
+	if (socketpair(AF_LOCAL, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+								0, fds) < 0)
+		return btd_error_failed(msg, strerror(errno));
+
+	client = new0(struct report_client, 1);
+	client->io = io_new(fds[0]);
+	if (!client->io) {
+		close(fds[0]);
+		close(fds[1]);
+		free(client);
+		return btd_error_failed(msg, strerror(EIO));
+	}
+
+	io_set_close_on_destroy(client->io, true);
+	io_set_disconnect_handler(client->io, report_client_hup, client, NULL);
+
+	client->adapter = adapter;
+	client->owner = g_strdup(dbus_message_get_sender(msg));
+	client->watch = g_dbus_add_disconnect_watch(dbus_conn, client->owner,
+						report_client_disconnect,
+						client, NULL);
+
+	if (!adapter->reports)
+		adapter->reports = malloc(REPORTS_MTU);
+
+	queue_push_tail(adapter->report_clients, client);
+
+	DBG("owner %s", client->owner);
+
+	reply = g_dbus_create_reply(msg, DBUS_TYPE_UNIX_FD, &fds[1],
+					DBUS_TYPE_UINT16, &mtu,
+					DBUS_TYPE_INVALID);
+
+	close(fds[1]);
+
+	return reply;
+}
+
 static const GDBusMethodTable adapter_methods[] = {
 	{ GDBUS_ASYNC_METHOD("StartDiscovery", NULL, NULL, start_discovery) },
 	{ GDBUS_METHOD("SetDiscoveryFilter",
@@ -3918,6 +4525,12 @@ static const GDBusMethodTable adapter_methods[] = {
 	{ GDBUS_EXPERIMENTAL_ASYNC_METHOD("ConnectDevice",
 				GDBUS_ARGS({ "properties", "a{sv}" }), NULL,
 				connect_device) },
+	{ GDBUS_EXPERIMENTAL_METHOD("AcquireReports", NULL,
+				GDBUS_ARGS({ "fd", "h" }, { "mtu", "q" }),
+				acquire_reports) },
+	{ GDBUS_EXPERIMENTAL_METHOD("ImportDevices",
+				GDBUS_ARGS({ "devices", "aa{sv}" }), NULL,
+				import_devices) },
 	{ }
 };
 
@@ -4227,7 +4840,7 @@ static int generate_and_write_irk(uint8_t *irk, GKeyFile *key_file,
 								str_irk_out);
 	create_file(filename, S_IRUSR | S_IWUSR);
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -4249,7 +4862,7 @@ static int load_irk(struct btd_adapter *adapter, uint8_t *irk)
 					btd_adapter_get_storage_dir(adapter));
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -4583,12 +5196,58 @@ static void load_conn_params_complete(uint8_t status, uint16_t length,
 		btd_error(adapter->dev_id,
 			"hci%u Load Connection Parameters failed: %s (0x%02x)",
 				adapter->dev_id, mgmt_errstr(status), status);
+		/* Kernel state is unknown now so resend on next update */
+		queue_remove_all(adapter->conn_params, NULL, NULL, free);
 		return;
 	}
 
 	DBG("Connection Parameters loaded for hci%u", adapter->dev_id);
 }
 
+static bool match_conn_param(const void *a, const void *b)
+{
+	const struct conn_param *param = a;
+	const struct conn_param *match = b;
+
+	return param->bdaddr_type == match->bdaddr_type &&
+				!bacmp(&param->bdaddr, &match->bdaddr);
+}
+
+/* Returns false if the kernel already has the same parameters */
+static bool conn_param_update(struct btd_adapter *adapter,
+					const struct conn_param *info)
+{
+	struct conn_param *param;
+
+	param = queue_find(adapter->conn_params, match_conn_param, info);
+	if (param) {
+		if (param->min_interval == info->min_interval &&
+				param->max_interval == info->max_interval &&
+				param->latency == info->latency &&
+				param->timeout == info->timeout)
+			return false;
+	} else {
+		param = new0(struct conn_param, 1);
+		queue_push_tail(adapter->conn_params, param);
+	}
+
+	memcpy(param, info, sizeof(*param));
+
+	return true;
+}
+
+static void conn_param_remove(struct btd_adapter *adapter,
+				const bdaddr_t *bdaddr, uint8_t bdaddr_type)
+{
+	struct conn_param match;
+
+	memset(&match, 0, sizeof(match));
+	bacpy(&match.bdaddr, bdaddr);
+	match.bdaddr_type = bdaddr_type;
+
+	free(queue_remove_if(adapter->conn_params, match_conn_param, &match));
+}
+
 static void load_conn_params(struct btd_adapter *adapter, GSList *params)
 {
 	struct mgmt_cp_load_conn_param *cp;
@@ -4652,6 +5311,7 @@ void btd_adapter_load_conn_param(struct btd_adapter *adapter,
 	if (MGMT_VERSION(mgmt_version, mgmt_revision) < MGMT_VERSION(1, 23))
 		return;
 
+	memset(&param, 0, sizeof(param));
 	bacpy(&param.bdaddr, peer);
 	param.bdaddr_type = bdaddr_type;
 	param.max_interval = max_interval;
@@ -4659,11 +5319,60 @@ void btd_adapter_load_conn_param(struct btd_adapter *adapter,
 	param.latency = latency;
 	param.timeout = timeout;
 
+	if (!conn_param_update(adapter, &param)) {
+		DBG("hci%u conn params unchanged", adapter->dev_id);
+		return;
+	}
+
 	params = g_slist_append(params, &param);
 	load_conn_params(adapter, params);
 	g_slist_free(params);
 }
 
+bool btd_adapter_get_conn_param(struct btd_adapter *adapter,
+				const bdaddr_t *peer, uint8_t bdaddr_type,
+				uint16_t *min_interval, uint16_t *max_interval,
+				uint16_t *latency, uint16_t *timeout)
+{
+	struct conn_param match, *param;
+	char filename[PATH_MAX];
+	char device_addr[18];
+	GKeyFile *key_file;
+
+	memset(&match, 0, sizeof(match));
+	bacpy(&match.bdaddr, peer);
+	match.bdaddr_type = bdaddr_type;
+
+	/* Parameters loaded at runtime take precedence over the stored ones */
+	param = queue_find(adapter->conn_params, match_conn_param, &match);
+	if (param)
+		goto done;
+
+	ba2str(peer, device_addr);
+	create_filename(filename, PATH_MAX, "/%s/%s/info",
+			btd_adapter_get_storage_dir(adapter), device_addr);
+
+	key_file = g_key_file_new();
+	btd_storage_load(key_file, filename, NULL);
+	param = get_conn_param(key_file, device_addr, bdaddr_type);
+	g_key_file_free(key_file);
+
+	if (!param)
+		return false;
+
+	memcpy(&match, param, sizeof(match));
+	g_free(param);
+	param = &match;
+
+done:
+	*min_interval = param->min_interval;
+	*max_interval = param->max_interval;
+	*latency = param->latency;
+	*timeout = param->timeout;
+
+	return true;
+}
+
 static uint8_t get_addr_type(GKeyFile *keyfile)
 {
 	uint8_t addr_type;
@@ -4932,6 +5641,119 @@ done:
 	mgmt_tlv_list_free(list);
 }
 
+static void device_load_free(void *data)
+{
+	struct device_load *load = data;
+
+	g_key_file_free(load->key_file);
+	free(load);
+}
+
+static void load_device(struct btd_adapter *adapter, struct device_load *load)
+{
+	struct btd_device *device;
+	bool created = false;
+
+	device = queue_find_hash(adapter->devices, bdaddr_hash(&load->bdaddr),
+					device_bdaddr_match, &load->bdaddr);
+	if (!device) {
+		device = device_create_from_storage(adapter, load->address,
+							load->key_file);
+		if (!device)
+			return;
+
+		if (load->rpa)
+			device_set_rpa(device, true);
+
+		btd_device_set_temporary(device, false);
+		adapter_add_device(adapter, device);
+
+		/* TODO: register services from pre-loaded list of primaries */
+
+		created = true;
+	}
+
+	if (load->bonded) {
+		device_set_paired(device, BDADDR_BREDR);
+		device_set_bonded(device, BDADDR_BREDR);
+	}
+
+	if (created)
+		probe_devices(device);
+}
+
+static void load_devices_complete(struct btd_adapter *adapter)
+{
+	DBG("hci%u", adapter->dev_id);
+
+	/* restore Service Changed CCC value for bonded devices */
+	btd_gatt_database_restore_svc_chng_ccc(adapter->database);
+}
+
+static gboolean load_devices_idle(gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	struct device_load *load;
+	int i;
+
+	for (i = 0; i < LOAD_DEVICES_BATCH; i++) {
+		load = queue_pop_head(adapter->load_queue);
+		if (!load)
+			break;
+
+		load_device(adapter, load);
+		device_load_free(load);
+	}
+
+	if (!queue_isempty(adapter->load_queue))
+		return TRUE;
+
+	adapter->load_id = 0;
+	load_devices_complete(adapter);
+
+	return FALSE;
+}
+
+static bool device_load_match(const void *data, const void *match_data)
+{
+	const struct device_load *load = data;
+
+	return !bacmp(&load->bdaddr, match_data);
+}
+
+/* Create a stored device right away if it is looked up while loading */
+static bool load_device_now(struct btd_adapter *adapter,
+						const bdaddr_t *bdaddr)
+{
+	struct device_load *load;
+
+	load = queue_remove_if(adapter->load_queue, device_load_match,
+							(void *) bdaddr);
+	if (!load)
+		return false;
+
+	load_device(adapter, load);
+	device_load_free(load);
+
+	return true;
+}
+
+static void load_devices_cancel(struct btd_adapter *adapter)
+{
+	if (adapter->load_id) {
+		g_source_remove(adapter->load_id);
+		adapter->load_id = 0;
+	}
+
+	queue_remove_all(adapter->load_queue, NULL, NULL, device_load_free);
+}
+
+/*
+ * Only the keys and connection parameters are needed before the adapter can
+ * be used, so those are handed to the kernel first. The device objects and
+ * their profiles are then created from the main loop a few at a time, or on
+ * the first lookup of a device.
+ */
 static void load_devices(struct btd_adapter *adapter)
 {
 	char dirname[PATH_MAX];
@@ -4939,7 +5761,7 @@ static void load_devices(struct btd_adapter *adapter)
 	GSList *ltks = NULL;
 	GSList *irks = NULL;
 	GSList *params = NULL;
-	GSList *added_devices = NULL;
+	GSList *l;
 	GError *gerr = NULL;
 	DIR *dir;
 	struct dirent *entry;
@@ -4952,20 +5774,21 @@ static void load_devices(struct btd_adapter *adapter)
 		btd_error(adapter->dev_id,
 				"Unable to open adapter storage directory: %s",
 								dirname);
+		load_devices_complete(adapter);
 		return;
 	}
 
 	while ((entry = readdir(dir)) != NULL) {
-		struct btd_device *device;
+		struct device_load *load;
 		char filename[PATH_MAX];
 		GKeyFile *key_file;
 		struct link_key_info *key_info;
 		struct smp_ltk_info *ltk_info;
 		struct smp_ltk_info *peripheral_ltk_info;
-		GSList *list;
 		struct irk_info *irk_info;
 		struct conn_param *param;
 		uint8_t bdaddr_type;
+		bdaddr_t bdaddr;
 
 		if (entry->d_type == DT_UNKNOWN)
 			entry->d_type = util_get_dt(dirname, entry->d_name);
@@ -4978,7 +5801,7 @@ static void load_devices(struct btd_adapter *adapter)
 					entry->d_name);
 
 		key_file = g_key_file_new();
-		if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+		if (!btd_storage_load(key_file, filename, &gerr)) {
 			error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 			g_clear_error(&gerr);
@@ -5022,7 +5845,8 @@ static void load_devices(struct btd_adapter *adapter)
 				irk_info = NULL;
 			}
 
-			goto free;
+			g_key_file_free(key_file);
+			continue;
 		}
 
 		if (key_info)
@@ -5041,36 +5865,25 @@ static void load_devices(struct btd_adapter *adapter)
 		if (param)
 			params = g_slist_append(params, param);
 
-		list = g_slist_find_custom(adapter->devices, entry->d_name,
-							device_address_cmp);
-		if (list) {
-			device = list->data;
-			goto device_exist;
+		/* When reloading only the keys of known devices are needed */
+		str2ba(entry->d_name, &bdaddr);
+		if (queue_find_hash(adapter->devices, bdaddr_hash(&bdaddr),
+					device_bdaddr_match, &bdaddr) ||
+				queue_find(adapter->load_queue,
+					device_load_match, &bdaddr)) {
+			g_key_file_free(key_file);
+			continue;
 		}
 
-		device = device_create_from_storage(adapter, entry->d_name,
-							key_file);
-		if (!device)
-			goto free;
-
-		if (irk_info)
-			device_set_rpa(device, true);
-
-		btd_device_set_temporary(device, false);
-		adapter_add_device(adapter, device);
-
-		/* TODO: register services from pre-loaded list of primaries */
-
-		added_devices = g_slist_append(added_devices, device);
-
-device_exist:
-		if (key_info) {
-			device_set_paired(device, BDADDR_BREDR);
-			device_set_bonded(device, BDADDR_BREDR);
-		}
+		load = new0(struct device_load, 1);
+		strncpy(load->address, entry->d_name,
+						sizeof(load->address) - 1);
+		bacpy(&load->bdaddr, &bdaddr);
+		load->key_file = key_file;
+		load->rpa = irk_info != NULL;
+		load->bonded = key_info != NULL;
 
-free:
-		g_key_file_free(key_file);
+		queue_push_tail(adapter->load_queue, load);
 	}
 
 	closedir(dir);
@@ -5082,10 +5895,20 @@ free:
 	g_slist_free_full(ltks, g_free);
 	load_irks(adapter, irks);
 	g_slist_free_full(irks, g_free);
+	queue_remove_all(adapter->conn_params, NULL, NULL, free);
+	for (l = params; l; l = g_slist_next(l))
+		conn_param_update(adapter, l->data);
+
 	load_conn_params(adapter, params);
 	g_slist_free_full(params, g_free);
 
-	g_slist_free_full(added_devices, probe_devices);
+	if (queue_isempty(adapter->load_queue)) {
+		load_devices_complete(adapter);
+		return;
+	}
+
+	if (!adapter->load_id)
+		adapter->load_id = g_idle_add(load_devices_idle, adapter);
 }
 
 int btd_adapter_block_address(struct btd_adapter *adapter,
@@ -5188,7 +6011,7 @@ void adapter_add_profile(struct btd_adapter *adapter, gpointer p)
 
 	probe_profile(profile, adapter);
 
-	g_slist_foreach(adapter->devices, device_probe_profile, profile);
+	queue_foreach(adapter->devices, device_probe_profile, profile);
 }
 
 void adapter_remove_profile(struct btd_adapter *adapter, gpointer p)
@@ -5199,7 +6022,7 @@ void adapter_remove_profile(struct btd_adapter *adapter, gpointer p)
 		return;
 
 	if (profile->device_remove)
-		g_slist_foreach(adapter->devices, device_remove_profile, p);
+		queue_foreach(adapter->devices, device_remove_profile, p);
 
 	adapter->profiles = g_slist_remove(adapter->profiles, profile);
 
@@ -5252,14 +6075,14 @@ void device_resolved_drivers(struct btd_adapter *adapter,
 static void adapter_add_device(struct btd_adapter *adapter,
 						struct btd_device *device)
 {
-	adapter->devices = g_slist_prepend(adapter->devices, device);
+	queue_push_head(adapter->devices, device);
 	device_added_drivers(adapter, device);
 }
 
 static void adapter_remove_device(struct btd_adapter *adapter,
 						struct btd_device *device)
 {
-	adapter->devices = g_slist_remove(adapter->devices, device);
+	queue_remove(adapter->devices, device);
 	device_removed_drivers(adapter, device);
 }
 
@@ -5830,21 +6653,21 @@ static void adapter_start(struct btd_adapter *adapter)
 	trigger_passive_scanning(adapter);
 }
 
-static void reply_pending_requests(struct btd_adapter *adapter)
+static void reply_pending_bonding(void *data, void *user_data)
 {
-	GSList *l;
+	struct btd_device *device = data;
 
+	if (device_is_bonding(device, NULL))
+		device_bonding_failed(device, HCI_OE_USER_ENDED_CONNECTION);
+}
+
+static void reply_pending_requests(struct btd_adapter *adapter)
+{
 	if (!adapter)
 		return;
 
 	/* pending bonding */
-	for (l = adapter->devices; l; l = l->next) {
-		struct btd_device *device = l->data;
-
-		if (device_is_bonding(device, NULL))
-			device_bonding_failed(device,
-						HCI_OE_USER_ENDED_CONNECTION);
-	}
+	queue_foreach(adapter->devices, reply_pending_bonding, NULL);
 }
 
 static void remove_driver(gpointer data, gpointer user_data)
@@ -5897,9 +6720,179 @@ static void cancel_exp_pending(void *data)
 	struct exp_pending *pending = data;
 	struct btd_adapter *adapter = pending->adapter;
 
-	pending->adapter = NULL;
-	mgmt_cancel(adapter->mgmt, pending->id);
-	g_free(pending);
+	pending->adapter = NULL;
+	mgmt_cancel(adapter->mgmt, pending->id);
+	g_free(pending);
+}
+
+/*
+ * With AdapterThreads enabled each adapter opens its own control channel
+ * socket and a thread reads it, forwarding only the device found events of
+ * that adapter through a socket pair.  The main thread receives them with
+ * a separate struct mgmt, so report bursts of one adapter are read off the
+ * main loop and dispatched in batches next to the other adapters' events.
+ * Everything besides the socket reads still runs on the main thread.
+ */
+#define WORKER_BUF_SIZE		1024
+#define WORKER_BATCH		32
+
+struct adapter_worker {
+	uint16_t index;
+	int hci_fd;
+	int pair_fd;
+	int stop_fd;
+	pthread_t thread;
+	unsigned int drops;
+	struct mgmt *mgmt;
+};
+
+static void *adapter_worker_thread(void *user_data)
+{
+	struct adapter_worker *worker = user_data;
+	uint8_t buf[WORKER_BUF_SIZE];
+	struct pollfd fds[2];
+
+	fds[0].fd = worker->hci_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = worker->stop_fd;
+	fds[1].events = POLLIN;
+
+	while (1) {
+		const struct mgmt_hdr *hdr = (void *) buf;
+		ssize_t len;
+
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[1].revents || fds[0].revents & (POLLERR | POLLHUP))
+			break;
+
+		len = recv(worker->hci_fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (len < MGMT_HDR_SIZE || btohs(hdr->index) != worker->index)
+			continue;
+
+		if (btohs(hdr->opcode) != MGMT_EV_DEVICE_FOUND)
+			continue;
+
+		/* Reports are dropped rather than blocking the reader */
+		if (send(worker->pair_fd, buf, len, MSG_DONTWAIT) < 0)
+			__atomic_add_fetch(&worker->drops, 1, __ATOMIC_SEQ_CST);
+	}
+
+	return NULL;
+}
+
+static void adapter_worker_free(struct adapter_worker *worker)
+{
+	uint64_t event = 1;
+	unsigned int drops;
+
+	if (!worker)
+		return;
+
+	if (write(worker->stop_fd, &event, sizeof(event)) == sizeof(event))
+		pthread_join(worker->thread, NULL);
+
+	drops = __atomic_load_n(&worker->drops, __ATOMIC_SEQ_CST);
+	if (drops)
+		DBG("hci%u worker dropped %u reports", worker->index, drops);
+
+	mgmt_unref(worker->mgmt);
+	close(worker->pair_fd);
+	close(worker->stop_fd);
+	close(worker->hci_fd);
+	free(worker);
+}
+
+static int adapter_worker_socket(void)
+{
+	struct sockaddr_hci addr;
+	int fd;
+
+	fd = socket(PF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
+	if (fd < 0)
+		return -errno;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.hci_family = AF_BLUETOOTH;
+	addr.hci_dev = HCI_DEV_NONE;
+	addr.hci_channel = HCI_CHANNEL_CONTROL;
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		int err = -errno;
+
+		close(fd);
+		return err;
+	}
+
+	return fd;
+}
+
+static struct adapter_worker *adapter_worker_new(uint16_t index)
+{
+	struct adapter_worker *worker;
+	sigset_t mask, old;
+	int sv[2], err;
+
+	worker = new0(struct adapter_worker, 1);
+	worker->index = index;
+	worker->pair_fd = -1;
+	worker->stop_fd = -1;
+
+	worker->hci_fd = adapter_worker_socket();
+	if (worker->hci_fd < 0) {
+		free(worker);
+		return NULL;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+		goto failed;
+
+	worker->pair_fd = sv[0];
+
+	worker->mgmt = mgmt_new(sv[1]);
+	if (!worker->mgmt) {
+		close(sv[1]);
+		goto failed;
+	}
+
+	mgmt_set_close_on_unref(worker->mgmt, true);
+	mgmt_set_read_batch(worker->mgmt, WORKER_BATCH);
+
+	worker->stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (worker->stop_fd < 0)
+		goto failed;
+
+	/* Signals are handled by the main loop, not the worker */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &old);
+	err = pthread_create(&worker->thread, NULL, adapter_worker_thread,
+								worker);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (!err)
+		return worker;
+
+	close(worker->stop_fd);
+	worker->stop_fd = -1;
+
+failed:
+	mgmt_unref(worker->mgmt);
+	if (worker->pair_fd >= 0)
+		close(worker->pair_fd);
+	close(worker->hci_fd);
+	free(worker);
+
+	return NULL;
 }
 
 static void adapter_free(gpointer user_data)
@@ -5929,6 +6922,11 @@ static void adapter_free(gpointer user_data)
 	g_queue_foreach(adapter->auths, free_service_auth, NULL);
 	g_queue_free(adapter->auths);
 	queue_destroy(adapter->exps, NULL);
+	queue_destroy(adapter->devices, NULL);
+	queue_destroy(adapter->report_clients, NULL);
+	queue_destroy(adapter->pending_devices, free);
+	queue_destroy(adapter->load_queue, device_load_free);
+	queue_destroy(adapter->conn_params, free);
 
 	queue_destroy(adapter->exp_pending, cancel_exp_pending);
 
@@ -5949,6 +6947,8 @@ static void adapter_free(gpointer user_data)
 
 	mgmt_unref(adapter->mgmt);
 
+	adapter_worker_free(adapter->worker);
+
 	sdp_list_free(adapter->services, NULL);
 
 	g_slist_free(adapter->connections);
@@ -5988,6 +6988,8 @@ void btd_adapter_unref(struct btd_adapter *adapter)
 
 	DBG("Freeing adapter %s", adapter->path);
 
+	g_dbus_unregister_interface(dbus_conn, adapter->path,
+						STATISTICS_INTERFACE);
 	g_dbus_unregister_interface(dbus_conn, adapter->path,
 						ADAPTER_INTERFACE);
 }
@@ -6012,7 +7014,7 @@ static void convert_names_entry(char *key, char *value, void *user_data)
 	create_file(filename, 0600);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6020,7 +7022,7 @@ static void convert_names_entry(char *key, char *value, void *user_data)
 	g_key_file_set_string(key_file, "General", "Name", value);
 
 	data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, data, length, &gerr)) {
+	if (!btd_storage_save(filename, data, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -6245,7 +7247,7 @@ static void convert_entry(char *key, char *value, void *user_data)
 			converter->address, key);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6258,7 +7260,7 @@ static void convert_entry(char *key, char *value, void *user_data)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -6351,7 +7353,7 @@ static void store_sdp_record(char *local, char *peer, int handle, char *value)
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6363,7 +7365,7 @@ static void store_sdp_record(char *local, char *peer, int handle, char *value)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -6435,7 +7437,7 @@ static void convert_sdp_entry(char *key, char *value, void *user_data)
 								dst_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6446,7 +7448,7 @@ static void convert_sdp_entry(char *key, char *value, void *user_data)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -6495,7 +7497,7 @@ static void convert_primaries_entry(char *key, char *value, void *user_data)
 	create_filename(filename, PATH_MAX, "/%s/%s/attributes", address, key);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6520,7 +7522,7 @@ static void convert_primaries_entry(char *key, char *value, void *user_data)
 		goto end;
 
 	create_file(filename, 0600);
-	if (!g_file_set_contents(filename, data, length, &gerr)) {
+	if (!btd_storage_save(filename, data, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6535,7 +7537,7 @@ static void convert_primaries_entry(char *key, char *value, void *user_data)
 	create_filename(filename, PATH_MAX, "/%s/%s/info", address, key);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6545,7 +7547,7 @@ static void convert_primaries_entry(char *key, char *value, void *user_data)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -6591,7 +7593,7 @@ static void convert_ccc_entry(char *key, char *value, void *user_data)
 	create_filename(filename, PATH_MAX, "/%s/%s/ccc", src_addr, dst_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6603,7 +7605,7 @@ static void convert_ccc_entry(char *key, char *value, void *user_data)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -6647,7 +7649,7 @@ static void convert_gatt_entry(char *key, char *value, void *user_data)
 	create_filename(filename, PATH_MAX, "/%s/%s/gatt", src_addr, dst_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6659,7 +7661,7 @@ static void convert_gatt_entry(char *key, char *value, void *user_data)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -6702,7 +7704,7 @@ static void convert_proximity_entry(char *key, char *value, void *user_data)
 	create_filename(filename, PATH_MAX, "/%s/%s/proximity", src_addr, key);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6713,7 +7715,7 @@ static void convert_proximity_entry(char *key, char *value, void *user_data)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -6818,7 +7820,7 @@ static void convert_config(struct btd_adapter *adapter, const char *filename,
 	create_file(filename, 0600);
 
 	data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, data, length, &gerr)) {
+	if (!btd_storage_save(filename, data, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -6907,7 +7909,7 @@ static void load_config(struct btd_adapter *adapter)
 		convert_device_storage(adapter);
 	}
 
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6999,13 +8001,28 @@ static struct btd_adapter *btd_adapter_new(uint16_t index)
 	adapter->auths = g_queue_new();
 	adapter->exps = queue_new();
 	adapter->exp_pending = queue_new();
+	adapter->report_clients = queue_new();
+	adapter->pending_devices = queue_new();
+	adapter->load_queue = queue_new();
+	adapter->conn_params = queue_new();
+
+	adapter->devices = queue_new();
+	queue_set_hash(adapter->devices, device_hash);
 
 	return btd_adapter_ref(adapter);
 }
 
+static void remove_device_and_drivers(void *data, void *user_data)
+{
+	struct btd_device *device = data;
+	struct btd_adapter *adapter = user_data;
+
+	device_removed_drivers(adapter, device);
+	device_remove(device, FALSE);
+}
+
 static void adapter_remove(struct btd_adapter *adapter)
 {
-	GSList *l;
 	struct gatt_db *db;
 
 	DBG("Removing adapter %s", adapter->path);
@@ -7013,13 +8030,8 @@ static void adapter_remove(struct btd_adapter *adapter)
 	g_slist_free(adapter->connect_list);
 	adapter->connect_list = NULL;
 
-	for (l = adapter->devices; l; l = l->next) {
-		device_removed_drivers(adapter, l->data);
-		device_remove(l->data, FALSE);
-	}
-
-	g_slist_free(adapter->devices);
-	adapter->devices = NULL;
+	queue_foreach(adapter->devices, remove_device_and_drivers, adapter);
+	queue_remove_all(adapter->devices, NULL, NULL, NULL);
 
 	discovery_cleanup(adapter, 0);
 
@@ -7047,6 +8059,12 @@ static void adapter_remove(struct btd_adapter *adapter)
 	g_slist_free(adapter->msd_callbacks);
 	adapter->msd_callbacks = NULL;
 
+	load_devices_cancel(adapter);
+
+	queue_remove_all(adapter->report_clients, NULL, NULL,
+							report_client_free);
+	reports_stop(adapter);
+
 	queue_remove_all(adapter->exp_pending, NULL, NULL, cancel_exp_pending);
 }
 
@@ -7128,6 +8146,14 @@ static void adapter_msd_notify(struct btd_adapter *adapter,
 	}
 }
 
+static bool is_proximity_match(struct discovery_filter *item,
+						int8_t tx_power, int8_t rssi)
+{
+	return item->rssi == DISTANCE_VAL_INVALID || item->rssi <= rssi ||
+			item->pathloss == DISTANCE_VAL_INVALID ||
+			(tx_power != 127 && tx_power - rssi <= item->pathloss);
+}
+
 static bool is_filter_match(GSList *discovery_filter, struct eir_data *eir_data,
 								int8_t rssi)
 {
@@ -7168,11 +8194,7 @@ static bool is_filter_match(GSList *discovery_filter, struct eir_data *eir_data,
 
 		if (got_match) {
 			/* we have service match, check proximity */
-			if (item->rssi == DISTANCE_VAL_INVALID ||
-			    item->rssi <= rssi ||
-			    item->pathloss == DISTANCE_VAL_INVALID ||
-			    (eir_data->tx_power != 127 &&
-			     eir_data->tx_power - rssi <= item->pathloss))
+			if (is_proximity_match(item, eir_data->tx_power, rssi))
 				return true;
 
 			got_match = false;
@@ -7182,6 +8204,29 @@ static bool is_filter_match(GSList *discovery_filter, struct eir_data *eir_data,
 	return got_match;
 }
 
+static bool is_filter_match_peek(GSList *discovery_filter,
+					const struct eir_peek *peek, int8_t rssi)
+{
+	GSList *l;
+
+	for (l = discovery_filter; l != NULL; l = g_slist_next(l)) {
+		struct discovery_client *client = l->data;
+		struct discovery_filter *item = client->discovery_filter;
+
+		if (!item)
+			return true;
+
+		if (item->uuids && !eir_peek_match_uuids(peek, item->uuid128,
+							item->uuid_count))
+			continue;
+
+		if (is_proximity_match(item, peek->tx_power, rssi))
+			return true;
+	}
+
+	return false;
+}
+
 static void filter_duplicate_data(void *data, void *user_data)
 {
 	struct discovery_client *client = data;
@@ -7194,7 +8239,8 @@ static void filter_duplicate_data(void *data, void *user_data)
 }
 
 static bool device_is_discoverable(struct btd_adapter *adapter,
-					struct eir_data *eir, const char *addr,
+					unsigned int flags, const char *name,
+					size_t name_len, const char *addr,
 					uint8_t bdaddr_type)
 {
 	GSList *l;
@@ -7203,7 +8249,7 @@ static bool device_is_discoverable(struct btd_adapter *adapter,
 	if (bdaddr_type == BDADDR_BREDR || adapter->filtered_discovery)
 		discoverable = true;
 	else
-		discoverable = eir->flags & (EIR_LIM_DISC | EIR_GEN_DISC);
+		discoverable = flags & (EIR_LIM_DISC | EIR_GEN_DISC);
 
 	/*
 	 * Mark as not discoverable if no client has requested discovery and
@@ -7231,14 +8277,159 @@ static bool device_is_discoverable(struct btd_adapter *adapter,
 		if (!strncmp(filter->pattern, addr, pattern_len))
 			return true;
 
-		if (eir->name && !strncmp(filter->pattern, eir->name,
-							pattern_len))
+		if (name && name_len >= pattern_len &&
+				!memcmp(filter->pattern, name, pattern_len))
 			return true;
 	}
 
 	return discoverable;
 }
 
+/*
+ * Run the discovery filters against the raw report so that reports which
+ * would be dropped anyway are never parsed nor create a device object.
+ */
+static bool device_found_prefilter(struct btd_adapter *adapter,
+					const uint8_t *data, uint8_t data_len,
+					const char *addr, uint8_t bdaddr_type,
+					int8_t rssi)
+{
+	struct eir_peek peek;
+
+	eir_peek(&peek, data, data_len);
+
+	if (peek.rsi || (peek.name && !peek.name_valid))
+		return true;
+
+	if (btd_adapter_has_settings(adapter,
+					MGMT_SETTING_ISO_SYNC_RECEIVER) &&
+			eir_peek_has_service_data(&peek, BCAA_SERVICE_UUID))
+		return true;
+
+	if (!device_is_discoverable(adapter, peek.flags,
+					(const char *) peek.name,
+					peek.name_len, addr, bdaddr_type))
+		return false;
+
+	if (adapter->filtered_discovery &&
+			!is_filter_match_peek(adapter->discovery_list, &peek,
+									rssi))
+		return false;
+
+	return true;
+}
+
+static bool device_found_wanted(struct btd_adapter *adapter,
+					struct eir_data *eir_data,
+					bool discoverable, int8_t rssi)
+{
+	if (!adapter->discovery_list)
+		return false;
+
+	if (eir_data->rsi)
+		return true;
+
+	if (!discoverable)
+		return false;
+
+	return !adapter->filtered_discovery ||
+		is_filter_match(adapter->discovery_list, eir_data, rssi);
+}
+
+static bool pending_device_match(const void *data, const void *match_data)
+{
+	const struct pending_device *pending = data;
+	const struct device_addr_type *addr = match_data;
+
+	return pending->bdaddr_type == addr->bdaddr_type &&
+				!bacmp(&pending->bdaddr, &addr->bdaddr);
+}
+
+static void pending_device_add(struct btd_adapter *adapter,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type, uint32_t flags,
+					const uint8_t *data, uint8_t data_len)
+{
+	struct pending_device *pending;
+	struct device_addr_type addr;
+
+	if (bdaddr_type == BDADDR_BREDR || (flags & MGMT_DEV_FOUND_SCAN_RSP))
+		return;
+
+	bacpy(&addr.bdaddr, bdaddr);
+	addr.bdaddr_type = bdaddr_type;
+
+	/* Keep the most recently seen devices, reusing the oldest entry */
+	pending = queue_remove_if(adapter->pending_devices,
+						pending_device_match, &addr);
+	if (!pending &&
+		queue_length(adapter->pending_devices) >= PENDING_DEVICES_MAX)
+		pending = queue_pop_head(adapter->pending_devices);
+	if (!pending)
+		pending = new0(struct pending_device, 1);
+
+	bacpy(&pending->bdaddr, bdaddr);
+	pending->bdaddr_type = bdaddr_type;
+	pending->flags = flags;
+	pending->data_len = data_len;
+	memcpy(pending->data, data, data_len);
+
+	queue_push_tail(adapter->pending_devices, pending);
+}
+
+/*
+ * Scan responses are not enough to create a device, but one of a device left
+ * pending because its advertising report didn't match may be wanted.
+ */
+static struct btd_device *pending_device_promote(struct btd_adapter *adapter,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type, int8_t rssi,
+					const uint8_t *data, uint8_t data_len,
+					const char *addr)
+{
+	struct pending_device *pending;
+	struct device_addr_type match;
+	struct btd_device *dev;
+	struct eir_peek peek;
+	bool connectable;
+
+	if (!adapter->discovery_list)
+		return NULL;
+
+	bacpy(&match.bdaddr, bdaddr);
+	match.bdaddr_type = bdaddr_type;
+
+	pending = queue_find(adapter->pending_devices, pending_device_match,
+								&match);
+	if (!pending || !device_found_prefilter(adapter, data, data_len, addr,
+							bdaddr_type, rssi))
+		return NULL;
+
+	queue_remove(adapter->pending_devices, pending);
+
+	dev = adapter_create_device(adapter, bdaddr, bdaddr_type);
+	if (!dev) {
+		free(pending);
+		return NULL;
+	}
+
+	/* Account for the advertising report as if the device had been
+	 * created by it.
+	 */
+	connectable = !(pending->flags & MGMT_DEV_FOUND_NOT_CONNECTABLE);
+	device_update_last_seen(dev, bdaddr_type, connectable);
+
+	eir_peek(&peek, pending->data, pending->data_len);
+	if (peek.flags && !(peek.flags & EIR_BREDR_UNSUP)) {
+		device_set_bredr_support(dev);
+		device_update_last_seen(dev, BDADDR_BREDR, connectable);
+	}
+
+	free(pending);
+
+	return dev;
+}
+
 void btd_adapter_device_found(struct btd_adapter *adapter,
 					const bdaddr_t *bdaddr,
 					uint8_t bdaddr_type, int8_t rssi,
@@ -7247,7 +8438,6 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 					bool monitoring)
 {
 	struct btd_device *dev;
-	struct bt_ad *ad = NULL;
 	struct eir_data eir_data;
 	bool name_known, discoverable;
 	char addr[18];
@@ -7257,8 +8447,15 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	bool name_resolve_failed;
 	bool scan_rsp;
 	bool duplicate = false;
+	bool unchanged = false;
+	bool match;
+	struct eir_peek peek;
 	struct queue *matched_monitors = NULL;
 
+	BT_TRACE4(device_found, adapter->dev_id, bdaddr, bdaddr_type, rssi);
+
+	adapter->device_found_count++;
+
 	confirm = (flags & MGMT_DEV_FOUND_CONFIRM_NAME);
 	legacy = (flags & MGMT_DEV_FOUND_LEGACY_PAIRING);
 	not_connectable = (flags & MGMT_DEV_FOUND_NOT_CONNECTABLE);
@@ -7268,18 +8465,13 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!btd_adv_monitor_offload_enabled(adapter->adv_monitor_manager) ||
 				(MGMT_VERSION(mgmt_version, mgmt_revision) <
 							MGMT_VERSION(1, 22))) {
-		if (bdaddr_type != BDADDR_BREDR)
-			ad = bt_ad_new_with_data(data_len, data);
-
 		/* During the background scanning, update the device only when
 		 * the data match at least one Adv monitor
 		 */
-		if (ad) {
+		if (bdaddr_type != BDADDR_BREDR) {
 			matched_monitors = btd_adv_monitor_content_filter(
 						adapter->adv_monitor_manager,
-						ad);
-			bt_ad_unref(ad);
-			ad = NULL;
+						data, data_len);
 			monitoring = matched_monitors ? true : false;
 		}
 	}
@@ -7287,24 +8479,67 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!adapter->discovering && !monitoring)
 		return;
 
-	memset(&eir_data, 0, sizeof(eir_data));
-	eir_parse(&eir_data, data, data_len);
+	adapter_report(adapter, bdaddr, bdaddr_type, rssi, flags, data,
+								data_len);
 
 	ba2str(bdaddr, addr);
 
-	discoverable = device_is_discoverable(adapter, &eir_data, addr,
-							bdaddr_type);
-
 	dev = btd_adapter_find_device(adapter, bdaddr, bdaddr_type);
-	if (!dev) {
-		/* In case of being just a scan response don't attempt to create
-		 * the device.
-		 */
-		if (scan_rsp) {
-			eir_data_free(&eir_data);
+
+	/* In case of being just a scan response don't attempt to create
+	 * the device.
+	 */
+	if (!dev && scan_rsp) {
+		dev = pending_device_promote(adapter, bdaddr, bdaddr_type, rssi,
+							data, data_len, addr);
+		if (!dev)
 			return;
-		}
+	}
+
+	/* Unknown devices not matching any discovery client are dropped
+	 * before the report is parsed.
+	 */
+	if (!dev && !monitoring && adapter->discovery_list &&
+			!device_found_prefilter(adapter, data, data_len, addr,
+							bdaddr_type, rssi)) {
+		pending_device_add(adapter, bdaddr, bdaddr_type, flags, data,
+								data_len);
+		return;
+	}
 
+	if (adapter->discovery_list)
+		g_slist_foreach(adapter->discovery_list, filter_duplicate_data,
+								&duplicate);
+
+	/* Reports identical to the one last applied to the device only need
+	 * the fields used by the checks below, unless every report has to
+	 * be signalled.
+	 */
+	if (dev && !duplicate && !adapter->msd_callbacks &&
+				device_adv_data_equal(dev, data, data_len)) {
+		eir_peek(&peek, data, data_len);
+		unchanged = !peek.name || peek.name_valid;
+	}
+
+	memset(&eir_data, 0, sizeof(eir_data));
+
+	if (unchanged) {
+		eir_data.flags = peek.flags;
+		eir_data.rsi = peek.rsi;
+		eir_data.tx_power = peek.tx_power;
+		discoverable = device_is_discoverable(adapter, peek.flags,
+						(const char *) peek.name,
+						peek.name_len, addr,
+						bdaddr_type);
+	} else {
+		eir_parse(&eir_data, data, data_len);
+		discoverable = device_is_discoverable(adapter, eir_data.flags,
+				eir_data.name,
+				eir_data.name ? strlen(eir_data.name) : 0,
+				addr, bdaddr_type);
+	}
+
+	if (!dev) {
 		/* Monitor Devices advertising Broadcast Announcements if the
 		 * adapter is capable of synchronizing to it.
 		 */
@@ -7318,6 +8553,17 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 			return;
 		}
 
+		/* Only materialize a device object for reports that are going
+		 * to be reported or monitored.
+		 */
+		if (!monitoring && !device_found_wanted(adapter, &eir_data,
+							discoverable, rssi)) {
+			pending_device_add(adapter, bdaddr, bdaddr_type, flags,
+							data, data_len);
+			eir_data_free(&eir_data);
+			return;
+		}
+
 		dev = adapter_create_device(adapter, bdaddr, bdaddr_type);
 	}
 
@@ -7360,9 +8606,18 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	/* If there is no matched Adv monitors, don't continue if not
 	 * discoverable or if active discovery filter don't match.
 	 */
-	if (!eir_data.rsi && !monitoring && (!discoverable ||
-		(adapter->filtered_discovery && !is_filter_match(
-				adapter->discovery_list, &eir_data, rssi)))) {
+	match = discoverable;
+	if (match && !eir_data.rsi && !monitoring &&
+					adapter->filtered_discovery) {
+		if (unchanged)
+			match = is_filter_match_peek(adapter->discovery_list,
+								&peek, rssi);
+		else
+			match = is_filter_match(adapter->discovery_list,
+							&eir_data, rssi);
+	}
+
+	if (!eir_data.rsi && !monitoring && !match) {
 		eir_data_free(&eir_data);
 		return;
 	}
@@ -7377,6 +8632,11 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	else
 		device_set_rssi(dev, rssi);
 
+	if (unchanged) {
+		name_known = device_name_known(dev);
+		goto notify;
+	}
+
 	if (eir_data.tx_power != 127)
 		device_set_tx_power(dev, eir_data.tx_power);
 
@@ -7402,10 +8662,6 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 
 	device_add_eir_uuids(dev, eir_data.services);
 
-	if (adapter->discovery_list)
-		g_slist_foreach(adapter->discovery_list, filter_duplicate_data,
-								&duplicate);
-
 	if (eir_data.msd_list) {
 		device_set_manufacturer_data(dev, eir_data.msd_list, duplicate);
 		adapter_msd_notify(adapter, dev, eir_data.msd_list);
@@ -7420,8 +8676,11 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (bdaddr_type != BDADDR_BREDR)
 		device_set_flags(dev, eir_data.flags);
 
+	device_store_adv_data(dev, data, data_len);
+
 	eir_data_free(&eir_data);
 
+notify:
 	/* After the device is updated, notify the matched Adv monitors */
 	if (matched_monitors) {
 		btd_adv_monitor_notify_monitors(adapter->adv_monitor_manager,
@@ -7648,7 +8907,19 @@ static void agent_auth_cb(struct agent *agent, DBusError *derr,
 							void *user_data)
 {
 	struct btd_adapter *adapter = user_data;
-	struct service_auth *auth = g_queue_pop_head(adapter->auths);
+	struct service_auth *auth = NULL;
+	GList *l;
+
+	/* Only one authorization at a time is waiting for the agent */
+	for (l = adapter->auths->head; l != NULL; l = l->next) {
+		struct service_auth *pending = l->data;
+
+		if (pending->agent) {
+			auth = pending;
+			g_queue_delete_link(adapter->auths, l);
+			break;
+		}
+	}
 
 	if (!auth) {
 		DBG("No pending authorization");
@@ -7678,58 +8949,71 @@ static void agent_auth_cb(struct agent *agent, DBusError *derr,
 static gboolean process_auth_queue(gpointer user_data)
 {
 	struct btd_adapter *adapter = user_data;
+	bool prompting = false;
 	DBusError err;
+	GList *l, *next;
 
 	adapter->auth_idle_id = 0;
 
 	dbus_error_init(&err);
 	dbus_set_error_const(&err, ERROR_INTERFACE ".Rejected", NULL);
 
-	while (!g_queue_is_empty(adapter->auths)) {
-		struct service_auth *auth = adapter->auths->head->data;
+	/*
+	 * Only agent prompts are serialized, requests that can be answered
+	 * right away don't wait behind others still resolving services.
+	 */
+	for (l = adapter->auths->head; l != NULL; l = next) {
+		struct service_auth *auth = l->data;
 		struct btd_device *device = auth->device;
+		DBusError *derr = &err;
+
+		next = l->next;
 
 		/* Wait services to be resolved before asking authorization */
 		if (auth->svc_id > 0)
-			return FALSE;
+			continue;
 
-		if (!btd_adapter_is_uuid_allowed(adapter, auth->uuid)) {
-			auth->cb(&err, auth->user_data);
-			goto next;
-		}
+		if (!btd_adapter_is_uuid_allowed(adapter, auth->uuid))
+			goto done;
 
 		if (btd_device_is_trusted(device) == TRUE) {
-			auth->cb(NULL, auth->user_data);
-			goto next;
+			derr = NULL;
+			goto done;
 		}
 
 		/* If agent is set authorization is already ongoing */
-		if (auth->agent)
-			return FALSE;
+		if (auth->agent || prompting) {
+			prompting = true;
+			continue;
+		}
 
 		auth->agent = agent_get(NULL);
 		if (auth->agent == NULL) {
 			btd_warn(adapter->dev_id,
 					"Authentication attempt without agent");
-			auth->cb(&err, auth->user_data);
-			goto next;
+			goto done;
 		}
 
 		if (agent_authorize_service(auth->agent, device, auth->uuid,
-					agent_auth_cb, adapter, NULL) < 0) {
-			auth->cb(&err, auth->user_data);
-			goto next;
-		}
+					agent_auth_cb, adapter, NULL) < 0)
+			goto done;
 
-		break;
+		prompting = true;
+		continue;
+
+done:
+		g_queue_delete_link(adapter->auths, l);
+
+		auth->cb(derr, auth->user_data);
 
-next:
 		if (auth->agent)
 			agent_unref(auth->agent);
 
 		g_free(auth);
 
-		g_queue_pop_head(adapter->auths);
+		/* The callback may have changed the queue, start over */
+		next = adapter->auths->head;
+		prompting = false;
 	}
 
 	dbus_error_free(&err);
@@ -7957,6 +9241,78 @@ int btd_adapter_read_clock(struct btd_adapter *adapter, const bdaddr_t *bdaddr,
 	return -ENOSYS;
 }
 
+struct clock_info_data {
+	btd_adapter_clock_cb_t cb;
+	void *user_data;
+	void (*destroy)(void *user_data);
+};
+
+static void clock_info_data_free(void *user_data)
+{
+	struct clock_info_data *data = user_data;
+
+	if (data->destroy)
+		data->destroy(data->user_data);
+
+	free(data);
+}
+
+static void get_clock_info_complete(uint8_t status, uint16_t length,
+					const void *param, void *user_data)
+{
+	const struct mgmt_rp_get_clock_info *rp = param;
+	struct clock_info_data *data = user_data;
+
+	if (status != MGMT_STATUS_SUCCESS) {
+		data->cb(-EIO, 0, 0, 0, data->user_data);
+		return;
+	}
+
+	if (length < sizeof(*rp)) {
+		data->cb(-EILSEQ, 0, 0, 0, data->user_data);
+		return;
+	}
+
+	data->cb(0, le32_to_cpu(rp->local_clock),
+				le32_to_cpu(rp->piconet_clock),
+				le16_to_cpu(rp->accuracy), data->user_data);
+}
+
+/* Both clocks are sampled by the controller within the same command, the
+ * destroy callback is only called if the request could be queued.
+ */
+int btd_adapter_get_clock_info(struct btd_adapter *adapter,
+				const bdaddr_t *bdaddr,
+				btd_adapter_clock_cb_t cb, void *user_data,
+				void (*destroy)(void *user_data))
+{
+	struct mgmt_cp_get_clock_info cp;
+	struct clock_info_data *data;
+
+	if (!btd_adapter_get_powered(adapter))
+		return -EINVAL;
+
+	memset(&cp, 0, sizeof(cp));
+	bacpy(&cp.addr.bdaddr, bdaddr);
+	cp.addr.type = BDADDR_BREDR;
+
+	data = new0(struct clock_info_data, 1);
+	data->cb = cb;
+	data->user_data = user_data;
+
+	if (!mgmt_send(adapter->mgmt, MGMT_OP_GET_CLOCK_INFO,
+				adapter->dev_id, sizeof(cp), &cp,
+				get_clock_info_complete, data,
+				clock_info_data_free)) {
+		free(data);
+		return -EIO;
+	}
+
+	data->destroy = destroy;
+
+	return 0;
+}
+
 int btd_adapter_remove_bonding(struct btd_adapter *adapter,
 				const bdaddr_t *bdaddr, uint8_t bdaddr_type)
 {
@@ -8631,7 +9987,7 @@ static void store_link_key(struct btd_adapter *adapter,
 	create_file(filename, 0600);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -8648,7 +10004,7 @@ static void store_link_key(struct btd_adapter *adapter,
 	g_key_file_set_integer(key_file, "LinkKey", "PINLength", pin_length);
 
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -8724,7 +10080,7 @@ static void store_ltk_group(struct btd_adapter *adapter, const bdaddr_t *peer,
 	create_filename(filename, PATH_MAX, "/%s/%s/info",
 			btd_adapter_get_storage_dir(adapter), device_addr);
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -8745,7 +10101,7 @@ static void store_ltk_group(struct btd_adapter *adapter, const bdaddr_t *peer,
 	create_file(filename, 0600);
 
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -8896,7 +10252,7 @@ static void store_irk(struct btd_adapter *adapter, const bdaddr_t *peer,
 	create_file(filename, 0600);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -8910,7 +10266,7 @@ static void store_irk(struct btd_adapter *adapter, const bdaddr_t *peer,
 	g_key_file_set_string(key_file, "IdentityResolvingKey", "Key", str);
 
 	store_data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, store_data, length, &gerr)) {
+	if (!btd_storage_save(filename, store_data, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -8961,6 +10317,7 @@ static void new_irk_callback(uint16_t index, uint16_t length,
 	}
 
 	device_update_addr(device, &addr->bdaddr, addr->type);
+	queue_rehash(adapter->devices, device);
 
 	if (duplicate)
 		device_merge_duplicate(device, duplicate);
@@ -8993,7 +10350,7 @@ void btd_adapter_store_conn_param(struct btd_adapter *adapter,
 	create_filename(filename, PATH_MAX, "/%s/%s/info",
 			btd_adapter_get_storage_dir(adapter), device_addr);
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -9011,7 +10368,7 @@ void btd_adapter_store_conn_param(struct btd_adapter *adapter,
 	create_file(filename, 0600);
 
 	store_data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, store_data, length, &gerr)) {
+	if (!btd_storage_save(filename, store_data, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -9027,6 +10384,7 @@ static void new_conn_param(uint16_t index, uint16_t length,
 	const struct mgmt_ev_new_conn_param *ev = param;
 	struct btd_adapter *adapter = user_data;
 	uint16_t min, max, latency, timeout;
+	struct conn_param info;
 	struct btd_device *dev;
 	char dst[18];
 
@@ -9054,6 +10412,17 @@ static void new_conn_param(uint16_t index, uint16_t length,
 		return;
 	}
 
+	btd_device_set_conn_interval(dev, max);
+
+	memset(&info, 0, sizeof(info));
+	bacpy(&info.bdaddr, &ev->addr.bdaddr);
+	info.bdaddr_type = ev->addr.type;
+	info.min_interval = min;
+	info.max_interval = max;
+	info.latency = latency;
+	info.timeout = timeout;
+	conn_param_update(adapter, &info);
+
 	if (!ev->store_hint)
 		return;
 
@@ -9202,7 +10571,7 @@ void btd_adapter_for_each_device(struct btd_adapter *adapter,
 			void (*cb)(struct btd_device *device, void *data),
 			void *data)
 {
-	g_slist_foreach(adapter->devices, (GFunc) cb, data);
+	queue_foreach(adapter->devices, (queue_foreach_func_t) cb, data);
 }
 
 static int adapter_cmp(gconstpointer a, gconstpointer b)
@@ -9280,6 +10649,40 @@ static void services_modified(struct gatt_db_attribute *attrib, void *user_data)
 						ADAPTER_INTERFACE, "UUIDs");
 }
 
+static gboolean property_get_counters(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	DBusMessageIter dict;
+	dbus_uint64_t commands = 0, events = 0, signals;
+
+	mgmt_get_index_stats(adapter->mgmt, adapter->dev_id, &commands,
+								&events);
+	signals = g_dbus_get_signal_count();
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+
+	dict_append_entry(&dict, "DeviceFound", DBUS_TYPE_UINT64,
+						&adapter->device_found_count);
+	dict_append_entry(&dict, "MgmtCommands", DBUS_TYPE_UINT64, &commands);
+	dict_append_entry(&dict, "MgmtEvents", DBUS_TYPE_UINT64, &events);
+	dict_append_entry(&dict, "DBusSignals", DBUS_TYPE_UINT64, &signals);
+
+	dbus_message_iter_close_container(iter, &dict);
+
+	return TRUE;
+}
+
+static const GDBusPropertyTable statistics_properties[] = {
+	{ "Counters", "a{sv}", property_get_counters },
+	{ }
+};
+
 static int adapter_register(struct btd_adapter *adapter)
 {
 	struct agent *agent;
@@ -9336,6 +10739,10 @@ static int adapter_register(struct btd_adapter *adapter)
 	adapter->adv_manager = btd_adv_manager_new(adapter, adapter->mgmt);
 
 	if (g_dbus_get_flags() & G_DBUS_FLAG_ENABLE_EXPERIMENTAL) {
+		g_dbus_register_interface(dbus_conn, adapter->path,
+					STATISTICS_INTERFACE, NULL, NULL,
+					statistics_properties, adapter, NULL);
+
 		if (adapter->supported_settings & MGMT_SETTING_LE) {
 			adapter->adv_monitor_manager =
 				btd_adv_monitor_manager_create(adapter,
@@ -9371,9 +10778,6 @@ load:
 	load_defaults(adapter);
 	load_devices(adapter);
 
-	/* restore Service Changed CCC value for bonded devices */
-	btd_gatt_database_restore_svc_chng_ccc(adapter->database);
-
 	/* retrieve the active connections: address the scenario where
 	 * the are active connections before the daemon've started */
 	if (btd_adapter_get_powered(adapter))
@@ -9652,7 +11056,7 @@ static void remove_keys(struct btd_adapter *adapter,
 			btd_adapter_get_storage_dir(adapter), device_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -9668,7 +11072,7 @@ static void remove_keys(struct btd_adapter *adapter,
 	}
 
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -9756,7 +11160,7 @@ static bool get_static_addr(struct btd_adapter *adapter)
 	create_filename(filename, PATH_MAX, "/addresses");
 
 	file = g_key_file_new();
-	if (!g_key_file_load_from_file(file, filename, 0, &gerr)) {
+	if (!btd_storage_load(file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)",
 					filename, gerr->message);
 		g_clear_error(&gerr);
@@ -9814,7 +11218,7 @@ static bool get_static_addr(struct btd_adapter *adapter)
 						(const char **)addrs, len);
 
 	str = g_key_file_to_data(file, &len, NULL);
-	if (!g_file_set_contents(filename, str, len, &gerr)) {
+	if (!btd_storage_save(filename, str, len, &gerr)) {
 		error("Unable set contents for %s: (%s)",
 					filename, gerr->message);
 		g_error_free(gerr);
@@ -10331,7 +11735,16 @@ static void read_info_complete(uint8_t status, uint16_t length,
 						discovering_callback,
 						adapter, NULL);
 
-	mgmt_register(adapter->mgmt, MGMT_EV_DEVICE_FOUND,
+	if (btd_opts.adapter_threads && !adapter->worker) {
+		adapter->worker = adapter_worker_new(adapter->dev_id);
+		if (!adapter->worker)
+			btd_error(adapter->dev_id,
+					"Failed to start adapter thread");
+	}
+
+	/* The primary socket still receives the events but ignores them */
+	mgmt_register(adapter->worker ? adapter->worker->mgmt : adapter->mgmt,
+						MGMT_EV_DEVICE_FOUND,
 						adapter->dev_id,
 						device_found_callback,
 						adapter, NULL);
@@ -10796,6 +12209,17 @@ int adapter_init(void)
 
 	mgmt_set_debug(mgmt_primary, mgmt_debug, NULL, NULL);
 
+	/* Commands only issued in bulk during controller setup and that
+	 * don't depend on each other are allowed to be in flight together.
+	 */
+	mgmt_set_max_pending(mgmt_primary, MGMT_PIPELINE_WINDOW);
+	mgmt_set_pipelined(mgmt_primary, MGMT_OP_LOAD_LINK_KEYS, true);
+	mgmt_set_pipelined(mgmt_primary, MGMT_OP_LOAD_LONG_TERM_KEYS, true);
+	mgmt_set_pipelined(mgmt_primary, MGMT_OP_LOAD_IRKS, true);
+	mgmt_set_pipelined(mgmt_primary, MGMT_OP_LOAD_CONN_PARAM, true);
+	mgmt_set_pipelined(mgmt_primary, MGMT_OP_ADD_DEVICE, true);
+	mgmt_set_pipelined(mgmt_primary, MGMT_OP_SET_DEVICE_FLAGS, true);
+
 	DBG("sending read version command");
 
 	if (mgmt_send(mgmt_primary, MGMT_OP_READ_VERSION,
@@ -10808,8 +12232,19 @@ int adapter_init(void)
 	return -EIO;
 }
 
+static void mgmt_stats(uint16_t opcode, unsigned int count,
+					uint64_t total_usec, uint64_t max_usec,
+					void *user_data)
+{
+	DBG("opcode 0x%04x count %u avg %llu max %llu usec", opcode, count,
+			(unsigned long long) (total_usec / count),
+			(unsigned long long) max_usec);
+}
+
 void adapter_cleanup(void)
 {
+	mgmt_foreach_stats(mgmt_primary, mgmt_stats, NULL);
+
 	g_list_free(adapter_list);
 
 	while (adapters) {
@@ -17,6 +17,7 @@
 #include <lib/sdp.h>
 
 #define ADAPTER_INTERFACE	"org.bluez.Adapter1"
+#define STATISTICS_INTERFACE	"org.bluez.Statistics1"
 
 #define MAX_NAME_LENGTH		248
 
@@ -182,6 +183,15 @@ int btd_adapter_read_clock(struct btd_adapter *adapter, const bdaddr_t *bdaddr,
 				int which, int timeout, uint32_t *clock,
 				uint16_t *accuracy);
 
+typedef void (*btd_adapter_clock_cb_t) (int err, uint32_t local_clock,
+					uint32_t piconet_clock,
+					uint16_t accuracy, void *user_data);
+
+int btd_adapter_get_clock_info(struct btd_adapter *adapter,
+				const bdaddr_t *bdaddr,
+				btd_adapter_clock_cb_t cb, void *user_data,
+				void (*destroy)(void *user_data));
+
 int btd_adapter_block_address(struct btd_adapter *adapter,
 				const bdaddr_t *bdaddr, uint8_t bdaddr_type);
 int btd_adapter_unblock_address(struct btd_adapter *adapter,
@@ -294,6 +304,11 @@ void btd_adapter_load_conn_param(struct btd_adapter *adapter,
 				uint16_t min_interval, uint16_t max_interval,
 				uint16_t latency, uint16_t timeout);
 
+bool btd_adapter_get_conn_param(struct btd_adapter *adapter,
+				const bdaddr_t *peer, uint8_t bdaddr_type,
+				uint16_t *min_interval, uint16_t *max_interval,
+				uint16_t *latency, uint16_t *timeout);
+
 void btd_adapter_store_conn_param(struct btd_adapter *adapter,
 				const bdaddr_t *peer, uint8_t bdaddr_type,
 				uint16_t min_interval, uint16_t max_interval,
@@ -63,6 +63,7 @@ struct btd_adv_monitor_manager {
 
 	struct queue *apps;	/* apps who registered for Adv monitoring */
 	struct queue *merged_patterns;
+	struct bt_ad_matcher *matcher;	/* Compiled OR patterns */
 };
 
 struct adv_monitor_app {
@@ -165,7 +166,6 @@ struct app_match_data {
 };
 
 struct adv_content_filter_info {
-	struct bt_ad *ad;
 	struct queue *matched_monitors;	/* List of matched monitors */
 };
 
@@ -240,9 +240,13 @@ static void merged_pattern_free(void *data)
 	queue_destroy(merged_pattern->patterns, pattern_free);
 	queue_destroy(merged_pattern->monitors, NULL);
 
-	if (merged_pattern->manager)
+	if (merged_pattern->manager) {
 		queue_remove(merged_pattern->manager->merged_patterns,
 							merged_pattern);
+		bt_ad_matcher_remove(merged_pattern->manager->matcher,
+							merged_pattern);
+	}
+
 	free(merged_pattern);
 }
 
@@ -270,6 +274,12 @@ static void merge_rssi(const struct rssi_parameters *a,
 			const struct rssi_parameters *b,
 			struct rssi_parameters *merged)
 {
+	/* A monitor without RSSI filtering wants every report */
+	if (rssi_is_unset(a) || rssi_is_unset(b)) {
+		rssi_unset(merged);
+		return;
+	}
+
 	/* For low rssi, low_timeout, and high_rssi, choose the minimum of the
 	 * two values. Filtering the higher values is done on userspace.
 	 */
@@ -286,22 +296,20 @@ static void merge_rssi(const struct rssi_parameters *a,
 	 */
 	merged->high_rssi_timeout = 0;
 
-	/* Sampling period is not implemented yet in userspace. There is no
-	 * good value if the two values are different, so just choose 0 for
-	 * always reporting, to avoid missing packets.
+	/* Sampling period is not implemented yet in userspace. Choose the
+	 * shorter of the two so no monitor gets fewer reports than requested,
+	 * without falling back to waking the host for every packet.
 	 */
-	if (a->sampling_period != b->sampling_period)
-		merged->sampling_period = 0;
-	else
-		merged->sampling_period = a->sampling_period;
+	merged->sampling_period = get_smaller_not_unset(a->sampling_period,
+					b->sampling_period,
+					ADV_MONITOR_UNSET_SAMPLING_PERIOD);
 }
 
 /* Two merged_pattern are considered equal if all the following are true:
  * (1) both has the same monitor_type
  * (2) both has exactly the same pattern in the same order
- * Therefore, patterns A+B and B+A are considered different, as well as patterns
- * A and A+A. This shouldn't cause any issue, but solving this issue is a
- * potential improvement.
+ * Patterns are kept sorted and without redundant entries by pattern_add(), so
+ * patterns A+B, B+A and A+A+B are all considered equal.
  */
 static bool merged_pattern_is_equal(const void *data, const void *match_data)
 {
@@ -881,6 +889,70 @@ failed:
 	return false;
 }
 
+/* Orders patterns by AD type, offset and value */
+static int pattern_cmp(const struct bt_ad_pattern *a,
+					const struct bt_ad_pattern *b)
+{
+	int ret;
+
+	if (a->type != b->type)
+		return a->type - b->type;
+
+	if (a->offset != b->offset)
+		return a->offset - b->offset;
+
+	ret = memcmp(a->data, b->data, MIN(a->len, b->len));
+	if (ret)
+		return ret;
+
+	return a->len - b->len;
+}
+
+/* Returns true if every AD matching |b| also matches |a| */
+static bool pattern_covers(const struct bt_ad_pattern *a,
+					const struct bt_ad_pattern *b)
+{
+	return a->type == b->type && a->offset == b->offset &&
+			a->len <= b->len && !memcmp(a->data, b->data, a->len);
+}
+
+static bool match_pattern_covered(const void *data, const void *user_data)
+{
+	return pattern_covers(user_data, data);
+}
+
+/* Adds a pattern to a sorted list of OR'ed patterns, dropping the patterns
+ * made redundant by a shorter one, so identical monitors get merged and as few
+ * patterns as possible need to be offloaded to the controller.
+ */
+static void pattern_add(struct queue *patterns, struct bt_ad_pattern *pattern)
+{
+	const struct queue_entry *e;
+	void *prev = NULL;
+
+	for (e = queue_get_entries(patterns); e; e = e->next) {
+		if (pattern_covers(e->data, pattern)) {
+			pattern_free(pattern);
+			return;
+		}
+	}
+
+	queue_remove_all(patterns, match_pattern_covered, pattern,
+							pattern_free);
+
+	for (e = queue_get_entries(patterns); e; e = e->next) {
+		if (pattern_cmp(e->data, pattern) > 0)
+			break;
+
+		prev = e->data;
+	}
+
+	if (prev)
+		queue_push_after(patterns, prev, pattern);
+	else
+		queue_push_head(patterns, pattern);
+}
+
 /* Retrieves Patterns from the remote Adv Monitor object, verifies the values
  * and update the local Adv Monitor
  */
@@ -947,7 +1019,7 @@ static bool parse_patterns(struct adv_monitor *monitor, const char *path)
 		if (!pattern)
 			goto failed;
 
-		queue_push_tail(monitor->merged_pattern->patterns, pattern);
+		pattern_add(monitor->merged_pattern->patterns, pattern);
 
 		dbus_message_iter_next(&array_iter);
 	}
@@ -1236,6 +1308,12 @@ static void monitor_proxy_added_cb(GDBusProxy *proxy, void *user_data)
 		monitor->merged_pattern->manager = monitor->app->manager;
 		queue_push_tail(monitor->app->manager->merged_patterns,
 						monitor->merged_pattern);
+
+		if (monitor->merged_pattern->type == MONITOR_TYPE_OR_PATTERNS)
+			bt_ad_matcher_add(monitor->app->manager->matcher,
+					monitor->merged_pattern->patterns,
+					monitor->merged_pattern);
+
 		merged_pattern_add(monitor->merged_pattern);
 	} else {
 		/* Since there is a matching pattern, abandon the one we have */
@@ -1709,6 +1787,7 @@ static struct btd_adv_monitor_manager *manager_new(
 	manager->adapter_id = btd_adapter_get_index(adapter);
 	manager->apps = queue_new();
 	manager->merged_patterns = queue_new();
+	manager->matcher = bt_ad_matcher_new();
 
 	mgmt_register(manager->mgmt, MGMT_EV_ADV_MONITOR_REMOVED,
 			manager->adapter_id, adv_monitor_removed_callback,
@@ -1732,6 +1811,7 @@ static void manager_free(struct btd_adv_monitor_manager *manager)
 
 	queue_destroy(manager->apps, app_destroy);
 	queue_destroy(manager->merged_patterns, merged_pattern_free);
+	bt_ad_matcher_free(manager->matcher);
 
 	free(manager);
 }
@@ -1842,12 +1922,11 @@ bool btd_adv_monitor_offload_enabled(struct btd_adv_monitor_manager *manager)
 				MGMT_ADV_MONITOR_FEATURE_MASK_OR_PATTERNS);
 }
 
-/* Processes the content matching based pattern(s) of a monitor */
+/* Collects the active monitors of a merged pattern whose content matched */
 static void adv_match_per_monitor(void *data, void *user_data)
 {
 	struct adv_monitor *monitor = data;
 	struct adv_content_filter_info *info = user_data;
-	struct queue *patterns;
 
 	if (!monitor) {
 		error("Unexpected NULL adv_monitor object upon match");
@@ -1857,55 +1936,40 @@ static void adv_match_per_monitor(void *data, void *user_data)
 	if (monitor->state != MONITOR_STATE_ACTIVE)
 		return;
 
-	if (!monitor->merged_pattern)
-		return;
-
-	patterns = monitor->merged_pattern->patterns;
-	if (monitor->merged_pattern->type == MONITOR_TYPE_OR_PATTERNS &&
-				bt_ad_pattern_match(info->ad, patterns)) {
-		goto matched;
-	}
-
-	return;
-
-matched:
 	if (!info->matched_monitors)
 		info->matched_monitors = queue_new();
 
 	queue_push_tail(info->matched_monitors, monitor);
 }
 
-/* Processes the content matching for the monitor(s) of an app */
-static void adv_match_per_app(void *data, void *user_data)
+/* Processes the content matching for the monitor(s) of a merged pattern */
+static void adv_match_per_pattern(void *match_data, void *user_data)
 {
-	struct adv_monitor_app *app = data;
-
-	if (!app) {
-		error("Unexpected NULL adv_monitor_app object upon match");
-		return;
-	}
+	struct adv_monitor_merged_pattern *merged_pattern = match_data;
 
-	queue_foreach(app->monitors, adv_match_per_monitor, user_data);
+	queue_foreach(merged_pattern->monitors, adv_match_per_monitor,
+								user_data);
 }
 
 /* Processes the content matching for every app without RSSI filtering and
- * notifying monitors. The caller is responsible of releasing the memory of the
- * list but not the ad data.
+ * notifying monitors. The patterns of all monitors are compiled in a single
+ * matcher so the raw ad data is only walked once. The caller is responsible of
+ * releasing the memory of the list but not the ad data.
  * Returns the list of monitors whose content match the ad data.
  */
 struct queue *btd_adv_monitor_content_filter(
 				struct btd_adv_monitor_manager *manager,
-				struct bt_ad *ad)
+				const uint8_t *data, size_t len)
 {
 	struct adv_content_filter_info info;
 
-	if (!manager || !ad)
+	if (!manager || !data || !len)
 		return NULL;
 
-	info.ad = ad;
 	info.matched_monitors = NULL;
 
-	queue_foreach(manager->apps, adv_match_per_app, &info);
+	bt_ad_matcher_match(manager->matcher, data, len,
+					adv_match_per_pattern, &info);
 
 	return info.matched_monitors;
 }
@@ -15,6 +15,8 @@
 #define _GNU_SOURCE
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <errno.h>
 
 #include <dbus/dbus.h>
@@ -54,6 +56,7 @@ struct btd_adv_manager {
 	bool extended_add_cmds;
 	int8_t min_tx_power;
 	int8_t max_tx_power;
+	unsigned int rotate_id;
 };
 
 #define AD_TYPE_BROADCAST 0
@@ -64,6 +67,16 @@ struct btd_adv_manager {
  */
 #define ADV_TX_POWER_NO_PREFERENCE 0x7F
 
+/* Advertisements exceeding the controller instances are rotated in slots of
+ * MultiAdvertisementRotationInterval, or the kernel default of 2 seconds.
+ */
+#define ADV_ROTATION_SLOT	2000
+#define ADV_MAX_CLIENTS		UINT8_MAX
+#define ADV_DUTY_CYCLE_MAX	100
+
+/* Delay used to coalesce property changes of the same advertisement */
+#define ADV_REFRESH_DELAY	100
+
 struct btd_adv_client {
 	struct btd_adv_manager *manager;
 	char *owner;
@@ -87,6 +100,17 @@ struct btd_adv_client {
 	uint32_t min_interval;
 	uint32_t max_interval;
 	int8_t tx_power;
+	uint8_t priority;
+	uint8_t duty_cycle;
+	unsigned int pass;
+	unsigned int refresh_id;
+	bool refresh_params;
+	uint32_t ext_flags;
+	bool scannable;
+	uint8_t max_adv_data_len;
+	uint8_t max_scan_rsp_len;
+	struct mgmt_cp_add_ext_adv_data *ext_data;
+	uint16_t ext_data_len;
 	mgmt_request_func_t refresh_done_func;
 };
 
@@ -119,6 +143,11 @@ static void client_free(void *data)
 	if (client->disc_to_id > 0)
 		timeout_remove(client->disc_to_id);
 
+	if (client->refresh_id > 0)
+		timeout_remove(client->refresh_id);
+
+	free(client->ext_data);
+
 	if (client->client) {
 		g_dbus_client_set_disconnect_watch(client->client, NULL, NULL);
 		g_dbus_client_unref(client->client);
@@ -195,6 +224,167 @@ static void remove_advertising(struct btd_adv_manager *manager,
 			manager->mgmt_index, sizeof(cp), &cp, NULL, NULL, NULL);
 }
 
+static void client_set_ext_data(struct btd_adv_client *client,
+				struct mgmt_cp_add_ext_adv_data *cp,
+				uint16_t len)
+{
+	free(client->ext_data);
+	client->ext_data = cp;
+	client->ext_data_len = len;
+}
+
+static bool match_parked(const void *data, const void *user_data)
+{
+	const struct btd_adv_client *client = data;
+
+	return !client->instance && !client->reg;
+}
+
+static void min_pass(void *data, void *user_data)
+{
+	struct btd_adv_client *client = data;
+	unsigned int *pass = user_data;
+
+	if (client->pass < *pass)
+		*pass = client->pass;
+}
+
+static int client_sched_cmp(const void *a, const void *b)
+{
+	const struct btd_adv_client *ca = *(const struct btd_adv_client **) a;
+	const struct btd_adv_client *cb = *(const struct btd_adv_client **) b;
+
+	/* Higher priority first, then whoever had the least air time */
+	if (ca->priority != cb->priority)
+		return cb->priority - ca->priority;
+
+	if (ca->pass != cb->pass)
+		return ca->pass < cb->pass ? -1 : 1;
+
+	return 0;
+}
+
+static int refresh_advertisement(struct btd_adv_client *client,
+					mgmt_request_func_t func);
+
+static void client_park(struct btd_adv_client *client)
+{
+	struct btd_adv_manager *manager = client->manager;
+
+	DBG("Parking advertisement %s instance %u", client->path,
+							client->instance);
+
+	remove_advertising(manager, client->instance);
+	util_clear_uid(&manager->instance_bitmap, client->instance);
+	client->instance = 0;
+	client_set_ext_data(client, NULL, 0);
+}
+
+static void client_unpark(struct btd_adv_client *client)
+{
+	struct btd_adv_manager *manager = client->manager;
+
+	client->instance = util_get_uid(&manager->instance_bitmap,
+							manager->max_ads);
+	if (!client->instance)
+		return;
+
+	DBG("Resuming advertisement %s instance %u", client->path,
+							client->instance);
+
+	if (refresh_advertisement(client, NULL) < 0) {
+		util_clear_uid(&manager->instance_bitmap, client->instance);
+		client->instance = 0;
+	}
+}
+
+/* Stride scheduling: the clients with the highest priority and the lowest
+ * pass get the instances for the next slot, and each slot on air advances
+ * the pass inversely to the client DutyCycle.
+ */
+static void manager_rotate(struct btd_adv_manager *manager)
+{
+	struct btd_adv_client *list[ADV_MAX_CLIENTS];
+	const struct queue_entry *entry;
+	unsigned int count = 0, slots = manager->max_ads, i;
+
+	for (entry = queue_get_entries(manager->clients); entry;
+							entry = entry->next) {
+		struct btd_adv_client *client = entry->data;
+
+		/* Leave clients with requests in flight alone */
+		if (client->reg || client->add_adv_id) {
+			if (client->instance && slots)
+				slots--;
+			continue;
+		}
+
+		if (count < ADV_MAX_CLIENTS)
+			list[count++] = client;
+	}
+
+	qsort(list, count, sizeof(*list), client_sched_cmp);
+
+	/* Stop the ones losing their slot first so the instances are free */
+	for (i = slots; i < count; i++) {
+		if (list[i]->instance)
+			client_park(list[i]);
+	}
+
+	for (i = 0; i < slots && i < count; i++) {
+		list[i]->pass += ADV_DUTY_CYCLE_MAX / list[i]->duty_cycle;
+
+		if (!list[i]->instance)
+			client_unpark(list[i]);
+	}
+}
+
+static bool manager_rotate_cb(void *user_data)
+{
+	struct btd_adv_manager *manager = user_data;
+
+	manager_rotate(manager);
+
+	if (queue_find(manager->clients, match_parked, NULL))
+		return true;
+
+	manager->rotate_id = 0;
+
+	return false;
+}
+
+static void manager_schedule(struct btd_adv_manager *manager)
+{
+	unsigned int slot;
+
+	if (!queue_find(manager->clients, match_parked, NULL)) {
+		if (manager->rotate_id) {
+			timeout_remove(manager->rotate_id);
+			manager->rotate_id = 0;
+		}
+		return;
+	}
+
+	if (manager->rotate_id)
+		return;
+
+	slot = btd_opts.defaults.le.adv_rotation_interval;
+	if (!slot)
+		slot = ADV_ROTATION_SLOT;
+
+	manager->rotate_id = timeout_add(slot, manager_rotate_cb, manager,
+									NULL);
+}
+
+static bool rotation_enabled(struct btd_adv_manager *manager)
+{
+	if (!(g_dbus_get_flags() & G_DBUS_FLAG_ENABLE_EXPERIMENTAL))
+		return false;
+
+	return manager->max_ads &&
+			queue_length(manager->clients) < ADV_MAX_CLIENTS;
+}
+
 static void client_remove(void *data)
 {
 	struct btd_adv_client *client = data;
@@ -204,16 +394,29 @@ static void client_remove(void *data)
 									client);
 	g_dbus_client_set_disconnect_watch(client->client, NULL, NULL);
 
-	cp.instance = client->instance;
+	/* Parked clients have nothing on air */
+	if (client->instance) {
+		cp.instance = client->instance;
 
-	mgmt_send(client->manager->mgmt, MGMT_OP_REMOVE_ADVERTISING,
-			client->manager->mgmt_index, sizeof(cp), &cp,
-			NULL, NULL, NULL);
+		mgmt_send(client->manager->mgmt, MGMT_OP_REMOVE_ADVERTISING,
+				client->manager->mgmt_index, sizeof(cp), &cp,
+				NULL, NULL, NULL);
+
+		util_clear_uid(&client->manager->instance_bitmap,
+							client->instance);
+		client->instance = 0;
+	}
 
 	queue_remove(client->manager->clients, client);
 
 	g_idle_add(client_free_idle_cb, client);
 
+	/* Hand the freed instance over to a parked client right away */
+	if (queue_find(client->manager->clients, match_parked, NULL)) {
+		manager_rotate(client->manager);
+		manager_schedule(client->manager);
+	}
+
 	g_dbus_emit_property_changed(btd_get_dbus_connection(),
 				adapter_get_path(client->manager->adapter),
 				LE_ADVERTISING_MGR_IFACE, "SupportedInstances");
@@ -1037,6 +1240,13 @@ static int refresh_extended_adv(struct btd_adv_client *client,
 
 	flags = get_adv_flags(client);
 
+	/* Remember what the parameters were computed from, the kernel drops
+	 * the instance data along with them.
+	 */
+	client->ext_flags = flags;
+	client->scannable = adv_client_has_scan_response(client, flags);
+	client_set_ext_data(client, NULL, 0);
+
 	memset(&cp, 0, sizeof(cp));
 	cp.instance = client->instance;
 
@@ -1088,6 +1298,10 @@ static int refresh_extended_adv(struct btd_adv_client *client,
 static int refresh_advertisement(struct btd_adv_client *client,
 					mgmt_request_func_t func)
 {
+	/* Parked clients are sent when they get an instance back */
+	if (!client->instance)
+		return 0;
+
 	if (client->manager->extended_add_cmds)
 		return refresh_extended_adv(client, func);
 
@@ -1267,36 +1481,85 @@ static bool parse_tx_power(DBusMessageIter *iter,
 	return true;
 }
 
+static bool parse_priority(DBusMessageIter *iter,
+					struct btd_adv_client *client)
+{
+	if (!iter) {
+		client->priority = 0;
+		return true;
+	}
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_BYTE)
+		return false;
+
+	dbus_message_iter_get_basic(iter, &client->priority);
+
+	return true;
+}
+
+static bool parse_duty_cycle(DBusMessageIter *iter,
+					struct btd_adv_client *client)
+{
+	uint8_t duty_cycle;
+
+	if (!iter) {
+		client->duty_cycle = ADV_DUTY_CYCLE_MAX;
+		return true;
+	}
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_BYTE)
+		return false;
+
+	dbus_message_iter_get_basic(iter, &duty_cycle);
+
+	if (!duty_cycle || duty_cycle > ADV_DUTY_CYCLE_MAX) {
+		error("DutyCycle must be in range [1, %u]",
+							ADV_DUTY_CYCLE_MAX);
+		return false;
+	}
+
+	client->duty_cycle = duty_cycle;
+
+	return true;
+}
+
 static struct adv_parser {
 	const char *name;
 	bool (*func)(DBusMessageIter *iter, struct btd_adv_client *client);
 	bool experimental;
+	bool data_only;
 } parsers[] = {
 	{ "Type", parse_type },
-	{ "ServiceUUIDs", parse_service_uuids_ad },
-	{ "ScanResponseServiceUUIDs", parse_service_uuids_sr, true },
-	{ "SolicitUUIDs", parse_solicit_uuids_ad },
-	{ "ScanResponseSolicitUUIDs", parse_solicit_uuids_sr, true },
-	{ "ManufacturerData", parse_manufacturer_data_ad },
-	{ "ScanResponseManufacturerData", parse_manufacturer_data_sr, true },
-	{ "ServiceData", parse_service_data_ad },
-	{ "ScanResponseServiceData", parse_service_data_sr, true },
+	{ "ServiceUUIDs", parse_service_uuids_ad, false, true },
+	{ "ScanResponseServiceUUIDs", parse_service_uuids_sr, true, true },
+	{ "SolicitUUIDs", parse_solicit_uuids_ad, false, true },
+	{ "ScanResponseSolicitUUIDs", parse_solicit_uuids_sr, true, true },
+	{ "ManufacturerData", parse_manufacturer_data_ad, false, true },
+	{ "ScanResponseManufacturerData", parse_manufacturer_data_sr, true,
+									true },
+	{ "ServiceData", parse_service_data_ad, false, true },
+	{ "ScanResponseServiceData", parse_service_data_sr, true, true },
 	{ "Includes", parse_includes },
-	{ "LocalName", parse_local_name },
-	{ "Appearance", parse_appearance },
+	{ "LocalName", parse_local_name, false, true },
+	{ "Appearance", parse_appearance, false, true },
 	{ "Duration", parse_duration },
 	{ "Timeout", parse_timeout },
-	{ "Data", parse_data_ad },
-	{ "ScanResponseData", parse_data_sr },
+	{ "Data", parse_data_ad, false, true },
+	{ "ScanResponseData", parse_data_sr, false, true },
 	{ "Discoverable", parse_discoverable },
 	{ "DiscoverableTimeout", parse_discoverable_timeout },
 	{ "SecondaryChannel", parse_secondary },
 	{ "MinInterval", parse_min_interval },
 	{ "MaxInterval", parse_max_interval },
 	{ "TxPower", parse_tx_power },
+	{ "Priority", parse_priority, true },
+	{ "DutyCycle", parse_duty_cycle, true },
 	{ },
 };
 
+static void client_schedule_refresh(struct btd_adv_client *client,
+								bool params);
+
 static void properties_changed(GDBusProxy *proxy, const char *name,
 					DBusMessageIter *iter, void *user_data)
 {
@@ -1315,7 +1578,7 @@ static void properties_changed(GDBusProxy *proxy, const char *name,
 			continue;
 
 		if (parser->func(iter, client)) {
-			refresh_advertisement(client, NULL);
+			client_schedule_refresh(client, !parser->data_only);
 
 			break;
 		}
@@ -1351,24 +1614,8 @@ static void add_client_complete(struct btd_adv_client *client, uint8_t status)
 	client->reg = NULL;
 }
 
-static void add_adv_callback(uint8_t status, uint16_t length,
-					  const void *param, void *user_data)
+static void client_registered(struct btd_adv_client *client)
 {
-	struct btd_adv_client *client = user_data;
-	const struct mgmt_rp_add_advertising *rp = param;
-
-	client->add_adv_id = 0;
-
-	if (status)
-		goto done;
-
-	if (!param || length < sizeof(*rp)) {
-		status = MGMT_STATUS_FAILED;
-		goto done;
-	}
-
-	client->instance = rp->instance;
-
 	g_dbus_client_set_disconnect_watch(client->client, client_disconnect_cb,
 									client);
 	DBG("Advertisement registered: %s", client->path);
@@ -1383,70 +1630,71 @@ static void add_adv_callback(uint8_t status, uint16_t length,
 
 	g_dbus_proxy_set_property_watch(client->proxy, properties_changed,
 								client);
-
-done:
-	add_client_complete(client, status);
 }
 
-static void add_adv_params_callback(uint8_t status, uint16_t length,
+static void add_adv_callback(uint8_t status, uint16_t length,
 					  const void *param, void *user_data)
 {
 	struct btd_adv_client *client = user_data;
-	const struct mgmt_rp_add_ext_adv_params *rp = param;
-	struct mgmt_cp_add_ext_adv_data *cp = NULL;
-	uint8_t param_len;
-	uint8_t *adv_data = NULL;
-	size_t adv_data_len;
-	uint8_t *scan_rsp = NULL;
-	size_t scan_rsp_len = 0;
-	uint32_t flags = 0;
-	unsigned int mgmt_ret;
-	dbus_int16_t tx_power;
+	const struct mgmt_rp_add_advertising *rp = param;
 
 	client->add_adv_id = 0;
 
 	if (status)
-		goto fail;
+		goto done;
 
 	if (!param || length < sizeof(*rp)) {
 		status = MGMT_STATUS_FAILED;
-		goto fail;
+		goto done;
 	}
 
-	DBG("Refreshing advertisement data: %s", client->path);
+	client->instance = rp->instance;
 
-	/* Update tx power held by client */
-	tx_power = rp->tx_power;
-	if (tx_power != ADV_TX_POWER_NO_PREFERENCE)
-		g_dbus_proxy_set_property_basic(client->proxy, "TxPower",
-				DBUS_TYPE_INT16, &tx_power, NULL, NULL, NULL);
+	client_registered(client);
 
-	client->instance = rp->instance;
+done:
+	add_client_complete(client, status);
+}
+
+static struct mgmt_cp_add_ext_adv_data *generate_ext_adv_data(
+						struct btd_adv_client *client,
+						uint16_t *param_len)
+{
+	struct mgmt_cp_add_ext_adv_data *cp;
+	uint8_t *adv_data;
+	size_t adv_data_len;
+	uint8_t *scan_rsp = NULL;
+	size_t scan_rsp_len = 0;
+	uint32_t flags;
 
 	flags = get_adv_flags(client);
 
 	adv_data = generate_adv_data(client, &flags, &adv_data_len);
-	if (!adv_data || (adv_data_len > rp->max_adv_data_len)) {
+	if (!adv_data || (adv_data_len > client->max_adv_data_len)) {
 		error("Advertising data too long or couldn't be generated.");
-		goto fail;
+		free(adv_data);
+		return NULL;
 	}
 
 	if (adv_client_has_scan_response(client, flags)) {
 		scan_rsp = generate_scan_rsp(client, &flags, &scan_rsp_len);
 		if ((!scan_rsp && scan_rsp_len) ||
-				scan_rsp_len > rp->max_scan_rsp_len) {
+				scan_rsp_len > client->max_scan_rsp_len) {
 			error("Scan data couldn't be generated.");
-			goto fail;
+			free(adv_data);
+			free(scan_rsp);
+			return NULL;
 		}
 	}
 
-	param_len = sizeof(struct mgmt_cp_add_advertising) + adv_data_len +
-							scan_rsp_len;
+	*param_len = sizeof(*cp) + adv_data_len + scan_rsp_len;
 
-	cp = malloc0(param_len);
+	cp = malloc0(*param_len);
 	if (!cp) {
 		error("Couldn't allocate for MGMT!");
-		goto fail;
+		free(adv_data);
+		free(scan_rsp);
+		return NULL;
 	}
 
 	cp->instance = client->instance;
@@ -1459,8 +1707,45 @@ static void add_adv_params_callback(uint8_t status, uint16_t length,
 
 	free(adv_data);
 	free(scan_rsp);
-	adv_data = NULL;
-	scan_rsp = NULL;
+
+	return cp;
+}
+
+static void add_adv_params_callback(uint8_t status, uint16_t length,
+					  const void *param, void *user_data)
+{
+	struct btd_adv_client *client = user_data;
+	const struct mgmt_rp_add_ext_adv_params *rp = param;
+	struct mgmt_cp_add_ext_adv_data *cp;
+	uint16_t param_len;
+	unsigned int mgmt_ret;
+	dbus_int16_t tx_power;
+
+	client->add_adv_id = 0;
+
+	if (status)
+		goto fail;
+
+	if (!param || length < sizeof(*rp)) {
+		status = MGMT_STATUS_FAILED;
+		goto fail;
+	}
+
+	DBG("Refreshing advertisement data: %s", client->path);
+
+	/* Update tx power held by client */
+	tx_power = rp->tx_power;
+	if (tx_power != ADV_TX_POWER_NO_PREFERENCE)
+		g_dbus_proxy_set_property_basic(client->proxy, "TxPower",
+				DBUS_TYPE_INT16, &tx_power, NULL, NULL, NULL);
+
+	client->instance = rp->instance;
+	client->max_adv_data_len = rp->max_adv_data_len;
+	client->max_scan_rsp_len = rp->max_scan_rsp_len;
+
+	cp = generate_ext_adv_data(client, &param_len);
+	if (!cp)
+		goto fail;
 
 	/* Submit request to update instance data */
 	mgmt_ret = mgmt_send(client->manager->mgmt, MGMT_OP_ADD_EXT_ADV_DATA,
@@ -1475,24 +1760,16 @@ static void add_adv_params_callback(uint8_t status, uint16_t length,
 
 	if (!mgmt_ret) {
 		error("Failed to add Advertising Data");
+		free(cp);
 		goto fail;
 	}
 
-	free(cp);
-	cp = NULL;
+	/* Keep what is on air so data only updates can be compared */
+	client_set_ext_data(client, cp, param_len);
 
 	return;
 
 fail:
-	if (adv_data)
-		free(adv_data);
-
-	if (scan_rsp)
-		free(scan_rsp);
-
-	if (cp)
-		free(cp);
-
 	if (!status)
 		status = -EINVAL;
 
@@ -1500,6 +1777,82 @@ fail:
 	add_client_complete(client, status);
 }
 
+static int refresh_extended_adv_data(struct btd_adv_client *client)
+{
+	struct mgmt_cp_add_ext_adv_data *cp;
+	uint16_t param_len;
+
+	cp = generate_ext_adv_data(client, &param_len);
+	if (!cp)
+		return -EINVAL;
+
+	if (param_len == client->ext_data_len &&
+				!memcmp(cp, client->ext_data, param_len)) {
+		DBG("Advertisement data unchanged: %s", client->path);
+		free(cp);
+		return 0;
+	}
+
+	DBG("Refreshing advertisement data only: %s", client->path);
+
+	if (!mgmt_send(client->manager->mgmt, MGMT_OP_ADD_EXT_ADV_DATA,
+				client->manager->mgmt_index, param_len, cp,
+				NULL, NULL, NULL)) {
+		error("Failed to add Advertising Data");
+		free(cp);
+		return -EINVAL;
+	}
+
+	client_set_ext_data(client, cp, param_len);
+
+	return 0;
+}
+
+static bool client_refresh_cb(void *user_data)
+{
+	struct btd_adv_client *client = user_data;
+	uint32_t flags;
+
+	/* Wait for requests in flight, they may change the instance */
+	if (client->add_adv_id)
+		return true;
+
+	client->refresh_id = 0;
+
+	flags = get_adv_flags(client);
+
+	/* The parameters need to be set again if the flags changed or the
+	 * set stopped or started being scannable.
+	 */
+	if (client->refresh_params || !client->ext_data ||
+			!client->manager->extended_add_cmds ||
+			flags != client->ext_flags ||
+			adv_client_has_scan_response(client, flags) !=
+							client->scannable) {
+		client->refresh_params = false;
+		refresh_advertisement(client, NULL);
+		return false;
+	}
+
+	if (client->instance)
+		refresh_extended_adv_data(client);
+
+	return false;
+}
+
+static void client_schedule_refresh(struct btd_adv_client *client,
+								bool params)
+{
+	if (params)
+		client->refresh_params = true;
+
+	/* Coalesce bursts of property changes into a single update */
+	if (!client->refresh_id)
+		client->refresh_id = timeout_add(ADV_REFRESH_DELAY,
+						client_refresh_cb, client,
+						NULL);
+}
+
 static DBusMessage *parse_advertisement(struct btd_adv_client *client)
 {
 	struct adv_parser *parser;
@@ -1559,6 +1912,30 @@ static DBusMessage *parse_advertisement(struct btd_adv_client *client)
 		goto fail;
 	}
 
+	if (!client->instance) {
+		uint32_t flags = get_adv_flags(client);
+		uint8_t *adv_data;
+		size_t adv_data_len;
+
+		adv_data = generate_adv_data(client, &flags, &adv_data_len);
+		free(adv_data);
+
+		if (!adv_data ||
+			adv_data_len > calc_max_adv_len(client, flags)) {
+			error("Advertising data too long or couldn't be "
+								"generated.");
+			goto fail;
+		}
+
+		DBG("No instance available, rotating %s", client->path);
+
+		client_registered(client);
+		add_client_complete(client, MGMT_STATUS_SUCCESS);
+		manager_schedule(client->manager);
+
+		return NULL;
+	}
+
 	err = refresh_advertisement(client, add_adv_callback);
 
 	if (!err)
@@ -1642,6 +2019,7 @@ static struct btd_adv_client *client_create(struct btd_adv_manager *manager,
 	client->tx_power = ADV_TX_POWER_NO_PREFERENCE;
 	client->min_interval = 0;
 	client->max_interval = 0;
+	client->duty_cycle = ADV_DUTY_CYCLE_MAX;
 
 	client->refresh_done_func = NULL;
 
@@ -1688,12 +2066,18 @@ static DBusMessage *register_advertisement(DBusConnection *conn,
 
 	client->instance = util_get_uid(&manager->instance_bitmap,
 							manager->max_ads);
-	if (!client->instance) {
+	if (!client->instance && !rotation_enabled(manager)) {
 		client_free(client);
 		return btd_error_not_permitted(msg,
 					"Maximum advertisements reached");
 	}
 
+	/* Start along the others so it neither waits nor hogs the air */
+	client->pass = UINT_MAX;
+	queue_foreach(manager->clients, min_pass, &client->pass);
+	if (client->pass == UINT_MAX)
+		client->pass = 0;
+
 	DBG("Registered advertisement at path %s", match.path);
 
 	client->reg = dbus_message_ref(msg);
@@ -1739,7 +2123,10 @@ static gboolean get_instances(const GDBusPropertyTable *property,
 	struct btd_adv_manager *manager = data;
 	uint8_t instances;
 
-	instances = manager->max_ads - queue_length(manager->clients);
+	if (queue_length(manager->clients) >= manager->max_ads)
+		instances = 0;
+	else
+		instances = manager->max_ads - queue_length(manager->clients);
 
 	dbus_message_iter_append_basic(iter, DBUS_TYPE_BYTE, &instances);
 
@@ -1922,6 +2309,9 @@ static void manager_destroy(void *user_data)
 {
 	struct btd_adv_manager *manager = user_data;
 
+	if (manager->rotate_id)
+		timeout_remove(manager->rotate_id);
+
 	queue_destroy(manager->clients, client_destroy);
 
 	mgmt_unref(manager->mgmt);
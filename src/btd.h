@@ -30,6 +30,14 @@ enum jw_repairing_t {
 	JW_REPAIRING_ALWAYS,
 };
 
+enum le_phy_t {
+	LE_PHY_DEFAULT,
+	LE_PHY_AUTO,
+	LE_PHY_1M,
+	LE_PHY_2M,
+	LE_PHY_CODED,
+};
+
 enum mps_mode_t {
 	MPS_OFF,
 	MPS_SINGLE,
@@ -115,6 +123,7 @@ struct btd_avdtp_opts {
 struct btd_avrcp_opts {
 	bool		volume_without_target;
 	bool		volume_category;
+	uint32_t	position_interval;
 };
 
 struct btd_advmon_opts {
@@ -128,9 +137,14 @@ struct btd_opts {
 	uint32_t	pairto;
 	uint32_t	discovto;
 	uint32_t	tmpto;
+	uint32_t	sdp_cache_timeout;
 	uint8_t		privacy;
 	bool		device_privacy;
 	uint32_t	name_request_retry_delay;
+	uint32_t	prop_interval;
+	uint32_t	storage_delay;
+	bool		adapter_threads;
+	uint8_t		rssi_threshold;
 	uint8_t		secure_conn;
 
 	struct btd_defaults defaults;
@@ -155,6 +169,8 @@ struct btd_opts {
 	uint16_t	gatt_mtu;
 	uint8_t		gatt_channels;
 	bool		gatt_client;
+	bool		gatt_adaptive_conn;
+	bool		gatt_adaptive_chans;
 	enum bt_gatt_export_t gatt_export;
 	enum mps_mode_t	mps;
 
@@ -165,6 +181,8 @@ struct btd_opts {
 
 	enum jw_repairing_t jw_repairing;
 
+	enum le_phy_t	le_phy;
+
 	struct btd_advmon_opts	advmon;
 
 	struct btd_csis csis;
@@ -23,6 +23,7 @@
 #include <dirent.h>
 #include <time.h>
 #include <limits.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 
 #include <glib.h>
@@ -75,7 +76,34 @@
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #endif
 
-#define RSSI_THRESHOLD		8
+#define STORE_INFO_DELAY	1000	/* ms */
+
+/* Adaptive connection parameters, see AdaptiveConnection in main.conf */
+#define CONN_TUNE_PERIOD	1	/* seconds */
+#define CONN_TUNE_BURST_RATE	1024	/* ATT bytes per second */
+#define CONN_TUNE_IDLE_PERIODS	5
+#define CONN_TUNE_MIN_INTERVAL	0x0006	/* 7.5 ms */
+#define CONN_TUNE_MAX_INTERVAL	0x000c	/* 15 ms */
+
+/* Adaptive EATT channels, see AdaptiveChannels in main.conf */
+#define EATT_TUNE_PERIOD	1	/* seconds */
+#define EATT_TUNE_BUSY_WAITS	4	/* Queued requests per period */
+#define EATT_TUNE_IDLE_PERIODS	10
+#define EATT_TUNE_ADD_PERIODS	5	/* To connect a new channel */
+#define EATT_TUNE_MIN_CHANNELS	2
+#define EATT_TUNE_MIN_MTU	64
+
+/* Below this RSSI the auto PHY policy prefers range over throughput */
+#define LE_PHY_CODED_RSSI	-80
+
+#define LE_PHY_ALL	(BT_PHY_LE_1M_TX | BT_PHY_LE_1M_RX | \
+			BT_PHY_LE_2M_TX | BT_PHY_LE_2M_RX | \
+			BT_PHY_LE_CODED_TX | BT_PHY_LE_CODED_RX)
+
+#define PROP_RSSI		BIT(0)
+#define PROP_TX_POWER		BIT(1)
+#define PROP_MANUFACTURER_DATA	BIT(2)
+#define PROP_SERVICE_DATA	BIT(3)
 
 static DBusConnection *dbus_conn = NULL;
 static unsigned service_state_cb_id;
@@ -188,6 +216,24 @@ enum {
 	WAKE_FLAG_DISABLED,
 };
 
+struct conn_tune {
+	unsigned int timer;
+	uint64_t bytes;
+	uint8_t idle;
+	bool fast;
+	uint16_t min_interval;
+	uint16_t max_interval;
+	uint16_t latency;
+	uint16_t timeout;
+};
+
+struct eatt_tune {
+	unsigned int timer;
+	unsigned int waits;
+	uint8_t idle;
+	uint8_t adding;
+};
+
 struct btd_device {
 	int ref_count;
 
@@ -221,6 +267,8 @@ struct btd_device {
 	GSList		*svc_callbacks;
 	GSList		*eir_uuids;
 	struct bt_ad	*ad;
+	uint8_t		*adv_data;		/* Last applied report */
+	uint8_t		adv_data_len;
 	uint8_t         ad_flags[1];
 	char		name[MAX_NAME_LENGTH + 1];
 	char		*alias;
@@ -242,6 +290,8 @@ struct btd_device {
 	unsigned int	disconn_timer;
 	unsigned int	discov_timer;
 	unsigned int	temporary_timer;	/* Temporary/disappear timer */
+	unsigned int	props_timer;		/* Property update rate limit */
+	uint8_t		props_pending;
 	struct browse_req *browse;		/* service discover request */
 	struct bonding_req *bonding;
 	struct authentication_req *authr;	/* authentication request */
@@ -252,7 +302,12 @@ struct btd_device {
 
 	struct bt_att *att;			/* The new ATT transport */
 	uint16_t att_mtu;			/* The ATT MTU */
+	uint16_t conn_interval;			/* Connection interval hint */
 	unsigned int att_disconn_id;
+	struct conn_tune *tune;			/* Adaptive parameters */
+	struct eatt_tune *eatt_tune;		/* Adaptive EATT channels */
+	enum le_phy_t	le_phy;			/* Preferred PHY */
+	unsigned int	le_phy_reqs;
 
 	/*
 	 * TODO: For now, device creates and owns the client-role gatt_db, but
@@ -261,6 +316,7 @@ struct btd_device {
 	 */
 	struct gatt_db *db;			/* GATT db cache */
 	unsigned int db_id;
+	struct gatt_db_cache *db_cache;		/* Shared by DB Hash */
 	struct bt_gatt_client *client;		/* GATT client instance */
 	struct bt_gatt_server *server;		/* GATT server instance */
 	unsigned int gatt_ready_id;
@@ -288,13 +344,21 @@ struct btd_device {
 	int8_t		tx_power;
 
 	GIOChannel	*att_io;
-	guint		store_id;
+	unsigned int	store_id;
 
 	time_t		name_resolve_failed_time;
 
 	int8_t		volume;
 };
 
+static const char *le_phy_str[] = {
+	[LE_PHY_DEFAULT] = "default",
+	[LE_PHY_AUTO] = "auto",
+	[LE_PHY_1M] = "1M",
+	[LE_PHY_2M] = "2M",
+	[LE_PHY_CODED] = "coded",
+};
+
 static const uint16_t uuid_list[] = {
 	L2CAP_UUID,
 	PNP_INFO_SVCLASS_ID,
@@ -448,7 +512,7 @@ static void store_sirk(struct sirk_info *sirk, GKeyFile *key_file,
 	g_key_file_set_integer(key_file, group, "Rank", sirk->rank);
 }
 
-static gboolean store_device_info_cb(gpointer user_data)
+static bool store_device_info_cb(gpointer user_data)
 {
 	struct btd_device *device = user_data;
 	GKeyFile *key_file;
@@ -469,7 +533,7 @@ static gboolean store_device_info_cb(gpointer user_data)
 	create_file(filename, 0600);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -513,6 +577,13 @@ static gboolean store_device_info_cb(gpointer user_data)
 					       WAKE_FLAG_ENABLED);
 	}
 
+	if (device->le_phy != LE_PHY_DEFAULT)
+		g_key_file_set_string(key_file, "General", "PreferredPHY",
+						le_phy_str[device->le_phy]);
+	else
+		g_key_file_remove_key(key_file, "General", "PreferredPHY",
+									NULL);
+
 	if (device->uuids) {
 		GSList *l;
 		int i;
@@ -558,7 +629,7 @@ static gboolean store_device_info_cb(gpointer user_data)
 	}
 
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -569,7 +640,7 @@ static gboolean store_device_info_cb(gpointer user_data)
 	g_key_file_free(key_file);
 	g_free(uuids);
 
-	return FALSE;
+	return false;
 }
 
 bool device_address_is_private(struct btd_device *dev)
@@ -597,7 +668,11 @@ static void store_device_info(struct btd_device *device)
 		return;
 	}
 
-	device->store_id = g_idle_add(store_device_info_cb, device);
+	/* Updates tend to come in bursts, e.g. while connecting, so write
+	 * them all at once after a short delay.
+	 */
+	device->store_id = timeout_add(STORE_INFO_DELAY, store_device_info_cb,
+								device, NULL);
 }
 
 void device_store_cached_name(struct btd_device *dev, const char *name)
@@ -623,7 +698,7 @@ void device_store_cached_name(struct btd_device *dev, const char *name)
 	create_file(filename, 0600);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -636,7 +711,7 @@ void device_store_cached_name(struct btd_device *dev, const char *name)
 	data = g_key_file_to_data(key_file, &length, NULL);
 
 	if ((length != length_old) || (memcmp(data, data_old, length))) {
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_clear_error(&gerr);
@@ -672,7 +747,7 @@ static void device_store_cached_name_resolve(struct btd_device *dev)
 	create_file(filename, 0600);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -688,7 +763,7 @@ static void device_store_cached_name_resolve(struct btd_device *dev)
 	data = g_key_file_to_data(key_file, &length, NULL);
 
 	if ((length != length_old) || (memcmp(data, data_old, length))) {
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -732,6 +807,116 @@ static bool gatt_cache_is_enabled(struct btd_device *device)
 	}
 }
 
+/*
+ * Databases of peers exposing a Database Hash are kept once per hash so that
+ * other peers reporting the same hash can skip discovery.
+ */
+struct gatt_db_cache {
+	uint8_t hash[16];
+	struct gatt_db *db;
+	int ref_count;
+};
+
+static struct queue *db_caches = NULL;
+
+static bool match_db_cache(const void *data, const void *match_data)
+{
+	const struct gatt_db_cache *cache = data;
+
+	return !memcmp(cache->hash, match_data, sizeof(cache->hash));
+}
+
+static void db_cache_unref(struct gatt_db_cache *cache)
+{
+	if (!cache || --cache->ref_count)
+		return;
+
+	queue_remove(db_caches, cache);
+	if (queue_isempty(db_caches)) {
+		queue_destroy(db_caches, NULL);
+		db_caches = NULL;
+	}
+
+	gatt_db_unref(cache->db);
+	free(cache);
+}
+
+static void db_hash_read_value(struct gatt_db_attribute *attrib, int err,
+					const uint8_t *value, size_t length,
+					void *user_data)
+{
+	const uint8_t **hash = user_data;
+
+	if (err || length != 16)
+		return;
+
+	*hash = value;
+}
+
+static void db_hash_find(struct gatt_db_attribute *attrib, void *user_data)
+{
+	struct gatt_db_attribute **attr = user_data;
+
+	if (!*attr)
+		*attr = attrib;
+}
+
+static void device_update_db_cache(struct btd_device *device)
+{
+	struct gatt_db_attribute *attr = NULL;
+	struct gatt_db_cache *cache;
+	const uint8_t *hash = NULL;
+	bt_uuid_t uuid;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_DB_HASH);
+	gatt_db_find_by_type(device->db, 0x0001, 0xffff, &uuid, db_hash_find,
+									&attr);
+	if (attr)
+		gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
+						db_hash_read_value, &hash);
+
+	if (device->db_cache) {
+		if (hash && !memcmp(device->db_cache->hash, hash, 16))
+			return;
+
+		db_cache_unref(device->db_cache);
+		device->db_cache = NULL;
+	}
+
+	if (!hash)
+		return;
+
+	cache = queue_find(db_caches, match_db_cache, hash);
+	if (!cache) {
+		cache = new0(struct gatt_db_cache, 1);
+		memcpy(cache->hash, hash, sizeof(cache->hash));
+		cache->db = gatt_db_clone(device->db);
+
+		if (!db_caches)
+			db_caches = queue_new();
+
+		queue_push_tail(db_caches, cache);
+	}
+
+	cache->ref_count++;
+	device->db_cache = cache;
+}
+
+static struct gatt_db *gatt_db_cache_lookup(const uint8_t *hash,
+							void *user_data)
+{
+	struct btd_device *device = user_data;
+	struct gatt_db_cache *cache;
+
+	cache = queue_find(db_caches, match_db_cache, hash);
+	if (!cache)
+		return NULL;
+
+	DBG("%s: using database shared by DB Hash", device->path);
+
+	return cache->db;
+}
+
 static void gatt_cache_cleanup(struct btd_device *device)
 {
 	if (gatt_cache_is_enabled(device))
@@ -772,8 +957,14 @@ static void gatt_server_cleanup(struct btd_device *device)
 	device->server = NULL;
 }
 
+static void conn_tune_stop(struct btd_device *device);
+static void eatt_tune_stop(struct btd_device *device);
+
 static void attio_cleanup(struct btd_device *device)
 {
+	conn_tune_stop(device);
+	eatt_tune_stop(device);
+
 	if (device->att_disconn_id)
 		bt_att_unregister_disconnect(device->att,
 							device->att_disconn_id);
@@ -831,6 +1022,12 @@ static void device_free(gpointer user_data)
 {
 	struct btd_device *device = user_data;
 
+	/* Don't lose updates still waiting to be stored */
+	if (device->store_id) {
+		timeout_remove(device->store_id);
+		store_device_info_cb(device);
+	}
+
 	btd_gatt_client_destroy(device->client_dbus);
 	device->client_dbus = NULL;
 
@@ -843,9 +1040,11 @@ static void device_free(gpointer user_data)
 
 	attio_cleanup(device);
 
+	db_cache_unref(device->db_cache);
 	gatt_db_unref(device->db);
 
 	bt_ad_unref(device->ad);
+	free(device->adv_data);
 
 	if (device->tmp_records)
 		sdp_list_free(device->tmp_records,
@@ -860,6 +1059,9 @@ static void device_free(gpointer user_data)
 	if (device->temporary_timer)
 		timeout_remove(device->temporary_timer);
 
+	if (device->props_timer)
+		timeout_remove(device->props_timer);
+
 	if (device->connect)
 		dbus_message_unref(device->connect);
 
@@ -2285,6 +2487,60 @@ void device_add_eir_uuids(struct btd_device *dev, GSList *uuids)
 	device_probe_profiles(dev, added);
 }
 
+static void emit_props(struct btd_device *dev, uint8_t props)
+{
+	if (props & PROP_RSSI)
+		g_dbus_emit_property_changed(dbus_conn, dev->path,
+						DEVICE_INTERFACE, "RSSI");
+
+	if (props & PROP_TX_POWER)
+		g_dbus_emit_property_changed(dbus_conn, dev->path,
+						DEVICE_INTERFACE, "TxPower");
+
+	if (props & PROP_MANUFACTURER_DATA)
+		g_dbus_emit_property_changed(dbus_conn, dev->path,
+					DEVICE_INTERFACE, "ManufacturerData");
+
+	if (props & PROP_SERVICE_DATA)
+		g_dbus_emit_property_changed(dbus_conn, dev->path,
+					DEVICE_INTERFACE, "ServiceData");
+}
+
+static bool props_timeout(gpointer user_data)
+{
+	struct btd_device *dev = user_data;
+
+	/* Stop once an interval passes without updates */
+	if (!dev->props_pending) {
+		dev->props_timer = 0;
+		return false;
+	}
+
+	emit_props(dev, dev->props_pending);
+	dev->props_pending = 0;
+
+	return true;
+}
+
+/*
+ * Properties updated by advertising reports are signalled at most once per
+ * PropertyUpdateInterval; updates in between are merged into a single
+ * PropertiesChanged carrying the latest values.
+ */
+static void device_props_changed(struct btd_device *dev, uint8_t props)
+{
+	if (dev->props_timer) {
+		dev->props_pending |= props;
+		return;
+	}
+
+	emit_props(dev, props);
+
+	if (btd_opts.prop_interval)
+		dev->props_timer = timeout_add(btd_opts.prop_interval,
+						props_timeout, dev, NULL);
+}
+
 static void add_manufacturer_data(void *data, void *user_data)
 {
 	struct eir_msd *msd = data;
@@ -2294,8 +2550,7 @@ static void add_manufacturer_data(void *data, void *user_data)
 								msd->data_len))
 		return;
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-					DEVICE_INTERFACE, "ManufacturerData");
+	device_props_changed(dev, PROP_MANUFACTURER_DATA);
 }
 
 void device_set_manufacturer_data(struct btd_device *dev, GSList *list,
@@ -2324,8 +2579,7 @@ static void add_service_data(void *data, void *user_data)
 	device_add_eir_uuids(dev, l);
 	g_slist_free(l);
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-					DEVICE_INTERFACE, "ServiceData");
+	device_props_changed(dev, PROP_SERVICE_DATA);
 }
 
 void device_set_service_data(struct btd_device *dev, GSList *list,
@@ -2360,6 +2614,21 @@ void device_set_data(struct btd_device *dev, GSList *list,
 	g_slist_foreach(list, add_data, dev);
 }
 
+bool device_adv_data_equal(struct btd_device *dev, const uint8_t *data,
+								uint8_t len)
+{
+	return dev->adv_data && dev->adv_data_len == len &&
+					!memcmp(dev->adv_data, data, len);
+}
+
+void device_store_adv_data(struct btd_device *dev, const uint8_t *data,
+								uint8_t len)
+{
+	free(dev->adv_data);
+	dev->adv_data = len ? util_memdup(data, len) : NULL;
+	dev->adv_data_len = len;
+}
+
 static struct btd_service *find_connectable_service(struct btd_device *dev,
 							const char *uuid)
 {
@@ -2832,7 +3101,7 @@ static void store_services(struct btd_device *device)
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -2844,6 +3113,31 @@ static void store_services(struct btd_device *device)
 	g_key_file_free(key_file);
 }
 
+static void remove_cached_attributes(const char *filename)
+{
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+	char *data;
+	gsize length = 0;
+
+	key_file = g_key_file_new();
+	if (!btd_storage_load(key_file, filename, NULL) ||
+			!g_key_file_remove_group(key_file, "Attributes", NULL)) {
+		g_key_file_free(key_file);
+		return;
+	}
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	if (!btd_storage_save(filename, data, length, &gerr)) {
+		error("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+
+	g_free(data);
+	g_key_file_free(key_file);
+}
+
 static void store_gatt_db(struct btd_device *device)
 {
 	char filename[PATH_MAX];
@@ -2860,12 +3154,19 @@ static void store_gatt_db(struct btd_device *device)
 
 	ba2str(&device->bdaddr, dst_addr);
 
-	create_filename(filename, PATH_MAX, "/%s/cache/%s",
+	create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt",
 				btd_adapter_get_storage_dir(device->adapter),
 				dst_addr);
 	create_file(filename, 0600);
 
-	btd_settings_gatt_db_store(device->db, filename);
+	if (btd_settings_gatt_db_store_cache(device->db, filename) < 0)
+		return;
+
+	/* Drop attributes stored by older versions in the cache file */
+	create_filename(filename, PATH_MAX, "/%s/cache/%s",
+				btd_adapter_get_storage_dir(device->adapter),
+				dst_addr);
+	remove_cached_attributes(filename);
 }
 
 static void browse_request_complete(struct browse_req *req, uint8_t type,
@@ -3467,6 +3768,175 @@ dev_property_prefer_bearer_exists(const GDBusPropertyTable *property,
 	return device_prefer_bearer_str(device) != NULL;
 }
 
+static uint32_t device_le_phys(struct btd_device *dev)
+{
+	enum le_phy_t phy = dev->le_phy;
+
+	if (phy == LE_PHY_DEFAULT)
+		phy = btd_opts.le_phy;
+
+	switch (phy) {
+	case LE_PHY_AUTO:
+		if (dev->rssi && dev->rssi < LE_PHY_CODED_RSSI)
+			return BT_PHY_LE_CODED_TX | BT_PHY_LE_CODED_RX;
+		return BT_PHY_LE_2M_TX | BT_PHY_LE_2M_RX;
+	case LE_PHY_1M:
+		return BT_PHY_LE_1M_TX | BT_PHY_LE_1M_RX;
+	case LE_PHY_2M:
+		return BT_PHY_LE_2M_TX | BT_PHY_LE_2M_RX;
+	case LE_PHY_CODED:
+		return BT_PHY_LE_CODED_TX | BT_PHY_LE_CODED_RX;
+	case LE_PHY_DEFAULT:
+		break;
+	}
+
+	return 0;
+}
+
+/* PHYs the controller or peer don't support are simply not selected */
+static void device_set_le_phys(struct btd_device *dev, uint32_t phys)
+{
+	int fd;
+
+	if (!dev->att || bt_att_get_link_type(dev->att) != BT_ATT_LE)
+		return;
+
+	fd = bt_att_get_fd(dev->att);
+	if (fd < 0)
+		return;
+
+	if (setsockopt(fd, SOL_BLUETOOTH, BT_PHY, &phys, sizeof(phys)) < 0) {
+		DBG("Unable to set LE PHYs 0x%08x: %s", phys, strerror(errno));
+		return;
+	}
+
+	dev->le_phy_reqs++;
+}
+
+static bool le_phy_parse(const char *str, enum le_phy_t *phy)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(le_phy_str); i++) {
+		if (!strcasecmp(str, le_phy_str[i])) {
+			*phy = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static gboolean
+dev_property_get_prefer_phy(const GDBusPropertyTable *property,
+				DBusMessageIter *iter, void *data)
+{
+	struct btd_device *device = data;
+	const char *str = le_phy_str[device->le_phy];
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &str);
+
+	return TRUE;
+}
+
+static void
+dev_property_set_prefer_phy(const GDBusPropertyTable *property,
+					DBusMessageIter *value,
+					GDBusPendingPropertySet id, void *data)
+{
+	struct btd_device *device = data;
+	enum le_phy_t phy;
+	uint32_t phys;
+	const char *str;
+
+	if (dbus_message_iter_get_arg_type(value) != DBUS_TYPE_STRING) {
+		g_dbus_pending_property_error(id,
+					ERROR_INTERFACE ".InvalidArguments",
+					"Invalid arguments in method call");
+		return;
+	}
+
+	dbus_message_iter_get_basic(value, &str);
+
+	if (!le_phy_parse(str, &phy)) {
+		g_dbus_pending_property_error(id,
+					ERROR_INTERFACE ".InvalidArguments",
+					"Invalid arguments in method call");
+		return;
+	}
+
+	if (device->le_phy == phy)
+		goto done;
+
+	device->le_phy = phy;
+
+	/* Without a preference let the controllers pick any PHY again */
+	phys = device_le_phys(device);
+	device_set_le_phys(device, phys ? phys : LE_PHY_ALL);
+
+	store_device_info(device);
+
+	g_dbus_emit_property_changed(dbus_conn, device->path,
+					DEVICE_INTERFACE, "PreferredPHY");
+
+done:
+	g_dbus_pending_property_success(id);
+}
+
+static gboolean dev_property_le_exists(const GDBusPropertyTable *property,
+								void *data)
+{
+	struct btd_device *device = data;
+
+	return device->le;
+}
+
+static gboolean dev_property_get_phys(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct btd_device *device = data;
+	static const struct {
+		uint32_t bit;
+		const char *str;
+	} phys_str[] = {
+		{ BT_PHY_LE_1M_TX, "LE1MTX" },
+		{ BT_PHY_LE_1M_RX, "LE1MRX" },
+		{ BT_PHY_LE_2M_TX, "LE2MTX" },
+		{ BT_PHY_LE_2M_RX, "LE2MRX" },
+		{ BT_PHY_LE_CODED_TX, "LECODEDTX" },
+		{ BT_PHY_LE_CODED_RX, "LECODEDRX" },
+	};
+	DBusMessageIter array;
+	uint32_t phys = 0;
+	socklen_t len = sizeof(phys);
+	size_t i;
+
+	getsockopt(bt_att_get_fd(device->att), SOL_BLUETOOTH, BT_PHY, &phys,
+									&len);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					DBUS_TYPE_STRING_AS_STRING, &array);
+
+	for (i = 0; i < ARRAY_SIZE(phys_str); i++) {
+		if (phys & phys_str[i].bit)
+			dbus_message_iter_append_basic(&array,
+							DBUS_TYPE_STRING,
+							&phys_str[i].str);
+	}
+
+	dbus_message_iter_close_container(iter, &array);
+
+	return TRUE;
+}
+
+static gboolean dev_property_phys_exists(const GDBusPropertyTable *property,
+								void *data)
+{
+	struct btd_device *device = data;
+
+	return device->att && bt_att_get_link_type(device->att) == BT_ATT_LE;
+}
+
 static const GDBusPropertyTable device_properties[] = {
 	{ "Address", "s", dev_property_get_address },
 	{ "AddressType", "s", property_get_address_type },
@@ -3509,6 +3979,59 @@ static const GDBusPropertyTable device_properties[] = {
 				dev_property_set_prefer_bearer,
 				dev_property_prefer_bearer_exists,
 				G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ "PreferredPHY", "s", dev_property_get_prefer_phy,
+				dev_property_set_prefer_phy,
+				dev_property_le_exists,
+				G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ "PHYs", "as", dev_property_get_phys, NULL,
+				dev_property_phys_exists,
+				G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ }
+};
+
+static gboolean dev_property_get_counters(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct btd_device *device = data;
+	struct bt_att_chan_stats stats;
+	DBusMessageIter dict;
+	dbus_uint32_t value;
+
+	if (!bt_att_get_stats(device->att, &stats))
+		memset(&stats, 0, sizeof(stats));
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+
+	dict_append_entry(&dict, "AttTxPdus", DBUS_TYPE_UINT64,
+							&stats.tx_pdus);
+	dict_append_entry(&dict, "AttTxBytes", DBUS_TYPE_UINT64,
+							&stats.tx_bytes);
+	dict_append_entry(&dict, "AttRxPdus", DBUS_TYPE_UINT64,
+							&stats.rx_pdus);
+	dict_append_entry(&dict, "AttRxBytes", DBUS_TYPE_UINT64,
+							&stats.rx_bytes);
+
+	value = stats.reqs;
+	dict_append_entry(&dict, "AttRequests", DBUS_TYPE_UINT32, &value);
+	value = stats.inds;
+	dict_append_entry(&dict, "AttIndications", DBUS_TYPE_UINT32, &value);
+	value = stats.timeouts;
+	dict_append_entry(&dict, "AttTimeouts", DBUS_TYPE_UINT32, &value);
+	value = device->le_phy_reqs;
+	dict_append_entry(&dict, "LePhyRequests", DBUS_TYPE_UINT32, &value);
+
+	dbus_message_iter_close_container(iter, &dict);
+
+	return TRUE;
+}
+
+static const GDBusPropertyTable statistics_properties[] = {
+	{ "Counters", "a{sv}", dev_property_get_counters },
 	{ }
 };
 
@@ -3755,7 +4278,7 @@ static char *load_cached_name(struct btd_device *device, const char *local,
 
 	key_file = g_key_file_new();
 
-	if (!g_key_file_load_from_file(key_file, filename, 0, NULL))
+	if (!btd_storage_load(key_file, filename, NULL))
 		goto failed;
 
 	str = g_key_file_get_string(key_file, "General", "Name", NULL);
@@ -3785,7 +4308,7 @@ static void load_cached_name_resolve(struct btd_device *device,
 
 	key_file = g_key_file_new();
 
-	if (!g_key_file_load_from_file(key_file, filename, 0, NULL))
+	if (!btd_storage_load(key_file, filename, NULL))
 		goto failed;
 
 	failed_time = g_key_file_get_uint64(key_file, "NameResolving",
@@ -3938,7 +4461,7 @@ static void convert_info(struct btd_device *device, GKeyFile *key_file)
 			device_addr);
 
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -4099,6 +4622,12 @@ next:
 		gerr = NULL;
 	}
 
+	str = g_key_file_get_string(key_file, "General", "PreferredPHY", NULL);
+	if (str) {
+		le_phy_parse(str, &device->le_phy);
+		g_free(str);
+	}
+
 	if (store_needed)
 		store_device_info(device);
 }
@@ -4124,7 +4653,7 @@ static void load_att_info(struct btd_device *device, const char *local,
 		return;
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -4237,16 +4766,26 @@ static void load_gatt_db(struct btd_device *device, const char *local,
 
 	DBG("Restoring %s gatt database from file", peer);
 
-	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
+	create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt", local, peer);
 
-	err = btd_settings_gatt_db_load(device->db, filename);
-	if (err < 0) {
+	err = btd_settings_gatt_db_load_cache(device->db, filename);
+	if (err == -ENOENT) {
+		/* Fallback to the attributes of older versions */
+		create_filename(filename, PATH_MAX, "/%s/cache/%s", local,
+									peer);
+
+		err = btd_settings_gatt_db_load(device->db, filename);
 		if (err == -ENOENT)
 			return;
 
+		/* Convert to the binary format */
+		if (!err)
+			store_gatt_db(device);
+	}
+
+	if (err < 0)
 		warn("Error loading db from cache for %s: %s (%d)", peer,
 						strerror(-err), err);
-	}
 
 	g_slist_free_full(device->primaries, g_free);
 	device->primaries = NULL;
@@ -4565,6 +5104,11 @@ static struct btd_device *device_new(struct btd_adapter *adapter,
 		return NULL;
 	}
 
+	if (g_dbus_get_flags() & G_DBUS_FLAG_ENABLE_EXPERIMENTAL)
+		g_dbus_register_interface(dbus_conn, device->path,
+					STATISTICS_INTERFACE, NULL, NULL,
+					statistics_properties, device, NULL);
+
 	device->adapter = adapter;
 	device->sirks = queue_new();
 	device->temporary = true;
@@ -4965,19 +5509,29 @@ static void device_remove_stored(struct btd_device *device)
 	if (device->blocked)
 		device_unblock(device, TRUE, FALSE);
 
+	bt_search_invalidate(btd_adapter_get_address(device->adapter),
+							&device->bdaddr);
+
 	ba2str(&device->bdaddr, device_addr);
 
 	create_filename(filename, PATH_MAX, "/%s/%s",
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
+	btd_storage_remove(filename);
 	delete_folder_tree(filename);
 
+	create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt",
+				btd_adapter_get_storage_dir(device->adapter),
+				device_addr);
+	btd_storage_remove(filename);
+	unlink(filename);
+
 	create_filename(filename, PATH_MAX, "/%s/cache/%s",
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		g_error_free(gerr);
 		g_key_file_free(key_file);
 		return;
@@ -4985,11 +5539,12 @@ static void device_remove_stored(struct btd_device *device)
 	g_key_file_remove_group(key_file, "ServiceRecords", NULL);
 	g_key_file_remove_group(key_file, "Attributes", NULL);
 	g_key_file_remove_group(key_file, "Endpoints", NULL);
+	g_key_file_remove_group(key_file, "ReportMap", NULL);
 
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
 		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
+		if (!btd_storage_save(filename, data, length, &gerr)) {
 			error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 			g_error_free(gerr);
@@ -5042,7 +5597,7 @@ void device_remove(struct btd_device *device, gboolean remove_stored)
 	clear_temporary_timer(device);
 
 	if (device->store_id > 0) {
-		g_source_remove(device->store_id);
+		timeout_remove(device->store_id);
 		device->store_id = 0;
 
 		if (!remove_stored)
@@ -5399,7 +5954,7 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 	create_file(sdp_file, 0600);
 
 	sdp_key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(sdp_key_file, sdp_file, 0, &gerr)) {
+	if (!btd_storage_load(sdp_key_file, sdp_file, &gerr)) {
 		error("Unable to load key file from %s: (%s)", sdp_file,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -5412,7 +5967,7 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 	create_file(att_file, 0600);
 
 	att_key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(att_key_file, att_file, 0, &gerr)) {
+	if (!btd_storage_load(att_key_file, att_file, &gerr)) {
 		error("Unable to load key file from %s: (%s)", att_file,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -5472,7 +6027,7 @@ next:
 	if (sdp_key_file) {
 		data = g_key_file_to_data(sdp_key_file, &length, NULL);
 		if (length > 0) {
-			if (!g_file_set_contents(sdp_file, data, length,
+			if (!btd_storage_save(sdp_file, data, length,
 								&gerr)) {
 				error("Unable set contents for %s: (%s)",
 						sdp_file, gerr->message);
@@ -5487,7 +6042,7 @@ next:
 	if (att_key_file) {
 		data = g_key_file_to_data(att_key_file, &length, NULL);
 		if (length > 0) {
-			if (!g_file_set_contents(att_file, data, length,
+			if (!btd_storage_save(att_file, data, length,
 								&gerr)) {
 				error("Unable set contents for %s: (%s)",
 						att_file, gerr->message);
@@ -5763,6 +6318,9 @@ static void gatt_client_ready_cb(bool success, uint8_t att_ecode,
 	device_svc_resolved(device, BROWSE_GATT, device->bdaddr_type, 0);
 
 	store_gatt_db(device);
+
+	if (gatt_cache_is_enabled(device))
+		device_update_db_cache(device);
 }
 
 static void gatt_client_service_changed(uint16_t start_handle,
@@ -5813,6 +6371,11 @@ static void gatt_client_init(struct btd_device *device)
 	bt_gatt_client_set_debug(device->client, gatt_debug, NULL, NULL);
 	g_attrib_attach_client(device->attrib, device->client);
 
+	if (gatt_cache_is_enabled(device))
+		bt_gatt_client_set_db_lookup(device->client,
+						gatt_db_cache_lookup, device,
+						NULL);
+
 	/*
 	 * If we have cache, notify existing service about the new connection
 	 * so they can react to notifications while discovering services
@@ -5870,6 +6433,7 @@ static void gatt_server_init(struct btd_device *device,
 		bt_att_set_enc_key_size(device->att, device->ltk->enc_size);
 
 	bt_gatt_server_set_debug(device->server, gatt_debug, NULL, NULL);
+	bt_gatt_server_set_conn_interval(device->server, device->conn_interval);
 
 	btd_gatt_database_server_connected(database, device->server);
 }
@@ -5902,6 +6466,210 @@ static bool remote_counter(uint32_t *sign_cnt, void *user_data)
 	return true;
 }
 
+static void conn_tune_set(struct btd_device *dev, bool fast)
+{
+	struct conn_tune *tune = dev->tune;
+
+	tune->fast = fast;
+
+	if (!fast) {
+		btd_device_set_conn_param(dev, tune->min_interval,
+						tune->max_interval,
+						tune->latency, tune->timeout);
+		return;
+	}
+
+	/* Prefer 2M while busy unless a PHY has been configured */
+	if (!device_le_phys(dev))
+		device_set_le_phys(dev, BT_PHY_LE_2M_TX | BT_PHY_LE_2M_RX);
+
+	btd_device_set_conn_param(dev, CONN_TUNE_MIN_INTERVAL,
+					CONN_TUNE_MAX_INTERVAL, 0,
+					tune->timeout);
+}
+
+static bool conn_tune_timeout(gpointer user_data)
+{
+	struct btd_device *dev = user_data;
+	struct conn_tune *tune = dev->tune;
+	struct bt_att_chan_stats stats;
+	uint64_t bytes;
+	unsigned int rate;
+
+	if (!bt_att_get_stats(dev->att, &stats))
+		return TRUE;
+
+	bytes = stats.tx_bytes + stats.rx_bytes;
+	rate = (bytes - tune->bytes) / CONN_TUNE_PERIOD;
+	tune->bytes = bytes;
+
+	if (rate >= CONN_TUNE_BURST_RATE) {
+		tune->idle = 0;
+
+		if (!tune->fast) {
+			DBG("%s %u bytes/s, requesting fast connection",
+							dev->path, rate);
+			conn_tune_set(dev, true);
+		}
+
+		return TRUE;
+	}
+
+	if (tune->fast && ++tune->idle >= CONN_TUNE_IDLE_PERIODS) {
+		DBG("%s idle, restoring connection parameters", dev->path);
+		conn_tune_set(dev, false);
+	}
+
+	return TRUE;
+}
+
+static void conn_tune_start(struct btd_device *dev)
+{
+	struct btd_le_defaults *le = &btd_opts.defaults.le;
+	struct conn_tune *tune;
+	struct bt_att_chan_stats stats;
+
+	if (!btd_opts.gatt_adaptive_conn || dev->tune)
+		return;
+
+	if (bt_att_get_link_type(dev->att) != BT_ATT_LE)
+		return;
+
+	tune = new0(struct conn_tune, 1);
+
+	/* Restore what the device has been using so far, or the defaults */
+	if (!btd_adapter_get_conn_param(dev->adapter, &dev->bdaddr,
+					dev->bdaddr_type, &tune->min_interval,
+					&tune->max_interval, &tune->latency,
+					&tune->timeout)) {
+		tune->min_interval = le->min_conn_interval ?
+					le->min_conn_interval : 0x0018;
+		tune->max_interval = le->max_conn_interval ?
+					le->max_conn_interval : 0x0028;
+		tune->latency = le->conn_latency;
+		tune->timeout = le->conn_lsto ? le->conn_lsto : 0x002a;
+	}
+
+	if (bt_att_get_stats(dev->att, &stats))
+		tune->bytes = stats.tx_bytes + stats.rx_bytes;
+
+	tune->timer = timeout_add_seconds(CONN_TUNE_PERIOD, conn_tune_timeout,
+								dev, NULL);
+	dev->tune = tune;
+}
+
+static void conn_tune_stop(struct btd_device *dev)
+{
+	struct conn_tune *tune = dev->tune;
+
+	if (!tune)
+		return;
+
+	timeout_remove(tune->timer);
+
+	/* Parameters loaded in the kernel are used for the next connection */
+	if (tune->fast)
+		conn_tune_set(dev, false);
+
+	free(tune);
+	dev->tune = NULL;
+}
+
+static uint16_t eatt_tune_mtu(struct btd_device *dev)
+{
+	struct bt_att_chan_stats stats;
+
+	/* Size new channels after the largest PDU seen so far */
+	if (!bt_att_get_stats(dev->att, &stats) ||
+				stats.max_pdu >= bt_att_get_mtu(dev->att))
+		return btd_opts.gatt_mtu;
+
+	return MIN(MAX(stats.max_pdu, EATT_TUNE_MIN_MTU), btd_opts.gatt_mtu);
+}
+
+static bool eatt_tune_timeout(gpointer user_data)
+{
+	struct btd_device *dev = user_data;
+	struct eatt_tune *tune = dev->eatt_tune;
+	unsigned int waits, delta;
+	int channels;
+
+	waits = bt_att_get_req_waits(dev->att);
+	delta = waits - tune->waits;
+	tune->waits = waits;
+
+	channels = bt_att_get_channels(dev->att);
+
+	if (tune->adding)
+		tune->adding--;
+
+	if (delta >= EATT_TUNE_BUSY_WAITS) {
+		tune->idle = 0;
+
+		if (tune->adding || channels >= btd_opts.gatt_channels)
+			return TRUE;
+
+		DBG("%s %u requests waited, adding EATT channel", dev->path,
+									delta);
+
+		if (btd_gatt_client_eatt_add(dev->client_dbus,
+						eatt_tune_mtu(dev)))
+			tune->adding = EATT_TUNE_ADD_PERIODS;
+
+		return TRUE;
+	}
+
+	if (delta) {
+		tune->idle = 0;
+		return TRUE;
+	}
+
+	if (channels <= EATT_TUNE_MIN_CHANNELS ||
+				++tune->idle < EATT_TUNE_IDLE_PERIODS)
+		return TRUE;
+
+	tune->idle = 0;
+
+	if (bt_att_close_idle_chan(dev->att))
+		DBG("%s idle, closing EATT channel", dev->path);
+
+	return TRUE;
+}
+
+static void eatt_tune_start(struct btd_device *dev)
+{
+	struct eatt_tune *tune;
+
+	if (!btd_opts.gatt_adaptive_chans || dev->eatt_tune)
+		return;
+
+	if (btd_opts.gatt_channels <= EATT_TUNE_MIN_CHANNELS)
+		return;
+
+	/* Only the initiator opens EATT channels, see gatt_client_init */
+	if (bt_att_get_link_type(dev->att) != BT_ATT_LE ||
+				!btd_device_is_initiator(dev))
+		return;
+
+	tune = new0(struct eatt_tune, 1);
+	tune->waits = bt_att_get_req_waits(dev->att);
+	tune->timer = timeout_add_seconds(EATT_TUNE_PERIOD, eatt_tune_timeout,
+								dev, NULL);
+	dev->eatt_tune = tune;
+}
+
+static void eatt_tune_stop(struct btd_device *dev)
+{
+	struct eatt_tune *tune = dev->eatt_tune;
+
+	if (!tune)
+		return;
+
+	timeout_remove(tune->timer);
+	free(tune);
+	dev->eatt_tune = NULL;
+}
+
 bool device_attach_att(struct btd_device *dev, GIOChannel *io)
 {
 	GError *gerr = NULL;
@@ -5912,6 +6680,7 @@ bool device_attach_att(struct btd_device *dev, GIOChannel *io)
 	struct btd_gatt_database *database;
 	const bdaddr_t *dst;
 	char dstaddr[18];
+	uint32_t phys;
 
 	bt_io_get(io, &gerr, BT_IO_OPT_SEC_LEVEL, &sec_level,
 						BT_IO_OPT_IMTU, &mtu,
@@ -5993,6 +6762,13 @@ bool device_attach_att(struct btd_device *dev, GIOChannel *io)
 	gatt_client_init(dev);
 	gatt_server_init(dev, database);
 
+	phys = device_le_phys(dev);
+	if (phys)
+		device_set_le_phys(dev, phys);
+
+	conn_tune_start(dev);
+	eatt_tune_start(dev);
+
 	/*
 	 * Remove the device from the connect_list and give the passive
 	 * scanning another chance to be restarted in case there are
@@ -6433,7 +7209,7 @@ void device_store_svc_chng_ccc(struct btd_device *device, uint8_t bdaddr_type,
 				device_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -6463,7 +7239,7 @@ void device_store_svc_chng_ccc(struct btd_device *device, uint8_t bdaddr_type,
 	create_file(filename, 0600);
 
 	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
+	if (!btd_storage_save(filename, str, length, &gerr)) {
 		error("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -6487,7 +7263,7 @@ void device_load_svc_chng_ccc(struct btd_device *device, uint16_t *ccc_le,
 				device_addr);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -6543,13 +7319,12 @@ void device_set_rssi_with_delta(struct btd_device *device, int8_t rssi,
 		device->rssi = rssi;
 	}
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "RSSI");
+	device_props_changed(device, PROP_RSSI);
 }
 
 void device_set_rssi(struct btd_device *device, int8_t rssi)
 {
-	device_set_rssi_with_delta(device, rssi, RSSI_THRESHOLD);
+	device_set_rssi_with_delta(device, rssi, btd_opts.rssi_threshold);
 }
 
 void device_set_tx_power(struct btd_device *device, int8_t tx_power)
@@ -6564,8 +7339,7 @@ void device_set_tx_power(struct btd_device *device, int8_t tx_power)
 
 	device->tx_power = tx_power;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "TxPower");
+	device_props_changed(device, PROP_TX_POWER);
 }
 
 void device_set_flags(struct btd_device *device, uint8_t flags)
@@ -7292,7 +8066,7 @@ bool btd_device_set_gatt_db(struct btd_device *device, struct gatt_db *db)
 		return false;
 
 	clone = gatt_db_clone(db);
-	if (clone)
+	if (!clone)
 		return false;
 
 	gatt_db_unregister(device->db, device->db_id);
@@ -7369,7 +8143,7 @@ static sdp_list_t *read_device_records(struct btd_device *device)
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -7469,6 +8243,8 @@ void btd_device_unref(struct btd_device *device)
 
 	DBG("Freeing device %s", device->path);
 
+	g_dbus_unregister_interface(dbus_conn, device->path,
+						STATISTICS_INTERFACE);
 	g_dbus_unregister_interface(dbus_conn, device->path, DEVICE_INTERFACE);
 }
 
@@ -7684,6 +8460,14 @@ void btd_device_set_conn_param(struct btd_device *device, uint16_t min_interval,
 					timeout);
 }
 
+void btd_device_set_conn_interval(struct btd_device *device,
+							uint16_t interval)
+{
+	device->conn_interval = interval;
+
+	bt_gatt_server_set_conn_interval(device->server, interval);
+}
+
 void btd_device_foreach_service_data(struct btd_device *dev, bt_ad_func_t func,
 							void *data)
 {
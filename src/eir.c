@@ -26,6 +26,7 @@
 #include "lib/sdp.h"
 
 #include "src/shared/util.h"
+#include "src/shared/ad.h"
 #include "uuid-helper.h"
 #include "eir.h"
 
@@ -241,36 +242,47 @@ static void eir_parse_data(struct eir_data *eir, uint8_t type,
 		eir->rsi = true;
 }
 
-void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+static bool eir_next(const uint8_t *eir_data, uint8_t eir_len,
+				uint16_t *offset, uint8_t *type,
+				const uint8_t **data, uint8_t *data_len)
 {
-	uint16_t len = 0;
-
-	eir->flags = 0;
-	eir->tx_power = 127;
+	const uint8_t *field;
+	uint8_t field_len;
 
 	/* No EIR data to parse */
-	if (eir_data == NULL)
-		return;
+	if (eir_data == NULL || *offset + 1 >= eir_len)
+		return false;
 
-	while (len < eir_len - 1) {
-		uint8_t field_len = eir_data[0];
-		const uint8_t *data;
-		uint8_t data_len;
+	field = &eir_data[*offset];
+	field_len = field[0];
 
-		/* Check for the end of EIR */
-		if (field_len == 0)
-			break;
+	/* Check for the end of EIR */
+	if (field_len == 0)
+		return false;
 
-		len += field_len + 1;
+	/* Do not continue EIR Data parsing if got incorrect length */
+	if (*offset + field_len + 1 > eir_len)
+		return false;
 
-		/* Do not continue EIR Data parsing if got incorrect length */
-		if (len > eir_len)
-			break;
+	*offset += field_len + 1;
+	*type = field[1];
+	*data = &field[2];
+	*data_len = field_len - 1;
 
-		data = &eir_data[2];
-		data_len = field_len - 1;
+	return true;
+}
+
+void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+{
+	uint16_t offset = 0;
+	const uint8_t *data;
+	uint8_t type, data_len;
+
+	eir->flags = 0;
+	eir->tx_power = 127;
 
-		switch (eir_data[1]) {
+	while (eir_next(eir_data, eir_len, &offset, &type, &data, &data_len)) {
+		switch (type) {
 		case EIR_UUID16_SOME:
 		case EIR_UUID16_ALL:
 			eir_parse_uuid16(eir, data, data_len);
@@ -301,7 +313,7 @@ void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
 			g_free(eir->name);
 
 			eir->name = name2utf8(data, data_len);
-			eir->name_complete = eir_data[1] == EIR_NAME_COMPLETE;
+			eir->name_complete = type == EIR_NAME_COMPLETE;
 			break;
 
 		case EIR_TX_POWER:
@@ -362,14 +374,98 @@ void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
 			break;
 
 		default:
-			eir_parse_data(eir, eir_data[1], data, data_len);
+			eir_parse_data(eir, type, data, data_len);
 			break;
 		}
+	}
+}
+
+void eir_peek(struct eir_peek *peek, const uint8_t *eir_data, uint8_t eir_len)
+{
+	uint16_t offset = 0;
+	const uint8_t *data;
+	uint8_t type, data_len;
 
-		eir_data += field_len + 1;
+	memset(peek, 0, sizeof(*peek));
+	peek->data = eir_data;
+	peek->len = eir_len;
+	peek->tx_power = 127;
+
+	while (eir_next(eir_data, eir_len, &offset, &type, &data, &data_len)) {
+		switch (type) {
+		case EIR_FLAGS:
+			if (data_len > 0)
+				peek->flags = *data;
+			break;
+
+		case EIR_NAME_SHORT:
+		case EIR_NAME_COMPLETE:
+			while (data_len > 0 && data[data_len - 1] == '\0')
+				data_len--;
+
+			/* eir_parse() rewrites names that are not valid UTF-8
+			 * so leave those for it to decide.
+			 */
+			peek->name_valid = g_utf8_validate((const char *) data,
+							data_len, NULL);
+			peek->name = data;
+			peek->name_len = data_len;
+			break;
+
+		case EIR_TX_POWER:
+			if (data_len < 1)
+				break;
+			peek->tx_power = (int8_t) data[0];
+			break;
+
+		case EIR_CSIP_RSI:
+			peek->rsi = true;
+			break;
+		}
 	}
 }
 
+struct peek_uuids {
+	const uint128_t *uuids;
+	size_t count;
+};
+
+static bool peek_uuid_match(const bt_uuid_t *uuid, void *user_data)
+{
+	const struct peek_uuids *set = user_data;
+	bt_uuid_t u128;
+
+	bt_uuid_to_uuid128(uuid, &u128);
+
+	return bt_uuid128_find(set->uuids, set->count, &u128.value.u128) >= 0;
+}
+
+bool eir_peek_match_uuids(const struct eir_peek *peek, const uint128_t *uuids,
+							size_t count)
+{
+	struct peek_uuids set = {
+		.uuids = uuids,
+		.count = count,
+	};
+
+	return bt_ad_view_foreach_uuid(peek->data, peek->len, peek_uuid_match,
+									&set);
+}
+
+bool eir_peek_has_service_data(const struct eir_peek *peek, const char *uuid)
+{
+	struct bt_ad_service_data sd;
+	bt_uuid_t match;
+
+	if (bt_string_to_uuid(&match, uuid) < 0)
+		return false;
+
+	if (!bt_ad_view_get_service_data(peek->data, peek->len, &match, &sd))
+		return false;
+
+	return sd.len + bt_uuid_len(&sd.uuid) <= EIR_SD_MAX_LEN;
+}
+
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len)
 {
 
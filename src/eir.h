@@ -92,6 +92,18 @@ struct eir_data {
 	GSList *data_list;
 };
 
+/* Allocation free view of the fields needed to filter reports */
+struct eir_peek {
+	const uint8_t *data;
+	uint8_t len;
+	unsigned int flags;
+	int8_t tx_power;
+	bool rsi;
+	const uint8_t *name;
+	uint8_t name_len;
+	bool name_valid;
+};
+
 void eir_data_free(struct eir_data *eir);
 void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len);
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len);
@@ -101,3 +113,7 @@ int eir_create_oob(const bdaddr_t *addr, const char *name, uint32_t cod,
 			uint16_t did_version, uint16_t did_source,
 			sdp_list_t *uuids, uint8_t *data);
 struct eir_sd *eir_get_service_data(struct eir_data *eir, const char *uuid);
+void eir_peek(struct eir_peek *peek, const uint8_t *eir_data, uint8_t eir_len);
+bool eir_peek_match_uuids(const struct eir_peek *peek, const uint128_t *uuids,
+							size_t count);
+bool eir_peek_has_service_data(const struct eir_peek *peek, const char *uuid);
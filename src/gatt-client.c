@@ -18,6 +18,10 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 
 #include <dbus/dbus.h>
 
@@ -86,9 +90,47 @@ struct async_dbus_op {
 	async_dbus_op_complete_t complete;
 };
 
+#define NOTIFY_BATCH_SIZE	4096
+#define NOTIFY_RING_SLOTS	64
+#define NOTIFY_RING_MAX_SLOTS	4096
+
+/* Channels opened on connection when AdaptiveChannels is enabled */
+#define EATT_ADAPTIVE_CHANNELS	2
+
+/* Shared memory layout of AcquireNotifyRing, in host byte order */
+struct notify_ring_hdr {
+	uint32_t slots;
+	uint32_t slot_size;
+	uint32_t head;		/* written by bluetoothd */
+	uint32_t tail;		/* written by the client */
+	uint32_t overflow;
+	uint32_t reserved[3];
+};
+
+struct notify_ring_slot {
+	uint32_t seq;
+	uint16_t len;
+	uint16_t reserved;
+	uint64_t timestamp;	/* CLOCK_MONOTONIC in nanoseconds */
+	uint8_t value[BT_ATT_MAX_VALUE_LEN];
+};
+
+struct notify_ring {
+	struct notify_ring_hdr *hdr;
+	size_t size;
+	int mem_fd;
+	int event_fd;
+	uint32_t seq;
+};
+
 struct sock_io {
 	DBusMessage *msg;
 	struct io *io;
+	unsigned int credits_id;
+	struct notify_ring *ring;
+	uint8_t *batch;
+	uint16_t batch_len;
+	guint batch_id;
 	void (*destroy)(void *data);
 	void *data;
 };
@@ -1127,6 +1169,20 @@ fail:
 	return btd_error_not_supported(msg);
 }
 
+static bool sock_read(struct io *io, void *user_data);
+
+static void sock_credits(unsigned int credits, void *user_data)
+{
+	struct characteristic *chrc = user_data;
+	struct bt_gatt_client *gatt = chrc->service->client->gatt;
+
+	bt_gatt_client_credits_unregister(gatt, chrc->write_io->credits_id);
+	chrc->write_io->credits_id = 0;
+
+	if (!io_set_read_handler(chrc->write_io->io, sock_read, chrc, NULL))
+		error("Unable to resume reading from %s", chrc->path);
+}
+
 static bool sock_read(struct io *io, void *user_data)
 {
 	struct characteristic *chrc = user_data;
@@ -1162,7 +1218,121 @@ static bool sock_read(struct io *io, void *user_data)
 					chrc->props & BT_GATT_CHRC_PROP_AUTH,
 					buf, bytes_read);
 
-	return true;
+	if (bt_gatt_client_get_write_credits(gatt))
+		return true;
+
+	/* Stop reading until the commands already queued make it into the
+	 * socket, the writer is then throttled by the socketpair itself.
+	 */
+	chrc->write_io->credits_id = bt_gatt_client_credits_register(gatt,
+							sock_credits, chrc,
+							NULL);
+
+	return !chrc->write_io->credits_id;
+}
+
+static int notify_ring_memfd(void)
+{
+#ifdef __NR_memfd_create
+	return syscall(__NR_memfd_create, "notify-ring", 0x0001U);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void notify_ring_free(struct notify_ring *ring)
+{
+	if (!ring)
+		return;
+
+	if (ring->hdr)
+		munmap(ring->hdr, ring->size);
+
+	if (ring->mem_fd >= 0)
+		close(ring->mem_fd);
+
+	if (ring->event_fd >= 0)
+		close(ring->event_fd);
+
+	free(ring);
+}
+
+static struct notify_ring *notify_ring_new(uint16_t slots)
+{
+	struct notify_ring *ring;
+	void *addr;
+
+	ring = new0(struct notify_ring, 1);
+	ring->size = sizeof(struct notify_ring_hdr) +
+				slots * sizeof(struct notify_ring_slot);
+	ring->event_fd = -1;
+
+	ring->mem_fd = notify_ring_memfd();
+	if (ring->mem_fd < 0)
+		goto fail;
+
+	if (ftruncate(ring->mem_fd, ring->size) < 0)
+		goto fail;
+
+	addr = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+							ring->mem_fd, 0);
+	if (addr == MAP_FAILED)
+		goto fail;
+
+	ring->hdr = addr;
+	ring->hdr->slots = slots;
+	ring->hdr->slot_size = sizeof(struct notify_ring_slot);
+
+	ring->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ring->event_fd < 0)
+		goto fail;
+
+	return ring;
+
+fail:
+	notify_ring_free(ring);
+	return NULL;
+}
+
+static void notify_ring_push(struct notify_ring *ring, const uint8_t *value,
+							uint16_t length)
+{
+	struct notify_ring_hdr *hdr = ring->hdr;
+	struct notify_ring_slot *slot;
+	struct timespec ts;
+	uint32_t head = hdr->head;
+	uint32_t tail;
+	uint64_t event = 1;
+
+	/* Sequence numbers also advance for dropped notifications */
+	tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+	if (head - tail >= hdr->slots) {
+		__atomic_store_n(&hdr->overflow, hdr->overflow + 1,
+							__ATOMIC_RELAXED);
+		ring->seq++;
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	slot = (void *) (hdr + 1) + (head % hdr->slots) * sizeof(*slot);
+	slot->seq = ring->seq++;
+	slot->len = MIN(length, sizeof(slot->value));
+	slot->timestamp = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	memcpy(slot->value, value, slot->len);
+
+	__atomic_store_n(&hdr->head, head + 1, __ATOMIC_SEQ_CST);
+
+	/*
+	 * Only wake up the client when the ring was empty, a client that is
+	 * still draining picks up the new head after updating the tail.
+	 */
+	if (__atomic_load_n(&hdr->tail, __ATOMIC_SEQ_CST) != head)
+		return;
+
+	if (write(ring->event_fd, &event, sizeof(event)) < 0)
+		error("write: %s", strerror(errno));
 }
 
 static void sock_io_destroy(struct sock_io *io)
@@ -1170,6 +1340,13 @@ static void sock_io_destroy(struct sock_io *io)
 	if (io->destroy)
 		io->destroy(io->data);
 
+	notify_ring_free(io->ring);
+
+	if (io->batch_id)
+		g_source_remove(io->batch_id);
+
+	free(io->batch);
+
 	if (io->msg)
 		dbus_message_unref(io->msg);
 
@@ -1182,6 +1359,8 @@ static void destroy_sock(struct characteristic *chrc, struct io *io)
 	queue_remove(chrc->service->client->ios, io);
 
 	if (chrc->write_io && io == chrc->write_io->io) {
+		bt_gatt_client_credits_unregister(chrc->service->client->gatt,
+						chrc->write_io->credits_id);
 		sock_io_destroy(chrc->write_io);
 		chrc->write_io = NULL;
 		g_dbus_emit_property_changed(btd_get_dbus_connection(),
@@ -1244,7 +1423,20 @@ static DBusMessage *create_sock(struct characteristic *chrc, DBusMessage *msg)
 
 	mtu = bt_gatt_client_get_mtu(gatt);
 
-	reply = g_dbus_create_reply(msg, DBUS_TYPE_UNIX_FD, &fds[dir],
+	if (!dir && chrc->notify_io->ring) {
+		struct notify_ring *ring = chrc->notify_io->ring;
+
+		reply = g_dbus_create_reply(msg, DBUS_TYPE_UNIX_FD, &fds[dir],
+					DBUS_TYPE_UNIX_FD, &ring->mem_fd,
+					DBUS_TYPE_UNIX_FD, &ring->event_fd,
+					DBUS_TYPE_UINT16, &mtu,
+					DBUS_TYPE_INVALID);
+
+		/* The mapping stays valid after closing the memfd */
+		close(ring->mem_fd);
+		ring->mem_fd = -1;
+	} else
+		reply = g_dbus_create_reply(msg, DBUS_TYPE_UNIX_FD, &fds[dir],
 					DBUS_TYPE_UINT16, &mtu,
 					DBUS_TYPE_INVALID);
 
@@ -1507,6 +1699,43 @@ static void register_notify_cb(uint16_t att_ecode, void *user_data)
 	create_notify_reply(op, true, 0);
 }
 
+static void notify_batch_flush(struct sock_io *io)
+{
+	if (!io->batch_len)
+		return;
+
+	if (send(io_get_fd(io->io), io->batch, io->batch_len,
+						MSG_NOSIGNAL) < 0)
+		error("send: %s", strerror(errno));
+
+	io->batch_len = 0;
+}
+
+static gboolean notify_batch_idle(gpointer user_data)
+{
+	struct sock_io *io = user_data;
+
+	io->batch_id = 0;
+	notify_batch_flush(io);
+
+	return FALSE;
+}
+
+static void notify_batch_push(struct sock_io *io, const uint8_t *value,
+							uint16_t length)
+{
+	if (io->batch_len + 2 + length > NOTIFY_BATCH_SIZE)
+		notify_batch_flush(io);
+
+	put_le16(length, io->batch + io->batch_len);
+	memcpy(io->batch + io->batch_len + 2, value, length);
+	io->batch_len += 2 + length;
+
+	/* Flush once the notifications of this loop iteration are queued */
+	if (!io->batch_id)
+		io->batch_id = g_idle_add(notify_batch_idle, io);
+}
+
 static void notify_io_cb(uint16_t value_handle, const uint8_t *value,
 					uint16_t length, void *user_data)
 {
@@ -1520,6 +1749,16 @@ static void notify_io_cb(uint16_t value_handle, const uint8_t *value,
 	if (!chrc->notify_io || !chrc->notify_io->io)
 		return;
 
+	if (chrc->notify_io->ring) {
+		notify_ring_push(chrc->notify_io->ring, value, length);
+		return;
+	}
+
+	if (chrc->notify_io->batch) {
+		notify_batch_push(chrc->notify_io, value, length);
+		return;
+	}
+
 	iov.iov_base = (void *) value;
 	iov.iov_len = length;
 
@@ -1563,13 +1802,14 @@ static void notify_io_destroy(void *data)
 		notify_client_unref(client);
 }
 
-static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
-					DBusMessage *msg, void *user_data)
+static DBusMessage *acquire_notify(struct characteristic *chrc,
+					DBusMessage *msg, uint16_t slots,
+					bool batch)
 {
-	struct characteristic *chrc = user_data;
 	struct bt_gatt_client *gatt = chrc->service->client->gatt;
 	const char *sender = dbus_message_get_sender(msg);
 	struct notify_client *client;
+	struct notify_ring *ring = NULL;
 
 	if (!gatt)
 		return btd_error_failed(msg, "Not connected");
@@ -1585,9 +1825,17 @@ static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
 			BT_GATT_CHRC_PROP_INDICATE)))
 		return btd_error_not_supported(msg);
 
+	if (slots) {
+		ring = notify_ring_new(slots);
+		if (!ring)
+			return btd_error_failed(msg, strerror(errno));
+	}
+
 	client = notify_client_create(chrc, sender);
-	if (!client)
+	if (!client) {
+		notify_ring_free(ring);
 		return btd_error_failed(msg, "Failed allocate notify session");
+	}
 
 	client->notify_id = bt_gatt_client_register_notify(gatt,
 						chrc->value_handle,
@@ -1595,6 +1843,7 @@ static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
 						notify_io_cb,
 						client, NULL);
 	if (!client->notify_id) {
+		notify_ring_free(ring);
 		notify_client_unref(client);
 		return btd_error_failed(msg, "Failed to subscribe");
 	}
@@ -1604,11 +1853,85 @@ static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
 	chrc->notify_io = new0(struct sock_io, 1);
 	chrc->notify_io->data = client;
 	chrc->notify_io->msg = dbus_message_ref(msg);
+	chrc->notify_io->ring = ring;
+	if (batch)
+		chrc->notify_io->batch = malloc(NOTIFY_BATCH_SIZE);
 	chrc->notify_io->destroy = notify_io_destroy;
 
 	return NULL;
 }
 
+static int parse_notify_options(DBusMessageIter *iter, uint16_t *slots,
+							dbus_bool_t *batch)
+{
+	DBusMessageIter dict;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+		return -EINVAL;
+
+	dbus_message_iter_recurse(iter, &dict);
+
+	while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+		const char *key;
+		DBusMessageIter value, entry;
+		int var;
+
+		dbus_message_iter_recurse(&dict, &entry);
+		dbus_message_iter_get_basic(&entry, &key);
+
+		dbus_message_iter_next(&entry);
+		dbus_message_iter_recurse(&entry, &value);
+
+		var = dbus_message_iter_get_arg_type(&value);
+		if (slots && strcasecmp(key, "slots") == 0) {
+			if (var != DBUS_TYPE_UINT16)
+				return -EINVAL;
+			dbus_message_iter_get_basic(&value, slots);
+		}
+
+		if (batch && strcasecmp(key, "batch") == 0) {
+			if (var != DBUS_TYPE_BOOLEAN)
+				return -EINVAL;
+			dbus_message_iter_get_basic(&value, batch);
+		}
+
+		dbus_message_iter_next(&dict);
+	}
+
+	return 0;
+}
+
+static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	DBusMessageIter iter;
+	dbus_bool_t batch = FALSE;
+
+	dbus_message_iter_init(msg, &iter);
+
+	if (parse_notify_options(&iter, NULL, &batch))
+		return btd_error_invalid_args(msg);
+
+	return acquire_notify(user_data, msg, 0, batch);
+}
+
+static DBusMessage *characteristic_acquire_notify_ring(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	DBusMessageIter iter;
+	uint16_t slots = NOTIFY_RING_SLOTS;
+
+	dbus_message_iter_init(msg, &iter);
+
+	if (parse_notify_options(&iter, &slots, NULL))
+		return btd_error_invalid_args(msg);
+
+	if (!slots || slots > NOTIFY_RING_MAX_SLOTS)
+		return btd_error_invalid_args(msg);
+
+	return acquire_notify(user_data, msg, slots, false);
+}
+
 static DBusMessage *characteristic_start_notify(DBusConnection *conn,
 					DBusMessage *msg, void *user_data)
 {
@@ -1748,6 +2071,13 @@ static const GDBusMethodTable characteristic_methods[] = {
 					GDBUS_ARGS({ "fd", "h" },
 						{ "mtu", "q" }),
 					characteristic_acquire_notify) },
+	{ GDBUS_EXPERIMENTAL_ASYNC_METHOD("AcquireNotifyRing",
+					GDBUS_ARGS({ "options", "a{sv}" }),
+					GDBUS_ARGS({ "fd", "h" },
+						{ "ring", "h" },
+						{ "event", "h" },
+						{ "mtu", "q" }),
+					characteristic_acquire_notify_ring) },
 	{ GDBUS_ASYNC_METHOD("StartNotify", NULL, NULL,
 					characteristic_start_notify) },
 	{ GDBUS_METHOD("StopNotify", NULL, NULL,
@@ -1776,6 +2106,8 @@ static void characteristic_free(void *data)
 
 	if (chrc->write_io) {
 		queue_remove(chrc->service->client->ios, chrc->write_io->io);
+		bt_gatt_client_credits_unregister(gatt,
+						chrc->write_io->credits_id);
 		sock_io_destroy(chrc->write_io);
 	}
 
@@ -2333,76 +2665,108 @@ static void eatt_connect_cb(GIOChannel *io, GError *gerr, gpointer user_data)
 	device_attach_att(client->device, io);
 }
 
-void btd_gatt_client_eatt_connect(struct btd_gatt_client *client)
+static bool eatt_connect_chan(struct btd_gatt_client *client, uint16_t mtu,
+							int defer_timeout)
 {
-	struct bt_att *att = bt_gatt_client_get_att(client->gatt);
 	struct btd_device *dev = client->device;
 	struct btd_adapter *adapter = device_get_adapter(dev);
 	GIOChannel *io;
 	GError *gerr = NULL;
 	char addr[18];
-	int i;
-
-	if (!(client->features & BT_GATT_CHRC_CLI_FEAT_EATT) ||
-				!btd_device_is_initiator(dev))
-		return;
-
-	if (bt_att_get_channels(att) == btd_opts.gatt_channels)
-		return;
 
 	ba2str(device_get_address(dev), addr);
 
-	for (i = bt_att_get_channels(att); i < btd_opts.gatt_channels; i++) {
-		int defer_timeout = i + 1 < btd_opts.gatt_channels ? 1 : 0;
-
-		DBG("Connection attempt to: %s defer %s", addr,
+	DBG("Connection attempt to: %s mtu %u defer %s", addr, mtu,
 					defer_timeout ? "true" : "false");
 
-		/* Attempt to connect using the Ext-Flowctl */
+	/* Attempt to connect using the Ext-Flowctl */
+	io = bt_io_connect(eatt_connect_cb, client, NULL, &gerr,
+				BT_IO_OPT_SOURCE_BDADDR,
+				btd_adapter_get_address(adapter),
+				BT_IO_OPT_SOURCE_TYPE,
+				btd_adapter_get_address_type(adapter),
+				BT_IO_OPT_DEST_BDADDR,
+				device_get_address(dev),
+				BT_IO_OPT_DEST_TYPE,
+				device_get_le_address_type(dev),
+				BT_IO_OPT_MODE, BT_IO_MODE_EXT_FLOWCTL,
+				BT_IO_OPT_PSM, BT_ATT_EATT_PSM,
+				BT_IO_OPT_SEC_LEVEL, BT_IO_SEC_LOW,
+				BT_IO_OPT_MTU, mtu,
+				BT_IO_OPT_DEFER_TIMEOUT, defer_timeout,
+				BT_IO_OPT_INVALID);
+	if (!io) {
+		g_error_free(gerr);
+		gerr = NULL;
+		/* Fallback to legacy LE Mode */
 		io = bt_io_connect(eatt_connect_cb, client, NULL, &gerr,
-					BT_IO_OPT_SOURCE_BDADDR,
-					btd_adapter_get_address(adapter),
-					BT_IO_OPT_SOURCE_TYPE,
-					btd_adapter_get_address_type(adapter),
-					BT_IO_OPT_DEST_BDADDR,
-					device_get_address(dev),
-					BT_IO_OPT_DEST_TYPE,
-					device_get_le_address_type(dev),
-					BT_IO_OPT_MODE, BT_IO_MODE_EXT_FLOWCTL,
-					BT_IO_OPT_PSM, BT_ATT_EATT_PSM,
-					BT_IO_OPT_SEC_LEVEL, BT_IO_SEC_LOW,
-					BT_IO_OPT_MTU, btd_opts.gatt_mtu,
-					BT_IO_OPT_DEFER_TIMEOUT, defer_timeout,
-					BT_IO_OPT_INVALID);
+				BT_IO_OPT_SOURCE_BDADDR,
+				btd_adapter_get_address(adapter),
+				BT_IO_OPT_SOURCE_TYPE,
+				btd_adapter_get_address_type(adapter),
+				BT_IO_OPT_DEST_BDADDR,
+				device_get_address(dev),
+				BT_IO_OPT_DEST_TYPE,
+				device_get_le_address_type(dev),
+				BT_IO_OPT_PSM, BT_ATT_EATT_PSM,
+				BT_IO_OPT_SEC_LEVEL, BT_IO_SEC_LOW,
+				BT_IO_OPT_MTU, mtu,
+				BT_IO_OPT_INVALID);
 		if (!io) {
-			g_error_free(gerr);
-			gerr = NULL;
-			/* Fallback to legacy LE Mode */
-			io = bt_io_connect(eatt_connect_cb, client, NULL, &gerr,
-					BT_IO_OPT_SOURCE_BDADDR,
-					btd_adapter_get_address(adapter),
-					BT_IO_OPT_SOURCE_TYPE,
-					btd_adapter_get_address_type(adapter),
-					BT_IO_OPT_DEST_BDADDR,
-					device_get_address(dev),
-					BT_IO_OPT_DEST_TYPE,
-					device_get_le_address_type(dev),
-					BT_IO_OPT_PSM, BT_ATT_EATT_PSM,
-					BT_IO_OPT_SEC_LEVEL, BT_IO_SEC_LOW,
-					BT_IO_OPT_MTU, btd_opts.gatt_mtu,
-					BT_IO_OPT_INVALID);
-			if (!io) {
-				error("EATT bt_io_connect(%s): %s", addr,
+			error("EATT bt_io_connect(%s): %s", addr,
 							gerr->message);
-				g_error_free(gerr);
-				return;
-			}
+			g_error_free(gerr);
+			return false;
 		}
+	}
+
+	g_io_channel_unref(io);
+
+	return true;
+}
+
+static bool eatt_allowed(struct btd_gatt_client *client)
+{
+	return (client->features & BT_GATT_CHRC_CLI_FEAT_EATT) &&
+				btd_device_is_initiator(client->device);
+}
+
+void btd_gatt_client_eatt_connect(struct btd_gatt_client *client)
+{
+	struct bt_att *att = bt_gatt_client_get_att(client->gatt);
+	int channels = btd_opts.gatt_channels;
+	int i;
+
+	if (!eatt_allowed(client))
+		return;
 
-		g_io_channel_unref(io);
+	/* The rest are opened on demand, see btd_gatt_client_eatt_add */
+	if (btd_opts.gatt_adaptive_chans)
+		channels = MIN(channels, EATT_ADAPTIVE_CHANNELS);
+
+	for (i = bt_att_get_channels(att); i < channels; i++) {
+		int defer_timeout = i + 1 < channels ? 1 : 0;
+
+		if (!eatt_connect_chan(client, btd_opts.gatt_mtu,
+							defer_timeout))
+			return;
 	}
 }
 
+bool btd_gatt_client_eatt_add(struct btd_gatt_client *client, uint16_t mtu)
+{
+	struct bt_att *att;
+
+	if (!client || !client->gatt || !eatt_allowed(client))
+		return false;
+
+	att = bt_gatt_client_get_att(client->gatt);
+	if (bt_att_get_channels(att) >= btd_opts.gatt_channels)
+		return false;
+
+	return eatt_connect_chan(client, mtu, 0);
+}
+
 void btd_gatt_client_connected(struct btd_gatt_client *client)
 {
 	struct bt_gatt_client *gatt;
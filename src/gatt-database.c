@@ -73,6 +73,7 @@ struct btd_gatt_database {
 	GIOChannel *bredr_io;
 	struct queue *records;
 	struct queue *device_states;
+	struct queue *subscribers;
 	struct queue *ccc_callbacks;
 	struct gatt_db_attribute *svc_chngd;
 	struct gatt_db_attribute *svc_chngd_ccc;
@@ -172,6 +173,13 @@ struct notify {
 	uint16_t len;
 	bt_gatt_server_conf_func_t conf;
 	void *user_data;
+	struct queue *pdus;
+};
+
+struct notify_pdu {
+	uint16_t mtu;
+	uint16_t len;
+	uint8_t data[];
 };
 
 #define CLI_FEAT_SIZE 1
@@ -197,6 +205,11 @@ struct ccc_state {
 	uint16_t value;
 };
 
+struct ccc_subscribers {
+	uint16_t handle;
+	struct queue *states;
+};
+
 struct ccc_cb_data {
 	uint16_t handle;
 	btd_gatt_database_ccc_write_t callback;
@@ -277,6 +290,67 @@ static struct ccc_state *find_ccc_state(struct device_state *dev_state,
 							UINT_TO_PTR(handle));
 }
 
+static bool subscribers_match(const void *a, const void *b)
+{
+	const struct ccc_subscribers *subs = a;
+	uint16_t handle = PTR_TO_UINT(b);
+
+	return subs->handle == handle;
+}
+
+static void subscribers_free(void *data)
+{
+	struct ccc_subscribers *subs = data;
+
+	queue_destroy(subs->states, NULL);
+	free(subs);
+}
+
+static void subscribers_add(struct btd_gatt_database *db,
+				struct device_state *state, uint16_t handle)
+{
+	struct ccc_subscribers *subs;
+
+	subs = queue_find(db->subscribers, subscribers_match,
+						UINT_TO_PTR(handle));
+	if (!subs) {
+		subs = new0(struct ccc_subscribers, 1);
+		subs->handle = handle;
+		subs->states = queue_new();
+		queue_push_tail(db->subscribers, subs);
+	} else if (queue_find(subs->states, NULL, state))
+		return;
+
+	queue_push_tail(subs->states, state);
+}
+
+static void subscribers_remove(struct btd_gatt_database *db,
+				struct device_state *state, uint16_t handle)
+{
+	struct ccc_subscribers *subs;
+
+	subs = queue_find(db->subscribers, subscribers_match,
+						UINT_TO_PTR(handle));
+	if (!subs)
+		return;
+
+	queue_remove(subs->states, state);
+
+	if (queue_isempty(subs->states)) {
+		queue_remove(db->subscribers, subs);
+		subscribers_free(subs);
+	}
+}
+
+static void ccc_state_unsubscribe(void *data, void *user_data)
+{
+	struct ccc_state *ccc = data;
+	struct device_state *state = user_data;
+
+	if (ccc->value)
+		subscribers_remove(state->db, state, ccc->handle);
+}
+
 static struct device_state *device_state_create(struct btd_gatt_database *db,
 							const bdaddr_t *bdaddr,
 							uint8_t bdaddr_type)
@@ -296,6 +370,7 @@ static void device_state_free(void *data)
 {
 	struct device_state *state = data;
 
+	queue_foreach(state->ccc_states, ccc_state_unsubscribe, state);
 	queue_destroy(state->ccc_states, free);
 
 	if (state->pending) {
@@ -432,16 +507,11 @@ done:
 	return dev_state;
 }
 
-static struct ccc_state *get_ccc_state(struct btd_gatt_database *database,
-					struct bt_att *att, uint16_t handle)
+static struct ccc_state *device_state_get_ccc(struct device_state *dev_state,
+								uint16_t handle)
 {
-	struct device_state *dev_state;
 	struct ccc_state *ccc;
 
-	dev_state = get_device_state(database, att);
-	if (!dev_state)
-		return NULL;
-
 	ccc = find_ccc_state(dev_state, handle);
 	if (ccc)
 		return ccc;
@@ -453,6 +523,18 @@ static struct ccc_state *get_ccc_state(struct btd_gatt_database *database,
 	return ccc;
 }
 
+static struct ccc_state *get_ccc_state(struct btd_gatt_database *database,
+					struct bt_att *att, uint16_t handle)
+{
+	struct device_state *dev_state;
+
+	dev_state = get_device_state(database, att);
+	if (!dev_state)
+		return NULL;
+
+	return device_state_get_ccc(dev_state, handle);
+}
+
 static void cancel_pending_read(void *data)
 {
 	struct pending_op *op = data;
@@ -633,6 +715,7 @@ static void gatt_database_free(void *data)
 
 	queue_destroy(database->records, gatt_record_free);
 	queue_destroy(database->device_states, device_state_free);
+	queue_destroy(database->subscribers, subscribers_free);
 	queue_destroy(database->apps, app_free);
 	queue_destroy(database->profiles, profile_free);
 	queue_destroy(database->ccc_callbacks, ccc_cb_free);
@@ -1042,6 +1125,7 @@ static void gatt_ccc_write_cb(struct gatt_db_attribute *attrib,
 					void *user_data)
 {
 	struct btd_gatt_database *database = user_data;
+	struct device_state *dev_state;
 	struct ccc_state *ccc;
 	struct ccc_cb_data *ccc_cb;
 	uint16_t handle, val;
@@ -1061,12 +1145,14 @@ static void gatt_ccc_write_cb(struct gatt_db_attribute *attrib,
 		goto done;
 	}
 
-	ccc = get_ccc_state(database, att, handle);
-	if (!ccc) {
+	dev_state = get_device_state(database, att);
+	if (!dev_state) {
 		ecode = BT_ATT_ERROR_UNLIKELY;
 		goto done;
 	}
 
+	ccc = device_state_get_ccc(dev_state, handle);
+
 	if (len == 1)
 		val = *value;
 	else
@@ -1093,8 +1179,15 @@ static void gatt_ccc_write_cb(struct gatt_db_attribute *attrib,
 			pending_op_free(op);
 	}
 
-	if (!ecode)
-		ccc->value = val;
+	if (ecode)
+		goto done;
+
+	if (!val)
+		subscribers_remove(database, dev_state, handle);
+	else if (!ccc->value)
+		subscribers_add(database, dev_state, handle);
+
+	ccc->value = val;
 
 done:
 	gatt_db_attribute_write_result(attrib, id, ecode);
@@ -1400,10 +1493,46 @@ static void state_set_pending(struct device_state *state, struct notify *notify)
 	/* Copy notify contents to pending */
 	state->pending = new0(struct notify, 1);
 	memcpy(state->pending, notify, sizeof(*notify));
+	state->pending->pdus = NULL;
 	state->pending->value = malloc(notify->len);
 	memcpy(state->pending->value, notify->value, notify->len);
 }
 
+static bool notify_pdu_match_mtu(const void *data, const void *match_data)
+{
+	const struct notify_pdu *pdu = data;
+
+	return pdu->mtu == PTR_TO_UINT(match_data);
+}
+
+/* Encode the notification once per MTU and send the same PDU to all the
+ * subscribers that use it.
+ */
+static void send_notification_pdu(struct bt_gatt_server *server,
+						struct notify *notify)
+{
+	struct bt_att *att = bt_gatt_server_get_att(server);
+	uint16_t mtu = bt_att_get_mtu(att);
+	struct notify_pdu *pdu;
+	uint16_t len;
+
+	pdu = queue_find(notify->pdus, notify_pdu_match_mtu,
+						UINT_TO_PTR(mtu));
+	if (!pdu) {
+		len = MIN(notify->len, mtu - 3);
+
+		pdu = malloc(sizeof(*pdu) + 2 + len);
+		pdu->mtu = mtu;
+		pdu->len = 2 + len;
+		put_le16(notify->handle, pdu->data);
+		memcpy(pdu->data + 2, notify->value, len);
+		queue_push_tail(notify->pdus, pdu);
+	}
+
+	bt_att_send(att, BT_ATT_OP_HANDLE_NFY, pdu->data, pdu->len, NULL,
+								NULL, NULL);
+}
+
 static void send_notification_to_device(void *data, void *user_data)
 {
 	struct device_state *device_state = data;
@@ -1450,6 +1579,13 @@ static void send_notification_to_device(void *data, void *user_data)
 	 */
 	if (!(ccc->value & 0x0002)) {
 		DBG("GATT server sending notification");
+
+		if (notify->pdus && !(device_state->cli_feat[0] &
+					BT_GATT_CHRC_CLI_FEAT_NFY_MULTI)) {
+			send_notification_pdu(server, notify);
+			return;
+		}
+
 		bt_gatt_server_send_notification(server,
 					notify->handle, notify->value,
 					notify->len, device_state->cli_feat[0] &
@@ -1473,6 +1609,32 @@ remove:
 	}
 }
 
+static void send_notification_to_subscribers(
+					struct btd_gatt_database *database,
+					struct notify *notify)
+{
+	struct ccc_subscribers *subs;
+
+	/* Service Changed also marks every robust caching client as change
+	 * unaware so it needs to visit all the states.
+	 */
+	if (notify->conf == service_changed_conf) {
+		queue_foreach(database->device_states,
+				send_notification_to_device, notify);
+		return;
+	}
+
+	subs = queue_find(database->subscribers, subscribers_match,
+					UINT_TO_PTR(notify->ccc_handle));
+	if (!subs)
+		return;
+
+	notify->pdus = queue_new();
+	queue_foreach(subs->states, send_notification_to_device, notify);
+	queue_destroy(notify->pdus, free);
+	notify->pdus = NULL;
+}
+
 static void gatt_notify_cb(struct gatt_db_attribute *attrib,
 					struct gatt_db_attribute *ccc,
 					const uint8_t *value, size_t len,
@@ -1502,8 +1664,7 @@ static void gatt_notify_cb(struct gatt_db_attribute *attrib,
 
 		send_notification_to_device(state, &notify);
 	} else
-		queue_foreach(database->device_states,
-				send_notification_to_device, &notify);
+		send_notification_to_subscribers(database, &notify);
 }
 
 static void register_core_services(struct btd_gatt_database *database)
@@ -1534,8 +1695,7 @@ static void send_notification_to_devices(struct btd_gatt_database *database,
 	notify.conf = conf;
 	notify.user_data = user_data;
 
-	queue_foreach(database->device_states, send_notification_to_device,
-								&notify);
+	send_notification_to_subscribers(database, &notify);
 }
 
 static void send_service_changed(struct btd_gatt_database *database,
@@ -4054,6 +4214,7 @@ struct btd_gatt_database *btd_gatt_database_new(struct btd_adapter *adapter)
 	database->db = gatt_db_new();
 	database->records = queue_new();
 	database->device_states = queue_new();
+	database->subscribers = queue_new();
 	database->apps = queue_new();
 	database->profiles = queue_new();
 	database->ccc_callbacks = queue_new();
@@ -4214,6 +4375,9 @@ static void restore_ccc(struct btd_gatt_database *database,
 	ccc->handle = gatt_db_attribute_get_handle(database->svc_chngd_ccc);
 	ccc->value = value;
 	queue_push_tail(dev_state->ccc_states, ccc);
+
+	if (value)
+		subscribers_add(database, dev_state, ccc->handle);
 }
 
 static void restore_state(struct btd_device *device, void *data)
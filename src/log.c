@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <glib.h>
 
@@ -34,10 +35,49 @@
 
 #define LOG_IDENT "bluetoothd"
 
-static void monitor_log(uint16_t index, int priority,
-					const char *format, va_list ap)
+#define LOG_BUF_SIZE 1024
+
+/*
+ * Format the message only once and hand the same string to both syslog
+ * and the monitor channel.  Messages that fit the stack buffer do not
+ * need any allocation.
+ */
+static void log_vprintf(uint16_t index, int priority, const char *format,
+								va_list ap)
 {
-	bt_log_vprintf(index, LOG_IDENT, priority, format, ap);
+	char buf[LOG_BUF_SIZE];
+	char *str = buf;
+	struct iovec iov;
+	va_list aq;
+	int len;
+
+	va_copy(aq, ap);
+	len = vsnprintf(buf, sizeof(buf), format, aq);
+	va_end(aq);
+
+	if (len < 0)
+		return;
+
+	if ((size_t) len >= sizeof(buf) && vasprintf(&str, format, ap) < 0)
+		return;
+
+	syslog(priority, "%s", str);
+
+	len = strlen(str);
+
+	/* Replace new line since btmon already adds it */
+	if (len > 1 && str[len - 1] == '\n') {
+		str[len - 1] = '\0';
+		len--;
+	}
+
+	iov.iov_base = str;
+	iov.iov_len = len + 1;
+
+	bt_log_sendmsg(index, LOG_IDENT, priority, &iov, 1);
+
+	if (str != buf)
+		free(str);
 }
 
 void info(const char *format, ...)
@@ -45,11 +85,7 @@ void info(const char *format, ...)
 	va_list ap;
 
 	va_start(ap, format);
-	vsyslog(LOG_INFO, format, ap);
-	va_end(ap);
-
-	va_start(ap, format);
-	monitor_log(HCI_DEV_NONE, LOG_INFO, format, ap);
+	log_vprintf(HCI_DEV_NONE, LOG_INFO, format, ap);
 	va_end(ap);
 }
 
@@ -58,11 +94,7 @@ void btd_log(uint16_t index, int priority, const char *format, ...)
 	va_list ap;
 
 	va_start(ap, format);
-	vsyslog(priority, format, ap);
-	va_end(ap);
-
-	va_start(ap, format);
-	monitor_log(index, priority, format, ap);
+	log_vprintf(index, priority, format, ap);
 	va_end(ap);
 }
 
@@ -71,11 +103,7 @@ void btd_error(uint16_t index, const char *format, ...)
 	va_list ap;
 
 	va_start(ap, format);
-	vsyslog(LOG_ERR, format, ap);
-	va_end(ap);
-
-	va_start(ap, format);
-	monitor_log(index, LOG_ERR, format, ap);
+	log_vprintf(index, LOG_ERR, format, ap);
 	va_end(ap);
 }
 
@@ -84,11 +112,7 @@ void btd_warn(uint16_t index, const char *format, ...)
 	va_list ap;
 
 	va_start(ap, format);
-	vsyslog(LOG_WARNING, format, ap);
-	va_end(ap);
-
-	va_start(ap, format);
-	monitor_log(index, LOG_WARNING, format, ap);
+	log_vprintf(index, LOG_WARNING, format, ap);
 	va_end(ap);
 }
 
@@ -97,11 +121,7 @@ void btd_info(uint16_t index, const char *format, ...)
 	va_list ap;
 
 	va_start(ap, format);
-	vsyslog(LOG_INFO, format, ap);
-	va_end(ap);
-
-	va_start(ap, format);
-	monitor_log(index, LOG_INFO, format, ap);
+	log_vprintf(index, LOG_INFO, format, ap);
 	va_end(ap);
 }
 
@@ -110,11 +130,7 @@ void btd_debug(uint16_t index, const char *format, ...)
 	va_list ap;
 
 	va_start(ap, format);
-	vsyslog(LOG_DEBUG, format, ap);
-	va_end(ap);
-
-	va_start(ap, format);
-	monitor_log(index, LOG_DEBUG, format, ap);
+	log_vprintf(index, LOG_DEBUG, format, ap);
 	va_end(ap);
 }
 
@@ -122,6 +138,14 @@ extern struct btd_debug_desc __start___debug[];
 extern struct btd_debug_desc __stop___debug[];
 
 static char **enabled = NULL;
+static char *debug_patterns = NULL;
+
+struct debug_section {
+	struct btd_debug_desc *start;
+	struct btd_debug_desc *stop;
+};
+
+static GSList *debug_sections = NULL;
 
 static gboolean is_enabled(const struct btd_debug_desc *desc)
 {
@@ -143,6 +167,8 @@ void __btd_enable_debug(struct btd_debug_desc *start,
 {
 	struct btd_debug_desc *desc;
 
+	struct debug_section *section;
+
 	if (start == NULL || stop == NULL)
 		return;
 
@@ -150,6 +176,52 @@ void __btd_enable_debug(struct btd_debug_desc *start,
 		if (is_enabled(desc))
 			desc->flags |= BTD_DEBUG_FLAG_PRINT;
 	}
+
+	section = g_new0(struct debug_section, 1);
+	section->start = start;
+	section->stop = stop;
+
+	debug_sections = g_slist_prepend(debug_sections, section);
+}
+
+static void update_section(gpointer data, gpointer user_data)
+{
+	struct debug_section *section = data;
+	struct btd_debug_desc *desc;
+
+	for (desc = section->start; desc < section->stop; desc++) {
+		if (is_enabled(desc))
+			desc->flags |= BTD_DEBUG_FLAG_PRINT;
+		else
+			desc->flags &= ~BTD_DEBUG_FLAG_PRINT;
+	}
+}
+
+void __btd_set_debug(const char *debug)
+{
+	g_strfreev(enabled);
+	enabled = NULL;
+
+	g_free(debug_patterns);
+	debug_patterns = NULL;
+
+	if (debug != NULL && *debug != '\0') {
+		enabled = g_strsplit_set(debug, ":, ", 0);
+		debug_patterns = g_strdup(debug);
+	}
+
+	/*
+	 * Only the descriptor flags change, so a DBG() that is not enabled
+	 * still costs a single test of its own flags.
+	 */
+	g_slist_foreach(debug_sections, update_section, NULL);
+
+	info("Debug patterns set to \"%s\"", debug_patterns ? : "");
+}
+
+const char *__btd_get_debug(void)
+{
+	return debug_patterns;
 }
 
 void __btd_toggle_debug(void)
@@ -164,8 +236,10 @@ void __btd_log_init(const char *debug, int detach)
 {
 	int option = LOG_NDELAY | LOG_PID;
 
-	if (debug != NULL)
+	if (debug != NULL) {
 		enabled = g_strsplit_set(debug, ":, ", 0);
+		debug_patterns = g_strdup(debug);
+	}
 
 	__btd_enable_debug(__start___debug, __stop___debug);
 
@@ -186,4 +260,8 @@ void __btd_log_cleanup(void)
 	bt_log_close();
 
 	g_strfreev(enabled);
+	g_free(debug_patterns);
+
+	g_slist_free_full(debug_sections, g_free);
+	debug_sections = NULL;
 }
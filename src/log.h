@@ -28,6 +28,8 @@ void btd_debug(uint16_t index, const char *format, ...)
 void __btd_log_init(const char *debug, int detach);
 void __btd_log_cleanup(void);
 void __btd_toggle_debug(void);
+void __btd_set_debug(const char *debug);
+const char *__btd_get_debug(void);
 
 struct btd_debug_desc {
 	const char *file;
@@ -49,18 +49,24 @@
 #include "shared/util.h"
 #include "btd.h"
 #include "sdpd.h"
+#include "sdp-client.h"
 #include "adapter.h"
 #include "device.h"
+#include "storage.h"
 #include "dbus-common.h"
+#include "error.h"
 #include "agent.h"
 #include "profile.h"
 
 #define BLUEZ_NAME "org.bluez"
+#define DEBUG_INTERFACE "org.bluez.Debug1"
 
 #define DEFAULT_PAIRABLE_TIMEOUT           0 /* disabled */
 #define DEFAULT_DISCOVERABLE_TIMEOUT     180 /* 3 minutes */
 #define DEFAULT_TEMPORARY_TIMEOUT         30 /* 30 seconds */
+#define DEFAULT_SDP_CACHE_TIMEOUT         60 /* 1 minute */
 #define DEFAULT_NAME_REQUEST_RETRY_DELAY 300 /* 5 minutes */
+#define DEFAULT_RSSI_THRESHOLD             8 /* 8 dBm */
 
 #define SHUTDOWN_GRACE_SECONDS 10
 
@@ -87,10 +93,15 @@ static const char *supported_options[] = {
 	"JustWorksRepairing",
 	"TemporaryTimeout",
 	"RefreshDiscovery",
+	"ServiceRecordCacheTimeout",
 	"Experimental",
 	"Testing",
 	"KernelExperimental",
 	"RemoteNameRequestRetryDelay",
+	"PropertyUpdateInterval",
+	"RSSIThreshold",
+	"StorageWriteDelay",
+	"AdapterThreads",
 	NULL
 };
 
@@ -131,6 +142,7 @@ static const char *le_options[] = {
 	"AdvMonAllowlistScanDuration",
 	"AdvMonNoFilterScanDuration",
 	"EnableAdvMonInterleaveScan",
+	"PreferredPHY",
 	NULL
 };
 
@@ -140,6 +152,9 @@ static const char *policy_options[] = {
 	"ReconnectIntervals",
 	"AutoEnable",
 	"ResumeDelay",
+	"ReconnectSpacing",
+	"ReconnectJitter",
+	"ReconnectConcurrency",
 	NULL
 };
 
@@ -150,6 +165,8 @@ static const char *gatt_options[] = {
 	"Channels",
 	"Client",
 	"ExportClaimedServices",
+	"AdaptiveConnection",
+	"AdaptiveChannels",
 	NULL
 };
 
@@ -170,6 +187,7 @@ static const char *avdtp_options[] = {
 static const char *avrcp_options[] = {
 	"VolumeWithoutTarget",
 	"VolumeCategory",
+	"PositionInterval",
 	NULL
 };
 
@@ -338,6 +356,23 @@ static bt_gatt_cache_t parse_gatt_cache_str(const char *cache)
 	}
 }
 
+static enum le_phy_t parse_le_phy(const char *phy)
+{
+	if (!strcasecmp(phy, "auto"))
+		return LE_PHY_AUTO;
+	else if (!strcasecmp(phy, "1M"))
+		return LE_PHY_1M;
+	else if (!strcasecmp(phy, "2M"))
+		return LE_PHY_2M;
+	else if (!strcasecmp(phy, "coded"))
+		return LE_PHY_CODED;
+
+	if (strcasecmp(phy, "default"))
+		warn("Invalid value for LE PreferredPHY: %s", phy);
+
+	return LE_PHY_DEFAULT;
+}
+
 static enum jw_repairing_t parse_jw_repairing(const char *jw_repairing)
 {
 	if (!strcmp(jw_repairing, "never")) {
@@ -695,10 +730,17 @@ static void parse_le_config(GKeyFile *config)
 		  1},
 	};
 
+	char *str = NULL;
+
 	if (btd_opts.mode == BT_MODE_BREDR)
 		return;
 
 	parse_mode_config(config, "LE", params, ARRAY_SIZE(params));
+
+	if (parse_config_string(config, "LE", "PreferredPHY", &str)) {
+		btd_opts.le_phy = parse_le_phy(str);
+		g_free(str);
+	}
 }
 
 static bool match_experimental(const void *data, const void *match_data)
@@ -1053,6 +1095,9 @@ static void parse_general(GKeyFile *config)
 						0, UINT32_MAX);
 	parse_config_bool(config, "General", "RefreshDiscovery",
 						&btd_opts.refresh_discovery);
+	parse_config_u32(config, "General", "ServiceRecordCacheTimeout",
+						&btd_opts.sdp_cache_timeout,
+						0, UINT32_MAX);
 	parse_secure_conns(config);
 	parse_config_bool(config, "General", "Experimental",
 						&btd_opts.experimental);
@@ -1062,6 +1107,17 @@ static void parse_general(GKeyFile *config)
 	parse_config_u32(config, "General", "RemoteNameRequestRetryDelay",
 					&btd_opts.name_request_retry_delay,
 					0, UINT32_MAX);
+	parse_config_u32(config, "General", "PropertyUpdateInterval",
+					&btd_opts.prop_interval,
+					0, UINT32_MAX);
+	parse_config_u8(config, "General", "RSSIThreshold",
+					&btd_opts.rssi_threshold,
+					0, INT8_MAX);
+	parse_config_u32(config, "General", "StorageWriteDelay",
+					&btd_opts.storage_delay,
+					0, UINT32_MAX);
+	parse_config_bool(config, "General", "AdapterThreads",
+					&btd_opts.adapter_threads);
 }
 
 static void parse_gatt_cache(GKeyFile *config)
@@ -1112,6 +1168,10 @@ static void parse_gatt(GKeyFile *config)
 	parse_config_u8(config, "GATT", "Channels", &btd_opts.gatt_channels,
 				1, 6);
 	parse_config_bool(config, "GATT", "Client", &btd_opts.gatt_client);
+	parse_config_bool(config, "GATT", "AdaptiveConnection",
+					&btd_opts.gatt_adaptive_conn);
+	parse_config_bool(config, "GATT", "AdaptiveChannels",
+					&btd_opts.gatt_adaptive_chans);
 	parse_gatt_export(config);
 }
 
@@ -1193,6 +1253,9 @@ static void parse_avrcp(GKeyFile *config)
 	parse_config_bool(config, "AVRCP",
 		"VolumeCategory",
 		&btd_opts.avrcp.volume_category);
+	parse_config_u32(config, "AVRCP", "PositionInterval",
+				&btd_opts.avrcp.position_interval,
+				0, 60000);
 }
 
 static void parse_advmon(GKeyFile *config)
@@ -1233,11 +1296,13 @@ static void init_defaults(void)
 	btd_opts.pairto = DEFAULT_PAIRABLE_TIMEOUT;
 	btd_opts.discovto = DEFAULT_DISCOVERABLE_TIMEOUT;
 	btd_opts.tmpto = DEFAULT_TEMPORARY_TIMEOUT;
+	btd_opts.sdp_cache_timeout = DEFAULT_SDP_CACHE_TIMEOUT;
 	btd_opts.reverse_discovery = TRUE;
 	btd_opts.name_resolv = TRUE;
 	btd_opts.debug_keys = FALSE;
 	btd_opts.refresh_discovery = TRUE;
 	btd_opts.name_request_retry_delay = DEFAULT_NAME_REQUEST_RETRY_DELAY;
+	btd_opts.rssi_threshold = DEFAULT_RSSI_THRESHOLD;
 	btd_opts.secure_conn = SC_ON;
 
 	btd_opts.defaults.num_entries = 0;
@@ -1265,6 +1330,7 @@ static void init_defaults(void)
 
 	btd_opts.avrcp.volume_without_target = false;
 	btd_opts.avrcp.volume_category = true;
+	btd_opts.avrcp.position_interval = 1000;
 
 	btd_opts.advmon.rssi_sampling_period = 0xFF;
 	btd_opts.csis.encrypt = true;
@@ -1296,6 +1362,11 @@ static bool quit_eventloop(gpointer user_data)
 	return FALSE;
 }
 
+static void alloc_stats_debug(const char *str, void *user_data)
+{
+	info("%s", str);
+}
+
 static void signal_callback(int signum, void *user_data)
 {
 	static bool terminated = false;
@@ -1316,6 +1387,7 @@ static void signal_callback(int signum, void *user_data)
 		break;
 	case SIGUSR2:
 		__btd_toggle_debug();
+		util_alloc_stats_dump(alloc_stats_debug, NULL);
 		break;
 	}
 }
@@ -1393,6 +1465,44 @@ static int connect_dbus(void)
 	return 0;
 }
 
+static gboolean property_get_debug(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *user_data)
+{
+	const char *str = __btd_get_debug() ? : "";
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &str);
+
+	return TRUE;
+}
+
+static void property_set_debug(const GDBusPropertyTable *property,
+				DBusMessageIter *iter,
+				GDBusPendingPropertySet id, void *user_data)
+{
+	const char *str;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_STRING) {
+		g_dbus_pending_property_error(id,
+					ERROR_INTERFACE ".InvalidArguments",
+					"Invalid arguments in method call");
+		return;
+	}
+
+	dbus_message_iter_get_basic(iter, &str);
+
+	__btd_set_debug(str);
+
+	g_dbus_pending_property_success(id);
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(), "/org/bluez",
+					DEBUG_INTERFACE, "Debug");
+}
+
+static const GDBusPropertyTable debug_properties[] = {
+	{ "Debug", "s", property_get_debug, property_set_debug },
+	{ }
+};
+
 static gboolean parse_debug(const char *key, const char *value,
 				gpointer user_data, GError **error)
 {
@@ -1498,12 +1608,18 @@ int main(int argc, char *argv[])
 
 	btd_device_init();
 	btd_agent_init();
+
+	g_dbus_register_interface(btd_get_dbus_connection(), "/org/bluez",
+					DEBUG_INTERFACE, NULL, NULL,
+					debug_properties, NULL, NULL);
 	btd_profile_init();
 
 	if (btd_opts.mode != BT_MODE_LE) {
 		if (option_compat == TRUE)
 			sdp_flags |= SDP_SERVER_COMPAT;
 
+		bt_search_set_cache_timeout(btd_opts.sdp_cache_timeout);
+
 		start_sdp_server(sdp_mtu, sdp_flags);
 
 		if (btd_opts.did_source > 0)
@@ -1539,11 +1655,15 @@ int main(int argc, char *argv[])
 	plugin_cleanup();
 
 	btd_profile_cleanup();
+	g_dbus_unregister_interface(btd_get_dbus_connection(), "/org/bluez",
+							DEBUG_INTERFACE);
 	btd_agent_cleanup();
 	btd_device_cleanup();
 
 	adapter_cleanup();
 
+	btd_storage_cleanup();
+
 	rfkill_exit();
 
 	if (btd_opts.mode != BT_MODE_LE)
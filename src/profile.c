@@ -17,6 +17,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <time.h>
 
 #include <glib.h>
 #include <dbus/dbus.h>
@@ -684,6 +686,10 @@ struct ext_profile {
 	GSList *conns;
 
 	GSList *connects;
+
+	unsigned int setups;
+	unsigned int setup_failures;
+	uint64_t setup_time;
 };
 
 struct ext_io {
@@ -706,6 +712,8 @@ struct ext_io {
 
 	guint auth_id;
 	DBusPendingCall *pending;
+
+	struct timespec start;
 };
 
 struct ext_record {
@@ -884,6 +892,32 @@ drop:
 	return FALSE;
 }
 
+static void conn_setup_complete(struct ext_io *conn, bool success)
+{
+	struct ext_profile *ext = conn->ext;
+	struct timespec now;
+	unsigned int elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	elapsed = (now.tv_sec - conn->start.tv_sec) * 1000 +
+			(now.tv_nsec - conn->start.tv_nsec) / 1000000;
+
+	if (!success) {
+		ext->setup_failures++;
+		DBG("%s setup failed after %u ms (%u failures)", ext->name,
+						elapsed, ext->setup_failures);
+		return;
+	}
+
+	ext->setups++;
+	ext->setup_time += elapsed;
+
+	DBG("%s setup took %u ms (%u connections, average %" PRIu64 " ms)",
+					ext->name, elapsed, ext->setups,
+					ext->setup_time / ext->setups);
+}
+
 static void new_conn_reply(DBusPendingCall *call, void *user_data)
 {
 	struct ext_io *conn = user_data;
@@ -904,12 +938,15 @@ static void new_conn_reply(DBusPendingCall *call, void *user_data)
 			btd_service_connecting_complete(conn->service, 0);
 
 		conn->connected = true;
+		conn_setup_complete(conn, true);
 		return;
 	}
 
 	error("%s replied with an error: %s, %s", ext->name,
 						err.name, err.message);
 
+	conn_setup_complete(conn, false);
+
 	if (conn->service)
 		btd_service_connecting_complete(conn->service, -ECONNREFUSED);
 
@@ -1141,6 +1178,12 @@ static void ext_connect(GIOChannel *io, GError *err, gpointer user_data)
 		return;
 
 drop:
+	conn_setup_complete(conn, false);
+
+	/* The cached records may be outdated */
+	bt_search_invalidate(btd_adapter_get_address(conn->adapter),
+					device_get_address(conn->device));
+
 	if (conn->service)
 		btd_service_connecting_complete(conn->service,
 						err ? -err->code : -EIO);
@@ -1185,6 +1228,7 @@ static void ext_auth(DBusError *err, void *user_data)
 	return;
 
 drop:
+	conn_setup_complete(conn, false);
 	ext->conns = g_slist_remove(ext->conns, conn);
 	ext_io_destroy(conn);
 }
@@ -1231,6 +1275,8 @@ done:
 	if (service)
 		conn->service = btd_service_ref(service);
 
+	clock_gettime(CLOCK_MONOTONIC, &conn->start);
+
 	cond = G_IO_HUP | G_IO_ERR | G_IO_NVAL;
 	conn->io_id = g_io_add_watch(io, cond, ext_io_disconnected, conn);
 
@@ -1625,7 +1671,7 @@ static int connect_io(struct ext_io *conn, const bdaddr_t *src,
 	return 0;
 }
 
-static uint16_t get_goep_l2cap_psm(sdp_record_t *rec)
+static uint16_t get_goep_l2cap_psm(const sdp_record_t *rec)
 {
 	sdp_data_t *data;
 
@@ -1643,6 +1689,34 @@ static uint16_t get_goep_l2cap_psm(sdp_record_t *rec)
 	return data->val.uint16;
 }
 
+static int parse_record(struct ext_io *conn, const sdp_record_t *rec)
+{
+	sdp_list_t *protos;
+	int port;
+
+	if (sdp_get_access_protos(rec, &protos) < 0) {
+		error("Unable to get proto list from %s record",
+							conn->ext->name);
+		return -ENOTSUP;
+	}
+
+	port = sdp_get_proto_port(protos, L2CAP_UUID);
+	if (port > 0)
+		conn->psm = port;
+
+	port = sdp_get_proto_port(protos, RFCOMM_UUID);
+	if (port > 0)
+		conn->chan = port;
+
+	if (conn->psm == 0 && sdp_get_proto_desc(protos, OBEX_UUID))
+		conn->psm = get_goep_l2cap_psm(rec);
+
+	sdp_list_foreach(protos, (sdp_list_func_t) sdp_list_free, NULL);
+	sdp_list_free(protos, NULL);
+
+	return 0;
+}
+
 static void record_cb(sdp_list_t *recs, int err, gpointer user_data)
 {
 	struct ext_io *conn = user_data;
@@ -1664,31 +1738,9 @@ static void record_cb(sdp_list_t *recs, int err, gpointer user_data)
 	}
 
 	for (r = recs; r != NULL; r = r->next) {
-		sdp_record_t *rec = r->data;
-		sdp_list_t *protos;
-		int port;
-
-		if (sdp_get_access_protos(rec, &protos) < 0) {
-			error("Unable to get proto list from %s record",
-								ext->name);
-			err = -ENOTSUP;
+		err = parse_record(conn, r->data);
+		if (err < 0)
 			goto failed;
-		}
-
-		port = sdp_get_proto_port(protos, L2CAP_UUID);
-		if (port > 0)
-			conn->psm = port;
-
-		port = sdp_get_proto_port(protos, RFCOMM_UUID);
-		if (port > 0)
-			conn->chan = port;
-
-		if (conn->psm == 0 && sdp_get_proto_desc(protos, OBEX_UUID))
-			conn->psm = get_goep_l2cap_psm(rec);
-
-		sdp_list_foreach(protos, (sdp_list_func_t) sdp_list_free,
-									NULL);
-		sdp_list_free(protos, NULL);
 
 		if (conn->chan || conn->psm)
 			break;
@@ -1711,6 +1763,8 @@ static void record_cb(sdp_list_t *recs, int err, gpointer user_data)
 	return;
 
 failed:
+	conn_setup_complete(conn, false);
+
 	if (conn->service)
 		btd_service_connecting_complete(conn->service, err);
 
@@ -1718,6 +1772,23 @@ failed:
 	ext_io_destroy(conn);
 }
 
+/*
+ * Use the record found during service discovery when there is one, a new
+ * SDP search per connection only adds latency.  Should the record turn out
+ * to be outdated the connection fails and the cached records are
+ * invalidated.
+ */
+static bool resolve_cached(struct ext_io *conn, struct btd_device *dev)
+{
+	const sdp_record_t *rec;
+
+	rec = btd_device_get_record(dev, conn->ext->remote_uuid);
+	if (!rec || parse_record(conn, rec) < 0)
+		return false;
+
+	return conn->chan || conn->psm;
+}
+
 static int resolve_service(struct ext_io *conn, const bdaddr_t *src,
 							const bdaddr_t *dst)
 {
@@ -1756,12 +1827,16 @@ static int ext_connect_dev(struct btd_service *service)
 
 	conn = g_new0(struct ext_io, 1);
 	conn->ext = ext;
+	clock_gettime(CLOCK_MONOTONIC, &conn->start);
 
 	if (ext->remote_psm || ext->remote_chan) {
 		conn->psm = ext->remote_psm;
 		conn->chan = ext->remote_chan;
 		err = connect_io(conn, btd_adapter_get_address(adapter),
 						device_get_address(dev));
+	} else if (resolve_cached(conn, dev)) {
+		err = connect_io(conn, btd_adapter_get_address(adapter),
+						device_get_address(dev));
 	} else {
 		err = resolve_service(conn, btd_adapter_get_address(adapter),
 						device_get_address(dev));
@@ -38,6 +38,18 @@ struct cached_sdp_session {
 
 static GSList *cached_sdp_sessions = NULL;
 
+/* Service search results, kept for cache_timeout seconds */
+struct cached_sdp_result {
+	bdaddr_t src;
+	bdaddr_t dst;
+	uuid_t uuid;
+	sdp_list_t *recs;
+	unsigned int timer;
+};
+
+static GSList *cached_sdp_results = NULL;
+static unsigned int cache_timeout = 0;
+
 static void cleanup_cached_session(struct cached_sdp_session *cached)
 {
 	cached_sdp_sessions = g_slist_remove(cached_sdp_sessions, cached);
@@ -122,6 +134,77 @@ static void cache_sdp_session(bdaddr_t *src, bdaddr_t *dst,
 	g_io_channel_unref(chan);
 }
 
+static void cached_result_free(struct cached_sdp_result *cached)
+{
+	cached_sdp_results = g_slist_remove(cached_sdp_results, cached);
+	timeout_remove(cached->timer);
+	sdp_list_free(cached->recs, (sdp_free_func_t) sdp_record_free);
+	g_free(cached);
+}
+
+static bool cached_result_expired(gpointer user_data)
+{
+	struct cached_sdp_result *cached = user_data;
+
+	cached->timer = 0;
+	cached_result_free(cached);
+
+	return FALSE;
+}
+
+static struct cached_sdp_result *find_cached_result(const bdaddr_t *src,
+							const bdaddr_t *dst,
+							const uuid_t *uuid)
+{
+	GSList *l;
+
+	for (l = cached_sdp_results; l != NULL; l = l->next) {
+		struct cached_sdp_result *c = l->data;
+
+		if (bacmp(&c->src, src) || bacmp(&c->dst, dst))
+			continue;
+
+		if (sdp_uuid_cmp(&c->uuid, uuid) == 0)
+			return c;
+	}
+
+	return NULL;
+}
+
+static sdp_list_t *copy_records(sdp_list_t *recs)
+{
+	sdp_list_t *copy = NULL;
+
+	for (; recs; recs = recs->next)
+		copy = sdp_list_append(copy, sdp_copy_record(recs->data));
+
+	return copy;
+}
+
+static void cache_sdp_result(const bdaddr_t *src, const bdaddr_t *dst,
+					const uuid_t *uuid, sdp_list_t *recs)
+{
+	struct cached_sdp_result *cached;
+
+	if (!cache_timeout || !recs)
+		return;
+
+	cached = find_cached_result(src, dst, uuid);
+	if (cached)
+		cached_result_free(cached);
+
+	cached = g_new0(struct cached_sdp_result, 1);
+	bacpy(&cached->src, src);
+	bacpy(&cached->dst, dst);
+	cached->uuid = *uuid;
+	cached->recs = copy_records(recs);
+	cached->timer = timeout_add_seconds(cache_timeout,
+						cached_result_expired,
+						cached, NULL);
+
+	cached_sdp_results = g_slist_prepend(cached_sdp_results, cached);
+}
+
 struct search_context {
 	bdaddr_t		src;
 	bdaddr_t		dst;
@@ -132,6 +215,7 @@ struct search_context {
 	uuid_t			uuid;
 	guint			io_id;
 	gboolean		filter_svc_class;
+	sdp_list_t		*cached;
 };
 
 static GSList *context_list = NULL;
@@ -143,6 +227,7 @@ static void search_context_cleanup(struct search_context *ctxt)
 	if (ctxt->destroy)
 		ctxt->destroy(ctxt->user_data);
 
+	sdp_list_free(ctxt->cached, (sdp_free_func_t) sdp_record_free);
 	g_free(ctxt);
 }
 
@@ -200,6 +285,11 @@ static void search_completed_cb(uint8_t type, uint16_t status,
 done:
 	cache_sdp_session(&ctxt->src, &ctxt->dst, ctxt->session);
 
+	if (err < 0)
+		bt_search_invalidate(&ctxt->src, &ctxt->dst);
+	else if (ctxt->filter_svc_class)
+		cache_sdp_result(&ctxt->src, &ctxt->dst, &ctxt->uuid, recs);
+
 	if (ctxt->cb)
 		ctxt->cb(recs, err, ctxt->user_data);
 
@@ -218,6 +308,8 @@ static gboolean search_process_cb(GIOChannel *chan, GIOCondition cond,
 		sdp_close(ctxt->session);
 		ctxt->session = NULL;
 
+		bt_search_invalidate(&ctxt->src, &ctxt->dst);
+
 		if (ctxt->cb)
 			ctxt->cb(NULL, -EIO, ctxt->user_data);
 
@@ -379,6 +471,50 @@ int bt_search(const bdaddr_t *src, const bdaddr_t *dst,
 	return 0;
 }
 
+static gboolean cached_search_cb(gpointer user_data)
+{
+	struct search_context *ctxt = user_data;
+
+	ctxt->io_id = 0;
+
+	ctxt->cb(ctxt->cached, 0, ctxt->user_data);
+
+	search_context_cleanup(ctxt);
+
+	return FALSE;
+}
+
+static bool search_cached(const bdaddr_t *src, const bdaddr_t *dst,
+			uuid_t *uuid, bt_callback_t cb, void *user_data,
+			bt_destroy_t destroy)
+{
+	struct cached_sdp_result *cached;
+	struct search_context *ctxt;
+
+	cached = find_cached_result(src, dst, uuid);
+	if (!cached)
+		return false;
+
+	DBG("Using cached service records");
+
+	ctxt = g_new0(struct search_context, 1);
+	bacpy(&ctxt->src, src);
+	bacpy(&ctxt->dst, dst);
+	ctxt->uuid = *uuid;
+	ctxt->cb = cb;
+	ctxt->destroy = destroy;
+	ctxt->user_data = user_data;
+	ctxt->filter_svc_class = TRUE;
+	ctxt->cached = copy_records(cached->recs);
+
+	/* Callers expect the callback to be called asynchronously */
+	ctxt->io_id = g_idle_add(cached_search_cb, ctxt);
+
+	context_list = g_slist_append(context_list, ctxt);
+
+	return true;
+}
+
 int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
 			uuid_t *uuid, bt_callback_t cb, void *user_data,
 			bt_destroy_t destroy, uint16_t flags)
@@ -389,6 +525,9 @@ int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
 	if (!cb)
 		return -EINVAL;
 
+	if (search_cached(src, dst, uuid, cb, user_data, destroy))
+		return 0;
+
 	/* The resulting service class ID need to match uuid */
 	err = create_search_context_full(&ctxt, src, dst, uuid, flags,
 					user_data, cb, destroy, TRUE);
@@ -428,7 +567,7 @@ int bt_cancel_discovery(const bdaddr_t *src, const bdaddr_t *dst)
 
 	ctxt = l->data;
 
-	if (!ctxt->session)
+	if (!ctxt->session && !ctxt->cached)
 		return -ENOTCONN;
 
 	if (ctxt->io_id)
@@ -450,3 +589,29 @@ void bt_clear_cached_session(const bdaddr_t *src, const bdaddr_t *dst)
 	if (session)
 		sdp_close(session);
 }
+
+void bt_search_set_cache_timeout(unsigned int seconds)
+{
+	cache_timeout = seconds;
+
+	if (!cache_timeout) {
+		while (cached_sdp_results)
+			cached_result_free(cached_sdp_results->data);
+	}
+}
+
+void bt_search_invalidate(const bdaddr_t *src, const bdaddr_t *dst)
+{
+	GSList *l, *next;
+
+	for (l = cached_sdp_results; l != NULL; l = next) {
+		struct cached_sdp_result *c = l->data;
+
+		next = l->next;
+
+		if (bacmp(&c->src, src) || bacmp(&c->dst, dst))
+			continue;
+
+		cached_result_free(c);
+	}
+}
@@ -17,6 +17,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "lib/bluetooth.h"
 #include "lib/sdp.h"
@@ -33,6 +34,27 @@ typedef struct {
 	bdaddr_t device;
 } sdp_access_t;
 
+/*
+ * Inverted index from the 128-bit UUIDs of the record search patterns
+ * to the records containing them, and the encoded PDU of each record.
+ * Both are built on demand and dropped whenever the repository changes.
+ */
+typedef struct {
+	uint128_t uuid;
+	sdp_list_t *records;	/* Sorted by record handle */
+} sdp_uuid_index_t;
+
+typedef struct {
+	uint32_t handle;
+	sdp_buf_t pdu;
+} sdp_pdu_cache_t;
+
+static sdp_uuid_index_t *uuid_index;
+static int uuid_index_len;
+static bool uuid_index_valid;
+static sdp_list_t *pdu_cache;
+static uint32_t svcdb_generation;
+
 /*
  * Ordering function called when inserting a service record.
  * The service repository is a linked list in sorted order
@@ -69,11 +91,197 @@ static void access_free(void *p)
 	free(p);
 }
 
+static void pdu_cache_free(void *p)
+{
+	sdp_pdu_cache_t *cache = p;
+
+	free(cache->pdu.data);
+	free(cache);
+}
+
+static int pdu_cache_sort(const void *p1, const void *p2)
+{
+	const sdp_pdu_cache_t *c1 = p1;
+	const sdp_pdu_cache_t *c2 = p2;
+
+	return c1->handle - c2->handle;
+}
+
+/*
+ * Drop the UUID index and encoded records, called whenever records are
+ * added, removed or modified
+ */
+void sdp_svcdb_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < uuid_index_len; i++)
+		sdp_list_free(uuid_index[i].records, NULL);
+
+	free(uuid_index);
+	uuid_index = NULL;
+	uuid_index_len = 0;
+	uuid_index_valid = false;
+
+	sdp_list_free(pdu_cache, pdu_cache_free);
+	pdu_cache = NULL;
+
+	svcdb_generation++;
+}
+
+/*
+ * Return a counter that changes whenever the repository changes
+ */
+uint32_t sdp_svcdb_get_generation(void)
+{
+	return svcdb_generation;
+}
+
+static int uuid_index_cmp(const void *p1, const void *p2)
+{
+	const sdp_uuid_index_t *i1 = p1;
+	const sdp_uuid_index_t *i2 = p2;
+
+	return memcmp(&i1->uuid, &i2->uuid, sizeof(uint128_t));
+}
+
+static void uuid_index_build(void)
+{
+	sdp_list_t *l, *p;
+	int i, size = 0;
+
+	for (l = service_db; l; l = l->next) {
+		sdp_record_t *rec = l->data;
+
+		for (p = rec->pattern; p; p = p->next) {
+			uuid_t *uuid = p->data;
+			sdp_uuid_index_t *entry = NULL;
+
+			if (uuid == NULL)
+				continue;
+
+			for (i = 0; i < uuid_index_len; i++) {
+				if (!memcmp(&uuid_index[i].uuid,
+						&uuid->value.uuid128,
+						sizeof(uint128_t))) {
+					entry = &uuid_index[i];
+					break;
+				}
+			}
+
+			if (!entry) {
+				if (uuid_index_len == size) {
+					void *tmp;
+
+					size = size ? size * 2 : 32;
+					tmp = realloc(uuid_index,
+						size * sizeof(*uuid_index));
+					if (!tmp) {
+						sdp_svcdb_invalidate();
+						return;
+					}
+
+					uuid_index = tmp;
+				}
+
+				entry = &uuid_index[uuid_index_len++];
+				memcpy(&entry->uuid, &uuid->value.uuid128,
+							sizeof(uint128_t));
+				entry->records = NULL;
+			}
+
+			/* service_db is walked in handle order */
+			entry->records = sdp_list_append(entry->records, rec);
+		}
+	}
+
+	qsort(uuid_index, uuid_index_len, sizeof(*uuid_index),
+							uuid_index_cmp);
+
+	uuid_index_valid = true;
+
+	SDPDBG("Indexed %d UUIDs", uuid_index_len);
+}
+
+/*
+ * Return the records that may match a search pattern of UUIDs, which is
+ * the shortest list of records containing any one of the UUIDs. The
+ * records still need to be matched against the full pattern.
+ */
+sdp_list_t *sdp_svcdb_candidates(sdp_list_t *search)
+{
+	sdp_list_t *candidates = service_db;
+	int best = -1;
+
+	if (!uuid_index_valid)
+		uuid_index_build();
+
+	if (!uuid_index_valid)
+		return service_db;
+
+	for (; search; search = search->next) {
+		sdp_uuid_index_t key, *entry;
+		uuid_t *uuid128;
+		int len;
+
+		if (search->data == NULL)
+			return service_db;
+
+		uuid128 = sdp_uuid_to_uuid128(search->data);
+		memcpy(&key.uuid, &uuid128->value.uuid128, sizeof(uint128_t));
+		bt_free(uuid128);
+
+		entry = bsearch(&key, uuid_index, uuid_index_len,
+					sizeof(*uuid_index), uuid_index_cmp);
+		if (!entry)
+			return NULL;
+
+		len = sdp_list_len(entry->records);
+		if (best < 0 || len < best) {
+			best = len;
+			candidates = entry->records;
+		}
+	}
+
+	return candidates;
+}
+
+/*
+ * Return the encoded PDU of a record, generating it the first time
+ */
+const sdp_buf_t *sdp_record_get_pdu(sdp_record_t *rec)
+{
+	sdp_pdu_cache_t key, *cache;
+	sdp_list_t *p;
+
+	key.handle = rec->handle;
+	p = sdp_list_find(pdu_cache, &key, pdu_cache_sort);
+	if (p)
+		return &((sdp_pdu_cache_t *) p->data)->pdu;
+
+	cache = malloc(sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->handle = rec->handle;
+
+	if (sdp_gen_record_pdu(rec, &cache->pdu) < 0) {
+		free(cache);
+		return NULL;
+	}
+
+	pdu_cache = sdp_list_insert_sorted(pdu_cache, cache, pdu_cache_sort);
+
+	return &cache->pdu;
+}
+
 /*
  * Reset the service repository by deleting its contents
  */
 void sdp_svcdb_reset(void)
 {
+	sdp_svcdb_invalidate();
+
 	sdp_list_free(service_db, (sdp_free_func_t) sdp_record_free);
 	service_db = NULL;
 
@@ -167,6 +375,7 @@ void sdp_record_add(const bdaddr_t *device, sdp_record_t *rec)
 	SDPDBG("with handle : 0x%x", rec->handle);
 
 	service_db = sdp_list_insert_sorted(service_db, rec, record_sort);
+	sdp_svcdb_invalidate();
 
 	dev = malloc(sizeof(*dev));
 	if (!dev)
@@ -241,6 +450,8 @@ int sdp_record_remove(uint32_t handle)
 	if (r)
 		service_db = sdp_list_remove(service_db, r);
 
+	sdp_svcdb_invalidate();
+
 	p = access_locate(handle);
 	if (p == NULL || p->data == NULL)
 		return 0;
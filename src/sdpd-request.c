@@ -53,6 +53,124 @@ struct sdp_cont_info {
 
 static sdp_list_t *cstates;
 
+/*
+ * Complete ServiceSearchAttribute responses, keyed by the search pattern
+ * and attribute list of the request, and dropped whenever the service
+ * repository changes.
+ */
+#define SDP_RSP_CACHE_MAX 16
+
+typedef struct {
+	bdaddr_t device;
+	uint8_t *key;
+	unsigned int pattern_len;
+	unsigned int attrs_len;
+	uint16_t rsp_count;
+	sdp_buf_t buf;
+} sdp_rsp_cache_t;
+
+static sdp_list_t *rsp_cache;
+static uint32_t rsp_cache_generation;
+
+static void rsp_cache_free(void *data)
+{
+	sdp_rsp_cache_t *cache = data;
+
+	free(cache->key);
+	free(cache->buf.data);
+	free(cache);
+}
+
+void sdp_rsp_cache_cleanup(void)
+{
+	sdp_list_free(rsp_cache, rsp_cache_free);
+	rsp_cache = NULL;
+}
+
+static sdp_rsp_cache_t *rsp_cache_find(sdp_req_t *req,
+					const uint8_t *pattern,
+					unsigned int pattern_len,
+					const uint8_t *attrs,
+					unsigned int attrs_len)
+{
+	sdp_list_t *l, *prev = NULL;
+
+	if (rsp_cache_generation != sdp_svcdb_get_generation()) {
+		sdp_rsp_cache_cleanup();
+		rsp_cache_generation = sdp_svcdb_get_generation();
+		return NULL;
+	}
+
+	for (l = rsp_cache; l; prev = l, l = l->next) {
+		sdp_rsp_cache_t *cache = l->data;
+
+		if (cache->pattern_len != pattern_len ||
+					cache->attrs_len != attrs_len)
+			continue;
+
+		if (bacmp(&cache->device, &req->device) ||
+				memcmp(cache->key, pattern, pattern_len) ||
+				memcmp(cache->key + pattern_len, attrs,
+								attrs_len))
+			continue;
+
+		/* Move to the front so the least used entry is the last */
+		if (prev) {
+			prev->next = l->next;
+			l->next = rsp_cache;
+			rsp_cache = l;
+		}
+
+		return cache;
+	}
+
+	return NULL;
+}
+
+static void rsp_cache_add(sdp_req_t *req, const uint8_t *pattern,
+				unsigned int pattern_len, const uint8_t *attrs,
+				unsigned int attrs_len, uint16_t rsp_count,
+				sdp_buf_t *buf)
+{
+	sdp_rsp_cache_t *cache;
+	sdp_list_t *last;
+
+	if (sdp_list_len(rsp_cache) >= SDP_RSP_CACHE_MAX) {
+		last = rsp_cache;
+		while (last->next)
+			last = last->next;
+
+		cache = last->data;
+		rsp_cache = sdp_list_remove(rsp_cache, cache);
+		rsp_cache_free(cache);
+	}
+
+	cache = malloc(sizeof(*cache));
+	if (!cache)
+		return;
+
+	cache->key = malloc(pattern_len + attrs_len);
+	cache->buf.data = malloc(buf->data_size);
+	if (!cache->key || (buf->data_size && !cache->buf.data)) {
+		free(cache->buf.data);
+		free(cache->key);
+		free(cache);
+		return;
+	}
+
+	bacpy(&cache->device, &req->device);
+	memcpy(cache->key, pattern, pattern_len);
+	memcpy(cache->key + pattern_len, attrs, attrs_len);
+	cache->pattern_len = pattern_len;
+	cache->attrs_len = attrs_len;
+	cache->rsp_count = rsp_count;
+	memcpy(cache->buf.data, buf->data, buf->data_size);
+	cache->buf.data_size = buf->data_size;
+	cache->buf.buf_size = buf->data_size;
+
+	rsp_cache = sdp_list_prepend(rsp_cache, cache);
+}
+
 static int cstate_match(const void *data, const void *user_data)
 {
 	const sdp_cont_info_t *cinfo = data;
@@ -460,8 +578,8 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 	buf->data_size += sizeof(uint16_t);
 
 	if (cstate == NULL) {
-		/* for every record in the DB, do a pattern search */
-		sdp_list_t *list = sdp_get_record_list();
+		/* for every candidate record, do a pattern search */
+		sdp_list_t *list = sdp_svcdb_candidates(pattern);
 
 		handleSize = 0;
 		for (; list && rsp_count < expected; list = list->next) {
@@ -595,7 +713,7 @@ done:
  */
 static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 {
-	sdp_buf_t pdu;
+	const sdp_buf_t *pdu = NULL;
 
 	if (!rec)
 		return SDP_INVALID_RECORD_HANDLE;
@@ -607,8 +725,6 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 
 	SDPDBG("Entries in attr seq : %d", sdp_list_len(seq));
 
-	sdp_gen_record_pdu(rec, &pdu);
-
 	for (; seq; seq = seq->next) {
 		struct attrid *aid = seq->data;
 
@@ -630,10 +746,13 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 			SDPDBG("Low id : 0x%x", low);
 			SDPDBG("High id : 0x%x", high);
 
-			if (low == 0x0000 && high == 0xffff && pdu.data_size <= buf->buf_size) {
+			if (low == 0x0000 && high == 0xffff)
+				pdu = sdp_record_get_pdu(rec);
+
+			if (pdu && pdu->data_size <= buf->buf_size) {
 				/* copy it */
-				memcpy(buf->data, pdu.data, pdu.data_size);
-				buf->data_size = pdu.data_size;
+				memcpy(buf->data, pdu->data, pdu->data_size);
+				buf->data_size = pdu->data_size;
 				break;
 			}
 			/* (else) sub-range of attributes */
@@ -648,13 +767,10 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 		} else {
 			error("Unexpected data type : 0x%x", aid->dtd);
 			error("Expect uint16_t or uint32_t");
-			free(pdu.data);
 			return SDP_INVALID_SYNTAX;
 		}
 	}
 
-	free(pdu.data);
-
 	return 0;
 }
 
@@ -843,6 +959,8 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 	sdp_list_t *pattern = NULL, *seq = NULL, *svcList;
 	sdp_cont_state_t *cstate = NULL;
 	sdp_cont_info_t *cinfo = NULL;
+	uint8_t *pattern_data, *attrs_data;
+	unsigned int pattern_len, attrs_len;
 	short cstate_size = 0;
 	uint8_t dtd = 0;
 	sdp_buf_t tmpbuf;
@@ -857,6 +975,8 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 		goto done;
 	}
 	totscanned = scanned;
+	pattern_data = pdata;
+	pattern_len = scanned;
 
 	SDPDBG("Bytes scanned: %d", scanned);
 
@@ -886,6 +1006,8 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 		status = SDP_INVALID_SYNTAX;
 		goto done;
 	}
+	attrs_data = pdata;
+	attrs_len = scanned;
 
 	pdata += scanned;
 	data_left -= scanned;
@@ -907,7 +1029,7 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 		goto done;
 	}
 
-	svcList = sdp_get_record_list();
+	svcList = sdp_svcdb_candidates(pattern);
 
 	tmpbuf.data = malloc(USHRT_MAX);
 	tmpbuf.data_size = 0;
@@ -926,7 +1048,20 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 
 	if (cstate == NULL) {
 		/* no continuation state -> create new response */
+		sdp_rsp_cache_t *cache;
 		sdp_list_t *p;
+
+		/* unless an identical request has been answered already */
+		cache = rsp_cache_find(req, pattern_data, pattern_len,
+						attrs_data, attrs_len);
+		if (cache) {
+			memcpy(buf->data, cache->buf.data,
+						cache->buf.data_size);
+			buf->data_size = cache->buf.data_size;
+			rsp_count = cache->rsp_count;
+			svcList = NULL;
+		}
+
 		for (p = svcList; p; p = p->next) {
 			sdp_record_t *rec = p->data;
 			if (sdp_match_uuid(pattern, rec->pattern) > 0 &&
@@ -952,6 +1087,11 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 				SDPDBG("Net PDU size : %d", buf->data_size);
 			}
 		}
+
+		if (!cache && !status)
+			rsp_cache_add(req, pattern_data, pattern_len,
+					attrs_data, attrs_len, rsp_count, buf);
+
 		if (buf->data_size > max) {
 			sdp_cont_state_t newState;
 
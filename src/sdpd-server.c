@@ -253,6 +253,7 @@ void stop_sdp_server(void)
 	info("Stopping SDP server");
 
 	sdp_svcdb_reset();
+	sdp_rsp_cache_cleanup();
 
 	if (unix_id > 0)
 		g_source_remove(unix_id);
@@ -297,6 +297,8 @@ uint32_t sdp_get_time(void)
  */
 static void update_db_timestamp(void)
 {
+	sdp_svcdb_invalidate();
+
 	if (fixed_dbts) {
 		sdp_data_t *d = sdp_data_alloc(SDP_UINT32, &fixed_dbts);
 		sdp_attr_replace(server, SDP_ATTR_SVCDB_STATE, d);
@@ -31,6 +31,7 @@ typedef struct request {
 } sdp_req_t;
 
 void sdp_cstate_cleanup(int sock);
+void sdp_rsp_cache_cleanup(void);
 
 void handle_internal_request(int sk, int mtu, void *data, int len);
 void handle_request(int sk, uint8_t *data, int len);
@@ -56,6 +57,10 @@ sdp_record_t *sdp_record_find(uint32_t handle);
 void sdp_record_add(const bdaddr_t *device, sdp_record_t *rec);
 int sdp_record_remove(uint32_t handle);
 sdp_list_t *sdp_get_record_list(void);
+void sdp_svcdb_invalidate(void);
+uint32_t sdp_svcdb_get_generation(void);
+sdp_list_t *sdp_svcdb_candidates(sdp_list_t *search);
+const sdp_buf_t *sdp_record_get_pdu(sdp_record_t *rec);
 int sdp_check_access(uint32_t handle, bdaddr_t *device);
 uint32_t sdp_next_handle(void);
 
@@ -50,18 +50,96 @@ struct btd_device_set {
 	struct btd_device *device;
 };
 
+static bool match_discovered(const void *data, const void *match_data)
+{
+	struct btd_device *device = (void *) data;
+
+	return !gatt_db_isempty(btd_device_get_gatt_db(device));
+}
+
+static void set_share_gatt_db(struct btd_device_set *set,
+						struct btd_device *device)
+{
+	struct btd_device *member;
+
+	if (!gatt_db_isempty(btd_device_get_gatt_db(device)))
+		return;
+
+	/* Attempt to use existing gatt_db from set if device has never been
+	 * connected before.
+	 *
+	 * If dbs don't really match bt_gatt_client will attempt to rediscover
+	 * the ranges that don't match.
+	 */
+	member = queue_find(set->devices, match_discovered, NULL);
+	if (member)
+		btd_device_set_gatt_db(device, btd_device_get_gatt_db(member));
+}
+
+static int set_connect_all(struct btd_device_set *set)
+{
+	const struct queue_entry *entry;
+	int err = -EALREADY;
+
+	/* Connect all members at once instead of waiting for each one to
+	 * connect and resolve its services before moving to the next.
+	 */
+	for (entry = queue_get_entries(set->devices); entry;
+					entry = entry->next) {
+		struct btd_device *device = entry->data;
+		int ret;
+
+		if (btd_device_is_connected(device))
+			continue;
+
+		set_share_gatt_db(set, device);
+
+		ret = device_connect_le(device);
+		if (!ret || err == -EALREADY)
+			err = ret;
+	}
+
+	return err;
+}
+
 static DBusMessage *set_disconnect(DBusConnection *conn, DBusMessage *msg,
 							void *user_data)
 {
-	/* TODO */
-	return NULL;
+	struct btd_device_set *set = user_data;
+	const struct queue_entry *entry;
+	bool connected = false;
+
+	for (entry = queue_get_entries(set->devices); entry;
+					entry = entry->next) {
+		struct btd_device *device = entry->data;
+
+		if (!btd_device_is_connected(device))
+			continue;
+
+		connected = true;
+		device_request_disconnect(device, NULL);
+	}
+
+	if (!connected)
+		return btd_error_not_connected(msg);
+
+	return dbus_message_new_method_return(msg);
 }
 
 static DBusMessage *set_connect(DBusConnection *conn, DBusMessage *msg,
 							void *user_data)
 {
-	/* TODO */
-	return NULL;
+	struct btd_device_set *set = user_data;
+	int err;
+
+	err = set_connect_all(set);
+	if (err == -EALREADY)
+		return btd_error_already_connected(msg);
+
+	if (err < 0)
+		return btd_error_failed(msg, strerror(-err));
+
+	return dbus_message_new_method_return(msg);
 }
 
 static const GDBusMethodTable set_methods[] = {
@@ -226,20 +304,6 @@ static struct btd_device_set *set_find(struct btd_device *device,
 	return NULL;
 }
 
-static void set_connect_next(struct btd_device_set *set)
-{
-	const struct queue_entry *entry;
-
-	for (entry = queue_get_entries(set->devices); entry;
-					entry = entry->next) {
-		struct btd_device *device = entry->data;
-
-		/* Only connect one at time(?) */
-		if (!device_connect_le(device))
-			return;
-	}
-}
-
 static void set_add(struct btd_device_set *set, struct btd_device *device)
 {
 	/* Check if device is already part of the set then skip to connect */
@@ -255,7 +319,7 @@ static void set_add(struct btd_device_set *set, struct btd_device *device)
 done:
 	/* Check if set is marked to auto-connect */
 	if (btd_device_is_connected(device) && set->auto_connect)
-		set_connect_next(set);
+		set_connect_all(set);
 }
 
 static void foreach_rsi(void *data, void *user_data)
@@ -282,19 +346,7 @@ static void foreach_rsi(void *data, void *user_data)
 	if (memcmp(ad->data, res, sizeof(res)))
 		return;
 
-	/* Attempt to use existing gatt_db from set if device has never been
-	 * connected before.
-	 *
-	 * If dbs don't really match bt_gatt_client will attempt to rediscover
-	 * the ranges that don't match.
-	 */
-	if (gatt_db_isempty(btd_device_get_gatt_db(set->device))) {
-		struct btd_device *device;
-
-		device = queue_get_entries(set->devices)->data;
-		btd_device_set_gatt_db(set->device,
-					btd_device_get_gatt_db(device));
-	}
+	set_share_gatt_db(set, set->device);
 
 	device_connect_le(set->device);
 }
@@ -13,16 +13,24 @@
 
 #include <stdbool.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 
 #include "lib/bluetooth.h"
 #include "lib/uuid.h"
+#include "lib/sdp.h"
 
 #include "log.h"
+#include "src/shared/util.h"
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
+#include "storage.h"
 #include "settings.h"
 
 #define GATT_PRIM_SVC_UUID_STR "2800"
@@ -314,7 +322,7 @@ int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename)
 	int err;
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		DBG("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -500,7 +508,7 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	struct gatt_saver saver;
 
 	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	if (!btd_storage_load(key_file, filename, &gerr)) {
 		DBG("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -515,7 +523,7 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	gatt_db_foreach_service(db, NULL, store_service, &saver);
 
 	data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, data, length, &gerr)) {
+	if (!btd_storage_save(filename, data, length, &gerr)) {
 		DBG("Unable set contents for %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -524,3 +532,463 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	g_free(data);
 	g_key_file_free(key_file);
 }
+
+/*
+ * Binary cache format: a header followed by fixed size records, services
+ * first, each followed by its included services, characteristics and
+ * descriptors. All values are little endian.
+ */
+#define GATT_CACHE_MAGIC	0x43475a42	/* "BZGC" */
+#define GATT_CACHE_VERSION	1
+
+#define GATT_CACHE_HASH		0x01
+
+enum {
+	GATT_CACHE_PRIM_SVC = 1,
+	GATT_CACHE_SND_SVC,
+	GATT_CACHE_INCL,
+	GATT_CACHE_CHRC,
+	GATT_CACHE_DESC,
+};
+
+struct gatt_cache_hdr {
+	uint32_t magic;
+	uint8_t  version;
+	uint8_t  flags;
+	uint16_t reserved;
+	uint32_t count;
+	uint8_t  hash[16];
+} __packed;
+
+struct gatt_cache_rec {
+	uint8_t  type;
+	uint8_t  properties;
+	uint8_t  uuid_len;
+	uint8_t  reserved;
+	uint16_t handle;
+	uint16_t value;		/* End, value handle or extended properties */
+	uint16_t end;		/* Included service end handle */
+	uint16_t reserved2;
+	uint8_t  uuid[16];
+} __packed;
+
+struct gatt_cache_saver {
+	struct gatt_db *db;
+	struct gatt_cache_hdr hdr;
+	struct gatt_cache_rec *recs;
+	unsigned int count;
+	unsigned int size;
+	uint16_t ext_props;
+};
+
+static void cache_put_uuid(struct gatt_cache_rec *rec, const bt_uuid_t *uuid)
+{
+	switch (uuid->type) {
+	case BT_UUID16:
+		rec->uuid_len = 2;
+		put_le16(uuid->value.u16, rec->uuid);
+		break;
+	case BT_UUID32:
+		rec->uuid_len = 4;
+		put_le32(uuid->value.u32, rec->uuid);
+		break;
+	case BT_UUID128:
+		rec->uuid_len = 16;
+		memcpy(rec->uuid, &uuid->value.u128, 16);
+		break;
+	default:
+		rec->uuid_len = 0;
+		break;
+	}
+}
+
+static int cache_get_uuid(const struct gatt_cache_rec *rec, bt_uuid_t *uuid)
+{
+	uint128_t u128;
+
+	switch (rec->uuid_len) {
+	case 2:
+		return bt_uuid16_create(uuid, get_le16(rec->uuid));
+	case 4:
+		return bt_uuid32_create(uuid, get_le32(rec->uuid));
+	case 16:
+		memcpy(&u128, rec->uuid, 16);
+		return bt_uuid128_create(uuid, u128);
+	default:
+		return -EINVAL;
+	}
+}
+
+static struct gatt_cache_rec *cache_new_rec(struct gatt_cache_saver *saver,
+						uint8_t type, uint16_t handle)
+{
+	struct gatt_cache_rec *rec;
+
+	if (saver->count == saver->size) {
+		saver->size = MAX(saver->size * 2, 32u);
+		saver->recs = g_renew(struct gatt_cache_rec, saver->recs,
+								saver->size);
+	}
+
+	rec = &saver->recs[saver->count++];
+	memset(rec, 0, sizeof(*rec));
+	rec->type = type;
+	put_le16(handle, &rec->handle);
+
+	return rec;
+}
+
+static void report_ref_read_value_cb(struct gatt_db_attribute *attrib,
+						int err, const uint8_t *value,
+						size_t length, void *user_data)
+{
+	const uint8_t **ref = user_data;
+
+	if (err || (length != 2))
+		return;
+
+	*ref = value;
+}
+
+static void cache_store_desc(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	struct gatt_cache_rec *rec;
+	const bt_uuid_t *uuid;
+	bt_uuid_t ext_uuid, ref_uuid;
+
+	uuid = gatt_db_attribute_get_type(attr);
+
+	rec = cache_new_rec(saver, GATT_CACHE_DESC,
+					gatt_db_attribute_get_handle(attr));
+	cache_put_uuid(rec, uuid);
+
+	bt_uuid16_create(&ext_uuid, GATT_CHARAC_EXT_PROPER_UUID);
+	if (!bt_uuid_cmp(uuid, &ext_uuid)) {
+		put_le16(saver->ext_props, &rec->value);
+		return;
+	}
+
+	/* Keep HID Report References so HoG can skip reading them */
+	bt_uuid16_create(&ref_uuid, GATT_REPORT_REFERENCE);
+	if (!bt_uuid_cmp(uuid, &ref_uuid)) {
+		const uint8_t *ref = NULL;
+
+		gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
+					report_ref_read_value_cb, &ref);
+		if (ref)
+			memcpy(&rec->value, ref, 2);
+	}
+}
+
+static void cache_store_chrc(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	struct gatt_cache_rec *rec;
+	uint16_t handle, value_handle;
+	uint8_t properties;
+	bt_uuid_t uuid, hash_uuid;
+
+	if (!gatt_db_attribute_get_char_data(attr, &handle, &value_handle,
+						&properties, &saver->ext_props,
+						&uuid)) {
+		DBG("Unable to locate Characteristic data");
+		return;
+	}
+
+	rec = cache_new_rec(saver, GATT_CACHE_CHRC, handle);
+	rec->properties = properties;
+	put_le16(value_handle, &rec->value);
+	cache_put_uuid(rec, &uuid);
+
+	/* Keep the Database Hash value in the header */
+	bt_uuid16_create(&hash_uuid, GATT_CHARAC_DB_HASH);
+	if (!bt_uuid_cmp(&uuid, &hash_uuid)) {
+		const uint8_t *hash = NULL;
+
+		attr = gatt_db_get_attribute(saver->db, value_handle);
+
+		gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
+					db_hash_read_value_cb, &hash);
+		if (hash) {
+			memcpy(saver->hdr.hash, hash, 16);
+			saver->hdr.flags |= GATT_CACHE_HASH;
+		}
+	}
+
+	gatt_db_service_foreach_desc(attr, cache_store_desc, saver);
+}
+
+static void cache_store_incl(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	struct gatt_cache_rec *rec;
+	uint16_t handle, start, end;
+
+	if (!gatt_db_attribute_get_incl_data(attr, &handle, &start, &end)) {
+		DBG("Unable to locate Included data");
+		return;
+	}
+
+	rec = cache_new_rec(saver, GATT_CACHE_INCL, handle);
+	put_le16(start, &rec->value);
+	put_le16(end, &rec->end);
+}
+
+static void cache_store_service(struct gatt_db_attribute *attr,
+							void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	struct gatt_cache_rec *rec;
+	uint16_t start, end;
+	bt_uuid_t uuid;
+	bool primary;
+
+	if (!gatt_db_attribute_get_service_data(attr, &start, &end, &primary,
+								&uuid)) {
+		DBG("Unable to locate Service data");
+		return;
+	}
+
+	rec = cache_new_rec(saver, primary ? GATT_CACHE_PRIM_SVC :
+						GATT_CACHE_SND_SVC, start);
+	put_le16(end, &rec->value);
+	cache_put_uuid(rec, &uuid);
+
+	gatt_db_service_foreach_incl(attr, cache_store_incl, saver);
+	gatt_db_service_foreach_char(attr, cache_store_chrc, saver);
+}
+
+int btd_settings_gatt_db_store_cache(struct gatt_db *db, const char *filename)
+{
+	struct gatt_cache_saver saver;
+	GError *gerr = NULL;
+	uint8_t *data;
+	size_t len;
+	int err = 0;
+
+	memset(&saver, 0, sizeof(saver));
+	saver.db = db;
+
+	gatt_db_foreach_service(db, NULL, cache_store_service, &saver);
+
+	put_le32(GATT_CACHE_MAGIC, &saver.hdr.magic);
+	saver.hdr.version = GATT_CACHE_VERSION;
+	put_le32(saver.count, &saver.hdr.count);
+
+	len = sizeof(saver.hdr) + saver.count * sizeof(*saver.recs);
+	data = g_malloc(len);
+	memcpy(data, &saver.hdr, sizeof(saver.hdr));
+	if (saver.count)
+		memcpy(data + sizeof(saver.hdr), saver.recs,
+					saver.count * sizeof(*saver.recs));
+
+	if (!btd_storage_save(filename, (char *) data, len, &gerr)) {
+		DBG("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+		err = -EIO;
+	}
+
+	g_free(data);
+	g_free(saver.recs);
+
+	return err;
+}
+
+static int cache_load_service(struct gatt_db *db,
+					const struct gatt_cache_rec *rec)
+{
+	uint16_t start = get_le16(&rec->handle);
+	uint16_t end = get_le16(&rec->value);
+	bt_uuid_t uuid;
+
+	if (end < start || cache_get_uuid(rec, &uuid) < 0)
+		return -EIO;
+
+	if (!gatt_db_insert_service(db, start, &uuid,
+					rec->type == GATT_CACHE_PRIM_SVC,
+					end - start + 1)) {
+		DBG("Unable load service into db!");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int cache_load_rec(struct gatt_db *db,
+					const struct gatt_cache_hdr *hdr,
+					const struct gatt_cache_rec *rec,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+	uint16_t handle = get_le16(&rec->handle);
+	uint16_t value = get_le16(&rec->value);
+	bt_uuid_t uuid, uuid_cmp;
+
+	if (!service)
+		return -EIO;
+
+	switch (rec->type) {
+	case GATT_CACHE_INCL:
+		att = gatt_db_get_attribute(db, value);
+		if (!att)
+			return -EIO;
+
+		att = gatt_db_service_insert_included(service, handle, att);
+		if (!att || gatt_db_attribute_get_handle(att) != handle)
+			return -EIO;
+
+		return 0;
+	case GATT_CACHE_CHRC:
+		if (cache_get_uuid(rec, &uuid) < 0)
+			return -EIO;
+
+		att = gatt_db_service_insert_characteristic(service, handle,
+							value, &uuid, 0,
+							rec->properties,
+							NULL, NULL, NULL);
+		if (!att || gatt_db_attribute_get_handle(att) != value)
+			return -EIO;
+
+		bt_uuid16_create(&uuid_cmp, GATT_CHARAC_DB_HASH);
+		if (!bt_uuid_cmp(&uuid, &uuid_cmp) &&
+					(hdr->flags & GATT_CACHE_HASH)) {
+			if (!gatt_db_attribute_write(att, 0, hdr->hash, 16, 0,
+						NULL, load_desc_value, NULL))
+				return -EIO;
+		}
+
+		return 0;
+	case GATT_CACHE_DESC:
+		if (cache_get_uuid(rec, &uuid) < 0)
+			return -EIO;
+
+		bt_uuid16_create(&uuid_cmp, GATT_CHARAC_EXT_PROPER_UUID);
+
+		/* If it is CEP then it must contain the value */
+		if (!bt_uuid_cmp(&uuid, &uuid_cmp) && !value)
+			return -EIO;
+
+		att = gatt_db_service_insert_descriptor(service, handle, &uuid,
+							0, NULL, NULL, NULL);
+		if (!att || gatt_db_attribute_get_handle(att) != handle)
+			return -EIO;
+
+		if (value) {
+			if (!gatt_db_attribute_write(att, 0,
+						(uint8_t *) &rec->value,
+						sizeof(rec->value), 0, NULL,
+						load_desc_value, NULL))
+				return -EIO;
+		}
+
+		return 0;
+	default:
+		return -EIO;
+	}
+}
+
+static int cache_load(struct gatt_db *db, const struct gatt_cache_hdr *hdr,
+					const struct gatt_cache_rec *recs,
+					uint32_t count)
+{
+	struct gatt_db_attribute *service = NULL;
+	uint32_t i;
+	int err;
+
+	/* First load service definitions so includes can be resolved */
+	for (i = 0; i < count; i++) {
+		if (recs[i].type != GATT_CACHE_PRIM_SVC &&
+					recs[i].type != GATT_CACHE_SND_SVC)
+			continue;
+
+		err = cache_load_service(db, &recs[i]);
+		if (err) {
+			gatt_db_clear(db);
+			return err;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		const struct gatt_cache_rec *rec = &recs[i];
+
+		if (rec->type == GATT_CACHE_PRIM_SVC ||
+					rec->type == GATT_CACHE_SND_SVC) {
+			if (service)
+				gatt_db_service_set_active(service, true);
+
+			service = gatt_db_get_attribute(db,
+						get_le16(&rec->handle));
+			continue;
+		}
+
+		err = cache_load_rec(db, hdr, rec, service);
+		if (err) {
+			gatt_db_clear(db);
+			return err;
+		}
+	}
+
+	if (service)
+		gatt_db_service_set_active(service, true);
+
+	return 0;
+}
+
+static const struct gatt_cache_hdr *cache_map(const char *filename,
+							size_t *len)
+{
+	const struct gatt_cache_hdr *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EIO;
+		return NULL;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return NULL;
+
+	hdr = map;
+	*len = st.st_size;
+
+	if (get_le32(&hdr->magic) != GATT_CACHE_MAGIC ||
+				hdr->version != GATT_CACHE_VERSION ||
+				*len != sizeof(*hdr) + get_le32(&hdr->count) *
+					sizeof(struct gatt_cache_rec)) {
+		munmap(map, *len);
+		errno = EIO;
+		return NULL;
+	}
+
+	return hdr;
+}
+
+int btd_settings_gatt_db_load_cache(struct gatt_db *db, const char *filename)
+{
+	const struct gatt_cache_hdr *hdr;
+	size_t len;
+	int err;
+
+	hdr = cache_map(filename, &len);
+	if (!hdr)
+		return -errno;
+
+	err = cache_load(db, hdr, (const void *) (hdr + 1),
+						get_le32(&hdr->count));
+
+	munmap((void *) hdr, len);
+
+	return err;
+}
@@ -9,3 +9,6 @@
 
 int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename);
 void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename);
+
+int btd_settings_gatt_db_load_cache(struct gatt_db *db, const char *filename);
+int btd_settings_gatt_db_store_cache(struct gatt_db *db, const char *filename);
@@ -1482,3 +1482,361 @@ struct bt_ad_pattern *bt_ad_pattern_match(struct bt_ad *ad,
 
 	return info.matched_pattern;
 }
+
+struct ad_matcher_owner {
+	void *match_data;
+	unsigned int gen;
+};
+
+struct ad_matcher_entry {
+	struct ad_matcher_owner *owner;
+	struct bt_ad_pattern pattern;
+};
+
+/* Patterns are indexed by AD type so that each AD structure of a report is
+ * only compared against the patterns that can possibly match it, and every
+ * owner (a set of OR'ed patterns) is reported at most once per report.
+ */
+struct bt_ad_matcher {
+	struct queue *types[256];	/* List of ad_matcher_entry per type */
+	struct queue *owners;		/* List of ad_matcher_owner */
+	unsigned int gen;
+};
+
+struct matcher_add_info {
+	struct bt_ad_matcher *matcher;
+	struct ad_matcher_owner *owner;
+};
+
+struct bt_ad_matcher *bt_ad_matcher_new(void)
+{
+	struct bt_ad_matcher *matcher;
+
+	matcher = new0(struct bt_ad_matcher, 1);
+	matcher->owners = queue_new();
+
+	return matcher;
+}
+
+void bt_ad_matcher_free(struct bt_ad_matcher *matcher)
+{
+	unsigned int i;
+
+	if (!matcher)
+		return;
+
+	for (i = 0; i < 256; i++)
+		queue_destroy(matcher->types[i], free);
+
+	queue_destroy(matcher->owners, free);
+	free(matcher);
+}
+
+static void matcher_add_pattern(void *data, void *user_data)
+{
+	struct bt_ad_pattern *pattern = data;
+	struct matcher_add_info *info = user_data;
+	struct bt_ad_matcher *matcher = info->matcher;
+	struct ad_matcher_entry *entry;
+
+	if (!matcher->types[pattern->type])
+		matcher->types[pattern->type] = queue_new();
+
+	entry = new0(struct ad_matcher_entry, 1);
+	entry->owner = info->owner;
+	entry->pattern = *pattern;
+
+	queue_push_tail(matcher->types[pattern->type], entry);
+}
+
+bool bt_ad_matcher_add(struct bt_ad_matcher *matcher, struct queue *patterns,
+							void *match_data)
+{
+	struct matcher_add_info info;
+
+	if (!matcher || queue_isempty(patterns))
+		return false;
+
+	info.matcher = matcher;
+	info.owner = new0(struct ad_matcher_owner, 1);
+	info.owner->match_data = match_data;
+
+	queue_foreach(patterns, matcher_add_pattern, &info);
+	queue_push_tail(matcher->owners, info.owner);
+
+	return true;
+}
+
+static bool match_owner_data(const void *data, const void *match_data)
+{
+	const struct ad_matcher_owner *owner = data;
+
+	return owner->match_data == match_data;
+}
+
+static bool match_entry_owner(const void *data, const void *match_data)
+{
+	const struct ad_matcher_entry *entry = data;
+
+	return entry->owner == match_data;
+}
+
+void bt_ad_matcher_remove(struct bt_ad_matcher *matcher, void *match_data)
+{
+	struct ad_matcher_owner *owner;
+	unsigned int i;
+
+	if (!matcher)
+		return;
+
+	owner = queue_remove_if(matcher->owners, match_owner_data, match_data);
+	if (!owner)
+		return;
+
+	for (i = 0; i < 256; i++) {
+		if (!matcher->types[i])
+			continue;
+
+		queue_remove_all(matcher->types[i], match_entry_owner, owner,
+									free);
+		if (queue_isempty(matcher->types[i])) {
+			queue_destroy(matcher->types[i], NULL);
+			matcher->types[i] = NULL;
+		}
+	}
+
+	free(owner);
+}
+
+static void owner_reset_gen(void *data, void *user_data)
+{
+	struct ad_matcher_owner *owner = data;
+
+	owner->gen = 0;
+}
+
+/* Matches the patterns against the raw AD structures of a report, calling
+ * func once for every owner with at least one matching pattern. Offsets are
+ * relative to the start of the AD data, as done by controllers offloading
+ * the same patterns.
+ */
+void bt_ad_matcher_match(struct bt_ad_matcher *matcher, const uint8_t *data,
+					size_t len, bt_ad_matcher_func_t func,
+					void *user_data)
+{
+	struct bt_ad_data ad;
+	size_t offset = 0;
+
+	if (!matcher || !data || !func)
+		return;
+
+	if (!++matcher->gen) {
+		queue_foreach(matcher->owners, owner_reset_gen, NULL);
+		matcher->gen = 1;
+	}
+
+	while (bt_ad_view_next(data, len, &offset, &ad)) {
+		const struct queue_entry *e;
+
+		for (e = queue_get_entries(matcher->types[ad.type]); e;
+								e = e->next) {
+			struct ad_matcher_entry *entry = e->data;
+			struct bt_ad_pattern *pattern = &entry->pattern;
+
+			if (entry->owner->gen == matcher->gen)
+				continue;
+
+			if (ad.len < (size_t) pattern->offset + pattern->len)
+				continue;
+
+			if (ad.data[pattern->offset] != pattern->data[0] ||
+					memcmp(ad.data + pattern->offset,
+						pattern->data, pattern->len))
+				continue;
+
+			entry->owner->gen = matcher->gen;
+			func(entry->owner->match_data, user_data);
+		}
+	}
+}
+
+/* The view helpers below walk the raw AD structures without allocating,
+ * the returned data pointers point into the buffer being viewed.
+ */
+bool bt_ad_view_next(const uint8_t *data, size_t len, size_t *offset,
+						struct bt_ad_data *ad)
+{
+	uint8_t elen;
+
+	if (!data || !offset || *offset + 1 >= len)
+		return false;
+
+	elen = data[*offset];
+	if (!elen || *offset + elen + 1 > len)
+		return false;
+
+	ad->type = data[*offset + 1];
+	ad->data = (uint8_t *) &data[*offset + 2];
+	ad->len = elen - 1;
+
+	*offset += elen + 1;
+
+	return true;
+}
+
+bool bt_ad_view_find(const uint8_t *data, size_t len, uint8_t type,
+						struct bt_ad_data *ad)
+{
+	size_t offset = 0;
+
+	while (bt_ad_view_next(data, len, &offset, ad)) {
+		if (ad->type == type)
+			return true;
+	}
+
+	return false;
+}
+
+static void view_uuid(const uint8_t *data, size_t size, bt_uuid_t *uuid)
+{
+	uint128_t value;
+
+	switch (size) {
+	case 2:
+		bt_uuid16_create(uuid, get_le16(data));
+		break;
+	case 4:
+		bt_uuid32_create(uuid, get_le32(data));
+		break;
+	default:
+		bswap_128(data, &value);
+		bt_uuid128_create(uuid, value);
+		break;
+	}
+}
+
+bool bt_ad_view_foreach_uuid(const uint8_t *data, size_t len,
+				bt_ad_view_uuid_func_t func, void *user_data)
+{
+	struct bt_ad_data ad;
+	size_t offset = 0;
+
+	if (!func)
+		return false;
+
+	while (bt_ad_view_next(data, len, &offset, &ad)) {
+		size_t size, i;
+
+		switch (ad.type) {
+		case BT_AD_UUID16_SOME:
+		case BT_AD_UUID16_ALL:
+			size = 2;
+			break;
+		case BT_AD_UUID32_SOME:
+		case BT_AD_UUID32_ALL:
+			size = 4;
+			break;
+		case BT_AD_UUID128_SOME:
+		case BT_AD_UUID128_ALL:
+			size = 16;
+			break;
+		default:
+			continue;
+		}
+
+		for (i = 0; i + size <= ad.len; i += size) {
+			bt_uuid_t uuid;
+
+			view_uuid(ad.data + i, size, &uuid);
+
+			if (func(&uuid, user_data))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static bool view_uuid_match(const bt_uuid_t *uuid, void *user_data)
+{
+	return !bt_uuid_cmp(uuid, user_data);
+}
+
+bool bt_ad_view_has_service_uuid(const uint8_t *data, size_t len,
+						const bt_uuid_t *uuid)
+{
+	if (!uuid)
+		return false;
+
+	return bt_ad_view_foreach_uuid(data, len, view_uuid_match,
+							(void *) uuid);
+}
+
+bool bt_ad_view_get_manufacturer_data(const uint8_t *data, size_t len,
+			uint16_t id, struct bt_ad_manufacturer_data *manuf)
+{
+	struct bt_ad_data ad;
+	size_t offset = 0;
+
+	if (!manuf)
+		return false;
+
+	while (bt_ad_view_next(data, len, &offset, &ad)) {
+		if (ad.type != BT_AD_MANUFACTURER_DATA || ad.len < 2)
+			continue;
+
+		if (get_le16(ad.data) != id)
+			continue;
+
+		manuf->manufacturer_id = id;
+		manuf->data = ad.data + 2;
+		manuf->len = ad.len - 2;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool bt_ad_view_get_service_data(const uint8_t *data, size_t len,
+					const bt_uuid_t *uuid,
+					struct bt_ad_service_data *sd)
+{
+	struct bt_ad_data ad;
+	size_t offset = 0;
+
+	if (!uuid || !sd)
+		return false;
+
+	while (bt_ad_view_next(data, len, &offset, &ad)) {
+		size_t size;
+
+		switch (ad.type) {
+		case BT_AD_SERVICE_DATA16:
+			size = 2;
+			break;
+		case BT_AD_SERVICE_DATA32:
+			size = 4;
+			break;
+		case BT_AD_SERVICE_DATA128:
+			size = 16;
+			break;
+		default:
+			continue;
+		}
+
+		if (ad.len < size)
+			continue;
+
+		view_uuid(ad.data, size, &sd->uuid);
+		if (bt_uuid_cmp(&sd->uuid, uuid))
+			continue;
+
+		sd->data = ad.data + size;
+		sd->len = ad.len - size;
+
+		return true;
+	}
+
+	return false;
+}
@@ -189,3 +189,42 @@ struct bt_ad_pattern *bt_ad_pattern_new(uint8_t type, size_t offset,
 
 struct bt_ad_pattern *bt_ad_pattern_match(struct bt_ad *ad,
 							struct queue *patterns);
+
+struct bt_ad_matcher;
+
+typedef void (*bt_ad_matcher_func_t)(void *match_data, void *user_data);
+
+struct bt_ad_matcher *bt_ad_matcher_new(void);
+
+void bt_ad_matcher_free(struct bt_ad_matcher *matcher);
+
+bool bt_ad_matcher_add(struct bt_ad_matcher *matcher, struct queue *patterns,
+							void *match_data);
+
+void bt_ad_matcher_remove(struct bt_ad_matcher *matcher, void *match_data);
+
+void bt_ad_matcher_match(struct bt_ad_matcher *matcher, const uint8_t *data,
+					size_t len, bt_ad_matcher_func_t func,
+					void *user_data);
+
+typedef bool (*bt_ad_view_uuid_func_t)(const bt_uuid_t *uuid,
+							void *user_data);
+
+bool bt_ad_view_next(const uint8_t *data, size_t len, size_t *offset,
+						struct bt_ad_data *ad);
+
+bool bt_ad_view_find(const uint8_t *data, size_t len, uint8_t type,
+						struct bt_ad_data *ad);
+
+bool bt_ad_view_foreach_uuid(const uint8_t *data, size_t len,
+				bt_ad_view_uuid_func_t func, void *user_data);
+
+bool bt_ad_view_has_service_uuid(const uint8_t *data, size_t len,
+						const bt_uuid_t *uuid);
+
+bool bt_ad_view_get_manufacturer_data(const uint8_t *data, size_t len,
+			uint16_t id, struct bt_ad_manufacturer_data *manuf);
+
+bool bt_ad_view_get_service_data(const uint8_t *data, size_t len,
+					const bt_uuid_t *uuid,
+					struct bt_ad_service_data *sd);
@@ -0,0 +1,423 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AES_X86
+#include <cpuid.h>
+#include <wmmintrin.h>
+#elif defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+#define AES_ARM
+#include <arm_neon.h>
+#endif
+
+#include "src/shared/aes.h"
+
+/*
+ * AES-128 block encryption and AES-CMAC (RFC 4493), run in process so that
+ * callers do not need a round trip through AF_ALG for each block. Only the
+ * forward cipher is implemented since neither CMAC nor CCM need the
+ * inverse one.
+ */
+
+static const uint8_t sbox[256] = {
+	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
+	0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+	0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+	0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc,
+	0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+	0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a,
+	0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+	0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+	0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+	0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b,
+	0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+	0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85,
+	0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+	0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+	0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+	0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17,
+	0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+	0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88,
+	0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+	0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+	0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+	0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9,
+	0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+	0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6,
+	0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+	0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94,
+	0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68,
+	0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static const uint8_t rcon[10] = {
+	0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
+};
+
+static inline uint8_t xtime(uint8_t x)
+{
+	return (x << 1) ^ ((x & 0x80) ? 0x1b : 0x00);
+}
+
+void bt_aes_set_key(struct bt_aes *aes, const uint8_t key[16])
+{
+	uint8_t *rk = aes->rk;
+	unsigned int i;
+
+	memcpy(rk, key, 16);
+
+	for (i = 16; i < sizeof(aes->rk); i += 4) {
+		uint8_t t[4];
+
+		memcpy(t, rk + i - 4, 4);
+
+		if (!(i % 16)) {
+			uint8_t t0 = t[0];
+
+			t[0] = sbox[t[1]] ^ rcon[i / 16 - 1];
+			t[1] = sbox[t[2]];
+			t[2] = sbox[t[3]];
+			t[3] = sbox[t0];
+		}
+
+		rk[i] = rk[i - 16] ^ t[0];
+		rk[i + 1] = rk[i - 15] ^ t[1];
+		rk[i + 2] = rk[i - 14] ^ t[2];
+		rk[i + 3] = rk[i - 13] ^ t[3];
+	}
+}
+
+static void encrypt_soft(const uint8_t *rk, const uint8_t in[16],
+							uint8_t out[16])
+{
+	uint8_t s[16], t[16];
+	unsigned int r, c;
+
+	for (c = 0; c < 16; c++)
+		s[c] = in[c] ^ rk[c];
+
+	for (r = 1; r < BT_AES_ROUND_KEYS; r++) {
+		/* SubBytes and ShiftRows */
+		for (c = 0; c < 16; c++)
+			t[c] = sbox[s[(c + (c % 4) * 4) % 16]];
+
+		rk += 16;
+
+		if (r == BT_AES_ROUND_KEYS - 1) {
+			for (c = 0; c < 16; c++)
+				out[c] = t[c] ^ rk[c];
+			return;
+		}
+
+		/* MixColumns and AddRoundKey */
+		for (c = 0; c < 16; c += 4) {
+			uint8_t a0 = t[c], a1 = t[c + 1];
+			uint8_t a2 = t[c + 2], a3 = t[c + 3];
+			uint8_t x = a0 ^ a1 ^ a2 ^ a3;
+
+			s[c] = a0 ^ x ^ xtime(a0 ^ a1) ^ rk[c];
+			s[c + 1] = a1 ^ x ^ xtime(a1 ^ a2) ^ rk[c + 1];
+			s[c + 2] = a2 ^ x ^ xtime(a2 ^ a3) ^ rk[c + 2];
+			s[c + 3] = a3 ^ x ^ xtime(a3 ^ a0) ^ rk[c + 3];
+		}
+	}
+}
+
+static void encrypt_blocks_soft(const uint8_t *rk, const uint8_t *in,
+						uint8_t *out, size_t blocks)
+{
+	for (; blocks; blocks--, in += 16, out += 16)
+		encrypt_soft(rk, in, out);
+}
+
+static void encrypt_keys_soft(const struct bt_aes *aes, size_t count,
+					const uint8_t in[16], uint8_t *out)
+{
+	for (; count; count--, aes++, out += 16)
+		encrypt_soft(aes->rk, in, out);
+}
+
+#if defined(AES_X86)
+__attribute__((target("aes,sse2")))
+static void encrypt_blocks_hw(const uint8_t *rk, const uint8_t *in,
+						uint8_t *out, size_t blocks)
+{
+	__m128i k[BT_AES_ROUND_KEYS];
+	unsigned int r;
+
+	for (r = 0; r < BT_AES_ROUND_KEYS; r++)
+		k[r] = _mm_loadu_si128((const __m128i *) (rk + r * 16));
+
+	/* Four independent blocks keep the AESENC pipeline busy */
+	for (; blocks >= 4; blocks -= 4, in += 64, out += 64) {
+		__m128i s0, s1, s2, s3;
+
+		s0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in), k[0]);
+		s1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 16)),
+									k[0]);
+		s2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 32)),
+									k[0]);
+		s3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 48)),
+									k[0]);
+
+		for (r = 1; r < BT_AES_ROUND_KEYS - 1; r++) {
+			s0 = _mm_aesenc_si128(s0, k[r]);
+			s1 = _mm_aesenc_si128(s1, k[r]);
+			s2 = _mm_aesenc_si128(s2, k[r]);
+			s3 = _mm_aesenc_si128(s3, k[r]);
+		}
+
+		_mm_storeu_si128((__m128i *) out,
+					_mm_aesenclast_si128(s0, k[r]));
+		_mm_storeu_si128((__m128i *) (out + 16),
+					_mm_aesenclast_si128(s1, k[r]));
+		_mm_storeu_si128((__m128i *) (out + 32),
+					_mm_aesenclast_si128(s2, k[r]));
+		_mm_storeu_si128((__m128i *) (out + 48),
+					_mm_aesenclast_si128(s3, k[r]));
+	}
+
+	for (; blocks; blocks--, in += 16, out += 16) {
+		__m128i s;
+
+		s = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in), k[0]);
+
+		for (r = 1; r < BT_AES_ROUND_KEYS - 1; r++)
+			s = _mm_aesenc_si128(s, k[r]);
+
+		_mm_storeu_si128((__m128i *) out,
+					_mm_aesenclast_si128(s, k[r]));
+	}
+}
+
+/* One block under four independent key schedules, e.g. a list of IRKs */
+#define RK(k, r) _mm_loadu_si128((const __m128i *) ((k) + (r) * 16))
+
+__attribute__((target("aes,sse2")))
+static void encrypt_keys_hw(const struct bt_aes *aes, size_t count,
+					const uint8_t in[16], uint8_t *out)
+{
+	__m128i m = _mm_loadu_si128((const __m128i *) in);
+	unsigned int r;
+
+	for (; count >= 4; count -= 4, aes += 4, out += 64) {
+		const uint8_t *k0 = aes[0].rk, *k1 = aes[1].rk;
+		const uint8_t *k2 = aes[2].rk, *k3 = aes[3].rk;
+		__m128i s0, s1, s2, s3;
+
+		s0 = _mm_xor_si128(m, RK(k0, 0));
+		s1 = _mm_xor_si128(m, RK(k1, 0));
+		s2 = _mm_xor_si128(m, RK(k2, 0));
+		s3 = _mm_xor_si128(m, RK(k3, 0));
+
+		for (r = 1; r < BT_AES_ROUND_KEYS - 1; r++) {
+			s0 = _mm_aesenc_si128(s0, RK(k0, r));
+			s1 = _mm_aesenc_si128(s1, RK(k1, r));
+			s2 = _mm_aesenc_si128(s2, RK(k2, r));
+			s3 = _mm_aesenc_si128(s3, RK(k3, r));
+		}
+
+		_mm_storeu_si128((__m128i *) out,
+					_mm_aesenclast_si128(s0, RK(k0, r)));
+		_mm_storeu_si128((__m128i *) (out + 16),
+					_mm_aesenclast_si128(s1, RK(k1, r)));
+		_mm_storeu_si128((__m128i *) (out + 32),
+					_mm_aesenclast_si128(s2, RK(k2, r)));
+		_mm_storeu_si128((__m128i *) (out + 48),
+					_mm_aesenclast_si128(s3, RK(k3, r)));
+	}
+
+	for (; count; count--, aes++, out += 16)
+		encrypt_blocks_hw(aes->rk, in, out, 1);
+}
+
+#undef RK
+
+static bool have_hw(void)
+{
+	static int hw = -1;
+	unsigned int eax, ebx, ecx, edx;
+
+	if (hw < 0)
+		hw = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+							(ecx & bit_AES);
+
+	return hw;
+}
+#elif defined(AES_ARM)
+static void encrypt_blocks_hw(const uint8_t *rk, const uint8_t *in,
+						uint8_t *out, size_t blocks)
+{
+	uint8x16_t k[BT_AES_ROUND_KEYS];
+	unsigned int r;
+
+	for (r = 0; r < BT_AES_ROUND_KEYS; r++)
+		k[r] = vld1q_u8(rk + r * 16);
+
+	for (; blocks; blocks--, in += 16, out += 16) {
+		uint8x16_t s = vld1q_u8(in);
+
+		for (r = 0; r < BT_AES_ROUND_KEYS - 2; r++)
+			s = vaesmcq_u8(vaeseq_u8(s, k[r]));
+
+		s = vaeseq_u8(s, k[r]);
+		vst1q_u8(out, veorq_u8(s, k[r + 1]));
+	}
+}
+
+static bool have_hw(void)
+{
+	return true;
+}
+
+static void encrypt_keys_hw(const struct bt_aes *aes, size_t count,
+					const uint8_t in[16], uint8_t *out)
+{
+	for (; count; count--, aes++, out += 16)
+		encrypt_blocks_hw(aes->rk, in, out, 1);
+}
+#else
+#define encrypt_blocks_hw encrypt_blocks_soft
+#define encrypt_keys_hw encrypt_keys_soft
+
+static bool have_hw(void)
+{
+	return false;
+}
+#endif
+
+void bt_aes_encrypt_blocks(const struct bt_aes *aes, const uint8_t *in,
+						uint8_t *out, size_t blocks)
+{
+	if (have_hw())
+		encrypt_blocks_hw(aes->rk, in, out, blocks);
+	else
+		encrypt_blocks_soft(aes->rk, in, out, blocks);
+}
+
+void bt_aes_encrypt_keys(const struct bt_aes *aes, size_t count,
+					const uint8_t in[16], uint8_t *out)
+{
+	if (have_hw())
+		encrypt_keys_hw(aes, count, in, out);
+	else
+		encrypt_keys_soft(aes, count, in, out);
+}
+
+void bt_aes_encrypt(const struct bt_aes *aes, const uint8_t in[16],
+							uint8_t out[16])
+{
+	bt_aes_encrypt_blocks(aes, in, out, 1);
+}
+
+bool bt_aes_hw(void)
+{
+	return have_hw();
+}
+
+const char *bt_aes_impl(void)
+{
+	if (!have_hw())
+		return "software";
+
+#if defined(AES_X86)
+	return "AES-NI";
+#else
+	return "ARMv8 Crypto Extensions";
+#endif
+}
+
+static void cmac_subkey(const uint8_t in[16], uint8_t out[16])
+{
+	unsigned int i;
+
+	for (i = 0; i < 15; i++)
+		out[i] = in[i] << 1 | in[i + 1] >> 7;
+
+	out[15] = in[15] << 1;
+
+	if (in[0] & 0x80)
+		out[15] ^= 0x87;
+}
+
+bool bt_aes_cmac_iov(const uint8_t key[16], const struct iovec *iov,
+				size_t iov_cnt, uint8_t mac[16])
+{
+	struct bt_aes aes;
+	uint8_t x[16] = { }, l[16], k[16];
+	size_t used = 0, i, j;
+	bool pending = false;
+
+	bt_aes_set_key(&aes, key);
+
+	for (i = 0; i < iov_cnt; i++) {
+		const uint8_t *data = iov[i].iov_base;
+		size_t len = iov[i].iov_len;
+
+		for (j = 0; j < len; j++) {
+			/* Only encrypt a full block once more data follows */
+			if (pending) {
+				bt_aes_encrypt(&aes, x, x);
+				pending = false;
+				used = 0;
+			}
+
+			x[used++] ^= data[j];
+
+			if (used == 16)
+				pending = true;
+		}
+	}
+
+	memset(l, 0, sizeof(l));
+	bt_aes_encrypt(&aes, l, l);
+	cmac_subkey(l, k);
+
+	/* Incomplete or empty last block: pad and use the second subkey */
+	if (used < 16) {
+		x[used] ^= 0x80;
+		memcpy(l, k, 16);
+		cmac_subkey(l, k);
+	}
+
+	for (i = 0; i < 16; i++)
+		x[i] ^= k[i];
+
+	bt_aes_encrypt(&aes, x, mac);
+
+	memset(&aes, 0, sizeof(aes));
+
+	return true;
+}
+
+bool bt_aes_cmac(const uint8_t key[16], const uint8_t *msg, size_t msg_len,
+							uint8_t mac[16])
+{
+	struct iovec iov = {
+		.iov_base = (void *) msg,
+		.iov_len = msg_len,
+	};
+
+	return bt_aes_cmac_iov(key, &iov, 1, mac);
+}
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#define BT_AES_BLOCK_SIZE	16
+#define BT_AES_ROUND_KEYS	11
+
+struct iovec;
+
+struct bt_aes {
+	uint8_t rk[BT_AES_ROUND_KEYS * BT_AES_BLOCK_SIZE];
+};
+
+void bt_aes_set_key(struct bt_aes *aes, const uint8_t key[16]);
+void bt_aes_encrypt(const struct bt_aes *aes, const uint8_t in[16],
+							uint8_t out[16]);
+void bt_aes_encrypt_blocks(const struct bt_aes *aes, const uint8_t *in,
+						uint8_t *out, size_t blocks);
+void bt_aes_encrypt_keys(const struct bt_aes *aes, size_t count,
+					const uint8_t in[16], uint8_t *out);
+
+bool bt_aes_cmac(const uint8_t key[16], const uint8_t *msg, size_t msg_len,
+							uint8_t mac[16]);
+bool bt_aes_cmac_iov(const uint8_t key[16], const struct iovec *iov,
+				size_t iov_cnt, uint8_t mac[16]);
+
+bool bt_aes_hw(void);
+const char *bt_aes_impl(void);
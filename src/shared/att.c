@@ -20,6 +20,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/util.h"
 #include "src/shared/timeout.h"
+#include "src/shared/trace.h"
 #include "lib/bluetooth.h"
 #include "lib/l2cap.h"
 #include "lib/uuid.h"
@@ -30,6 +31,9 @@
 #define ATT_OP_CMD_MASK			0x40
 #define ATT_OP_SIGNED_MASK		0x80
 #define ATT_TIMEOUT_INTERVAL		30000  /* 30000 ms */
+#define ATT_OP_POOL_MAX			32
+#define ATT_RX_BATCH			8  /* PDUs read per wakeup */
+#define ATT_WRITE_CREDITS		16 /* Commands queued before throttling */
 
 /* Length of signature in write signed packet */
 #define BT_ATT_SIGNATURE_LEN		12
@@ -53,6 +57,8 @@ struct bt_att_chan {
 
 	uint8_t *buf;
 	uint16_t mtu;
+
+	struct bt_att_chan_stats stats;
 };
 
 struct bt_att {
@@ -72,7 +78,12 @@ struct bt_att {
 	struct queue *req_queue;	/* Queued ATT protocol requests */
 	struct queue *ind_queue;	/* Queued ATT protocol indications */
 	struct queue *write_queue;	/* Queue of PDUs ready to send */
+	unsigned int write_cmds;	/* Commands queued in write_queue */
+	bool write_blocked;		/* Credits ran out since last notify */
+	struct queue *credits_list;	/* List of write credits handlers */
 	bool in_disc;			/* Cleanup queues on disconnect_cb */
+	unsigned int req_waits;		/* Requests queued while busy */
+	struct bt_att_chan_stats closed_stats;	/* Of detached channels */
 
 	bt_att_timeout_func_t timeout_callback;
 	bt_att_destroy_func_t timeout_destroy;
@@ -126,6 +137,8 @@ static const struct {
 	{ BT_ATT_OP_READ_MULT_RSP,		ATT_OP_TYPE_RSP },
 	{ BT_ATT_OP_READ_BY_GRP_TYPE_REQ,	ATT_OP_TYPE_REQ },
 	{ BT_ATT_OP_READ_BY_GRP_TYPE_RSP,	ATT_OP_TYPE_RSP },
+	{ BT_ATT_OP_READ_MULT_VL_REQ,		ATT_OP_TYPE_REQ },
+	{ BT_ATT_OP_READ_MULT_VL_RSP,		ATT_OP_TYPE_RSP },
 	{ BT_ATT_OP_WRITE_REQ,			ATT_OP_TYPE_REQ },
 	{ BT_ATT_OP_WRITE_RSP,			ATT_OP_TYPE_RSP },
 	{ BT_ATT_OP_WRITE_CMD,			ATT_OP_TYPE_CMD },
@@ -141,6 +154,15 @@ static const struct {
 	{ }
 };
 
+/*
+ * Only LE sized channels read in batches, a BR/EDR MTU can be large enough
+ * to make a buffer per PDU too costly.
+ */
+static unsigned int chan_rx_slots(uint16_t mtu)
+{
+	return mtu <= BT_ATT_MAX_LE_MTU ? ATT_RX_BATCH : 1;
+}
+
 static enum att_op_type get_op_type(uint8_t opcode)
 {
 	int i;
@@ -168,6 +190,7 @@ static const struct {
 	{ BT_ATT_OP_READ_BLOB_REQ,		BT_ATT_OP_READ_BLOB_RSP },
 	{ BT_ATT_OP_READ_MULT_REQ,		BT_ATT_OP_READ_MULT_RSP },
 	{ BT_ATT_OP_READ_BY_GRP_TYPE_REQ,	BT_ATT_OP_READ_BY_GRP_TYPE_RSP },
+	{ BT_ATT_OP_READ_MULT_VL_REQ,		BT_ATT_OP_READ_MULT_VL_RSP },
 	{ BT_ATT_OP_WRITE_REQ,			BT_ATT_OP_WRITE_RSP },
 	{ BT_ATT_OP_PREP_WRITE_REQ,		BT_ATT_OP_PREP_WRITE_RSP },
 	{ BT_ATT_OP_EXEC_WRITE_REQ,		BT_ATT_OP_EXEC_WRITE_RSP },
@@ -199,6 +222,9 @@ struct att_send_op {
 	void *user_data;
 };
 
+static __thread struct util_pool op_pool =
+			UTIL_POOL_INIT(struct att_send_op, ATT_OP_POOL_MAX);
+
 static void destroy_att_send_op(void *data)
 {
 	struct att_send_op *op = data;
@@ -210,7 +236,7 @@ static void destroy_att_send_op(void *data)
 		op->destroy(op->user_data);
 
 	free(op->pdu);
-	free(op);
+	util_pool_release(&op_pool, op);
 }
 
 static void cancel_att_send_op(void *data)
@@ -267,6 +293,14 @@ struct att_exchange {
 	void *user_data;
 };
 
+struct att_credits {
+	unsigned int id;
+	bool removed;
+	bt_att_credits_func_t callback;
+	bt_att_destroy_func_t destroy;
+	void *user_data;
+};
+
 static void destroy_att_disconn(void *data)
 {
 	struct att_disconn *disconn = data;
@@ -287,6 +321,16 @@ static void destroy_att_exchange(void *data)
 	free(exchange);
 }
 
+static void destroy_att_credits(void *data)
+{
+	struct att_credits *credits = data;
+
+	if (credits->destroy)
+		credits->destroy(credits->user_data);
+
+	free(credits);
+}
+
 static bool match_disconn_id(const void *a, const void *b)
 {
 	const struct att_disconn *disconn = a;
@@ -326,29 +370,42 @@ static void att_hexdump(struct bt_att *att, char dir, const void *data,
 }
 
 static bool encode_pdu(struct bt_att *att, struct att_send_op *op,
-					const void *pdu, uint16_t length)
+					const struct iovec *iov, int iovcnt)
 {
 	uint16_t pdu_len = 1;
 	struct sign_info *sign = att->local_sign;
 	uint32_t sign_cnt;
+	size_t length = 0;
+	uint8_t *ptr;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		length += iov[i].iov_len;
 
 	if (sign && (op->opcode & ATT_OP_SIGNED_MASK))
 		pdu_len += BT_ATT_SIGNATURE_LEN;
 
-	if (length && pdu)
-		pdu_len += length;
-
-	if (pdu_len > att->mtu)
+	if (length + pdu_len > att->mtu)
 		return false;
 
+	pdu_len += length;
+
 	op->len = pdu_len;
 	op->pdu = malloc(op->len);
 	if (!op->pdu)
 		return false;
 
-	((uint8_t *) op->pdu)[0] = op->opcode;
-	if (pdu_len > 1)
-		memcpy(op->pdu + 1, pdu, length);
+	ptr = op->pdu;
+	*ptr++ = op->opcode;
+
+	/* Gather the payload straight into the PDU */
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].iov_len)
+			continue;
+
+		memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+		ptr += iov[i].iov_len;
+	}
 
 	if (!sign || !(op->opcode & ATT_OP_SIGNED_MASK) || !att->crypto)
 		return true;
@@ -369,18 +426,24 @@ fail:
 
 static struct att_send_op *create_att_send_op(struct bt_att *att,
 						uint8_t opcode,
-						const void *pdu,
-						uint16_t length,
+						const struct iovec *iov,
+						int iovcnt,
 						bt_att_response_func_t callback,
 						void *user_data,
 						bt_att_destroy_func_t destroy)
 {
 	struct att_send_op *op;
 	enum att_op_type type;
+	int i;
 
-	if (length && !pdu)
+	if (iovcnt < 0 || (iovcnt && !iov))
 		return NULL;
 
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len && !iov[i].iov_base)
+			return NULL;
+	}
+
 	type = get_op_type(opcode);
 	if (type == ATT_OP_TYPE_UNKNOWN)
 		return NULL;
@@ -398,21 +461,149 @@ static struct att_send_op *create_att_send_op(struct bt_att *att,
 	if (!callback && (type == ATT_OP_TYPE_REQ || type == ATT_OP_TYPE_IND))
 		return NULL;
 
-	op = new0(struct att_send_op, 1);
+	op = util_pool_alloc(&op_pool);
 	op->type = type;
 	op->opcode = opcode;
 	op->callback = callback;
 	op->destroy = destroy;
 	op->user_data = user_data;
 
-	if (!encode_pdu(att, op, pdu, length)) {
-		free(op);
+	if (!encode_pdu(att, op, iov, iovcnt)) {
+		util_pool_release(&op_pool, op);
 		return NULL;
 	}
 
 	return op;
 }
 
+static unsigned int chan_depth(struct bt_att_chan *chan)
+{
+	return queue_length(chan->queue) + !!chan->pending_req +
+							!!chan->pending_ind;
+}
+
+static bool chan_can_take(struct bt_att_chan *chan, struct att_send_op *op)
+{
+	if (op->len > chan->mtu)
+		return false;
+
+	switch (op->type) {
+	case ATT_OP_TYPE_REQ:
+		/* Don't send Exchange MTU over EATT */
+		if (op->opcode == BT_ATT_OP_MTU_REQ &&
+					chan->type == BT_ATT_EATT)
+			return false;
+
+		return !chan->pending_req;
+	case ATT_OP_TYPE_IND:
+		return !chan->pending_ind;
+	default:
+		return true;
+	}
+}
+
+/*
+ * Order channels by backlog first, then by MTU so bigger responses fit in a
+ * single PDU, and finally by the number of operations already carried.
+ */
+static bool chan_better(struct bt_att_chan *a, struct bt_att_chan *b)
+{
+	unsigned int depth_a = chan_depth(a), depth_b = chan_depth(b);
+
+	if (depth_a != depth_b)
+		return depth_a < depth_b;
+
+	if (a->mtu != b->mtu)
+		return a->mtu > b->mtu;
+
+	return a->stats.reqs + a->stats.inds < b->stats.reqs + b->stats.inds;
+}
+
+static struct bt_att_chan *select_chan(struct bt_att *att,
+						struct att_send_op *op)
+{
+	const struct queue_entry *entry;
+	struct bt_att_chan *best = NULL;
+
+	for (entry = queue_get_entries(att->chans); entry;
+						entry = entry->next) {
+		struct bt_att_chan *chan = entry->data;
+
+		if (!chan_can_take(chan, op))
+			continue;
+
+		if (!best || chan_better(chan, best))
+			best = chan;
+	}
+
+	return best;
+}
+
+static void wakeup_chan_writer(void *data, void *user_data);
+
+/*
+ * Requests and indications are only taken by the best idle channel, the
+ * others leave them queued and make sure that channel is woken up.
+ */
+static bool chan_preferred(struct bt_att_chan *chan, struct att_send_op *op)
+{
+	struct bt_att_chan *best;
+
+	if (!chan_can_take(chan, op))
+		return false;
+
+	best = select_chan(chan->att, op);
+	if (!best || best == chan)
+		return true;
+
+	wakeup_chan_writer(best, NULL);
+
+	return false;
+}
+
+static struct att_send_op *pop_shared_op(struct bt_att *att,
+							struct queue *queue)
+{
+	struct att_send_op *op = queue_pop_head(queue);
+
+	/* Let the next best channel pick up whatever is left */
+	if (!queue_isempty(queue))
+		queue_foreach(att->chans, wakeup_chan_writer, NULL);
+
+	return op;
+}
+
+static void write_credit_release(struct bt_att *att, struct att_send_op *op)
+{
+	if (op->type == ATT_OP_TYPE_CMD && att->write_cmds)
+		att->write_cmds--;
+}
+
+static void credits_handler(void *data, void *user_data)
+{
+	struct att_credits *credits = data;
+
+	if (credits->removed)
+		return;
+
+	if (credits->callback)
+		credits->callback(PTR_TO_UINT(user_data), credits->user_data);
+}
+
+static void write_credits_notify(struct bt_att *att)
+{
+	/* Only notify once half of the credits are back so writers are not
+	 * woken up for every single PDU that makes it into the socket.
+	 */
+	if (!att->write_blocked || att->write_cmds > ATT_WRITE_CREDITS / 2)
+		return;
+
+	att->write_blocked = false;
+
+	queue_foreach(att->credits_list, credits_handler,
+			UINT_TO_PTR(ATT_WRITE_CREDITS - att->write_cmds));
+}
+
 static struct att_send_op *pick_next_send_op(struct bt_att_chan *chan)
 {
 	struct bt_att *att = chan->att;
@@ -425,32 +616,27 @@ static struct att_send_op *pick_next_send_op(struct bt_att_chan *chan)
 
 	/* See if any operations are already in the write queue */
 	op = queue_peek_head(att->write_queue);
-	if (op && op->len <= chan->mtu)
+	if (op && op->len <= chan->mtu) {
+		write_credit_release(att, op);
 		return queue_pop_head(att->write_queue);
+	}
 
 	/* If there is no pending request, pick an operation from the
 	 * request queue.
 	 */
 	if (!chan->pending_req) {
 		op = queue_peek_head(att->req_queue);
-		if (op && op->len <= chan->mtu) {
-			/* Don't send Exchange MTU over EATT */
-			if (op->opcode == BT_ATT_OP_MTU_REQ &&
-					chan->type == BT_ATT_EATT)
-				goto indicate;
-
-			return queue_pop_head(att->req_queue);
-		}
+		if (op && chan_preferred(chan, op))
+			return pop_shared_op(att, att->req_queue);
 	}
 
-indicate:
 	/* There is either a request pending or no requests queued. If there is
 	 * no pending indication, pick an operation from the indication queue.
 	 */
 	if (!chan->pending_ind) {
 		op = queue_peek_head(att->ind_queue);
-		if (op && op->len <= chan->mtu)
-			return queue_pop_head(att->ind_queue);
+		if (op && chan_preferred(chan, op))
+			return pop_shared_op(att, att->ind_queue);
 	}
 
 	return NULL;
@@ -492,6 +678,8 @@ static bool timeout_cb(void *user_data)
 	DBG(att, "(chan %p) Operation timed out: 0x%02x", chan,
 						op->opcode);
 
+	chan->stats.timeouts++;
+
 	if (att->timeout_callback)
 		att->timeout_callback(op->id, op->opcode, att->timeout_data);
 
@@ -534,6 +722,14 @@ static ssize_t bt_att_chan_write(struct bt_att_chan *chan, uint8_t opcode,
 		return ret;
 	}
 
+	chan->stats.tx_pdus++;
+	chan->stats.tx_bytes += ret;
+
+	if (ret > chan->stats.max_pdu)
+		chan->stats.max_pdu = ret;
+
+	BT_TRACE3(att_send, chan, opcode, ret);
+
 	if (att->debug_level)
 		util_hexdump('<', pdu, ret, att->debug_callback,
 						att->debug_data);
@@ -566,15 +762,20 @@ static bool can_write_data(struct io *io, void *user_data)
 	switch (op->type) {
 	case ATT_OP_TYPE_REQ:
 		chan->pending_req = op;
+		chan->stats.reqs++;
 		break;
 	case ATT_OP_TYPE_IND:
 		chan->pending_ind = op;
+		chan->stats.inds++;
 		break;
+	case ATT_OP_TYPE_CMD:
+		destroy_att_send_op(op);
+		write_credits_notify(chan->att);
+		return true;
 	case ATT_OP_TYPE_RSP:
 		/* Set in_req to false to indicate that no request is pending */
 		chan->in_req = false;
 		/* fall through */
-	case ATT_OP_TYPE_CMD:
 	case ATT_OP_TYPE_NFY:
 	case ATT_OP_TYPE_CONF:
 	case ATT_OP_TYPE_UNKNOWN:
@@ -652,6 +853,23 @@ static void bt_att_chan_free(void *data)
 	free(chan);
 }
 
+static void sum_chan_stats(void *data, void *user_data)
+{
+	struct bt_att_chan *chan = data;
+	struct bt_att_chan_stats *stats = user_data;
+
+	stats->tx_pdus += chan->stats.tx_pdus;
+	stats->tx_bytes += chan->stats.tx_bytes;
+	stats->rx_pdus += chan->stats.rx_pdus;
+	stats->rx_bytes += chan->stats.rx_bytes;
+	stats->reqs += chan->stats.reqs;
+	stats->inds += chan->stats.inds;
+	stats->timeouts += chan->stats.timeouts;
+
+	if (chan->stats.max_pdu > stats->max_pdu)
+		stats->max_pdu = chan->stats.max_pdu;
+}
+
 static bool disconnect_cb(struct io *io, void *user_data)
 {
 	struct bt_att_chan *chan = user_data;
@@ -671,6 +889,7 @@ static bool disconnect_cb(struct io *io, void *user_data)
 
 	/* Dettach channel */
 	queue_remove(att->chans, chan);
+	sum_chan_stats(chan, &att->closed_stats);
 
 	if (chan->pending_req) {
 		disc_att_send_op(chan->pending_req);
@@ -696,6 +915,7 @@ static bool disconnect_cb(struct io *io, void *user_data)
 	queue_remove_all(att->req_queue, NULL, NULL, disc_att_send_op);
 	queue_remove_all(att->ind_queue, NULL, NULL, disc_att_send_op);
 	queue_remove_all(att->write_queue, NULL, NULL, disc_att_send_op);
+	att->write_cmds = 0;
 
 	att->in_disc = false;
 
@@ -1036,29 +1256,28 @@ not_supported:
 	bt_att_unref(att);
 }
 
-static bool can_read_data(struct io *io, void *user_data)
+static bool chan_read_pdu(struct bt_att_chan *chan, uint8_t *pdu,
+							ssize_t bytes_read)
 {
-	struct bt_att_chan *chan = user_data;
 	struct bt_att *att = chan->att;
 	uint8_t opcode;
-	uint8_t *pdu;
-	ssize_t bytes_read;
-
-	bytes_read = read(chan->fd, chan->buf, chan->mtu);
-	if (bytes_read < 0)
-		return false;
 
 	VERBOSE(att, "(chan %p) ATT received: %zd", chan, bytes_read);
 
-	att_hexdump(att, '>', chan->buf, bytes_read);
+	chan->stats.rx_pdus++;
+	chan->stats.rx_bytes += bytes_read;
+
+	if (bytes_read > chan->stats.max_pdu)
+		chan->stats.max_pdu = bytes_read;
+
+	att_hexdump(att, '>', pdu, bytes_read);
 
 	if (bytes_read < ATT_MIN_PDU_LEN)
 		return true;
 
-	pdu = chan->buf;
 	opcode = pdu[0];
 
-	bt_att_ref(att);
+	BT_TRACE3(att_recv, chan, opcode, bytes_read);
 
 	/* Act on the received PDU based on the opcode type */
 	switch (get_op_type(opcode)) {
@@ -1083,7 +1302,6 @@ static bool can_read_data(struct io *io, void *user_data)
 					"another is pending: 0x%02x",
 					chan, opcode);
 			io_shutdown(chan->io);
-			bt_att_unref(chan->att);
 
 			return false;
 		}
@@ -1105,9 +1323,54 @@ static bool can_read_data(struct io *io, void *user_data)
 		break;
 	}
 
+	return true;
+}
+
+static bool can_read_data(struct io *io, void *user_data)
+{
+	struct bt_att_chan *chan = user_data;
+	struct bt_att *att = chan->att;
+	struct iovec iov[ATT_RX_BATCH];
+	size_t len[ATT_RX_BATCH];
+	unsigned int slots, i;
+	uint16_t mtu = chan->mtu;
+	uint8_t *buf = chan->buf;
+	bool ret = true;
+	int count;
+
+	slots = chan_rx_slots(mtu);
+
+	for (i = 0; i < slots; i++) {
+		iov[i].iov_base = buf + i * mtu;
+		iov[i].iov_len = mtu;
+	}
+
+	count = io_recv_batch(chan->io, iov, slots, len);
+	if (count == -EAGAIN)
+		return true;
+
+	if (count < 0)
+		return false;
+
+	bt_att_ref(att);
+
+	/*
+	 * Take ownership of the buffer while dispatching so a MTU change
+	 * done by one of the handlers cannot free the PDUs still pending.
+	 */
+	chan->buf = NULL;
+
+	for (i = 0; ret && i < (unsigned int) count; i++)
+		ret = chan_read_pdu(chan, iov[i].iov_base, len[i]);
+
+	if (chan->buf)
+		free(buf);
+	else
+		chan->buf = buf;
+
 	bt_att_unref(att);
 
-	return true;
+	return ret;
 }
 
 static bool is_io_l2cap_based(int fd)
@@ -1154,6 +1417,7 @@ static void bt_att_free(struct bt_att *att)
 	queue_destroy(att->notify_list, NULL);
 	queue_destroy(att->disconn_list, NULL);
 	queue_destroy(att->exchange_list, NULL);
+	queue_destroy(att->credits_list, NULL);
 	queue_destroy(att->chans, bt_att_chan_free);
 
 	free(att);
@@ -1228,7 +1492,7 @@ static struct bt_att_chan *bt_att_chan_new(int fd, uint8_t type)
 	if (chan->mtu < BT_ATT_DEFAULT_LE_MTU)
 		goto fail;
 
-	chan->buf = malloc(chan->mtu);
+	chan->buf = malloc(chan->mtu * chan_rx_slots(chan->mtu));
 	if (!chan->buf)
 		goto fail;
 
@@ -1281,6 +1545,7 @@ struct bt_att *bt_att_new(int fd, bool ext_signed)
 	att->notify_list = queue_new();
 	att->disconn_list = queue_new();
 	att->exchange_list = queue_new();
+	att->credits_list = queue_new();
 
 	bt_att_attach_chan(att, chan);
 
@@ -1370,6 +1635,71 @@ int bt_att_get_channels(struct bt_att *att)
 	return queue_length(att->chans);
 }
 
+bool bt_att_chan_get_stats(struct bt_att_chan *chan,
+					struct bt_att_chan_stats *stats)
+{
+	if (!chan || !stats)
+		return false;
+
+	*stats = chan->stats;
+
+	return true;
+}
+
+bool bt_att_get_stats(struct bt_att *att, struct bt_att_chan_stats *stats)
+{
+	if (!att || !stats)
+		return false;
+
+	/* Channels closed so far still count towards the totals */
+	*stats = att->closed_stats;
+
+	queue_foreach(att->chans, sum_chan_stats, stats);
+
+	return true;
+}
+
+unsigned int bt_att_get_req_waits(struct bt_att *att)
+{
+	if (!att)
+		return 0;
+
+	return att->req_waits;
+}
+
+static bool chan_req_idle(const void *data, const void *match_data)
+{
+	const struct bt_att_chan *chan = data;
+
+	return !chan->pending_req;
+}
+
+static bool chan_idle(const void *data, const void *match_data)
+{
+	const struct bt_att_chan *chan = data;
+
+	return chan->type == BT_ATT_EATT && !chan->pending_req &&
+			!chan->pending_ind && !chan->in_req &&
+			queue_isempty(chan->queue);
+}
+
+bool bt_att_close_idle_chan(struct bt_att *att)
+{
+	struct bt_att_chan *chan;
+
+	if (!att)
+		return false;
+
+	/* EATT channels are at the head, so the newest one goes first */
+	chan = queue_find(att->chans, chan_idle, NULL);
+	if (!chan)
+		return false;
+
+	DBG(att, "(chan %p) Closing idle channel", chan);
+
+	return io_shutdown(chan->io);
+}
+
 bool bt_att_set_debug(struct bt_att *att, uint8_t level,
 			bt_att_debug_func_t callback, void *user_data,
 			bt_att_destroy_func_t destroy)
@@ -1424,7 +1754,7 @@ bool bt_att_set_mtu(struct bt_att *att, uint16_t mtu)
 	if (!chan)
 		return -ENOTCONN;
 
-	buf = malloc(mtu);
+	buf = malloc(mtu * chan_rx_slots(mtu));
 	if (!buf)
 		return false;
 
@@ -1583,10 +1913,101 @@ bool bt_att_unregister_exchange(struct bt_att *att, unsigned int id)
 	return true;
 }
 
+unsigned int bt_att_register_write_credits(struct bt_att *att,
+					bt_att_credits_func_t callback,
+					void *user_data,
+					bt_att_destroy_func_t destroy)
+{
+	struct att_credits *credits;
+
+	if (!att || queue_isempty(att->chans))
+		return 0;
+
+	credits = new0(struct att_credits, 1);
+	credits->callback = callback;
+	credits->destroy = destroy;
+	credits->user_data = user_data;
+
+	if (att->next_reg_id < 1)
+		att->next_reg_id = 1;
+
+	credits->id = att->next_reg_id++;
+
+	if (!queue_push_tail(att->credits_list, credits)) {
+		free(credits);
+		return 0;
+	}
+
+	return credits->id;
+}
+
+bool bt_att_unregister_write_credits(struct bt_att *att, unsigned int id)
+{
+	struct att_credits *credits;
+
+	if (!att || !id)
+		return false;
+
+	/* Check if disconnect is running */
+	if (queue_isempty(att->chans)) {
+		credits = queue_find(att->credits_list, match_disconn_id,
+							UINT_TO_PTR(id));
+		if (!credits)
+			return false;
+
+		credits->removed = true;
+		return true;
+	}
+
+	credits = queue_remove_if(att->credits_list, match_disconn_id,
+							UINT_TO_PTR(id));
+	if (!credits)
+		return false;
+
+	destroy_att_credits(credits);
+	return true;
+}
+
+unsigned int bt_att_get_write_credits(struct bt_att *att)
+{
+	if (!att || queue_isempty(att->chans))
+		return 0;
+
+	if (att->write_cmds >= ATT_WRITE_CREDITS)
+		return 0;
+
+	return ATT_WRITE_CREDITS - att->write_cmds;
+}
+
+unsigned int bt_att_get_write_queue_len(struct bt_att *att)
+{
+	if (!att)
+		return 0;
+
+	return queue_length(att->write_queue);
+}
+
 unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 				const void *pdu, uint16_t length,
 				bt_att_response_func_t callback, void *user_data,
 				bt_att_destroy_func_t destroy)
+{
+	struct iovec iov;
+
+	if (length && !pdu)
+		return 0;
+
+	iov.iov_base = (void *) pdu;
+	iov.iov_len = length;
+
+	return bt_att_sendv(att, opcode, &iov, 1, callback, user_data,
+								destroy);
+}
+
+unsigned int bt_att_sendv(struct bt_att *att, uint8_t opcode,
+				const struct iovec *iov, int iovcnt,
+				bt_att_response_func_t callback, void *user_data,
+				bt_att_destroy_func_t destroy)
 {
 	struct att_send_op *op;
 	bool result;
@@ -1594,7 +2015,7 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 	if (!att || queue_isempty(att->chans))
 		return 0;
 
-	op = create_att_send_op(att, opcode, pdu, length, callback, user_data,
+	op = create_att_send_op(att, opcode, iov, iovcnt, callback, user_data,
 								destroy);
 	if (!op)
 		return 0;
@@ -1615,12 +2036,20 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 	/* Add the op to the correct queue based on its type */
 	switch (op->type) {
 	case ATT_OP_TYPE_REQ:
+		if (!queue_isempty(att->req_queue) ||
+				!queue_find(att->chans, chan_req_idle, NULL))
+			att->req_waits++;
+
 		result = queue_push_tail(att->req_queue, op);
 		break;
 	case ATT_OP_TYPE_IND:
 		result = queue_push_tail(att->ind_queue, op);
 		break;
 	case ATT_OP_TYPE_CMD:
+		result = queue_push_tail(att->write_queue, op);
+		if (result && ++att->write_cmds >= ATT_WRITE_CREDITS)
+			att->write_blocked = true;
+		break;
 	case ATT_OP_TYPE_NFY:
 	case ATT_OP_TYPE_UNKNOWN:
 	case ATT_OP_TYPE_RSP:
@@ -1633,7 +2062,7 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 done:
 	if (!result) {
 		free(op->pdu);
-		free(op);
+		util_pool_release(&op_pool, op);
 		return 0;
 	}
 
@@ -1650,9 +2079,10 @@ int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 {
 	const struct queue_entry *entry;
 	struct att_send_op *op;
+	struct iovec iov;
 	bool result;
 
-	if (!att || !id)
+	if (!att || !id || (length && !pdu))
 		return -EINVAL;
 
 	/* Lookup request on each channel */
@@ -1671,7 +2101,10 @@ int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 	if (get_op_type(opcode) != ATT_OP_TYPE_REQ)
 		return -EOPNOTSUPP;
 
-	op = create_att_send_op(att, opcode, pdu, length, callback, user_data,
+	iov.iov_base = (void *) pdu;
+	iov.iov_len = length;
+
+	op = create_att_send_op(att, opcode, &iov, 1, callback, user_data,
 								destroy);
 	if (!op)
 		return -ENOMEM;
@@ -1692,7 +2125,7 @@ int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 
 	if (!result) {
 		free(op->pdu);
-		free(op);
+		util_pool_release(&op_pool, op);
 		return -ENOMEM;
 	}
 
@@ -1706,20 +2139,38 @@ unsigned int bt_att_chan_send(struct bt_att_chan *chan, uint8_t opcode,
 				bt_att_response_func_t callback,
 				void *user_data,
 				bt_att_destroy_func_t destroy)
+{
+	struct iovec iov;
+
+	if (len && !pdu)
+		return -EINVAL;
+
+	iov.iov_base = (void *) pdu;
+	iov.iov_len = len;
+
+	return bt_att_chan_sendv(chan, opcode, &iov, 1, callback, user_data,
+								destroy);
+}
+
+unsigned int bt_att_chan_sendv(struct bt_att_chan *chan, uint8_t opcode,
+				const struct iovec *iov, int iovcnt,
+				bt_att_response_func_t callback,
+				void *user_data,
+				bt_att_destroy_func_t destroy)
 {
 	struct att_send_op *op;
 
 	if (!chan || !chan->att)
 		return -EINVAL;
 
-	op = create_att_send_op(chan->att, opcode, pdu, len, callback,
+	op = create_att_send_op(chan->att, opcode, iov, iovcnt, callback,
 						user_data, destroy);
 	if (!op)
 		return -EINVAL;
 
 	if (!queue_push_tail(chan->queue, op)) {
 		free(op->pdu);
-		free(op);
+		util_pool_release(&op_pool, op);
 		return 0;
 	}
 
@@ -1816,8 +2267,10 @@ bool bt_att_cancel(struct bt_att *att, unsigned int id)
 		goto done;
 
 	op = queue_remove_if(att->write_queue, match_op_id, UINT_TO_PTR(id));
-	if (op)
+	if (op) {
+		write_credit_release(att, op);
 		goto done;
+	}
 
 	if (!op)
 		return false;
@@ -1840,6 +2293,7 @@ bool bt_att_cancel_all(struct bt_att *att)
 	queue_remove_all(att->req_queue, NULL, NULL, destroy_att_send_op);
 	queue_remove_all(att->ind_queue, NULL, NULL, destroy_att_send_op);
 	queue_remove_all(att->write_queue, NULL, NULL, destroy_att_send_op);
+	att->write_cmds = 0;
 
 	for (entry = queue_get_entries(att->chans); entry;
 						entry = entry->next) {
@@ -1963,6 +2417,7 @@ bool bt_att_unregister_all(struct bt_att *att)
 	queue_remove_all(att->notify_list, NULL, NULL, destroy_att_notify);
 	queue_remove_all(att->disconn_list, NULL, NULL, destroy_att_disconn);
 	queue_remove_all(att->exchange_list, NULL, NULL, destroy_att_exchange);
+	queue_remove_all(att->credits_list, NULL, NULL, destroy_att_credits);
 
 	return true;
 }
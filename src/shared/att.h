@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 #include "src/shared/att-types.h"
 
@@ -33,6 +34,23 @@ int bt_att_attach_fd(struct bt_att *att, int fd);
 
 int bt_att_get_channels(struct bt_att *att);
 
+struct bt_att_chan_stats {
+	uint64_t tx_pdus;
+	uint64_t tx_bytes;
+	uint64_t rx_pdus;
+	uint64_t rx_bytes;
+	unsigned int reqs;
+	unsigned int inds;
+	unsigned int timeouts;
+	uint16_t max_pdu;
+};
+
+bool bt_att_chan_get_stats(struct bt_att_chan *chan,
+					struct bt_att_chan_stats *stats);
+bool bt_att_get_stats(struct bt_att *att, struct bt_att_chan_stats *stats);
+unsigned int bt_att_get_req_waits(struct bt_att *att);
+bool bt_att_close_idle_chan(struct bt_att *att);
+
 typedef void (*bt_att_response_func_t)(uint8_t opcode, const void *pdu,
 					uint16_t length, void *user_data);
 typedef void (*bt_att_notify_func_t)(struct bt_att_chan *chan, uint16_t mtu,
@@ -44,6 +62,7 @@ typedef void (*bt_att_timeout_func_t)(unsigned int id, uint8_t opcode,
 							void *user_data);
 typedef void (*bt_att_disconnect_func_t)(int err, void *user_data);
 typedef void (*bt_att_exchange_func_t)(uint16_t mtu, void *user_data);
+typedef void (*bt_att_credits_func_t)(unsigned int credits, void *user_data);
 typedef bool (*bt_att_counter_func_t)(uint32_t *sign_cnt, void *user_data);
 
 bool bt_att_set_debug(struct bt_att *att, uint8_t level,
@@ -63,6 +82,11 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 					bt_att_response_func_t callback,
 					void *user_data,
 					bt_att_destroy_func_t destroy);
+unsigned int bt_att_sendv(struct bt_att *att, uint8_t opcode,
+					const struct iovec *iov, int iovcnt,
+					bt_att_response_func_t callback,
+					void *user_data,
+					bt_att_destroy_func_t destroy);
 int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 					const void *pdu, uint16_t length,
 					bt_att_response_func_t callback,
@@ -73,6 +97,11 @@ unsigned int bt_att_chan_send(struct bt_att_chan *chan, uint8_t opcode,
 					bt_att_response_func_t callback,
 					void *user_data,
 					bt_att_destroy_func_t destroy);
+unsigned int bt_att_chan_sendv(struct bt_att_chan *chan, uint8_t opcode,
+					const struct iovec *iov, int iovcnt,
+					bt_att_response_func_t callback,
+					void *user_data,
+					bt_att_destroy_func_t destroy);
 #define bt_att_chan_send_rsp(chan, opcode, pdu, len) \
 	bt_att_chan_send(chan, opcode, pdu, len, NULL, NULL, NULL)
 bool bt_att_chan_cancel(struct bt_att_chan *chan, unsigned int id);
@@ -99,6 +128,13 @@ unsigned int bt_att_register_exchange(struct bt_att *att,
 					void *user_data,
 					bt_att_destroy_func_t destroy);
 bool bt_att_unregister_exchange(struct bt_att *att, unsigned int id);
+unsigned int bt_att_register_write_credits(struct bt_att *att,
+					bt_att_credits_func_t callback,
+					void *user_data,
+					bt_att_destroy_func_t destroy);
+bool bt_att_unregister_write_credits(struct bt_att *att, unsigned int id);
+unsigned int bt_att_get_write_credits(struct bt_att *att);
+unsigned int bt_att_get_write_queue_len(struct bt_att *att);
 bool bt_att_unregister_all(struct bt_att *att);
 
 int bt_att_get_security(struct bt_att *att, uint8_t *enc_size);
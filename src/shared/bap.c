@@ -6921,6 +6921,12 @@ static bool compare_ltv(struct iovec *iov1,
 	if (iov1->iov_len != iov2->iov_len)
 		return false;
 
+	/* Streams of the same subgroup normally carry identical metadata,
+	 * only fall back to matching each LTV when the order differs.
+	 */
+	if (!memcmp(iov1->iov_base, iov2->iov_base, iov1->iov_len))
+		return true;
+
 	ltv_search.found = true;
 	ltv_search.iov = iov2;
 
@@ -6972,6 +6978,12 @@ static struct iovec *extract_diff_caps(
 	ext_data.src = subgroup_caps;
 	ext_data.result = new0(struct iovec, 1);
 
+	/* Nothing is BIS specific if the configuration is the same */
+	if (subgroup_caps->iov_len == bis_caps->iov_len &&
+			!memcmp(subgroup_caps->iov_base, bis_caps->iov_base,
+							bis_caps->iov_len))
+		return ext_data.result;
+
 	util_ltv_foreach(bis_caps->iov_base,
 			bis_caps->iov_len, NULL,
 			extract_ltv, &ext_data);
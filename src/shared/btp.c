@@ -8,8 +8,10 @@
  *
  */
 
+#include <errno.h>
 #include <stdbool.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <time.h>
 #include <unistd.h>
@@ -21,6 +23,13 @@
 
 #define BTP_MTU 512
 
+/*
+ * Room for several commands so a tester may pipeline them without waiting
+ * for each response, and the number of queued messages written at once.
+ */
+#define BTP_READ_BUF_SIZE (BTP_MTU * 8)
+#define BTP_WRITE_BATCH 16
+
 struct btp_handler {
 	unsigned int id;
 	uint8_t service;
@@ -41,7 +50,9 @@ struct btp {
 	struct l_queue *handlers;
 	unsigned int next_handler;
 
-	uint8_t buf[BTP_MTU];
+	uint8_t buf[BTP_READ_BUF_SIZE];
+	size_t buf_len;
+	unsigned int in_flight;
 
 	btp_disconnect_func_t disconnect_cb;
 	void *disconnect_cb_data;
@@ -107,42 +118,82 @@ static bool handler_match(const void *a, const void *b)
 					(handler->opcode == match->opcode);
 }
 
-static bool can_read_data(struct l_io *io, void *user_data)
+static void handle_command(struct btp *btp, struct btp_hdr *hdr)
 {
 	struct handler_match_data match;
-	struct btp *btp = user_data;
 	struct btp_handler *handler;
-	struct btp_hdr *hdr;
-	ssize_t bytes_read;
-	uint16_t data_len;
-
-	bytes_read = read(l_io_get_fd(btp->io), btp->buf, sizeof(btp->buf));
-	if (bytes_read < 0)
-		return false;
-
-	if ((size_t) bytes_read < sizeof(*hdr))
-		return false;
-
-	hdr = (void *)btp->buf;
-
-	data_len = L_LE16_TO_CPU(hdr->data_len);
-
-	if ((size_t) bytes_read < sizeof(*hdr) + data_len)
-		return false;
 
 	match.service = hdr->service;
 	match.opcode = hdr->opcode;
 
+	/* Every command is answered by exactly one response */
+	btp->in_flight++;
+
 	handler = l_queue_find(btp->handlers, handler_match, &match);
 	if (handler) {
-		handler->callback(hdr->index, hdr->data, data_len,
-							handler->user_data);
-		return false;
+		handler->callback(hdr->index, hdr->data,
+					L_LE16_TO_CPU(hdr->data_len),
+					handler->user_data);
+		return;
 	}
 
-	/* keep reader active if we sent error reply */
 	btp_send_error(btp, match.service, hdr->index, BTP_ERROR_UNKNOWN_CMD);
-	return true;
+}
+
+/*
+ * BTP responses carry no tag besides service and opcode, so the tester
+ * matches them by order. Buffered commands are still dispatched one at a
+ * time: the next one only once the response to the previous one is out.
+ */
+static void process_commands(struct btp *btp)
+{
+	size_t offset = 0;
+
+	while (!btp->in_flight) {
+		struct btp_hdr *hdr = (void *) (btp->buf + offset);
+		size_t len;
+
+		if (btp->buf_len - offset < sizeof(*hdr))
+			break;
+
+		len = sizeof(*hdr) + L_LE16_TO_CPU(hdr->data_len);
+		if (len > BTP_MTU) {
+			l_error("Invalid BTP message length %zu", len);
+			offset = btp->buf_len;
+			break;
+		}
+
+		if (btp->buf_len - offset < len)
+			break;
+
+		offset += len;
+
+		handle_command(btp, hdr);
+	}
+
+	if (!offset)
+		return;
+
+	btp->buf_len -= offset;
+	memmove(btp->buf, btp->buf + offset, btp->buf_len);
+}
+
+static bool can_read_data(struct l_io *io, void *user_data)
+{
+	struct btp *btp = user_data;
+	ssize_t bytes_read;
+
+	bytes_read = read(l_io_get_fd(btp->io), btp->buf + btp->buf_len,
+					sizeof(btp->buf) - btp->buf_len);
+	if (bytes_read <= 0)
+		return false;
+
+	btp->buf_len += bytes_read;
+
+	process_commands(btp);
+
+	/* Keep reading ahead while there is room for more commands */
+	return btp->buf_len < sizeof(btp->buf);
 }
 
 static void read_watch_destroy(void *user_data)
@@ -183,6 +234,7 @@ struct btp *btp_new(const char *path)
 
 struct pending_message {
 	size_t len;
+	size_t offset;
 	void *data;
 	bool wakeup_read;
 };
@@ -223,25 +275,65 @@ bool btp_set_disconnect_handler(struct btp *btp, btp_disconnect_func_t callback,
 	return true;
 }
 
+static void message_sent(struct btp *btp, struct pending_message *msg)
+{
+	if (msg->wakeup_read && btp->in_flight)
+		btp->in_flight--;
+
+	destroy_message(msg);
+}
+
 static bool can_write_data(struct l_io *io, void *user_data)
 {
 	struct btp *btp = user_data;
+	const struct l_queue_entry *entry;
 	struct pending_message *msg;
+	struct iovec iov[BTP_WRITE_BATCH];
+	int iovcnt = 0;
+	ssize_t written;
+
+	/* Coalesce queued responses and events into a single write */
+	for (entry = l_queue_get_entries(btp->pending);
+				entry && iovcnt < BTP_WRITE_BATCH;
+				entry = entry->next) {
+		msg = entry->data;
+
+		iov[iovcnt].iov_base = msg->data + msg->offset;
+		iov[iovcnt].iov_len = msg->len - msg->offset;
+		iovcnt++;
+	}
 
-	msg = l_queue_pop_head(btp->pending);
-	if (!msg)
+	if (!iovcnt)
 		return false;
 
-	if (msg->wakeup_read)
-		wakeup_reader(btp);
+	written = writev(l_io_get_fd(btp->io), iov, iovcnt);
+	if (written < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return true;
 
-	if (write(l_io_get_fd(btp->io), msg->data, msg->len) < 0) {
 		l_error("Failed to send BTP message");
-		destroy_message(msg);
-		return false;
+		message_sent(btp, l_queue_pop_head(btp->pending));
+		written = 0;
 	}
 
-	destroy_message(msg);
+	while ((msg = l_queue_peek_head(btp->pending)) && written > 0) {
+		size_t left = msg->len - msg->offset;
+
+		if ((size_t) written < left) {
+			msg->offset += written;
+			break;
+		}
+
+		written -= left;
+		message_sent(btp, l_queue_pop_head(btp->pending));
+	}
+
+	if (!btp->in_flight) {
+		process_commands(btp);
+
+		if (btp->buf_len < sizeof(btp->buf))
+			wakeup_reader(btp);
+	}
 
 	return !l_queue_isempty(btp->pending);
 }
@@ -22,6 +22,12 @@
 #include <limits.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "src/shared/btsnoop.h"
 
@@ -42,11 +48,34 @@ struct btsnoop_pkt {
 } __attribute__ ((packed));
 #define BTSNOOP_PKT_SIZE (sizeof(struct btsnoop_pkt))
 
+/* Amount of a mapped capture that is paged in ahead of the reader */
+#define BTSNOOP_PREFETCH (4 * 1024 * 1024)
+
 static const uint8_t btsnoop_id[] = { 0x62, 0x74, 0x73, 0x6e,
 				      0x6f, 0x6f, 0x70, 0x00 };
 
 static const uint32_t btsnoop_version = 1;
 
+/* Compressed files use the BTSnoop header with a different pattern,
+ * followed by chunks of zstd compressed BTSnoop records.
+ */
+struct btsnoop_chunk {
+	uint32_t	size;		/* Compressed Length */
+	uint32_t	len;		/* Uncompressed Length */
+	uint32_t	count;		/* Number of records */
+	uint64_t	ts;		/* Timestamp of first record */
+} __attribute__ ((packed));
+#define BTSNOOP_CHUNK_SIZE (sizeof(struct btsnoop_chunk))
+
+/* Positions in compressed files are the chunk offset and the offset of
+ * the record within the uncompressed chunk.
+ */
+#define BTSNOOP_CHUNK_SHIFT	20
+#define BTSNOOP_CHUNK_MAX	((1 << BTSNOOP_CHUNK_SHIFT) - 1)
+
+static const uint8_t btsnoop_zstd_id[] = { 0x62, 0x74, 0x73, 0x6e,
+					   0x7a, 0x73, 0x74, 0x00 };
+
 struct pklg_pkt {
 	uint32_t	len;
 	uint64_t	ts;
@@ -54,6 +83,21 @@ struct pklg_pkt {
 } __attribute__ ((packed));
 #define PKLG_PKT_SIZE (sizeof(struct pklg_pkt))
 
+/* The index file is a local cache so it uses host byte order */
+struct btsnoop_index_hdr {
+	uint8_t		id[8];		/* Identification Pattern */
+	uint64_t	file_size;	/* Size of the indexed file */
+	uint64_t	count;		/* Number of entries */
+} __attribute__ ((packed));
+
+struct btsnoop_index {
+	uint64_t	offset;		/* Record offset in the file */
+	uint64_t	ts;		/* Timestamp microseconds */
+} __attribute__ ((packed));
+
+static const uint8_t btsnoop_index_id[] = { 0x62, 0x74, 0x73, 0x6e,
+					    0x69, 0x64, 0x78, 0x00 };
+
 struct btsnoop {
 	int ref_count;
 	int fd;
@@ -68,8 +112,233 @@ struct btsnoop {
 	size_t cur_size;
 	unsigned int max_count;
 	unsigned int cur_count;
+	uint8_t *map;
+	size_t map_size;
+	size_t map_offset;
+	size_t map_prefetch;
+	struct btsnoop_index *index_list;
+	size_t index_count;
+	bool zstd;
+	uint8_t *chunk;
+	size_t chunk_size;
+	size_t chunk_len;
+	size_t chunk_pos;
+	uint32_t chunk_count;
+	uint64_t chunk_ts;
+	off_t chunk_offset;
+	void *zbuf;
+	size_t zbuf_size;
+	uint16_t snaplen;
 };
 
+static void btsnoop_map(struct btsnoop *btsnoop)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(btsnoop->fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+							!st.st_size)
+		return;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, btsnoop->fd, 0);
+	if (map == MAP_FAILED) {
+		posix_fadvise(btsnoop->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		return;
+	}
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	btsnoop->map = map;
+	btsnoop->map_size = st.st_size;
+	btsnoop->map_offset = 0;
+	btsnoop->map_prefetch = 0;
+}
+
+/*
+ * Keep the next window of the capture being read in by the kernel while
+ * the current one is decoded, so the reader rarely blocks on a page fault.
+ */
+static void map_prefetch(struct btsnoop *btsnoop)
+{
+	size_t len;
+
+	/* Restart the window after seeking past it */
+	if (btsnoop->map_prefetch < btsnoop->map_offset)
+		btsnoop->map_prefetch = btsnoop->map_offset -
+				btsnoop->map_offset % BTSNOOP_PREFETCH;
+
+	if (btsnoop->map_offset + BTSNOOP_PREFETCH <= btsnoop->map_prefetch ||
+				btsnoop->map_prefetch >= btsnoop->map_size)
+		return;
+
+	len = btsnoop->map_size - btsnoop->map_prefetch;
+	if (len > BTSNOOP_PREFETCH)
+		len = BTSNOOP_PREFETCH;
+
+	madvise(btsnoop->map + btsnoop->map_prefetch, len, MADV_WILLNEED);
+	btsnoop->map_prefetch += len;
+}
+
+static ssize_t file_read(struct btsnoop *btsnoop, void *buf, size_t len)
+{
+	if (!btsnoop->map)
+		return read(btsnoop->fd, buf, len);
+
+	if (len > btsnoop->map_size - btsnoop->map_offset)
+		len = btsnoop->map_size - btsnoop->map_offset;
+
+	memcpy(buf, btsnoop->map + btsnoop->map_offset, len);
+	btsnoop->map_offset += len;
+
+	map_prefetch(btsnoop);
+
+	return len;
+}
+
+static off_t file_seek(struct btsnoop *btsnoop, off_t offset, int whence)
+{
+	if (!btsnoop->map)
+		return lseek(btsnoop->fd, offset, whence);
+
+	if (whence == SEEK_CUR)
+		offset += btsnoop->map_offset;
+
+	if (offset < 0 || (size_t) offset > btsnoop->map_size)
+		return -1;
+
+	btsnoop->map_offset = offset;
+
+	return offset;
+}
+
+static bool chunk_load(struct btsnoop *btsnoop)
+{
+#ifdef HAVE_ZSTD
+	struct btsnoop_chunk chunk;
+	uint8_t *buf = NULL;
+	const void *src;
+	size_t size, len;
+	off_t offset;
+	ssize_t ret;
+
+	offset = file_seek(btsnoop, 0, SEEK_CUR);
+	if (offset < 0)
+		return false;
+
+	ret = file_read(btsnoop, &chunk, BTSNOOP_CHUNK_SIZE);
+	if (ret == 0)
+		return false;
+
+	if (ret != BTSNOOP_CHUNK_SIZE)
+		goto failed;
+
+	size = be32toh(chunk.size);
+	len = be32toh(chunk.len);
+
+	if (len > BTSNOOP_CHUNK_MAX || size > ZSTD_compressBound(len))
+		goto failed;
+
+	/* Decompress straight from the mapping when there is one */
+	if (btsnoop->map) {
+		if (size > btsnoop->map_size - btsnoop->map_offset)
+			goto failed;
+
+		src = btsnoop->map + btsnoop->map_offset;
+		btsnoop->map_offset += size;
+	} else {
+		buf = malloc(size);
+		if (!buf)
+			goto failed;
+
+		ret = read(btsnoop->fd, buf, size);
+		if (ret < 0 || (size_t) ret != size)
+			goto failed;
+
+		src = buf;
+	}
+
+	ret = ZSTD_decompress(btsnoop->chunk, BTSNOOP_CHUNK_MAX, src, size);
+	if (ZSTD_isError(ret) || (size_t) ret != len)
+		goto failed;
+
+	free(buf);
+
+	btsnoop->chunk_offset = offset;
+	btsnoop->chunk_len = len;
+	btsnoop->chunk_pos = 0;
+
+	return true;
+
+failed:
+	free(buf);
+	btsnoop->aborted = true;
+#endif
+	return false;
+}
+
+static ssize_t btsnoop_read(struct btsnoop *btsnoop, void *buf, size_t len)
+{
+	size_t total = 0;
+
+	if (!btsnoop->zstd)
+		return file_read(btsnoop, buf, len);
+
+	while (total < len) {
+		size_t count;
+
+		if (btsnoop->chunk_pos == btsnoop->chunk_len &&
+						!chunk_load(btsnoop))
+			break;
+
+		count = btsnoop->chunk_len - btsnoop->chunk_pos;
+		if (count > len - total)
+			count = len - total;
+
+		memcpy(buf + total, btsnoop->chunk + btsnoop->chunk_pos,
+								count);
+		btsnoop->chunk_pos += count;
+		total += count;
+	}
+
+	return total;
+}
+
+static off_t btsnoop_seek(struct btsnoop *btsnoop, off_t offset, int whence)
+{
+	off_t chunk_offset;
+	size_t pos;
+
+	if (!btsnoop->zstd)
+		return file_seek(btsnoop, offset, whence);
+
+	if (whence == SEEK_CUR && !offset)
+		return (btsnoop->chunk_offset << BTSNOOP_CHUNK_SHIFT) |
+							btsnoop->chunk_pos;
+
+	if (whence != SEEK_SET || offset < 0)
+		return -1;
+
+	chunk_offset = offset >> BTSNOOP_CHUNK_SHIFT;
+	pos = offset & BTSNOOP_CHUNK_MAX;
+
+	if (file_seek(btsnoop, chunk_offset, SEEK_SET) != chunk_offset)
+		return -1;
+
+	btsnoop->chunk_offset = chunk_offset;
+	btsnoop->chunk_len = 0;
+	btsnoop->chunk_pos = 0;
+
+	if (!pos)
+		return offset;
+
+	if (!chunk_load(btsnoop) || pos > btsnoop->chunk_len)
+		return -1;
+
+	btsnoop->chunk_pos = pos;
+
+	return offset;
+}
+
 struct btsnoop *btsnoop_open(const char *path, unsigned long flags)
 {
 	struct btsnoop *btsnoop;
@@ -88,10 +357,30 @@ struct btsnoop *btsnoop_open(const char *path, unsigned long flags)
 
 	btsnoop->flags = flags;
 
-	len = read(btsnoop->fd, &hdr, BTSNOOP_HDR_SIZE);
+	btsnoop_map(btsnoop);
+
+	len = btsnoop_read(btsnoop, &hdr, BTSNOOP_HDR_SIZE);
 	if (len < 0 || len != BTSNOOP_HDR_SIZE)
 		goto failed;
 
+#ifdef HAVE_ZSTD
+	if (!memcmp(hdr.id, btsnoop_zstd_id, sizeof(btsnoop_zstd_id))) {
+		if (be32toh(hdr.version) != btsnoop_version)
+			goto failed;
+
+		btsnoop->chunk = malloc(BTSNOOP_CHUNK_MAX);
+		if (!btsnoop->chunk)
+			goto failed;
+
+		btsnoop->format = be32toh(hdr.type);
+		btsnoop->index = 0xffff;
+		btsnoop->zstd = true;
+		btsnoop->chunk_offset = BTSNOOP_HDR_SIZE;
+
+		return btsnoop_ref(btsnoop);
+	}
+#endif
+
 	if (!memcmp(hdr.id, btsnoop_id, sizeof(btsnoop_id))) {
 		/* Check for BTSnoop version 1 format */
 		if (be32toh(hdr.version) != btsnoop_version)
@@ -114,26 +403,50 @@ struct btsnoop *btsnoop_open(const char *path, unsigned long flags)
 		btsnoop->pklg_v2 = (hdr.id[1] == 0x01);
 
 		/* Apple Packet Logger format has no header */
-		lseek(btsnoop->fd, 0, SEEK_SET);
+		btsnoop_seek(btsnoop, 0, SEEK_SET);
 	}
 
 	return btsnoop_ref(btsnoop);
 
 failed:
+	if (btsnoop->map)
+		munmap(btsnoop->map, btsnoop->map_size);
+
 	close(btsnoop->fd);
 	free(btsnoop);
 
 	return NULL;
 }
 
-struct btsnoop *btsnoop_create(const char *path, size_t max_size,
-					unsigned int max_count, uint32_t format)
+static bool write_header(struct btsnoop *btsnoop)
 {
-	struct btsnoop *btsnoop;
 	struct btsnoop_hdr hdr;
+	ssize_t written;
+
+	if (btsnoop->zstd)
+		memcpy(hdr.id, btsnoop_zstd_id, sizeof(btsnoop_zstd_id));
+	else
+		memcpy(hdr.id, btsnoop_id, sizeof(btsnoop_id));
+
+	hdr.version = htobe32(btsnoop_version);
+	hdr.type = htobe32(btsnoop->format);
+
+	written = write(btsnoop->fd, &hdr, BTSNOOP_HDR_SIZE);
+	if (written < 0)
+		return false;
+
+	btsnoop->cur_size = BTSNOOP_HDR_SIZE;
+
+	return true;
+}
+
+static struct btsnoop *create_file(const char *path, size_t max_size,
+					unsigned int max_count, uint32_t format,
+					size_t chunk_size)
+{
+	struct btsnoop *btsnoop;
 	const char *real_path;
 	char tmp[PATH_MAX];
-	ssize_t written;
 
 	if (!max_size && max_count)
 		return NULL;
@@ -163,20 +476,51 @@ struct btsnoop *btsnoop_create(const char *path, size_t max_size,
 	btsnoop->max_count = max_count;
 	btsnoop->max_size = max_size;
 
-	memcpy(hdr.id, btsnoop_id, sizeof(btsnoop_id));
-	hdr.version = htobe32(btsnoop_version);
-	hdr.type = htobe32(btsnoop->format);
-
-	written = write(btsnoop->fd, &hdr, BTSNOOP_HDR_SIZE);
-	if (written < 0) {
-		close(btsnoop->fd);
-		free(btsnoop);
-		return NULL;
+#ifdef HAVE_ZSTD
+	if (chunk_size) {
+		btsnoop->zstd = true;
+		btsnoop->chunk_size = chunk_size;
+		btsnoop->chunk = malloc(chunk_size);
+		btsnoop->zbuf_size = ZSTD_compressBound(chunk_size);
+		btsnoop->zbuf = malloc(btsnoop->zbuf_size);
+		if (!btsnoop->chunk || !btsnoop->zbuf)
+			goto failed;
 	}
+#endif
 
-	btsnoop->cur_size = BTSNOOP_HDR_SIZE;
+	if (!write_header(btsnoop))
+		goto failed;
 
 	return btsnoop_ref(btsnoop);
+
+failed:
+	close(btsnoop->fd);
+	free(btsnoop->zbuf);
+	free(btsnoop->chunk);
+	free(btsnoop);
+	return NULL;
+}
+
+struct btsnoop *btsnoop_create(const char *path, size_t max_size,
+					unsigned int max_count, uint32_t format)
+{
+	return create_file(path, max_size, max_count, format, 0);
+}
+
+struct btsnoop *btsnoop_create_zstd(const char *path, size_t max_size,
+					unsigned int max_count, uint32_t format,
+					size_t chunk_size)
+{
+#ifdef HAVE_ZSTD
+	/* Leave room for one maximum sized record */
+	if (chunk_size < BTSNOOP_PKT_SIZE + BTSNOOP_MAX_PACKET_SIZE ||
+					chunk_size > BTSNOOP_CHUNK_MAX)
+		return NULL;
+
+	return create_file(path, max_size, max_count, format, chunk_size);
+#else
+	return NULL;
+#endif
 }
 
 struct btsnoop *btsnoop_ref(struct btsnoop *btsnoop)
@@ -197,9 +541,17 @@ void btsnoop_unref(struct btsnoop *btsnoop)
 	if (__sync_sub_and_fetch(&btsnoop->ref_count, 1))
 		return;
 
+	btsnoop_flush(btsnoop);
+
+	if (btsnoop->map)
+		munmap(btsnoop->map, btsnoop->map_size);
+
 	if (btsnoop->fd >= 0)
 		close(btsnoop->fd);
 
+	free(btsnoop->index_list);
+	free(btsnoop->zbuf);
+	free(btsnoop->chunk);
 	free(btsnoop);
 }
 
@@ -213,9 +565,7 @@ uint32_t btsnoop_get_format(struct btsnoop *btsnoop)
 
 static bool btsnoop_rotate(struct btsnoop *btsnoop)
 {
-	struct btsnoop_hdr hdr;
 	char path[PATH_MAX];
-	ssize_t written;
 
 	close(btsnoop->fd);
 
@@ -234,22 +584,91 @@ static bool btsnoop_rotate(struct btsnoop *btsnoop)
 	if (btsnoop->fd < 0)
 		return false;
 
-	memcpy(hdr.id, btsnoop_id, sizeof(btsnoop_id));
-	hdr.version = htobe32(btsnoop_version);
-	hdr.type = htobe32(btsnoop->format);
+	return write_header(btsnoop);
+}
+
+bool btsnoop_flush(struct btsnoop *btsnoop)
+{
+#ifdef HAVE_ZSTD
+	struct btsnoop_chunk chunk;
+	struct iovec iov[2];
+	size_t size;
+	ssize_t written;
+
+	if (!btsnoop || !btsnoop->chunk_size || !btsnoop->chunk_len)
+		return true;
+
+	size = ZSTD_compress(btsnoop->zbuf, btsnoop->zbuf_size,
+				btsnoop->chunk, btsnoop->chunk_len,
+				ZSTD_CLEVEL_DEFAULT);
+	if (ZSTD_isError(size))
+		return false;
+
+	if (btsnoop->max_size && btsnoop->max_size <=
+			btsnoop->cur_size + size + BTSNOOP_CHUNK_SIZE)
+		if (!btsnoop_rotate(btsnoop))
+			return false;
+
+	chunk.size = htobe32(size);
+	chunk.len = htobe32(btsnoop->chunk_len);
+	chunk.count = htobe32(btsnoop->chunk_count);
+	chunk.ts = htobe64(btsnoop->chunk_ts);
+
+	iov[0].iov_base = &chunk;
+	iov[0].iov_len = BTSNOOP_CHUNK_SIZE;
+	iov[1].iov_base = btsnoop->zbuf;
+	iov[1].iov_len = size;
+
+	written = writev(btsnoop->fd, iov, 2);
+
+	btsnoop->chunk_len = 0;
+	btsnoop->chunk_count = 0;
 
-	written = write(btsnoop->fd, &hdr, BTSNOOP_HDR_SIZE);
 	if (written < 0)
 		return false;
 
-	btsnoop->cur_size = BTSNOOP_HDR_SIZE;
+	btsnoop->cur_size += written;
+#endif
+	return true;
+}
+
+static bool chunk_add(struct btsnoop *btsnoop, const struct btsnoop_pkt *pkt,
+					const void *data, uint16_t size)
+{
+	if (btsnoop->chunk_len + BTSNOOP_PKT_SIZE + size >
+						btsnoop->chunk_size)
+		if (!btsnoop_flush(btsnoop))
+			return false;
+
+	if (!btsnoop->chunk_count)
+		btsnoop->chunk_ts = be64toh(pkt->ts);
+
+	memcpy(btsnoop->chunk + btsnoop->chunk_len, pkt, BTSNOOP_PKT_SIZE);
+	btsnoop->chunk_len += BTSNOOP_PKT_SIZE;
+
+	if (data && size > 0) {
+		memcpy(btsnoop->chunk + btsnoop->chunk_len, data, size);
+		btsnoop->chunk_len += size;
+	}
+
+	btsnoop->chunk_count++;
 
 	return true;
 }
 
-bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
+bool btsnoop_set_snaplen(struct btsnoop *btsnoop, uint16_t snaplen)
+{
+	if (!btsnoop)
+		return false;
+
+	btsnoop->snaplen = snaplen;
+
+	return true;
+}
+
+static bool write_record(struct btsnoop *btsnoop, struct timeval *tv,
 			uint32_t flags, uint32_t drops, const void *data,
-			uint16_t size)
+			uint16_t size, uint16_t len)
 {
 	struct btsnoop_pkt pkt;
 	uint64_t ts;
@@ -258,36 +677,46 @@ bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
 	if (!btsnoop || !tv)
 		return false;
 
-	if (btsnoop->max_size && btsnoop->max_size <=
-			btsnoop->cur_size + size + BTSNOOP_PKT_SIZE)
+	if (!btsnoop->chunk_size && btsnoop->max_size && btsnoop->max_size <=
+			btsnoop->cur_size + len + BTSNOOP_PKT_SIZE)
 		if (!btsnoop_rotate(btsnoop))
 			return false;
 
 	ts = (tv->tv_sec - 946684800ll) * 1000000ll + tv->tv_usec;
 
 	pkt.size  = htobe32(size);
-	pkt.len   = htobe32(size);
+	pkt.len   = htobe32(len);
 	pkt.flags = htobe32(flags);
 	pkt.drops = htobe32(drops);
 	pkt.ts    = htobe64(ts + 0x00E03AB44A676000ll);
 
+	if (btsnoop->chunk_size)
+		return chunk_add(btsnoop, &pkt, data, len);
+
 	written = write(btsnoop->fd, &pkt, BTSNOOP_PKT_SIZE);
 	if (written < 0)
 		return false;
 
 	btsnoop->cur_size += BTSNOOP_PKT_SIZE;
 
-	if (data && size > 0) {
-		written = write(btsnoop->fd, data, size);
+	if (data && len > 0) {
+		written = write(btsnoop->fd, data, len);
 		if (written < 0)
 			return false;
 	}
 
-	btsnoop->cur_size += size;
+	btsnoop->cur_size += len;
 
 	return true;
 }
 
+bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
+			uint32_t flags, uint32_t drops, const void *data,
+			uint16_t size)
+{
+	return write_record(btsnoop, tv, flags, drops, data, size, size);
+}
+
 static uint32_t get_flags_from_opcode(uint16_t opcode)
 {
 	switch (opcode) {
@@ -321,6 +750,7 @@ bool btsnoop_write_hci(struct btsnoop *btsnoop, struct timeval *tv,
 			const void *data, uint16_t size)
 {
 	uint32_t flags;
+	uint16_t len;
 
 	if (!btsnoop)
 		return false;
@@ -346,7 +776,22 @@ bool btsnoop_write_hci(struct btsnoop *btsnoop, struct timeval *tv,
 		return false;
 	}
 
-	return btsnoop_write(btsnoop, tv, flags, drops, data, size);
+	len = size;
+
+	/* Only data packets are truncated, their headers stay intact */
+	switch (opcode) {
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		if (btsnoop->snaplen && len > btsnoop->snaplen)
+			len = btsnoop->snaplen;
+		break;
+	}
+
+	return write_record(btsnoop, tv, flags, drops, data, size, len);
 }
 
 bool btsnoop_write_phy(struct btsnoop *btsnoop, struct timeval *tv,
@@ -378,7 +823,7 @@ static bool pklg_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 	uint64_t ts;
 	ssize_t len;
 
-	len = read(btsnoop->fd, &pkt, PKLG_PKT_SIZE);
+	len = btsnoop_read(btsnoop, &pkt, PKLG_PKT_SIZE);
 	if (len == 0)
 		return false;
 
@@ -453,7 +898,7 @@ static bool pklg_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 		break;
 	}
 
-	len = read(btsnoop->fd, data, toread);
+	len = btsnoop_read(btsnoop, data, toread);
 	if (len < 0) {
 		btsnoop->aborted = true;
 		return false;
@@ -520,7 +965,7 @@ bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 	if (btsnoop->pklg_format)
 		return pklg_read_hci(btsnoop, tv, index, opcode, data, size);
 
-	len = read(btsnoop->fd, &pkt, BTSNOOP_PKT_SIZE);
+	len = btsnoop_read(btsnoop, &pkt, BTSNOOP_PKT_SIZE);
 	if (len == 0)
 		return false;
 
@@ -548,7 +993,7 @@ bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 		break;
 
 	case BTSNOOP_FORMAT_UART:
-		len = read(btsnoop->fd, &pkt_type, 1);
+		len = btsnoop_read(btsnoop, &pkt_type, 1);
 		if (len < 0) {
 			btsnoop->aborted = true;
 			return false;
@@ -569,7 +1014,7 @@ bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 		return false;
 	}
 
-	len = read(btsnoop->fd, data, toread);
+	len = btsnoop_read(btsnoop, data, toread);
 	if (len < 0) {
 		btsnoop->aborted = true;
 		return false;
@@ -585,3 +1030,214 @@ bool btsnoop_read_phy(struct btsnoop *btsnoop, struct timeval *tv,
 {
 	return false;
 }
+
+static bool index_add(struct btsnoop *btsnoop, size_t *size, uint64_t offset,
+						const struct timeval *tv)
+{
+	struct btsnoop_index *entry;
+
+	if (btsnoop->index_count == *size) {
+		size_t new_size = *size ? *size * 2 : 1024;
+
+		entry = reallocarray(btsnoop->index_list, new_size,
+							sizeof(*entry));
+		if (!entry)
+			return false;
+
+		btsnoop->index_list = entry;
+		*size = new_size;
+	}
+
+	entry = &btsnoop->index_list[btsnoop->index_count++];
+	entry->offset = offset;
+	entry->ts = tv->tv_sec * 1000000ull + tv->tv_usec;
+
+	return true;
+}
+
+bool btsnoop_build_index(struct btsnoop *btsnoop)
+{
+	uint8_t buf[BTSNOOP_MAX_PACKET_SIZE];
+	off_t start, offset;
+	size_t size = 0;
+	struct timeval tv;
+	uint16_t index, opcode, len;
+
+	if (!btsnoop || btsnoop->aborted)
+		return false;
+
+	start = btsnoop_seek(btsnoop, 0, SEEK_CUR);
+	if (start < 0)
+		return false;
+
+	free(btsnoop->index_list);
+	btsnoop->index_list = NULL;
+	btsnoop->index_count = 0;
+
+	while (1) {
+		offset = btsnoop_seek(btsnoop, 0, SEEK_CUR);
+
+		if (!btsnoop_read_hci(btsnoop, &tv, &index, &opcode, buf,
+									&len))
+			break;
+
+		if (!index_add(btsnoop, &size, offset, &tv))
+			break;
+	}
+
+	/* A truncated last record is not fatal for the records before it */
+	btsnoop->aborted = false;
+
+	return btsnoop_seek(btsnoop, start, SEEK_SET) == start;
+}
+
+bool btsnoop_load_index(struct btsnoop *btsnoop, const char *path)
+{
+	struct btsnoop_index_hdr hdr;
+	struct btsnoop_index *list;
+	struct stat st;
+	ssize_t len;
+	int fd;
+
+	if (!btsnoop || fstat(btsnoop->fd, &st) < 0)
+		return false;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	len = read(fd, &hdr, sizeof(hdr));
+	if (len != sizeof(hdr) || memcmp(hdr.id, btsnoop_index_id,
+						sizeof(btsnoop_index_id)) ||
+				hdr.file_size != (uint64_t) st.st_size ||
+				hdr.count > SIZE_MAX / sizeof(*list))
+		goto failed;
+
+	list = malloc(hdr.count * sizeof(*list));
+	if (!list)
+		goto failed;
+
+	len = read(fd, list, hdr.count * sizeof(*list));
+	if (len < 0 || (size_t) len != hdr.count * sizeof(*list)) {
+		free(list);
+		goto failed;
+	}
+
+	close(fd);
+
+	free(btsnoop->index_list);
+	btsnoop->index_list = list;
+	btsnoop->index_count = hdr.count;
+
+	return true;
+
+failed:
+	close(fd);
+	return false;
+}
+
+bool btsnoop_save_index(struct btsnoop *btsnoop, const char *path)
+{
+	struct btsnoop_index_hdr hdr;
+	struct stat st;
+	ssize_t len;
+	size_t size;
+	int fd;
+
+	if (!btsnoop || fstat(btsnoop->fd, &st) < 0)
+		return false;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+					S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0)
+		return false;
+
+	memcpy(hdr.id, btsnoop_index_id, sizeof(btsnoop_index_id));
+	hdr.file_size = st.st_size;
+	hdr.count = btsnoop->index_count;
+
+	len = write(fd, &hdr, sizeof(hdr));
+	if (len != sizeof(hdr))
+		goto failed;
+
+	size = btsnoop->index_count * sizeof(*btsnoop->index_list);
+
+	len = write(fd, btsnoop->index_list, size);
+	if (len < 0 || (size_t) len != size)
+		goto failed;
+
+	close(fd);
+
+	return true;
+
+failed:
+	close(fd);
+	unlink(path);
+	return false;
+}
+
+size_t btsnoop_get_count(struct btsnoop *btsnoop)
+{
+	if (!btsnoop)
+		return 0;
+
+	return btsnoop->index_count;
+}
+
+bool btsnoop_get_time(struct btsnoop *btsnoop, size_t frame,
+							struct timeval *tv)
+{
+	uint64_t ts;
+
+	if (!btsnoop || frame >= btsnoop->index_count)
+		return false;
+
+	ts = btsnoop->index_list[frame].ts;
+	tv->tv_sec = ts / 1000000ull;
+	tv->tv_usec = ts % 1000000ull;
+
+	return true;
+}
+
+bool btsnoop_seek_frame(struct btsnoop *btsnoop, size_t frame)
+{
+	off_t offset;
+
+	if (!btsnoop || frame >= btsnoop->index_count)
+		return false;
+
+	offset = btsnoop->index_list[frame].offset;
+
+	if (btsnoop_seek(btsnoop, offset, SEEK_SET) != offset)
+		return false;
+
+	btsnoop->aborted = false;
+
+	return true;
+}
+
+size_t btsnoop_find_time(struct btsnoop *btsnoop, const struct timeval *tv)
+{
+	uint64_t ts;
+	size_t low = 0, high;
+
+	if (!btsnoop)
+		return 0;
+
+	ts = tv->tv_sec * 1000000ull + tv->tv_usec;
+	high = btsnoop->index_count;
+
+	/* Records are not strictly ordered in time, this finds the first
+	 * one of the sequence where time stops being earlier than tv.
+	 */
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (btsnoop->index_list[mid].ts < ts)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
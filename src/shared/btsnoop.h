@@ -92,12 +92,17 @@ struct btsnoop;
 struct btsnoop *btsnoop_open(const char *path, unsigned long flags);
 struct btsnoop *btsnoop_create(const char *path, size_t max_size,
 				unsigned int max_count, uint32_t format);
+struct btsnoop *btsnoop_create_zstd(const char *path, size_t max_size,
+				unsigned int max_count, uint32_t format,
+				size_t chunk_size);
 
 struct btsnoop *btsnoop_ref(struct btsnoop *btsnoop);
 void btsnoop_unref(struct btsnoop *btsnoop);
 
 uint32_t btsnoop_get_format(struct btsnoop *btsnoop);
 
+bool btsnoop_set_snaplen(struct btsnoop *btsnoop, uint16_t snaplen);
+bool btsnoop_flush(struct btsnoop *btsnoop);
 bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv, uint32_t flags,
 			uint32_t drops, const void *data, uint16_t size);
 bool btsnoop_write_hci(struct btsnoop *btsnoop, struct timeval *tv,
@@ -111,3 +116,12 @@ bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 					void *data, uint16_t *size);
 bool btsnoop_read_phy(struct btsnoop *btsnoop, struct timeval *tv,
 			uint16_t *frequency, void *data, uint16_t *size);
+
+bool btsnoop_build_index(struct btsnoop *btsnoop);
+bool btsnoop_load_index(struct btsnoop *btsnoop, const char *path);
+bool btsnoop_save_index(struct btsnoop *btsnoop, const char *path);
+size_t btsnoop_get_count(struct btsnoop *btsnoop);
+bool btsnoop_get_time(struct btsnoop *btsnoop, size_t frame,
+							struct timeval *tv);
+bool btsnoop_seek_frame(struct btsnoop *btsnoop, size_t frame);
+size_t btsnoop_find_time(struct btsnoop *btsnoop, const struct timeval *tv);
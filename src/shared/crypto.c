@@ -14,10 +14,12 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 
 #include "src/shared/util.h"
+#include "src/shared/aes.h"
 #include "src/shared/crypto.h"
 
 #ifndef HAVE_LINUX_IF_ALG_H
@@ -64,6 +66,11 @@ struct af_alg_iv {
 
 #define ATT_SIGN_LEN	12
 
+/*
+ * AES runs in process when the CPU has AES instructions. Otherwise the
+ * AF_ALG sockets are used if available, falling back to the in process
+ * table based implementation.
+ */
 struct bt_crypto {
 	int ref_count;
 	int ecb_aes;
@@ -135,28 +142,29 @@ struct bt_crypto *bt_crypto_new(void)
 
 	singleton = new0(struct bt_crypto, 1);
 
-	singleton->ecb_aes = ecb_aes_setup();
-	if (singleton->ecb_aes < 0) {
-		free(singleton);
-		singleton = NULL;
-		return NULL;
-	}
-
 	singleton->urandom = urandom_setup();
 	if (singleton->urandom < 0) {
-		close(singleton->ecb_aes);
 		free(singleton);
 		singleton = NULL;
 		return NULL;
 	}
 
+	singleton->ecb_aes = -1;
+	singleton->cmac_aes = -1;
+
+	if (bt_aes_hw())
+		return bt_crypto_ref(singleton);
+
+	singleton->ecb_aes = ecb_aes_setup();
 	singleton->cmac_aes = cmac_aes_setup();
-	if (singleton->cmac_aes < 0) {
-		close(singleton->urandom);
-		close(singleton->ecb_aes);
-		free(singleton);
-		singleton = NULL;
-		return NULL;
+	if (singleton->ecb_aes < 0 || singleton->cmac_aes < 0) {
+		if (singleton->ecb_aes >= 0)
+			close(singleton->ecb_aes);
+		if (singleton->cmac_aes >= 0)
+			close(singleton->cmac_aes);
+
+		singleton->ecb_aes = -1;
+		singleton->cmac_aes = -1;
 	}
 
 	return bt_crypto_ref(singleton);
@@ -181,8 +189,12 @@ void bt_crypto_unref(struct bt_crypto *crypto)
 		return;
 
 	close(crypto->urandom);
-	close(crypto->ecb_aes);
-	close(crypto->cmac_aes);
+
+	if (crypto->ecb_aes >= 0)
+		close(crypto->ecb_aes);
+
+	if (crypto->cmac_aes >= 0)
+		close(crypto->cmac_aes);
 
 	free(crypto);
 	singleton = NULL;
@@ -251,6 +263,65 @@ static bool alg_encrypt(int fd, const void *inbuf, size_t inlen,
 	return true;
 }
 
+/* Key and data of both helpers have their most significant octet first */
+static bool crypto_ecb(struct bt_crypto *crypto, const uint8_t key[16],
+				const uint8_t in[16], uint8_t out[16])
+{
+	struct bt_aes aes;
+	int fd;
+
+	if (crypto->ecb_aes < 0) {
+		bt_aes_set_key(&aes, key);
+		bt_aes_encrypt(&aes, in, out);
+		memset(&aes, 0, sizeof(aes));
+		return true;
+	}
+
+	fd = alg_new(crypto->ecb_aes, key, 16);
+	if (fd < 0)
+		return false;
+
+	if (!alg_encrypt(fd, in, 16, out, 16)) {
+		close(fd);
+		return false;
+	}
+
+	close(fd);
+
+	return true;
+}
+
+static bool crypto_cmac(struct bt_crypto *crypto, const uint8_t key[16],
+				const struct iovec *iov, size_t iov_cnt,
+				uint8_t res[16])
+{
+	ssize_t len;
+	int fd;
+
+	if (crypto->cmac_aes < 0)
+		return bt_aes_cmac_iov(key, iov, iov_cnt, res);
+
+	fd = alg_new(crypto->cmac_aes, key, 16);
+	if (fd < 0)
+		return false;
+
+	len = writev(fd, iov, iov_cnt);
+	if (len < 0) {
+		close(fd);
+		return false;
+	}
+
+	len = read(fd, res, 16);
+	if (len < 0) {
+		close(fd);
+		return false;
+	}
+
+	close(fd);
+
+	return true;
+}
+
 static inline void swap_buf(const uint8_t *src, uint8_t *dst, uint16_t len)
 {
 	int i;
@@ -264,12 +335,11 @@ bool bt_crypto_sign_att(struct bt_crypto *crypto, const uint8_t key[16],
 				uint32_t sign_cnt,
 				uint8_t signature[ATT_SIGN_LEN])
 {
-	int fd;
-	int len;
 	uint8_t tmp[16], out[16];
 	uint16_t msg_len = m_len + sizeof(uint32_t);
 	uint8_t msg[msg_len];
 	uint8_t msg_s[msg_len];
+	struct iovec iov;
 
 	if (!crypto)
 		return false;
@@ -283,26 +353,14 @@ bool bt_crypto_sign_att(struct bt_crypto *crypto, const uint8_t key[16],
 	/* The most significant octet of key corresponds to key[0] */
 	swap_buf(key, tmp, 16);
 
-	fd = alg_new(crypto->cmac_aes, tmp, 16);
-	if (fd < 0)
-		return false;
-
 	/* Swap msg before signing */
 	swap_buf(msg, msg_s, msg_len);
 
-	len = send(fd, msg_s, msg_len, 0);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
+	iov.iov_base = msg_s;
+	iov.iov_len = msg_len;
 
-	len = read(fd, out, 16);
-	if (len < 0) {
-		close(fd);
+	if (!crypto_cmac(crypto, tmp, &iov, 1, out))
 		return false;
-	}
-
-	close(fd);
 
 	/*
 	 * As to BT spec. 4.1 Vol[3], Part C, chapter 10.4.1 sign counter should
@@ -358,7 +416,6 @@ bool bt_crypto_e(struct bt_crypto *crypto, const uint8_t key[16],
 			const uint8_t plaintext[16], uint8_t encrypted[16])
 {
 	uint8_t tmp[16], in[16], out[16];
-	int fd;
 
 	if (!crypto)
 		return false;
@@ -366,24 +423,15 @@ bool bt_crypto_e(struct bt_crypto *crypto, const uint8_t key[16],
 	/* The most significant octet of key corresponds to key[0] */
 	swap_buf(key, tmp, 16);
 
-	fd = alg_new(crypto->ecb_aes, tmp, 16);
-	if (fd < 0)
-		return false;
-
-
 	/* Most significant octet of plaintextData corresponds to in[0] */
 	swap_buf(plaintext, in, 16);
 
-	if (!alg_encrypt(fd, in, 16, out, 16)) {
-		close(fd);
+	if (!crypto_ecb(crypto, tmp, in, out))
 		return false;
-	}
 
 	/* Most significant octet of encryptedData corresponds to out[0] */
 	swap_buf(out, encrypted, 16);
 
-	close(fd);
-
 	return true;
 }
 
@@ -442,6 +490,212 @@ bool bt_crypto_ah(struct bt_crypto *crypto, const uint8_t k[16],
 	return true;
 }
 
+/*
+ * Resolving a private address means running ah() under every known IRK,
+ * which for a busy scan is the same address over and over. The resolver
+ * keeps the expanded key schedules so that a lookup is a single batched
+ * pass over all of them, and remembers the outcome for recently seen
+ * addresses, including the ones that did not resolve.
+ */
+#define RESOLVER_BATCH		16
+#define RESOLVER_CACHE_SIZE	128
+
+struct resolver_cache {
+	uint8_t addr[6];
+	bool valid;
+	void *user_data;
+};
+
+struct resolver_irk {
+	uint8_t irk[16];
+	void *user_data;
+};
+
+struct bt_crypto_resolver {
+	struct bt_aes *keys;
+	struct resolver_irk *irks;
+	size_t count;
+	size_t alloc;
+	struct resolver_cache cache[RESOLVER_CACHE_SIZE];
+};
+
+struct bt_crypto_resolver *bt_crypto_resolver_new(void)
+{
+	return new0(struct bt_crypto_resolver, 1);
+}
+
+void bt_crypto_resolver_free(struct bt_crypto_resolver *resolver)
+{
+	if (!resolver)
+		return;
+
+	free(resolver->keys);
+	free(resolver->irks);
+	free(resolver);
+}
+
+static void resolver_flush(struct bt_crypto_resolver *resolver)
+{
+	memset(resolver->cache, 0, sizeof(resolver->cache));
+}
+
+/*
+ * A new key is tried after all existing ones, so it can only change the
+ * outcome for addresses that did not resolve. Removing a key only affects
+ * the addresses that it resolved.
+ */
+static void resolver_invalidate(struct bt_crypto_resolver *resolver,
+							void *user_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < RESOLVER_CACHE_SIZE; i++) {
+		if (resolver->cache[i].user_data == user_data)
+			resolver->cache[i].valid = false;
+	}
+}
+
+bool bt_crypto_resolver_add(struct bt_crypto_resolver *resolver,
+				const uint8_t irk[16], void *user_data)
+{
+	uint8_t tmp[16];
+
+	if (!resolver || !irk)
+		return false;
+
+	if (resolver->count == resolver->alloc) {
+		size_t alloc = resolver->alloc ? resolver->alloc * 2 : 8;
+		struct bt_aes *keys;
+		struct resolver_irk *irks;
+
+		keys = realloc(resolver->keys, alloc * sizeof(*keys));
+		if (!keys)
+			return false;
+
+		resolver->keys = keys;
+
+		irks = realloc(resolver->irks, alloc * sizeof(*irks));
+		if (!irks)
+			return false;
+
+		resolver->irks = irks;
+		resolver->alloc = alloc;
+	}
+
+	swap_buf(irk, tmp, 16);
+	bt_aes_set_key(&resolver->keys[resolver->count], tmp);
+	memcpy(resolver->irks[resolver->count].irk, irk, 16);
+	resolver->irks[resolver->count].user_data = user_data;
+	resolver->count++;
+
+	resolver_invalidate(resolver, NULL);
+
+	return true;
+}
+
+bool bt_crypto_resolver_remove(struct bt_crypto_resolver *resolver,
+						const uint8_t irk[16])
+{
+	void *user_data;
+	size_t i, n;
+
+	if (!resolver || !irk)
+		return false;
+
+	for (i = 0; i < resolver->count; i++) {
+		if (!memcmp(resolver->irks[i].irk, irk, 16))
+			break;
+	}
+
+	if (i == resolver->count)
+		return false;
+
+	user_data = resolver->irks[i].user_data;
+
+	n = --resolver->count - i;
+	memmove(&resolver->keys[i], &resolver->keys[i + 1],
+						n * sizeof(*resolver->keys));
+	memmove(&resolver->irks[i], &resolver->irks[i + 1],
+						n * sizeof(*resolver->irks));
+
+	resolver_invalidate(resolver, user_data);
+
+	return true;
+}
+
+void bt_crypto_resolver_clear(struct bt_crypto_resolver *resolver)
+{
+	if (!resolver)
+		return;
+
+	resolver->count = 0;
+	resolver_flush(resolver);
+}
+
+size_t bt_crypto_resolver_count(struct bt_crypto_resolver *resolver)
+{
+	return resolver ? resolver->count : 0;
+}
+
+static void *resolver_lookup(struct bt_crypto_resolver *resolver,
+							const uint8_t addr[6])
+{
+	uint8_t in[16], out[RESOLVER_BATCH * 16];
+	size_t i, j, n;
+
+	/* r' = padding || prand, most significant octet first */
+	memset(in, 0, 13);
+	in[13] = addr[5];
+	in[14] = addr[4];
+	in[15] = addr[3];
+
+	for (i = 0; i < resolver->count; i += n) {
+		n = resolver->count - i;
+		if (n > RESOLVER_BATCH)
+			n = RESOLVER_BATCH;
+
+		bt_aes_encrypt_keys(&resolver->keys[i], n, in, out);
+
+		/* hash = e(irk, r') mod 2^24 */
+		for (j = 0; j < n; j++) {
+			const uint8_t *e = out + j * 16;
+
+			if (e[15] == addr[0] && e[14] == addr[1] &&
+							e[13] == addr[2])
+				return resolver->irks[i + j].user_data;
+		}
+	}
+
+	return NULL;
+}
+
+void *bt_crypto_resolver_resolve(struct bt_crypto_resolver *resolver,
+							const uint8_t addr[6])
+{
+	struct resolver_cache *entry;
+	unsigned int slot;
+
+	if (!resolver || !addr)
+		return NULL;
+
+	/* Only resolvable private addresses carry a hash */
+	if ((addr[5] & 0xc0) != 0x40)
+		return NULL;
+
+	/* The hash part is already uniformly distributed */
+	slot = get_le16(addr) % RESOLVER_CACHE_SIZE;
+	entry = &resolver->cache[slot];
+
+	if (entry->valid && !memcmp(entry->addr, addr, 6))
+		return entry->user_data;
+
+	memcpy(entry->addr, addr, 6);
+	entry->user_data = resolver_lookup(resolver, addr);
+	entry->valid = true;
+
+	return entry->user_data;
+}
+
 typedef struct {
 	uint64_t a, b;
 } u128;
@@ -589,31 +843,15 @@ bool bt_crypto_s1(struct bt_crypto *crypto, const uint8_t k[16],
 static bool aes_cmac_be(struct bt_crypto *crypto, const uint8_t key[16],
 			const uint8_t *msg, size_t msg_len, uint8_t res[16])
 {
-	ssize_t len;
-	int fd;
+	struct iovec iov;
 
 	if (msg_len > CMAC_MSG_MAX)
 		return false;
 
-	fd = alg_new(crypto->cmac_aes, key, 16);
-	if (fd < 0)
-		return false;
+	iov.iov_base = (void *) msg;
+	iov.iov_len = msg_len;
 
-	len = send(fd, msg, msg_len, 0);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	len = read(fd, res, 16);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	close(fd);
-
-	return true;
+	return crypto_cmac(crypto, key, &iov, 1, res);
 }
 
 static bool aes_cmac(struct bt_crypto *crypto, const uint8_t key[16],
@@ -725,31 +963,11 @@ bool bt_crypto_gatt_hash(struct bt_crypto *crypto, struct iovec *iov,
 				size_t iov_len, uint8_t res[16])
 {
 	const uint8_t key[16] = {};
-	ssize_t len;
-	int fd;
 
 	if (!crypto)
 		return false;
 
-	fd = alg_new(crypto->cmac_aes, key, 16);
-	if (fd < 0)
-		return false;
-
-	len = writev(fd, iov, iov_len);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	len = read(fd, res, 16);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	close(fd);
-
-	return true;
+	return crypto_cmac(crypto, key, iov, iov_len, res);
 }
 
 /*
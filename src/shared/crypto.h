@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/uio.h>
 
 struct bt_crypto;
@@ -26,6 +27,20 @@ bool bt_crypto_e(struct bt_crypto *crypto, const uint8_t key[16],
 			const uint8_t plaintext[16], uint8_t encrypted[16]);
 bool bt_crypto_ah(struct bt_crypto *crypto, const uint8_t k[16],
 					const uint8_t r[3], uint8_t hash[3]);
+
+struct bt_crypto_resolver;
+
+struct bt_crypto_resolver *bt_crypto_resolver_new(void);
+void bt_crypto_resolver_free(struct bt_crypto_resolver *resolver);
+bool bt_crypto_resolver_add(struct bt_crypto_resolver *resolver,
+				const uint8_t irk[16], void *user_data);
+bool bt_crypto_resolver_remove(struct bt_crypto_resolver *resolver,
+						const uint8_t irk[16]);
+void bt_crypto_resolver_clear(struct bt_crypto_resolver *resolver);
+size_t bt_crypto_resolver_count(struct bt_crypto_resolver *resolver);
+void *bt_crypto_resolver_resolve(struct bt_crypto_resolver *resolver,
+							const uint8_t addr[6]);
+
 bool bt_crypto_c1(struct bt_crypto *crypto, const uint8_t k[16],
 			const uint8_t r[16], const uint8_t pres[7],
 			const uint8_t preq[7], uint8_t iat,
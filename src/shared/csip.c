@@ -40,6 +40,7 @@
 #define SIRK "761FAE703ED681F0C50B34155B6434FB"
 #define CSIS_SIZE	0x02
 #define CSIS_LOCK	0x01
+#define CSIS_LOCKED	0x02
 #define CSIS_RANK	0x01
 #define CSIS_PLAINTEXT	0x01
 #define CSIS_ENC	0x02
@@ -76,6 +77,13 @@ struct bt_csip_cb {
 	void *user_data;
 };
 
+struct bt_csip_lock {
+	struct bt_csip *csip;
+	uint8_t value;
+	bt_csip_lock_func_t func;
+	void *user_data;
+};
+
 struct bt_csip_ready {
 	unsigned int id;
 	bt_csip_ready_func_t func;
@@ -553,7 +561,7 @@ static void foreach_csis_char(struct gatt_db_attribute *attr, void *user_data)
 {
 	struct bt_csip *csip = user_data;
 	uint16_t value_handle;
-	bt_uuid_t uuid, uuid_sirk, uuid_size, uuid_rank;
+	bt_uuid_t uuid, uuid_sirk, uuid_size, uuid_lock, uuid_rank;
 	struct bt_csis *csis;
 
 	if (!gatt_db_attribute_get_char_data(attr, NULL, &value_handle,
@@ -562,6 +570,7 @@ static void foreach_csis_char(struct gatt_db_attribute *attr, void *user_data)
 
 	bt_uuid16_create(&uuid_sirk, CS_SIRK);
 	bt_uuid16_create(&uuid_size, CS_SIZE);
+	bt_uuid16_create(&uuid_lock, CS_LOCK);
 	bt_uuid16_create(&uuid_rank, CS_RANK);
 
 	if (!bt_uuid_cmp(&uuid, &uuid_sirk)) {
@@ -592,6 +601,17 @@ static void foreach_csis_char(struct gatt_db_attribute *attr, void *user_data)
 							csip, NULL);
 	}
 
+	if (!bt_uuid_cmp(&uuid, &uuid_lock)) {
+		DBG(csip, "Lock found: handle 0x%04x", value_handle);
+
+		csis = csip_get_csis(csip);
+		if (!csis)
+			return;
+
+		csis->lock = attr;
+		csis->lock_val = CSIS_LOCK;
+	}
+
 	if (!bt_uuid_cmp(&uuid, &uuid_rank)) {
 		DBG(csip, "Rank found: handle 0x%04x", value_handle);
 
@@ -801,6 +821,75 @@ bool bt_csip_get_sirk(struct bt_csip *csip, uint8_t *type,
 	return true;
 }
 
+static void write_lock(bool success, uint8_t att_ecode, void *user_data)
+{
+	struct bt_csip_lock *req = user_data;
+	struct bt_csis *csis = csip_get_csis(req->csip);
+
+	if (!success)
+		DBG(req->csip, "Unable to write Lock: error 0x%02x", att_ecode);
+	else if (csis)
+		csis->lock_val = req->value;
+
+	if (req->func)
+		req->func(req->csip, success, att_ecode, req->user_data);
+}
+
+static void lock_free(void *data)
+{
+	struct bt_csip_lock *req = data;
+
+	bt_csip_unref(req->csip);
+	free(req);
+}
+
+/*
+ * Set Coordinators are expected to take the lock of every member in
+ * ascending Rank order and release it in the opposite order, so that two
+ * coordinators racing for the same set cannot deadlock each other.
+ */
+unsigned int bt_csip_lock(struct bt_csip *csip, bool lock,
+				bt_csip_lock_func_t func, void *user_data)
+{
+	struct bt_csip_lock *req;
+	struct bt_csis *csis;
+	uint16_t value_handle;
+	unsigned int id;
+
+	if (!csip || !csip->client || !csip->rdb)
+		return 0;
+
+	csis = csip->rdb->csis;
+	if (!csis || !csis->lock)
+		return 0;
+
+	if (!gatt_db_attribute_get_char_data(csis->lock, NULL, &value_handle,
+						NULL, NULL, NULL))
+		return 0;
+
+	req = new0(struct bt_csip_lock, 1);
+	req->csip = bt_csip_ref(csip);
+	req->value = lock ? CSIS_LOCKED : CSIS_LOCK;
+	req->func = func;
+	req->user_data = user_data;
+
+	id = bt_gatt_client_write_value(csip->client, value_handle,
+					&req->value, sizeof(req->value),
+					write_lock, req, lock_free);
+	if (!id)
+		lock_free(req);
+
+	return id;
+}
+
+bool bt_csip_is_locked(struct bt_csip *csip)
+{
+	if (!csip || !csip->rdb || !csip->rdb->csis)
+		return false;
+
+	return csip->rdb->csis->lock_val == CSIS_LOCKED;
+}
+
 unsigned int bt_csip_ready_register(struct bt_csip *csip,
 				bt_csip_ready_func_t func, void *user_data,
 				bt_csip_destroy_func_t destroy)
@@ -28,6 +28,8 @@ typedef void (*bt_csip_destroy_func_t)(void *user_data);
 typedef void (*bt_csip_debug_func_t)(const char *str, void *user_data);
 typedef void (*bt_csip_func_t)(struct bt_csip *csip, void *user_data);
 typedef bool (*bt_csip_encrypt_func_t)(struct bt_att *att, uint8_t k[16]);
+typedef void (*bt_csip_lock_func_t)(struct bt_csip *csip, bool success,
+					uint8_t att_ecode, void *user_data);
 typedef bool (*bt_csip_sirk_func_t)(struct bt_csip *csip, uint8_t type,
 				    uint8_t k[16], uint8_t size, uint8_t rank,
 				    void *user_data);
@@ -58,6 +60,10 @@ bool bt_csip_set_sirk(struct bt_csip *csip, bool encrypt,
 bool bt_csip_get_sirk(struct bt_csip *csip, uint8_t *type,
 				uint8_t k[16], uint8_t *size, uint8_t *rank);
 
+unsigned int bt_csip_lock(struct bt_csip *csip, bool lock,
+				bt_csip_lock_func_t func, void *user_data);
+bool bt_csip_is_locked(struct bt_csip *csip);
+
 unsigned int bt_csip_ready_register(struct bt_csip *csip,
 				bt_csip_ready_func_t func, void *user_data,
 				bt_csip_destroy_func_t destroy);
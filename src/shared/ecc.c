@@ -259,6 +259,15 @@ static uint64_t vli_sub(uint64_t *result, const uint64_t *left,
 
 static uint128_t mul_64_64(uint64_t left, uint64_t right)
 {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 m = (unsigned __int128) left * right;
+	uint128_t result;
+
+	result.m_low = m;
+	result.m_high = m >> 64;
+
+	return result;
+#else
 	uint64_t a0 = left & 0xffffffffull;
 	uint64_t a1 = left >> 32;
 	uint64_t b0 = right & 0xffffffffull;
@@ -280,6 +289,7 @@ static uint128_t mul_64_64(uint64_t left, uint64_t right)
 	result.m_high = m3 + (m2 >> 32);
 
 	return result;
+#endif
 }
 
 static uint128_t add_128_128(uint128_t a, uint128_t b)
@@ -770,6 +780,164 @@ static void ecc_point_mult(struct ecc_point *result,
 	vli_set(result->y, ry[0]);
 }
 
+/* Fixed base multiplication for the generator, using a 6-teeth comb over
+ * projective coordinates with the complete addition formulas for a = -3
+ * from https://eprint.iacr.org/2015/1060.pdf (algorithm 4). The same
+ * sequence of doublings, additions and table scans is executed for every
+ * scalar, and the addition also handles the point at infinity and
+ * doubling, so no branch depends on the private key bits.
+ */
+#define COMB_TEETH	6
+#define COMB_SPACING	((ECC_BYTES * 8 + COMB_TEETH - 1) / COMB_TEETH)
+#define COMB_SIZE	(1 << COMB_TEETH)
+
+struct ecc_proj_point {
+	uint64_t x[NUM_ECC_DIGITS];
+	uint64_t y[NUM_ECC_DIGITS];
+	uint64_t z[NUM_ECC_DIGITS];
+};
+
+static struct ecc_proj_point comb_table[COMB_SIZE];
+static bool comb_ready;
+
+static void ecc_point_add_complete(struct ecc_proj_point *r,
+					const struct ecc_proj_point *p,
+					const struct ecc_proj_point *q)
+{
+	uint64_t t0[NUM_ECC_DIGITS], t1[NUM_ECC_DIGITS];
+	uint64_t t2[NUM_ECC_DIGITS], t3[NUM_ECC_DIGITS];
+	uint64_t t4[NUM_ECC_DIGITS];
+	uint64_t x3[NUM_ECC_DIGITS], y3[NUM_ECC_DIGITS];
+	uint64_t z3[NUM_ECC_DIGITS];
+
+	vli_mod_mult_fast(t0, p->x, q->x);
+	vli_mod_mult_fast(t1, p->y, q->y);
+	vli_mod_mult_fast(t2, p->z, q->z);
+	vli_mod_add(t3, p->x, p->y, curve_p);
+	vli_mod_add(t4, q->x, q->y, curve_p);
+	vli_mod_mult_fast(t3, t3, t4);
+	vli_mod_add(t4, t0, t1, curve_p);
+	vli_mod_sub(t3, t3, t4, curve_p);
+	vli_mod_add(t4, p->y, p->z, curve_p);
+	vli_mod_add(x3, q->y, q->z, curve_p);
+	vli_mod_mult_fast(t4, t4, x3);
+	vli_mod_add(x3, t1, t2, curve_p);
+	vli_mod_sub(t4, t4, x3, curve_p);
+	vli_mod_add(x3, p->x, p->z, curve_p);
+	vli_mod_add(y3, q->x, q->z, curve_p);
+	vli_mod_mult_fast(x3, x3, y3);
+	vli_mod_add(y3, t0, t2, curve_p);
+	vli_mod_sub(y3, x3, y3, curve_p);
+	vli_mod_mult_fast(z3, curve_b, t2);
+	vli_mod_sub(x3, y3, z3, curve_p);
+	vli_mod_add(z3, x3, x3, curve_p);
+	vli_mod_add(x3, x3, z3, curve_p);
+	vli_mod_sub(z3, t1, x3, curve_p);
+	vli_mod_add(x3, t1, x3, curve_p);
+	vli_mod_mult_fast(y3, curve_b, y3);
+	vli_mod_add(t1, t2, t2, curve_p);
+	vli_mod_add(t2, t1, t2, curve_p);
+	vli_mod_sub(y3, y3, t2, curve_p);
+	vli_mod_sub(y3, y3, t0, curve_p);
+	vli_mod_add(t1, y3, y3, curve_p);
+	vli_mod_add(y3, t1, y3, curve_p);
+	vli_mod_add(t1, t0, t0, curve_p);
+	vli_mod_add(t0, t1, t0, curve_p);
+	vli_mod_sub(t0, t0, t2, curve_p);
+	vli_mod_mult_fast(t1, t4, y3);
+	vli_mod_mult_fast(t2, t0, y3);
+	vli_mod_mult_fast(y3, x3, z3);
+	vli_mod_add(y3, y3, t2, curve_p);
+	vli_mod_mult_fast(x3, t3, x3);
+	vli_mod_sub(x3, x3, t1, curve_p);
+	vli_mod_mult_fast(z3, t4, z3);
+	vli_mod_mult_fast(t1, t3, t0);
+	vli_mod_add(z3, z3, t1, curve_p);
+
+	vli_set(r->x, x3);
+	vli_set(r->y, y3);
+	vli_set(r->z, z3);
+}
+
+static void comb_setup(void)
+{
+	struct ecc_proj_point base;
+	unsigned int i, j;
+
+	/* Entry 0 is the point at infinity (0 : 1 : 0) */
+	memset(comb_table, 0, sizeof(comb_table));
+	comb_table[0].y[0] = 1;
+
+	vli_set(base.x, curve_g.x);
+	vli_set(base.y, curve_g.y);
+	vli_clear(base.z);
+	base.z[0] = 1;
+
+	/* Entry d holds sum(2^(i * COMB_SPACING) * G) for each bit i of d */
+	for (i = 0; i < COMB_TEETH; i++) {
+		for (j = 1 << i; j < 2u << i; j++)
+			ecc_point_add_complete(&comb_table[j],
+					&comb_table[j - (1 << i)], &base);
+
+		for (j = 0; j < COMB_SPACING; j++)
+			ecc_point_add_complete(&base, &base, &base);
+	}
+
+	comb_ready = true;
+}
+
+static void comb_select(struct ecc_proj_point *r, unsigned int digit)
+{
+	unsigned int i, j;
+
+	memset(r, 0, sizeof(*r));
+
+	for (i = 0; i < COMB_SIZE; i++) {
+		uint64_t mask = -(((uint64_t) (i ^ digit) - 1) >> 63);
+
+		for (j = 0; j < NUM_ECC_DIGITS; j++) {
+			r->x[j] |= comb_table[i].x[j] & mask;
+			r->y[j] |= comb_table[i].y[j] & mask;
+			r->z[j] |= comb_table[i].z[j] & mask;
+		}
+	}
+}
+
+static void ecc_base_mult(struct ecc_point *result, const uint64_t *scalar)
+{
+	struct ecc_proj_point r, t;
+	uint64_t zinv[NUM_ECC_DIGITS];
+	int i;
+	unsigned int j;
+
+	if (!comb_ready)
+		comb_setup();
+
+	comb_select(&r, 0);
+
+	for (i = COMB_SPACING - 1; i >= 0; i--) {
+		unsigned int digit = 0;
+
+		for (j = 0; j < COMB_TEETH; j++) {
+			unsigned int bit = i + j * COMB_SPACING;
+
+			if (bit >= ECC_BYTES * 8)
+				break;
+
+			digit |= ((scalar[bit / 64] >> (bit % 64)) & 1) << j;
+		}
+
+		ecc_point_add_complete(&r, &r, &r);
+		comb_select(&t, digit);
+		ecc_point_add_complete(&r, &r, &t);
+	}
+
+	/* Back to affine, the point at infinity maps to (0, 0) */
+	vli_mod_inv(zinv, r.z, curve_p);
+	vli_mod_mult_fast(result->x, r.x, zinv);
+	vli_mod_mult_fast(result->y, r.y, zinv);
+}
+
 static bool ecc_valid_point(const struct ecc_point *point)
 {
 	uint64_t tmp1[NUM_ECC_DIGITS];
@@ -853,7 +1021,7 @@ bool ecc_make_public_key(const uint8_t private_key[32], uint8_t public_key[64])
 	if (vli_cmp(curve_n, priv) != 1)
 		return false;
 
-	ecc_point_mult(&pk, &curve_g, priv, NULL, vli_num_bits(priv));
+	ecc_base_mult(&pk, priv);
 
 	if (ecc_point_is_zero(&pk))
 		return false;
@@ -883,7 +1051,7 @@ bool ecc_make_key(uint8_t public_key[64], uint8_t private_key[32])
 		if (vli_cmp(curve_n, priv) != 1)
 			continue;
 
-		ecc_point_mult(&pk, &curve_g, priv, NULL, vli_num_bits(priv));
+		ecc_base_mult(&pk, priv);
 	} while (ecc_point_is_zero(&pk));
 
 	ecc_native2bytes(priv, private_key);
@@ -20,6 +20,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
+#include "src/shared/trace.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -53,6 +54,12 @@ struct idle_cb {
 	void *data;
 };
 
+struct credits_cb {
+	bt_gatt_client_credits_callback_t callback;
+	bt_gatt_client_destroy_func_t destroy;
+	void *data;
+};
+
 struct bt_gatt_client {
 	struct bt_att *att;
 	int ref_count;
@@ -63,6 +70,7 @@ struct bt_gatt_client {
 
 	struct queue *ready_cbs;
 	struct queue *idle_cbs;
+	struct queue *credits_cbs;
 
 	bt_gatt_client_service_changed_callback_t svc_chngd_callback;
 	bt_gatt_client_destroy_func_t svc_chngd_destroy;
@@ -72,6 +80,10 @@ struct bt_gatt_client {
 	bt_gatt_client_destroy_func_t debug_destroy;
 	void *debug_data;
 
+	bt_gatt_client_db_lookup_func_t db_lookup_callback;
+	bt_gatt_client_destroy_func_t db_lookup_destroy;
+	void *db_lookup_data;
+
 	struct gatt_db *db;
 	bool in_init;
 	bool ready;
@@ -92,7 +104,7 @@ struct bt_gatt_client {
 	struct queue *notify_list;
 	struct queue *notify_chrcs;
 	int next_reg_id;
-	unsigned int disc_id, nfy_id, nfy_mult_id, ind_id;
+	unsigned int disc_id, nfy_id, nfy_mult_id, ind_id, credits_id;
 
 	/*
 	 * Handles of the GATT Service and the Service Changed characteristic
@@ -113,13 +125,23 @@ struct bt_gatt_client {
 	unsigned int next_request_id;
 
 	struct bt_gatt_request *discovery_req;
+	struct queue *discovery_reqs;	/* Parallel discovery requests */
 	unsigned int mtu_req_id;
+
+	/*
+	 * Reads waiting to be coalesced into a Read Multiple Variable Length
+	 * request and the batches currently in flight.
+	 */
+	struct queue *read_queue;
+	struct queue *read_batches;
 };
 
 struct request {
 	struct bt_gatt_client *client;
 	bool long_write;
 	bool prep_write;
+	bool long_read;
+	bool batched;
 	bool removed;
 	int ref_count;
 	unsigned int id;
@@ -164,6 +186,16 @@ static void idle_destroy(void *data)
 	free(idle);
 }
 
+static void credits_destroy(void *data)
+{
+	struct credits_cb *credits = data;
+
+	if (credits->destroy)
+		credits->destroy(credits->data);
+
+	free(credits);
+}
+
 static bool idle_notify(const void *data, const void *user_data)
 {
 	const struct idle_cb *idle = data;
@@ -379,10 +411,15 @@ struct discovery_op {
 	struct queue *pending_svcs;
 	struct queue *pending_chrcs;
 	struct queue *ext_prop_desc;
+	struct queue *chrc_ranges;
+	struct queue *desc_chrcs;
+	struct queue *done_svcs;
 	struct gatt_db_attribute *cur_svc;
 	struct gatt_db_attribute *hash;
 	uint8_t server_feat;
 	bool success;
+	bool parallel;
+	unsigned int pending_reqs;
 	uint16_t start;
 	uint16_t end;
 	uint16_t last;
@@ -403,6 +440,9 @@ static void discovery_op_free(struct discovery_op *op)
 	queue_destroy(op->pending_svcs, NULL);
 	queue_destroy(op->pending_chrcs, free);
 	queue_destroy(op->ext_prop_desc, NULL);
+	queue_destroy(op->chrc_ranges, free);
+	queue_destroy(op->desc_chrcs, free);
+	queue_destroy(op->done_svcs, NULL);
 	free(op);
 }
 
@@ -433,11 +473,20 @@ static void gatt_log(struct bt_gatt_client *client, const char *format, ...)
 	va_end(ap);
 }
 
+static void discovery_req_cancel(void *data);
+
 static void discovery_op_complete(struct discovery_op *op, bool success,
 								uint8_t err)
 {
 	const struct queue_entry *svc;
 
+	BT_TRACE2(gatt_discovery_complete, op->client, success);
+
+	/* Drop any parallel request still in flight */
+	queue_remove_all(op->client->discovery_reqs, NULL, NULL,
+							discovery_req_cancel);
+	op->pending_reqs = 0;
+
 	op->success = success;
 
 	/* Read database hash if discovery has been successful */
@@ -505,6 +554,9 @@ static struct discovery_op *discovery_op_create(struct bt_gatt_client *client,
 	op->pending_svcs = queue_new();
 	op->pending_chrcs = queue_new();
 	op->ext_prop_desc = queue_new();
+	op->chrc_ranges = queue_new();
+	op->desc_chrcs = queue_new();
+	op->done_svcs = queue_new();
 	op->client = client;
 	op->complete_func = complete_func;
 	op->failure_func = failure_func;
@@ -564,6 +616,96 @@ static void discovery_req_clear(struct bt_gatt_client *client)
 	client->discovery_req = NULL;
 }
 
+/*
+ * With more than one ATT bearer the characteristics of different services and
+ * the descriptors of different characteristics are discovered concurrently,
+ * keeping at most one request in flight per bearer.
+ */
+struct discovery_req {
+	struct discovery_op *op;
+	struct bt_gatt_request *req;
+};
+
+static void discovery_req_free(void *data)
+{
+	struct discovery_req *dreq = data;
+
+	discovery_op_unref(dreq->op);
+	free(dreq);
+}
+
+static void discovery_req_cancel(void *data)
+{
+	struct discovery_req *dreq = data;
+	struct bt_gatt_request *req = dreq->req;
+
+	bt_gatt_request_cancel(req);
+	bt_gatt_request_unref(req);
+}
+
+static void discovery_req_done(struct discovery_req *dreq)
+{
+	struct discovery_op *op = dreq->op;
+
+	queue_remove(op->client->discovery_reqs, dreq);
+	bt_gatt_request_unref(dreq->req);
+	op->pending_reqs--;
+}
+
+static unsigned int discovery_max_reqs(struct discovery_op *op)
+{
+	int chans = bt_att_get_channels(op->client->att);
+
+	return chans > 1 ? chans : 1;
+}
+
+static void discover_chrcs_parallel_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data);
+static void discover_descs_parallel_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data);
+static bool discovery_chrcs_chunk(struct bt_gatt_result *result,
+							void *user_data);
+static bool discovery_descs_chunk(struct bt_gatt_result *result,
+							void *user_data);
+
+static bool discovery_req_send(struct discovery_op *op, bool chrcs,
+						uint16_t start, uint16_t end)
+{
+	struct bt_gatt_client *client = op->client;
+	struct discovery_req *dreq;
+
+	dreq = new0(struct discovery_req, 1);
+	dreq->op = discovery_op_ref(op);
+
+	BT_TRACE4(gatt_discover_parallel, client, chrcs, start, end);
+
+	if (chrcs)
+		dreq->req = bt_gatt_discover_characteristics(client->att,
+					start, end, discover_chrcs_parallel_cb,
+					dreq, discovery_req_free);
+	else
+		dreq->req = bt_gatt_discover_descriptors(client->att,
+					start, end, discover_descs_parallel_cb,
+					dreq, discovery_req_free);
+
+	if (!dreq->req) {
+		discovery_req_free(dreq);
+		return false;
+	}
+
+	/* Parse each response as it arrives instead of copying them */
+	bt_gatt_request_set_chunk_func(dreq->req, chrcs ?
+					discovery_chrcs_chunk :
+					discovery_descs_chunk, op);
+
+	queue_push_tail(client->discovery_reqs, dreq);
+	op->pending_reqs++;
+
+	return true;
+}
+
 static void discover_remove_pending(struct discovery_op *op,
 					struct gatt_db_attribute *attr)
 {
@@ -585,6 +727,51 @@ static void discover_remove_pending(struct discovery_op *op,
 static void discover_chrcs_cb(bool success, uint8_t att_ecode,
 						struct bt_gatt_result *result,
 						void *user_data);
+static void discover_chrcs_next(struct discovery_op *op, uint8_t att_ecode);
+
+struct split_data {
+	struct discovery_op *op;
+	struct handle_range *range;
+};
+
+static void split_chrc_range(void *data, void *user_data)
+{
+	struct gatt_db_attribute *attr = data;
+	struct split_data *split = user_data;
+	struct handle_range *range;
+	uint16_t start, end;
+
+	gatt_db_attribute_get_service_handles(attr, &start, &end);
+
+	start = MAX(start, split->range->start);
+	end = MIN(end, split->range->end);
+	if (start >= end)
+		return;
+
+	range = new0(struct handle_range, 1);
+	range->start = start;
+	range->end = end;
+	queue_push_tail(split->op->chrc_ranges, range);
+}
+
+static bool discover_chrcs_parallel(struct discovery_op *op)
+{
+	struct handle_range *range;
+
+	while (op->pending_reqs < discovery_max_reqs(op) &&
+				(range = queue_pop_head(op->chrc_ranges))) {
+		if (!discovery_req_send(op, true, range->start, range->end)) {
+			DBG(op->client, "Failed to start characteristic "
+								"discovery");
+			free(range);
+			return false;
+		}
+
+		free(range);
+	}
+
+	return true;
+}
 
 static void discover_incl_cb(bool success, uint8_t att_ecode,
 				struct bt_gatt_result *result, void *user_data)
@@ -679,6 +866,24 @@ next:
 		goto failed;
 	}
 
+	if (op->parallel) {
+		struct split_data split = { op, range };
+
+		/* Discover the characteristics of each pending service */
+		queue_foreach(op->pending_svcs, split_chrc_range, &split);
+		free(range);
+
+		if (!discover_chrcs_parallel(op))
+			goto failed;
+
+		if (!op->pending_reqs)
+			discover_chrcs_next(op, att_ecode);
+
+		return;
+	}
+
+	BT_TRACE3(gatt_discover_chrcs, client, range->start, range->end);
+
 	client->discovery_req = bt_gatt_discover_characteristics(client->att,
 							range->start,
 							range->end,
@@ -686,8 +891,11 @@ next:
 							discovery_op_ref(op),
 							discovery_op_unref);
 	free(range);
-	if (client->discovery_req)
+	if (client->discovery_req) {
+		bt_gatt_request_set_chunk_func(client->discovery_req,
+						discovery_chrcs_chunk, op);
 		return;
+	}
 
 	DBG(client, "Failed to start characteristic discovery");
 
@@ -708,18 +916,161 @@ static void discover_descs_cb(bool success, uint8_t att_ecode,
 						struct bt_gatt_result *result,
 						void *user_data);
 
+/*
+ * Inserts the characteristic into the database, returns 1 if its descriptors
+ * need to be discovered, 0 if not and a negative value on error.
+ */
+static int discovery_insert_chrc(struct discovery_op *op,
+						struct chrc *chrc_data)
+{
+	struct bt_gatt_client *client = op->client;
+	struct gatt_db_attribute *attr, *svc;
+	uint16_t desc_start, start, end;
+
+	attr = gatt_db_insert_characteristic(client->db,
+						chrc_data->start_handle,
+						chrc_data->value_handle,
+						&chrc_data->uuid, 0,
+						chrc_data->properties,
+						NULL, NULL, NULL);
+	if (!attr) {
+		DBG(client, "Failed to insert characteristic at 0x%04x",
+						chrc_data->value_handle);
+
+		/* Some devices have been seen reporting orphaned
+		 * characteristics.  In order to favor interoperability
+		 * we skip over characteristics in error
+		 */
+		return 0;
+	}
+
+	if (gatt_db_attribute_get_handle(attr) != chrc_data->value_handle)
+		return -1;
+
+	svc = gatt_db_attribute_get_service(attr);
+	gatt_db_attribute_get_service_handles(svc, &start, &end);
+
+	/*
+	 * Adjust end_handle in case the next chrc is not within the
+	 * same service.
+	 */
+	if (chrc_data->end_handle > end)
+		chrc_data->end_handle = end;
+
+	/*
+	 * check for descriptors presence, before initializing the
+	 * desc_handle and avoid integer overflow during desc_handle
+	 * initialization.
+	 */
+	if (chrc_data->value_handle >= chrc_data->end_handle)
+		return 0;
+
+	desc_start = chrc_data->value_handle + 1;
+
+	if (desc_start == chrc_data->end_handle &&
+		(chrc_data->properties & BT_GATT_CHRC_PROP_NOTIFY ||
+		 chrc_data->properties & BT_GATT_CHRC_PROP_INDICATE)) {
+		bt_uuid_t ccc_uuid;
+
+		/* If there is only one descriptor that must be the CCC
+		 * in case either notify or indicate are supported.
+		 */
+		bt_uuid16_create(&ccc_uuid, GATT_CLIENT_CHARAC_CFG_UUID);
+		attr = gatt_db_insert_descriptor(client->db, desc_start,
+							&ccc_uuid, 0, NULL,
+							NULL, NULL);
+		if (attr)
+			return 0;
+	}
+
+	/* Check if the start range is within characteristic range */
+	if (desc_start > chrc_data->end_handle)
+		return 0;
+
+	return 1;
+}
+
+static bool read_ext_prop_desc(struct discovery_op *op);
+
+static bool discover_descs_parallel(struct discovery_op *op,
+							bool *discovering)
+{
+	struct bt_gatt_client *client = op->client;
+	struct gatt_db_attribute *svc;
+	struct chrc *chrc_data;
+	int err;
+
+	*discovering = false;
+
+	/*
+	 * Insert every characteristic first so that descriptors of different
+	 * characteristics can be discovered at the same time.
+	 */
+	while ((chrc_data = queue_pop_head(op->pending_chrcs))) {
+		svc = gatt_db_get_service(client->db, chrc_data->value_handle);
+		if (svc && !queue_find(op->done_svcs, NULL, svc))
+			queue_push_tail(op->done_svcs, svc);
+
+		err = discovery_insert_chrc(op, chrc_data);
+		if (err > 0) {
+			queue_push_tail(op->desc_chrcs, chrc_data);
+			continue;
+		}
+
+		free(chrc_data);
+
+		if (err < 0)
+			goto failed;
+	}
+
+	while (op->pending_reqs < discovery_max_reqs(op) &&
+			(chrc_data = queue_pop_head(op->desc_chrcs))) {
+		if (!discovery_req_send(op, false, chrc_data->value_handle + 1,
+						chrc_data->end_handle)) {
+			DBG(client, "Failed to start descriptor discovery");
+			free(chrc_data);
+			goto failed;
+		}
+
+		free(chrc_data);
+	}
+
+	if (op->pending_reqs) {
+		*discovering = true;
+		return true;
+	}
+
+	/* Extended properties are read once all descriptors are known */
+	if (read_ext_prop_desc(op)) {
+		*discovering = true;
+		return true;
+	}
+
+	/* Done with all services */
+	while ((svc = queue_pop_head(op->done_svcs)))
+		discover_remove_pending(op, svc);
+
+	return true;
+
+failed:
+	DBG(client, "Failed to discover descriptors");
+
+	return false;
+}
+
 static bool discover_descs(struct discovery_op *op, bool *discovering)
 {
 	struct bt_gatt_client *client = op->client;
-	struct gatt_db_attribute *attr;
 	struct chrc *chrc_data;
-	uint16_t desc_start;
+	int err;
+
+	if (op->parallel)
+		return discover_descs_parallel(op, discovering);
 
 	*discovering = false;
 
 	while ((chrc_data = queue_pop_head(op->pending_chrcs))) {
 		struct gatt_db_attribute *svc;
-		uint16_t start, end;
 
 		/* Adjust current service */
 		svc = gatt_db_get_service(client->db, chrc_data->value_handle);
@@ -734,83 +1085,27 @@ static bool discover_descs(struct discovery_op *op, bool *discovering)
 			op->cur_svc = svc;
 		}
 
-		attr = gatt_db_insert_characteristic(client->db,
-							chrc_data->start_handle,
-							chrc_data->value_handle,
-							&chrc_data->uuid, 0,
-							chrc_data->properties,
-							NULL, NULL, NULL);
-
-		if (!attr) {
-			DBG(client,
-				"Failed to insert characteristic at 0x%04x",
-				chrc_data->value_handle);
-
-			/* Some devices have been seen reporting orphaned
-			 * characteristics.  In order to favor interoperability
-			 * we skip over characteristics in error
-			 */
-			free(chrc_data);
-			continue;
-		}
-
-		if (gatt_db_attribute_get_handle(attr) !=
-							chrc_data->value_handle)
+		err = discovery_insert_chrc(op, chrc_data);
+		if (err < 0)
 			goto failed;
 
-		gatt_db_attribute_get_service_handles(svc, &start, &end);
-
-		/*
-		 * Adjust end_handle in case the next chrc is not within the
-		 * same service.
-		 */
-		if (chrc_data->end_handle > end)
-			chrc_data->end_handle = end;
-
-		/*
-		 * check for descriptors presence, before initializing the
-		 * desc_handle and avoid integer overflow during desc_handle
-		 * initialization.
-		 */
-		if (chrc_data->value_handle >= chrc_data->end_handle) {
+		if (!err) {
 			free(chrc_data);
 			continue;
 		}
 
-		desc_start = chrc_data->value_handle + 1;
-
-		if (desc_start == chrc_data->end_handle &&
-			(chrc_data->properties & BT_GATT_CHRC_PROP_NOTIFY ||
-			 chrc_data->properties & BT_GATT_CHRC_PROP_INDICATE)) {
-			bt_uuid_t ccc_uuid;
-
-			/* If there is only one descriptor that must be the CCC
-			 * in case either notify or indicate are supported.
-			 */
-			bt_uuid16_create(&ccc_uuid,
-					GATT_CLIENT_CHARAC_CFG_UUID);
-			attr = gatt_db_insert_descriptor(client->db, desc_start,
-							&ccc_uuid, 0, NULL,
-							NULL, NULL);
-			if (attr) {
-				free(chrc_data);
-				continue;
-			}
-		}
-
-		/* Check if the start range is within characteristic range */
-		if (desc_start > chrc_data->end_handle) {
-			free(chrc_data);
-			continue;
-		}
+		BT_TRACE1(gatt_discover_descs, client);
 
 		client->discovery_req = bt_gatt_discover_descriptors(
-							client->att, desc_start,
-							chrc_data->end_handle,
-							discover_descs_cb,
-							discovery_op_ref(op),
-							discovery_op_unref);
+						client->att,
+						chrc_data->value_handle + 1,
+						chrc_data->end_handle,
+						discover_descs_cb,
+						discovery_op_ref(op),
+						discovery_op_unref);
 		if (client->discovery_req) {
+			bt_gatt_request_set_chunk_func(client->discovery_req,
+						discovery_descs_chunk, op);
 			*discovering = true;
 			goto done;
 		}
@@ -909,11 +1204,9 @@ done:
 	discovery_op_complete(op, success, att_ecode);
 }
 
-static void discover_descs_cb(bool success, uint8_t att_ecode,
-						struct bt_gatt_result *result,
-						void *user_data)
+static bool discovery_parse_descs(struct discovery_op *op,
+						struct bt_gatt_result *result)
 {
-	struct discovery_op *op = user_data;
 	struct bt_gatt_client *client = op->client;
 	struct bt_gatt_iter iter;
 	struct gatt_db_attribute *attr;
@@ -922,26 +1215,14 @@ static void discover_descs_cb(bool success, uint8_t att_ecode,
 	bt_uuid_t uuid;
 	char uuid_str[MAX_LEN_UUID_STR];
 	unsigned int desc_count;
-	bool discovering;
 	bt_uuid_t ext_prop_uuid;
 
-	discovery_req_clear(client);
-
-	if (!success) {
-		if (att_ecode == BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND) {
-			success = true;
-			goto next;
-		}
-
-		goto done;
-	}
-
 	if (!result || !bt_gatt_iter_init(&iter, result))
-		goto failed;
+		return false;
 
 	desc_count = bt_gatt_result_descriptor_count(result);
 	if (desc_count == 0)
-		goto failed;
+		return false;
 
 	DBG(client, "Descriptors found: %u", desc_count);
 
@@ -966,16 +1247,47 @@ static void discover_descs_cb(bool success, uint8_t att_ecode,
 
 			DBG(client, "Failed to insert descriptor at 0x%04x",
 				handle);
-			goto failed;
+			return false;
 		}
 
 		if (gatt_db_attribute_get_handle(attr) != handle)
-			goto failed;
+			return false;
 
 		if (!bt_uuid_cmp(&ext_prop_uuid, &uuid))
 			queue_push_tail(op->ext_prop_desc, attr);
 	}
 
+	return true;
+}
+
+static bool discovery_descs_chunk(struct bt_gatt_result *result,
+							void *user_data)
+{
+	return discovery_parse_descs(user_data, result);
+}
+
+static void discover_descs_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data)
+{
+	struct discovery_op *op = user_data;
+	struct bt_gatt_client *client = op->client;
+	bool discovering;
+
+	discovery_req_clear(client);
+
+	if (!success) {
+		if (att_ecode == BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND) {
+			success = true;
+			goto next;
+		}
+
+		goto done;
+	}
+
+	if (result && !discovery_parse_descs(op, result))
+		goto failed;
+
 	/* If we got extended prop descriptor, lets read it right away */
 	if (read_ext_prop_desc(op))
 		return;
@@ -996,11 +1308,42 @@ done:
 	discovery_op_complete(op, success, att_ecode);
 }
 
-static void discover_chrcs_cb(bool success, uint8_t att_ecode,
+static void discover_descs_parallel_cb(bool success, uint8_t att_ecode,
 						struct bt_gatt_result *result,
 						void *user_data)
 {
-	struct discovery_op *op = user_data;
+	struct discovery_req *dreq = user_data;
+	struct discovery_op *op = dreq->op;
+	bool discovering;
+
+	discovery_req_done(dreq);
+
+	if (!success) {
+		if (att_ecode != BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND)
+			goto done;
+
+		success = true;
+	} else if (result && !discovery_parse_descs(op, result))
+		goto failed;
+
+	if (!discover_descs(op, &discovering))
+		goto failed;
+
+	if (discovering)
+		return;
+
+	goto done;
+
+failed:
+	success = false;
+
+done:
+	discovery_op_complete(op, success, att_ecode);
+}
+
+static bool discovery_parse_chrcs(struct discovery_op *op,
+						struct bt_gatt_result *result)
+{
 	struct bt_gatt_client *client = op->client;
 	struct bt_gatt_iter iter;
 	struct chrc *chrc_data;
@@ -1010,28 +1353,16 @@ static void discover_chrcs_cb(bool success, uint8_t att_ecode,
 	bt_uuid_t uuid;
 	char uuid_str[MAX_LEN_UUID_STR];
 	unsigned int chrc_count;
-	bool discovering;
-
-	discovery_req_clear(client);
-
-	if (!success) {
-		if (att_ecode == BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND) {
-			success = true;
-			goto next;
-		}
-
-		goto done;
-	}
 
 	if (!result || !bt_gatt_iter_init(&iter, result))
-		goto failed;
+		return false;
 
 	chrc_count = bt_gatt_result_characteristic_count(result);
 
 	DBG(client, "Characteristics found: %u", chrc_count);
 
 	if (chrc_count == 0)
-		goto failed;
+		return false;
 
 	while (bt_gatt_iter_next_characteristic(&iter, &start, &end, &value,
 						&properties, u128.data)) {
@@ -1054,7 +1385,21 @@ static void discover_chrcs_cb(bool success, uint8_t att_ecode,
 		queue_push_tail(op->pending_chrcs, chrc_data);
 	}
 
-next:
+	return true;
+}
+
+static bool discovery_chrcs_chunk(struct bt_gatt_result *result,
+							void *user_data)
+{
+	return discovery_parse_chrcs(user_data, result);
+}
+
+static void discover_chrcs_next(struct discovery_op *op, uint8_t att_ecode)
+{
+	struct bt_gatt_client *client = op->client;
+	bool success = true;
+	bool discovering;
+
 	/*
 	 * Before attempting to process discovered characteristics make sure we
 	 * discovered all missing ranges.
@@ -1066,6 +1411,8 @@ next:
 		if (!range)
 			goto failed;
 
+		BT_TRACE1(gatt_discover_included, client);
+
 		client->discovery_req =
 			bt_gatt_discover_included_services(client->att,
 							range->start,
@@ -1102,6 +1449,61 @@ done:
 	discovery_op_complete(op, success, att_ecode);
 }
 
+static void discover_chrcs_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data)
+{
+	struct discovery_op *op = user_data;
+
+	discovery_req_clear(op->client);
+
+	if (!success) {
+		if (att_ecode == BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND)
+			goto next;
+
+		goto done;
+	}
+
+	if (result && !discovery_parse_chrcs(op, result))
+		goto done;
+
+next:
+	discover_chrcs_next(op, att_ecode);
+	return;
+
+done:
+	discovery_op_complete(op, false, att_ecode);
+}
+
+static void discover_chrcs_parallel_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data)
+{
+	struct discovery_req *dreq = user_data;
+	struct discovery_op *op = dreq->op;
+
+	discovery_req_done(dreq);
+
+	if (!success) {
+		if (att_ecode != BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND)
+			goto failed;
+	} else if (result && !discovery_parse_chrcs(op, result))
+		goto failed;
+
+	if (!discover_chrcs_parallel(op))
+		goto failed;
+
+	/* Wait for the characteristics of every service */
+	if (op->pending_reqs)
+		return;
+
+	discover_chrcs_next(op, att_ecode);
+	return;
+
+failed:
+	discovery_op_complete(op, false, att_ecode);
+}
+
 static bool match_handle_range(const void *data, const void *match_data)
 {
 	const struct handle_range *range = data;
@@ -1274,8 +1676,12 @@ next:
 	if (op->svc_last < 0xffff)
 		remove_discov_range(op, op->svc_last + 1, 0xffff);
 
+	op->parallel = bt_att_get_channels(client->att) > 1;
+
 	range = queue_peek_head(op->discov_ranges);
 
+	BT_TRACE1(gatt_discover_included, client);
+
 	if (range)
 		client->discovery_req = bt_gatt_discover_included_services(
 							client->att,
@@ -1344,6 +1750,8 @@ secondary:
 		goto done;
 
 	/* Discover secondary services */
+	BT_TRACE1(gatt_discover_secondary, client);
+
 	client->discovery_req = bt_gatt_discover_secondary_services(client->att,
 						NULL, op->start, op->end,
 						discover_secondary_cb,
@@ -1413,6 +1821,8 @@ static void discover_all(struct discovery_op *op)
 {
 	struct bt_gatt_client *client = op->client;
 
+	BT_TRACE1(gatt_discover_primary, client);
+
 	client->discovery_req = bt_gatt_discover_all_primary_services(
 							client->att, NULL,
 							discover_primary_cb,
@@ -1512,6 +1922,81 @@ static void get_first_attribute(struct gatt_db_attribute *attrib,
 	*stored = attrib;
 }
 
+static void db_hash_lookup_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data)
+{
+	struct discovery_op *op = user_data;
+	struct bt_gatt_client *client = op->client;
+	struct gatt_db *cache;
+	const uint8_t *value;
+	uint16_t len, handle;
+	struct bt_gatt_iter iter;
+	bt_uuid_t uuid;
+
+	if (!success || !client->db_lookup_callback)
+		goto discover;
+
+	bt_gatt_iter_init(&iter, result);
+	if (!bt_gatt_iter_next_read_by_type(&iter, &handle, &len, &value) ||
+								len != 16)
+		goto discover;
+
+	cache = client->db_lookup_callback(value, client->db_lookup_data);
+	if (!cache || !gatt_db_copy(client->db, cache))
+		goto discover;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_DB_HASH);
+	gatt_db_find_by_type(client->db, 0x0001, 0xffff, &uuid,
+						get_first_attribute, &op->hash);
+	if (!op->hash || gatt_db_attribute_get_handle(op->hash) != handle) {
+		DBG(client, "DB Hash cache mismatch");
+		op->hash = NULL;
+		gatt_db_clear(client->db);
+		goto discover;
+	}
+
+	DBG(client, "DB Hash cached: skipping discovery");
+
+	/* The whole database is known so there is no trailing range to clear */
+	op->last = UINT16_MAX;
+
+	gatt_db_attribute_write(op->hash, 0, value, len, 0, NULL,
+					db_hash_write_value_cb, client);
+
+	queue_remove_all(op->pending_svcs, NULL, NULL, NULL);
+	discovery_op_complete(op, true, 0);
+	return;
+
+discover:
+	discover_all(op);
+}
+
+static bool lookup_db_hash(struct discovery_op *op)
+{
+	struct bt_gatt_client *client = op->client;
+	bt_uuid_t uuid;
+
+	/*
+	 * Only attempt to use a shared database when there is nothing cached
+	 * for this peer, otherwise the stored hash is checked as usual.
+	 */
+	if (!client->db_lookup_callback || !gatt_db_isempty(client->db))
+		return false;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_DB_HASH);
+
+	if (!bt_gatt_read_by_type(client->att, 0x0001, 0xffff, &uuid,
+							db_hash_lookup_cb,
+							discovery_op_ref(op),
+							discovery_op_unref)) {
+		discovery_op_unref(op);
+		return false;
+	}
+
+	return true;
+}
+
 static bool read_db_hash(struct discovery_op *op)
 {
 	struct bt_gatt_client *client = op->client;
@@ -1633,7 +2118,7 @@ static void exchange_mtu_cb(bool success, uint8_t att_ecode, void *user_data)
 discover:
 	read_server_feat(op);
 
-	if (read_db_hash(op)) {
+	if (read_db_hash(op) || lookup_db_hash(op)) {
 		op->success = false;
 		return;
 	}
@@ -1948,6 +2433,8 @@ static void process_service_changed(struct bt_gatt_client *client,
 	if (!op)
 		goto fail;
 
+	BT_TRACE1(gatt_discover_primary, client);
+
 	client->discovery_req = bt_gatt_discover_primary_services(client->att,
 						NULL, start_handle, end_handle,
 						discover_primary_cb,
@@ -2144,11 +2631,13 @@ static bool gatt_client_init(struct bt_gatt_client *client, uint16_t mtu)
 discover:
 	read_server_feat(op);
 
-	if (read_db_hash(op)) {
+	if (read_db_hash(op) || lookup_db_hash(op)) {
 		op->success = false;
 		goto done;
 	}
 
+	BT_TRACE1(gatt_discover_primary, client);
+
 	client->discovery_req = bt_gatt_discover_all_primary_services(
 							client->att, NULL,
 							discover_primary_cb,
@@ -2295,15 +2784,21 @@ static void bt_gatt_client_free(struct bt_gatt_client *client)
 
 	queue_destroy(client->ready_cbs, ready_destroy);
 	queue_destroy(client->idle_cbs, idle_destroy);
+	queue_destroy(client->credits_cbs, credits_destroy);
 
 	if (client->debug_destroy)
 		client->debug_destroy(client->debug_data);
 
+	if (client->db_lookup_destroy)
+		client->db_lookup_destroy(client->db_lookup_data);
+
 	if (client->att) {
 		bt_att_unregister_disconnect(client->att, client->disc_id);
 		bt_att_unregister(client->att, client->nfy_id);
 		bt_att_unregister(client->att, client->nfy_mult_id);
 		bt_att_unregister(client->att, client->ind_id);
+		bt_att_unregister_write_credits(client->att,
+							client->credits_id);
 		bt_att_unref(client->att);
 	}
 
@@ -2313,6 +2808,9 @@ static void bt_gatt_client_free(struct bt_gatt_client *client)
 	queue_destroy(client->svc_chngd_queue, free);
 	queue_destroy(client->long_write_queue, request_unref);
 	queue_destroy(client->pending_requests, request_unref);
+	queue_destroy(client->discovery_reqs, NULL);
+	queue_destroy(client->read_queue, NULL);
+	queue_destroy(client->read_batches, NULL);
 
 	if (client->parent) {
 		queue_remove(client->parent->clones, client);
@@ -2328,6 +2826,7 @@ static void att_disconnect_cb(int err, void *user_data)
 	bool in_init = client->in_init;
 
 	client->disc_id = 0;
+	client->credits_id = 0;
 
 	bt_att_unref(client->att);
 	client->att = NULL;
@@ -2354,11 +2853,15 @@ static struct bt_gatt_client *gatt_client_new(struct gatt_db *db,
 	client->clones = queue_new();
 	client->ready_cbs = queue_new();
 	client->idle_cbs = queue_new();
+	client->credits_cbs = queue_new();
 	client->long_write_queue = queue_new();
 	client->svc_chngd_queue = queue_new();
 	client->notify_list = queue_new();
 	client->notify_chrcs = queue_new();
 	client->pending_requests = queue_new();
+	client->discovery_reqs = queue_new();
+	client->read_queue = queue_new();
+	client->read_batches = queue_new();
 
 	client->nfy_id = bt_att_register(att, BT_ATT_OP_HANDLE_NFY,
 						notify_cb, client, NULL);
@@ -2509,6 +3012,24 @@ bool bt_gatt_client_set_service_changed(struct bt_gatt_client *client,
 	return true;
 }
 
+bool bt_gatt_client_set_db_lookup(struct bt_gatt_client *client,
+				bt_gatt_client_db_lookup_func_t callback,
+				void *user_data,
+				bt_gatt_client_destroy_func_t destroy)
+{
+	if (!client)
+		return false;
+
+	if (client->db_lookup_destroy)
+		client->db_lookup_destroy(client->db_lookup_data);
+
+	client->db_lookup_callback = callback;
+	client->db_lookup_destroy = destroy;
+	client->db_lookup_data = user_data;
+
+	return true;
+}
+
 bool bt_gatt_client_set_debug(struct bt_gatt_client *client,
 					bt_gatt_client_debug_func_t callback,
 					void *user_data,
@@ -2618,10 +3139,25 @@ static bool cancel_prep_write_session(struct bt_gatt_client *client,
 							req, request_unref);
 }
 
+static bool cancel_batched_read(struct request *req)
+{
+	/* Not sent yet, just drop it */
+	if (queue_remove(req->client->read_queue, req)) {
+		request_unref(req);
+		return true;
+	}
+
+	/* Part of a batch in flight, its result is ignored once removed */
+	return true;
+}
+
 static bool cancel_request(struct request *req)
 {
 	req->removed = true;
 
+	if (req->batched)
+		return cancel_batched_read(req);
+
 	if (req->long_write)
 		return cancel_long_write_req(req->client, req);
 
@@ -2646,6 +3182,8 @@ bool bt_gatt_client_cancel(struct bt_gatt_client *client, unsigned int id)
 	return cancel_request(req);
 }
 
+static void read_batch_cancel(void *data);
+
 static void cancel_pending(void *data)
 {
 	cancel_request(data);
@@ -2664,6 +3202,12 @@ bool bt_gatt_client_cancel_all(struct bt_gatt_client *client)
 		client->discovery_req = NULL;
 	}
 
+	queue_remove_all(client->discovery_reqs, NULL, NULL,
+							discovery_req_cancel);
+
+	queue_remove_all(client->read_queue, NULL, NULL, request_unref);
+	queue_remove_all(client->read_batches, NULL, NULL, read_batch_cancel);
+
 	if (client->mtu_req_id)
 		bt_att_cancel(client->att, client->mtu_req_id);
 
@@ -2671,6 +3215,7 @@ bool bt_gatt_client_cancel_all(struct bt_gatt_client *client)
 }
 
 struct read_op {
+	uint16_t value_handle;
 	bt_gatt_client_read_callback_t callback;
 	void *user_data;
 	bt_gatt_client_destroy_func_t destroy;
@@ -2717,6 +3262,8 @@ done:
 		op->callback(success, att_ecode, value, length, op->user_data);
 }
 
+static unsigned int read_batch_add(struct request *req);
+
 unsigned int bt_gatt_client_read_value(struct bt_gatt_client *client,
 					uint16_t value_handle,
 					bt_gatt_client_read_callback_t callback,
@@ -2725,6 +3272,7 @@ unsigned int bt_gatt_client_read_value(struct bt_gatt_client *client,
 {
 	struct request *req;
 	struct read_op *op;
+	unsigned int id;
 	uint8_t pdu[2];
 
 	if (!client)
@@ -2742,9 +3290,15 @@ unsigned int bt_gatt_client_read_value(struct bt_gatt_client *client,
 	op->user_data = user_data;
 	op->destroy = destroy;
 
+	op->value_handle = value_handle;
+
 	req->data = op;
 	req->destroy = destroy_read_op;
 
+	id = read_batch_add(req);
+	if (id)
+		return id;
+
 	put_le16(value_handle, pdu);
 
 	req->att_id = bt_att_send(client->att, BT_ATT_OP_READ_REQ,
@@ -2811,9 +3365,12 @@ static void read_multiple_cb(uint8_t opcode, const void *pdu, uint16_t length,
 		 * current ATT_MTU.
 		 */
 		if (len > length)
-			length = len;
+			len = length;
 
 		op->callback(success, att_ecode, pdu, len, op->user_data);
+
+		pdu += len;
+		length -= len;
 	}
 }
 
@@ -2979,6 +3536,268 @@ done:
 						op->iov.iov_len, op->user_data);
 }
 
+static void read_batch_flush(struct bt_gatt_client *client);
+
+struct read_batch {
+	struct bt_gatt_client *client;
+	struct queue *reqs;
+	unsigned int att_id;
+};
+
+static uint16_t read_req_handle(struct request *req)
+{
+	if (req->long_read) {
+		struct read_long_op *op = req->data;
+
+		return op->value_handle;
+	} else {
+		struct read_op *op = req->data;
+
+		return op->value_handle;
+	}
+}
+
+static void read_req_fail(struct request *req)
+{
+	if (req->long_read) {
+		struct read_long_op *op = req->data;
+
+		if (op->callback)
+			op->callback(false, 0, NULL, 0, op->user_data);
+	} else {
+		struct read_op *op = req->data;
+
+		if (op->callback)
+			op->callback(false, 0, NULL, 0, op->user_data);
+	}
+}
+
+/* Sends the request on its own as if it had never been batched */
+static void read_req_send(struct request *req)
+{
+	struct bt_gatt_client *client = req->client;
+	uint8_t pdu[4];
+	uint16_t len = 2;
+	uint8_t opcode = BT_ATT_OP_READ_REQ;
+
+	req->batched = false;
+
+	put_le16(read_req_handle(req), pdu);
+
+	if (req->long_read) {
+		struct read_long_op *op = req->data;
+
+		if (op->offset) {
+			opcode = BT_ATT_OP_READ_BLOB_REQ;
+			put_le16(op->offset, pdu + 2);
+			len += 2;
+		}
+	}
+
+	req->att_id = bt_att_send(client->att, opcode, pdu, len,
+				req->long_read ? read_long_cb : read_cb,
+				request_ref(req), request_unref);
+	if (req->att_id)
+		return;
+
+	request_unref(req);
+	read_req_fail(req);
+}
+
+static void read_req_value(struct request *req, const uint8_t *value,
+						uint16_t len, uint16_t value_len)
+{
+	if (req->long_read) {
+		struct read_long_op *op = req->data;
+
+		if (len == value_len) {
+			if (op->callback)
+				op->callback(true, 0, value, len,
+							op->user_data);
+			return;
+		}
+
+		/* Read the remaining of the value with Read Blob */
+		if (!append_chunk(op, value, len)) {
+			read_req_fail(req);
+			return;
+		}
+	} else {
+		struct read_op *op = req->data;
+
+		if (len == value_len) {
+			if (op->callback)
+				op->callback(true, 0, value, len,
+							op->user_data);
+			return;
+		}
+	}
+
+	read_req_send(req);
+}
+
+static void read_batch_free(void *data)
+{
+	struct read_batch *batch = data;
+
+	queue_destroy(batch->reqs, request_unref);
+	free(batch);
+}
+
+static void read_batch_cancel(void *data)
+{
+	struct read_batch *batch = data;
+
+	bt_att_cancel(batch->client->att, batch->att_id);
+}
+
+static void read_batch_cb(uint8_t opcode, const void *pdu, uint16_t length,
+								void *user_data)
+{
+	struct read_batch *batch = user_data;
+	struct bt_gatt_client *client = batch->client;
+	struct request *req;
+
+	bt_gatt_client_ref(client);
+
+	queue_remove(client->read_batches, batch);
+
+	if (queue_length(batch->reqs) == 1) {
+		req = queue_pop_head(batch->reqs);
+		req->batched = false;
+
+		if (req->removed)
+			goto unref;
+
+		/* Continue with Read Blob if the value may not be complete */
+		if (req->long_read && opcode == BT_ATT_OP_READ_RSP && pdu &&
+				length >= bt_att_get_mtu(client->att) - 1) {
+			read_req_value(req, pdu, length, UINT16_MAX);
+			goto unref;
+		}
+
+		if (req->long_read)
+			read_long_cb(opcode, pdu, length, req);
+		else
+			read_cb(opcode, pdu, length, req);
+
+unref:
+		request_unref(req);
+		goto done;
+	}
+
+	/*
+	 * In case of error the offending handle is not known so fallback to
+	 * reading each value on its own.
+	 */
+	if (opcode != BT_ATT_OP_READ_MULT_VL_RSP || (!pdu && length))
+		length = 0;
+
+	while ((req = queue_pop_head(batch->reqs))) {
+		uint16_t value_len, len;
+		const uint8_t *value;
+
+		if (req->removed) {
+			request_unref(req);
+			continue;
+		}
+
+		/* Values that did not fit are read separately */
+		if (length < 2) {
+			read_req_send(req);
+			request_unref(req);
+			continue;
+		}
+
+		value_len = get_le16(pdu);
+		pdu += 2;
+		length -= 2;
+
+		value = pdu;
+		len = MIN(value_len, length);
+		pdu += len;
+		length -= len;
+
+		req->batched = false;
+		read_req_value(req, value, len, value_len);
+		request_unref(req);
+	}
+
+done:
+	read_batch_flush(client);
+	bt_gatt_client_unref(client);
+}
+
+static void read_batch_flush(struct bt_gatt_client *client)
+{
+	unsigned int max_reqs, max_handles;
+
+	max_reqs = MAX(bt_att_get_channels(client->att), 1);
+	max_handles = (bt_att_get_mtu(client->att) - 1) / 2;
+
+	while (queue_length(client->read_batches) < max_reqs &&
+				!queue_isempty(client->read_queue)) {
+		uint8_t pdu[BT_ATT_MAX_LE_MTU];
+		struct read_batch *batch;
+		struct request *req;
+		uint16_t len = 0;
+		uint8_t opcode;
+
+		batch = new0(struct read_batch, 1);
+		batch->client = client;
+		batch->reqs = queue_new();
+
+		while (len / 2 < max_handles && len < sizeof(pdu) &&
+				(req = queue_pop_head(client->read_queue))) {
+			put_le16(read_req_handle(req), pdu + len);
+			len += 2;
+			queue_push_tail(batch->reqs, req);
+		}
+
+		opcode = len > 2 ? BT_ATT_OP_READ_MULT_VL_REQ :
+							BT_ATT_OP_READ_REQ;
+
+		batch->att_id = bt_att_send(client->att, opcode, pdu, len,
+						read_batch_cb, batch,
+						read_batch_free);
+		if (!batch->att_id) {
+			while ((req = queue_pop_head(batch->reqs))) {
+				req->batched = false;
+				read_req_fail(req);
+				request_unref(req);
+			}
+
+			read_batch_free(batch);
+			return;
+		}
+
+		queue_push_tail(client->read_batches, batch);
+	}
+}
+
+/*
+ * Reads are coalesced into Read Multiple Variable Length requests when the
+ * peer supports them: a read is sent right away if there is a bearer without
+ * a batch in flight, otherwise it waits for the next batch.
+ */
+static unsigned int read_batch_add(struct request *req)
+{
+	struct bt_gatt_client *client = req->client;
+	unsigned int id = req->id;
+
+	if (!client->ready || !bt_att_get_channels(client->att) ||
+			!(bt_gatt_client_get_features(client) &
+						BT_GATT_CHRC_CLI_FEAT_EATT))
+		return 0;
+
+	req->batched = true;
+	queue_push_tail(client->read_queue, req);
+
+	read_batch_flush(client);
+
+	return id;
+}
+
 unsigned int bt_gatt_client_read_long_value(struct bt_gatt_client *client,
 					uint16_t value_handle, uint16_t offset,
 					bt_gatt_client_read_callback_t callback,
@@ -3011,6 +3830,14 @@ unsigned int bt_gatt_client_read_long_value(struct bt_gatt_client *client,
 
 	req->data = op;
 	req->destroy = destroy_read_long_op;
+	req->long_read = true;
+
+	if (!offset) {
+		unsigned int id = read_batch_add(req);
+
+		if (id)
+			return id;
+	}
 
 	put_le16(value_handle, pdu);
 	pdu_len = sizeof(value_handle);
@@ -3826,6 +4653,73 @@ bool bt_gatt_client_idle_unregister(struct bt_gatt_client *client,
 	return false;
 }
 
+unsigned int bt_gatt_client_get_write_credits(struct bt_gatt_client *client)
+{
+	if (!client)
+		return 0;
+
+	return bt_att_get_write_credits(client->att);
+}
+
+static void credits_notify(void *data, void *user_data)
+{
+	struct credits_cb *credits = data;
+
+	credits->callback(PTR_TO_UINT(user_data), credits->data);
+}
+
+static void att_credits_cb(unsigned int credits, void *user_data)
+{
+	struct bt_gatt_client *client = user_data;
+
+	queue_foreach(client->credits_cbs, credits_notify,
+						UINT_TO_PTR(credits));
+}
+
+unsigned int bt_gatt_client_credits_register(struct bt_gatt_client *client,
+				bt_gatt_client_credits_callback_t callback,
+				void *user_data,
+				bt_gatt_client_destroy_func_t destroy)
+{
+	struct credits_cb *credits;
+
+	if (!client || !callback)
+		return 0;
+
+	if (!client->credits_id) {
+		client->credits_id = bt_att_register_write_credits(client->att,
+							att_credits_cb,
+							client, NULL);
+		if (!client->credits_id)
+			return 0;
+	}
+
+	credits = new0(struct credits_cb, 1);
+	credits->callback = callback;
+	credits->destroy = destroy;
+	credits->data = user_data;
+
+	queue_push_tail(client->credits_cbs, credits);
+
+	return PTR_TO_UINT(credits);
+}
+
+bool bt_gatt_client_credits_unregister(struct bt_gatt_client *client,
+						unsigned int id)
+{
+	struct credits_cb *credits = UINT_TO_PTR(id);
+
+	if (!client || !id)
+		return false;
+
+	if (queue_remove(client->credits_cbs, credits)) {
+		credits_destroy(credits);
+		return true;
+	}
+
+	return false;
+}
+
 bool bt_gatt_client_set_retry(struct bt_gatt_client *client,
 					unsigned int id,
 					bool retry)
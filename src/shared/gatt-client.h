@@ -27,6 +27,8 @@ void bt_gatt_client_unref(struct bt_gatt_client *client);
 
 typedef void (*bt_gatt_client_destroy_func_t)(void *user_data);
 typedef void (*bt_gatt_client_idle_callback_t)(void *user_data);
+typedef void (*bt_gatt_client_credits_callback_t)(unsigned int credits,
+							void *user_data);
 typedef void (*bt_gatt_client_callback_t)(bool success, uint8_t att_ecode,
 							void *user_data);
 typedef void (*bt_gatt_client_debug_func_t)(const char *str, void *user_data);
@@ -44,6 +46,9 @@ typedef void (*bt_gatt_client_register_callback_t)(uint16_t att_ecode,
 typedef void (*bt_gatt_client_service_changed_callback_t)(uint16_t start_handle,
 							uint16_t end_handle,
 							void *user_data);
+typedef struct gatt_db *(*bt_gatt_client_db_lookup_func_t)(
+							const uint8_t *hash,
+							void *user_data);
 
 bool bt_gatt_client_is_ready(struct bt_gatt_client *client);
 unsigned int bt_gatt_client_ready_register(struct bt_gatt_client *client,
@@ -56,6 +61,10 @@ bool bt_gatt_client_set_service_changed(struct bt_gatt_client *client,
 			bt_gatt_client_service_changed_callback_t callback,
 			void *user_data,
 			bt_gatt_client_destroy_func_t destroy);
+bool bt_gatt_client_set_db_lookup(struct bt_gatt_client *client,
+				bt_gatt_client_db_lookup_func_t callback,
+				void *user_data,
+				bt_gatt_client_destroy_func_t destroy);
 bool bt_gatt_client_set_debug(struct bt_gatt_client *client,
 					bt_gatt_client_debug_func_t callback,
 					void *user_data,
@@ -134,6 +143,13 @@ unsigned int bt_gatt_client_idle_register(struct bt_gatt_client *client,
 					bt_gatt_client_destroy_func_t destroy);
 bool bt_gatt_client_idle_unregister(struct bt_gatt_client *client,
 						unsigned int id);
+unsigned int bt_gatt_client_get_write_credits(struct bt_gatt_client *client);
+unsigned int bt_gatt_client_credits_register(struct bt_gatt_client *client,
+				bt_gatt_client_credits_callback_t callback,
+				void *user_data,
+				bt_gatt_client_destroy_func_t destroy);
+bool bt_gatt_client_credits_unregister(struct bt_gatt_client *client,
+						unsigned int id);
 bool bt_gatt_client_set_retry(struct bt_gatt_client *client,
 					unsigned int id,
 					bool retry);
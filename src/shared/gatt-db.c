@@ -61,6 +61,14 @@ struct gatt_db {
 	uint16_t last_handle;
 	struct queue *services;
 
+	/* Active and inactive services sorted by handle */
+	struct gatt_db_service **index;
+	unsigned int index_len;
+	unsigned int index_size;
+
+	/* Attributes grouped by type, hashed by UUID */
+	struct queue *types;
+
 	struct queue *notify_list;
 	unsigned int next_notify_id;
 
@@ -131,8 +139,225 @@ struct gatt_db_service {
 	bool claimed;
 	uint16_t num_handles;
 	struct gatt_db_attribute **attributes;
+	struct iovec hash;		/* Cached Database Hash material */
+};
+
+#define DB_INDEX_MIN_SIZE	16
+
+static uint16_t index_end_handle(const struct gatt_db_service *service)
+{
+	return service->attributes[0]->handle + service->num_handles - 1;
+}
+
+/* Index of the first service ending at or after the given handle */
+static unsigned int db_index_lookup(struct gatt_db *db, uint16_t handle)
+{
+	unsigned int lo = 0, hi = db->index_len;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (index_end_handle(db->index[mid]) < handle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static bool db_index_add(struct gatt_db *db, struct gatt_db_service *service)
+{
+	unsigned int pos;
+
+	if (db->index_len == db->index_size) {
+		struct gatt_db_service **index;
+		unsigned int size;
+
+		size = MAX(db->index_size * 2, DB_INDEX_MIN_SIZE);
+		index = realloc(db->index, size * sizeof(*index));
+		if (!index)
+			return false;
+
+		db->index = index;
+		db->index_size = size;
+	}
+
+	pos = db_index_lookup(db, service->attributes[0]->handle);
+
+	memmove(&db->index[pos + 1], &db->index[pos],
+				(db->index_len - pos) * sizeof(*db->index));
+	db->index[pos] = service;
+	db->index_len++;
+
+	return true;
+}
+
+static void db_index_remove(struct gatt_db *db,
+					struct gatt_db_service *service)
+{
+	unsigned int pos;
+
+	if (!db->index_len)
+		return;
+
+	pos = db_index_lookup(db, service->attributes[0]->handle);
+	if (pos >= db->index_len || db->index[pos] != service)
+		return;
+
+	db->index_len--;
+	memmove(&db->index[pos], &db->index[pos + 1],
+				(db->index_len - pos) * sizeof(*db->index));
+}
+
+static struct gatt_db_service *db_index_find(struct gatt_db *db,
+							uint16_t handle)
+{
+	struct gatt_db_service *service;
+	unsigned int pos;
+
+	pos = db_index_lookup(db, handle);
+	if (pos >= db->index_len)
+		return NULL;
+
+	service = db->index[pos];
+	if (service->attributes[0]->handle > handle)
+		return NULL;
+
+	return service;
+}
+
+struct attribute_type {
+	bt_uuid_t uuid;
+	unsigned int hash;
+	struct gatt_db_attribute **attrs;	/* Sorted by handle */
+	unsigned int len;
+	unsigned int size;
 };
 
+#define TYPE_MIN_SIZE		4
+
+static unsigned int uuid_hash(const bt_uuid_t *uuid)
+{
+	bt_uuid_t uuid128;
+	unsigned int hash = 0;
+	int i;
+
+	/* Hash the 128-bit form so it agrees with bt_uuid_cmp */
+	bt_uuid_to_uuid128(uuid, &uuid128);
+
+	for (i = 0; i < 16; i++)
+		hash = hash * 31 + uuid128.value.u128.data[i];
+
+	return hash;
+}
+
+static unsigned int attribute_type_hash(const void *data)
+{
+	const struct attribute_type *type = data;
+
+	return type->hash;
+}
+
+static bool match_attribute_type(const void *a, const void *b)
+{
+	const struct attribute_type *type = a;
+	const bt_uuid_t *uuid = b;
+
+	return !bt_uuid_cmp(&type->uuid, uuid);
+}
+
+static void attribute_type_free(void *data)
+{
+	struct attribute_type *type = data;
+
+	free(type->attrs);
+	free(type);
+}
+
+static struct attribute_type *find_attribute_type(struct gatt_db *db,
+							const bt_uuid_t *uuid)
+{
+	if (!db->types)
+		return NULL;
+
+	return queue_find_hash(db->types, uuid_hash(uuid),
+						match_attribute_type, uuid);
+}
+
+/* Index of the first attribute of the type at or after the given handle */
+static unsigned int attribute_type_lookup(struct attribute_type *type,
+							uint16_t handle)
+{
+	unsigned int lo = 0, hi = type->len;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (type->attrs[mid]->handle < handle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void attribute_type_add(struct gatt_db *db,
+					struct gatt_db_attribute *attr)
+{
+	struct attribute_type *type;
+	unsigned int pos;
+
+	if (!db->types)
+		return;
+
+	type = find_attribute_type(db, &attr->uuid);
+	if (!type) {
+		type = new0(struct attribute_type, 1);
+		type->uuid = attr->uuid;
+		type->hash = uuid_hash(&attr->uuid);
+		queue_push_tail(db->types, type);
+	}
+
+	if (type->len == type->size) {
+		type->size = MAX(type->size * 2, TYPE_MIN_SIZE);
+		type->attrs = realloc(type->attrs,
+					type->size * sizeof(*type->attrs));
+	}
+
+	pos = attribute_type_lookup(type, attr->handle);
+
+	memmove(&type->attrs[pos + 1], &type->attrs[pos],
+				(type->len - pos) * sizeof(*type->attrs));
+	type->attrs[pos] = attr;
+	type->len++;
+}
+
+static void attribute_type_remove(struct gatt_db *db,
+					struct gatt_db_attribute *attr)
+{
+	struct attribute_type *type;
+	unsigned int pos;
+
+	type = find_attribute_type(db, &attr->uuid);
+	if (!type)
+		return;
+
+	pos = attribute_type_lookup(type, attr->handle);
+	if (pos >= type->len || type->attrs[pos] != attr)
+		return;
+
+	type->len--;
+	memmove(&type->attrs[pos], &type->attrs[pos + 1],
+				(type->len - pos) * sizeof(*type->attrs));
+
+	if (!type->len) {
+		queue_remove(db->types, type);
+		attribute_type_free(type);
+	}
+}
+
 static void set_attribute_data(struct gatt_db_attribute *attribute,
 						gatt_db_read_t read_func,
 						gatt_db_write_t write_func,
@@ -196,6 +421,9 @@ static void attribute_destroy(struct gatt_db_attribute *attribute)
 	if (!attribute)
 		return;
 
+	if (attribute->service && attribute->service->db)
+		attribute_type_remove(attribute->service->db, attribute);
+
 	queue_destroy(attribute->pending_reads, pending_read_free);
 	queue_destroy(attribute->pending_writes, pending_write_free);
 	queue_destroy(attribute->notify_list, attribute_notify_destroy);
@@ -226,9 +454,14 @@ static struct gatt_db_attribute *new_attribute(struct gatt_db_service *service,
 		memcpy(attribute->value, val, len);
 	}
 
-	attribute->pending_reads = queue_new();
-	attribute->pending_writes = queue_new();
-	attribute->notify_list = queue_new();
+	/* Per attribute queues are only allocated once they are needed */
+	if (service->db)
+		attribute_type_add(service->db, attribute);
+
+	/* Service contents changed, regenerate its hash material */
+	free(service->hash.iov_base);
+	service->hash.iov_base = NULL;
+	service->hash.iov_len = 0;
 
 	return attribute;
 
@@ -254,6 +487,8 @@ struct gatt_db *gatt_db_new(void)
 	db = new0(struct gatt_db, 1);
 	db->crypto = bt_crypto_new();
 	db->services = queue_new();
+	db->types = queue_new();
+	queue_set_hash(db->types, attribute_type_hash);
 	db->notify_list = queue_new();
 	db->last_handle = 0x0000;
 
@@ -316,6 +551,7 @@ static void service_clone(void *data, void *user_data)
 	}
 
 	queue_push_tail(db->services, clone);
+	db_index_add(db, clone);
 }
 
 struct gatt_db *gatt_db_clone(struct gatt_db *db)
@@ -370,12 +606,12 @@ static void handle_notify(void *data, void *user_data)
 
 struct hash_data {
 	struct iovec *iov;
-	uint16_t i;
+	unsigned int i;
 };
 
 static void gen_hash_m(struct gatt_db_attribute *attr, void *user_data)
 {
-	struct hash_data *hash = user_data;
+	struct iovec *hash = user_data;
 	uint8_t *data;
 	size_t len;
 
@@ -390,61 +626,64 @@ static void gen_hash_m(struct gatt_db_attribute *attr, void *user_data)
 	case GATT_SND_SVC_UUID:
 	case GATT_INCLUDE_UUID:
 	case GATT_CHARAC_UUID:
-		/* Allocate space for handle + type + value */
+		/* Space for handle + type + value */
 		len = 2 + 2 + attr->value_len;
-		data = malloc(2 + 2 + attr->value_len);
-		put_le16(attr->handle, data);
-		bt_uuid_to_le(&attr->uuid, data + 2);
-		memcpy(data + 4, attr->value, attr->value_len);
 		break;
 	case GATT_CHARAC_USER_DESC_UUID:
 	case GATT_CLIENT_CHARAC_CFG_UUID:
 	case GATT_SERVER_CHARAC_CFG_UUID:
 	case GATT_CHARAC_FMT_UUID:
 	case GATT_CHARAC_AGREG_FMT_UUID:
-		/* Allocate space for handle + type  */
+		/* Space for handle + type  */
 		len = 2 + 2;
-		data = malloc(2 + 2 + attr->value_len);
-		put_le16(attr->handle, data);
-		bt_uuid_to_le(&attr->uuid, data + 2);
 		break;
 	default:
 		return;
 	}
 
-	hash->iov[hash->i].iov_base = data;
-	hash->iov[hash->i].iov_len = len;
+	data = realloc(hash->iov_base, hash->iov_len + len);
+	if (!data)
+		return;
+
+	hash->iov_base = data;
+	data += hash->iov_len;
+	hash->iov_len += len;
 
-	hash->i++;
+	put_le16(attr->handle, data);
+	bt_uuid_to_le(&attr->uuid, data + 2);
 
-	return;
+	if (len > 4)
+		memcpy(data + 4, attr->value, attr->value_len);
 }
 
 static void service_gen_hash_m(struct gatt_db_attribute *attr, void *user_data)
 {
-	gatt_db_service_foreach(attr, NULL, gen_hash_m, user_data);
+	struct hash_data *hash = user_data;
+	struct gatt_db_service *service = attr->service;
+
+	/* Only serialize services that changed since the last update */
+	if (!service->hash.iov_base)
+		gatt_db_service_foreach(attr, NULL, gen_hash_m,
+							&service->hash);
+
+	hash->iov[hash->i++] = service->hash;
 }
 
 static bool db_hash_update(void *user_data)
 {
 	struct gatt_db *db = user_data;
 	struct hash_data hash;
-	uint16_t i;
 
 	db->hash_id = 0;
 
 	if (gatt_db_isempty(db))
 		return false;
 
-	hash.iov = new0(struct iovec, db->last_handle + 1);
+	hash.iov = new0(struct iovec, queue_length(db->services));
 	hash.i = 0;
 
 	gatt_db_foreach_service(db, NULL, service_gen_hash_m, &hash);
-	bt_crypto_gatt_hash(db->crypto, hash.iov, db->last_handle + 1,
-				db->hash);
-
-	for (i = 0; i < hash.i; i++)
-		free(hash.iov[i].iov_base);
+	bt_crypto_gatt_hash(db->crypto, hash.iov, hash.i, db->hash);
 
 	free(hash.iov);
 
@@ -493,25 +732,53 @@ static void notify_service_changed(struct gatt_db *db,
 
 	queue_foreach(db->notify_list, handle_notify, &data);
 
-	/* Tigger hash update */
-	if (!db->hash_id && db->crypto)
+	/* Trigger hash update, postponing it while services keep changing
+	 * so registering many services at once only rehashes once.
+	 * gatt_db_get_hash still forces the update if it is pending.
+	 */
+	if (db->crypto) {
+		timeout_remove(db->hash_id);
 		db->hash_id = timeout_add(HASH_UPDATE_TIMEOUT, db_hash_update,
 								db, NULL);
+	}
 
 	gatt_db_unref(db);
 }
 
+static void notify_service_added(void *data, void *user_data)
+{
+	struct gatt_db_service *service = data;
+
+	if (service->active)
+		notify_service_changed(user_data, service, true);
+}
+
+bool gatt_db_copy(struct gatt_db *db, struct gatt_db *src)
+{
+	if (!db || !src || db == src || !gatt_db_isempty(db))
+		return false;
+
+	queue_foreach(src->services, service_clone, db);
+	queue_foreach(db->services, notify_service_added, db);
+
+	return true;
+}
+
 static void gatt_db_service_destroy(void *data)
 {
 	struct gatt_db_service *service = data;
 	int i;
 
+	if (service->db && service->attributes[0])
+		db_index_remove(service->db, service);
+
 	if (service->active)
 		notify_service_changed(service->db, service, false);
 
 	for (i = 0; i < service->num_handles; i++)
 		attribute_destroy(service->attributes[i]);
 
+	free(service->hash.iov_base);
 	free(service->attributes);
 	free(service);
 }
@@ -533,7 +800,11 @@ static void gatt_db_destroy(struct gatt_db *db)
 	if (db->hash_id)
 		timeout_remove(db->hash_id);
 
+	db->index_len = 0;
+	queue_destroy(db->types, attribute_type_free);
+	db->types = NULL;
 	queue_destroy(db->services, gatt_db_service_destroy);
+	free(db->index);
 	free(db->ccc);
 	free(db);
 }
@@ -735,31 +1006,23 @@ static struct gatt_db_service *find_insert_loc(struct gatt_db *db,
 						uint16_t start, uint16_t end,
 						struct gatt_db_service **after)
 {
-	const struct queue_entry *services_entry;
 	struct gatt_db_service *service;
-	uint16_t cur_start, cur_end;
+	unsigned int pos;
 
 	*after = NULL;
 
-	services_entry = queue_get_entries(db->services);
-
-	while (services_entry) {
-		service = services_entry->data;
-
-		gatt_db_service_get_handles(service, &cur_start, &cur_end);
+	pos = db_index_lookup(db, start);
+	if (pos)
+		*after = db->index[pos - 1];
 
-		if (start >= cur_start && start <= cur_end)
-			return service;
-
-		if (end >= cur_start && end <= cur_end)
-			return service;
+	if (pos >= db->index_len)
+		return NULL;
 
-		if (end < cur_start)
-			return NULL;
+	service = db->index[pos];
 
-		*after = service;
-		services_entry = services_entry->next;
-	}
+	/* Overlaps with the first service not ending before start */
+	if (service->attributes[0]->handle <= end)
+		return service;
 
 	return NULL;
 }
@@ -814,22 +1077,29 @@ struct gatt_db_attribute *gatt_db_insert_service(struct gatt_db *db,
 	if (!service)
 		return NULL;
 
+	service->attributes[0]->handle = handle;
+	service->num_handles = num_handles;
+
+	if (!db_index_add(db, service))
+		goto fail;
+
 	if (after) {
 		if (!queue_push_after(db->services, after, service))
-			goto fail;
+			goto unindex;
 	} else if (!queue_push_head(db->services, service)) {
-		goto fail;
+		goto unindex;
 	}
 
 	service->db = db;
-	service->attributes[0]->handle = handle;
-	service->num_handles = num_handles;
+	attribute_type_add(db, service->attributes[0]);
 
 	/* Fast-forward last_handle if the new service was added to the end */
 	db->last_handle = MAX(handle + num_handles - 1, db->last_handle);
 
 	return service->attributes[0];
 
+unindex:
+	db_index_remove(db, service);
 fail:
 	gatt_db_service_destroy(service);
 	return NULL;
@@ -993,7 +1263,7 @@ service_insert_characteristic(struct gatt_db_service *service,
 
 	i = service_get_attribute_index(service, &value_handle, 0);
 	if (!i) {
-		free(*chrc);
+		attribute_destroy(*chrc);
 		*chrc = NULL;
 		return NULL;
 	}
@@ -1001,7 +1271,7 @@ service_insert_characteristic(struct gatt_db_service *service,
 	service->attributes[i] = new_attribute(service, value_handle, uuid,
 						NULL, 0);
 	if (!service->attributes[i]) {
-		free(*chrc);
+		attribute_destroy(*chrc);
 		*chrc = NULL;
 		return NULL;
 	}
@@ -1543,7 +1813,12 @@ static void foreach_in_range(void *data, void *user_data)
 		return foreach_service_in_range(data, user_data);
 	}
 
-	for (i = 0; i < service->num_handles; i++) {
+	/* Attributes are stored at their offset from the service handle */
+	i = 0;
+	if (foreach_data->start > svc_start)
+		i = foreach_data->start - svc_start;
+
+	for (; i < service->num_handles; i++) {
 		struct gatt_db_attribute *attribute = service->attributes[i];
 
 		if (!attribute)
@@ -1563,6 +1838,68 @@ static void foreach_in_range(void *data, void *user_data)
 	}
 }
 
+static void foreach_type_in_range(struct gatt_db *db,
+					struct foreach_data *foreach_data)
+{
+	unsigned int handle = foreach_data->start;
+
+	/*
+	 * Look the type up again on every step since callbacks may add or
+	 * remove attributes.
+	 */
+	while (handle <= foreach_data->end) {
+		struct attribute_type *type;
+		struct gatt_db_attribute *attribute;
+		unsigned int pos;
+
+		type = find_attribute_type(db, foreach_data->uuid);
+		if (!type)
+			return;
+
+		pos = attribute_type_lookup(type, handle);
+		if (pos >= type->len)
+			return;
+
+		attribute = type->attrs[pos];
+		if (attribute->handle > foreach_data->end)
+			return;
+
+		handle = attribute->handle + 1;
+
+		if (!attribute->service->active)
+			continue;
+
+		foreach_data->func(attribute, foreach_data->user_data);
+	}
+}
+
+static void foreach_index_in_range(struct gatt_db *db,
+					struct foreach_data *foreach_data)
+{
+	unsigned int start = foreach_data->start;
+
+	/*
+	 * Look the next service up by handle on every step since callbacks
+	 * may add or remove services.
+	 */
+	while (start <= foreach_data->end) {
+		struct gatt_db_service *service;
+		unsigned int pos;
+
+		pos = db_index_lookup(db, start);
+		if (pos >= db->index_len)
+			return;
+
+		service = db->index[pos];
+		if (service->attributes[0]->handle > foreach_data->end)
+			return;
+
+		start = index_end_handle(service) + 1;
+
+		foreach_in_range(service, foreach_data);
+	}
+}
+
 void gatt_db_foreach_service_in_range(struct gatt_db *db,
 						const bt_uuid_t *uuid,
 						gatt_db_attribute_cb_t func,
@@ -1582,7 +1919,7 @@ void gatt_db_foreach_service_in_range(struct gatt_db *db,
 	data.end = end_handle;
 	data.attr = false;
 
-	queue_foreach(db->services, foreach_in_range, &data);
+	foreach_index_in_range(db, &data);
 }
 
 void gatt_db_foreach_in_range(struct gatt_db *db, const bt_uuid_t *uuid,
@@ -1603,7 +1940,10 @@ void gatt_db_foreach_in_range(struct gatt_db *db, const bt_uuid_t *uuid,
 	data.end = end_handle;
 	data.attr = true;
 
-	queue_foreach(db->services, foreach_in_range, &data);
+	if (uuid)
+		foreach_type_in_range(db, &data);
+	else
+		foreach_index_in_range(db, &data);
 }
 
 void gatt_db_service_foreach(struct gatt_db_attribute *attrib,
@@ -1727,17 +2067,6 @@ void gatt_db_service_foreach_incl(struct gatt_db_attribute *attrib,
 								user_data);
 }
 
-static bool find_service_for_handle(const void *data, const void *user_data)
-{
-	const struct gatt_db_service *service = data;
-	uint16_t handle = PTR_TO_UINT(user_data);
-	uint16_t start, end;
-
-	gatt_db_service_get_handles(service, &start, &end);
-
-	return (start <= handle) && (handle <= end);
-}
-
 struct gatt_db_attribute *gatt_db_get_service(struct gatt_db *db,
 							uint16_t handle)
 {
@@ -1746,8 +2075,7 @@ struct gatt_db_attribute *gatt_db_get_service(struct gatt_db *db,
 	if (!db || !handle)
 		return NULL;
 
-	service = queue_find(db->services, find_service_for_handle,
-						UINT_TO_PTR(handle));
+	service = db_index_find(db, handle);
 	if (!service)
 		return NULL;
 
@@ -1767,13 +2095,12 @@ struct gatt_db_attribute *gatt_db_get_attribute(struct gatt_db *db,
 
 	service = attrib->service;
 
-	for (i = 0; i < service->num_handles; i++) {
-		if (!service->attributes[i])
-			continue;
+	i = handle - attrib->handle;
+	if (i >= service->num_handles)
+		return NULL;
 
-		if (service->attributes[i]->handle == handle)
-			return service->attributes[i];
-	}
+	if (service->attributes[i] && service->attributes[i]->handle == handle)
+		return service->attributes[i];
 
 	return NULL;
 }
@@ -2150,6 +2477,9 @@ bool gatt_db_attribute_read(struct gatt_db_attribute *attrib, uint16_t offset,
 		p->func = func;
 		p->user_data = user_data;
 
+		if (!attrib->pending_reads)
+			attrib->pending_reads = queue_new();
+
 		queue_push_tail(attrib->pending_reads, p);
 
 		attrib->read_func(attrib, p->id, offset, opcode, att,
@@ -2244,6 +2574,9 @@ bool gatt_db_attribute_write(struct gatt_db_attribute *attrib, uint16_t offset,
 		p->func = func;
 		p->user_data = user_data;
 
+		if (!attrib->pending_writes)
+			attrib->pending_writes = queue_new();
+
 		queue_push_tail(attrib->pending_writes, p);
 
 		attrib->write_func(attrib, p->id, offset, value, len, opcode,
@@ -2399,6 +2732,9 @@ unsigned int gatt_db_attribute_register(struct gatt_db_attribute *attrib,
 
 	notify->id = attrib->next_notify_id++;
 
+	if (!attrib->notify_list)
+		attrib->notify_list = queue_new();
+
 	if (!queue_push_tail(attrib->notify_list, notify)) {
 		free(notify);
 		return 0;
@@ -13,6 +13,7 @@ struct gatt_db_attribute;
 
 struct gatt_db *gatt_db_new(void);
 struct gatt_db *gatt_db_clone(struct gatt_db *db);
+bool gatt_db_copy(struct gatt_db *db, struct gatt_db *src);
 
 struct gatt_db *gatt_db_ref(struct gatt_db *db);
 void gatt_db_unref(struct gatt_db *db);
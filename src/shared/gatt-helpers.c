@@ -29,6 +29,7 @@ struct bt_gatt_result {
 	void *pdu;
 	uint16_t pdu_len;
 	uint16_t data_len;
+	uint16_t next_start;
 
 	void *op;  /* Discovery operation data */
 
@@ -203,6 +204,12 @@ struct bt_gatt_request {
 	uint16_t service_type;
 	struct bt_gatt_result *result_head;
 	struct bt_gatt_result *result_tail;
+	bool included;
+	bt_gatt_chunk_func_t chunk_func;
+	void *chunk_data;
+	unsigned int chunks;
+	uint8_t held[21];
+	uint16_t held_len;
 	bt_gatt_request_callback_t callback;
 	void *user_data;
 	bt_gatt_destroy_func_t destroy;
@@ -229,6 +236,69 @@ static struct bt_gatt_result *result_append(uint8_t opcode, const void *pdu,
 	return result;
 }
 
+static bool result_add(struct bt_gatt_request *op, uint8_t opcode,
+					const void *pdu, uint16_t pdu_len,
+					uint16_t data_len, bool last)
+{
+	struct bt_gatt_result prev, cur, *head = NULL;
+	uint8_t held[sizeof(op->held)];
+	bool hold;
+
+	if (!op->chunk_func)
+		return result_append(opcode, pdu, pdu_len, data_len,
+								op) != NULL;
+
+	memset(&cur, 0, sizeof(cur));
+	cur.opcode = opcode;
+	cur.pdu = (void *) pdu;
+	cur.pdu_len = pdu_len;
+	cur.data_len = data_len;
+	cur.op = op;
+
+	/*
+	 * The end handle of a characteristic is only known once the next
+	 * one has been received, so hold back the last one of each response.
+	 */
+	hold = !last && opcode == BT_ATT_OP_READ_BY_TYPE_RSP &&
+					data_len <= sizeof(held);
+	if (hold) {
+		cur.pdu_len -= data_len;
+		memcpy(held, pdu + cur.pdu_len, data_len);
+		cur.next_start = get_le16(held);
+	}
+
+	if (cur.pdu_len)
+		head = &cur;
+
+	if (op->held_len) {
+		memset(&prev, 0, sizeof(prev));
+		prev.opcode = opcode;
+		prev.pdu = op->held;
+		prev.pdu_len = op->held_len;
+		prev.data_len = op->held_len;
+		prev.op = op;
+		prev.next = head;
+		prev.next_start = cur.next_start;
+		head = &prev;
+	}
+
+	op->held_len = 0;
+
+	if (head) {
+		op->chunks++;
+
+		if (!op->chunk_func(head, op->chunk_data))
+			return false;
+	}
+
+	if (hold) {
+		memcpy(op->held, held, data_len);
+		op->held_len = data_len;
+	}
+
+	return true;
+}
+
 bool bt_gatt_iter_next_included_service(struct bt_gatt_iter *iter,
 				uint16_t *handle, uint16_t *start_handle,
 				uint16_t *end_handle, uint8_t uuid[16])
@@ -355,6 +425,7 @@ bool bt_gatt_iter_next_characteristic(struct bt_gatt_iter *iter,
 				uint16_t *value_handle, uint8_t *properties,
 				uint8_t uuid[16])
 {
+	struct bt_gatt_result *cur;
 	struct bt_gatt_request *op;
 	const void *pdu_ptr;
 
@@ -386,6 +457,8 @@ bool bt_gatt_iter_next_characteristic(struct bt_gatt_iter *iter,
 	*value_handle = get_le16(pdu_ptr + 3);
 	convert_uuid_le(pdu_ptr + 5, iter->result->data_len - 5, uuid);
 
+	cur = iter->result;
+
 	iter->pos += iter->result->data_len;
 	if (iter->pos == iter->result->pdu_len) {
 		iter->result = iter->result->next;
@@ -393,7 +466,11 @@ bool bt_gatt_iter_next_characteristic(struct bt_gatt_iter *iter,
 	}
 
 	if (!iter->result) {
-		*end_handle = op->end_handle;
+		if (cur->next_start)
+			*end_handle = cur->next_start - 1;
+		else
+			*end_handle = op->end_handle;
+
 		return true;
 	}
 
@@ -597,6 +674,24 @@ void bt_gatt_request_cancel(struct bt_gatt_request *req)
 	req->id = 0;
 }
 
+/*
+ * Pass each response to func as it arrives instead of keeping a copy of
+ * every PDU. The result is only valid during the call, and the request
+ * callback then reports success with a NULL result.
+ */
+bool bt_gatt_request_set_chunk_func(struct bt_gatt_request *req,
+					bt_gatt_chunk_func_t func,
+					void *user_data)
+{
+	if (!req || req->included || req->result_head)
+		return false;
+
+	req->chunk_func = func;
+	req->chunk_data = user_data;
+
+	return true;
+}
+
 static void async_req_unref(void *data)
 {
 	struct bt_gatt_request *req = data;
@@ -607,8 +702,18 @@ static void async_req_unref(void *data)
 static void discovery_op_complete(struct bt_gatt_request *op, bool success,
 								uint8_t ecode)
 {
+	/* Flush the characteristic held back for its end handle */
+	if (op->held_len && (success ||
+				ecode == BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND) &&
+			!result_add(op, BT_ATT_OP_READ_BY_TYPE_RSP, NULL, 0,
+							op->held_len, true)) {
+		success = false;
+		ecode = 0;
+	}
+
 	/* Reset success if there is some result to report */
-	if (ecode == BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND && op->result_head)
+	if (ecode == BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND &&
+					(op->result_head || op->chunks))
 		success = true;
 
 	if (op->callback)
@@ -628,7 +733,6 @@ static void read_by_grp_type_cb(uint8_t opcode, const void *pdu,
 	struct bt_gatt_request *op = user_data;
 	bool success;
 	uint8_t att_ecode = 0;
-	struct bt_gatt_result *cur_result;
 	size_t data_length;
 	size_t list_length;
 	uint16_t last_end;
@@ -663,13 +767,6 @@ static void read_by_grp_type_cb(uint8_t opcode, const void *pdu,
 	/* PDU is correctly formatted. Get the last end handle to process the
 	 * next request and store the PDU.
 	 */
-	cur_result = result_append(opcode, pdu + 1, list_length, data_length,
-									op);
-	if (!cur_result) {
-		success = false;
-		goto done;
-	}
-
 	last_end = get_le16(pdu + length - data_length + 2);
 
 	/*
@@ -681,6 +778,26 @@ static void read_by_grp_type_cb(uint8_t opcode, const void *pdu,
 		goto done;
 	}
 
+	/* Some devices incorrectly return 0xffff as the end group handle when
+	 * the read-by-group-type request is performed within a smaller range.
+	 * Manually set the end group handle that we report in the result to the
+	 * end handle in the original request.
+	 */
+	if (last_end >= op->end_handle && last_end == 0xffff &&
+					last_end != op->end_handle) {
+		uint8_t *list = util_memdup(pdu + 1, list_length);
+
+		put_le16(op->end_handle, list + list_length - data_length + 2);
+		success = result_add(op, opcode, list, list_length,
+							data_length, true);
+		free(list);
+	} else
+		success = result_add(op, opcode, pdu + 1, list_length,
+							data_length, true);
+
+	if (!success)
+		goto done;
+
 	op->start_handle = last_end + 1;
 
 	if (last_end < op->end_handle) {
@@ -702,15 +819,6 @@ static void read_by_grp_type_cb(uint8_t opcode, const void *pdu,
 		goto done;
 	}
 
-	/* Some devices incorrectly return 0xffff as the end group handle when
-	 * the read-by-group-type request is performed within a smaller range.
-	 * Manually set the end group handle that we report in the result to the
-	 * end handle in the original request.
-	 */
-	if (last_end == 0xffff && last_end != op->end_handle)
-		put_le16(op->end_handle,
-				cur_result->pdu + length - data_length + 1);
-
 	success = true;
 
 done:
@@ -740,7 +848,7 @@ static void find_by_type_val_cb(uint8_t opcode, const void *pdu,
 		goto done;
 	}
 
-	if (!result_append(opcode, pdu, length, 4, op)) {
+	if (!result_add(op, opcode, pdu, length, 4, true)) {
 		success = false;
 		goto done;
 	}
@@ -1146,6 +1254,7 @@ struct bt_gatt_request *bt_gatt_discover_included_services(struct bt_att *att,
 	put_le16(start, pdu);
 	put_le16(end, pdu + 2);
 	put_le16(GATT_INCLUDE_UUID, pdu + 4);
+	op->included = true;
 
 	op->id = bt_att_send(att, BT_ATT_OP_READ_BY_TYPE_REQ, pdu, sizeof(pdu),
 				discover_included_cb, bt_gatt_request_ref(op),
@@ -1194,11 +1303,6 @@ static void discover_chrcs_cb(uint8_t opcode, const void *pdu,
 		goto done;
 	}
 
-	if (!result_append(opcode, pdu + 1, length - 1,
-							data_length, op)) {
-		success = false;
-		goto done;
-	}
 	last_handle = get_le16(pdu + length - data_length);
 
 	/*
@@ -1210,6 +1314,12 @@ static void discover_chrcs_cb(uint8_t opcode, const void *pdu,
 		goto done;
 	}
 
+	if (!result_add(op, opcode, pdu + 1, length - 1, data_length,
+					last_handle == op->end_handle)) {
+		success = false;
+		goto done;
+	}
+
 	op->start_handle = last_handle + 1;
 
 	if (last_handle != op->end_handle) {
@@ -1423,7 +1533,7 @@ static void discover_descs_cb(uint8_t opcode, const void *pdu,
 		goto done;
 	}
 
-	if (!result_append(opcode, pdu + 1, length - 1, data_length, op)) {
+	if (!result_add(op, opcode, pdu + 1, length - 1, data_length, true)) {
 		success = false;
 		goto done;
 	}
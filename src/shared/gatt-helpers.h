@@ -51,12 +51,17 @@ typedef void (*bt_gatt_result_callback_t)(bool success, uint8_t att_ecode,
 typedef void (*bt_gatt_request_callback_t)(bool success, uint8_t att_ecode,
 						struct bt_gatt_result *result,
 						void *user_data);
+typedef bool (*bt_gatt_chunk_func_t)(struct bt_gatt_result *result,
+							void *user_data);
 
 struct bt_gatt_request;
 
 struct bt_gatt_request *bt_gatt_request_ref(struct bt_gatt_request *req);
 void bt_gatt_request_unref(struct bt_gatt_request *req);
 void bt_gatt_request_cancel(struct bt_gatt_request *req);
+bool bt_gatt_request_set_chunk_func(struct bt_gatt_request *req,
+					bt_gatt_chunk_func_t func,
+					void *user_data);
 
 unsigned int bt_gatt_exchange_mtu(struct bt_att *att, uint16_t client_rx_mtu,
 					bt_gatt_result_callback_t callback,
@@ -40,11 +40,22 @@
  */
 #define DEFAULT_MAX_PREP_QUEUE_LEN 30
 
+/* Prepared write buffers kept around for the next long write */
+#define PREP_WRITE_POOL_MAX 4
+
 #define NFY_MULT_TIMEOUT 10
+#define NFY_MULT_TIMEOUT_MAX 100
 
 #define DBG(_server, _format, arg...) \
 	gatt_log(_server, "%s:%s() " _format, __FILE__, __func__, ## arg)
 
+struct async_read_value {
+	struct gatt_db_attribute *attr;
+	uint8_t ecode;
+	uint8_t *value;
+	size_t len;
+};
+
 struct async_read_op {
 	struct bt_att_chan *chan;
 	struct bt_gatt_server *server;
@@ -55,6 +66,9 @@ struct async_read_op {
 	size_t pdu_len;
 	size_t value_len;
 	struct queue *db_data;
+	struct async_read_value *values;
+	unsigned int num_values;
+	unsigned int pending;
 };
 
 struct async_write_op {
@@ -65,21 +79,15 @@ struct async_write_op {
 
 struct prep_write_data {
 	struct bt_gatt_server *server;
-	uint8_t *value;
 	uint16_t handle;
 	uint16_t offset;
 	uint16_t length;
 
 	bool reliable_supported;
-};
 
-static void prep_write_data_destroy(void *user_data)
-{
-	struct prep_write_data *data = user_data;
-
-	free(data->value);
-	free(data);
-}
+	/* Values are never longer than this so allocate it upfront */
+	uint8_t value[BT_ATT_MAX_VALUE_LEN];
+};
 
 struct nfy_mult_data {
 	unsigned int id;
@@ -113,6 +121,8 @@ struct bt_gatt_server {
 
 	struct queue *prep_queue;
 	unsigned int max_prep_queue_len;
+	struct util_pool prep_pool;
+	bool prep_stream;
 
 	bt_gatt_server_debug_func_t debug_callback;
 	bt_gatt_server_destroy_func_t debug_destroy;
@@ -122,8 +132,17 @@ struct bt_gatt_server {
 	void *authorize_data;
 
 	struct nfy_mult_data *nfy_mult;
+	uint16_t conn_interval;
+	struct bt_gatt_server_nfy_stats nfy_stats;
 };
 
+static void prep_write_data_destroy(void *user_data)
+{
+	struct prep_write_data *data = user_data;
+
+	util_pool_release(&data->server->prep_pool, data);
+}
+
 static void notify_multiple_free(struct bt_gatt_server *server)
 {
 	if (!server->nfy_mult)
@@ -160,6 +179,7 @@ static void bt_gatt_server_free(struct bt_gatt_server *server)
 	bt_att_unregister(server->att, server->signed_write_cmd_id);
 
 	queue_destroy(server->prep_queue, prep_write_data_destroy);
+	util_pool_flush(&server->prep_pool);
 
 	gatt_db_unref(server->db);
 	bt_att_unref(server->att);
@@ -346,59 +366,18 @@ error:
 
 static void async_read_op_destroy(struct async_read_op *op)
 {
+	unsigned int i;
+
+	for (i = 0; i < op->num_values; i++)
+		free(op->values[i].value);
+
 	bt_gatt_server_unref(op->server);
 	queue_destroy(op->db_data, NULL);
+	free(op->values);
 	free(op->pdu);
 	free(op);
 }
 
-static void process_read_by_type(struct async_read_op *op);
-
-static void read_by_type_read_complete_cb(struct gatt_db_attribute *attr,
-						int err, const uint8_t *value,
-						size_t len, void *user_data)
-{
-	struct async_read_op *op = user_data;
-	uint16_t handle;
-
-	handle = gatt_db_attribute_get_handle(attr);
-
-	/* Terminate the operation if there was an error */
-	if (err) {
-		bt_att_chan_send_error_rsp(op->chan, BT_ATT_OP_READ_BY_TYPE_REQ,
-								handle, err);
-		async_read_op_destroy(op);
-		return;
-	}
-
-	if (op->pdu_len == 0) {
-		op->value_len = MIN(MIN((unsigned int)op->mtu - 4, 253), len);
-		op->pdu[0] = op->value_len + 2;
-		op->pdu_len++;
-	} else if (len != op->value_len) {
-		op->done = true;
-		goto done;
-	}
-
-	/* Stop if this would surpass the MTU */
-	if (op->pdu_len + op->value_len + 2 > (unsigned int) op->mtu - 1) {
-		op->done = true;
-		goto done;
-	}
-
-	/* Encode the current value */
-	put_le16(handle, op->pdu + op->pdu_len);
-	memcpy(op->pdu + op->pdu_len + 2, value, op->value_len);
-
-	op->pdu_len += op->value_len + 2;
-
-	if (op->pdu_len == (unsigned int) op->mtu - 1)
-		op->done = true;
-
-done:
-	process_read_by_type(op);
-}
-
 static bool check_min_key_size(uint8_t min_size, uint8_t size)
 {
 	if (!min_size || !size)
@@ -457,21 +436,182 @@ static uint8_t check_permissions(struct bt_gatt_server *server,
 	return 0;
 }
 
+static void read_by_type_send_error(struct async_read_op *op,
+					struct gatt_db_attribute *attr,
+					uint8_t ecode)
+{
+	bt_att_chan_send_error_rsp(op->chan, BT_ATT_OP_READ_BY_TYPE_REQ,
+				gatt_db_attribute_get_handle(attr), ecode);
+	async_read_op_destroy(op);
+}
+
+static void read_by_type_send_rsp(struct async_read_op *op)
+{
+	bt_att_chan_send_rsp(op->chan, BT_ATT_OP_READ_BY_TYPE_RSP,
+						op->pdu, op->pdu_len);
+	async_read_op_destroy(op);
+}
+
+/* Returns false once the response cannot take any more values */
+static bool read_by_type_encode(struct async_read_op *op,
+					struct gatt_db_attribute *attr,
+					const uint8_t *value, size_t len)
+{
+	uint16_t handle = gatt_db_attribute_get_handle(attr);
+
+	if (op->pdu_len == 0) {
+		op->value_len = MIN(MIN((unsigned int)op->mtu - 4, 253), len);
+		op->pdu[0] = op->value_len + 2;
+		op->pdu_len++;
+	} else if (len != op->value_len) {
+		op->done = true;
+		return false;
+	}
+
+	/* Stop if this would surpass the MTU */
+	if (op->pdu_len + op->value_len + 2 > (unsigned int) op->mtu - 1) {
+		op->done = true;
+		return false;
+	}
+
+	/* Encode the current value */
+	put_le16(handle, op->pdu + op->pdu_len);
+	memcpy(op->pdu + op->pdu_len + 2, value, op->value_len);
+
+	op->pdu_len += op->value_len + 2;
+
+	if (op->pdu_len == (unsigned int) op->mtu - 1)
+		op->done = true;
+
+	return !op->done;
+}
+
+static void read_by_type_complete(struct async_read_op *op)
+{
+	unsigned int i;
+
+	/* Assemble the response in handle order, as if the values had been
+	 * read one after the other.
+	 */
+	for (i = 0; i < op->num_values; i++) {
+		struct async_read_value *v = &op->values[i];
+
+		if (v->ecode) {
+			read_by_type_send_error(op, v->attr, v->ecode);
+			return;
+		}
+
+		if (!read_by_type_encode(op, v->attr, v->value, v->len))
+			break;
+	}
+
+	read_by_type_send_rsp(op);
+}
+
+static void read_by_type_value_cb(struct gatt_db_attribute *attr, int err,
+					const uint8_t *value, size_t len,
+					void *user_data)
+{
+	struct async_read_op *op = user_data;
+	unsigned int i;
+
+	for (i = 0; i < op->num_values; i++) {
+		struct async_read_value *v = &op->values[i];
+
+		if (v->attr != attr)
+			continue;
+
+		if (err)
+			v->ecode = err;
+		else if (len) {
+			v->value = util_memdup(value, len);
+			v->len = len;
+		}
+
+		break;
+	}
+
+	if (!--op->pending)
+		read_by_type_complete(op);
+}
+
+static void read_by_type_read_all(struct async_read_op *op)
+{
+	struct bt_gatt_server *server = op->server;
+	unsigned int i, count;
+
+	/* Now that the value length is known only read as many attributes as
+	 * can still fit in the response, all of them at once.
+	 */
+	count = ((unsigned int) op->mtu - 1 - op->pdu_len) /
+							(op->value_len + 2);
+	count = MIN(count, queue_length(op->db_data));
+
+	op->values = new0(struct async_read_value, count);
+	op->num_values = count;
+
+	for (i = 0; i < count; i++)
+		op->values[i].attr = queue_pop_head(op->db_data);
+
+	/* Hold a reference so reads completing right away don't finish the
+	 * operation while there are still reads to be issued.
+	 */
+	op->pending = 1;
+
+	for (i = 0; i < count; i++) {
+		struct async_read_value *v = &op->values[i];
+
+		v->ecode = check_permissions(server, v->attr,
+						BT_ATT_PERM_READ_MASK);
+		if (v->ecode)
+			continue;
+
+		op->pending++;
+
+		if (gatt_db_attribute_read(v->attr, 0, op->opcode, server->att,
+					read_by_type_value_cb, op))
+			continue;
+
+		op->pending--;
+		v->ecode = BT_ATT_ERROR_UNLIKELY;
+	}
+
+	if (!--op->pending)
+		read_by_type_complete(op);
+}
+
+static void read_by_type_read_complete_cb(struct gatt_db_attribute *attr,
+						int err, const uint8_t *value,
+						size_t len, void *user_data)
+{
+	struct async_read_op *op = user_data;
+
+	/* Terminate the operation if there was an error */
+	if (err) {
+		read_by_type_send_error(op, attr, err);
+		return;
+	}
+
+	if (!read_by_type_encode(op, attr, value, len) ||
+					queue_isempty(op->db_data)) {
+		read_by_type_send_rsp(op);
+		return;
+	}
+
+	read_by_type_read_all(op);
+}
+
 static void process_read_by_type(struct async_read_op *op)
 {
 	struct bt_gatt_server *server = op->server;
 	uint8_t ecode;
 	struct gatt_db_attribute *attr;
 
+	/* The first value is read on its own, its length determines how many
+	 * of the remaining attributes can make it into the response.
+	 */
 	attr = queue_pop_head(op->db_data);
 
-	if (op->done || !attr) {
-		bt_att_chan_send_rsp(op->chan, BT_ATT_OP_READ_BY_TYPE_RSP,
-						op->pdu, op->pdu_len);
-		async_read_op_destroy(op);
-		return;
-	}
-
 	ecode = check_permissions(server, attr, BT_ATT_PERM_READ_MASK);
 	if (ecode)
 		goto error;
@@ -483,9 +623,7 @@ static void process_read_by_type(struct async_read_op *op)
 	ecode = BT_ATT_ERROR_UNLIKELY;
 
 error:
-	bt_att_chan_send_error_rsp(op->chan, BT_ATT_OP_READ_BY_TYPE_REQ,
-				gatt_db_attribute_get_handle(attr), ecode);
-	async_read_op_destroy(op);
+	read_by_type_send_error(op, attr, ecode);
 }
 
 static void read_by_type_cb(struct bt_att_chan *chan, uint16_t mtu,
@@ -1177,22 +1315,14 @@ error:
 static bool append_prep_data(struct prep_write_data *prep_data, uint16_t handle,
 					uint16_t length, uint8_t *value)
 {
-	uint8_t *val;
-	uint16_t len;
-
 	if (!length)
 		return true;
 
-	len = prep_data->length + length;
-
-	val = realloc(prep_data->value, len);
-	if (!val)
+	if (prep_data->length + length > sizeof(prep_data->value))
 		return false;
 
-	memcpy(val + prep_data->length, value, length);
-
-	prep_data->value = val;
-	prep_data->length = len;
+	memcpy(prep_data->value + prep_data->length, value, length);
+	prep_data->length += length;
 
 	return true;
 }
@@ -1220,14 +1350,14 @@ static bool prep_data_new(struct bt_gatt_server *server,
 {
 	struct prep_write_data *prep_data;
 
-	prep_data = new0(struct prep_write_data, 1);
+	prep_data = util_pool_alloc(&server->prep_pool);
+	prep_data->server = server;
 
 	if (!append_prep_data(prep_data, handle, length, value)) {
 		prep_write_data_destroy(prep_data);
 		return false;
 	}
 
-	prep_data->server = server;
 	prep_data->handle = handle;
 	prep_data->offset = offset;
 
@@ -1268,6 +1398,45 @@ struct prep_write_complete_data {
 	struct bt_gatt_server *server;
 };
 
+static void prep_write_stream_cb(struct gatt_db_attribute *attr, int err,
+								void *user_data)
+{
+	struct prep_write_complete_data *pwcd = user_data;
+
+	if (err)
+		bt_att_chan_send_error_rsp(pwcd->chan, BT_ATT_OP_PREP_WRITE_REQ,
+						get_le16(pwcd->pdu), err);
+	else
+		bt_att_chan_send_rsp(pwcd->chan, BT_ATT_OP_PREP_WRITE_RSP,
+						pwcd->pdu, pwcd->length);
+
+	free(pwcd->pdu);
+	free(pwcd);
+}
+
+static bool prep_write_stream(struct prep_write_complete_data *pwcd,
+					struct gatt_db_attribute *attr,
+					uint16_t handle, uint16_t offset)
+{
+	struct bt_gatt_server *server = pwcd->server;
+
+	/* Segments that are part of a reliable write, or that could be, need
+	 * to be queued until the client executes or cancels them.
+	 */
+	if (!server->prep_stream || !queue_isempty(server->prep_queue) ||
+			is_reliable_write_supported(server, handle - 1))
+		return false;
+
+	if (!gatt_db_attribute_write(attr, offset,
+					(uint8_t *) pwcd->pdu + 4,
+					pwcd->length - 4,
+					BT_ATT_OP_EXEC_WRITE_REQ, server->att,
+					prep_write_stream_cb, pwcd))
+		prep_write_stream_cb(attr, BT_ATT_ERROR_UNLIKELY, pwcd);
+
+	return true;
+}
+
 static void prep_write_complete_cb(struct gatt_db_attribute *attr, int err,
 								void *user_data)
 {
@@ -1288,6 +1457,9 @@ static void prep_write_complete_cb(struct gatt_db_attribute *attr, int err,
 
 	offset = get_le16(pwcd->pdu + 2);
 
+	if (prep_write_stream(pwcd, attr, handle, offset))
+		return;
+
 	if (!store_prep_data(pwcd->server, handle, offset, pwcd->length - 4,
 						&((uint8_t *) pwcd->pdu)[4]))
 		bt_att_chan_send_error_rsp(pwcd->chan, BT_ATT_OP_PREP_WRITE_RSP,
@@ -1654,6 +1826,8 @@ struct bt_gatt_server *bt_gatt_server_new(struct gatt_db *db,
 	server->mtu = MAX(mtu, BT_ATT_DEFAULT_LE_MTU);
 	server->max_prep_queue_len = DEFAULT_MAX_PREP_QUEUE_LEN;
 	server->prep_queue = queue_new();
+	server->prep_pool.size = sizeof(struct prep_write_data);
+	server->prep_pool.max = PREP_WRITE_POOL_MAX;
 	server->min_enc_size = min_enc_size;
 
 	if (!gatt_server_register_att_handlers(server)) {
@@ -1733,6 +1907,7 @@ static bool notify_multiple(void *user_data)
 	struct bt_gatt_server *server = user_data;
 
 	server->nfy_mult->id = 0;
+	server->nfy_stats.mult_pdus++;
 
 	bt_att_send(server->att, BT_ATT_OP_HANDLE_NFY_MULT,
 			server->nfy_mult->pdu, server->nfy_mult->offset, NULL,
@@ -1743,6 +1918,25 @@ static bool notify_multiple(void *user_data)
 	return false;
 }
 
+static unsigned int notify_multiple_window(struct bt_gatt_server *server)
+{
+	unsigned int window = NFY_MULT_TIMEOUT;
+	unsigned int depth;
+
+	/* Connection interval is in 1.25 ms units, nothing can go out before
+	 * the next connection event anyway.
+	 */
+	if (server->conn_interval)
+		window = MAX(server->conn_interval * 5 / 4, 1);
+
+	/* The more PDUs are already waiting to be sent the longer it takes for
+	 * this one to go out, so keep packing values in the meantime.
+	 */
+	depth = bt_att_get_write_queue_len(server->att);
+
+	return MIN(window * (depth + 1), NFY_MULT_TIMEOUT_MAX);
+}
+
 static bool notify_append_le16(struct nfy_mult_data *data, uint16_t value)
 {
 	if (data->offset + sizeof(value) > data->len)
@@ -1770,11 +1964,18 @@ bool bt_gatt_server_send_notification(struct bt_gatt_server *server,
 		/* flush buffered data if this request hits buffer size limit */
 		if (data && data->offset > 0 &&
 				data->len - data->offset < 4 + length) {
+			server->nfy_stats.mult_full++;
 			notify_multiple_timeout_remove(server);
 			notify_multiple(server);
 			/* data has been freed by notify_multiple */
 			data = NULL;
 		}
+
+		/* Nothing to wait for if the bearer is idle */
+		if (!data && !bt_att_get_write_queue_len(server->att)) {
+			server->nfy_stats.immediate++;
+			multiple = false;
+		}
 	}
 
 	if (!data) {
@@ -1800,13 +2001,16 @@ bool bt_gatt_server_send_notification(struct bt_gatt_server *server,
 	data->offset += length;
 
 	if (multiple) {
+		server->nfy_stats.mult_values++;
+
 		if (!server->nfy_mult)
 			server->nfy_mult = data;
 
 		if (!server->nfy_mult->id)
-			server->nfy_mult->id = timeout_add(NFY_MULT_TIMEOUT,
-						   notify_multiple, server,
-						   NULL);
+			server->nfy_mult->id = timeout_add(
+						notify_multiple_window(server),
+						notify_multiple, server,
+						NULL);
 
 		return true;
 	}
@@ -1859,18 +2063,20 @@ bool bt_gatt_server_send_indication(struct bt_gatt_server *server,
 					void *user_data,
 					bt_gatt_server_destroy_func_t destroy)
 {
-	uint16_t pdu_len;
-	uint8_t *pdu;
+	uint8_t hdr[2];
+	struct iovec iov[2];
 	struct ind_data *data;
 	bool result;
 
 	if (!server || (length && !value))
 		return false;
 
-	pdu_len = MIN(bt_att_get_mtu(server->att) - 1, length + 2);
-	pdu = malloc(pdu_len);
-	if (!pdu)
-		return false;
+	put_le16(handle, hdr);
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = (void *) value;
+	iov[1].iov_len = MIN(bt_att_get_mtu(server->att) - 3, length);
 
 	data = new0(struct ind_data, 1);
 
@@ -1878,20 +2084,48 @@ bool bt_gatt_server_send_indication(struct bt_gatt_server *server,
 	data->destroy = destroy;
 	data->user_data = user_data;
 
-	put_le16(handle, pdu);
-	memcpy(pdu + 2, value, pdu_len - 2);
-
-	result = !!bt_att_send(server->att, BT_ATT_OP_HANDLE_IND, pdu,
-							pdu_len, conf_cb,
-							data, destroy_ind_data);
+	result = !!bt_att_sendv(server->att, BT_ATT_OP_HANDLE_IND, iov, 2,
+							conf_cb, data,
+							destroy_ind_data);
 	if (!result)
 		destroy_ind_data(data);
 
-	free(pdu);
-
 	return result;
 }
 
+bool bt_gatt_server_set_prep_write_stream(struct bt_gatt_server *server,
+								bool enable)
+{
+	if (!server)
+		return false;
+
+	server->prep_stream = enable;
+
+	return true;
+}
+
+bool bt_gatt_server_set_conn_interval(struct bt_gatt_server *server,
+							uint16_t interval)
+{
+	if (!server)
+		return false;
+
+	server->conn_interval = interval;
+
+	return true;
+}
+
+bool bt_gatt_server_get_nfy_stats(struct bt_gatt_server *server,
+				struct bt_gatt_server_nfy_stats *stats)
+{
+	if (!server || !stats)
+		return false;
+
+	*stats = server->nfy_stats;
+
+	return true;
+}
+
 bool bt_gatt_server_set_authorize(struct bt_gatt_server *server,
 					bt_gatt_server_authorize_cb_t cb,
 					void *user_data)
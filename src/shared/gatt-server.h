@@ -37,6 +37,22 @@ bool bt_gatt_server_set_authorize(struct bt_gatt_server *server,
 					bt_gatt_server_authorize_cb_t cb,
 					void *user_data);
 
+bool bt_gatt_server_set_prep_write_stream(struct bt_gatt_server *server,
+								bool enable);
+
+bool bt_gatt_server_set_conn_interval(struct bt_gatt_server *server,
+							uint16_t interval);
+
+struct bt_gatt_server_nfy_stats {
+	uint64_t immediate;	/* Sent right away, bearer was idle */
+	uint64_t mult_values;	/* Values packed for Multiple Notification */
+	uint64_t mult_pdus;	/* Multiple Notification PDUs sent */
+	uint64_t mult_full;	/* PDUs flushed because they were full */
+};
+
+bool bt_gatt_server_get_nfy_stats(struct bt_gatt_server *server,
+				struct bt_gatt_server_nfy_stats *stats);
+
 bool bt_gatt_server_send_notification(struct bt_gatt_server *server,
 					uint16_t handle, const uint8_t *value,
 					uint16_t length, bool multiple);
@@ -47,6 +47,8 @@ struct hci_filter {
 	uint16_t opcode;
 };
 
+#define HCI_RX_BATCH	8
+
 struct bt_hci {
 	int ref_count;
 	struct io *io;
@@ -295,30 +297,42 @@ static void process_event(struct bt_hci *hci, const void *data, size_t size)
 static bool io_read_callback(struct io *io, void *user_data)
 {
 	struct bt_hci *hci = user_data;
-	uint8_t buf[512];
-	ssize_t len;
-	int fd;
-
-	fd = io_get_fd(hci->io);
-	if (fd < 0)
-		return false;
+	uint8_t buf[HCI_RX_BATCH][512];
+	struct iovec iov[HCI_RX_BATCH];
+	size_t len[HCI_RX_BATCH];
+	int i, count;
 
 	if (hci->is_stream)
 		return false;
 
-	len = read(fd, buf, sizeof(buf));
-	if (len < 0)
-		return false;
+	for (i = 0; i < HCI_RX_BATCH; i++) {
+		iov[i].iov_base = buf[i];
+		iov[i].iov_len = sizeof(buf[i]);
+	}
 
-	if (len < 1)
+	count = io_recv_batch(hci->io, iov, HCI_RX_BATCH, len);
+	if (count == -EAGAIN)
 		return true;
 
-	switch (buf[0]) {
-	case BT_H4_EVT_PKT:
-		process_event(hci, buf + 1, len - 1);
-		break;
+	if (count < 0)
+		return false;
+
+	/* Event handlers may drop the last reference */
+	bt_hci_ref(hci);
+
+	for (i = 0; i < count; i++) {
+		if (len[i] < 1)
+			continue;
+
+		switch (buf[i][0]) {
+		case BT_H4_EVT_PKT:
+			process_event(hci, buf[i] + 1, len[i] - 1);
+			break;
+		}
 	}
 
+	bt_hci_unref(hci);
+
 	return true;
 }
 
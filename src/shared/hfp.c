@@ -25,6 +25,8 @@
 #include "src/shared/io.h"
 #include "src/shared/hfp.h"
 
+#define HFP_BUF_SIZE	4096
+
 struct hfp_gw {
 	int ref_count;
 	int fd;
@@ -77,6 +79,7 @@ struct hfp_hf {
 
 struct cmd_handler {
 	char *prefix;
+	unsigned int hash;
 	void *user_data;
 	hfp_destroy_func_t destroy;
 	hfp_result_func_t callback;
@@ -96,6 +99,7 @@ struct cmd_response {
 
 struct event_handler {
 	char *prefix;
+	unsigned int hash;
 	void *user_data;
 	hfp_destroy_func_t destroy;
 	hfp_hf_result_func_t callback;
@@ -124,6 +128,23 @@ static bool match_handler_prefix(const void *a, const void *b)
 	return true;
 }
 
+static unsigned int prefix_hash(const char *prefix)
+{
+	unsigned int hash = 5381;
+
+	while (*prefix)
+		hash = hash * 33 + (uint8_t) *prefix++;
+
+	return hash;
+}
+
+static unsigned int cmd_handler_hash(const void *data)
+{
+	const struct cmd_handler *handler = data;
+
+	return handler->hash;
+}
+
 static void write_watch_destroy(void *user_data)
 {
 	struct hfp_gw *hfp = user_data;
@@ -244,8 +265,8 @@ static bool handle_at_command(struct hfp_gw *hfp, const char *data)
 
 done:
 
-	handler = queue_find(hfp->cmd_handlers, match_handler_prefix,
-								lookup_prefix);
+	handler = queue_find_hash(hfp->cmd_handlers, prefix_hash(lookup_prefix),
+					match_handler_prefix, lookup_prefix);
 	if (!handler) {
 		handle_unknown_at_command(hfp, data);
 		return true;
@@ -462,9 +483,9 @@ failed:
 
 static void process_input(struct hfp_gw *hfp)
 {
+	char buf[HFP_BUF_SIZE];
 	char *str, *ptr;
 	size_t len, count;
-	bool free_ptr = false;
 	bool read_again;
 
 	do {
@@ -492,18 +513,17 @@ static void process_input(struct hfp_gw *hfp)
 			if (!ptr)
 				return;
 
-			*ptr = '\0';
-
-			count = len2 + len;
-			ptr = malloc(count);
-			if (!ptr)
-				return;
+			/*
+			 * The whole command fits in the ring buffer, so join
+			 * both parts on the stack instead of allocating.
+			 */
+			count = len + (ptr - str2);
 
-			memcpy(ptr, str, len);
-			memcpy(ptr + len, str2, len2);
+			memcpy(buf, str, len);
+			memcpy(buf + len, str2, ptr - str2);
+			buf[count] = '\0';
 
-			free_ptr = true;
-			str = ptr;
+			str = buf;
 		} else {
 			count = ptr - str;
 			*ptr = '\0';
@@ -527,10 +547,6 @@ static void process_input(struct hfp_gw *hfp)
 			read_again = !hfp->result_pending;
 
 		ringbuf_drain(hfp->read_buf, count + 1);
-
-		if (free_ptr)
-			free(ptr);
-
 	} while (read_again);
 }
 
@@ -538,6 +554,22 @@ static void read_watch_destroy(void *user_data)
 {
 }
 
+/*
+ * A mirrored buffer lets the parsers see commands that wrap around the end
+ * of the ring as one string, the copying fallback is only for systems
+ * without memfd support.
+ */
+static struct ringbuf *hfp_ringbuf_new(void)
+{
+	struct ringbuf *ringbuf;
+
+	ringbuf = ringbuf_new_mirrored(HFP_BUF_SIZE);
+	if (!ringbuf)
+		ringbuf = ringbuf_new(HFP_BUF_SIZE);
+
+	return ringbuf;
+}
+
 static bool can_read_data(struct io *io, void *user_data)
 {
 	struct hfp_gw *hfp = user_data;
@@ -566,13 +598,13 @@ struct hfp_gw *hfp_gw_new(int fd)
 	hfp->fd = fd;
 	hfp->close_on_unref = false;
 
-	hfp->read_buf = ringbuf_new(4096);
+	hfp->read_buf = hfp_ringbuf_new();
 	if (!hfp->read_buf) {
 		free(hfp);
 		return NULL;
 	}
 
-	hfp->write_buf = ringbuf_new(4096);
+	hfp->write_buf = ringbuf_new(HFP_BUF_SIZE);
 	if (!hfp->write_buf) {
 		ringbuf_free(hfp->read_buf);
 		free(hfp);
@@ -588,6 +620,7 @@ struct hfp_gw *hfp_gw_new(int fd)
 	}
 
 	hfp->cmd_handlers = queue_new();
+	queue_set_hash(hfp->cmd_handlers, cmd_handler_hash);
 
 	if (!io_set_read_handler(hfp->io, can_read_data, hfp,
 							read_watch_destroy)) {
@@ -831,8 +864,10 @@ bool hfp_gw_register(struct hfp_gw *hfp, hfp_result_func_t callback,
 		return false;
 	}
 
-	if (queue_find(hfp->cmd_handlers, match_handler_prefix,
-							handler->prefix)) {
+	handler->hash = prefix_hash(handler->prefix);
+
+	if (queue_find_hash(hfp->cmd_handlers, handler->hash,
+				match_handler_prefix, handler->prefix)) {
 		destroy_cmd_handler(handler);
 		return false;
 	}
@@ -845,16 +880,10 @@ bool hfp_gw_register(struct hfp_gw *hfp, hfp_result_func_t callback,
 bool hfp_gw_unregister(struct hfp_gw *hfp, const char *prefix)
 {
 	struct cmd_handler *handler;
-	char *lookup_prefix;
-
-	lookup_prefix = strdup(prefix);
-	if (!lookup_prefix)
-		return false;
 
+	/* Cast to void as queue_remove needs that */
 	handler = queue_remove_if(hfp->cmd_handlers, match_handler_prefix,
-								lookup_prefix);
-	free(lookup_prefix);
-
+							(void *) prefix);
 	if (!handler)
 		return false;
 
@@ -933,6 +962,13 @@ static bool match_handler_event_prefix(const void *a, const void *b)
 	return true;
 }
 
+static unsigned int event_handler_hash(const void *data)
+{
+	const struct event_handler *handler = data;
+
+	return handler->hash;
+}
+
 static void destroy_event_handler(void *data)
 {
 	struct event_handler *handler = data;
@@ -977,6 +1013,10 @@ static bool is_response(const char *prefix, enum hfp_result *result,
 						enum hfp_error *cme_err,
 						struct hfp_context *context)
 {
+	/* Unsolicited results like +CIEV are far more frequent */
+	if (prefix[0] == '+' && strcmp(prefix, "+CME ERROR"))
+		return false;
+
 	if (strcmp(prefix, "OK") == 0) {
 		*result = HFP_RESULT_OK;
 		/*
@@ -1103,8 +1143,10 @@ static void hf_call_prefix_handler(struct hfp_hf *hfp, const char *data)
 		return;
 	}
 
-	handler = queue_find(hfp->event_handlers, match_handler_event_prefix,
-								lookup_prefix);
+	handler = queue_find_hash(hfp->event_handlers,
+					prefix_hash(lookup_prefix),
+					match_handler_event_prefix,
+					lookup_prefix);
 	if (!handler)
 		return;
 
@@ -1142,9 +1184,9 @@ static char *find_cr_lf(char *str, size_t len)
 
 static void hf_process_input(struct hfp_hf *hfp)
 {
-	char *str, *ptr, *str2, *tmp;
-	size_t len, count, offset, len2;
-	bool free_tmp = false;
+	char buf[HFP_BUF_SIZE];
+	char *str, *ptr, *str2;
+	size_t len, count, offset, len2, rest;
 
 	str = ringbuf_peek(hfp->read_buf, 0, &len);
 	if (!str)
@@ -1171,48 +1213,49 @@ static void hf_process_input(struct hfp_hf *hfp)
 	 * Just check if there is no wrapped data in ring buffer.
 	 * Should not happen too often
 	 */
-	if (len == ringbuf_len(hfp->read_buf))
+	if (len == ringbuf_len(hfp->read_buf) || offset == len)
 		goto done;
 
 	str2 = ringbuf_peek(hfp->read_buf, len, &len2);
 	if (!str2)
 		goto done;
 
-	ptr = find_cr_lf(str2, len2);
-	if (!ptr) {
-		/* Might happen that we wrap between \r and \n */
-		ptr = memchr(str2, '\n', len2);
+	rest = len - offset;
+
+	if (str[len - 1] == '\r' && str2[0] == '\n') {
+		/* Wrapped between \r and \n */
+		rest--;
+		count = 0;
+		len2 = 1;
+	} else {
+		ptr = find_cr_lf(str2, len2);
 		if (!ptr)
 			goto done;
-	}
-
-	count = ptr - str2;
-
-	if (count) {
-		*ptr = '\0';
 
-		tmp = malloc(len + count);
-		if (!tmp)
-			goto done;
+		count = ptr - str2;
+		len2 = count + 2;
+	}
 
-		/* "str" here is not a string so we need to use memcpy */
-		memcpy(tmp, str, len);
-		memcpy(tmp + len, str2, count);
+	/*
+	 * The whole line fits in the ring buffer, so join both parts on the
+	 * stack instead of allocating.
+	 */
+	if (rest + count) {
+		memcpy(buf, str + offset, rest);
+		memcpy(buf + rest, str2, count);
+		buf[rest + count] = '\0';
 
-		free_tmp = true;
-	} else {
-		str[len-1] = '\0';
-		tmp = str;
+		hf_call_prefix_handler(hfp, buf);
 	}
 
-	hf_call_prefix_handler(hfp, tmp);
-	offset += count;
+	ringbuf_drain(hfp->read_buf, len + len2);
+
+	/* Whatever follows the wrapped line is now contiguous */
+	hf_process_input(hfp);
+	return;
 
 done:
 	ringbuf_drain(hfp->read_buf, offset);
-
-	if (free_tmp)
-		free(tmp);
 }
 
 static bool hf_can_read_data(struct io *io, void *user_data)
@@ -1240,13 +1283,13 @@ struct hfp_hf *hfp_hf_new(int fd)
 	hfp->fd = fd;
 	hfp->close_on_unref = false;
 
-	hfp->read_buf = ringbuf_new(4096);
+	hfp->read_buf = hfp_ringbuf_new();
 	if (!hfp->read_buf) {
 		free(hfp);
 		return NULL;
 	}
 
-	hfp->write_buf = ringbuf_new(4096);
+	hfp->write_buf = ringbuf_new(HFP_BUF_SIZE);
 	if (!hfp->write_buf) {
 		ringbuf_free(hfp->read_buf);
 		free(hfp);
@@ -1262,6 +1305,7 @@ struct hfp_hf *hfp_hf_new(int fd)
 	}
 
 	hfp->event_handlers = queue_new();
+	queue_set_hash(hfp->event_handlers, event_handler_hash);
 	hfp->cmd_queue = queue_new();
 	hfp->writer_active = false;
 
@@ -1441,8 +1485,10 @@ bool hfp_hf_register(struct hfp_hf *hfp, hfp_hf_result_func_t callback,
 		return false;
 	}
 
-	if (queue_find(hfp->event_handlers, match_handler_event_prefix,
-							handler->prefix)) {
+	handler->hash = prefix_hash(handler->prefix);
+
+	if (queue_find_hash(hfp->event_handlers, handler->hash,
+				match_handler_event_prefix, handler->prefix)) {
 		destroy_event_handler(handler);
 		return false;
 	}
@@ -12,8 +12,11 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
+
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <sys/socket.h>
 
 #include "src/shared/mainloop.h"
@@ -302,6 +305,104 @@ ssize_t io_send(struct io *io, const struct iovec *iov, int iovcnt)
 	return ret;
 }
 
+int io_recv_batch(struct io *io, struct iovec *iov, unsigned int count,
+								size_t *len)
+{
+	struct mmsghdr msgs[IO_BATCH_MAX];
+	unsigned int i;
+	int fd, ret;
+
+	if (!io || io->fd < 0)
+		return -ENOTCONN;
+
+	fd = io->fd;
+
+	if (!iov || !len || !count)
+		return -EINVAL;
+
+	if (count > IO_BATCH_MAX)
+		count = IO_BATCH_MAX;
+
+	memset(msgs, 0, count * sizeof(*msgs));
+
+	for (i = 0; i < count; i++) {
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		ret = recvmmsg(fd, msgs, count, MSG_DONTWAIT, NULL);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0 && errno == ENOTSOCK) {
+		/* Not a socket so fall back to a single read */
+		do {
+			ret = readv(fd, iov, 1);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret < 0)
+			return -errno;
+
+		len[0] = ret;
+
+		return 1;
+	}
+
+	if (ret < 0)
+		return -errno;
+
+	for (i = 0; i < (unsigned int) ret; i++)
+		len[i] = msgs[i].msg_len;
+
+	return ret;
+}
+
+int io_send_batch(struct io *io, const struct iovec *iov, unsigned int count)
+{
+	struct mmsghdr msgs[IO_BATCH_MAX];
+	unsigned int i;
+	int fd, ret;
+
+	if (!io || io->fd < 0)
+		return -ENOTCONN;
+
+	fd = io->fd;
+
+	if (!iov || !count)
+		return -EINVAL;
+
+	if (count > IO_BATCH_MAX)
+		count = IO_BATCH_MAX;
+
+	memset(msgs, 0, count * sizeof(*msgs));
+
+	for (i = 0; i < count; i++) {
+		msgs[i].msg_hdr.msg_iov = (struct iovec *) &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		ret = sendmmsg(fd, msgs, count, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0 && errno == ENOTSOCK) {
+		/* Not a socket so fall back to a single write */
+		do {
+			ret = writev(fd, iov, 1);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret < 0)
+			return -errno;
+
+		return 1;
+	}
+
+	if (ret < 0)
+		return -errno;
+
+	return ret;
+}
+
 bool io_shutdown(struct io *io)
 {
 	if (!io || io->fd < 0)
@@ -22,6 +22,13 @@ int io_get_fd(struct io *io);
 bool io_set_close_on_destroy(struct io *io, bool do_close);
 
 ssize_t io_send(struct io *io, const struct iovec *iov, int iovcnt);
+
+/* Maximum number of datagrams moved by a single batch call */
+#define IO_BATCH_MAX 32
+
+int io_recv_batch(struct io *io, struct iovec *iov, unsigned int count,
+								size_t *len);
+int io_send_batch(struct io *io, const struct iovec *iov, unsigned int count);
 bool io_shutdown(struct io *io);
 
 typedef bool (*io_callback_func_t)(struct io *io, void *user_data);
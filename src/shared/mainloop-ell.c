@@ -78,6 +78,16 @@ int mainloop_run_with_signal(mainloop_signal_func func, void *user_data)
 	return l_main_run_with_signal(l_sig_func, user_data);
 }
 
+int mainloop_set_max_events(unsigned int max)
+{
+	return -ENOSYS;
+}
+
+int mainloop_set_busy_poll(unsigned int usec)
+{
+	return -ENOSYS;
+}
+
 int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 				void *user_data, mainloop_destroy_func destroy)
 {
@@ -73,6 +73,16 @@ int mainloop_run(void)
 	return exit_status;
 }
 
+int mainloop_set_max_events(unsigned int max)
+{
+	return -ENOSYS;
+}
+
+int mainloop_set_busy_poll(unsigned int usec)
+{
+	return -ENOSYS;
+}
+
 int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 				void *user_data, mainloop_destroy_func destroy)
 {
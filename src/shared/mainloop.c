@@ -26,16 +26,25 @@
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <time.h>
 
 #include "mainloop.h"
 #include "mainloop-notify.h"
 
-#define MAX_EPOLL_EVENTS 10
+#define DEFAULT_EPOLL_EVENTS 64
 
 static int epoll_fd;
 static int epoll_terminate;
 static int exit_status = EXIT_SUCCESS;
 
+static unsigned int max_events = DEFAULT_EPOLL_EVENTS;
+static unsigned int busy_poll_usec;
+
+/* Events of the batch currently being dispatched */
+static struct epoll_event *dispatch_events;
+static int dispatch_index;
+static int dispatch_count;
+
 struct mainloop_data {
 	int fd;
 	uint32_t events;
@@ -44,25 +53,53 @@ struct mainloop_data {
 	void *user_data;
 };
 
-#define MAX_MAINLOOP_ENTRIES 128
+#define MIN_MAINLOOP_ENTRIES 128
 
-static struct mainloop_data *mainloop_list[MAX_MAINLOOP_ENTRIES];
+static struct mainloop_data **mainloop_list;
+static unsigned int mainloop_list_size;
+
+/*
+ * Timeouts are kept in a hierarchical timer wheel with a resolution of
+ * one millisecond, multiplexed over a single timerfd that is armed for
+ * the next slot that needs attention.
+ */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
 
 struct timeout_data {
-	int fd;
+	int id;
+	uint64_t expire;
+	int level;
+	unsigned int slot;
+	struct timeout_data *next;
+	struct timeout_data **pprev;
 	mainloop_timeout_func callback;
 	mainloop_destroy_func destroy;
 	void *user_data;
 };
 
+static struct {
+	int fd;
+	uint64_t now;
+	uint64_t armed;
+	unsigned int count;
+	struct timeout_data *slots[WHEEL_LEVELS][WHEEL_SIZE];
+	uint64_t bitmap[WHEEL_LEVELS];
+	struct timeout_data **table;
+	unsigned int table_size;
+	unsigned int *free_ids;
+	unsigned int free_count;
+} wheel = { .fd = -1 };
+
 void mainloop_init(void)
 {
-	unsigned int i;
-
 	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 
-	for (i = 0; i < MAX_MAINLOOP_ENTRIES; i++)
-		mainloop_list[i] = NULL;
+	free(mainloop_list);
+	mainloop_list = NULL;
+	mainloop_list_size = 0;
 
 	epoll_terminate = 0;
 
@@ -88,27 +125,92 @@ void mainloop_exit_failure(void)
 	epoll_terminate = 1;
 }
 
+int mainloop_set_max_events(unsigned int max)
+{
+	if (!max)
+		return -EINVAL;
+
+	max_events = max;
+
+	return 0;
+}
+
+int mainloop_set_busy_poll(unsigned int usec)
+{
+	busy_poll_usec = usec;
+
+	return 0;
+}
+
+static uint64_t get_monotonic_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
 int mainloop_run(void)
 {
+	struct epoll_event *events = NULL;
+	unsigned int events_size = 0;
+	uint64_t busy_until = 0;
 	unsigned int i;
 
 	while (!epoll_terminate) {
-		struct epoll_event events[MAX_EPOLL_EVENTS];
-		int n, nfds;
+		int nfds, timeout = -1;
 
-		nfds = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+		if (events_size != max_events) {
+			free(events);
+			events = calloc(max_events, sizeof(*events));
+			if (!events) {
+				exit_status = EXIT_FAILURE;
+				break;
+			}
+
+			events_size = max_events;
+		}
+
+		/*
+		 * In busy poll mode keep polling without sleeping for a
+		 * while after the last activity, trading CPU time for
+		 * lower wakeup latency.
+		 */
+		if (busy_until && get_monotonic_usec() < busy_until)
+			timeout = 0;
+
+		nfds = epoll_wait(epoll_fd, events, events_size, timeout);
 		if (nfds < 0)
 			continue;
 
-		for (n = 0; n < nfds; n++) {
-			struct mainloop_data *data = events[n].data.ptr;
+		if (nfds > 0 && busy_poll_usec)
+			busy_until = get_monotonic_usec() + busy_poll_usec;
+		else if (!nfds)
+			continue;
 
-			data->callback(data->fd, events[n].events,
-							data->user_data);
+		dispatch_events = events;
+		dispatch_count = nfds;
+
+		for (dispatch_index = 0; dispatch_index < dispatch_count;
+							dispatch_index++) {
+			struct epoll_event *ev = &events[dispatch_index];
+			struct mainloop_data *data = ev->data.ptr;
+
+			/* Removed by a previous callback of this batch */
+			if (!data)
+				continue;
+
+			data->callback(data->fd, ev->events, data->user_data);
 		}
+
+		dispatch_events = NULL;
+		dispatch_count = 0;
 	}
 
-	for (i = 0; i < MAX_MAINLOOP_ENTRIES; i++) {
+	free(events);
+
+	for (i = 0; i < mainloop_list_size; i++) {
 		struct mainloop_data *data = mainloop_list[i];
 
 		mainloop_list[i] = NULL;
@@ -123,6 +225,10 @@ int mainloop_run(void)
 		}
 	}
 
+	free(mainloop_list);
+	mainloop_list = NULL;
+	mainloop_list_size = 0;
+
 	close(epoll_fd);
 	epoll_fd = 0;
 
@@ -131,6 +237,30 @@ int mainloop_run(void)
 	return exit_status;
 }
 
+static int mainloop_list_grow(unsigned int size)
+{
+	struct mainloop_data **list;
+	unsigned int new_size = mainloop_list_size;
+
+	if (new_size < MIN_MAINLOOP_ENTRIES)
+		new_size = MIN_MAINLOOP_ENTRIES;
+
+	while (new_size < size)
+		new_size *= 2;
+
+	list = realloc(mainloop_list, new_size * sizeof(*list));
+	if (!list)
+		return -ENOMEM;
+
+	memset(list + mainloop_list_size, 0,
+			(new_size - mainloop_list_size) * sizeof(*list));
+
+	mainloop_list = list;
+	mainloop_list_size = new_size;
+
+	return 0;
+}
+
 int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 				void *user_data, mainloop_destroy_func destroy)
 {
@@ -138,9 +268,15 @@ int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 	struct epoll_event ev;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1 || !callback)
+	if (fd < 0 || !callback)
 		return -EINVAL;
 
+	if ((unsigned int) fd >= mainloop_list_size) {
+		err = mainloop_list_grow(fd + 1);
+		if (err < 0)
+			return err;
+	}
+
 	data = malloc(sizeof(*data));
 	if (!data)
 		return -ENOMEM;
@@ -173,7 +309,7 @@ int mainloop_modify_fd(int fd, uint32_t events)
 	struct epoll_event ev;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1)
+	if (fd < 0 || (unsigned int) fd >= mainloop_list_size)
 		return -EINVAL;
 
 	data = mainloop_list[fd];
@@ -196,9 +332,9 @@ int mainloop_modify_fd(int fd, uint32_t events)
 int mainloop_remove_fd(int fd)
 {
 	struct mainloop_data *data;
-	int err;
+	int err, i;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1)
+	if (fd < 0 || (unsigned int) fd >= mainloop_list_size)
 		return -EINVAL;
 
 	data = mainloop_list[fd];
@@ -207,6 +343,12 @@ int mainloop_remove_fd(int fd)
 
 	mainloop_list[fd] = NULL;
 
+	/* Drop events still pending for this fd in the current batch */
+	for (i = dispatch_index + 1; i < dispatch_count; i++) {
+		if (dispatch_events[i].data.ptr == data)
+			dispatch_events[i].data.ptr = NULL;
+	}
+
 	err = epoll_ctl(epoll_fd, EPOLL_CTL_DEL, data->fd, NULL);
 
 	if (data->destroy)
@@ -217,105 +359,407 @@ int mainloop_remove_fd(int fd)
 	return err;
 }
 
-static void timeout_destroy(void *user_data)
+static uint64_t get_monotonic_msec(void)
 {
-	struct timeout_data *data = user_data;
+	struct timespec ts;
 
-	close(data->fd);
-	data->fd = -1;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	if (data->destroy)
-		data->destroy(data->user_data);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
 
-	free(data);
+static void wheel_unlink(struct timeout_data *data)
+{
+	if (!data->pprev)
+		return;
+
+	*data->pprev = data->next;
+	if (data->next)
+		data->next->pprev = data->pprev;
+
+	if (data->level >= 0 && !wheel.slots[data->level][data->slot])
+		wheel.bitmap[data->level] &= ~(1ULL << data->slot);
+
+	data->next = NULL;
+	data->pprev = NULL;
+	data->level = -1;
+}
+
+static void wheel_link(struct timeout_data **head, struct timeout_data *data)
+{
+	data->next = *head;
+	if (data->next)
+		data->next->pprev = &data->next;
+
+	*head = data;
+	data->pprev = head;
+}
+
+static void wheel_insert(struct timeout_data *data)
+{
+	uint64_t expire = data->expire;
+	unsigned int level;
+
+	if (expire < wheel.now)
+		expire = wheel.now;
+
+	/* Pick the lowest level whose slots can reach the expiry time */
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		unsigned int shift = level * WHEEL_BITS;
+
+		if ((expire >> shift) - (wheel.now >> shift) < WHEEL_SIZE)
+			break;
+	}
+
+	/* Timeouts beyond the wheel range wait in the farthest slot */
+	if ((expire >> (level * WHEEL_BITS)) -
+			(wheel.now >> (level * WHEEL_BITS)) >= WHEEL_SIZE)
+		expire = wheel.now + ((uint64_t) (WHEEL_SIZE - 1) <<
+						(level * WHEEL_BITS));
+
+	data->level = level;
+	data->slot = (expire >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+	wheel_link(&wheel.slots[level][data->slot], data);
+	wheel.bitmap[level] |= 1ULL << data->slot;
+}
+
+static void wheel_cascade(unsigned int level)
+{
+	unsigned int slot = (wheel.now >> (level * WHEEL_BITS)) & WHEEL_MASK;
+	struct timeout_data *list;
+
+	if (slot == 0 && level < WHEEL_LEVELS - 1)
+		wheel_cascade(level + 1);
+
+	list = wheel.slots[level][slot];
+	wheel.slots[level][slot] = NULL;
+	wheel.bitmap[level] &= ~(1ULL << slot);
+
+	while (list) {
+		struct timeout_data *data = list;
+
+		list = data->next;
+		data->next = NULL;
+		data->pprev = NULL;
+		data->level = -1;
+
+		wheel_insert(data);
+	}
+}
+
+static unsigned int bitmap_next(uint64_t bitmap, unsigned int slot)
+{
+	uint64_t rotated;
+
+	if (!bitmap)
+		return WHEEL_SIZE;
+
+	rotated = slot ? (bitmap >> slot) | (bitmap << (WHEEL_SIZE - slot)) :
+									bitmap;
+
+	return __builtin_ctzll(rotated);
+}
+
+static void wheel_arm(void)
+{
+	struct itimerspec itimer;
+	uint64_t next = UINT64_MAX;
+	unsigned int level;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		unsigned int shift = level * WHEEL_BITS;
+		unsigned int slot = (wheel.now >> shift) & WHEEL_MASK;
+		unsigned int offset;
+		uint64_t expire;
+
+		offset = bitmap_next(wheel.bitmap[level], slot);
+		if (offset == WHEEL_SIZE)
+			continue;
+
+		/* Higher levels only need a wakeup to cascade their slot */
+		expire = ((wheel.now >> shift) + offset) << shift;
+		if (expire < next)
+			next = expire;
+	}
+
+	if (next == wheel.armed)
+		return;
+
+	memset(&itimer, 0, sizeof(itimer));
+
+	if (next != UINT64_MAX) {
+		/* An all zero value disarms the timer so never ask for 0 */
+		if (!next)
+			next = 1;
+
+		itimer.it_value.tv_sec = next / 1000;
+		itimer.it_value.tv_nsec = (next % 1000) * 1000 * 1000;
+	}
+
+	if (timerfd_settime(wheel.fd, TFD_TIMER_ABSTIME, &itimer, NULL) < 0)
+		return;
+
+	wheel.armed = next;
+}
+
+static void wheel_advance(uint64_t now, struct timeout_data **expired)
+{
+	while (wheel.now <= now) {
+		unsigned int slot = wheel.now & WHEEL_MASK;
+		struct timeout_data *list;
+		uint64_t next;
+		unsigned int offset;
+
+		if (!wheel.count) {
+			wheel.now = now + 1;
+			break;
+		}
+
+		if (!slot)
+			wheel_cascade(1);
+
+		list = wheel.slots[0][slot];
+		wheel.slots[0][slot] = NULL;
+		wheel.bitmap[0] &= ~(1ULL << slot);
+
+		while (list) {
+			struct timeout_data *data = list;
+
+			list = data->next;
+			data->next = NULL;
+			data->pprev = NULL;
+			data->level = -1;
+
+			wheel_link(expired, data);
+			wheel.count--;
+		}
+
+		/* Skip ahead to the next used slot or cascade point */
+		offset = slot + 1;
+		if (offset < WHEEL_SIZE && (wheel.bitmap[0] >> offset))
+			next = (wheel.now & ~(uint64_t) WHEEL_MASK) + offset +
+				__builtin_ctzll(wheel.bitmap[0] >> offset);
+		else
+			next = (wheel.now | WHEEL_MASK) + 1;
+
+		wheel.now = next < now + 1 ? next : now + 1;
+	}
 }
 
-static void timeout_callback(int fd, uint32_t events, void *user_data)
+static void wheel_callback(int fd, uint32_t events, void *user_data)
 {
-	struct timeout_data *data = user_data;
-	uint64_t expired;
-	ssize_t result;
+	struct timeout_data *expired = NULL;
+	uint64_t value;
 
 	if (events & (EPOLLERR | EPOLLHUP))
 		return;
 
-	result = read(data->fd, &expired, sizeof(expired));
-	if (result != sizeof(expired))
+	if (read(fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
 		return;
 
-	if (data->callback)
-		data->callback(data->fd, data->user_data);
+	wheel.armed = UINT64_MAX;
+
+	wheel_advance(get_monotonic_msec(), &expired);
+
+	while (expired) {
+		struct timeout_data *data = expired;
+
+		/* The callback may remove or re-arm any expired entry */
+		wheel_unlink(data);
+
+		data->callback(data->id, data->user_data);
+	}
+
+	wheel_arm();
 }
 
-static inline int timeout_set(int fd, unsigned int msec)
+static void timeout_free(struct timeout_data *data)
 {
-	struct itimerspec itimer;
-	unsigned int sec = msec / 1000;
+	if (data->destroy)
+		data->destroy(data->user_data);
 
-	memset(&itimer, 0, sizeof(itimer));
-	itimer.it_interval.tv_sec = 0;
-	itimer.it_interval.tv_nsec = 0;
-	itimer.it_value.tv_sec = sec;
-	itimer.it_value.tv_nsec = (msec - (sec * 1000)) * 1000 * 1000;
+	free(data);
+}
+
+static void wheel_destroy(void *user_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < wheel.table_size; i++) {
+		struct timeout_data *data = wheel.table[i];
+
+		if (!data)
+			continue;
+
+		wheel.table[i] = NULL;
+		timeout_free(data);
+	}
+
+	close(wheel.fd);
 
-	return timerfd_settime(fd, 0, &itimer, NULL);
+	free(wheel.table);
+	free(wheel.free_ids);
+	memset(&wheel, 0, sizeof(wheel));
+	wheel.fd = -1;
+}
+
+static int wheel_init(void)
+{
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0)
+		return -EIO;
+
+	memset(&wheel, 0, sizeof(wheel));
+	wheel.fd = fd;
+	wheel.armed = UINT64_MAX;
+	wheel.now = get_monotonic_msec();
+
+	if (mainloop_add_fd(fd, EPOLLIN, wheel_callback, NULL,
+							wheel_destroy) < 0) {
+		close(fd);
+		wheel.fd = -1;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int wheel_alloc_id(struct timeout_data *data)
+{
+	unsigned int id;
+
+	if (!wheel.free_count) {
+		unsigned int size = wheel.table_size ? wheel.table_size * 2 :
+								WHEEL_SIZE;
+		struct timeout_data **table;
+		unsigned int *free_ids;
+
+		table = realloc(wheel.table, size * sizeof(*table));
+		if (!table)
+			return -ENOMEM;
+
+		wheel.table = table;
+
+		free_ids = realloc(wheel.free_ids, size * sizeof(*free_ids));
+		if (!free_ids)
+			return -ENOMEM;
+
+		wheel.free_ids = free_ids;
+
+		/* Hand out lower ids first, and never use id 0 */
+		for (id = size; id > wheel.table_size; id--)
+			wheel.free_ids[wheel.free_count++] = id;
+
+		memset(table + wheel.table_size, 0,
+				(size - wheel.table_size) * sizeof(*table));
+		wheel.table_size = size;
+	}
+
+	id = wheel.free_ids[--wheel.free_count];
+	wheel.table[id - 1] = data;
+
+	return id;
+}
+
+static struct timeout_data *wheel_lookup(int id)
+{
+	if (id <= 0 || (unsigned int) id > wheel.table_size)
+		return NULL;
+
+	return wheel.table[id - 1];
+}
+
+static void timeout_start(struct timeout_data *data, unsigned int msec)
+{
+	uint64_t now = get_monotonic_msec();
+
+	if (data->level >= 0)
+		wheel.count--;
+
+	wheel_unlink(data);
+
+	/* Nothing pending, so the wheel can jump to the current time */
+	if (!wheel.count && wheel.now < now)
+		wheel.now = now;
+
+	data->expire = now + msec;
+	wheel_insert(data);
+	wheel.count++;
+
+	if (data->expire < wheel.armed)
+		wheel_arm();
 }
 
 int mainloop_add_timeout(unsigned int msec, mainloop_timeout_func callback,
 				void *user_data, mainloop_destroy_func destroy)
 {
 	struct timeout_data *data;
+	int id;
 
 	if (!callback)
 		return -EINVAL;
 
+	if (wheel.fd < 0 && wheel_init() < 0)
+		return -EIO;
+
 	data = malloc(sizeof(*data));
 	if (!data)
 		return -ENOMEM;
 
 	memset(data, 0, sizeof(*data));
+	data->level = -1;
 	data->callback = callback;
 	data->destroy = destroy;
 	data->user_data = user_data;
 
-	data->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-	if (data->fd < 0) {
+	id = wheel_alloc_id(data);
+	if (id < 0) {
 		free(data);
-		return -EIO;
+		return id;
 	}
 
-	if (msec > 0) {
-		if (timeout_set(data->fd, msec) < 0) {
-			close(data->fd);
-			free(data);
-			return -EIO;
-		}
-	}
+	data->id = id;
 
-	if (mainloop_add_fd(data->fd, EPOLLIN | EPOLLONESHOT,
-				timeout_callback, data, timeout_destroy) < 0) {
-		close(data->fd);
-		free(data);
-		return -EIO;
-	}
+	if (msec > 0)
+		timeout_start(data, msec);
 
-	return data->fd;
+	return id;
 }
 
 int mainloop_modify_timeout(int id, unsigned int msec)
 {
-	if (msec > 0) {
-		if (timeout_set(id, msec) < 0)
-			return -EIO;
-	}
+	struct timeout_data *data;
 
-	if (mainloop_modify_fd(id, EPOLLIN | EPOLLONESHOT) < 0)
+	data = wheel_lookup(id);
+	if (!data)
 		return -EIO;
 
+	if (msec > 0)
+		timeout_start(data, msec);
+
 	return 0;
 }
 
 int mainloop_remove_timeout(int id)
 {
-	return mainloop_remove_fd(id);
+	struct timeout_data *data;
+
+	data = wheel_lookup(id);
+	if (!data)
+		return -ENXIO;
+
+	if (data->level >= 0)
+		wheel.count--;
+
+	wheel_unlink(data);
+
+	wheel.table[id - 1] = NULL;
+	wheel.free_ids[wheel.free_count++] = id;
+
+	timeout_free(data);
+
+	return 0;
 }
@@ -24,6 +24,8 @@ void mainloop_exit_success(void);
 void mainloop_exit_failure(void);
 int mainloop_run(void);
 int mainloop_run_with_signal(mainloop_signal_func func, void *user_data);
+int mainloop_set_max_events(unsigned int max);
+int mainloop_set_busy_poll(unsigned int usec);
 
 int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 				void *user_data, mainloop_destroy_func destroy);
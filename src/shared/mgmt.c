@@ -12,10 +12,13 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
 
 #include "lib/bluetooth.h"
 #include "lib/mgmt.h"
@@ -26,6 +29,7 @@
 #include "src/shared/util.h"
 #include "src/shared/mgmt.h"
 #include "src/shared/timeout.h"
+#include "src/shared/trace.h"
 
 #define DBG(_mgmt, _format, arg...) \
 	mgmt_log(_mgmt, "%s:%s() " _format, __FILE__, __func__, ## arg)
@@ -40,12 +44,22 @@ struct mgmt {
 	struct queue *reply_queue;
 	struct queue *pending_list;
 	struct queue *notify_list;
+	struct queue *notify_buckets;
+	struct queue *pipelined;
+	struct queue *stats;
+	struct queue *index_stats;
+	unsigned int max_pending;
 	unsigned int next_request_id;
 	unsigned int next_notify_id;
 	bool need_notify_cleanup;
 	bool in_notify;
+	bool in_batch;
 	void *buf;
 	uint16_t len;
+	unsigned int batch;
+	void *batch_buf;
+	struct mmsghdr *batch_msgs;
+	struct iovec *batch_iov;
 	uint16_t mtu;
 	mgmt_debug_func_t debug_callback;
 	mgmt_destroy_func_t debug_destroy;
@@ -64,6 +78,21 @@ struct mgmt_request {
 	void *user_data;
 	int timeout;
 	unsigned int timeout_id;
+	bool pipelined;
+	uint64_t sent;
+};
+
+struct mgmt_stats {
+	uint16_t opcode;
+	unsigned int count;
+	uint64_t total;
+	uint64_t max;
+};
+
+struct mgmt_index_stats {
+	uint16_t index;
+	uint64_t commands;
+	uint64_t events;
 };
 
 struct mgmt_notify {
@@ -76,6 +105,12 @@ struct mgmt_notify {
 	void *user_data;
 };
 
+/* Handlers of one event code, in registration order */
+struct mgmt_notify_bucket {
+	uint16_t event;
+	struct queue *notify_list;
+};
+
 struct mgmt_tlv_list {
 	struct queue *tlv_queue;
 	uint16_t size;
@@ -129,14 +164,6 @@ static bool match_notify_id(const void *a, const void *b)
 	return notify->id == id;
 }
 
-static bool match_notify_index(const void *a, const void *b)
-{
-	const struct mgmt_notify *notify = a;
-	uint16_t index = PTR_TO_UINT(b);
-
-	return notify->index == index;
-}
-
 static bool match_notify_removed(const void *a, const void *b)
 {
 	const struct mgmt_notify *notify = a;
@@ -147,12 +174,59 @@ static bool match_notify_removed(const void *a, const void *b)
 static void mark_notify_removed(void *data , void *user_data)
 {
 	struct mgmt_notify *notify = data;
-	uint16_t index = PTR_TO_UINT(user_data);
+	const uint16_t *index = user_data;
 
-	if (notify->index == index || index == MGMT_INDEX_NONE)
+	if (!index || notify->index == *index)
 		notify->removed = true;
 }
 
+static unsigned int notify_bucket_hash(const void *data)
+{
+	const struct mgmt_notify_bucket *bucket = data;
+
+	return bucket->event;
+}
+
+static bool match_bucket_event(const void *a, const void *b)
+{
+	const struct mgmt_notify_bucket *bucket = a;
+	uint16_t event = PTR_TO_UINT(b);
+
+	return bucket->event == event;
+}
+
+static struct mgmt_notify_bucket *find_bucket(struct mgmt *mgmt,
+							uint16_t event)
+{
+	return queue_find_hash(mgmt->notify_buckets, event,
+				match_bucket_event, UINT_TO_PTR(event));
+}
+
+static void destroy_bucket(void *data)
+{
+	struct mgmt_notify_bucket *bucket = data;
+
+	queue_destroy(bucket->notify_list, NULL);
+	free(bucket);
+}
+
+static void bucket_remove_notify(void *data, void *user_data)
+{
+	struct mgmt_notify_bucket *bucket = data;
+
+	queue_remove_all(bucket->notify_list, match_notify_removed, NULL,
+									NULL);
+}
+
+/* Drop the handlers marked as removed from both the buckets and the list */
+static void notify_cleanup(struct mgmt *mgmt)
+{
+	queue_foreach(mgmt->notify_buckets, bucket_remove_notify, NULL);
+	queue_remove_all(mgmt->notify_list, match_notify_removed, NULL,
+							destroy_notify);
+	mgmt->need_notify_cleanup = false;
+}
+
 static void write_watch_destroy(void *user_data)
 {
 	struct mgmt *mgmt = user_data;
@@ -192,6 +266,76 @@ static void mgmt_log(struct mgmt *mgmt, const char *format, ...)
 	va_end(ap);
 }
 
+static uint64_t get_time_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static bool match_stats_opcode(const void *a, const void *b)
+{
+	const struct mgmt_stats *stats = a;
+	uint16_t opcode = PTR_TO_UINT(b);
+
+	return stats->opcode == opcode;
+}
+
+static bool match_index_stats(const void *a, const void *b)
+{
+	const struct mgmt_index_stats *stats = a;
+
+	return stats->index == PTR_TO_UINT(b);
+}
+
+static void update_index_stats(struct mgmt *mgmt, uint16_t index,
+							bool event)
+{
+	struct mgmt_index_stats *stats;
+
+	stats = queue_find(mgmt->index_stats, match_index_stats,
+							UINT_TO_PTR(index));
+	if (!stats) {
+		stats = new0(struct mgmt_index_stats, 1);
+		stats->index = index;
+		queue_push_tail(mgmt->index_stats, stats);
+	}
+
+	if (event)
+		stats->events++;
+	else
+		stats->commands++;
+}
+
+static void update_stats(struct mgmt *mgmt, struct mgmt_request *request)
+{
+	struct mgmt_stats *stats;
+	uint64_t rtt;
+
+	if (!request->sent)
+		return;
+
+	rtt = get_time_usec() - request->sent;
+
+	stats = queue_find(mgmt->stats, match_stats_opcode,
+					UINT_TO_PTR(request->opcode));
+	if (!stats) {
+		stats = new0(struct mgmt_stats, 1);
+		stats->opcode = request->opcode;
+		queue_push_tail(mgmt->stats, stats);
+	}
+
+	stats->count++;
+	stats->total += rtt;
+	if (rtt > stats->max)
+		stats->max = rtt;
+
+	DBG(mgmt, "[0x%04x] command 0x%04x rtt %llu usec", request->index,
+				request->opcode, (unsigned long long) rtt);
+}
+
 static bool send_request(struct mgmt *mgmt, struct mgmt_request *request)
 {
 	struct iovec iov;
@@ -211,6 +355,10 @@ static bool send_request(struct mgmt *mgmt, struct mgmt_request *request)
 		return false;
 	}
 
+	BT_TRACE2(mgmt_send, request->opcode, request->index);
+
+	update_index_stats(mgmt, request->index, false);
+
 	if (request->timeout)
 		request->timeout_id = timeout_add_seconds(request->timeout,
 							request_timeout,
@@ -219,11 +367,53 @@ static bool send_request(struct mgmt *mgmt, struct mgmt_request *request)
 
 	DBG(mgmt, "[0x%04x] command 0x%04x", request->index, request->opcode);
 
+	request->sent = get_time_usec();
+
 	queue_push_tail(mgmt->pending_list, request);
 
 	return true;
 }
 
+struct pending_index {
+	uint16_t index;
+	unsigned int count;
+	bool blocked;
+};
+
+static void count_pending(void *data, void *user_data)
+{
+	struct mgmt_request *request = data;
+	struct pending_index *match = user_data;
+
+	if (!request->pipelined)
+		match->blocked = true;
+
+	if (request->index == match->index)
+		match->count++;
+}
+
+static bool can_send_request(struct mgmt *mgmt, struct mgmt_request *request)
+{
+	struct pending_index match;
+
+	if (queue_isempty(mgmt->pending_list))
+		return true;
+
+	/* Only pipelined commands may be sent while others are pending, and
+	 * only as long as every pending command is pipelined as well.
+	 */
+	if (!request->pipelined)
+		return false;
+
+	match.index = request->index;
+	match.count = 0;
+	match.blocked = false;
+
+	queue_foreach(mgmt->pending_list, count_pending, &match);
+
+	return !match.blocked && match.count < mgmt->max_pending;
+}
+
 static bool can_write_data(struct io *io, void *user_data)
 {
 	struct mgmt *mgmt = user_data;
@@ -232,15 +422,14 @@ static bool can_write_data(struct io *io, void *user_data)
 
 	request = queue_pop_head(mgmt->reply_queue);
 	if (!request) {
-		/* only reply commands can jump the queue */
-		if (!queue_isempty(mgmt->pending_list))
+		/* only reply and pipelined commands can jump the queue */
+		request = queue_peek_head(mgmt->request_queue);
+		if (!request || !can_send_request(mgmt, request))
 			return false;
 
-		request = queue_pop_head(mgmt->request_queue);
-		if (!request)
-			return false;
+		queue_pop_head(mgmt->request_queue);
 
-		can_write = false;
+		can_write = !queue_isempty(mgmt->request_queue);
 	} else {
 		/* allow multiple replies to jump the queue */
 		can_write = !queue_isempty(mgmt->reply_queue);
@@ -255,8 +444,12 @@ static bool can_write_data(struct io *io, void *user_data)
 static void wakeup_writer(struct mgmt *mgmt)
 {
 	if (!queue_isempty(mgmt->pending_list)) {
-		/* only queued reply commands trigger wakeup */
-		if (queue_isempty(mgmt->reply_queue))
+		struct mgmt_request *request;
+
+		/* only queued reply or pipelined commands trigger wakeup */
+		request = queue_peek_head(mgmt->request_queue);
+		if (queue_isempty(mgmt->reply_queue) && (!request ||
+					!can_send_request(mgmt, request)))
 			return;
 	}
 
@@ -290,6 +483,8 @@ static void request_complete(struct mgmt *mgmt, uint8_t status,
 	struct opcode_index match = { .opcode = opcode, .index = index };
 	struct mgmt_request *request;
 
+	BT_TRACE3(mgmt_complete, opcode, index, status);
+
 	request = queue_remove_if(mgmt->pending_list,
 					match_request_opcode_index, &match);
 	if (!request) {
@@ -302,6 +497,8 @@ static void request_complete(struct mgmt *mgmt, uint8_t status,
 	}
 
 	if (request) {
+		update_stats(mgmt, request);
+
 		if (request->callback)
 			request->callback(status, length, param,
 							request->user_data);
@@ -327,9 +524,6 @@ static void notify_handler(void *data, void *user_data)
 	if (notify->removed)
 		return;
 
-	if (notify->event != match->event)
-		return;
-
 	if (notify->index != match->index && notify->index != MGMT_INDEX_NONE)
 		return;
 
@@ -343,59 +537,56 @@ static void process_notify(struct mgmt *mgmt, uint16_t event, uint16_t index,
 {
 	struct event_index match = { .event = event, .index = index,
 					.length = length, .param = param };
+	struct mgmt_notify_bucket *bucket;
+
+	/* Only the handlers registered for this event code are visited */
+	bucket = find_bucket(mgmt, event);
+	if (!bucket)
+		return;
 
 	mgmt->in_notify = true;
 
-	queue_foreach(mgmt->notify_list, notify_handler, &match);
+	queue_foreach(bucket->notify_list, notify_handler, &match);
 
 	mgmt->in_notify = false;
 
-	if (mgmt->need_notify_cleanup) {
-		queue_remove_all(mgmt->notify_list, match_notify_removed,
-							NULL, destroy_notify);
-		mgmt->need_notify_cleanup = false;
-	}
+	if (mgmt->need_notify_cleanup)
+		notify_cleanup(mgmt);
 }
 
-static bool can_read_data(struct io *io, void *user_data)
+static void process_event(struct mgmt *mgmt, const void *buf,
+							ssize_t bytes_read)
 {
-	struct mgmt *mgmt = user_data;
-	struct mgmt_hdr *hdr;
-	struct mgmt_ev_cmd_complete *cc;
-	struct mgmt_ev_cmd_status *cs;
-	ssize_t bytes_read;
+	const struct mgmt_hdr *hdr = buf;
+	const struct mgmt_ev_cmd_complete *cc;
+	const struct mgmt_ev_cmd_status *cs;
 	uint16_t opcode, event, index, length;
 
-	bytes_read = read(mgmt->fd, mgmt->buf, mgmt->len);
-	if (bytes_read < 0)
-		return false;
-
 	if (bytes_read < MGMT_HDR_SIZE)
-		return true;
+		return;
 
-	hdr = mgmt->buf;
 	event = btohs(hdr->opcode);
 	index = btohs(hdr->index);
 	length = btohs(hdr->len);
 
 	if (bytes_read < length + MGMT_HDR_SIZE)
-		return true;
+		return;
 
-	mgmt_ref(mgmt);
+	update_index_stats(mgmt, index, true);
 
 	switch (event) {
 	case MGMT_EV_CMD_COMPLETE:
-		cc = mgmt->buf + MGMT_HDR_SIZE;
+		cc = buf + MGMT_HDR_SIZE;
 		opcode = btohs(cc->opcode);
 
 		DBG(mgmt, "[0x%04x] command 0x%04x complete: 0x%02x",
 						index, opcode, cc->status);
 
 		request_complete(mgmt, cc->status, opcode, index, length - 3,
-						mgmt->buf + MGMT_HDR_SIZE + 3);
+						buf + MGMT_HDR_SIZE + 3);
 		break;
 	case MGMT_EV_CMD_STATUS:
-		cs = mgmt->buf + MGMT_HDR_SIZE;
+		cs = buf + MGMT_HDR_SIZE;
 		opcode = btohs(cs->opcode);
 
 		DBG(mgmt, "[0x%04x] command 0x%02x status: 0x%02x",
@@ -407,15 +598,99 @@ static bool can_read_data(struct io *io, void *user_data)
 		DBG(mgmt, "[0x%04x] event 0x%04x", index, event);
 
 		process_notify(mgmt, event, index, length,
-						mgmt->buf + MGMT_HDR_SIZE);
+						buf + MGMT_HDR_SIZE);
 		break;
 	}
+}
+
+static bool read_batch(struct mgmt *mgmt)
+{
+	unsigned int i;
+	int count;
+
+	count = recvmmsg(mgmt->fd, mgmt->batch_msgs, mgmt->batch,
+							MSG_DONTWAIT, NULL);
+	if (count < 0)
+		return errno == EAGAIN || errno == EINTR;
+
+	mgmt_ref(mgmt);
+	mgmt->in_batch = true;
+
+	/* Stop early once the last external reference has been dropped */
+	for (i = 0; i < (unsigned int) count && mgmt->ref_count > 1; i++)
+		process_event(mgmt, mgmt->batch_iov[i].iov_base,
+						mgmt->batch_msgs[i].msg_len);
+
+	mgmt->in_batch = false;
+	mgmt_unref(mgmt);
+
+	return true;
+}
+
+static bool can_read_data(struct io *io, void *user_data)
+{
+	struct mgmt *mgmt = user_data;
+	ssize_t bytes_read;
+
+	if (mgmt->batch > 1)
+		return read_batch(mgmt);
+
+	bytes_read = read(mgmt->fd, mgmt->buf, mgmt->len);
+	if (bytes_read < 0)
+		return false;
+
+	mgmt_ref(mgmt);
+
+	process_event(mgmt, mgmt->buf, bytes_read);
 
 	mgmt_unref(mgmt);
 
 	return true;
 }
 
+static void free_batch(struct mgmt *mgmt)
+{
+	free(mgmt->batch_msgs);
+	free(mgmt->batch_iov);
+	free(mgmt->batch_buf);
+	mgmt->batch_msgs = NULL;
+	mgmt->batch_iov = NULL;
+	mgmt->batch_buf = NULL;
+	mgmt->batch = 1;
+}
+
+bool mgmt_set_read_batch(struct mgmt *mgmt, unsigned int max)
+{
+	unsigned int i;
+
+	if (!mgmt || !max || mgmt->in_batch)
+		return false;
+
+	free_batch(mgmt);
+
+	if (max == 1)
+		return true;
+
+	mgmt->batch_buf = malloc((size_t) max * mgmt->len);
+	mgmt->batch_msgs = calloc(max, sizeof(*mgmt->batch_msgs));
+	mgmt->batch_iov = calloc(max, sizeof(*mgmt->batch_iov));
+	if (!mgmt->batch_buf || !mgmt->batch_msgs || !mgmt->batch_iov) {
+		free_batch(mgmt);
+		return false;
+	}
+
+	for (i = 0; i < max; i++) {
+		mgmt->batch_iov[i].iov_base = mgmt->batch_buf + i * mgmt->len;
+		mgmt->batch_iov[i].iov_len = mgmt->len;
+		mgmt->batch_msgs[i].msg_hdr.msg_iov = &mgmt->batch_iov[i];
+		mgmt->batch_msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	mgmt->batch = max;
+
+	return true;
+}
+
 static void mgmt_set_mtu(struct mgmt *mgmt)
 {
 	socklen_t len = 0;
@@ -471,8 +746,19 @@ struct mgmt *mgmt_new(int fd)
 	mgmt->reply_queue = queue_new();
 	mgmt->pending_list = queue_new();
 	mgmt->notify_list = queue_new();
+	mgmt->notify_buckets = queue_new();
+	queue_set_hash(mgmt->notify_buckets, notify_bucket_hash);
+	mgmt->pipelined = queue_new();
+	mgmt->stats = queue_new();
+	mgmt->index_stats = queue_new();
+	mgmt->max_pending = 1;
+	mgmt->batch = 1;
 
 	if (!io_set_read_handler(mgmt->io, can_read_data, mgmt, NULL)) {
+		queue_destroy(mgmt->index_stats, NULL);
+		queue_destroy(mgmt->stats, NULL);
+		queue_destroy(mgmt->pipelined, NULL);
+		queue_destroy(mgmt->notify_buckets, NULL);
 		queue_destroy(mgmt->notify_list, NULL);
 		queue_destroy(mgmt->pending_list, NULL);
 		queue_destroy(mgmt->reply_queue, NULL);
@@ -548,6 +834,9 @@ void mgmt_unref(struct mgmt *mgmt)
 
 	queue_destroy(mgmt->reply_queue, NULL);
 	queue_destroy(mgmt->request_queue, NULL);
+	queue_destroy(mgmt->pipelined, NULL);
+	queue_destroy(mgmt->stats, free);
+	queue_destroy(mgmt->index_stats, free);
 
 	io_set_write_handler(mgmt->io, NULL, NULL, NULL);
 	io_set_read_handler(mgmt->io, NULL, NULL, NULL);
@@ -563,8 +852,10 @@ void mgmt_unref(struct mgmt *mgmt)
 
 	free(mgmt->buf);
 	mgmt->buf = NULL;
+	free_batch(mgmt);
 
 	if (!mgmt->in_notify) {
+		queue_destroy(mgmt->notify_buckets, destroy_bucket);
 		queue_destroy(mgmt->notify_list, NULL);
 		queue_destroy(mgmt->pending_list, NULL);
 		free(mgmt);
@@ -646,6 +937,8 @@ static struct mgmt_request *create_request(struct mgmt *mgmt, uint16_t opcode,
 	request->destroy = destroy;
 	request->user_data = user_data;
 	request->timeout = timeout;
+	request->pipelined = queue_find(mgmt->pipelined, NULL,
+							UINT_TO_PTR(opcode));
 
 	return request;
 }
@@ -948,10 +1241,19 @@ unsigned int mgmt_register(struct mgmt *mgmt, uint16_t event, uint16_t index,
 				void *user_data, mgmt_destroy_func_t destroy)
 {
 	struct mgmt_notify *notify;
+	struct mgmt_notify_bucket *bucket;
 
 	if (!mgmt || !event)
 		return 0;
 
+	bucket = find_bucket(mgmt, event);
+	if (!bucket) {
+		bucket = new0(struct mgmt_notify_bucket, 1);
+		bucket->event = event;
+		bucket->notify_list = queue_new();
+		queue_push_tail(mgmt->notify_buckets, bucket);
+	}
+
 	notify = new0(struct mgmt_notify, 1);
 	notify->event = event;
 	notify->index = index;
@@ -970,6 +1272,8 @@ unsigned int mgmt_register(struct mgmt *mgmt, uint16_t event, uint16_t index,
 		return 0;
 	}
 
+	queue_push_tail(bucket->notify_list, notify);
+
 	return notify->id;
 }
 
@@ -980,12 +1284,15 @@ bool mgmt_unregister(struct mgmt *mgmt, unsigned int id)
 	if (!mgmt || !id)
 		return false;
 
-	notify = queue_remove_if(mgmt->notify_list, match_notify_id,
+	notify = queue_find(mgmt->notify_list, match_notify_id,
 							UINT_TO_PTR(id));
-	if (!notify)
+	if (!notify || notify->removed)
 		return false;
 
 	if (!mgmt->in_notify) {
+		queue_remove(mgmt->notify_list, notify);
+		queue_remove(find_bucket(mgmt, notify->event)->notify_list,
+								notify);
 		destroy_notify(notify);
 		return true;
 	}
@@ -1001,13 +1308,12 @@ bool mgmt_unregister_index(struct mgmt *mgmt, uint16_t index)
 	if (!mgmt)
 		return false;
 
-	if (mgmt->in_notify) {
-		queue_foreach(mgmt->notify_list, mark_notify_removed,
-							UINT_TO_PTR(index));
+	queue_foreach(mgmt->notify_list, mark_notify_removed, &index);
+
+	if (mgmt->in_notify)
 		mgmt->need_notify_cleanup = true;
-	} else
-		queue_remove_all(mgmt->notify_list, match_notify_index,
-					UINT_TO_PTR(index), destroy_notify);
+	else
+		notify_cleanup(mgmt);
 
 	return true;
 }
@@ -1017,12 +1323,12 @@ bool mgmt_unregister_all(struct mgmt *mgmt)
 	if (!mgmt)
 		return false;
 
-	if (mgmt->in_notify) {
-		queue_foreach(mgmt->notify_list, mark_notify_removed,
-						UINT_TO_PTR(MGMT_INDEX_NONE));
+	queue_foreach(mgmt->notify_list, mark_notify_removed, NULL);
+
+	if (mgmt->in_notify)
 		mgmt->need_notify_cleanup = true;
-	} else
-		queue_remove_all(mgmt->notify_list, NULL, NULL, destroy_notify);
+	else
+		notify_cleanup(mgmt);
 
 	return true;
 }
@@ -1034,3 +1340,79 @@ uint16_t mgmt_get_mtu(struct mgmt *mgmt)
 
 	return mgmt->mtu;
 }
+
+bool mgmt_set_max_pending(struct mgmt *mgmt, unsigned int max)
+{
+	if (!mgmt || !max)
+		return false;
+
+	mgmt->max_pending = max;
+
+	wakeup_writer(mgmt);
+
+	return true;
+}
+
+bool mgmt_set_pipelined(struct mgmt *mgmt, uint16_t opcode, bool enable)
+{
+	if (!mgmt || !opcode)
+		return false;
+
+	if (!enable)
+		return queue_remove(mgmt->pipelined, UINT_TO_PTR(opcode));
+
+	if (queue_find(mgmt->pipelined, NULL, UINT_TO_PTR(opcode)))
+		return true;
+
+	return queue_push_tail(mgmt->pipelined, UINT_TO_PTR(opcode));
+}
+
+struct stats_foreach {
+	mgmt_stats_func_t func;
+	void *user_data;
+};
+
+static void stats_foreach(void *data, void *user_data)
+{
+	struct mgmt_stats *stats = data;
+	struct stats_foreach *foreach = user_data;
+
+	foreach->func(stats->opcode, stats->count, stats->total, stats->max,
+							foreach->user_data);
+}
+
+bool mgmt_get_index_stats(struct mgmt *mgmt, uint16_t index,
+				uint64_t *commands, uint64_t *events)
+{
+	struct mgmt_index_stats *stats;
+
+	if (!mgmt)
+		return false;
+
+	stats = queue_find(mgmt->index_stats, match_index_stats,
+							UINT_TO_PTR(index));
+
+	if (commands)
+		*commands = stats ? stats->commands : 0;
+
+	if (events)
+		*events = stats ? stats->events : 0;
+
+	return true;
+}
+
+bool mgmt_foreach_stats(struct mgmt *mgmt, mgmt_stats_func_t func,
+							void *user_data)
+{
+	struct stats_foreach foreach;
+
+	if (!mgmt || !func)
+		return false;
+
+	foreach.func = func;
+	foreach.user_data = user_data;
+
+	queue_foreach(mgmt->stats, stats_foreach, &foreach);
+
+	return true;
+}
@@ -30,6 +30,7 @@ bool mgmt_set_debug(struct mgmt *mgmt, mgmt_debug_func_t callback,
 				void *user_data, mgmt_destroy_func_t destroy);
 
 bool mgmt_set_close_on_unref(struct mgmt *mgmt, bool do_close);
+bool mgmt_set_read_batch(struct mgmt *mgmt, unsigned int max);
 
 typedef void (*mgmt_request_func_t)(uint8_t status, uint16_t length,
 					const void *param, void *user_data);
@@ -88,3 +89,14 @@ bool mgmt_unregister_index(struct mgmt *mgmt, uint16_t index);
 bool mgmt_unregister_all(struct mgmt *mgmt);
 
 uint16_t mgmt_get_mtu(struct mgmt *mgmt);
+
+bool mgmt_set_max_pending(struct mgmt *mgmt, unsigned int max);
+bool mgmt_set_pipelined(struct mgmt *mgmt, uint16_t opcode, bool enable);
+
+typedef void (*mgmt_stats_func_t)(uint16_t opcode, unsigned int count,
+					uint64_t total_usec, uint64_t max_usec,
+					void *user_data);
+bool mgmt_foreach_stats(struct mgmt *mgmt, mgmt_stats_func_t func,
+							void *user_data);
+bool mgmt_get_index_stats(struct mgmt *mgmt, uint16_t index,
+				uint64_t *commands, uint64_t *events);
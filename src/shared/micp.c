@@ -722,6 +722,9 @@ static void micp_mute_state_notify(struct bt_micp *micp, uint16_t value_handle,
 	memcpy(&mute_state, value, sizeof(mute_state));
 
 	DBG(micp, "Mute state: 0x%x", mute_state);
+
+	micp->mute = mute_state;
+	micp->mute_cached = true;
 }
 
 static void read_mute_state(struct bt_micp *micp, bool success,
@@ -746,6 +749,12 @@ static void read_mute_state(struct bt_micp *micp, bool success,
 	}
 
 	DBG(micp, "Mute state: %x", *mute_state);
+
+	if (micp->mute_cached && micp->mute != *mute_state)
+		DBG(micp, "Cached Mute state 0x%x outdated", micp->mute);
+
+	micp->mute = *mute_state;
+	micp->mute_cached = true;
 }
 
 static void foreach_mics_char(struct gatt_db_attribute *attr, void *user_data)
@@ -765,15 +774,15 @@ static void foreach_mics_char(struct gatt_db_attribute *attr, void *user_data)
 				value_handle);
 
 		mics = micp_get_mics(micp);
-		if (!mics || mics->ms)
+		if (!mics || (mics->ms && mics->ms != attr))
 			return;
 
 		mics->ms = attr;
 
-		micp_read_value(micp, value_handle, read_mute_state, micp);
-
 		micp->mute_id = micp_register_notify(micp, value_handle,
 						micp_mute_state_notify, NULL);
+
+		micp_read_value(micp, value_handle, read_mute_state, micp);
 	}
 }
 
@@ -885,10 +894,20 @@ bool bt_micp_attach(struct bt_micp *micp, struct bt_gatt_client *client)
 	if (!micp->client)
 		return false;
 
-	bt_gatt_client_idle_register(micp->client, micp_idle, micp, NULL);
-
 	bt_uuid16_create(&uuid, MICS_UUID);
 	gatt_db_foreach_service(micp->ldb->db, &uuid, foreach_mics_service,
 						micp);
+
+	/* With the state cached from the last connection there is no need
+	 * to wait for the reads, they only verify it.
+	 */
+	if (micp->mute_cached) {
+		micp_notify_ready(micp);
+		return true;
+	}
+
+	micp->idle_id = bt_gatt_client_idle_register(micp->client, micp_idle,
+								micp, NULL);
+
 	return true;
 }
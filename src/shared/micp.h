@@ -43,6 +43,7 @@ struct bt_micp {
 
 	unsigned int idle_id;
 	uint8_t mute;
+	bool mute_cached;
 
 	struct queue *notify;
 	struct queue *pending;
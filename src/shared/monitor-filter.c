@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2011-2014  Intel Corporation
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+#include "src/shared/util.h"
+#include "src/shared/btsnoop.h"
+#include "src/shared/monitor-filter.h"
+
+#define MONITOR_HDR_SIZE	6
+#define MONITOR_INDEX_NONE	0xffff
+
+#define FILTER_PASS		0x0fffffff
+#define FILTER_MAX		20
+
+#define HCI_OPCODES	(MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_COMMAND_PKT) | \
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_EVENT_PKT) | \
+			DATA_OPCODES)
+
+#define DATA_OPCODES	(MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ACL_TX_PKT) | \
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ACL_RX_PKT) | \
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_SCO_TX_PKT) | \
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_SCO_RX_PKT) | \
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ISO_TX_PKT) | \
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ISO_RX_PKT))
+
+static const struct {
+	const char *str;
+	uint32_t opcodes;
+} type_table[] = {
+	{ "cmd", MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_COMMAND_PKT) },
+	{ "evt", MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_EVENT_PKT) },
+	{ "acl", MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ACL_TX_PKT) |
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ACL_RX_PKT) },
+	{ "sco", MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_SCO_TX_PKT) |
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_SCO_RX_PKT) },
+	{ "iso", MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ISO_TX_PKT) |
+			MONITOR_FILTER_OPCODE(BTSNOOP_OPCODE_ISO_RX_PKT) },
+	{ }
+};
+
+/*
+ * Parse a comma separated list of HCI packet types. Frames that are not
+ * HCI packets (index, logging and control frames) are always selected.
+ */
+bool monitor_filter_parse_types(const char *str, uint32_t *opcodes)
+{
+	char *list, *type, *saveptr;
+	bool result = true;
+	int i;
+
+	list = strdup(str);
+	if (!list)
+		return false;
+
+	*opcodes = MONITOR_FILTER_ALL & ~HCI_OPCODES;
+
+	for (type = strtok_r(list, ",", &saveptr); type;
+				type = strtok_r(NULL, ",", &saveptr)) {
+		for (i = 0; type_table[i].str; i++) {
+			if (!strcmp(type, type_table[i].str))
+				break;
+		}
+
+		if (!type_table[i].str) {
+			result = false;
+			break;
+		}
+
+		*opcodes |= type_table[i].opcodes;
+	}
+
+	free(list);
+
+	return result;
+}
+
+/*
+ * Attach a classic BPF program to a monitor channel socket so that frames
+ * of other controllers or unwanted packet types are dropped in the kernel.
+ * HCI data frames can additionally be truncated to snaplen bytes of
+ * payload. Frames without an index are always passed.
+ */
+bool monitor_filter_attach(int fd, uint16_t index, uint32_t opcodes,
+							uint16_t snaplen)
+{
+	struct sock_filter filters[FILTER_MAX];
+	struct sock_fprog fprog;
+	struct {
+		unsigned int pos;
+		bool on_true;
+		bool to_pass;
+	} jumps[FILTER_MAX];
+	unsigned int len = 0, njumps = 0, pass, reject, i;
+
+	if (index == MONITOR_INDEX_NONE && opcodes == MONITOR_FILTER_ALL &&
+								!snaplen)
+		return true;
+
+#define ADD_STMT(code, k) \
+	(filters[len++] = (struct sock_filter) BPF_STMT(code, k))
+#define ADD_JUMP(code, k, on_true, to_pass) \
+	(jumps[njumps++] = (typeof(jumps[0])) { len, on_true, to_pass }, \
+	filters[len++] = (struct sock_filter) BPF_JUMP(code, k, 0, 0))
+
+	if (index != MONITOR_INDEX_NONE) {
+		/* A <- index, loaded in network order */
+		ADD_STMT(BPF_LD + BPF_H + BPF_ABS, 2);
+		ADD_JUMP(BPF_JMP + BPF_JEQ + BPF_K, MONITOR_INDEX_NONE,
+								true, true);
+		ADD_JUMP(BPF_JMP + BPF_JEQ + BPF_K, bswap_16(index),
+								false, false);
+	}
+
+	/* A <- opcode, all defined opcodes fit into the low byte */
+	ADD_STMT(BPF_LD + BPF_B + BPF_ABS, 0);
+	ADD_JUMP(BPF_JMP + BPF_JGE + BPF_K, 32, true, true);
+
+	/* X <- 1 << opcode */
+	ADD_STMT(BPF_MISC + BPF_TAX, 0);
+	ADD_STMT(BPF_LD + BPF_IMM, 1);
+	ADD_STMT(BPF_ALU + BPF_LSH + BPF_X, 0);
+	ADD_STMT(BPF_MISC + BPF_TAX, 0);
+
+	if (opcodes != MONITOR_FILTER_ALL) {
+		ADD_STMT(BPF_ALU + BPF_AND + BPF_K, opcodes);
+		ADD_JUMP(BPF_JMP + BPF_JEQ + BPF_K, 0, true, false);
+	}
+
+	if (snaplen) {
+		ADD_STMT(BPF_MISC + BPF_TXA, 0);
+		ADD_STMT(BPF_ALU + BPF_AND + BPF_K, DATA_OPCODES);
+		ADD_JUMP(BPF_JMP + BPF_JEQ + BPF_K, 0, true, true);
+		ADD_STMT(BPF_RET + BPF_K, MONITOR_HDR_SIZE + snaplen);
+	}
+
+	pass = len;
+	ADD_STMT(BPF_RET + BPF_K, FILTER_PASS);
+	reject = len;
+	ADD_STMT(BPF_RET + BPF_K, 0);
+
+#undef ADD_STMT
+#undef ADD_JUMP
+
+	/* Jump offsets are relative to the next instruction */
+	for (i = 0; i < njumps; i++) {
+		struct sock_filter *f = &filters[jumps[i].pos];
+		unsigned int target = jumps[i].to_pass ? pass : reject;
+
+		if (jumps[i].on_true)
+			f->jt = target - jumps[i].pos - 1;
+		else
+			f->jf = target - jumps[i].pos - 1;
+	}
+
+	fprog.len = len;
+	fprog.filter = filters;
+
+	return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+							sizeof(fprog)) == 0;
+}
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2011-2014  Intel Corporation
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MONITOR_FILTER_OPCODE(op)	(1u << (op))
+#define MONITOR_FILTER_ALL		0xffffffff
+
+bool monitor_filter_attach(int fd, uint16_t index, uint32_t opcodes,
+							uint16_t snaplen);
+bool monitor_filter_parse_types(const char *str, uint32_t *opcodes);
@@ -15,13 +15,149 @@
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
 
+#define QUEUE_HASH_MIN_SIZE	16
+#define QUEUE_ENTRY_POOL_MAX	256
+
+struct queue_hash_entry {
+	void *data;
+	unsigned int hash;
+	struct queue_hash_entry *next;
+};
+
+struct queue_hash {
+	queue_hash_func_t func;
+	struct queue_hash_entry **buckets;
+	unsigned int size;
+};
+
 struct queue {
 	int ref_count;
 	struct queue_entry *head;
 	struct queue_entry *tail;
 	unsigned int entries;
+	struct queue_hash *hash;
 };
 
+static __thread struct util_pool entry_pool =
+			UTIL_POOL_INIT(struct queue_entry, QUEUE_ENTRY_POOL_MAX);
+static __thread struct util_pool hash_entry_pool =
+		UTIL_POOL_INIT(struct queue_hash_entry, QUEUE_ENTRY_POOL_MAX);
+
+static void queue_hash_clear(struct queue_hash *hash)
+{
+	unsigned int i;
+
+	for (i = 0; i < hash->size; i++) {
+		struct queue_hash_entry *entry = hash->buckets[i];
+
+		while (entry) {
+			struct queue_hash_entry *tmp = entry;
+
+			entry = entry->next;
+			util_pool_release(&hash_entry_pool, tmp);
+		}
+
+		hash->buckets[i] = NULL;
+	}
+}
+
+static void queue_hash_free(struct queue_hash *hash)
+{
+	if (!hash)
+		return;
+
+	queue_hash_clear(hash);
+	free(hash->buckets);
+	free(hash);
+}
+
+static void queue_hash_resize(struct queue_hash *hash, unsigned int size)
+{
+	struct queue_hash_entry **buckets;
+	unsigned int i;
+
+	buckets = new0(struct queue_hash_entry *, size);
+
+	for (i = 0; i < hash->size; i++) {
+		struct queue_hash_entry *entry = hash->buckets[i];
+
+		while (entry) {
+			struct queue_hash_entry *next = entry->next;
+			unsigned int idx = entry->hash & (size - 1);
+
+			entry->next = buckets[idx];
+			buckets[idx] = entry;
+			entry = next;
+		}
+	}
+
+	free(hash->buckets);
+	hash->buckets = buckets;
+	hash->size = size;
+}
+
+static void queue_hash_add(struct queue *queue, void *data)
+{
+	struct queue_hash *hash = queue->hash;
+	struct queue_hash_entry *entry;
+	unsigned int idx;
+
+	if (!hash)
+		return;
+
+	/* Keep the average chain length below two */
+	if (queue->entries > hash->size * 2)
+		queue_hash_resize(hash, hash->size * 2);
+
+	entry = util_pool_alloc(&hash_entry_pool);
+	entry->data = data;
+	entry->hash = hash->func(data);
+
+	idx = entry->hash & (hash->size - 1);
+	entry->next = hash->buckets[idx];
+	hash->buckets[idx] = entry;
+}
+
+static bool queue_hash_unlink(struct queue_hash *hash, unsigned int idx,
+								void *data)
+{
+	struct queue_hash_entry *entry, *prev = NULL;
+
+	for (entry = hash->buckets[idx]; entry;
+					prev = entry, entry = entry->next) {
+		if (entry->data != data)
+			continue;
+
+		if (prev)
+			prev->next = entry->next;
+		else
+			hash->buckets[idx] = entry->next;
+
+		util_pool_release(&hash_entry_pool, entry);
+
+		return true;
+	}
+
+	return false;
+}
+
+static void queue_hash_remove(struct queue *queue, void *data)
+{
+	struct queue_hash *hash = queue->hash;
+	unsigned int i;
+
+	if (!hash)
+		return;
+
+	if (queue_hash_unlink(hash, hash->func(data) & (hash->size - 1), data))
+		return;
+
+	/* The key has changed since insertion, look in every bucket */
+	for (i = 0; i < hash->size; i++)
+		if (queue_hash_unlink(hash, i, data))
+			return;
+}
+
 static struct queue *queue_ref(struct queue *queue)
 {
 	if (!queue)
@@ -37,6 +173,7 @@ static void queue_unref(struct queue *queue)
 	if (__sync_sub_and_fetch(&queue->ref_count, 1))
 		return;
 
+	queue_hash_free(queue->hash);
 	free(queue);
 }
 
@@ -66,12 +203,17 @@ static struct queue_entry *queue_entry_new(void *data)
 {
 	struct queue_entry *entry;
 
-	entry = new0(struct queue_entry, 1);
+	entry = util_pool_alloc(&entry_pool);
 	entry->data = data;
 
 	return entry;
 }
 
+static void queue_entry_free(struct queue_entry *entry)
+{
+	util_pool_release(&entry_pool, entry);
+}
+
 bool queue_push_tail(struct queue *queue, void *data)
 {
 	struct queue_entry *entry;
@@ -89,6 +231,7 @@ bool queue_push_tail(struct queue *queue, void *data)
 	if (!queue->head)
 		queue->head = entry;
 
+	queue_hash_add(queue, data);
 	queue->entries++;
 
 	return true;
@@ -110,6 +253,7 @@ bool queue_push_head(struct queue *queue, void *data)
 	if (!queue->tail)
 		queue->tail = entry;
 
+	queue_hash_add(queue, data);
 	queue->entries++;
 
 	return true;
@@ -142,6 +286,8 @@ bool queue_push_after(struct queue *queue, void *entry, void *data)
 		queue->tail = new_entry;
 
 	qentry->next = new_entry;
+
+	queue_hash_add(queue, data);
 	queue->entries++;
 
 	return true;
@@ -165,7 +311,8 @@ void *queue_pop_head(struct queue *queue)
 
 	data = entry->data;
 
-	free(entry);
+	queue_hash_remove(queue, data);
+	queue_entry_free(entry);
 	queue->entries--;
 
 	return data;
@@ -253,7 +400,8 @@ bool queue_remove(struct queue *queue, void *data)
 		if (!entry->next)
 			queue->tail = prev;
 
-		free(entry);
+		queue_hash_remove(queue, data);
+		queue_entry_free(entry);
 		queue->entries--;
 
 		return true;
@@ -289,7 +437,8 @@ void *queue_remove_if(struct queue *queue, queue_match_func_t function,
 
 			data = entry->data;
 
-			free(entry);
+			queue_hash_remove(queue, data);
+			queue_entry_free(entry);
 			queue->entries--;
 
 			return data;
@@ -332,6 +481,9 @@ unsigned int queue_remove_all(struct queue *queue, queue_match_func_t function,
 		queue->tail = NULL;
 		queue->entries = 0;
 
+		if (queue->hash)
+			queue_hash_clear(queue->hash);
+
 		while (entry) {
 			struct queue_entry *tmp = entry;
 
@@ -340,7 +492,7 @@ unsigned int queue_remove_all(struct queue *queue, queue_match_func_t function,
 			if (destroy)
 				destroy(tmp->data);
 
-			free(tmp);
+			queue_entry_free(tmp);
 			count++;
 		}
 	}
@@ -348,6 +500,69 @@ unsigned int queue_remove_all(struct queue *queue, queue_match_func_t function,
 	return count;
 }
 
+bool queue_set_hash(struct queue *queue, queue_hash_func_t function)
+{
+	struct queue_entry *entry;
+	unsigned int size = QUEUE_HASH_MIN_SIZE;
+
+	if (!queue || !function || queue->hash)
+		return false;
+
+	while (size * 2 < queue->entries)
+		size *= 2;
+
+	queue->hash = new0(struct queue_hash, 1);
+	queue->hash->func = function;
+	queue->hash->size = size;
+	queue->hash->buckets = new0(struct queue_hash_entry *, size);
+
+	for (entry = queue->head; entry; entry = entry->next)
+		queue_hash_add(queue, entry->data);
+
+	return true;
+}
+
+void *queue_find_hash(struct queue *queue, unsigned int hash,
+				queue_match_func_t function,
+				const void *match_data)
+{
+	struct queue_hash_entry *entry;
+
+	if (!queue)
+		return NULL;
+
+	if (!queue->hash)
+		return queue_find(queue, function, match_data);
+
+	if (!function)
+		function = direct_match;
+
+	for (entry = queue->hash->buckets[hash & (queue->hash->size - 1)];
+						entry; entry = entry->next) {
+		if (entry->hash != hash)
+			continue;
+
+		if (function(entry->data, match_data))
+			return entry->data;
+	}
+
+	return NULL;
+}
+
+bool queue_rehash(struct queue *queue, void *data)
+{
+	if (!queue || !queue->hash)
+		return false;
+
+	if (!queue_find(queue, NULL, data))
+		return false;
+
+	queue_hash_remove(queue, data);
+	queue_hash_add(queue, data);
+
+	return true;
+}
+
 const struct queue_entry *queue_get_entries(struct queue *queue)
 {
 	if (!queue)
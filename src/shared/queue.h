@@ -45,6 +45,14 @@ void *queue_remove_if(struct queue *queue, queue_match_func_t function,
 unsigned int queue_remove_all(struct queue *queue, queue_match_func_t function,
 				void *user_data, queue_destroy_func_t destroy);
 
+typedef unsigned int (*queue_hash_func_t)(const void *data);
+
+bool queue_set_hash(struct queue *queue, queue_hash_func_t function);
+void *queue_find_hash(struct queue *queue, unsigned int hash,
+				queue_match_func_t function,
+				const void *match_data);
+bool queue_rehash(struct queue *queue, void *data);
+
 const struct queue_entry *queue_get_entries(struct queue *queue);
 
 unsigned int queue_length(struct queue *queue);
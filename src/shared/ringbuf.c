@@ -15,8 +15,12 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include <sys/param.h>
+#include <sys/syscall.h>
 
 #include "src/shared/util.h"
 #include "src/shared/ringbuf.h"
@@ -30,6 +34,7 @@ struct ringbuf {
 	size_t size;
 	size_t in;
 	size_t out;
+	bool mirrored;
 	ringbuf_tracing_func_t in_tracing;
 	void *in_data;
 };
@@ -73,15 +78,110 @@ struct ringbuf *ringbuf_new(size_t size)
 	return ringbuf;
 }
 
+static int ringbuf_memfd(void)
+{
+#ifdef __NR_memfd_create
+	return syscall(__NR_memfd_create, "ringbuf", 0x0001U);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ * Map the same pages twice back to back, so that data wrapping around the
+ * end of the buffer can also be accessed contiguously past its end.
+ */
+static void *mirror_alloc(size_t size)
+{
+	void *addr, *ptr;
+	int fd;
+
+	fd = ringbuf_memfd();
+	if (fd < 0)
+		return NULL;
+
+	if (ftruncate(fd, size) < 0)
+		goto fail;
+
+	addr = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+								-1, 0);
+	if (addr == MAP_FAILED)
+		goto fail;
+
+	ptr = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+								fd, 0);
+	if (ptr != addr)
+		goto unmap;
+
+	ptr = mmap(addr + size, size, PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_FIXED, fd, 0);
+	if (ptr != addr + size)
+		goto unmap;
+
+	close(fd);
+
+	return addr;
+
+unmap:
+	munmap(addr, size * 2);
+fail:
+	close(fd);
+	return NULL;
+}
+
+struct ringbuf *ringbuf_new_mirrored(size_t size)
+{
+	struct ringbuf *ringbuf;
+	size_t real_size;
+	long page_size;
+
+	if (size < 2 || size > UINT_MAX / 2)
+		return NULL;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		return NULL;
+
+	/* Mappings need whole pages, page sizes are powers of two */
+	real_size = MAX(align_power2(size), (size_t) page_size);
+
+	ringbuf = new0(struct ringbuf, 1);
+	ringbuf->buffer = mirror_alloc(real_size);
+	if (!ringbuf->buffer) {
+		free(ringbuf);
+		return NULL;
+	}
+
+	ringbuf->size = real_size;
+	ringbuf->mirrored = true;
+	ringbuf->in = RINGBUF_RESET;
+	ringbuf->out = RINGBUF_RESET;
+
+	return ringbuf;
+}
+
 void ringbuf_free(struct ringbuf *ringbuf)
 {
 	if (!ringbuf)
 		return;
 
-	free(ringbuf->buffer);
+	if (ringbuf->mirrored)
+		munmap(ringbuf->buffer, ringbuf->size * 2);
+	else
+		free(ringbuf->buffer);
+
 	free(ringbuf);
 }
 
+bool ringbuf_is_mirrored(struct ringbuf *ringbuf)
+{
+	if (!ringbuf)
+		return false;
+
+	return ringbuf->mirrored;
+}
+
 bool ringbuf_set_input_tracing(struct ringbuf *ringbuf,
 			ringbuf_tracing_func_t callback, void *user_data)
 {
@@ -107,7 +207,8 @@ size_t ringbuf_len(struct ringbuf *ringbuf)
 	if (!ringbuf)
 		return 0;
 
-	return ringbuf->in - ringbuf->out;
+	return __atomic_load_n(&ringbuf->in, __ATOMIC_SEQ_CST) -
+			__atomic_load_n(&ringbuf->out, __ATOMIC_SEQ_CST);
 }
 
 size_t ringbuf_drain(struct ringbuf *ringbuf, size_t count)
@@ -136,9 +237,14 @@ void *ringbuf_peek(struct ringbuf *ringbuf, size_t offset, size_t *len_nowrap)
 	if (!ringbuf)
 		return NULL;
 
+	if (ringbuf->mirrored && len_nowrap) {
+		size_t len = ringbuf->in - ringbuf->out;
+		*len_nowrap = len - MIN(offset, len);
+	}
+
 	offset = (ringbuf->out + offset) & (ringbuf->size - 1);
 
-	if (len_nowrap) {
+	if (!ringbuf->mirrored && len_nowrap) {
 		size_t len = ringbuf->in - ringbuf->out;
 		*len_nowrap = MIN(len, ringbuf->size - offset);
 	}
@@ -146,42 +252,96 @@ void *ringbuf_peek(struct ringbuf *ringbuf, size_t offset, size_t *len_nowrap)
 	return ringbuf->buffer + offset;
 }
 
-ssize_t ringbuf_write(struct ringbuf *ringbuf, int fd)
+/* Split len bytes starting at index into at most two segments */
+static int ringbuf_iov(struct ringbuf *ringbuf, size_t index, size_t len,
+							struct iovec *iov)
 {
-	size_t len, offset, end;
-	struct iovec iov[2];
-	ssize_t consumed;
-
-	if (!ringbuf || fd < 0)
-		return -1;
+	size_t offset, end;
 
-	/* Determine how much data is available */
-	len = ringbuf->in - ringbuf->out;
 	if (!len)
 		return 0;
 
-	/* Grab data from buffer starting at offset until the end */
-	offset = ringbuf->out & (ringbuf->size - 1);
-	end = MIN(len, ringbuf->size - offset);
+	offset = index & (ringbuf->size - 1);
+	end = ringbuf->mirrored ? len : MIN(len, ringbuf->size - offset);
 
 	iov[0].iov_base = ringbuf->buffer + offset;
 	iov[0].iov_len = end;
 
-	/* Use second vector for remainder from the beginning */
+	if (end == len)
+		return 1;
+
 	iov[1].iov_base = ringbuf->buffer;
 	iov[1].iov_len = len - end;
 
-	consumed = writev(fd, iov, 2);
-	if (consumed < 0)
+	return 2;
+}
+
+int ringbuf_peekv(struct ringbuf *ringbuf, size_t offset, struct iovec *iov)
+{
+	size_t len;
+
+	if (!ringbuf || !iov)
 		return -1;
 
-	ringbuf->out += consumed;
+	len = ringbuf->in - ringbuf->out;
+	if (offset > len)
+		return -1;
 
-	if (ringbuf->out == ringbuf->in) {
-		ringbuf->in = RINGBUF_RESET;
-		ringbuf->out = RINGBUF_RESET;
+	return ringbuf_iov(ringbuf, ringbuf->out + offset, len - offset, iov);
+}
+
+int ringbuf_reservev(struct ringbuf *ringbuf, struct iovec *iov)
+{
+	if (!ringbuf || !iov)
+		return -1;
+
+	return ringbuf_iov(ringbuf, ringbuf->in,
+			ringbuf->size - ringbuf->in + ringbuf->out, iov);
+}
+
+size_t ringbuf_commit(struct ringbuf *ringbuf, size_t count)
+{
+	struct iovec iov[2];
+	int i, iovcnt;
+
+	if (!ringbuf)
+		return 0;
+
+	count = MIN(count, ringbuf->size - ringbuf->in + ringbuf->out);
+
+	if (ringbuf->in_tracing) {
+		iovcnt = ringbuf_iov(ringbuf, ringbuf->in, count, iov);
+
+		for (i = 0; i < iovcnt; i++)
+			ringbuf->in_tracing(iov[i].iov_base, iov[i].iov_len,
+							ringbuf->in_data);
 	}
 
+	ringbuf->in += count;
+
+	return count;
+}
+
+ssize_t ringbuf_write(struct ringbuf *ringbuf, int fd)
+{
+	struct iovec iov[2];
+	ssize_t consumed;
+	int iovcnt;
+
+	if (!ringbuf || fd < 0)
+		return -1;
+
+	/* Data wrapping around the end goes out as a second vector */
+	iovcnt = ringbuf_peekv(ringbuf, 0, iov);
+	if (!iovcnt)
+		return 0;
+
+	consumed = writev(fd, iov, iovcnt);
+	if (consumed < 0)
+		return -1;
+
+	ringbuf_drain(ringbuf, consumed);
+
 	return consumed;
 }
 
@@ -230,7 +390,8 @@ int ringbuf_vprintf(struct ringbuf *ringbuf, const char *format, va_list ap)
 
 	/* Determine possible length of string before wrapping */
 	offset = ringbuf->in & (ringbuf->size - 1);
-	end = MIN((size_t) len, ringbuf->size - offset);
+	end = ringbuf->mirrored ? (size_t) len :
+				MIN((size_t) len, ringbuf->size - offset);
 	memcpy(ringbuf->buffer + offset, str, end);
 
 	if (ringbuf->in_tracing)
@@ -255,43 +416,89 @@ int ringbuf_vprintf(struct ringbuf *ringbuf, const char *format, va_list ap)
 
 ssize_t ringbuf_read(struct ringbuf *ringbuf, int fd)
 {
-	size_t avail, offset, end;
 	struct iovec iov[2];
 	ssize_t consumed;
+	int iovcnt;
 
 	if (!ringbuf || fd < 0)
 		return -1;
 
-	/* Determine how much can actually be consumed */
-	avail = ringbuf->size - ringbuf->in + ringbuf->out;
-	if (!avail)
+	/* Free space wrapping around the end goes in as a second vector */
+	iovcnt = ringbuf_reservev(ringbuf, iov);
+	if (!iovcnt)
 		return -1;
 
-	/* Determine how much to consume before wrapping */
-	offset = ringbuf->in & (ringbuf->size - 1);
-	end = MIN(avail, ringbuf->size - offset);
+	consumed = readv(fd, iov, iovcnt);
+	if (consumed < 0)
+		return -1;
 
-	iov[0].iov_base = ringbuf->buffer + offset;
-	iov[0].iov_len = end;
+	ringbuf_commit(ringbuf, consumed);
 
-	/* Now put the remainder into the second vector */
-	iov[1].iov_base = ringbuf->buffer;
-	iov[1].iov_len = avail - end;
+	return consumed;
+}
 
-	consumed = readv(fd, iov, 2);
-	if (consumed < 0)
-		return -1;
+/*
+ * ringbuf_pushv and ringbuf_pull can be used concurrently by exactly one
+ * producer and one consumer thread. Neither resets the indexes, so they
+ * must not be mixed with the other functions while both threads run.
+ */
+bool ringbuf_pushv(struct ringbuf *ringbuf, const struct iovec *iov,
+								int iovcnt)
+{
+	size_t in, out, len = 0;
+	int i;
 
-	if (ringbuf->in_tracing) {
-		size_t len = MIN((size_t) consumed, end);
-		ringbuf->in_tracing(ringbuf->buffer + offset, len,
-							ringbuf->in_data);
-		if (consumed - len > 0)
-			ringbuf->in_tracing(ringbuf->buffer, consumed - len,
-							ringbuf->in_data);
+	if (!ringbuf || !iov)
+		return false;
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	in = ringbuf->in;
+	out = __atomic_load_n(&ringbuf->out, __ATOMIC_SEQ_CST);
+
+	/* Frames are either queued in full or not at all */
+	if (len > ringbuf->size - (in - out))
+		return false;
+
+	for (i = 0; i < iovcnt; i++) {
+		size_t offset, end;
+
+		offset = in & (ringbuf->size - 1);
+		end = MIN(iov[i].iov_len, ringbuf->size - offset);
+
+		memcpy(ringbuf->buffer + offset, iov[i].iov_base, end);
+		memcpy(ringbuf->buffer, iov[i].iov_base + end,
+						iov[i].iov_len - end);
+
+		in += iov[i].iov_len;
 	}
 
-	ringbuf->in += consumed;
+	__atomic_store_n(&ringbuf->in, in, __ATOMIC_SEQ_CST);
 
-	return consumed;
+	return true;
+}
+
+size_t ringbuf_pull(struct ringbuf *ringbuf, void *buf, size_t count)
+{
+	size_t in, out, offset, end;
+
+	if (!ringbuf || !buf)
+		return 0;
+
+	in = __atomic_load_n(&ringbuf->in, __ATOMIC_SEQ_CST);
+	out = ringbuf->out;
+
+	if (!count || count > in - out)
+		return 0;
+
+	offset = out & (ringbuf->size - 1);
+	end = MIN(count, ringbuf->size - offset);
+
+	memcpy(buf, ringbuf->buffer + offset, end);
+	memcpy(buf + end, ringbuf->buffer, count - end);
+
+	__atomic_store_n(&ringbuf->out, out + count, __ATOMIC_SEQ_CST);
+
+	return count;
 }
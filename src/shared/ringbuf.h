@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 
 typedef void (*ringbuf_tracing_func_t)(const void *buf, size_t count,
 							void *user_data);
@@ -18,8 +19,11 @@ typedef void (*ringbuf_tracing_func_t)(const void *buf, size_t count,
 struct ringbuf;
 
 struct ringbuf *ringbuf_new(size_t size);
+struct ringbuf *ringbuf_new_mirrored(size_t size);
 void ringbuf_free(struct ringbuf *ringbuf);
 
+bool ringbuf_is_mirrored(struct ringbuf *ringbuf);
+
 bool ringbuf_set_input_tracing(struct ringbuf *ringbuf,
 			ringbuf_tracing_func_t callback, void *user_data);
 
@@ -28,6 +32,7 @@ size_t ringbuf_capacity(struct ringbuf *ringbuf);
 size_t ringbuf_len(struct ringbuf *ringbuf);
 size_t ringbuf_drain(struct ringbuf *ringbuf, size_t count);
 void *ringbuf_peek(struct ringbuf *ringbuf, size_t offset, size_t *len_nowrap);
+int ringbuf_peekv(struct ringbuf *ringbuf, size_t offset, struct iovec *iov);
 ssize_t ringbuf_write(struct ringbuf *ringbuf, int fd);
 
 size_t ringbuf_avail(struct ringbuf *ringbuf);
@@ -35,3 +40,9 @@ int ringbuf_printf(struct ringbuf *ringbuf, const char *format, ...)
 					__attribute__((format(printf, 2, 3)));
 int ringbuf_vprintf(struct ringbuf *ringbuf, const char *format, va_list ap);
 ssize_t ringbuf_read(struct ringbuf *ringbuf, int fd);
+int ringbuf_reservev(struct ringbuf *ringbuf, struct iovec *iov);
+size_t ringbuf_commit(struct ringbuf *ringbuf, size_t count);
+
+bool ringbuf_pushv(struct ringbuf *ringbuf, const struct iovec *iov,
+								int iovcnt);
+size_t ringbuf_pull(struct ringbuf *ringbuf, void *buf, size_t count);
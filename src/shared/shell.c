@@ -25,6 +25,7 @@
 #include <wordexp.h>
 #include <getopt.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -38,6 +39,7 @@
 #include "src/shared/log.h"
 
 #define CMD_LENGTH	48
+#define OUTPUT_FLUSH_MS	50
 #define print_text(color, fmt, args...) \
 		printf(color fmt COLOR_OFF "\n", ## args)
 #define print_menu(cmd, args, desc) \
@@ -65,6 +67,18 @@ struct input {
 	FILE *f;
 };
 
+struct batch {
+	unsigned int max;
+	unsigned int inflight;
+	unsigned int ops;
+	unsigned int failed;
+	bool eof;
+	bool dequeuing;
+	uint64_t start;
+	uint64_t last;
+	uint64_t busy;
+};
+
 static struct {
 	bool init;
 	char *name;
@@ -72,6 +86,7 @@ static struct {
 	int argc;
 	char **argv;
 	bool mode;
+	bool stream;
 	bool zsh;
 	bool monitor;
 	int timeout;
@@ -80,6 +95,7 @@ static struct {
 
 	char *line;
 	struct queue *queue;
+	struct batch batch;
 
 	bool saved_prompt;
 	bt_shell_prompt_input_func saved_func;
@@ -93,6 +109,11 @@ static struct {
 	const struct bt_shell_menu_entry *exec;
 
 	struct queue *envs;
+
+	FILE *out;
+	char *out_buf;
+	size_t out_len;
+	unsigned int out_id;
 } data;
 
 static void shell_print_menu(void);
@@ -262,6 +283,121 @@ static void cmd_export(int argc, char *argv[])
 	}
 }
 
+static uint64_t batch_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* Accumulate the time spent by each command in flight so the average
+ * latency can be derived without knowing which command completed.
+ */
+static void batch_account(void)
+{
+	uint64_t now = batch_now();
+
+	data.batch.busy += data.batch.inflight * (now - data.batch.last);
+	data.batch.last = now;
+}
+
+static void batch_summary(void)
+{
+	struct batch *batch = &data.batch;
+
+	if (!batch->ops)
+		return;
+
+	printf("Batch: %u commands, %u failed, %.3f s total, "
+			"%.1f ms average latency\n", batch->ops, batch->failed,
+			(batch->last - batch->start) / 1000000.0,
+			batch->busy / 1000.0 / batch->ops);
+
+	batch->ops = 0;
+	batch->failed = 0;
+	batch->busy = 0;
+	batch->eof = false;
+}
+
+static int batch_exec(const char *line)
+{
+	int err;
+
+	bt_shell_printf("%s\n", line);
+
+	if (!data.batch.ops)
+		data.batch.start = data.batch.last = batch_now();
+
+	batch_account();
+	data.batch.inflight++;
+	data.batch.ops++;
+
+	err = bt_shell_exec(line);
+	if (err) {
+		batch_account();
+		data.batch.inflight--;
+		data.batch.failed++;
+	}
+
+	return err;
+}
+
+static void batch_dequeue(void)
+{
+	char *line;
+	int err;
+
+	if (data.batch.dequeuing)
+		return;
+
+	data.batch.dequeuing = true;
+
+	while (data.batch.inflight < data.batch.max) {
+		line = queue_peek_head(data.queue);
+		if (!line)
+			break;
+
+		/* Empty lines wait for all pending commands to complete */
+		if (line[0] == '\0') {
+			if (data.batch.inflight)
+				break;
+
+			free(queue_pop_head(data.queue));
+			continue;
+		}
+
+		line = queue_pop_head(data.queue);
+
+		err = batch_exec(line);
+		if (err < 0)
+			printf("%s: %s (%d)\n", line, strerror(-err), -err);
+
+		free(line);
+	}
+
+	data.batch.dequeuing = false;
+
+	if (data.batch.eof && !data.batch.inflight &&
+					queue_isempty(data.queue))
+		batch_summary();
+}
+
+static void batch_complete(int status)
+{
+	if (!data.batch.inflight)
+		return;
+
+	batch_account();
+	data.batch.inflight--;
+
+	if (status != EXIT_SUCCESS)
+		data.batch.failed++;
+
+	batch_dequeue();
+}
+
 static int bt_shell_queue_exec(char *line)
 {
 	int err;
@@ -270,6 +406,18 @@ static int bt_shell_queue_exec(char *line)
 	if (line[0] == '#')
 		return 0;
 
+	/* Pipeline commands up to the batch limit */
+	if (data.batch.max) {
+		if (!bt_shell_release_prompt(line)) {
+			bt_shell_printf("%s\n", line);
+			return 0;
+		}
+
+		queue_push_tail(data.queue, strdup(line));
+		batch_dequeue();
+		return 0;
+	}
+
 	/* Queue if already executing */
 	if (data.line) {
 		/* Check if prompt is being held then release using the line */
@@ -331,6 +479,11 @@ static bool bt_shell_input_line(struct input *input)
 	} else if (input->f) {
 		fclose(input->f);
 		input->f = NULL;
+
+		if (data.batch.max) {
+			data.batch.eof = true;
+			batch_dequeue();
+		}
 	}
 
 	free(line);
@@ -698,22 +851,31 @@ static int shell_exec(int argc, char *argv[])
 	return err;
 }
 
-void bt_shell_printf(const char *fmt, ...)
+static void output_write(void)
+{
+	if (!data.out)
+		return;
+
+	fclose(data.out);
+	data.out = NULL;
+
+	fwrite(data.out_buf, 1, data.out_len, stdout);
+
+	free(data.out_buf);
+	data.out_buf = NULL;
+	data.out_len = 0;
+}
+
+static bool output_flush(void *user_data)
 {
-	va_list args;
 	bool save_input;
 	char *saved_line;
 	int saved_point;
 
-	if (queue_isempty(data.inputs))
-		return;
+	data.out_id = 0;
 
-	if (data.mode) {
-		va_start(args, fmt);
-		vprintf(fmt, args);
-		va_end(args);
-		return;
-	}
+	if (!data.out)
+		return false;
 
 	save_input = !RL_ISSTATE(RL_STATE_DONE);
 
@@ -726,15 +888,7 @@ void bt_shell_printf(const char *fmt, ...)
 		rl_reset_line_state();
 	}
 
-	va_start(args, fmt);
-	vprintf(fmt, args);
-	va_end(args);
-
-	if (data.monitor) {
-		va_start(args, fmt);
-		bt_log_vprintf(0xffff, data.name, LOG_INFO, fmt, args);
-		va_end(args);
-	}
+	output_write();
 
 	if (save_input) {
 		if (!data.saved_prompt)
@@ -744,6 +898,65 @@ void bt_shell_printf(const char *fmt, ...)
 		rl_redisplay();
 		free(saved_line);
 	}
+
+	return false;
+}
+
+static void output_cancel(void)
+{
+	if (data.out_id) {
+		timeout_remove(data.out_id);
+		data.out_id = 0;
+	}
+
+	output_write();
+}
+
+void bt_shell_printf(const char *fmt, ...)
+{
+	va_list args;
+
+	if (queue_isempty(data.inputs))
+		return;
+
+	if (data.mode) {
+		va_start(args, fmt);
+		vprintf(fmt, args);
+		va_end(args);
+		return;
+	}
+
+	/* While the prompt is visible accumulate the output and redraw the
+	 * prompt only once per flush, otherwise print in place as there is
+	 * no input line to preserve.
+	 */
+	if (data.stream || RL_ISSTATE(RL_STATE_DONE)) {
+		output_cancel();
+
+		va_start(args, fmt);
+		vprintf(fmt, args);
+		va_end(args);
+	} else {
+		if (!data.out)
+			data.out = open_memstream(&data.out_buf, &data.out_len);
+
+		va_start(args, fmt);
+		if (data.out)
+			vfprintf(data.out, fmt, args);
+		else
+			vprintf(fmt, args);
+		va_end(args);
+
+		if (data.out && !data.out_id)
+			data.out_id = timeout_add(OUTPUT_FLUSH_MS, output_flush,
+								NULL, NULL);
+	}
+
+	if (data.monitor) {
+		va_start(args, fmt);
+		bt_log_vprintf(0xffff, data.name, LOG_INFO, fmt, args);
+		va_end(args);
+	}
 }
 
 void bt_shell_echo(const char *fmt, ...)
@@ -1287,6 +1500,7 @@ static const struct option main_options[] = {
 	{ "timeout",	required_argument, 0, 't' },
 	{ "monitor",	no_argument, 0, 'm' },
 	{ "zsh-complete",	no_argument, 0, 'z' },
+	{ "batch",	required_argument, 0, 'b' },
 };
 
 static void usage(int argc, char **argv, const struct bt_shell_opt *opt)
@@ -1306,6 +1520,7 @@ static void usage(int argc, char **argv, const struct bt_shell_opt *opt)
 		"\t--timeout \tTimeout in seconds for non-interactive mode\n"
 		"\t--version \tDisplay version\n"
 		"\t--init-script \tInit script file\n"
+		"\t--batch \tNumber of script commands to run in parallel\n"
 		"\t--help \t\tDisplay help\n");
 }
 
@@ -1324,9 +1539,10 @@ void bt_shell_init(int argc, char **argv, const struct bt_shell_opt *opt)
 	if (opt) {
 		memcpy(options + offset, opt->options,
 				sizeof(struct option) * opt->optno);
-		snprintf(optstr, sizeof(optstr), "+mhvs:t:%s", opt->optstr);
+		snprintf(optstr, sizeof(optstr), "+mhvs:t:b:%s",
+							opt->optstr);
 	} else
-		snprintf(optstr, sizeof(optstr), "+mhvs:t:");
+		snprintf(optstr, sizeof(optstr), "+mhvs:t:b:");
 
 	data.name = strrchr(argv[0], '/');
 	if (!data.name)
@@ -1363,6 +1579,13 @@ void bt_shell_init(int argc, char **argv, const struct bt_shell_opt *opt)
 			if (!endptr || *endptr != '\0')
 				printf("Unable to parse timeout\n");
 			break;
+		case 'b':
+			if (optarg)
+				data.batch.max = strtol(optarg, &endptr, 0);
+
+			if (!endptr || *endptr != '\0')
+				printf("Unable to parse batch size\n");
+			break;
 		case 'z':
 			data.zsh = 1;
 			break;
@@ -1402,6 +1625,9 @@ void bt_shell_init(int argc, char **argv, const struct bt_shell_opt *opt)
 	optind = 0;
 	data.mode = (data.argc > 0);
 
+	/* Output redirected to a file or pipe has no prompt to preserve */
+	data.stream = !isatty(STDOUT_FILENO);
+
 done:
 	if (data.mode)
 		bt_shell_set_env("NON_INTERACTIVE", &data.mode);
@@ -1506,6 +1732,8 @@ static void input_destroy(void *data)
 
 void bt_shell_cleanup(void)
 {
+	batch_summary();
+	output_cancel();
 	bt_shell_release_prompt("");
 	bt_shell_detach();
 
@@ -1540,6 +1768,11 @@ void bt_shell_quit(int status)
 
 void bt_shell_noninteractive_quit(int status)
 {
+	if (data.batch.inflight) {
+		batch_complete(status);
+		return;
+	}
+
 	if (!data.mode || data.timeout) {
 		bt_shell_dequeue_exec();
 		return;
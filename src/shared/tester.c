@@ -20,8 +20,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
+#include <malloc.h>
+#include <fcntl.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 
 #include <glib.h>
 
@@ -95,6 +99,7 @@ struct test_case {
 	unsigned int timeout;
 	unsigned int timeout_id;
 	unsigned int teardown_id;
+	unsigned int index;
 	tester_destroy_func_t destroy;
 	void *user_data;
 };
@@ -112,6 +117,21 @@ static gboolean option_monitor = FALSE;
 static gboolean option_list = FALSE;
 static const char *option_prefix = NULL;
 static const char *option_string = NULL;
+static int option_time_scale = 1;
+static int option_jobs = 1;
+static const char *option_shard = NULL;
+static unsigned int shard_index = 0;
+static unsigned int shard_count = 1;
+static unsigned int shard_next = 0;
+
+/* Set in a worker process when running with --jobs */
+static int worker_fd = -1;
+
+struct worker_result {
+	unsigned int index;
+	uint8_t result;
+	double exec_time;
+} __attribute__((packed));
 
 struct monitor_hdr {
 	uint16_t opcode;
@@ -297,6 +317,12 @@ void tester_add_full(const char *name, const void *test_data,
 		return;
 	}
 
+	if (shard_next++ % shard_count != shard_index) {
+		if (destroy)
+			destroy(user_data);
+		return;
+	}
+
 	if (option_list) {
 		tester_log("%s", name);
 		if (destroy)
@@ -350,6 +376,99 @@ void tester_add(const char *name, const void *test_data,
 					teardown_func, NULL, 0, NULL, NULL);
 }
 
+#define BENCH_SAMPLES		101
+#define BENCH_SAMPLE_NSEC	200000
+
+struct bench_data {
+	tester_bench_func_t func;
+	const void *test_data;
+};
+
+static uint64_t bench_batch(const struct bench_data *bench,
+						unsigned int iterations)
+{
+	struct timespec start, end;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < iterations; i++)
+		bench->func(bench->test_data);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start.tv_sec) * 1000000000ULL +
+						end.tv_nsec - start.tv_nsec;
+}
+
+static size_t bench_heap_used(void)
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+	return mallinfo2().uordblks;
+#else
+	return 0;
+#endif
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void bench_run(const void *test_data)
+{
+	const struct bench_data *bench = test_data;
+	double samples[BENCH_SAMPLES];
+	unsigned int iterations = 1;
+	unsigned int i;
+	size_t heap;
+
+	/* Grow the batch until a single sample is long enough to time */
+	while (bench_batch(bench, iterations) < BENCH_SAMPLE_NSEC &&
+						iterations < (1U << 30))
+		iterations <<= 1;
+
+	heap = bench_heap_used();
+
+	for (i = 0; i < BENCH_SAMPLES; i++)
+		samples[i] = (double) bench_batch(bench, iterations) /
+								iterations;
+
+	heap = bench_heap_used() - heap;
+
+	qsort(samples, BENCH_SAMPLES, sizeof(double), bench_cmp);
+
+	tester_print("%u samples of %u iterations", BENCH_SAMPLES,
+								iterations);
+	tester_print("ns/op: min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f",
+			samples[0], samples[BENCH_SAMPLES * 50 / 100],
+			samples[BENCH_SAMPLES * 90 / 100],
+			samples[BENCH_SAMPLES * 99 / 100],
+			samples[BENCH_SAMPLES - 1]);
+	tester_print("heap growth: %.3f bytes/op",
+			(double) (ssize_t) heap / iterations / BENCH_SAMPLES);
+
+	tester_test_passed();
+}
+
+void tester_add_benchmark(const char *name, const void *test_data,
+						tester_bench_func_t func)
+{
+	struct bench_data *bench;
+
+	if (!func)
+		return;
+
+	bench = new0(struct bench_data, 1);
+	bench->func = func;
+	bench->test_data = test_data;
+
+	tester_add_full(name, bench, NULL, NULL, bench_run, NULL, NULL, 0,
+								bench, free);
+}
+
 static struct test_case *tester_get_test(void)
 {
 	if (!test_current)
@@ -480,8 +599,12 @@ static void next_test_case(void)
 
 	test->start_time = g_timer_elapsed(test_timer, NULL);
 
+	/* The guard also covers the kernel, which keeps running in real
+	 * time, so undo the scale applied to emulated timers.
+	 */
 	if (test->timeout > 0)
-		test->timeout_id = timeout_add_seconds(test->timeout,
+		test->timeout_id = timeout_add_seconds(test->timeout *
+							timeout_get_scale(),
 							test_timeout, test,
 							NULL);
 
@@ -865,6 +988,12 @@ static GOptionEntry options[] = {
 				"Run tests matching provided prefix" },
 	{ "string", 's', 0, G_OPTION_ARG_STRING, &option_string,
 				"Run tests matching provided string" },
+	{ "time-scale", 't', 0, G_OPTION_ARG_INT, &option_time_scale,
+				"Run emulated timers N times faster" },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &option_jobs,
+				"Run tests in N parallel worker processes" },
+	{ "shard", 0, 0, G_OPTION_ARG_STRING, &option_shard,
+				"Only run every Nth test starting at K (K/N)" },
 	{ NULL },
 };
 
@@ -892,8 +1021,22 @@ void tester_init(int *argc, char ***argv)
 		exit(EXIT_SUCCESS);
 	}
 
+	/* Set by test-runner to split a tester across virtual machines */
+	if (!option_shard)
+		option_shard = getenv("TESTER_SHARD");
+
+	if (option_shard && (sscanf(option_shard, "%u/%u", &shard_index,
+						&shard_count) != 2 ||
+				shard_index >= shard_count)) {
+		g_printerr("Invalid shard %s\n", option_shard);
+		exit(1);
+	}
+
 	mainloop_init();
 
+	if (option_time_scale > 1)
+		timeout_set_scale(option_time_scale);
+
 	tester_name = strrchr(*argv[0], '/');
 	if (!tester_name)
 		tester_name = strdup(*argv[0]);
@@ -1062,20 +1205,184 @@ void tester_io_set_complete_func(tester_data_func_t func)
 	test->io_complete_func = func;
 }
 
+static int worker_report(void)
+{
+	GList *list;
+	int failed = 0;
+
+	for (list = g_list_first(test_list); list; list = g_list_next(list)) {
+		struct test_case *test = list->data;
+		struct worker_result res;
+
+		if (test->result == TEST_RESULT_FAILED ||
+				test->result == TEST_RESULT_TIMED_OUT)
+			failed++;
+
+		res.index = test->index;
+		res.result = test->result;
+		res.exec_time = test->end_time - test->start_time;
+
+		if (write(worker_fd, &res, sizeof(res)) != sizeof(res))
+			break;
+	}
+
+	close(worker_fd);
+	worker_fd = -1;
+
+	return failed;
+}
+
+static void worker_setup(int job, int fd)
+{
+	unsigned int index = 0;
+	GList *list, *next;
+
+	worker_fd = fd;
+
+	/* Keep progress lines whole when several workers share a terminal */
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	for (list = g_list_first(test_list); list; list = next, index++) {
+		struct test_case *test = list->data;
+
+		next = g_list_next(list);
+
+		if (index % option_jobs == (unsigned int) job) {
+			test->index = index;
+			continue;
+		}
+
+		test_list = g_list_delete_link(test_list, list);
+		test_destroy(test);
+	}
+}
+
+/* Each worker runs every Nth test case in its own process, and so with its
+ * own emulated controllers, and reports the outcome back over a pipe.
+ */
+static int run_workers(void)
+{
+	struct test_case **tests;
+	pid_t *pids;
+	int *fds;
+	unsigned int count, i;
+	GList *list;
+	int job;
+
+	count = g_list_length(test_list);
+	tests = g_new0(struct test_case *, count);
+
+	for (list = g_list_first(test_list), i = 0; list;
+					list = g_list_next(list), i++)
+		tests[i] = list->data;
+
+	pids = g_new0(pid_t, option_jobs);
+	fds = g_new0(int, option_jobs);
+
+	test_timer = g_timer_new();
+
+	fflush(stdout);
+
+	for (job = 0; job < option_jobs; job++) {
+		int sv[2];
+
+		fds[job] = -1;
+
+		if (pipe2(sv, O_CLOEXEC) < 0)
+			continue;
+
+		pids[job] = fork();
+		if (pids[job] < 0) {
+			close(sv[0]);
+			close(sv[1]);
+			continue;
+		}
+
+		if (!pids[job]) {
+			int n;
+
+			for (n = 0; n < job; n++) {
+				if (fds[n] >= 0)
+					close(fds[n]);
+			}
+
+			close(sv[0]);
+			g_free(tests);
+			g_free(pids);
+			g_free(fds);
+			worker_setup(job, sv[1]);
+			return -1;
+		}
+
+		close(sv[1]);
+		fds[job] = sv[0];
+	}
+
+	for (job = 0; job < option_jobs; job++) {
+		struct worker_result res;
+
+		if (fds[job] < 0)
+			continue;
+
+		while (read(fds[job], &res, sizeof(res)) == sizeof(res)) {
+			if (res.index >= count)
+				continue;
+
+			tests[res.index]->result = res.result;
+			tests[res.index]->start_time = 0;
+			tests[res.index]->end_time = res.exec_time;
+		}
+
+		close(fds[job]);
+	}
+
+	for (job = 0; job < option_jobs; job++) {
+		int status;
+
+		if (pids[job] <= 0)
+			continue;
+
+		if (waitpid(pids[job], &status, 0) < 0 || WIFEXITED(status))
+			continue;
+
+		/* A crashed worker leaves its remaining tests failed */
+		for (i = job; i < count; i += option_jobs) {
+			if (tests[i]->result == TEST_RESULT_NOT_RUN)
+				tests[i]->result = TEST_RESULT_FAILED;
+		}
+	}
+
+	g_timer_stop(test_timer);
+
+	g_free(tests);
+	g_free(pids);
+	g_free(fds);
+
+	return tester_summarize();
+}
+
 int tester_run(void)
 {
-	int ret;
+	int ret = -1;
 
 	if (option_list) {
 		mainloop_quit();
 		return EXIT_SUCCESS;
 	}
 
-	g_idle_add(start_tester, NULL);
+	if (option_jobs > 1 && !option_monitor)
+		ret = run_workers();
+
+	if (ret < 0) {
+		g_idle_add(start_tester, NULL);
 
-	mainloop_run_with_signal(signal_callback, NULL);
+		mainloop_run_with_signal(signal_callback, NULL);
 
-	ret = tester_summarize();
+		if (worker_fd >= 0)
+			ret = worker_report();
+		else
+			ret = tester_summarize();
+	}
 
 	g_list_free_full(test_list, test_destroy);
 
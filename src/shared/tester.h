@@ -55,6 +55,11 @@ void tester_add(const char *name, const void *test_data,
 					tester_data_func_t test_func,
 					tester_data_func_t teardown_func);
 
+typedef void (*tester_bench_func_t)(const void *test_data);
+
+void tester_add_benchmark(const char *name, const void *test_data,
+						tester_bench_func_t func);
+
 void *tester_get_data(void);
 
 void tester_pre_setup_complete(void);
@@ -23,6 +23,28 @@ struct timeout_data {
 	unsigned int timeout;
 };
 
+static unsigned int time_scale = 1;
+
+void timeout_set_scale(unsigned int scale)
+{
+	time_scale = scale ? scale : 1;
+}
+
+unsigned int timeout_get_scale(void)
+{
+	return time_scale;
+}
+
+static unsigned int scale_timeout(unsigned int timeout)
+{
+	if (time_scale == 1 || !timeout)
+		return timeout;
+
+	timeout /= time_scale;
+
+	return timeout ? timeout : 1;
+}
+
 static bool match_id(const void *a, const void *b)
 {
 	unsigned int to_id = L_PTR_TO_UINT(a);
@@ -67,10 +89,10 @@ unsigned int timeout_add(unsigned int timeout, timeout_func_t func,
 	data->func = func;
 	data->destroy = destroy;
 	data->user_data = user_data;
-	data->timeout = timeout;
+	data->timeout = scale_timeout(timeout);
 
 	while (id == 0 && tries < 3) {
-		to = l_timeout_create_ms(timeout, timeout_callback,
+		to = l_timeout_create_ms(data->timeout, timeout_callback,
 							data, timeout_destroy);
 		if (!to)
 			break;
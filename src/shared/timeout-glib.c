@@ -18,6 +18,28 @@ struct timeout_data {
 	void *user_data;
 };
 
+static unsigned int time_scale = 1;
+
+void timeout_set_scale(unsigned int scale)
+{
+	time_scale = scale ? scale : 1;
+}
+
+unsigned int timeout_get_scale(void)
+{
+	return time_scale;
+}
+
+static unsigned int scale_timeout(unsigned int timeout)
+{
+	if (time_scale == 1 || !timeout)
+		return timeout;
+
+	timeout /= time_scale;
+
+	return timeout ? timeout : 1;
+}
+
 static gboolean timeout_callback(gpointer user_data)
 {
 	struct timeout_data *data  = user_data;
@@ -52,8 +74,8 @@ unsigned int timeout_add(unsigned int timeout, timeout_func_t func,
 	data->destroy = destroy;
 	data->user_data = user_data;
 
-	id = g_timeout_add_full(G_PRIORITY_DEFAULT, timeout, timeout_callback,
-						data, timeout_destroy);
+	id = g_timeout_add_full(G_PRIORITY_DEFAULT, scale_timeout(timeout),
+					timeout_callback, data, timeout_destroy);
 	if (!id)
 		g_free(data);
 
@@ -89,6 +111,11 @@ unsigned int timeout_add_seconds(unsigned int timeout, timeout_func_t func,
 	if (!timeout)
 		id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, timeout_callback,
 							data, timeout_destroy);
+	else if (time_scale > 1)
+		id = g_timeout_add_full(G_PRIORITY_DEFAULT,
+					scale_timeout(timeout * 1000),
+					timeout_callback, data,
+					timeout_destroy);
 	else
 		id = g_timeout_add_seconds_full(G_PRIORITY_DEFAULT, timeout,
 							timeout_callback, data,
@@ -22,6 +22,28 @@ struct timeout_data {
 	void *user_data;
 };
 
+static unsigned int time_scale = 1;
+
+void timeout_set_scale(unsigned int scale)
+{
+	time_scale = scale ? scale : 1;
+}
+
+unsigned int timeout_get_scale(void)
+{
+	return time_scale;
+}
+
+static unsigned int scale_timeout(unsigned int timeout)
+{
+	if (time_scale == 1 || !timeout)
+		return timeout;
+
+	timeout /= time_scale;
+
+	return timeout ? timeout : 1;
+}
+
 static void timeout_callback(int id, void *user_data)
 {
 	struct timeout_data *data = user_data;
@@ -51,10 +73,10 @@ unsigned int timeout_add(unsigned int timeout, timeout_func_t func,
 	data = new0(struct timeout_data, 1);
 	data->func = func;
 	data->user_data = user_data;
-	data->timeout = timeout;
+	data->timeout = scale_timeout(timeout);
 	data->destroy = destroy;
 
-	data->id = mainloop_add_timeout(timeout, timeout_callback, data,
+	data->id = mainloop_add_timeout(data->timeout, timeout_callback, data,
 							timeout_destroy);
 	if (data->id < 0) {
 		free(data);
@@ -19,3 +19,9 @@ void timeout_remove(unsigned int id);
 
 unsigned int timeout_add_seconds(unsigned int timeout, timeout_func_t func,
 			void *user_data, timeout_destroy_func_t destroy);
+
+/* Virtual time for test builds: every timeout added afterwards fires scale
+ * times sooner than requested, so emulated timers run compressed.
+ */
+void timeout_set_scale(unsigned int scale);
+unsigned int timeout_get_scale(void);
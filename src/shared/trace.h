@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+/*
+ * Static tracepoints for bpftrace/perf, enabled with --enable-usdt.
+ * A disabled probe is a single nop, the arguments are only read by
+ * the tracer once it is attached.
+ */
+
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+
+#define BT_TRACE(name) DTRACE_PROBE(bluez, name)
+#define BT_TRACE1(name, a) DTRACE_PROBE1(bluez, name, a)
+#define BT_TRACE2(name, a, b) DTRACE_PROBE2(bluez, name, a, b)
+#define BT_TRACE3(name, a, b, c) DTRACE_PROBE3(bluez, name, a, b, c)
+#define BT_TRACE4(name, a, b, c, d) DTRACE_PROBE4(bluez, name, a, b, c, d)
+#else
+#define BT_TRACE(name) do { } while (0)
+#define BT_TRACE1(name, a) do { } while (0)
+#define BT_TRACE2(name, a, b) do { } while (0)
+#define BT_TRACE3(name, a, b, c) do { } while (0)
+#define BT_TRACE4(name, a, b, c, d) do { } while (0)
+#endif
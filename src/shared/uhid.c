@@ -14,6 +14,7 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -344,20 +345,32 @@ bool bt_uhid_unregister_all(struct bt_uhid *uhid)
 	return true;
 }
 
+static size_t uhid_event_len(const struct uhid_event *ev)
+{
+	/* The kernel zero fills whatever is not written so input events
+	 * only need to carry the used part of the report data.
+	 */
+	if (ev->type == UHID_INPUT2)
+		return offsetof(struct uhid_event, u.input2.data) +
+							ev->u.input2.size;
+
+	return sizeof(*ev);
+}
+
 static int uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
 {
 	ssize_t len;
 	struct iovec iov;
 
 	iov.iov_base = (void *) ev;
-	iov.iov_len = sizeof(*ev);
+	iov.iov_len = uhid_event_len(ev);
 
 	len = io_send(uhid->io, &iov, 1);
 	if (len < 0)
 		return -errno;
 
 	/* uHID kernel driver does not handle partial writes */
-	return len != sizeof(*ev) ? -EIO : 0;
+	return (size_t) len != iov.iov_len ? -EIO : 0;
 }
 
 int bt_uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
@@ -471,7 +484,7 @@ int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
 	if (!uhid)
 		return -EINVAL;
 
-	memset(&ev, 0, sizeof(ev));
+	/* Only the header and the used part of data are ever sent */
 	ev.type = UHID_INPUT2;
 
 	if (number) {
@@ -482,13 +495,16 @@ int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
 
 	if (data && size)
 		memcpy(&req->data[len], data, req->size - len);
+	else
+		memset(&req->data[len], 0, req->size - len);
 
 	/* Queue events if UHID_START has not been received yet */
 	if (!uhid->started) {
 		if (!uhid->input)
 			uhid->input = queue_new();
 
-		queue_push_tail(uhid->input, util_memdup(&ev, sizeof(ev)));
+		queue_push_tail(uhid->input, util_memdup(&ev,
+							uhid_event_len(&ev)));
 		return 0;
 	}
 
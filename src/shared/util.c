@@ -16,6 +16,7 @@
 #define _GNU_SOURCE
 #include <fcntl.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include <ctype.h>
 #include <stdbool.h>
 #include <sys/types.h>
@@ -38,7 +39,7 @@
 
 #include "src/shared/util.h"
 
-void *util_malloc(size_t size)
+void *(util_malloc)(size_t size)
 {
 	if (__builtin_expect(!!size, 1)) {
 		void *ptr;
@@ -54,14 +55,14 @@ void *util_malloc(size_t size)
 	return NULL;
 }
 
-void *util_memdup(const void *src, size_t size)
+void *(util_memdup)(const void *src, size_t size)
 {
 	void *cpy;
 
 	if (!src || !size)
 		return NULL;
 
-	cpy = util_malloc(size);
+	cpy = (util_malloc)(size);
 	if (!cpy)
 		return NULL;
 
@@ -70,6 +71,96 @@ void *util_memdup(const void *src, size_t size)
 	return cpy;
 }
 
+#ifdef HAVE_ALLOC_STATS
+static struct util_alloc_site *alloc_sites;
+
+static void alloc_site_add(struct util_alloc_site *site, size_t size)
+{
+	/* Sites are linked in on first use and never unlinked */
+	if (!__sync_lock_test_and_set(&site->registered, 1)) {
+		do {
+			site->next = alloc_sites;
+		} while (!__sync_bool_compare_and_swap(&alloc_sites,
+							site->next, site));
+	}
+
+	__sync_fetch_and_add(&site->count, 1);
+	__sync_fetch_and_add(&site->bytes, size);
+}
+
+void *util_malloc_site(struct util_alloc_site *site, size_t size)
+{
+	if (size)
+		alloc_site_add(site, size);
+
+	return (util_malloc)(size);
+}
+
+void *util_memdup_site(struct util_alloc_site *site, const void *src,
+								size_t size)
+{
+	if (src && size)
+		alloc_site_add(site, size);
+
+	return (util_memdup)(src, size);
+}
+#endif
+
+void util_alloc_stats_dump(util_debug_func_t function, void *user_data)
+{
+#ifdef HAVE_ALLOC_STATS
+	struct util_alloc_site *site;
+
+	for (site = alloc_sites; site; site = site->next)
+		util_debug(function, user_data, "%s:%u: %" PRIu64
+					" allocations %" PRIu64 " bytes",
+					site->file, site->line, site->count,
+					site->bytes);
+#endif
+}
+
+void *util_pool_alloc(struct util_pool *pool)
+{
+	void *ptr = pool->free;
+
+	if (ptr) {
+		pool->free = *(void **) ptr;
+		pool->count--;
+	} else
+		ptr = util_malloc(pool->size);
+
+	memset(ptr, 0, pool->size);
+
+	return ptr;
+}
+
+void util_pool_release(struct util_pool *pool, void *ptr)
+{
+	if (!ptr)
+		return;
+
+	if (pool->count >= pool->max || pool->size < sizeof(void *)) {
+		free(ptr);
+		return;
+	}
+
+	*(void **) ptr = pool->free;
+	pool->free = ptr;
+	pool->count++;
+}
+
+void util_pool_flush(struct util_pool *pool)
+{
+	while (pool->free) {
+		void *ptr = pool->free;
+
+		pool->free = *(void **) ptr;
+		free(ptr);
+	}
+
+	pool->count = 0;
+}
+
 void util_debug_va(util_debug_func_t function, void *user_data,
 				const char *format, va_list va)
 {
@@ -684,6 +775,7 @@ void *util_iov_pull_u8(struct iovec *iov, uint8_t *val)
 	return NULL;
 }
 
+/* Sorted by UUID, the lookups are binary searches */
 static const struct {
 	uint16_t uuid;
 	const char *str;
@@ -1156,427 +1248,428 @@ static const struct {
 	{ 0x2c01, "UGG Features"				},
 	{ 0x2c02, "UGT Features"				},
 	{ 0x2c03, "BGS Features"				},
-	{ 0x2c03, "BGR Features"				},
+	{ 0x2c04, "BGR Features"				},
+	/* SDO defined */
+	{ 0xfccc, "Wi-Fi Easy Connect Specification"		},
 	/* vendor defined */
-	{ 0xfeff, "GN Netcom"					},
-	{ 0xfefe, "GN ReSound A/S"				},
-	{ 0xfefd, "Gimbal, Inc."				},
-	{ 0xfefc, "Gimbal, Inc."				},
-	{ 0xfefb, "Telit Wireless Solutions (Formerly Stollmann E+V GmbH)" },
-	{ 0xfefa, "PayPal, Inc."				},
-	{ 0xfef9, "PayPal, Inc."				},
-	{ 0xfef8, "Aplix Corporation"				},
-	{ 0xfef7, "Aplix Corporation"				},
-	{ 0xfef6, "Wicentric, Inc."				},
-	{ 0xfef5, "Dialog Semiconductor GmbH"			},
-	{ 0xfef4, "Google"					},
-	{ 0xfef3, "Google"					},
-	{ 0xfef2, "CSR"						},
-	{ 0xfef1, "CSR"						},
-	{ 0xfef0, "Intel"					},
-	{ 0xfeef, "Polar Electro Oy "				},
-	{ 0xfeee, "Polar Electro Oy "				},
-	{ 0xfeed, "Tile, Inc."					},
-	{ 0xfeec, "Tile, Inc."					},
-	{ 0xfeeb, "Swirl Networks, Inc."			},
-	{ 0xfeea, "Swirl Networks, Inc."			},
-	{ 0xfee9, "Quintic Corp."				},
-	{ 0xfee8, "Quintic Corp."				},
-	{ 0xfee7, "Tencent Holdings Limited."			},
-	{ 0xfee6, "Silvair, Inc."				},
-	{ 0xfee5, "Nordic Semiconductor ASA"			},
-	{ 0xfee4, "Nordic Semiconductor ASA"			},
-	{ 0xfee3, "Anki, Inc."					},
-	{ 0xfee2, "Anki, Inc."					},
-	{ 0xfee1, "Anhui Huami Information Technology Co., Ltd. " },
-	{ 0xfee0, "Anhui Huami Information Technology Co., Ltd. " },
-	{ 0xfedf, "Design SHIFT"				},
-	{ 0xfede, "Coin, Inc."					},
-	{ 0xfedd, "Jawbone"					},
-	{ 0xfedc, "Jawbone"					},
-	{ 0xfedb, "Perka, Inc."					},
-	{ 0xfeda, "ISSC Technologies Corp. "			},
-	{ 0xfed9, "Pebble Technology Corporation"		},
-	{ 0xfed8, "Google"					},
-	{ 0xfed7, "Broadcom"					},
-	{ 0xfed6, "Broadcom"					},
-	{ 0xfed5, "Plantronics Inc."				},
-	{ 0xfed4, "Apple, Inc."					},
-	{ 0xfed3, "Apple, Inc."					},
-	{ 0xfed2, "Apple, Inc."					},
-	{ 0xfed1, "Apple, Inc."					},
-	{ 0xfed0, "Apple, Inc."					},
-	{ 0xfecf, "Apple, Inc."					},
-	{ 0xfece, "Apple, Inc."					},
-	{ 0xfecd, "Apple, Inc."					},
-	{ 0xfecc, "Apple, Inc."					},
-	{ 0xfecb, "Apple, Inc."					},
-	{ 0xfeca, "Apple, Inc."					},
-	{ 0xfec9, "Apple, Inc."					},
-	{ 0xfec8, "Apple, Inc."					},
-	{ 0xfec7, "Apple, Inc."					},
-	{ 0xfec6, "Kocomojo, LLC"				},
-	{ 0xfec5, "Realtek Semiconductor Corp."			},
-	{ 0xfec4, "PLUS Location Systems"			},
-	{ 0xfec3, "360fly, Inc."				},
-	{ 0xfec2, "Blue Spark Technologies, Inc."		},
-	{ 0xfec1, "KDDI Corporation"				},
-	{ 0xfec0, "KDDI Corporation"				},
-	{ 0xfebf, "Nod, Inc."					},
-	{ 0xfebe, "Bose Corporation"				},
-	{ 0xfebd, "Clover Network, Inc"				},
-	{ 0xfebc, "Dexcom Inc"					},
-	{ 0xfebb, "adafruit industries"				},
-	{ 0xfeba, "Tencent Holdings Limited"			},
-	{ 0xfeb9, "LG Electronics"				},
-	{ 0xfeb8, "Facebook, Inc."				},
-	{ 0xfeb7, "Facebook, Inc."				},
-	{ 0xfeb6, "Vencer Co., Ltd"				},
-	{ 0xfeb5, "WiSilica Inc."				},
-	{ 0xfeb4, "WiSilica Inc."				},
-	{ 0xfeb3, "Taobao"					},
-	{ 0xfeb2, "Microsoft Corporation"			},
-	{ 0xfeb1, "Electronics Tomorrow Limited"		},
-	{ 0xfeb0, "Nest Labs Inc"				},
-	{ 0xfeaf, "Nest Labs Inc"				},
-	{ 0xfeae, "Nokia"					},
-	{ 0xfead, "Nokia"					},
-	{ 0xfeac, "Nokia"					},
-	{ 0xfeab, "Nokia"					},
-	{ 0xfeaa, "Google"					},
-	{ 0xfea9, "Savant Systems LLC"				},
-	{ 0xfea8, "Savant Systems LLC"				},
-	{ 0xfea7, "UTC Fire and Security"			},
-	{ 0xfea6, "GoPro, Inc."					},
-	{ 0xfea5, "GoPro, Inc."					},
-	{ 0xfea4, "Paxton Access Ltd"				},
-	{ 0xfea3, "ITT Industries"				},
-	{ 0xfea2, "Intrepid Control Systems, Inc."		},
-	{ 0xfea1, "Intrepid Control Systems, Inc."		},
-	{ 0xfea0, "Google"					},
-	{ 0xfe9f, "Google"					},
-	{ 0xfe9e, "Dialog Semiconductor B.V."			},
-	{ 0xfe9d, "Mobiquity Networks Inc"			},
-	{ 0xfe9c, "GSI Laboratories, Inc."			},
-	{ 0xfe9b, "Samsara Networks, Inc"			},
-	{ 0xfe9a, "Estimote"					},
-	{ 0xfe99, "Currant Inc"					},
-	{ 0xfe98, "Currant Inc"					},
-	{ 0xfe97, "Tesla Motors Inc."				},
-	{ 0xfe96, "Tesla Motors Inc."				},
-	{ 0xfe95, "Xiaomi Inc."					},
-	{ 0xfe94, "OttoQ In"					},
-	{ 0xfe93, "OttoQ In"					},
-	{ 0xfe92, "Jarden Safety & Security"			},
-	{ 0xfe91, "Shanghai Imilab Technology Co.,Ltd"		},
-	{ 0xfe90, "JUMA"					},
-	{ 0xfe8f, "CSR"						},
-	{ 0xfe8e, "ARM Ltd"					},
-	{ 0xfe8d, "Interaxon Inc."				},
-	{ 0xfe8c, "TRON Forum"					},
-	{ 0xfe8b, "Apple, Inc."					},
-	{ 0xfe8a, "Apple, Inc."					},
-	{ 0xfe89, "B&O Play A/S"				},
-	{ 0xfe88, "SALTO SYSTEMS S.L."				},
-	{ 0xfe87, "Qingdao Yeelink Information Technology Co., Ltd. ( 青岛亿联客信息技术有限公司 )" },
-	{ 0xfe86, "HUAWEI Technologies Co., Ltd. ( 华为技术有限公司 )"	},
-	{ 0xfe85, "RF Digital Corp"				},
-	{ 0xfe84, "RF Digital Corp"				},
-	{ 0xfe83, "Blue Bite"					},
-	{ 0xfe82, "Medtronic Inc."				},
-	{ 0xfe81, "Medtronic Inc."				},
-	{ 0xfe80, "Doppler Lab"					},
-	{ 0xfe7f, "Doppler Lab"					},
-	{ 0xfe7e, "Awear Solutions Ltd"				},
-	{ 0xfe7d, "Aterica Health Inc."				},
-	{ 0xfe7c, "Telit Wireless Solutions (Formerly Stollmann E+V GmbH)" },
-	{ 0xfe7b, "Orion Labs, Inc."				},
-	{ 0xfe7a, "Bragi GmbH"					},
-	{ 0xfe79, "Zebra Technologies"				},
-	{ 0xfe78, "Hewlett-Packard Company"			},
-	{ 0xfe77, "Hewlett-Packard Company"			},
-	{ 0xfe76, "TangoMe"					},
-	{ 0xfe75, "TangoMe"					},
-	{ 0xfe74, "unwire"					},
-	{ 0xfe73, "Abbott (formerly St. Jude Medical, Inc.)"	},
-	{ 0xfe72, "Abbott (formerly St. Jude Medical, Inc.)"	},
-	{ 0xfe71, "Plume Design Inc"				},
-	{ 0xfe70, "Beijing Jingdong Century Trading Co., Ltd."	},
-	{ 0xfe6f, "LINE Corporation"				},
-	{ 0xfe6e, "The University of Tokyo "			},
-	{ 0xfe6d, "The University of Tokyo "			},
-	{ 0xfe6c, "TASER International, Inc."			},
-	{ 0xfe6b, "TASER International, Inc."			},
-	{ 0xfe6a, "Kontakt Micro-Location Sp. z o.o."		},
-	{ 0xfe69, "Capsule Technologies Inc."			},
-	{ 0xfe68, "Capsule Technologies Inc."			},
-	{ 0xfe67, "Lab Sensor Solutions"			},
-	{ 0xfe66, "Intel Corporation "				},
-	{ 0xfe65, "CHIPOLO d.o.o. "				},
-	{ 0xfe64, "Siemens AG"					},
-	{ 0xfe63, "Connected Yard, Inc. "			},
-	{ 0xfe62, "Indagem Tech LLC "				},
-	{ 0xfe61, "Logitech International SA "			},
-	{ 0xfe60, "Lierda Science & Technology Group Co., Ltd."	},
-	{ 0xfe5f, "Eyefi, Inc."					},
-	{ 0xfe5e, "Plastc Corporation "				},
-	{ 0xfe5d, "Grundfos A/S "				},
-	{ 0xfe5c, "million hunters GmbH "			},
-	{ 0xfe5b, "GT-tronics HK Ltd"				},
-	{ 0xfe5a, "Cronologics Corporation"			},
-	{ 0xfe59, "Nordic Semiconductor ASA "			},
-	{ 0xfe58, "Nordic Semiconductor ASA "			},
-	{ 0xfe57, "Dotted Labs "				},
-	{ 0xfe56, "Google Inc. "				},
-	{ 0xfe55, "Google Inc. "				},
-	{ 0xfe54, "Motiv, Inc. "				},
-	{ 0xfe53, "3M"						},
-	{ 0xfe52, "SetPoint Medical "				},
-	{ 0xfe51, "SRAM "					},
-	{ 0xfe50, "Google Inc."					},
-	{ 0xfe4f, "Molekule, Inc."				},
-	{ 0xfe4e, "NTT docomo "					},
-	{ 0xfe4d, "Casambi Technologies Oy"			},
-	{ 0xfe4c, "Volkswagen AG "				},
-	{ 0xfe4b, "Signify Netherlands B.V. (formerly Philips Lighting B.V.)" },
-	{ 0xfe4a, "OMRON HEALTHCARE Co., Ltd."			},
-	{ 0xfe49, "SenionLab AB"				},
-	{ 0xfe48, "General Motors "				},
-	{ 0xfe47, "General Motors "				},
-	{ 0xfe46, "B&O Play A/S "				},
-	{ 0xfe45, "Snapchat Inc"				},
-	{ 0xfe44, "SK Telecom "					},
-	{ 0xfe43, "Andreas Stihl AG & Co. KG"			},
-	{ 0xfe42, "Nets A/S "					},
-	{ 0xfe41, "Inugo Systems Limited"			},
-	{ 0xfe40, "Inugo Systems Limited"			},
-	{ 0xfe3f, "Friday Labs Limited"				},
-	{ 0xfe3e, "BD Medical"					},
-	{ 0xfe3d, "BD Medical"					},
-	{ 0xfe3c, "alibaba"					},
-	{ 0xfe3b, "Dobly Laboratories"				},
-	{ 0xfe3a, "TTS Tooltechnic Systems AG & Co. KG"		},
-	{ 0xfe39, "TTS Tooltechnic Systems AG & Co. KG"		},
-	{ 0xfe38, "Spaceek LTD"					},
-	{ 0xfe37, "Spaceek LTD"					},
-	{ 0xfe36, "HUAWEI Technologies Co., Ltd"		},
-	{ 0xfe35, "HUAWEI Technologies Co., Ltd"		},
-	{ 0xfe34, "SmallLoop LLC"				},
-	{ 0xfe33, "CHIPOLO d.o.o."				},
-	{ 0xfe32, "Pro-Mark, Inc."				},
-	{ 0xfe31, "Volkswagen AG"				},
-	{ 0xfe30, "Volkswagen AG"				},
-	{ 0xfe2f, "CRESCO Wireless, Inc"			},
-	{ 0xfe2e, "ERi,Inc."					},
-	{ 0xfe2d, "SMART INNOVATION Co.,Ltd"			},
-	{ 0xfe2c, "Google"					},
-	{ 0xfe2b, "ITT Industries"				},
-	{ 0xfe2a, "DaisyWorks, Inc."				},
-	{ 0xfe29, "Gibson Innovations"				},
-	{ 0xfe28, "Ayla Networks"				},
-	{ 0xfe27, "Google"					},
-	{ 0xfe26, "Google"					},
-	{ 0xfe25, "Apple, Inc. "				},
-	{ 0xfe24, "August Home Inc"				},
-	{ 0xfe23, "Zoll Medical Corporation"			},
-	{ 0xfe22, "Zoll Medical Corporation"			},
-	{ 0xfe21, "Bose Corporation"				},
-	{ 0xfe20, "Emerson"					},
-	{ 0xfe1f, "Garmin International, Inc."			},
-	{ 0xfe1e, "Smart Innovations Co., Ltd"			},
-	{ 0xfe1d, "Illuminati Instrument Corporation"		},
-	{ 0xfe1c, "NetMedia, Inc."				},
-	{ 0xfe1b, "Tyto Life LLC"				},
-	{ 0xfe1a, "Tyto Life LLC"				},
-	{ 0xfe19, "Google, Inc"					},
-	{ 0xfe18, "Runtime, Inc."				},
-	{ 0xfe17, "Telit Wireless Solutions GmbH"		},
-	{ 0xfe16, "Footmarks, Inc."				},
-	{ 0xfe15, "Amazon.com Services, Inc.."			},
-	{ 0xfe14, "Flextronics International USA Inc."		},
-	{ 0xfe13, "Apple Inc."					},
-	{ 0xfe12, "M-Way Solutions GmbH"			},
-	{ 0xfe11, "GMC-I Messtechnik GmbH"			},
-	{ 0xfe10, "Lapis Semiconductor Co., Ltd."		},
-	{ 0xfe0f, "Signify Netherlands B.V. (formerly Philips Lighting B.V.)" },
-	{ 0xfe0e, "Setec Pty Ltd"				},
-	{ 0xfe0d, "Procter & Gamble"				},
-	{ 0xfe0c, "Procter & Gamble"				},
-	{ 0xfe0b, "ruwido austria gmbh"				},
-	{ 0xfe0a, "ruwido austria gmbh"				},
-	{ 0xfe09, "Pillsy, Inc."				},
-	{ 0xfe08, "Microsoft"					},
-	{ 0xfe07, "Sonos, Inc."					},
-	{ 0xfe06, "Qualcomm Technologies, Inc."			},
-	{ 0xfe05, "CORE Transport Technologies NZ Limited "	},
-	{ 0xfe04, "OpenPath Security Inc"			},
-	{ 0xfe03, "Amazon.com Services, Inc."			},
-	{ 0xfe02, "Robert Bosch GmbH"				},
-	{ 0xfe01, "Duracell U.S. Operations Inc."		},
-	{ 0xfe00, "Amazon.com Services, Inc."			},
-	{ 0xfdff, "OSRAM GmbH"					},
-	{ 0xfdfe, "ADHERIUM(NZ) LIMITED"			},
-	{ 0xfdfd, "RecursiveSoft Inc."				},
-	{ 0xfdfc, "Optrel AG"					},
-	{ 0xfdfb, "Tandem Diabetes Care"			},
-	{ 0xfdfa, "Tandem Diabetes Care"			},
-	{ 0xfdf9, "INIA"					},
-	{ 0xfdf8, "Onvocal"					},
-	{ 0xfdf7, "HP Inc."					},
-	{ 0xfdf6, "AIAIAI ApS"					},
-	{ 0xfdf5, "Milwaukee Electric Tools"			},
-	{ 0xfdf4, "O. E. M. Controls, Inc."			},
-	{ 0xfdf3, "Amersports"					},
-	{ 0xfdf2, "AMICCOM Electronics Corporation"		},
-	{ 0xfdf1, "LAMPLIGHT Co.,Ltd"				},
-	{ 0xfdf0, "Google Inc."					},
-	{ 0xfdef, "ART AND PROGRAM, INC."			},
-	{ 0xfdee, "Huawei Technologies Co., Ltd."		},
-	{ 0xfded, "Pole Star"					},
-	{ 0xfdec, "Mannkind Corporation"			},
-	{ 0xfdeb, "Syntronix Corporation"			},
-	{ 0xfdea, "SeeScan, Inc"				},
-	{ 0xfde9, "Spacesaver Corporation"			},
-	{ 0xfde8, "Robert Bosch GmbH"				},
-	{ 0xfde7, "SECOM Co., LTD"				},
-	{ 0xfde6, "Intelletto Technologies Inc"			},
-	{ 0xfde5, "SMK Corporation "				},
-	{ 0xfde4, "JUUL Labs, Inc."				},
-	{ 0xfde3, "Abbott Diabetes Care"			},
-	{ 0xfde2, "Google Inc."					},
-	{ 0xfde1, "Fortin Electronic Systems "			},
-	{ 0xfde0, "John Deere"					},
-	{ 0xfddf, "Harman International"			},
-	{ 0xfdde, "Noodle Technology Inc. "			},
-	{ 0xfddd, "Arch Systems Inc"				},
-	{ 0xfddc, "4iiii Innovations Inc."			},
-	{ 0xfddb, "Samsung Electronics Co., Ltd. "		},
-	{ 0xfdda, "MHCS"					},
-	{ 0xfdd9, "Jiangsu Teranovo Tech Co., Ltd."		},
-	{ 0xfdd8, "Jiangsu Teranovo Tech Co., Ltd."		},
-	{ 0xfdd7, "Emerson"					},
-	{ 0xfdd6, "Ministry of Supply "				},
-	{ 0xfdd5, "Brompton Bicycle Ltd"			},
-	{ 0xfdd4, "LX Solutions Pty Limited"			},
-	{ 0xfdd3, "FUBA Automotive Electronics GmbH"		},
-	{ 0xfdd2, "Bose Corporation"				},
-	{ 0xfdd1, "Huawei Technologies Co., Ltd "		},
-	{ 0xfdd0, "Huawei Technologies Co., Ltd "		},
-	{ 0xfdcf, "Nalu Medical, Inc"				},
-	{ 0xfdce, "SENNHEISER electronic GmbH & Co. KG"		},
-	{ 0xfdcd, "Qingping Technology (Beijing) Co., Ltd."	},
-	{ 0xfdcc, "Shoof Technologies"				},
-	{ 0xfdcb, "Meggitt SA"					},
-	{ 0xfdca, "Fortin Electronic Systems "			},
-	{ 0xfdc9, "Busch-Jaeger Elektro GmbH"			},
-	{ 0xfdc8, "Hach – Danaher"				},
-	{ 0xfdc7, "Eli Lilly and Company"			},
-	{ 0xfdc6, "Eli Lilly and Company"			},
-	{ 0xfdc5, "Automatic Labs"				},
-	{ 0xfdc4, "Simavita (Aust) Pty Ltd"			},
-	{ 0xfdc3, "Baidu Online Network Technology (Beijing) Co., Ltd" },
-	{ 0xfdc2, "Baidu Online Network Technology (Beijing) Co., Ltd" },
-	{ 0xfdc1, "Hunter Douglas"				},
-	{ 0xfdc0, "Hunter Douglas"				},
-	{ 0xfdbf, "California Things Inc. "			},
-	{ 0xfdbe, "California Things Inc. "			},
-	{ 0xfdbd, "Clover Network, Inc."			},
-	{ 0xfdbc, "Emerson"					},
-	{ 0xfdbb, "Profoto"					},
-	{ 0xfdba, "Comcast Cable Corporation"			},
-	{ 0xfdb9, "Comcast Cable Corporation"			},
-	{ 0xfdb8, "LivaNova USA Inc."				},
-	{ 0xfdb7, "LivaNova USA Inc."				},
-	{ 0xfdb6, "GWA Hygiene GmbH"				},
-	{ 0xfdb5, "ECSG"					},
-	{ 0xfdb4, "HP Inc"					},
-	{ 0xfdb3, "Audiodo AB"					},
-	{ 0xfdb2, "Portable Multimedia Ltd "			},
-	{ 0xfdb1, "Proxy Technologies, Inc."			},
-	{ 0xfdb0, "Proxy Technologies, Inc."			},
-	{ 0xfdaf, "Wiliot LTD"					},
-	{ 0xfdae, "Houwa System Design, k.k."			},
-	{ 0xfdad, "Houwa System Design, k.k."			},
-	{ 0xfdac, "Tentacle Sync GmbH"				},
-	{ 0xfdab, "Xiaomi Inc."					},
-	{ 0xfdaa, "Xiaomi Inc."					},
-	{ 0xfda9, "Rhombus Systems, Inc."			},
-	{ 0xfda8, "PSA Peugeot Citroën"				},
-	{ 0xfda7, "WWZN Information Technology Company Limited"	},
-	{ 0xfda6, "WWZN Information Technology Company Limited"	},
-	{ 0xfda5, "Neurostim OAB, Inc."				},
-	{ 0xfda4, "Inseego Corp."				},
-	{ 0xfda3, "Inseego Corp."				},
-	{ 0xfda2, "Groove X, Inc"				},
-	{ 0xfda1, "Groove X, Inc"				},
-	{ 0xfda0, "Secugen Corporation"				},
-	{ 0xfd9f, "VitalTech Affiliates LLC"			},
-	{ 0xfd9e, "The Coca-Cola Company"			},
-	{ 0xfd9d, "Gastec Corporation"				},
-	{ 0xfd9c, "Huawei Technologies Co., Ltd."		},
-	{ 0xfd9b, "Huawei Technologies Co., Ltd."		},
-	{ 0xfd9a, "Huawei Technologies Co., Ltd."		},
-	{ 0xfd99, "ABB Oy"					},
-	{ 0xfd98, "Disney Worldwide Services, Inc."		},
-	{ 0xfd97, "June Life, Inc."				},
-	{ 0xfd96, "Google LLC"					},
-	{ 0xfd95, "Rigado"					},
-	{ 0xfd94, "Hewlett Packard Enterprise"			},
-	{ 0xfd93, "Bayerische Motoren Werke AG"			},
-	{ 0xfd92, "Qualcomm Technologies International, Ltd. (QTIL)" },
-	{ 0xfd91, "Groove X, Inc."				},
-	{ 0xfd90, "Guangzhou SuperSound Information Technology Co.,Ltd" },
-	{ 0xfd8f, "Matrix ComSec Pvt. Ltd."			},
-	{ 0xfd8e, "Motorola Solutions"				},
-	{ 0xfd8d, "quip NYC Inc."				},
-	{ 0xfd8c, "Google LLC"					},
-	{ 0xfd8b, "Jigowatts Inc."				},
-	{ 0xfd8a, "Signify Netherlands B.V."			},
-	{ 0xfd89, "Urbanminded LTD"				},
-	{ 0xfd88, "Urbanminded LTD"				},
-	{ 0xfd87, "Google LLC"					},
-	{ 0xfd86, "Abbott"					},
-	{ 0xfd85, "Husqvarna AB"				},
-	{ 0xfd84, "Tile, Inc."					},
-	{ 0xfd83, "iNFORM Technology GmbH"			},
-	{ 0xfd82, "Sony Corporation"				},
-	{ 0xfd81, "CANDY HOUSE, Inc."				},
-	{ 0xfd80, "Phindex Technologies, Inc"			},
-	{ 0xfd7f, "Husqvarna AB"				},
-	{ 0xfd7e, "Samsung Electronics Co., Ltd."		},
-	{ 0xfd7d, "Center for Advanced Research Wernher Von Braun" },
-	{ 0xfd7c, "Toshiba Information Systems(Japan) Corporation" },
-	{ 0xfd7b, "WYZE LABS, INC."				},
-	{ 0xfd7a, "Withings"					},
-	{ 0xfd79, "Withings"					},
-	{ 0xfd78, "Withings"					},
-	{ 0xfd77, "Withings"					},
-	{ 0xfd76, "Insulet Corporation"				},
-	{ 0xfd75, "Insulet Corporation"				},
-	{ 0xfd74, "BRControls Products BV"			},
-	{ 0xfd73, "BRControls Products BV"			},
-	{ 0xfd72, "Logitech International SA"			},
-	{ 0xfd71, "GN Hearing A/S"				},
-	{ 0xfd70, "GuangDong Oppo Mobile Telecommunications Corp., Ltd." },
-	{ 0xfd6f, "Apple, Inc."					},
-	{ 0xfd6e, "Polidea sp. z o.o."				},
-	{ 0xfd6d, "Sigma Elektro GmbH"				},
-	{ 0xfd6c, "Samsung Electronics Co., Ltd."		},
-	{ 0xfd6b, " rapitag GmbH"				},
-	{ 0xfd6a, "Emerson"					},
-	{ 0xfd69, "Samsung Electronics Co., Ltd."		},
-	{ 0xfd68, "Ubique Innovation AG"			},
-	{ 0xfd67, "Montblanc Simplo GmbH"			},
-	{ 0xfd66, "Zebra Technologies Corporation"		},
-	{ 0xfd65, "Razer Inc."					},
-	{ 0xfd64, "INRIA"					},
-	{ 0xfd63, "Fitbit, Inc."				},
-	{ 0xfd62, "Fitbit, Inc."				},
-	{ 0xfd61, "Arendi AG"					},
-	{ 0xfd60, "Sercomm Corporation"				},
 	{ 0xfd5f, "Oculus VR, LLC"				},
+	{ 0xfd60, "Sercomm Corporation"				},
+	{ 0xfd61, "Arendi AG"					},
+	{ 0xfd62, "Fitbit, Inc."				},
+	{ 0xfd63, "Fitbit, Inc."				},
+	{ 0xfd64, "INRIA"					},
+	{ 0xfd65, "Razer Inc."					},
+	{ 0xfd66, "Zebra Technologies Corporation"		},
+	{ 0xfd67, "Montblanc Simplo GmbH"			},
+	{ 0xfd68, "Ubique Innovation AG"			},
+	{ 0xfd69, "Samsung Electronics Co., Ltd."		},
+	{ 0xfd6a, "Emerson"					},
+	{ 0xfd6b, " rapitag GmbH"				},
+	{ 0xfd6c, "Samsung Electronics Co., Ltd."		},
+	{ 0xfd6d, "Sigma Elektro GmbH"				},
+	{ 0xfd6e, "Polidea sp. z o.o."				},
+	{ 0xfd6f, "Apple, Inc."					},
+	{ 0xfd70, "GuangDong Oppo Mobile Telecommunications Corp., Ltd." },
+	{ 0xfd71, "GN Hearing A/S"				},
+	{ 0xfd72, "Logitech International SA"			},
+	{ 0xfd73, "BRControls Products BV"			},
+	{ 0xfd74, "BRControls Products BV"			},
+	{ 0xfd75, "Insulet Corporation"				},
+	{ 0xfd76, "Insulet Corporation"				},
+	{ 0xfd77, "Withings"					},
+	{ 0xfd78, "Withings"					},
+	{ 0xfd79, "Withings"					},
+	{ 0xfd7a, "Withings"					},
+	{ 0xfd7b, "WYZE LABS, INC."				},
+	{ 0xfd7c, "Toshiba Information Systems(Japan) Corporation" },
+	{ 0xfd7d, "Center for Advanced Research Wernher Von Braun" },
+	{ 0xfd7e, "Samsung Electronics Co., Ltd."		},
+	{ 0xfd7f, "Husqvarna AB"				},
+	{ 0xfd80, "Phindex Technologies, Inc"			},
+	{ 0xfd81, "CANDY HOUSE, Inc."				},
+	{ 0xfd82, "Sony Corporation"				},
+	{ 0xfd83, "iNFORM Technology GmbH"			},
+	{ 0xfd84, "Tile, Inc."					},
+	{ 0xfd85, "Husqvarna AB"				},
+	{ 0xfd86, "Abbott"					},
+	{ 0xfd87, "Google LLC"					},
+	{ 0xfd88, "Urbanminded LTD"				},
+	{ 0xfd89, "Urbanminded LTD"				},
+	{ 0xfd8a, "Signify Netherlands B.V."			},
+	{ 0xfd8b, "Jigowatts Inc."				},
+	{ 0xfd8c, "Google LLC"					},
+	{ 0xfd8d, "quip NYC Inc."				},
+	{ 0xfd8e, "Motorola Solutions"				},
+	{ 0xfd8f, "Matrix ComSec Pvt. Ltd."			},
+	{ 0xfd90, "Guangzhou SuperSound Information Technology Co.,Ltd" },
+	{ 0xfd91, "Groove X, Inc."				},
+	{ 0xfd92, "Qualcomm Technologies International, Ltd. (QTIL)" },
+	{ 0xfd93, "Bayerische Motoren Werke AG"			},
+	{ 0xfd94, "Hewlett Packard Enterprise"			},
+	{ 0xfd95, "Rigado"					},
+	{ 0xfd96, "Google LLC"					},
+	{ 0xfd97, "June Life, Inc."				},
+	{ 0xfd98, "Disney Worldwide Services, Inc."		},
+	{ 0xfd99, "ABB Oy"					},
+	{ 0xfd9a, "Huawei Technologies Co., Ltd."		},
+	{ 0xfd9b, "Huawei Technologies Co., Ltd."		},
+	{ 0xfd9c, "Huawei Technologies Co., Ltd."		},
+	{ 0xfd9d, "Gastec Corporation"				},
+	{ 0xfd9e, "The Coca-Cola Company"			},
+	{ 0xfd9f, "VitalTech Affiliates LLC"			},
+	{ 0xfda0, "Secugen Corporation"				},
+	{ 0xfda1, "Groove X, Inc"				},
+	{ 0xfda2, "Groove X, Inc"				},
+	{ 0xfda3, "Inseego Corp."				},
+	{ 0xfda4, "Inseego Corp."				},
+	{ 0xfda5, "Neurostim OAB, Inc."				},
+	{ 0xfda6, "WWZN Information Technology Company Limited"	},
+	{ 0xfda7, "WWZN Information Technology Company Limited"	},
+	{ 0xfda8, "PSA Peugeot Citroën"				},
+	{ 0xfda9, "Rhombus Systems, Inc."			},
+	{ 0xfdaa, "Xiaomi Inc."					},
+	{ 0xfdab, "Xiaomi Inc."					},
+	{ 0xfdac, "Tentacle Sync GmbH"				},
+	{ 0xfdad, "Houwa System Design, k.k."			},
+	{ 0xfdae, "Houwa System Design, k.k."			},
+	{ 0xfdaf, "Wiliot LTD"					},
+	{ 0xfdb0, "Proxy Technologies, Inc."			},
+	{ 0xfdb1, "Proxy Technologies, Inc."			},
+	{ 0xfdb2, "Portable Multimedia Ltd "			},
+	{ 0xfdb3, "Audiodo AB"					},
+	{ 0xfdb4, "HP Inc"					},
+	{ 0xfdb5, "ECSG"					},
+	{ 0xfdb6, "GWA Hygiene GmbH"				},
+	{ 0xfdb7, "LivaNova USA Inc."				},
+	{ 0xfdb8, "LivaNova USA Inc."				},
+	{ 0xfdb9, "Comcast Cable Corporation"			},
+	{ 0xfdba, "Comcast Cable Corporation"			},
+	{ 0xfdbb, "Profoto"					},
+	{ 0xfdbc, "Emerson"					},
+	{ 0xfdbd, "Clover Network, Inc."			},
+	{ 0xfdbe, "California Things Inc. "			},
+	{ 0xfdbf, "California Things Inc. "			},
+	{ 0xfdc0, "Hunter Douglas"				},
+	{ 0xfdc1, "Hunter Douglas"				},
+	{ 0xfdc2, "Baidu Online Network Technology (Beijing) Co., Ltd" },
+	{ 0xfdc3, "Baidu Online Network Technology (Beijing) Co., Ltd" },
+	{ 0xfdc4, "Simavita (Aust) Pty Ltd"			},
+	{ 0xfdc5, "Automatic Labs"				},
+	{ 0xfdc6, "Eli Lilly and Company"			},
+	{ 0xfdc7, "Eli Lilly and Company"			},
+	{ 0xfdc8, "Hach – Danaher"				},
+	{ 0xfdc9, "Busch-Jaeger Elektro GmbH"			},
+	{ 0xfdca, "Fortin Electronic Systems "			},
+	{ 0xfdcb, "Meggitt SA"					},
+	{ 0xfdcc, "Shoof Technologies"				},
+	{ 0xfdcd, "Qingping Technology (Beijing) Co., Ltd."	},
+	{ 0xfdce, "SENNHEISER electronic GmbH & Co. KG"		},
+	{ 0xfdcf, "Nalu Medical, Inc"				},
+	{ 0xfdd0, "Huawei Technologies Co., Ltd "		},
+	{ 0xfdd1, "Huawei Technologies Co., Ltd "		},
+	{ 0xfdd2, "Bose Corporation"				},
+	{ 0xfdd3, "FUBA Automotive Electronics GmbH"		},
+	{ 0xfdd4, "LX Solutions Pty Limited"			},
+	{ 0xfdd5, "Brompton Bicycle Ltd"			},
+	{ 0xfdd6, "Ministry of Supply "				},
+	{ 0xfdd7, "Emerson"					},
+	{ 0xfdd8, "Jiangsu Teranovo Tech Co., Ltd."		},
+	{ 0xfdd9, "Jiangsu Teranovo Tech Co., Ltd."		},
+	{ 0xfdda, "MHCS"					},
+	{ 0xfddb, "Samsung Electronics Co., Ltd. "		},
+	{ 0xfddc, "4iiii Innovations Inc."			},
+	{ 0xfddd, "Arch Systems Inc"				},
+	{ 0xfdde, "Noodle Technology Inc. "			},
+	{ 0xfddf, "Harman International"			},
+	{ 0xfde0, "John Deere"					},
+	{ 0xfde1, "Fortin Electronic Systems "			},
+	{ 0xfde2, "Google Inc."					},
+	{ 0xfde3, "Abbott Diabetes Care"			},
+	{ 0xfde4, "JUUL Labs, Inc."				},
+	{ 0xfde5, "SMK Corporation "				},
+	{ 0xfde6, "Intelletto Technologies Inc"			},
+	{ 0xfde7, "SECOM Co., LTD"				},
+	{ 0xfde8, "Robert Bosch GmbH"				},
+	{ 0xfde9, "Spacesaver Corporation"			},
+	{ 0xfdea, "SeeScan, Inc"				},
+	{ 0xfdeb, "Syntronix Corporation"			},
+	{ 0xfdec, "Mannkind Corporation"			},
+	{ 0xfded, "Pole Star"					},
+	{ 0xfdee, "Huawei Technologies Co., Ltd."		},
+	{ 0xfdef, "ART AND PROGRAM, INC."			},
+	{ 0xfdf0, "Google Inc."					},
+	{ 0xfdf1, "LAMPLIGHT Co.,Ltd"				},
+	{ 0xfdf2, "AMICCOM Electronics Corporation"		},
+	{ 0xfdf3, "Amersports"					},
+	{ 0xfdf4, "O. E. M. Controls, Inc."			},
+	{ 0xfdf5, "Milwaukee Electric Tools"			},
+	{ 0xfdf6, "AIAIAI ApS"					},
+	{ 0xfdf7, "HP Inc."					},
+	{ 0xfdf8, "Onvocal"					},
+	{ 0xfdf9, "INIA"					},
+	{ 0xfdfa, "Tandem Diabetes Care"			},
+	{ 0xfdfb, "Tandem Diabetes Care"			},
+	{ 0xfdfc, "Optrel AG"					},
+	{ 0xfdfd, "RecursiveSoft Inc."				},
+	{ 0xfdfe, "ADHERIUM(NZ) LIMITED"			},
+	{ 0xfdff, "OSRAM GmbH"					},
+	{ 0xfe00, "Amazon.com Services, Inc."			},
+	{ 0xfe01, "Duracell U.S. Operations Inc."		},
+	{ 0xfe02, "Robert Bosch GmbH"				},
+	{ 0xfe03, "Amazon.com Services, Inc."			},
+	{ 0xfe04, "OpenPath Security Inc"			},
+	{ 0xfe05, "CORE Transport Technologies NZ Limited "	},
+	{ 0xfe06, "Qualcomm Technologies, Inc."			},
+	{ 0xfe07, "Sonos, Inc."					},
+	{ 0xfe08, "Microsoft"					},
+	{ 0xfe09, "Pillsy, Inc."				},
+	{ 0xfe0a, "ruwido austria gmbh"				},
+	{ 0xfe0b, "ruwido austria gmbh"				},
+	{ 0xfe0c, "Procter & Gamble"				},
+	{ 0xfe0d, "Procter & Gamble"				},
+	{ 0xfe0e, "Setec Pty Ltd"				},
+	{ 0xfe0f, "Signify Netherlands B.V. (formerly Philips Lighting B.V.)" },
+	{ 0xfe10, "Lapis Semiconductor Co., Ltd."		},
+	{ 0xfe11, "GMC-I Messtechnik GmbH"			},
+	{ 0xfe12, "M-Way Solutions GmbH"			},
+	{ 0xfe13, "Apple Inc."					},
+	{ 0xfe14, "Flextronics International USA Inc."		},
+	{ 0xfe15, "Amazon.com Services, Inc.."			},
+	{ 0xfe16, "Footmarks, Inc."				},
+	{ 0xfe17, "Telit Wireless Solutions GmbH"		},
+	{ 0xfe18, "Runtime, Inc."				},
+	{ 0xfe19, "Google, Inc"					},
+	{ 0xfe1a, "Tyto Life LLC"				},
+	{ 0xfe1b, "Tyto Life LLC"				},
+	{ 0xfe1c, "NetMedia, Inc."				},
+	{ 0xfe1d, "Illuminati Instrument Corporation"		},
+	{ 0xfe1e, "Smart Innovations Co., Ltd"			},
+	{ 0xfe1f, "Garmin International, Inc."			},
+	{ 0xfe20, "Emerson"					},
+	{ 0xfe21, "Bose Corporation"				},
+	{ 0xfe22, "Zoll Medical Corporation"			},
+	{ 0xfe23, "Zoll Medical Corporation"			},
+	{ 0xfe24, "August Home Inc"				},
+	{ 0xfe25, "Apple, Inc. "				},
+	{ 0xfe26, "Google"					},
+	{ 0xfe27, "Google"					},
+	{ 0xfe28, "Ayla Networks"				},
+	{ 0xfe29, "Gibson Innovations"				},
+	{ 0xfe2a, "DaisyWorks, Inc."				},
+	{ 0xfe2b, "ITT Industries"				},
+	{ 0xfe2c, "Google"					},
+	{ 0xfe2d, "SMART INNOVATION Co.,Ltd"			},
+	{ 0xfe2e, "ERi,Inc."					},
+	{ 0xfe2f, "CRESCO Wireless, Inc"			},
+	{ 0xfe30, "Volkswagen AG"				},
+	{ 0xfe31, "Volkswagen AG"				},
+	{ 0xfe32, "Pro-Mark, Inc."				},
+	{ 0xfe33, "CHIPOLO d.o.o."				},
+	{ 0xfe34, "SmallLoop LLC"				},
+	{ 0xfe35, "HUAWEI Technologies Co., Ltd"		},
+	{ 0xfe36, "HUAWEI Technologies Co., Ltd"		},
+	{ 0xfe37, "Spaceek LTD"					},
+	{ 0xfe38, "Spaceek LTD"					},
+	{ 0xfe39, "TTS Tooltechnic Systems AG & Co. KG"		},
+	{ 0xfe3a, "TTS Tooltechnic Systems AG & Co. KG"		},
+	{ 0xfe3b, "Dobly Laboratories"				},
+	{ 0xfe3c, "alibaba"					},
+	{ 0xfe3d, "BD Medical"					},
+	{ 0xfe3e, "BD Medical"					},
+	{ 0xfe3f, "Friday Labs Limited"				},
+	{ 0xfe40, "Inugo Systems Limited"			},
+	{ 0xfe41, "Inugo Systems Limited"			},
+	{ 0xfe42, "Nets A/S "					},
+	{ 0xfe43, "Andreas Stihl AG & Co. KG"			},
+	{ 0xfe44, "SK Telecom "					},
+	{ 0xfe45, "Snapchat Inc"				},
+	{ 0xfe46, "B&O Play A/S "				},
+	{ 0xfe47, "General Motors "				},
+	{ 0xfe48, "General Motors "				},
+	{ 0xfe49, "SenionLab AB"				},
+	{ 0xfe4a, "OMRON HEALTHCARE Co., Ltd."			},
+	{ 0xfe4b, "Signify Netherlands B.V. (formerly Philips Lighting B.V.)" },
+	{ 0xfe4c, "Volkswagen AG "				},
+	{ 0xfe4d, "Casambi Technologies Oy"			},
+	{ 0xfe4e, "NTT docomo "					},
+	{ 0xfe4f, "Molekule, Inc."				},
+	{ 0xfe50, "Google Inc."					},
+	{ 0xfe51, "SRAM "					},
+	{ 0xfe52, "SetPoint Medical "				},
+	{ 0xfe53, "3M"						},
+	{ 0xfe54, "Motiv, Inc. "				},
+	{ 0xfe55, "Google Inc. "				},
+	{ 0xfe56, "Google Inc. "				},
+	{ 0xfe57, "Dotted Labs "				},
+	{ 0xfe58, "Nordic Semiconductor ASA "			},
+	{ 0xfe59, "Nordic Semiconductor ASA "			},
+	{ 0xfe5a, "Cronologics Corporation"			},
+	{ 0xfe5b, "GT-tronics HK Ltd"				},
+	{ 0xfe5c, "million hunters GmbH "			},
+	{ 0xfe5d, "Grundfos A/S "				},
+	{ 0xfe5e, "Plastc Corporation "				},
+	{ 0xfe5f, "Eyefi, Inc."					},
+	{ 0xfe60, "Lierda Science & Technology Group Co., Ltd."	},
+	{ 0xfe61, "Logitech International SA "			},
+	{ 0xfe62, "Indagem Tech LLC "				},
+	{ 0xfe63, "Connected Yard, Inc. "			},
+	{ 0xfe64, "Siemens AG"					},
+	{ 0xfe65, "CHIPOLO d.o.o. "				},
+	{ 0xfe66, "Intel Corporation "				},
+	{ 0xfe67, "Lab Sensor Solutions"			},
+	{ 0xfe68, "Capsule Technologies Inc."			},
+	{ 0xfe69, "Capsule Technologies Inc."			},
+	{ 0xfe6a, "Kontakt Micro-Location Sp. z o.o."		},
+	{ 0xfe6b, "TASER International, Inc."			},
+	{ 0xfe6c, "TASER International, Inc."			},
+	{ 0xfe6d, "The University of Tokyo "			},
+	{ 0xfe6e, "The University of Tokyo "			},
+	{ 0xfe6f, "LINE Corporation"				},
+	{ 0xfe70, "Beijing Jingdong Century Trading Co., Ltd."	},
+	{ 0xfe71, "Plume Design Inc"				},
+	{ 0xfe72, "Abbott (formerly St. Jude Medical, Inc.)"	},
+	{ 0xfe73, "Abbott (formerly St. Jude Medical, Inc.)"	},
+	{ 0xfe74, "unwire"					},
+	{ 0xfe75, "TangoMe"					},
+	{ 0xfe76, "TangoMe"					},
+	{ 0xfe77, "Hewlett-Packard Company"			},
+	{ 0xfe78, "Hewlett-Packard Company"			},
+	{ 0xfe79, "Zebra Technologies"				},
+	{ 0xfe7a, "Bragi GmbH"					},
+	{ 0xfe7b, "Orion Labs, Inc."				},
+	{ 0xfe7c, "Telit Wireless Solutions (Formerly Stollmann E+V GmbH)" },
+	{ 0xfe7d, "Aterica Health Inc."				},
+	{ 0xfe7e, "Awear Solutions Ltd"				},
+	{ 0xfe7f, "Doppler Lab"					},
+	{ 0xfe80, "Doppler Lab"					},
+	{ 0xfe81, "Medtronic Inc."				},
+	{ 0xfe82, "Medtronic Inc."				},
+	{ 0xfe83, "Blue Bite"					},
+	{ 0xfe84, "RF Digital Corp"				},
+	{ 0xfe85, "RF Digital Corp"				},
+	{ 0xfe86, "HUAWEI Technologies Co., Ltd. ( 华为技术有限公司 )"	},
+	{ 0xfe87, "Qingdao Yeelink Information Technology Co., Ltd. ( 青岛亿联客信息技术有限公司 )" },
+	{ 0xfe88, "SALTO SYSTEMS S.L."				},
+	{ 0xfe89, "B&O Play A/S"				},
+	{ 0xfe8a, "Apple, Inc."					},
+	{ 0xfe8b, "Apple, Inc."					},
+	{ 0xfe8c, "TRON Forum"					},
+	{ 0xfe8d, "Interaxon Inc."				},
+	{ 0xfe8e, "ARM Ltd"					},
+	{ 0xfe8f, "CSR"						},
+	{ 0xfe90, "JUMA"					},
+	{ 0xfe91, "Shanghai Imilab Technology Co.,Ltd"		},
+	{ 0xfe92, "Jarden Safety & Security"			},
+	{ 0xfe93, "OttoQ In"					},
+	{ 0xfe94, "OttoQ In"					},
+	{ 0xfe95, "Xiaomi Inc."					},
+	{ 0xfe96, "Tesla Motors Inc."				},
+	{ 0xfe97, "Tesla Motors Inc."				},
+	{ 0xfe98, "Currant Inc"					},
+	{ 0xfe99, "Currant Inc"					},
+	{ 0xfe9a, "Estimote"					},
+	{ 0xfe9b, "Samsara Networks, Inc"			},
+	{ 0xfe9c, "GSI Laboratories, Inc."			},
+	{ 0xfe9d, "Mobiquity Networks Inc"			},
+	{ 0xfe9e, "Dialog Semiconductor B.V."			},
+	{ 0xfe9f, "Google"					},
+	{ 0xfea0, "Google"					},
+	{ 0xfea1, "Intrepid Control Systems, Inc."		},
+	{ 0xfea2, "Intrepid Control Systems, Inc."		},
+	{ 0xfea3, "ITT Industries"				},
+	{ 0xfea4, "Paxton Access Ltd"				},
+	{ 0xfea5, "GoPro, Inc."					},
+	{ 0xfea6, "GoPro, Inc."					},
+	{ 0xfea7, "UTC Fire and Security"			},
+	{ 0xfea8, "Savant Systems LLC"				},
+	{ 0xfea9, "Savant Systems LLC"				},
+	{ 0xfeaa, "Google"					},
+	{ 0xfeab, "Nokia"					},
+	{ 0xfeac, "Nokia"					},
+	{ 0xfead, "Nokia"					},
+	{ 0xfeae, "Nokia"					},
+	{ 0xfeaf, "Nest Labs Inc"				},
+	{ 0xfeb0, "Nest Labs Inc"				},
+	{ 0xfeb1, "Electronics Tomorrow Limited"		},
+	{ 0xfeb2, "Microsoft Corporation"			},
+	{ 0xfeb3, "Taobao"					},
+	{ 0xfeb4, "WiSilica Inc."				},
+	{ 0xfeb5, "WiSilica Inc."				},
+	{ 0xfeb6, "Vencer Co., Ltd"				},
+	{ 0xfeb7, "Facebook, Inc."				},
+	{ 0xfeb8, "Facebook, Inc."				},
+	{ 0xfeb9, "LG Electronics"				},
+	{ 0xfeba, "Tencent Holdings Limited"			},
+	{ 0xfebb, "adafruit industries"				},
+	{ 0xfebc, "Dexcom Inc"					},
+	{ 0xfebd, "Clover Network, Inc"				},
+	{ 0xfebe, "Bose Corporation"				},
+	{ 0xfebf, "Nod, Inc."					},
+	{ 0xfec0, "KDDI Corporation"				},
+	{ 0xfec1, "KDDI Corporation"				},
+	{ 0xfec2, "Blue Spark Technologies, Inc."		},
+	{ 0xfec3, "360fly, Inc."				},
+	{ 0xfec4, "PLUS Location Systems"			},
+	{ 0xfec5, "Realtek Semiconductor Corp."			},
+	{ 0xfec6, "Kocomojo, LLC"				},
+	{ 0xfec7, "Apple, Inc."					},
+	{ 0xfec8, "Apple, Inc."					},
+	{ 0xfec9, "Apple, Inc."					},
+	{ 0xfeca, "Apple, Inc."					},
+	{ 0xfecb, "Apple, Inc."					},
+	{ 0xfecc, "Apple, Inc."					},
+	{ 0xfecd, "Apple, Inc."					},
+	{ 0xfece, "Apple, Inc."					},
+	{ 0xfecf, "Apple, Inc."					},
+	{ 0xfed0, "Apple, Inc."					},
+	{ 0xfed1, "Apple, Inc."					},
+	{ 0xfed2, "Apple, Inc."					},
+	{ 0xfed3, "Apple, Inc."					},
+	{ 0xfed4, "Apple, Inc."					},
+	{ 0xfed5, "Plantronics Inc."				},
+	{ 0xfed6, "Broadcom"					},
+	{ 0xfed7, "Broadcom"					},
+	{ 0xfed8, "Google"					},
+	{ 0xfed9, "Pebble Technology Corporation"		},
+	{ 0xfeda, "ISSC Technologies Corp. "			},
+	{ 0xfedb, "Perka, Inc."					},
+	{ 0xfedc, "Jawbone"					},
+	{ 0xfedd, "Jawbone"					},
+	{ 0xfede, "Coin, Inc."					},
+	{ 0xfedf, "Design SHIFT"				},
+	{ 0xfee0, "Anhui Huami Information Technology Co., Ltd. " },
+	{ 0xfee1, "Anhui Huami Information Technology Co., Ltd. " },
+	{ 0xfee2, "Anki, Inc."					},
+	{ 0xfee3, "Anki, Inc."					},
+	{ 0xfee4, "Nordic Semiconductor ASA"			},
+	{ 0xfee5, "Nordic Semiconductor ASA"			},
+	{ 0xfee6, "Silvair, Inc."				},
+	{ 0xfee7, "Tencent Holdings Limited."			},
+	{ 0xfee8, "Quintic Corp."				},
+	{ 0xfee9, "Quintic Corp."				},
+	{ 0xfeea, "Swirl Networks, Inc."			},
+	{ 0xfeeb, "Swirl Networks, Inc."			},
+	{ 0xfeec, "Tile, Inc."					},
+	{ 0xfeed, "Tile, Inc."					},
+	{ 0xfeee, "Polar Electro Oy "				},
+	{ 0xfeef, "Polar Electro Oy "				},
+	{ 0xfef0, "Intel"					},
+	{ 0xfef1, "CSR"						},
+	{ 0xfef2, "CSR"						},
+	{ 0xfef3, "Google"					},
+	{ 0xfef4, "Google"					},
+	{ 0xfef5, "Dialog Semiconductor GmbH"			},
+	{ 0xfef6, "Wicentric, Inc."				},
+	{ 0xfef7, "Aplix Corporation"				},
+	{ 0xfef8, "Aplix Corporation"				},
+	{ 0xfef9, "PayPal, Inc."				},
+	{ 0xfefa, "PayPal, Inc."				},
+	{ 0xfefb, "Telit Wireless Solutions (Formerly Stollmann E+V GmbH)" },
+	{ 0xfefc, "Gimbal, Inc."				},
+	{ 0xfefd, "Gimbal, Inc."				},
+	{ 0xfefe, "GN ReSound A/S"				},
+	{ 0xfeff, "GN Netcom"					},
 	/* SDO defined */
-	{ 0xfccc, "Wi-Fi Easy Connect Specification"		},
 	{ 0xffef, "Wi-Fi Direct Specification"			},
 	{ 0xfff0, "Public Key Open Credential (PKOC)"		},
 	{ 0xfff1, "ICCE Digital Key"				},
@@ -1684,11 +1777,18 @@ static const struct {
 
 const char *bt_uuid16_to_str(uint16_t uuid)
 {
-	int i;
+	size_t lo = 0, hi = ARRAY_SIZE(uuid16_table) - 1;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
 
-	for (i = 0; uuid16_table[i].str; i++) {
-		if (uuid16_table[i].uuid == uuid)
-			return uuid16_table[i].str;
+		if (uuid16_table[mid].uuid == uuid)
+			return uuid16_table[mid].str;
+
+		if (uuid16_table[mid].uuid < uuid)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
 	return "Unknown";
@@ -1741,18 +1841,21 @@ const char *bt_uuidstr_to_str(const char *uuid)
 	if (len != 36)
 		return NULL;
 
+	/* Most UUIDs use the base UUID which has no 128-bit entries */
+	if (!strncasecmp(uuid + 8, "-0000-1000-8000-00805f9b34fb", 28)) {
+		if (sscanf(uuid, "%08x-0000-1000-8000-00805f9b34fb",
+								&val) != 1)
+			return NULL;
+
+		return bt_uuid32_to_str(val);
+	}
+
 	for (i = 0; uuid128_table[i].str; i++) {
 		if (strcasecmp(uuid128_table[i].uuid, uuid) == 0)
 			return uuid128_table[i].str;
 	}
 
-	if (strncasecmp(uuid + 8, "-0000-1000-8000-00805f9b34fb", 28))
-		return "Vendor specific";
-
-	if (sscanf(uuid, "%08x-0000-1000-8000-00805f9b34fb", &val) != 1)
-		return NULL;
-
-	return bt_uuid32_to_str(val);
+	return "Vendor specific";
 }
 
 static const struct {
@@ -1819,26 +1922,26 @@ static const struct {
 
 const char *bt_appear_to_str(uint16_t appearance)
 {
-	const char *str = NULL;
-	int i, type = 0;
-
-	for (i = 0; appearance_table[i].str; i++) {
-		if (appearance_table[i].generic) {
-			if (appearance < appearance_table[i].val)
-				break;
-			type = i;
-		}
+	size_t lo = 0, hi = ARRAY_SIZE(appearance_table) - 1;
 
-		if (appearance_table[i].val == appearance) {
-			str = appearance_table[i].str;
-			break;
-		}
+	/* Find the last entry not above the value, the table is sorted */
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (appearance_table[mid].val <= appearance)
+			lo = mid;
+		else
+			hi = mid;
 	}
 
-	if (!str)
-		str = appearance_table[type].str;
+	if (appearance_table[lo].val == appearance)
+		return appearance_table[lo].str;
 
-	return str;
+	/* Otherwise fallback to the category of the value */
+	while (!appearance_table[lo].generic)
+		lo--;
+
+	return appearance_table[lo].str;
 }
 
 char *strdelimit(char *str, char *del, char c)
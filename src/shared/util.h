@@ -96,6 +96,49 @@ bool argsisutf8(int argc, char *argv[]);
 void *util_malloc(size_t size);
 void *util_memdup(const void *src, size_t size);
 
+#ifdef HAVE_ALLOC_STATS
+/* Allocations counted per call site, built with --enable-alloc-stats */
+struct util_alloc_site {
+	const char *file;
+	unsigned int line;
+	int registered;
+	uint64_t count;
+	uint64_t bytes;
+	struct util_alloc_site *next;
+};
+
+#define UTIL_ALLOC_SITE()					\
+	(__extension__ ({					\
+		static struct util_alloc_site __site = {	\
+			.file = __FILE__,			\
+			.line = __LINE__,			\
+		};						\
+		&__site;					\
+	}))
+
+void *util_malloc_site(struct util_alloc_site *site, size_t size);
+void *util_memdup_site(struct util_alloc_site *site, const void *src,
+								size_t size);
+
+#define util_malloc(size) util_malloc_site(UTIL_ALLOC_SITE(), (size))
+#define util_memdup(src, size) \
+	util_memdup_site(UTIL_ALLOC_SITE(), (src), (size))
+#endif
+
+/* Cache of equally sized, short-lived objects to avoid malloc/free pairs */
+struct util_pool {
+	size_t size;
+	unsigned int max;
+	unsigned int count;
+	void *free;
+};
+
+#define UTIL_POOL_INIT(type, max) { sizeof(type), (max), 0, NULL }
+
+void *util_pool_alloc(struct util_pool *pool);
+void util_pool_release(struct util_pool *pool, void *ptr);
+void util_pool_flush(struct util_pool *pool);
+
 typedef void (*util_debug_func_t)(const char *str, void *user_data);
 
 void util_debug_va(util_debug_func_t function, void *user_data,
@@ -105,6 +148,8 @@ void util_debug(util_debug_func_t function, void *user_data,
 						const char *format, ...)
 					__attribute__((format(printf, 3, 4)));
 
+void util_alloc_stats_dump(util_debug_func_t function, void *user_data);
+
 void util_hexdump(const char dir, const unsigned char *buf, size_t len,
 				util_debug_func_t function, void *user_data);
 
@@ -212,6 +212,7 @@ struct bt_vcp {
 
 	uint8_t volume;
 	uint8_t volume_counter;
+	bool volume_cached;
 
 	struct bt_vcp_client_op pending_op;
 
@@ -285,6 +286,7 @@ struct bt_aics {
 	struct aud_ip_st *aud_ipst;
 	struct gain_setting_prop *gain_settingprop;
 	uint8_t	aud_input_type;
+	bool aud_input_type_cached;
 	uint8_t	aud_input_status;
 	char *aud_input_descr;
 	struct gatt_db_attribute *service;
@@ -439,6 +441,8 @@ static void vcp_db_free(void *data)
 
 	free(vdb->vcs);
 	free(vdb->vocs);
+	if (vdb->aics)
+		free(vdb->aics->gain_settingprop);
 	free(vdb->aics);
 	free(vdb);
 }
@@ -2055,6 +2059,7 @@ static void vcp_vstate_notify(struct bt_vcp *vcp, uint16_t value_handle,
 
 	vcp->volume = vstate.vol_set;
 	vcp->volume_counter = vstate.counter;
+	vcp->volume_cached = true;
 
 	if (vcp->volume_changed)
 		vcp->volume_changed(vcp, vcp->volume);
@@ -2287,8 +2292,17 @@ static void read_vol_state(struct bt_vcp *vcp, bool success, uint8_t att_ecode,
 	DBG(vcp, "Vol Mute:%x", vs->mute);
 	DBG(vcp, "Vol Counter:%x", vs->counter);
 
-	vcp->volume = vs->vol_set;
 	vcp->volume_counter = vs->counter;
+
+	/* The volume cached from the last connection is already in use */
+	if (vcp->volume_cached && vcp->volume == vs->vol_set)
+		return;
+
+	vcp->volume = vs->vol_set;
+	vcp->volume_cached = true;
+
+	if (vcp->volume_changed)
+		vcp->volume_changed(vcp, vcp->volume);
 }
 
 static void read_vol_offset_state(struct bt_vcp *vcp, bool success,
@@ -2495,11 +2509,11 @@ static void foreach_vcs_char(struct gatt_db_attribute *attr, void *user_data)
 
 		vcs->vs = attr;
 
-		vcp_read_value(vcp, value_handle, read_vol_state, vcp);
-
 		vcp->vstate_id = vcp_register_notify(vcp, value_handle,
 						     vcp_vstate_notify, NULL);
 
+		vcp_read_value(vcp, value_handle, read_vol_state, vcp);
+
 		return;
 	}
 
@@ -2664,6 +2678,7 @@ static void read_aics_gain_setting_prop(struct bt_vcp *vcp, bool success,
 					 void *user_data)
 {
 	struct gain_setting_prop *aics_gain_setting_prop;
+	struct bt_aics *aics;
 	struct iovec iov = {
 		.iov_base = (void *) value,
 		.iov_len = length,
@@ -2694,6 +2709,13 @@ static void read_aics_gain_setting_prop(struct bt_vcp *vcp, bool success,
 				aics_gain_setting_prop->gain_setting_min);
 	DBG(vcp, "Gain Setting Properties,  Max Value: %d",
 				aics_gain_setting_prop->gain_setting_max);
+
+	aics = vcp_get_aics(vcp);
+	if (!aics || aics->gain_settingprop)
+		return;
+
+	aics->gain_settingprop = util_memdup(aics_gain_setting_prop,
+					sizeof(*aics_gain_setting_prop));
 }
 
 static void read_aics_aud_ip_type(struct bt_vcp *vcp, bool success,
@@ -2702,6 +2724,7 @@ static void read_aics_aud_ip_type(struct bt_vcp *vcp, bool success,
 					 void *user_data)
 {
 	uint8_t ip_type;
+	struct bt_aics *aics;
 
 	if (!success) {
 		DBG(vcp,
@@ -2713,6 +2736,13 @@ static void read_aics_aud_ip_type(struct bt_vcp *vcp, bool success,
 	memcpy(&ip_type, value, length);
 
 	DBG(vcp, "Audio Input Type : %x", ip_type);
+
+	aics = vcp_get_aics(vcp);
+	if (!aics)
+		return;
+
+	aics->aud_input_type = ip_type;
+	aics->aud_input_type_cached = true;
 }
 
 static void read_aics_audio_ip_status(struct bt_vcp *vcp, bool success,
@@ -2815,7 +2845,7 @@ static void foreach_aics_char(struct gatt_db_attribute *attr, void *user_data)
 			value_handle);
 
 		aics = vcp_get_aics(vcp);
-		if (!aics || aics->aud_ip_state)
+		if (!aics || (aics->aud_ip_state && aics->aud_ip_state != attr))
 			return;
 
 		aics->aud_ip_state = attr;
@@ -2835,11 +2865,16 @@ static void foreach_aics_char(struct gatt_db_attribute *attr, void *user_data)
 			value_handle);
 
 		aics = vcp_get_aics(vcp);
-		if (!aics || aics->gain_stting_prop)
+		if (!aics || (aics->gain_stting_prop &&
+					aics->gain_stting_prop != attr))
 			return;
 
 		aics->gain_stting_prop = attr;
 
+		/* Static value, only read it once per device */
+		if (aics->gain_settingprop)
+			return;
+
 		vcp_read_value(vcp, value_handle, read_aics_gain_setting_prop,
 					   vcp);
 		return;
@@ -2850,11 +2885,14 @@ static void foreach_aics_char(struct gatt_db_attribute *attr, void *user_data)
 			value_handle);
 
 		aics = vcp_get_aics(vcp);
-		if (!aics || aics->aud_ip_type)
+		if (!aics || (aics->aud_ip_type && aics->aud_ip_type != attr))
 			return;
 
 		aics->aud_ip_type = attr;
 
+		if (aics->aud_input_type_cached)
+			return;
+
 		vcp_read_value(vcp, value_handle, read_aics_aud_ip_type,
 					   vcp);
 		return;
@@ -2866,7 +2904,8 @@ static void foreach_aics_char(struct gatt_db_attribute *attr, void *user_data)
 			value_handle);
 
 		aics = vcp_get_aics(vcp);
-		if (!aics || aics->aud_ip_status)
+		if (!aics || (aics->aud_ip_status &&
+					aics->aud_ip_status != attr))
 			return;
 
 		aics->aud_ip_status = attr;
@@ -2884,7 +2923,7 @@ static void foreach_aics_char(struct gatt_db_attribute *attr, void *user_data)
 		DBG(vcp, "AICS Input CP found: handle 0x%04x", value_handle);
 
 		aics = vcp_get_aics(vcp);
-		if (!aics || aics->aud_ip_cp)
+		if (!aics || (aics->aud_ip_cp && aics->aud_ip_cp != attr))
 			return;
 
 		aics->aud_ip_cp = attr;
@@ -2898,7 +2937,8 @@ static void foreach_aics_char(struct gatt_db_attribute *attr, void *user_data)
 			value_handle);
 
 		aics = vcp_get_aics(vcp);
-		if (!aics || aics->aud_ip_dscrptn)
+		if (!aics || (aics->aud_ip_dscrptn &&
+					aics->aud_ip_dscrptn != attr))
 			return;
 
 		aics->aud_ip_dscrptn = attr;
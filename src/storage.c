@@ -32,6 +32,11 @@
 #include "lib/sdp_lib.h"
 #include "lib/uuid.h"
 
+#include "src/shared/util.h"
+#include "src/shared/timeout.h"
+
+#include "log.h"
+#include "btd.h"
 #include "textfile.h"
 #include "uuid-helper.h"
 #include "storage.h"
@@ -178,3 +183,177 @@ sdp_record_t *find_record_in_list(sdp_list_t *recs, const char *uuid)
 	}
 	return NULL;
 }
+
+struct storage_file {
+	char *data;
+	gsize length;
+	bool written;
+};
+
+/* Files written by btd_storage_save() and not flushed to disk yet */
+static GHashTable *pending_files;
+static unsigned int flush_id;
+
+static void storage_file_free(void *data)
+{
+	struct storage_file *file = data;
+
+	free(file->data);
+	free(file);
+}
+
+gboolean btd_storage_load(GKeyFile *key_file, const char *filename,
+							GError **gerr)
+{
+	struct storage_file *file = NULL;
+
+	if (pending_files)
+		file = g_hash_table_lookup(pending_files, filename);
+
+	if (file)
+		return g_key_file_load_from_data(key_file, file->data,
+						file->length, 0, gerr);
+
+	return g_key_file_load_from_file(key_file, filename, 0, gerr);
+}
+
+static bool flush_timeout(gpointer user_data)
+{
+	flush_id = 0;
+	btd_storage_flush();
+
+	return false;
+}
+
+gboolean btd_storage_save(const char *filename, const char *data,
+					gsize length, GError **gerr)
+{
+	struct storage_file *file;
+
+	if (!btd_opts.storage_delay)
+		return g_file_set_contents(filename, data, length, gerr);
+
+	if (!pending_files)
+		pending_files = g_hash_table_new_full(g_str_hash, g_str_equal,
+							g_free,
+							storage_file_free);
+
+	file = new0(struct storage_file, 1);
+	file->data = length ? util_memdup(data, length) : NULL;
+	file->length = length;
+
+	g_hash_table_replace(pending_files, g_strdup(filename), file);
+
+	if (!flush_id)
+		flush_id = timeout_add(btd_opts.storage_delay, flush_timeout,
+								NULL, NULL);
+
+	return TRUE;
+}
+
+static gboolean match_path(gpointer key, gpointer value, gpointer user_data)
+{
+	const char *filename = key;
+	const char *path = user_data;
+	size_t len = strlen(path);
+
+	return !strncmp(filename, path, len) &&
+			(filename[len] == '\0' || filename[len] == '/');
+}
+
+void btd_storage_remove(const char *path)
+{
+	if (pending_files)
+		g_hash_table_foreach_remove(pending_files, match_path,
+							(gpointer) path);
+}
+
+static void write_file(gpointer key, gpointer value, gpointer user_data)
+{
+	const char *filename = key;
+	struct storage_file *file = value;
+	char tmp[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		error("Unable to create %s: %s", tmp, strerror(errno));
+		return;
+	}
+
+	len = file->length ? write(fd, file->data, file->length) : 0;
+	close(fd);
+
+	if (len < 0 || (gsize) len != file->length) {
+		error("Unable to write %s", tmp);
+		unlink(tmp);
+		return;
+	}
+
+	file->written = true;
+}
+
+static void rename_file(gpointer key, gpointer value, gpointer user_data)
+{
+	const char *filename = key;
+	struct storage_file *file = value;
+	char tmp[PATH_MAX];
+
+	if (!file->written)
+		return;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+
+	if (rename(tmp, filename) < 0) {
+		error("Unable to rename %s: %s", tmp, strerror(errno));
+		unlink(tmp);
+	}
+}
+
+/*
+ * All pending files are written to temporary files first and synced with a
+ * single syncfs() before being renamed in place, so a crash never leaves a
+ * truncated file behind and the whole batch costs two syncs.
+ */
+void btd_storage_flush(void)
+{
+	int fd;
+
+	if (flush_id) {
+		timeout_remove(flush_id);
+		flush_id = 0;
+	}
+
+	if (!pending_files || !g_hash_table_size(pending_files))
+		return;
+
+	DBG("%u files", g_hash_table_size(pending_files));
+
+	g_hash_table_foreach(pending_files, write_file, NULL);
+
+	fd = open(STORAGEDIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd >= 0)
+		syncfs(fd);
+
+	g_hash_table_foreach(pending_files, rename_file, NULL);
+
+	if (fd >= 0) {
+		syncfs(fd);
+		close(fd);
+	}
+
+	g_hash_table_remove_all(pending_files);
+}
+
+void btd_storage_cleanup(void)
+{
+	btd_storage_flush();
+
+	if (pending_files) {
+		g_hash_table_destroy(pending_files);
+		pending_files = NULL;
+	}
+}
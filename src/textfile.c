@@ -22,6 +22,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
@@ -201,6 +202,151 @@ static char *strnpbrk(const char *s, ssize_t len, const char *accept)
 	return NULL;
 }
 
+struct textfile_entry {
+	const char *key;
+	size_t key_len;
+	const char *value;
+	size_t value_len;
+	unsigned int order;
+};
+
+static int key_cmp(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+	int cmp;
+
+	cmp = memcmp(a, b, MIN(a_len, b_len));
+	if (cmp)
+		return cmp;
+
+	if (a_len == b_len)
+		return 0;
+
+	return a_len < b_len ? -1 : 1;
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+	const struct textfile_entry *e1 = a, *e2 = b;
+	int cmp;
+
+	cmp = key_cmp(e1->key, e1->key_len, e2->key, e2->key_len);
+	if (cmp)
+		return cmp;
+
+	/* Keep the first occurrence of a duplicated key first */
+	return e1->order < e2->order ? -1 : 1;
+}
+
+static const char *find_eol(const char *ptr, const char *end)
+{
+	while (ptr < end && *ptr != '\r' && *ptr != '\n')
+		ptr++;
+
+	return ptr;
+}
+
+static const char *skip_eol(const char *ptr, const char *end)
+{
+	while (ptr < end && (*ptr == '\r' || *ptr == '\n'))
+		ptr++;
+
+	return ptr;
+}
+
+static struct textfile_entry *find_entry(struct textfile_entry *entries,
+					unsigned int num, const char *key,
+					size_t len)
+{
+	unsigned int start = 0, end = num;
+
+	/* Lower bound so that duplicated keys resolve like find_key() */
+	while (start < end) {
+		unsigned int mid = start + (end - start) / 2;
+
+		if (key_cmp(entries[mid].key, entries[mid].key_len,
+							key, len) < 0)
+			start = mid + 1;
+		else
+			end = mid;
+	}
+
+	if (start == num || key_cmp(entries[start].key, entries[start].key_len,
+							key, len))
+		return NULL;
+
+	return &entries[start];
+}
+
+static struct textfile_entry *index_entries(const char *map, size_t size,
+							unsigned int *num)
+{
+	struct textfile_entry *entries = NULL, *tmp;
+	const char *off = map, *end = map + size;
+	unsigned int max = 0;
+
+	*num = 0;
+
+	while (off < end) {
+		const char *eol, *sep;
+
+		off = skip_eol(off, end);
+		eol = find_eol(off, end);
+
+		sep = memchr(off, ' ', eol - off);
+		if (sep) {
+			if (*num == max) {
+				max = max ? max * 2 : 16;
+				tmp = realloc(entries, max * sizeof(*entries));
+				if (!tmp) {
+					free(entries);
+					return NULL;
+				}
+				entries = tmp;
+			}
+
+			entries[*num].key = off;
+			entries[*num].key_len = sep - off;
+			entries[*num].value = sep + 1;
+			entries[*num].value_len = eol - sep - 1;
+			entries[*num].order = *num;
+			(*num)++;
+		}
+
+		off = eol;
+	}
+
+	if (!entries)
+		return malloc(sizeof(*entries));
+
+	qsort(entries, *num, sizeof(*entries), entry_cmp);
+
+	return entries;
+}
+
+static struct textfile_entry *index_keys(const char *keys[],
+					const char *values[],
+					unsigned int count)
+{
+	struct textfile_entry *entries;
+	unsigned int i;
+
+	entries = calloc(count ? count : 1, sizeof(*entries));
+	if (!entries)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		entries[i].key = keys[i];
+		entries[i].key_len = strlen(keys[i]);
+		entries[i].value = values[i];
+		entries[i].value_len = values[i] ? strlen(values[i]) : 0;
+		entries[i].order = i;
+	}
+
+	qsort(entries, count, sizeof(*entries), entry_cmp);
+
+	return entries;
+}
+
 static int write_key(const char *pathname, const char *key, const char *value, int icase)
 {
 	struct stat st;
@@ -404,6 +550,239 @@ char *textfile_get(const char *pathname, const char *key)
 	return read_key(pathname, key, 0);
 }
 
+int textfile_get_multi(const char *pathname, const char *keys[],
+				char *values[], unsigned int count)
+{
+	struct textfile_entry *entries, *entry;
+	struct stat st;
+	char *map;
+	off_t size;
+	unsigned int i, num;
+	int fd, err = 0;
+
+	for (i = 0; i < count; i++)
+		values[i] = NULL;
+
+	fd = open(pathname, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (flock(fd, LOCK_SH) < 0) {
+		err = -errno;
+		goto close;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		goto unlock;
+	}
+
+	size = st.st_size;
+	if (!size)
+		goto unlock;
+
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (!map || map == MAP_FAILED) {
+		err = -errno;
+		goto unlock;
+	}
+
+	entries = index_entries(map, size, &num);
+	if (!entries) {
+		err = -ENOMEM;
+		goto unmap;
+	}
+
+	for (i = 0; i < count; i++) {
+		entry = find_entry(entries, num, keys[i], strlen(keys[i]));
+		if (!entry)
+			continue;
+
+		values[i] = strndup(entry->value, entry->value_len);
+		if (!values[i]) {
+			err = -ENOMEM;
+			break;
+		}
+	}
+
+	free(entries);
+
+	if (err < 0) {
+		for (i = 0; i < count; i++) {
+			free(values[i]);
+			values[i] = NULL;
+		}
+	}
+
+unmap:
+	munmap(map, size);
+
+unlock:
+	flock(fd, LOCK_UN);
+
+close:
+	close(fd);
+	errno = -err;
+
+	return err;
+}
+
+static size_t put_entry(char *buf, const struct textfile_entry *entry)
+{
+	memcpy(buf, entry->key, entry->key_len);
+	buf[entry->key_len] = ' ';
+	memcpy(buf + entry->key_len + 1, entry->value, entry->value_len);
+	buf[entry->key_len + entry->value_len + 1] = '\n';
+
+	return entry->key_len + entry->value_len + 2;
+}
+
+int textfile_put_multi(const char *pathname, const char *keys[],
+				const char *values[], unsigned int count)
+{
+	struct textfile_entry *updates, *entry;
+	struct stat st;
+	const char *off, *end;
+	char *map = NULL, *buf;
+	bool *done;
+	off_t size;
+	size_t len = 0, max;
+	unsigned int i;
+	bool changed = false;
+	int fd, err = 0;
+
+	updates = index_keys(keys, values, count);
+	if (!updates)
+		return -ENOMEM;
+
+	done = calloc(count ? count : 1, sizeof(*done));
+	if (!done) {
+		free(updates);
+		return -ENOMEM;
+	}
+
+	fd = open(pathname, O_RDWR);
+	if (fd < 0) {
+		err = -errno;
+		goto free;
+	}
+
+	if (flock(fd, LOCK_EX) < 0) {
+		err = -errno;
+		goto close;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		goto unlock;
+	}
+
+	size = st.st_size;
+
+	if (size) {
+		map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (!map || map == MAP_FAILED) {
+			err = -errno;
+			goto unlock;
+		}
+	}
+
+	max = size + 1;
+	for (i = 0; i < count; i++)
+		max += updates[i].key_len + updates[i].value_len + 2;
+
+	buf = malloc(max);
+	if (!buf) {
+		err = -ENOMEM;
+		goto unmap;
+	}
+
+	off = map;
+	end = map + size;
+
+	while (off < end) {
+		const char *eol, *next, *sep;
+
+		eol = find_eol(off, end);
+		next = skip_eol(eol, end);
+
+		sep = memchr(off, ' ', eol - off);
+		entry = sep ? find_entry(updates, count, off, sep - off) : NULL;
+		if (!entry || done[entry - updates]) {
+			memcpy(buf + len, off, next - off);
+			len += next - off;
+			off = next;
+			continue;
+		}
+
+		done[entry - updates] = true;
+
+		if (!entry->value) {
+			changed = true;
+		} else {
+			if ((size_t) (eol - sep - 1) != entry->value_len ||
+					memcmp(sep + 1, entry->value,
+							entry->value_len))
+				changed = true;
+
+			len += put_entry(buf + len, entry);
+		}
+
+		off = next;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (done[i] || !updates[i].value)
+			continue;
+
+		if (len && buf[len - 1] != '\n' && buf[len - 1] != '\r')
+			buf[len++] = '\n';
+
+		len += put_entry(buf + len, &updates[i]);
+		changed = true;
+	}
+
+	if (map) {
+		munmap(map, size);
+		map = NULL;
+	}
+
+	if (!changed)
+		goto done;
+
+	if (ftruncate(fd, 0) < 0) {
+		err = -errno;
+		goto done;
+	}
+
+	lseek(fd, 0, SEEK_SET);
+
+	if (len && write(fd, buf, len) < 0)
+		err = -errno;
+
+	fdatasync(fd);
+
+done:
+	free(buf);
+
+unmap:
+	if (map)
+		munmap(map, size);
+
+unlock:
+	flock(fd, LOCK_UN);
+
+close:
+	close(fd);
+
+free:
+	free(done);
+	free(updates);
+	errno = -err;
+
+	return err;
+}
+
 int textfile_foreach(const char *pathname, textfile_cb func, void *data)
 {
 	struct stat st;
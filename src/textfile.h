@@ -17,6 +17,11 @@ int textfile_put(const char *pathname, const char *key, const char *value);
 int textfile_del(const char *pathname, const char *key);
 char *textfile_get(const char *pathname, const char *key);
 
+int textfile_put_multi(const char *pathname, const char *keys[],
+				const char *values[], unsigned int count);
+int textfile_get_multi(const char *pathname, const char *keys[],
+				char *values[], unsigned int count);
+
 typedef void (*textfile_cb) (char *key, char *value, void *data);
 
 int textfile_foreach(const char *pathname, textfile_cb func, void *data);
@@ -20,10 +20,12 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <getopt.h>
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <poll.h>
+#include <linux/serial.h>
 
 #include "lib/bluetooth.h"
 #include "lib/hci.h"
@@ -37,7 +39,231 @@
 #include "src/shared/tty.h"
 #include "src/shared/hci.h"
 
-static int open_serial(const char *path, unsigned int speed, bool flowctl)
+#define PROBE_TIMEOUT	1000
+
+static bool low_latency = false;
+static bool probe_speed = false;
+static unsigned int rx_trigger = 0;
+static unsigned int stats_interval = 0;
+
+static const unsigned int probe_speeds[] = {
+	4000000, 3000000, 2000000, 1500000, 1000000,
+	921600, 460800, 230400, 0
+};
+
+static bool uart_cmd(int fd, uint16_t opcode, const void *param,
+				uint8_t plen, void *rsp, size_t rsp_len)
+{
+	uint8_t pkt[4 + 255], buf[3 + 255];
+	struct pollfd p;
+	size_t len = 0, need = 3;
+
+	pkt[0] = BT_H4_CMD_PKT;
+	put_le16(opcode, pkt + 1);
+	pkt[3] = plen;
+	if (plen)
+		memcpy(pkt + 4, param, plen);
+
+	tcflush(fd, TCIOFLUSH);
+
+	if (write(fd, pkt, 4 + plen) != 4 + plen)
+		return false;
+
+	p.fd = fd;
+	p.events = POLLIN;
+
+	while (1) {
+		ssize_t r;
+
+		if (poll(&p, 1, PROBE_TIMEOUT) <= 0)
+			return false;
+
+		r = read(fd, buf + len, need - len);
+		if (r <= 0)
+			return false;
+
+		len += r;
+
+		/* Drop line noise left over from a speed change */
+		while (len > 0 && buf[0] != BT_H4_EVT_PKT) {
+			memmove(buf, buf + 1, --len);
+			need = 3;
+		}
+
+		if (len < need)
+			continue;
+
+		if (need == 3) {
+			need += buf[2];
+			if (len < need)
+				continue;
+		}
+
+		if (buf[1] == BT_HCI_EVT_CMD_COMPLETE && buf[2] >= 4 &&
+					get_le16(buf + 4) == opcode) {
+			if (rsp) {
+				memset(rsp, 0, rsp_len);
+				memcpy(rsp, buf + 6, rsp_len < len - 6 ?
+							rsp_len : len - 6);
+			}
+			return buf[6] == 0x00;
+		}
+
+		if (buf[1] == BT_HCI_EVT_CMD_STATUS && buf[2] >= 4 &&
+					get_le16(buf + 5) == opcode)
+			return buf[3] == 0x00;
+
+		/* Not the event we are waiting for */
+		len = 0;
+		need = 3;
+	}
+}
+
+static bool bcm_set_speed(int fd, unsigned int speed)
+{
+	uint8_t param[6] = { 0x00, 0x00 };
+
+	/* Rates above 3 Mbit require the 48 MHz UART clock */
+	if (speed > 3000000) {
+		uint8_t clock = 0x02;
+
+		if (!uart_cmd(fd, 0xfc45, &clock, 1, NULL, 0))
+			return false;
+	}
+
+	put_le32(speed, param + 2);
+
+	return uart_cmd(fd, 0xfc18, param, sizeof(param), NULL, 0);
+}
+
+static bool ti_set_speed(int fd, unsigned int speed)
+{
+	uint8_t param[4];
+
+	put_le32(speed, param);
+
+	return uart_cmd(fd, 0xff36, param, sizeof(param), NULL, 0);
+}
+
+static const struct {
+	uint16_t manufacturer;
+	bool (*set_speed)(int fd, unsigned int speed);
+} vendor_table[] = {
+	{ 13,  ti_set_speed  },		/* Texas Instruments */
+	{ 15,  bcm_set_speed },		/* Broadcom */
+	{ 305, bcm_set_speed },		/* Cypress */
+	{ }
+};
+
+static int set_tty_speed(int fd, unsigned int speed)
+{
+	struct termios ti;
+
+	if (tcgetattr(fd, &ti) < 0)
+		return -1;
+
+	cfsetospeed(&ti, speed);
+	cfsetispeed(&ti, speed);
+
+	return tcsetattr(fd, TCSADRAIN, &ti);
+}
+
+static void probe_uart_speed(int fd, unsigned int baudrate)
+{
+	struct bt_hci_rsp_read_local_version rsp;
+	uint16_t manufacturer;
+	unsigned int i, j;
+
+	if (!uart_cmd(fd, BT_HCI_CMD_READ_LOCAL_VERSION, NULL, 0,
+						&rsp, sizeof(rsp))) {
+		fprintf(stderr, "No response at %u baud, skipping probe\n",
+								baudrate);
+		return;
+	}
+
+	manufacturer = le16_to_cpu(rsp.manufacturer);
+
+	for (i = 0; vendor_table[i].set_speed; i++) {
+		if (vendor_table[i].manufacturer == manufacturer)
+			break;
+	}
+
+	if (!vendor_table[i].set_speed) {
+		printf("No speed probing for manufacturer %u\n", manufacturer);
+		return;
+	}
+
+	for (j = 0; probe_speeds[j] > baudrate; j++) {
+		unsigned int speed = tty_get_speed(probe_speeds[j]);
+
+		if (!speed || !vendor_table[i].set_speed(fd, probe_speeds[j]))
+			continue;
+
+		if (set_tty_speed(fd, speed) < 0) {
+			perror("Failed to change serial port speed");
+			break;
+		}
+
+		if (uart_cmd(fd, BT_HCI_CMD_READ_LOCAL_VERSION, NULL, 0,
+							NULL, 0)) {
+			printf("Switched speed to %u baud\n", probe_speeds[j]);
+			return;
+		}
+
+		/* Controller did not follow, fall back to the initial rate */
+		if (set_tty_speed(fd, tty_get_speed(baudrate)) < 0)
+			break;
+	}
+
+	printf("Keeping speed at %u baud\n", baudrate);
+}
+
+static void set_low_latency(int fd)
+{
+	struct serial_struct ss;
+
+	if (ioctl(fd, TIOCGSERIAL, &ss) < 0) {
+		perror("Failed to get serial port info");
+		return;
+	}
+
+	ss.flags |= ASYNC_LOW_LATENCY;
+
+	if (ioctl(fd, TIOCSSERIAL, &ss) < 0)
+		perror("Failed to enable low latency mode");
+}
+
+static void set_rx_trigger(const char *path)
+{
+	char *real, *name, sysfs[PATH_MAX];
+	int fd, len;
+
+	real = realpath(path, NULL);
+	if (!real) {
+		perror("Failed to resolve serial port path");
+		return;
+	}
+
+	name = strrchr(real, '/');
+	snprintf(sysfs, sizeof(sysfs), "/sys/class/tty/%s/rx_trig_bytes",
+						name ? name + 1 : real);
+	free(real);
+
+	fd = open(sysfs, O_WRONLY | O_CLOEXEC);
+	if (fd < 0) {
+		perror("Failed to open RX trigger level");
+		return;
+	}
+
+	len = dprintf(fd, "%u", rx_trigger);
+	if (len < 0)
+		perror("Failed to set RX trigger level");
+
+	close(fd);
+}
+
+static int open_serial(const char *path, unsigned int speed,
+				unsigned int baudrate, bool flowctl, bool probe)
 {
 	struct termios ti;
 	int fd, saved_ldisc, ldisc = N_HCI;
@@ -77,6 +303,15 @@ static int open_serial(const char *path, unsigned int speed, bool flowctl)
 		return -1;
 	}
 
+	if (low_latency)
+		set_low_latency(fd);
+
+	if (rx_trigger)
+		set_rx_trigger(path);
+
+	if (probe)
+		probe_uart_speed(fd, baudrate);
+
 	if (ioctl(fd, TIOCSETD, &ldisc) < 0) {
 		perror("Failed set serial line discipline");
 		close(fd);
@@ -96,12 +331,60 @@ static void local_version_callback(const void *data, uint8_t size,
 	printf("Manufacturer: %u\n", le16_to_cpu(rsp->manufacturer));
 }
 
+struct uart_stats {
+	int fd;
+	struct serial_icounter_struct last;
+};
+
+static bool stats_timeout(void *user_data)
+{
+	struct uart_stats *stats = user_data;
+	struct serial_icounter_struct icount;
+
+	if (ioctl(stats->fd, TIOCGICOUNT, &icount) < 0) {
+		perror("Failed to get serial port counters");
+		return false;
+	}
+
+	printf("UART %d: RX %u B/s TX %u B/s overrun %d buffer overrun %d\n",
+			stats->fd,
+			(icount.rx - stats->last.rx) / stats_interval,
+			(icount.tx - stats->last.tx) / stats_interval,
+			icount.overrun - stats->last.overrun,
+			icount.buf_overrun - stats->last.buf_overrun);
+
+	stats->last = icount;
+
+	return true;
+}
+
+static void start_stats(int fd)
+{
+	struct uart_stats *stats;
+
+	stats = new0(struct uart_stats, 1);
+	stats->fd = fd;
+
+	if (ioctl(fd, TIOCGICOUNT, &stats->last) < 0) {
+		perror("Failed to get serial port counters");
+		free(stats);
+		return;
+	}
+
+	timeout_add_seconds(stats_interval, stats_timeout, stats, free);
+}
+
 static int attach_proto(const char *path, unsigned int proto,
-			unsigned int speed, bool flowctl, unsigned int flags)
+			unsigned int speed, unsigned int baudrate,
+			bool flowctl, unsigned int flags)
 {
 	int fd, dev_id;
 
-	fd = open_serial(path, speed, flowctl);
+	if (probe_speed && proto != HCI_UART_H4)
+		fprintf(stderr, "Speed probing requires H4, skipping\n");
+
+	fd = open_serial(path, speed, baudrate, flowctl,
+				probe_speed && proto == HCI_UART_H4);
 	if (fd < 0)
 		return -1;
 
@@ -126,6 +409,9 @@ static int attach_proto(const char *path, unsigned int proto,
 
 	printf("Device index %d attached\n", dev_id);
 
+	if (stats_interval)
+		start_stats(fd);
+
 	if (flags & (1 << HCI_UART_RAW_DEVICE)) {
 		unsigned int attempts = 6;
 		struct bt_hci *hci;
@@ -182,6 +468,10 @@ static void usage(void)
 		"\t-P, --protocol <proto> Specify protocol type\n"
 		"\t-S, --speed <baudrate> Specify which baudrate to use\n"
 		"\t-N, --noflowctl        Disable flow control\n"
+		"\t-L, --lowlatency       Enable low latency serial mode\n"
+		"\t-F, --probe            Probe for the fastest baudrate\n"
+		"\t-t, --rxtrigger <num>  Set UART RX FIFO trigger level\n"
+		"\t-T, --stats <seconds>  Report UART throughput\n"
 		"\t-h, --help             Show help options\n");
 }
 
@@ -191,6 +481,10 @@ static const struct option main_options[] = {
 	{ "protocol", required_argument, NULL, 'P' },
 	{ "speed",    required_argument, NULL, 'S' },
 	{ "noflowctl",no_argument,       NULL, 'N' },
+	{ "lowlatency",no_argument,      NULL, 'L' },
+	{ "probe",    no_argument,       NULL, 'F' },
+	{ "rxtrigger",required_argument, NULL, 't' },
+	{ "stats",    required_argument, NULL, 'T' },
 	{ "version",  no_argument,       NULL, 'v' },
 	{ "help",     no_argument,       NULL, 'h' },
 	{ }
@@ -220,12 +514,12 @@ int main(int argc, char *argv[])
 	const char *bredr_path = NULL, *amp_path = NULL, *proto = NULL;
 	bool flowctl = true, raw_device = false;
 	int exit_status, count = 0, proto_id = HCI_UART_H4;
-	unsigned int speed = B115200;
+	unsigned int speed = B115200, baudrate = 115200;
 
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "B:A:P:S:NRvh",
+		opt = getopt_long(argc, argv, "B:A:P:S:NLFt:T:Rvh",
 						main_options, NULL);
 		if (opt < 0)
 			break;
@@ -241,7 +535,8 @@ int main(int argc, char *argv[])
 			proto = optarg;
 			break;
 		case 'S':
-			speed = tty_get_speed(atoi(optarg));
+			baudrate = atoi(optarg);
+			speed = tty_get_speed(baudrate);
 			if (!speed) {
 				fprintf(stderr, "Invalid speed: %s\n", optarg);
 				return EXIT_FAILURE;
@@ -250,6 +545,18 @@ int main(int argc, char *argv[])
 		case 'N':
 			flowctl = false;
 			break;
+		case 'L':
+			low_latency = true;
+			break;
+		case 'F':
+			probe_speed = true;
+			break;
+		case 't':
+			rx_trigger = atoi(optarg);
+			break;
+		case 'T':
+			stats_interval = atoi(optarg);
+			break;
 		case 'R':
 			raw_device = true;
 			break;
@@ -298,7 +605,8 @@ int main(int argc, char *argv[])
 		if (raw_device)
 			flags = (1 << HCI_UART_RAW_DEVICE);
 
-		fd = attach_proto(bredr_path, proto_id, speed, flowctl, flags);
+		fd = attach_proto(bredr_path, proto_id, speed, baudrate,
+							flowctl, flags);
 		if (fd >= 0) {
 			mainloop_add_fd(fd, 0, uart_callback, NULL, NULL);
 			count++;
@@ -317,7 +625,8 @@ int main(int argc, char *argv[])
 		if (raw_device)
 			flags = (1 << HCI_UART_RAW_DEVICE);
 
-		fd = attach_proto(amp_path, proto_id, speed, flowctl, flags);
+		fd = attach_proto(amp_path, proto_id, speed, baudrate,
+							flowctl, flags);
 		if (fd >= 0) {
 			mainloop_add_fd(fd, 0, uart_callback, NULL, NULL);
 			count++;
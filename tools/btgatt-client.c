@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <getopt.h>
 #include <limits.h>
 #include <errno.h>
@@ -31,6 +32,7 @@
 #include "src/shared/util.h"
 #include "src/shared/att.h"
 #include "src/shared/queue.h"
+#include "src/shared/timeout.h"
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
 #include "src/shared/gatt-helpers.h"
@@ -40,6 +42,21 @@
 #define PRLOG(...) \
 	printf(__VA_ARGS__); print_prompt();
 
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#define UUID_BENCH		"a3c87500-8ed3-4bdf-8a39-a01bebede295"
+#define UUID_BENCH_DATA		"a3c87501-8ed3-4bdf-8a39-a01bebede295"
+#define UUID_BENCH_CTRL		"a3c87502-8ed3-4bdf-8a39-a01bebede295"
+#define UUID_BENCH_STATS	"a3c87503-8ed3-4bdf-8a39-a01bebede295"
+
+#define BENCH_CTRL_STOP		0x00
+#define BENCH_CTRL_START	0x01
+#define BENCH_CTRL_RESET	0x02
+
+#define BENCH_MAX_CHRCS		8
+
 #define COLOR_OFF	"\x1B[0m"
 #define COLOR_RED	"\x1B[0;91m"
 #define COLOR_GREEN	"\x1B[0;92m"
@@ -59,6 +76,45 @@ struct client {
 
 	unsigned int reliable_session_id;
 	bool sec_retry;
+
+	uint16_t bench_ctrl;
+	uint16_t bench_stats;
+	uint16_t bench_data[BENCH_MAX_CHRCS];
+	int bench_chrcs;
+	struct bench *bench;
+};
+
+struct bench {
+	struct client *cli;
+	unsigned int duration;
+	uint64_t start;
+	uint64_t last;
+	unsigned int timeout_id;
+
+	/* bench-notify */
+	unsigned int notify_id[BENCH_MAX_CHRCS];
+	int registered;
+	uint16_t interval;
+	uint16_t burst;
+	uint32_t next_seq;
+	uint64_t pkts;
+	uint64_t bytes;
+	uint64_t lost;
+
+	/* bench-write */
+	uint16_t len;
+	unsigned int window;
+	uint64_t tx_base;
+	uint64_t sent;
+	uint8_t value[BT_ATT_MAX_VALUE_LEN];
+
+	/* bench-read */
+	unsigned int count;
+	unsigned int parallel;
+	unsigned int issued;
+	unsigned int done;
+	unsigned int failed;
+	uint32_t *latency;
 };
 
 static void print_prompt(void)
@@ -237,8 +293,11 @@ static struct client *client_create(int fd, uint16_t mtu)
 	return cli;
 }
 
+static void bench_free(struct bench *bench);
+
 static void client_destroy(struct client *cli)
 {
+	bench_free(cli->bench);
 	bt_gatt_client_unref(cli->gatt);
 	bt_att_unref(cli->att);
 	free(cli);
@@ -1514,6 +1573,608 @@ static void cmd_search_characteristics(struct client *cli, char *cmd_str)
 						NULL);
 }
 
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void bench_free(struct bench *bench)
+{
+	int i;
+
+	if (!bench)
+		return;
+
+	timeout_remove(bench->timeout_id);
+
+	for (i = 0; i < BENCH_MAX_CHRCS; i++) {
+		if (bench->notify_id[i])
+			bt_gatt_client_unregister_notify(bench->cli->gatt,
+							bench->notify_id[i]);
+	}
+
+	bench->cli->bench = NULL;
+	free(bench->latency);
+	free(bench);
+}
+
+static void bench_chrc_cb(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct client *cli = user_data;
+	uint16_t handle, value_handle;
+	uint8_t props;
+	bt_uuid_t uuid, bench_uuid;
+
+	if (!gatt_db_attribute_get_char_data(attr, &handle, &value_handle,
+						&props, NULL, &uuid))
+		return;
+
+	bt_string_to_uuid(&bench_uuid, UUID_BENCH_CTRL);
+	if (!bt_uuid_cmp(&uuid, &bench_uuid)) {
+		cli->bench_ctrl = value_handle;
+		return;
+	}
+
+	bt_string_to_uuid(&bench_uuid, UUID_BENCH_STATS);
+	if (!bt_uuid_cmp(&uuid, &bench_uuid)) {
+		cli->bench_stats = value_handle;
+		return;
+	}
+
+	bt_string_to_uuid(&bench_uuid, UUID_BENCH_DATA);
+	if (!bt_uuid_cmp(&uuid, &bench_uuid) &&
+					cli->bench_chrcs < BENCH_MAX_CHRCS)
+		cli->bench_data[cli->bench_chrcs++] = value_handle;
+}
+
+static void bench_service_cb(struct gatt_db_attribute *attr, void *user_data)
+{
+	gatt_db_service_foreach_char(attr, bench_chrc_cb, user_data);
+}
+
+static struct bench *bench_new(struct client *cli)
+{
+	bt_uuid_t uuid;
+
+	if (!bt_gatt_client_is_ready(cli->gatt)) {
+		printf("GATT client not initialized\n");
+		return NULL;
+	}
+
+	if (cli->bench) {
+		printf("Benchmark already in progress\n");
+		return NULL;
+	}
+
+	if (!cli->bench_ctrl) {
+		cli->bench_chrcs = 0;
+		bt_string_to_uuid(&uuid, UUID_BENCH);
+		gatt_db_foreach_service(cli->db, &uuid, bench_service_cb, cli);
+	}
+
+	if (!cli->bench_ctrl || !cli->bench_stats || !cli->bench_chrcs) {
+		cli->bench_ctrl = 0;
+		printf("Benchmark service not found, run btgatt-server -B\n");
+		return NULL;
+	}
+
+	cli->bench = new0(struct bench, 1);
+	cli->bench->cli = cli;
+
+	return cli->bench;
+}
+
+static bool bench_ctrl(struct bench *bench, uint8_t op,
+					bt_gatt_client_callback_t callback)
+{
+	uint8_t pdu[11];
+	uint16_t len = 1;
+
+	pdu[0] = op;
+
+	if (op == BENCH_CTRL_START) {
+		put_le16(bench->len, pdu + 1);
+		put_le32(0, pdu + 3);
+		put_le16(bench->interval, pdu + 7);
+		put_le16(bench->burst, pdu + 9);
+		len = sizeof(pdu);
+	}
+
+	return bt_gatt_client_write_value(bench->cli->gatt,
+						bench->cli->bench_ctrl,
+						pdu, len, callback, bench,
+						NULL) != 0;
+}
+
+static void bench_print_rate(uint64_t pkts, uint64_t bytes, uint64_t usec)
+{
+	if (!usec)
+		usec = 1;
+
+	printf("\t%llu packets, %llu bytes in %llu.%03llu s\n",
+				(unsigned long long) pkts,
+				(unsigned long long) bytes,
+				(unsigned long long) usec / 1000000,
+				(unsigned long long) usec / 1000 % 1000);
+	printf("\t%llu packets/s, %llu kbit/s\n",
+				(unsigned long long) (pkts * 1000000 / usec),
+				(unsigned long long) (bytes * 8000 / usec));
+}
+
+static void bench_notify_usage(void)
+{
+	printf("Usage: bench-notify [options]\n"
+		"Options:\n"
+		"\t-t, --time <sec>\tDuration (default 10)\n"
+		"\t-l, --length <len>\tValue length (default ATT MTU - 3)\n"
+		"\t-i, --interval <ms>\tServer burst interval (default 1)\n"
+		"\t-b, --burst <count>\tNotifications per burst (default 8)\n"
+		"e.g.:\n"
+		"\tbench-notify -t 5 -l 244\n");
+}
+
+static struct option bench_options[] = {
+	{ "time",	1, 0, 't' },
+	{ "length",	1, 0, 'l' },
+	{ "interval",	1, 0, 'i' },
+	{ "burst",	1, 0, 'b' },
+	{ "window",	1, 0, 'w' },
+	{ "count",	1, 0, 'c' },
+	{ "parallel",	1, 0, 'p' },
+	{ }
+};
+
+static bool bench_parse_opt(struct bench *bench, int opt, const char *arg)
+{
+	char *endptr = NULL;
+	unsigned long val;
+
+	val = strtoul(arg, &endptr, 0);
+	if (!endptr || *endptr != '\0')
+		return false;
+
+	switch (opt) {
+	case 't':
+		bench->duration = val;
+		return val > 0;
+	case 'l':
+		bench->len = val;
+		return val >= 4 && val <= BT_ATT_MAX_VALUE_LEN;
+	case 'i':
+		bench->interval = val;
+		return val > 0 && val <= UINT16_MAX;
+	case 'b':
+		bench->burst = val;
+		return val > 0 && val <= UINT16_MAX;
+	case 'w':
+		bench->window = val;
+		return val > 0;
+	case 'c':
+		bench->count = val;
+		return val > 0 && val <= UINT16_MAX * 16;
+	case 'p':
+		bench->parallel = val;
+		return val <= UINT8_MAX;
+	default:
+		return false;
+	}
+}
+
+static bool bench_parse_args(struct bench *bench, const char *name,
+					const char *optstr, char *cmd_str)
+{
+	char *argvbuf[16];
+	char **argv = argvbuf;
+	int argc = 1;
+	int opt;
+
+	if (!parse_args(cmd_str, 14, argv + 1, &argc))
+		return false;
+
+	optind = 0;
+	argv[0] = (char *) name;
+	while ((opt = getopt_long(argc, argv, optstr, bench_options,
+								NULL)) != -1) {
+		if (!bench_parse_opt(bench, opt, optarg))
+			return false;
+	}
+
+	return optind == argc;
+}
+
+static bool bench_notify_done(void *user_data)
+{
+	struct bench *bench = user_data;
+
+	bench->timeout_id = 0;
+	bench_ctrl(bench, BENCH_CTRL_STOP, NULL);
+
+	printf("\nNotification throughput (%d channels, %d chrcs):\n",
+					bt_att_get_channels(bench->cli->att),
+					bench->cli->bench_chrcs);
+	bench_print_rate(bench->pkts, bench->bytes, bench->last - bench->start);
+	PRLOG("\t%llu lost\n", (unsigned long long) bench->lost);
+
+	bench_free(bench);
+
+	return false;
+}
+
+static void bench_value_cb(uint16_t value_handle, const uint8_t *value,
+					uint16_t length, void *user_data)
+{
+	struct bench *bench = user_data;
+	uint32_t seq;
+
+	bench->last = bench_now();
+	if (!bench->pkts)
+		bench->start = bench->last;
+
+	bench->pkts++;
+	bench->bytes += length;
+
+	if (length < 4)
+		return;
+
+	/* Notifications may be reordered when spread over EATT channels */
+	seq = get_le32(value);
+	if (seq >= bench->next_seq) {
+		bench->lost += seq - bench->next_seq;
+		bench->next_seq = seq + 1;
+	} else if (bench->lost)
+		bench->lost--;
+}
+
+static void bench_start_cb(bool success, uint8_t att_ecode, void *user_data)
+{
+	struct bench *bench = user_data;
+
+	if (!success) {
+		PRLOG("\nFailed to start benchmark: %s (0x%02x)\n",
+				ecode_to_string(att_ecode), att_ecode);
+		bench_free(bench);
+		return;
+	}
+
+	bench->timeout_id = timeout_add_seconds(bench->duration,
+						bench_notify_done, bench,
+						NULL);
+}
+
+static void bench_register_cb(uint16_t att_ecode, void *user_data)
+{
+	struct bench *bench = user_data;
+
+	if (att_ecode) {
+		PRLOG("\nFailed to enable notifications: 0x%02x\n",
+								att_ecode);
+		bench_free(bench);
+		return;
+	}
+
+	if (++bench->registered < bench->cli->bench_chrcs)
+		return;
+
+	if (!bench_ctrl(bench, BENCH_CTRL_START, bench_start_cb)) {
+		PRLOG("\nFailed to start benchmark\n");
+		bench_free(bench);
+	}
+}
+
+static void cmd_bench_notify(struct client *cli, char *cmd_str)
+{
+	struct bench *bench;
+	int i;
+
+	bench = bench_new(cli);
+	if (!bench)
+		return;
+
+	bench->duration = 10;
+	bench->len = bt_att_get_mtu(cli->att) - 3;
+	bench->interval = 1;
+	bench->burst = 8;
+
+	if (!bench_parse_args(bench, "bench-notify", "+t:l:i:b:", cmd_str)) {
+		bench_notify_usage();
+		bench_free(bench);
+		return;
+	}
+
+	for (i = 0; i < cli->bench_chrcs; i++) {
+		bench->notify_id[i] = bt_gatt_client_register_notify(cli->gatt,
+							cli->bench_data[i],
+							bench_register_cb,
+							bench_value_cb,
+							bench, NULL);
+		if (!bench->notify_id[i]) {
+			printf("Failed to register notify handler\n");
+			bench_free(bench);
+			return;
+		}
+	}
+
+	printf("Measuring notification throughput for %u s\n",
+							bench->duration);
+}
+
+static void bench_write_usage(void)
+{
+	printf("Usage: bench-write [options]\n"
+		"Options:\n"
+		"\t-t, --time <sec>\tDuration (default 10)\n"
+		"\t-l, --length <len>\tValue length (default ATT MTU - 3)\n"
+		"\t-w, --window <count>\tCommands queued at once "
+							"(default 32)\n"
+		"e.g.:\n"
+		"\tbench-write -t 5 -l 244\n");
+}
+
+static void bench_stats_cb(bool success, uint8_t att_ecode,
+					const uint8_t *value, uint16_t length,
+					void *user_data)
+{
+	struct bench *bench = user_data;
+	uint32_t rx_pkts, rx_bytes;
+
+	if (!success || length < 8) {
+		PRLOG("\nFailed to read benchmark statistics: %s (0x%02x)\n",
+				ecode_to_string(att_ecode), att_ecode);
+		bench_free(bench);
+		return;
+	}
+
+	rx_pkts = get_le32(value);
+	rx_bytes = get_le32(value + 4);
+
+	printf("\nWrite Without Response throughput (%d channels):\n",
+					bt_att_get_channels(bench->cli->att));
+	bench_print_rate(rx_pkts, rx_bytes, bench->last - bench->start);
+	PRLOG("\t%llu sent, %llu lost\n", (unsigned long long) bench->sent,
+			(unsigned long long) (bench->sent > rx_pkts ?
+						bench->sent - rx_pkts : 0));
+
+	bench_free(bench);
+}
+
+static bool bench_write_cb(void *user_data)
+{
+	struct bench *bench = user_data;
+	struct client *cli = bench->cli;
+	struct bt_att_chan_stats stats;
+	uint64_t inflight;
+
+	bt_att_get_stats(cli->att, &stats);
+	inflight = bench->sent - (stats.tx_pdus - bench->tx_base);
+
+	if (bench->last) {
+		/* Wait for the queued commands to leave before reading */
+		if (inflight)
+			return true;
+
+		bench->timeout_id = 0;
+
+		if (!bt_gatt_client_read_value(cli->gatt, cli->bench_stats,
+						bench_stats_cb, bench, NULL)) {
+			PRLOG("\nFailed to read benchmark statistics\n");
+			bench_free(bench);
+		}
+
+		return false;
+	}
+
+	if (bench_now() - bench->start >= bench->duration * 1000000ULL) {
+		bench->last = bench_now();
+		return true;
+	}
+
+	while (inflight < bench->window) {
+		uint16_t handle = cli->bench_data[bench->sent %
+							cli->bench_chrcs];
+
+		put_le32(bench->sent, bench->value);
+
+		if (!bt_gatt_client_write_without_response(cli->gatt, handle,
+							false, bench->value,
+							bench->len))
+			break;
+
+		bench->sent++;
+		inflight++;
+	}
+
+	return true;
+}
+
+static void bench_reset_cb(bool success, uint8_t att_ecode, void *user_data)
+{
+	struct bench *bench = user_data;
+	struct bt_att_chan_stats stats;
+
+	if (!success) {
+		PRLOG("\nFailed to reset benchmark: %s (0x%02x)\n",
+				ecode_to_string(att_ecode), att_ecode);
+		bench_free(bench);
+		return;
+	}
+
+	bt_att_get_stats(bench->cli->att, &stats);
+	bench->tx_base = stats.tx_pdus;
+	bench->start = bench_now();
+	bench->timeout_id = timeout_add(1, bench_write_cb, bench, NULL);
+}
+
+static void cmd_bench_write(struct client *cli, char *cmd_str)
+{
+	struct bench *bench;
+	unsigned int i;
+
+	bench = bench_new(cli);
+	if (!bench)
+		return;
+
+	bench->duration = 10;
+	bench->len = bt_att_get_mtu(cli->att) - 3;
+	bench->window = 32;
+
+	if (!bench_parse_args(bench, "bench-write", "+t:l:w:", cmd_str)) {
+		bench_write_usage();
+		bench_free(bench);
+		return;
+	}
+
+	bench->len = MIN(bench->len, bt_att_get_mtu(cli->att) - 3);
+
+	for (i = 0; i < sizeof(bench->value); i++)
+		bench->value[i] = i;
+
+	if (!bench_ctrl(bench, BENCH_CTRL_RESET, bench_reset_cb)) {
+		printf("Failed to reset benchmark\n");
+		bench_free(bench);
+		return;
+	}
+
+	printf("Measuring Write Without Response throughput for %u s\n",
+							bench->duration);
+}
+
+static void bench_read_usage(void)
+{
+	printf("Usage: bench-read [options]\n"
+		"Options:\n"
+		"\t-c, --count <count>\tNumber of reads (default 1000)\n"
+		"\t-p, --parallel <num>\tReads in flight, 0 for one per "
+						"ATT channel (default 1)\n"
+		"e.g.:\n"
+		"\tbench-read -c 500 -p 0\n");
+}
+
+struct bench_req {
+	struct bench *bench;
+	uint64_t start;
+};
+
+static int latency_cmp(const void *a, const void *b)
+{
+	uint32_t la = *(const uint32_t *) a;
+	uint32_t lb = *(const uint32_t *) b;
+
+	return la < lb ? -1 : la > lb;
+}
+
+static void bench_read_report(struct bench *bench)
+{
+	uint64_t sum = 0;
+	unsigned int i, n = bench->done;
+
+	qsort(bench->latency, n, sizeof(*bench->latency), latency_cmp);
+
+	for (i = 0; i < n; i++)
+		sum += bench->latency[i];
+
+	printf("\nRead latency (%d channels, %u in flight):\n",
+					bt_att_get_channels(bench->cli->att),
+					bench->parallel);
+	bench_print_rate(n, 0, bench->last - bench->start);
+	printf("\tmin %u us, avg %llu us, max %u us\n", bench->latency[0],
+					(unsigned long long) (sum / n),
+					bench->latency[n - 1]);
+	PRLOG("\tp50 %u us, p90 %u us, p99 %u us, %u failed\n",
+					bench->latency[n * 50 / 100],
+					bench->latency[n * 90 / 100],
+					bench->latency[n * 99 / 100],
+					bench->failed);
+}
+
+static bool bench_read_next(struct bench *bench);
+
+static void bench_read_cb(bool success, uint8_t att_ecode,
+					const uint8_t *value, uint16_t length,
+					void *user_data)
+{
+	struct bench_req *req = user_data;
+	struct bench *bench = req->bench;
+
+	bench->last = bench_now();
+	bench->latency[bench->done++] = bench->last - req->start;
+
+	if (!success)
+		bench->failed++;
+
+	if (bench->done == bench->count) {
+		bench_read_report(bench);
+		bench_free(bench);
+		return;
+	}
+
+	if (bench->issued < bench->count && !bench_read_next(bench) &&
+					bench->issued == bench->done) {
+		PRLOG("\nFailed to initiate read\n");
+		bench_free(bench);
+	}
+}
+
+static bool bench_read_next(struct bench *bench)
+{
+	struct client *cli = bench->cli;
+	struct bench_req *req;
+
+	req = new0(struct bench_req, 1);
+	req->bench = bench;
+	req->start = bench_now();
+
+	if (!bt_gatt_client_read_value(cli->gatt,
+				cli->bench_data[bench->issued %
+							cli->bench_chrcs],
+				bench_read_cb, req, free)) {
+		free(req);
+		return false;
+	}
+
+	bench->issued++;
+
+	return true;
+}
+
+static void cmd_bench_read(struct client *cli, char *cmd_str)
+{
+	struct bench *bench;
+
+	bench = bench_new(cli);
+	if (!bench)
+		return;
+
+	bench->count = 1000;
+	bench->parallel = 1;
+
+	if (!bench_parse_args(bench, "bench-read", "+c:p:", cmd_str)) {
+		bench_read_usage();
+		bench_free(bench);
+		return;
+	}
+
+	if (!bench->parallel)
+		bench->parallel = bt_att_get_channels(cli->att);
+
+	bench->parallel = MIN(bench->parallel, bench->count);
+	bench->latency = new0(uint32_t, bench->count);
+	bench->start = bench_now();
+
+	while (bench->issued < bench->parallel) {
+		if (!bench_read_next(bench)) {
+			printf("Failed to initiate read\n");
+			bench_free(bench);
+			return;
+		}
+	}
+
+	printf("Measuring latency of %u reads\n", bench->count);
+}
+
 static void cmd_help(struct client *cli, char *cmd_str);
 
 typedef void (*command_func_t)(struct client *cli, char *cmd_str);
@@ -1556,6 +2217,12 @@ static struct {
 				"\tSearch service"},
 	{ "search-characteristics", cmd_search_characteristics,
 				"\tSearch characteristics"},
+	{ "bench-notify", cmd_bench_notify,
+				"\tMeasure notification throughput"},
+	{ "bench-write", cmd_bench_write,
+				"\tMeasure write without response throughput"},
+	{ "bench-read", cmd_bench_read,
+				"\tMeasure read latency distribution"},
 	{ }
 };
 
@@ -1701,6 +2368,62 @@ static int l2cap_le_att_connect(bdaddr_t *src, bdaddr_t *dst, uint8_t dst_type,
 	return sock;
 }
 
+static int l2cap_le_eatt_connect(bdaddr_t *src, bdaddr_t *dst,
+						uint8_t dst_type, int sec)
+{
+	int sock;
+	struct sockaddr_l2 srcaddr, dstaddr;
+	struct bt_security btsec;
+	uint8_t mode = BT_MODE_EXT_FLOWCTL;
+
+	sock = socket(PF_BLUETOOTH, SOCK_SEQPACKET, BTPROTO_L2CAP);
+	if (sock < 0) {
+		perror("Failed to create L2CAP socket");
+		return -1;
+	}
+
+	memset(&srcaddr, 0, sizeof(srcaddr));
+	srcaddr.l2_family = AF_BLUETOOTH;
+	srcaddr.l2_bdaddr_type = 0;
+	bacpy(&srcaddr.l2_bdaddr, src);
+
+	if (bind(sock, (struct sockaddr *)&srcaddr, sizeof(srcaddr)) < 0) {
+		perror("Failed to bind L2CAP socket");
+		close(sock);
+		return -1;
+	}
+
+	memset(&btsec, 0, sizeof(btsec));
+	btsec.level = sec;
+	if (setsockopt(sock, SOL_BLUETOOTH, BT_SECURITY, &btsec,
+							sizeof(btsec)) != 0) {
+		fprintf(stderr, "Failed to set L2CAP security level\n");
+		close(sock);
+		return -1;
+	}
+
+	if (setsockopt(sock, SOL_BLUETOOTH, BT_MODE, &mode,
+							sizeof(mode)) < 0) {
+		perror("Failed to set EATT channel mode");
+		close(sock);
+		return -1;
+	}
+
+	memset(&dstaddr, 0, sizeof(dstaddr));
+	dstaddr.l2_family = AF_BLUETOOTH;
+	dstaddr.l2_psm = htobs(BT_ATT_EATT_PSM);
+	dstaddr.l2_bdaddr_type = dst_type;
+	bacpy(&dstaddr.l2_bdaddr, dst);
+
+	if (connect(sock, (struct sockaddr *) &dstaddr, sizeof(dstaddr)) < 0) {
+		perror("Failed to connect EATT channel");
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
 static void usage(void)
 {
 	printf("btgatt-client\n");
@@ -1713,6 +2436,8 @@ static void usage(void)
 		"\t-m, --mtu <mtu> \t\tThe ATT MTU to use\n"
 		"\t-s, --security-level <sec> \tSet security level (low|medium|"
 								"high|fips)\n"
+		"\t-e, --eatt <num>\t\tConnect <num> Enhanced ATT "
+								"channels\n"
 		"\t-v, --verbose\t\t\tEnable extra logging\n"
 		"\t-h, --help\t\t\tDisplay help\n");
 }
@@ -1720,6 +2445,7 @@ static void usage(void)
 static struct option main_options[] = {
 	{ "index",		1, 0, 'i' },
 	{ "dest",		1, 0, 'd' },
+	{ "eatt",		1, 0, 'e' },
 	{ "type",		1, 0, 't' },
 	{ "mtu",		1, 0, 'm' },
 	{ "security-level",	1, 0, 's' },
@@ -1737,10 +2463,11 @@ int main(int argc, char *argv[])
 	bool dst_addr_given = false;
 	bdaddr_t src_addr, dst_addr;
 	int dev_id = -1;
-	int fd;
+	int eatt = 0;
+	int fd, i;
 	struct client *cli;
 
-	while ((opt = getopt_long(argc, argv, "+hvs:m:t:d:i:",
+	while ((opt = getopt_long(argc, argv, "+hvs:m:t:d:i:e:",
 						main_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
@@ -1800,6 +2527,13 @@ int main(int argc, char *argv[])
 
 			dst_addr_given = true;
 			break;
+		case 'e':
+			eatt = atoi(optarg);
+			if (eatt <= 0 || eatt > 5) {
+				fprintf(stderr, "EATT channels must be 1-5\n");
+				return EXIT_FAILURE;
+			}
+			break;
 
 		case 'i':
 			dev_id = hci_devid(optarg);
@@ -1853,6 +2587,21 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	for (i = 0; i < eatt; i++) {
+		fd = l2cap_le_eatt_connect(&src_addr, &dst_addr, dst_type, sec);
+		if (fd < 0)
+			break;
+
+		if (bt_att_attach_fd(cli->att, fd) < 0) {
+			fprintf(stderr, "Failed to attach EATT channel\n");
+			close(fd);
+			break;
+		}
+	}
+
+	if (eatt)
+		printf("Connected %d EATT channels\n", i);
+
 	if (mainloop_add_fd(fileno(stdin),
 				EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR,
 				prompt_read_cb, cli, NULL) < 0) {
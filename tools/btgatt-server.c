@@ -42,6 +42,18 @@
 #define UUID_HEART_RATE_BODY		0x2a38
 #define UUID_HEART_RATE_CTRL		0x2a39
 
+#define UUID_BENCH		"a3c87500-8ed3-4bdf-8a39-a01bebede295"
+#define UUID_BENCH_DATA		"a3c87501-8ed3-4bdf-8a39-a01bebede295"
+#define UUID_BENCH_CTRL		"a3c87502-8ed3-4bdf-8a39-a01bebede295"
+#define UUID_BENCH_STATS	"a3c87503-8ed3-4bdf-8a39-a01bebede295"
+
+#define BENCH_CTRL_STOP		0x00
+#define BENCH_CTRL_START	0x01
+#define BENCH_CTRL_RESET	0x02
+
+#define BENCH_MAX_CHRCS		8
+#define BENCH_DEFAULT_LEN	20
+
 #define ATT_CID 4
 
 #define PRLOG(...) \
@@ -86,6 +98,25 @@ struct server {
 	bool hr_msrmt_enabled;
 	int hr_ee_count;
 	unsigned int hr_timeout_id;
+
+	int eatt_fd;
+
+	struct bench_chrc {
+		struct server *server;
+		uint16_t handle;
+		bool enabled;
+	} bench_chrc[BENCH_MAX_CHRCS];
+	int bench_chrcs;
+	int bench_next;
+	uint8_t bench_value[BT_ATT_MAX_VALUE_LEN];
+	uint16_t bench_len;
+	uint32_t bench_count;
+	uint16_t bench_burst;
+	unsigned int bench_timeout_id;
+	uint32_t bench_rx_pkts;
+	uint32_t bench_rx_bytes;
+	uint32_t bench_tx_pkts;
+	uint32_t bench_tx_bytes;
 };
 
 static void print_prompt(void)
@@ -527,14 +558,299 @@ static void populate_hr_service(struct server *server)
 		gatt_db_service_set_active(service, true);
 }
 
+static void bench_data_read_cb(struct gatt_db_attribute *attrib,
+					unsigned int id, uint16_t offset,
+					uint8_t opcode, struct bt_att *att,
+					void *user_data)
+{
+	struct bench_chrc *chrc = user_data;
+	struct server *server = chrc->server;
+
+	if (offset > server->bench_len) {
+		gatt_db_attribute_read_result(attrib, id,
+						BT_ATT_ERROR_INVALID_OFFSET,
+						NULL, 0);
+		return;
+	}
+
+	gatt_db_attribute_read_result(attrib, id, 0,
+					server->bench_value + offset,
+					server->bench_len - offset);
+}
+
+static void bench_data_write_cb(struct gatt_db_attribute *attrib,
+					unsigned int id, uint16_t offset,
+					const uint8_t *value, size_t len,
+					uint8_t opcode, struct bt_att *att,
+					void *user_data)
+{
+	struct bench_chrc *chrc = user_data;
+	struct server *server = chrc->server;
+
+	server->bench_rx_pkts++;
+	server->bench_rx_bytes += len;
+
+	gatt_db_attribute_write_result(attrib, id, 0);
+}
+
+static void bench_ccc_read_cb(struct gatt_db_attribute *attrib,
+					unsigned int id, uint16_t offset,
+					uint8_t opcode, struct bt_att *att,
+					void *user_data)
+{
+	struct bench_chrc *chrc = user_data;
+	uint8_t value[2];
+
+	value[0] = chrc->enabled ? 0x01 : 0x00;
+	value[1] = 0x00;
+
+	gatt_db_attribute_read_result(attrib, id, 0, value, 2);
+}
+
+static void bench_ccc_write_cb(struct gatt_db_attribute *attrib,
+					unsigned int id, uint16_t offset,
+					const uint8_t *value, size_t len,
+					uint8_t opcode, struct bt_att *att,
+					void *user_data)
+{
+	struct bench_chrc *chrc = user_data;
+	uint8_t ecode = 0;
+
+	if (!value || len != 2) {
+		ecode = BT_ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LEN;
+		goto done;
+	}
+
+	if (offset) {
+		ecode = BT_ATT_ERROR_INVALID_OFFSET;
+		goto done;
+	}
+
+	if (value[0] > 0x01) {
+		ecode = 0x80;
+		goto done;
+	}
+
+	chrc->enabled = value[0] == 0x01;
+
+done:
+	gatt_db_attribute_write_result(attrib, id, ecode);
+}
+
+static bool bench_notify_cb(void *user_data)
+{
+	struct server *server = user_data;
+	uint16_t mtu = bt_att_get_mtu(server->att);
+	uint16_t len = MIN(server->bench_len, mtu - 3);
+	int i, j;
+
+	for (i = 0; i < server->bench_burst; i++) {
+		struct bench_chrc *chrc = NULL;
+
+		/* Round robin over the characteristics with CCC enabled */
+		for (j = 0; j < server->bench_chrcs; j++) {
+			chrc = &server->bench_chrc[server->bench_next++ %
+							server->bench_chrcs];
+			if (chrc->enabled)
+				break;
+
+			chrc = NULL;
+		}
+
+		if (!chrc)
+			break;
+
+		/* Tag each PDU so the client can detect losses */
+		put_le32(server->bench_tx_pkts, server->bench_value);
+
+		if (!bt_gatt_server_send_notification(server->gatt,
+							chrc->handle,
+							server->bench_value,
+							len, false))
+			break;
+
+		server->bench_tx_pkts++;
+		server->bench_tx_bytes += len;
+
+		if (server->bench_count && !--server->bench_count) {
+			PRLOG("Benchmark: notifications completed\n");
+			server->bench_timeout_id = 0;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void bench_stop(struct server *server)
+{
+	timeout_remove(server->bench_timeout_id);
+	server->bench_timeout_id = 0;
+}
+
+static void bench_ctrl_write_cb(struct gatt_db_attribute *attrib,
+					unsigned int id, uint16_t offset,
+					const uint8_t *value, size_t len,
+					uint8_t opcode, struct bt_att *att,
+					void *user_data)
+{
+	struct server *server = user_data;
+	uint16_t interval;
+	uint8_t ecode = 0;
+
+	if (!value || !len) {
+		ecode = BT_ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LEN;
+		goto done;
+	}
+
+	if (offset) {
+		ecode = BT_ATT_ERROR_INVALID_OFFSET;
+		goto done;
+	}
+
+	switch (value[0]) {
+	case BENCH_CTRL_STOP:
+		bench_stop(server);
+		PRLOG("Benchmark: stopped after %u notifications\n",
+							server->bench_tx_pkts);
+		break;
+	case BENCH_CTRL_START:
+		/* len (2), count (4), interval in ms (2), burst (2) */
+		if (len != 11) {
+			ecode = BT_ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LEN;
+			goto done;
+		}
+
+		server->bench_len = get_le16(value + 1);
+		server->bench_count = get_le32(value + 3);
+		interval = get_le16(value + 7);
+		server->bench_burst = get_le16(value + 9);
+
+		if (server->bench_len < 4 ||
+				server->bench_len > BT_ATT_MAX_VALUE_LEN ||
+				!interval || !server->bench_burst) {
+			ecode = BT_ERROR_OUT_OF_RANGE;
+			goto done;
+		}
+
+		bench_stop(server);
+		server->bench_timeout_id = timeout_add(interval,
+							bench_notify_cb,
+							server, NULL);
+
+		PRLOG("Benchmark: %u x %u bytes every %u ms\n",
+				server->bench_burst, server->bench_len,
+				interval);
+		break;
+	case BENCH_CTRL_RESET:
+		server->bench_rx_pkts = 0;
+		server->bench_rx_bytes = 0;
+		server->bench_tx_pkts = 0;
+		server->bench_tx_bytes = 0;
+		break;
+	default:
+		ecode = BT_ATT_ERROR_REQUEST_NOT_SUPPORTED;
+		break;
+	}
+
+done:
+	gatt_db_attribute_write_result(attrib, id, ecode);
+}
+
+static void bench_stats_read_cb(struct gatt_db_attribute *attrib,
+					unsigned int id, uint16_t offset,
+					uint8_t opcode, struct bt_att *att,
+					void *user_data)
+{
+	struct server *server = user_data;
+	uint8_t value[16];
+
+	put_le32(server->bench_rx_pkts, value);
+	put_le32(server->bench_rx_bytes, value + 4);
+	put_le32(server->bench_tx_pkts, value + 8);
+	put_le32(server->bench_tx_bytes, value + 12);
+
+	if (offset > sizeof(value)) {
+		gatt_db_attribute_read_result(attrib, id,
+						BT_ATT_ERROR_INVALID_OFFSET,
+						NULL, 0);
+		return;
+	}
+
+	gatt_db_attribute_read_result(attrib, id, 0, value + offset,
+						sizeof(value) - offset);
+}
+
+static void populate_bench_service(struct server *server)
+{
+	bt_uuid_t uuid;
+	struct gatt_db_attribute *service, *attr;
+	unsigned int i;
+	int num_handles = 1 + 2 + 2 + server->bench_chrcs * 3;
+
+	for (i = 0; i < sizeof(server->bench_value); i++)
+		server->bench_value[i] = i;
+
+	server->bench_len = BENCH_DEFAULT_LEN;
+
+	bt_string_to_uuid(&uuid, UUID_BENCH);
+	service = gatt_db_add_service(server->db, &uuid, true, num_handles);
+
+	/* Control Point Characteristic */
+	bt_string_to_uuid(&uuid, UUID_BENCH_CTRL);
+	gatt_db_service_add_characteristic(service, &uuid,
+						BT_ATT_PERM_WRITE,
+						BT_GATT_CHRC_PROP_WRITE,
+						NULL, bench_ctrl_write_cb,
+						server);
+
+	/* Statistics Characteristic */
+	bt_string_to_uuid(&uuid, UUID_BENCH_STATS);
+	gatt_db_service_add_characteristic(service, &uuid,
+						BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ,
+						bench_stats_read_cb, NULL,
+						server);
+
+	/* Data Characteristics */
+	for (i = 0; i < (unsigned int) server->bench_chrcs; i++) {
+		struct bench_chrc *chrc = &server->bench_chrc[i];
+
+		chrc->server = server;
+
+		bt_string_to_uuid(&uuid, UUID_BENCH_DATA);
+		attr = gatt_db_service_add_characteristic(service, &uuid,
+					BT_ATT_PERM_READ | BT_ATT_PERM_WRITE,
+					BT_GATT_CHRC_PROP_READ |
+					BT_GATT_CHRC_PROP_WRITE_WITHOUT_RESP |
+					BT_GATT_CHRC_PROP_WRITE |
+					BT_GATT_CHRC_PROP_NOTIFY,
+					bench_data_read_cb,
+					bench_data_write_cb, chrc);
+		chrc->handle = gatt_db_attribute_get_handle(attr);
+
+		bt_uuid16_create(&uuid, GATT_CLIENT_CHARAC_CFG_UUID);
+		gatt_db_service_add_descriptor(service, &uuid,
+					BT_ATT_PERM_READ | BT_ATT_PERM_WRITE,
+					bench_ccc_read_cb,
+					bench_ccc_write_cb, chrc);
+	}
+
+	gatt_db_service_set_active(service, true);
+}
+
 static void populate_db(struct server *server)
 {
 	populate_gap_service(server);
 	populate_gatt_service(server);
 	populate_hr_service(server);
+
+	if (server->bench_chrcs)
+		populate_bench_service(server);
 }
 
-static struct server *server_create(int fd, uint16_t mtu, bool hr_visible)
+static struct server *server_create(int fd, uint16_t mtu, bool hr_visible,
+							int bench_chrcs)
 {
 	struct server *server;
 	size_t name_len = strlen(test_device_name);
@@ -586,6 +902,8 @@ static struct server *server_create(int fd, uint16_t mtu, bool hr_visible)
 	}
 
 	server->hr_visible = hr_visible;
+	server->bench_chrcs = bench_chrcs;
+	server->eatt_fd = -1;
 
 	if (verbose) {
 		bt_att_set_debug(server->att, BT_ATT_DEBUG_VERBOSE,
@@ -614,6 +932,13 @@ fail:
 static void server_destroy(struct server *server)
 {
 	timeout_remove(server->hr_timeout_id);
+	timeout_remove(server->bench_timeout_id);
+
+	if (server->eatt_fd >= 0) {
+		mainloop_remove_fd(server->eatt_fd);
+		close(server->eatt_fd);
+	}
+
 	bt_gatt_server_unref(server->gatt);
 	gatt_db_unref(server->db);
 }
@@ -631,6 +956,9 @@ static void usage(void)
 		"\t-t, --type [random|public] \t The source address type\n"
 		"\t-v, --verbose\t\t\tEnable extra logging\n"
 		"\t-r, --heart-rate\t\tEnable Heart Rate service\n"
+		"\t-B, --benchmark <chrcs>\t\tEnable benchmark service with "
+						"<chrcs> data characteristics\n"
+		"\t-e, --eatt\t\t\tAccept Enhanced ATT channels\n"
 		"\t-h, --help\t\t\tDisplay help\n");
 }
 
@@ -641,6 +969,8 @@ static struct option main_options[] = {
 	{ "type",		1, 0, 't' },
 	{ "verbose",		0, 0, 'v' },
 	{ "heart-rate",		0, 0, 'r' },
+	{ "benchmark",		1, 0, 'B' },
+	{ "eatt",		0, 0, 'e' },
 	{ "help",		0, 0, 'h' },
 	{ }
 };
@@ -707,6 +1037,80 @@ fail:
 	return -1;
 }
 
+static int l2cap_le_eatt_listen(bdaddr_t *src, int sec, uint8_t src_type)
+{
+	int sk;
+	struct sockaddr_l2 srcaddr;
+	struct bt_security btsec;
+	uint8_t mode = BT_MODE_EXT_FLOWCTL;
+
+	sk = socket(PF_BLUETOOTH, SOCK_SEQPACKET | SOCK_NONBLOCK,
+								BTPROTO_L2CAP);
+	if (sk < 0) {
+		perror("Failed to create L2CAP socket");
+		return -1;
+	}
+
+	memset(&srcaddr, 0, sizeof(srcaddr));
+	srcaddr.l2_family = AF_BLUETOOTH;
+	srcaddr.l2_psm = htobs(BT_ATT_EATT_PSM);
+	srcaddr.l2_bdaddr_type = src_type;
+	bacpy(&srcaddr.l2_bdaddr, src);
+
+	if (bind(sk, (struct sockaddr *) &srcaddr, sizeof(srcaddr)) < 0) {
+		perror("Failed to bind EATT socket");
+		goto fail;
+	}
+
+	memset(&btsec, 0, sizeof(btsec));
+	btsec.level = sec;
+	if (setsockopt(sk, SOL_BLUETOOTH, BT_SECURITY, &btsec,
+							sizeof(btsec)) != 0) {
+		fprintf(stderr, "Failed to set L2CAP security level\n");
+		goto fail;
+	}
+
+	if (setsockopt(sk, SOL_BLUETOOTH, BT_MODE, &mode, sizeof(mode)) < 0) {
+		perror("Failed to set EATT channel mode");
+		goto fail;
+	}
+
+	if (listen(sk, 10) < 0) {
+		perror("Listening on EATT socket failed");
+		goto fail;
+	}
+
+	return sk;
+
+fail:
+	close(sk);
+	return -1;
+}
+
+static void eatt_accept_cb(int fd, uint32_t events, void *user_data)
+{
+	struct server *server = user_data;
+	int nsk;
+
+	if (events & (EPOLLHUP | EPOLLERR)) {
+		mainloop_remove_fd(fd);
+		return;
+	}
+
+	nsk = accept(fd, NULL, NULL);
+	if (nsk < 0)
+		return;
+
+	if (bt_att_attach_fd(server->att, nsk) < 0) {
+		close(nsk);
+		PRLOG("Failed to attach EATT channel\n");
+		return;
+	}
+
+	PRLOG("EATT channel connected (%d channels)\n",
+					bt_att_get_channels(server->att));
+}
+
 static void notify_usage(void)
 {
 	printf("Usage: notify [options] <value_handle> <value>\n"
@@ -1140,9 +1544,12 @@ int main(int argc, char *argv[])
 	uint8_t src_type = BDADDR_LE_PUBLIC;
 	uint16_t mtu = 0;
 	bool hr_visible = false;
+	int bench_chrcs = 0;
+	bool eatt = false;
+	int eatt_fd = -1;
 	struct server *server;
 
-	while ((opt = getopt_long(argc, argv, "+hvrs:t:m:i:",
+	while ((opt = getopt_long(argc, argv, "+hvreB:s:t:m:i:",
 						main_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
@@ -1154,6 +1561,17 @@ int main(int argc, char *argv[])
 		case 'r':
 			hr_visible = true;
 			break;
+		case 'B':
+			bench_chrcs = atoi(optarg);
+			if (bench_chrcs <= 0 || bench_chrcs > BENCH_MAX_CHRCS) {
+				fprintf(stderr, "Benchmark characteristics "
+					"must be 1-%d\n", BENCH_MAX_CHRCS);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'e':
+			eatt = true;
+			break;
 		case 's':
 			if (strcmp(optarg, "low") == 0)
 				sec = BT_SECURITY_LOW;
@@ -1224,20 +1642,43 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	/* Listen for EATT before the peer can request additional channels */
+	if (eatt) {
+		eatt_fd = l2cap_le_eatt_listen(&src_addr, sec, src_type);
+		if (eatt_fd < 0)
+			return EXIT_FAILURE;
+	}
+
 	fd = l2cap_le_att_listen_and_accept(&src_addr, sec, src_type);
 	if (fd < 0) {
 		fprintf(stderr, "Failed to accept L2CAP ATT connection\n");
+		if (eatt_fd >= 0)
+			close(eatt_fd);
 		return EXIT_FAILURE;
 	}
 
 	mainloop_init();
 
-	server = server_create(fd, mtu, hr_visible);
+	server = server_create(fd, mtu, hr_visible, bench_chrcs);
 	if (!server) {
 		close(fd);
+		if (eatt_fd >= 0)
+			close(eatt_fd);
 		return EXIT_FAILURE;
 	}
 
+	if (eatt_fd >= 0) {
+		if (mainloop_add_fd(eatt_fd, EPOLLIN | EPOLLHUP | EPOLLERR,
+					eatt_accept_cb, server, NULL) < 0) {
+			fprintf(stderr, "Failed to listen for EATT channels\n");
+			close(eatt_fd);
+			server_destroy(server);
+			return EXIT_FAILURE;
+		}
+
+		server->eatt_fd = eatt_fd;
+	}
+
 	if (mainloop_add_fd(fileno(stdin),
 				EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR,
 				prompt_read_cb, server, NULL) < 0) {
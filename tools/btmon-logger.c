@@ -35,9 +35,13 @@
 #include "src/shared/util.h"
 #include "src/shared/mainloop.h"
 #include "src/shared/btsnoop.h"
+#include "src/shared/monitor-filter.h"
 
 #define MONITOR_INDEX_NONE 0xffff
 
+#define COMPRESS_CHUNK_SIZE	(256 * 1024)
+#define COMPRESS_FLUSH_TIMEOUT	5000
+
 struct monitor_hdr {
 	uint16_t opcode;
 	uint16_t index;
@@ -45,6 +49,16 @@ struct monitor_hdr {
 } __attribute__ ((packed));
 
 static struct btsnoop *btsnoop_file = NULL;
+static uint16_t filter_index = MONITOR_INDEX_NONE;
+static uint32_t filter_opcodes = MONITOR_FILTER_ALL;
+static uint16_t filter_snaplen;
+
+static void flush_callback(int id, void *user_data)
+{
+	btsnoop_flush(btsnoop_file);
+
+	mainloop_modify_timeout(id, COMPRESS_FLUSH_TIMEOUT);
+}
 
 static void data_callback(int fd, uint32_t events, void *user_data)
 {
@@ -99,6 +113,14 @@ static void data_callback(int fd, uint32_t events, void *user_data)
 		index  = le16_to_cpu(hdr.index);
 		pktlen = le16_to_cpu(hdr.len);
 
+		/*
+		 * Data frames truncated by the socket filter keep their
+		 * original length, the btsnoop snaplen matches the filter.
+		 */
+		if (pktlen > len - sizeof(hdr) && (!filter_snaplen ||
+				len - sizeof(hdr) < filter_snaplen))
+			pktlen = len - sizeof(hdr);
+
 		btsnoop_write_hci(btsnoop_file, tv, index, opcode, 0, buf,
 									pktlen);
 	}
@@ -138,6 +160,13 @@ static bool open_monitor_channel(void)
 		return false;
 	}
 
+	if (!monitor_filter_attach(fd, filter_index, filter_opcodes,
+							filter_snaplen)) {
+		perror("Failed to attach socket filter");
+		close(fd);
+		return false;
+	}
+
 	mainloop_add_fd(fd, EPOLLIN, data_callback, NULL, NULL);
 
 	return true;
@@ -196,6 +225,10 @@ static void usage(void)
 		"\t-p, --parents          Create basename parent directories\n"
 		"\t-l, --limit <limit>    Limit traces file size (rotate)\n"
 		"\t-c, --count <count>    Limit number of rotated files\n"
+		"\t-z, --compress         Save traces zstd compressed\n"
+		"\t-i, --index <num>      Save only specified controller\n"
+		"\t-t, --type <list>      Save only cmd,evt,acl,sco,iso\n"
+		"\t-s, --snaplen <len>    Truncate data packets to len bytes\n"
 		"\t-v, --version          Show version\n"
 		"\t-h, --help             Show help options\n");
 }
@@ -205,6 +238,10 @@ static const struct option main_options[] = {
 	{ "parents",	no_argument,		NULL, 'p' },
 	{ "limit",	required_argument,	NULL, 'l' },
 	{ "count",	required_argument,	NULL, 'c' },
+	{ "compress",	no_argument,		NULL, 'z' },
+	{ "index",	required_argument,	NULL, 'i' },
+	{ "type",	required_argument,	NULL, 't' },
+	{ "snaplen",	required_argument,	NULL, 's' },
 	{ "version",	no_argument,		NULL, 'v' },
 	{ "help",	no_argument,		NULL, 'h' },
 	{ }
@@ -263,6 +300,9 @@ int main(int argc, char *argv[])
 	unsigned long max_count = 0;
 	size_t size_limit = 0;
 	bool parents = false;
+	bool compress = false;
+	unsigned long val;
+	const char *str;
 	int exit_status;
 	char *endptr;
 
@@ -273,7 +313,7 @@ int main(int argc, char *argv[])
 	while (true) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "b:l:c:vhp", main_options,
+		opt = getopt_long(argc, argv, "b:l:c:zi:t:s:vhp", main_options,
 									NULL);
 		if (opt < 0)
 			break;
@@ -314,6 +354,41 @@ int main(int argc, char *argv[])
 		case 'c':
 			max_count = strtoul(optarg, &endptr, 10);
 			break;
+		case 'z':
+			compress = true;
+			break;
+		case 'i':
+			if (!strncmp(optarg, "hci", 3))
+				str = optarg + 3;
+			else
+				str = optarg;
+
+			val = strtoul(str, &endptr, 10);
+			if (!*str || *endptr != '\0' ||
+					val >= MONITOR_INDEX_NONE) {
+				fprintf(stderr, "Invalid index\n");
+				return EXIT_FAILURE;
+			}
+
+			filter_index = val;
+			break;
+		case 't':
+			if (!monitor_filter_parse_types(optarg,
+							&filter_opcodes)) {
+				fprintf(stderr, "Invalid packet type\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 's':
+			val = strtoul(optarg, &endptr, 10);
+			if (*endptr != '\0' || !val ||
+					val > BTSNOOP_MAX_PACKET_SIZE) {
+				fprintf(stderr, "Invalid snaplen\n");
+				return EXIT_FAILURE;
+			}
+
+			filter_snaplen = val;
+			break;
 		case 'p':
 			if (getppid() != 1) {
 				fprintf(stderr, "Parents option allowed only "
@@ -345,11 +420,27 @@ int main(int argc, char *argv[])
 	if (parents && create_dir(path) < 0)
 		return EXIT_FAILURE;
 
-	btsnoop_file = btsnoop_create(path, size_limit, max_count,
+	if (compress) {
+		btsnoop_file = btsnoop_create_zstd(path, size_limit, max_count,
+						BTSNOOP_FORMAT_MONITOR,
+						COMPRESS_CHUNK_SIZE);
+		if (!btsnoop_file) {
+			fprintf(stderr, "Compressed traces not supported\n");
+			return EXIT_FAILURE;
+		}
+
+		/* Bound the amount of trace lost on a crash */
+		mainloop_add_timeout(COMPRESS_FLUSH_TIMEOUT, flush_callback,
+								NULL, NULL);
+	} else
+		btsnoop_file = btsnoop_create(path, size_limit, max_count,
 							BTSNOOP_FORMAT_MONITOR);
+
 	if (!btsnoop_file)
 		return EXIT_FAILURE;
 
+	btsnoop_set_snaplen(btsnoop_file, filter_snaplen);
+
 	drop_capabilities();
 
 	printf("Bluetooth monitor logger ver %s\n", VERSION);
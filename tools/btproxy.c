@@ -27,6 +27,7 @@
 #include <termios.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 #include <netdb.h>
@@ -50,11 +51,14 @@ struct sockaddr_hci {
 #define HCI_INDEX_NONE		0xffff
 #define HCI_INDEX_MAX		16
 
+#define BATCH_MAX		16
+
 static uint64_t hci_index = HCI_INDEX_NONE;
 static bool client_active = false;
 static bool debug_enabled = false;
 static bool emulate_ecc = false;
 static bool skip_first_zero = false;
+static bool batch_enabled = false;
 
 static void hexdump_print(const char *str, void *user_data)
 {
@@ -68,12 +72,14 @@ struct proxy {
 	uint16_t host_len;
 	bool host_shutdown;
 	bool host_skip_first_zero;
+	bool host_stream;
 
 	/* Receive events, ACL, SCO and ISO data */
 	int dev_fd;
 	uint8_t dev_buf[4096];
 	uint16_t dev_len;
 	bool dev_shutdown;
+	bool dev_stream;
 
 	/* ECC emulation */
 	uint8_t event_mask[8];
@@ -104,6 +110,83 @@ static bool write_packet(int fd, const void *data, size_t size,
 	return true;
 }
 
+static bool write_packets(int fd, struct iovec *iov, int iovcnt,
+							void *user_data)
+{
+	int i;
+
+	if (debug_enabled)
+		for (i = 0; i < iovcnt; i++)
+			util_hexdump('<', iov[i].iov_base, iov[i].iov_len,
+						hexdump_print, user_data);
+
+	while (iovcnt > 0) {
+		ssize_t written;
+
+		written = writev(fd, iov, iovcnt);
+		if (written < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return false;
+		}
+
+		/* Skip over what has been written so far */
+		while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base += written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Reads from the user channel and /dev/vhci always return complete packets,
+ * so unless they need to be modified they are forwarded as is. With batching
+ * enabled all pending packets go out with a single write to a stream socket.
+ */
+static bool forward_packets(int src_fd, const char *src_prefix, int dst_fd,
+				const char *dst_prefix, bool batch)
+{
+	static uint8_t pkts[BATCH_MAX][4096];
+	struct iovec iov[BATCH_MAX];
+	int i, cnt = 0;
+
+	for (i = 0; i < (batch ? BATCH_MAX : 1); i++) {
+		ssize_t len;
+
+		len = read(src_fd, pkts[i], sizeof(pkts[i]));
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				break;
+			return false;
+		}
+
+		if (len == 0)
+			break;
+
+		if (debug_enabled)
+			util_hexdump('>', pkts[i], len, hexdump_print,
+							(void *) src_prefix);
+
+		/* Notification packet from /dev/vhci - ignore */
+		if (pkts[i][0] == 0xff)
+			continue;
+
+		iov[cnt].iov_base = pkts[i];
+		iov[cnt].iov_len = len;
+		cnt++;
+	}
+
+	return write_packets(dst_fd, iov, cnt, (void *) dst_prefix);
+}
+
 static void host_write_packet(struct proxy *proxy, void *buf, uint16_t len)
 {
 	if (!write_packet(proxy->dev_fd, buf, len, "D: ")) {
@@ -301,6 +384,17 @@ static void host_read_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
+	if (!proxy->host_stream && !proxy->host_skip_first_zero &&
+							!emulate_ecc) {
+		if (!forward_packets(proxy->host_fd, "H: ", proxy->dev_fd,
+						"D: ", proxy->dev_stream &&
+						batch_enabled)) {
+			fprintf(stderr, "Forwarding host packets failed\n");
+			mainloop_remove_fd(proxy->host_fd);
+		}
+		return;
+	}
+
 	len = read(proxy->host_fd, proxy->host_buf + proxy->host_len,
 				sizeof(proxy->host_buf) - proxy->host_len);
 	if (len < 0) {
@@ -431,6 +525,16 @@ static void dev_read_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
+	if (!proxy->dev_stream && !emulate_ecc) {
+		if (!forward_packets(proxy->dev_fd, "D: ", proxy->host_fd,
+						"H: ", proxy->host_stream &&
+						batch_enabled)) {
+			fprintf(stderr, "Forwarding device packets failed\n");
+			mainloop_remove_fd(proxy->dev_fd);
+		}
+		return;
+	}
+
 	len = read(proxy->dev_fd, proxy->dev_buf + proxy->dev_len,
 				sizeof(proxy->dev_buf) - proxy->dev_len);
 	if (len < 0) {
@@ -506,6 +610,28 @@ process_packet:
 	proxy->dev_len = 0;
 }
 
+static bool is_stream(int fd)
+{
+	socklen_t len;
+	int type;
+
+	len = sizeof(type);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0)
+		return false;
+
+	return type == SOCK_STREAM;
+}
+
+static void set_nonblock(int fd)
+{
+	int flags;
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags >= 0)
+		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
 static bool setup_proxy(int host_fd, bool host_shutdown,
 						int dev_fd, bool dev_shutdown)
 {
@@ -525,6 +651,18 @@ static bool setup_proxy(int host_fd, bool host_shutdown,
 	proxy->dev_fd = dev_fd;
 	proxy->dev_shutdown = dev_shutdown;
 
+	proxy->host_stream = is_stream(host_fd);
+	proxy->dev_stream = is_stream(dev_fd);
+
+	/* Batching drains packets until the descriptor would block */
+	if (batch_enabled) {
+		if (!proxy->host_stream && proxy->dev_stream)
+			set_nonblock(host_fd);
+
+		if (!proxy->dev_stream && proxy->host_stream)
+			set_nonblock(dev_fd);
+	}
+
 	mainloop_add_fd(proxy->host_fd, EPOLLIN | EPOLLRDHUP,
 				host_read_callback, proxy, host_read_destroy);
 
@@ -768,6 +906,7 @@ static void usage(void)
 		"\t-i, --index <num>           Use specified controller\n"
 		"\t-a, --amp                   Create AMP controller\n"
 		"\t-e, --ecc                   Emulate ECC support\n"
+		"\t-b, --batch                 Batch packets to TCP/Unix\n"
 		"\t-d, --debug                 Enable debugging output\n"
 		"\t-h, --help                  Show help options\n");
 }
@@ -781,6 +920,7 @@ static const struct option main_options[] = {
 	{ "index",    required_argument, NULL, 'i' },
 	{ "amp",      no_argument,       NULL, 'a' },
 	{ "ecc",      no_argument,       NULL, 'e' },
+	{ "batch",    no_argument,       NULL, 'b' },
 	{ "debug",    no_argument,       NULL, 'd' },
 	{ "version",  no_argument,       NULL, 'v' },
 	{ "help",     no_argument,       NULL, 'h' },
@@ -801,7 +941,7 @@ int main(int argc, char *argv[])
 		int opt;
 		int index;
 
-		opt = getopt_long(argc, argv, "rc:l::u::p:i:aezdvh",
+		opt = getopt_long(argc, argv, "rc:l::u::p:i:aebzdvh",
 						main_options, NULL);
 		if (opt < 0)
 			break;
@@ -858,6 +998,9 @@ int main(int argc, char *argv[])
 		case 'e':
 			emulate_ecc = true;
 			break;
+		case 'b':
+			batch_enabled = true;
+			break;
 		case 'z':
 			skip_first_zero = true;
 			break;
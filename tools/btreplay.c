@@ -0,0 +1,854 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+
+#include <dbus/dbus.h>
+
+#include "src/shared/util.h"
+#include "src/shared/mainloop.h"
+#include "src/shared/btsnoop.h"
+#include "monitor/bt.h"
+
+#define HCI_PRIMARY	0x00
+
+#define H4_CMD_PKT	0x01
+#define H4_ACL_PKT	0x02
+#define H4_SCO_PKT	0x03
+#define H4_EVT_PKT	0x04
+#define H4_ISO_PKT	0x05
+#define H4_VENDOR_PKT	0xff
+
+#define DEFAULT_IDLE_TIMEOUT	2000
+
+struct record {
+	struct timeval tv;
+	uint8_t type;
+	uint16_t size;
+	uint8_t *data;
+	unsigned int gate;
+};
+
+/* Recorded reply to a command, matched to the host by opcode */
+struct response {
+	uint16_t opcode;
+	struct record *evt;
+	bool used;
+};
+
+static struct record *traffic;
+static size_t traffic_count;
+static size_t traffic_pos;
+
+static struct response *responses;
+static size_t response_count;
+static size_t response_next;
+
+static int vhci_fd = -1;
+static int idle_id = -1;
+static int timing_id = -1;
+static bool timing_done = false;
+static unsigned int idle_timeout = DEFAULT_IDLE_TIMEOUT;
+static bool use_timing = false;
+static bool debug_enabled = false;
+
+static unsigned int host_cmds;
+static unsigned int cmd_gate;
+static unsigned int unmatched_cmds;
+static unsigned int host_data;
+static unsigned int sent_events;
+static unsigned int sent_data;
+
+static struct timeval last_sent;
+static uint64_t latency_sum;
+static uint64_t latency_max;
+static unsigned int latency_count;
+
+static pid_t daemon_pid;
+static uint64_t cpu_start[2];
+static struct timeval start_tv;
+
+static DBusConnection *dbus_conn;
+static char *bluez_owner;
+static uint64_t dbus_signals;
+
+static uint64_t tv_diff_usec(const struct timeval *a, const struct timeval *b)
+{
+	struct timeval res;
+
+	timersub(a, b, &res);
+
+	if (res.tv_sec < 0)
+		return 0;
+
+	return res.tv_sec * 1000000ULL + res.tv_usec;
+}
+
+static bool read_cpu_time(pid_t pid, uint64_t ticks[2])
+{
+	char path[64], buf[1024], *ptr;
+	unsigned long utime, stime;
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (len <= 0)
+		return false;
+
+	buf[len] = '\0';
+
+	/* The command name may contain spaces, skip past it */
+	ptr = strrchr(buf, ')');
+	if (!ptr)
+		return false;
+
+	if (sscanf(ptr + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+					"%lu %lu", &utime, &stime) != 2)
+		return false;
+
+	ticks[0] = utime;
+	ticks[1] = stime;
+
+	return true;
+}
+
+static pid_t find_daemon(void)
+{
+	struct dirent *entry;
+	pid_t pid = 0;
+	DIR *dir;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return 0;
+
+	while (!pid && (entry = readdir(dir))) {
+		char path[PATH_MAX], comm[32];
+		ssize_t len;
+		int fd;
+
+		if (!isdigit(entry->d_name[0]))
+			continue;
+
+		snprintf(path, sizeof(path), "/proc/%s/comm", entry->d_name);
+
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		len = read(fd, comm, sizeof(comm) - 1);
+		close(fd);
+
+		if (len <= 0)
+			continue;
+
+		comm[len] = '\0';
+
+		if (!strcmp(comm, "bluetoothd\n"))
+			pid = atoi(entry->d_name);
+	}
+
+	closedir(dir);
+
+	return pid;
+}
+
+static void dbus_callback(int fd, uint32_t events, void *user_data)
+{
+	DBusMessage *msg;
+
+	if (events & (EPOLLERR | EPOLLHUP)) {
+		mainloop_remove_fd(fd);
+		return;
+	}
+
+	dbus_connection_read_write(dbus_conn, 0);
+
+	while ((msg = dbus_connection_pop_message(dbus_conn))) {
+		const char *sender = dbus_message_get_sender(msg);
+
+		if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_SIGNAL &&
+				(!bluez_owner ||
+				(sender && !strcmp(sender, bluez_owner))))
+			dbus_signals++;
+
+		dbus_message_unref(msg);
+	}
+}
+
+static char *get_name_owner(DBusConnection *conn, const char *name)
+{
+	DBusMessage *msg, *reply;
+	const char *owner;
+	char *str = NULL;
+
+	msg = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+						DBUS_INTERFACE_DBUS,
+						"GetNameOwner");
+	if (!msg)
+		return NULL;
+
+	dbus_message_append_args(msg, DBUS_TYPE_STRING, &name,
+							DBUS_TYPE_INVALID);
+
+	reply = dbus_connection_send_with_reply_and_block(conn, msg, -1, NULL);
+	dbus_message_unref(msg);
+
+	if (!reply)
+		return NULL;
+
+	if (dbus_message_get_args(reply, NULL, DBUS_TYPE_STRING, &owner,
+							DBUS_TYPE_INVALID))
+		str = strdup(owner);
+
+	dbus_message_unref(reply);
+
+	return str;
+}
+
+/*
+ * Count the signals bluetoothd emits by turning a private system bus
+ * connection into a monitor, which needs the same privileges as
+ * /dev/vhci does anyway.
+ */
+static bool setup_dbus(void)
+{
+	const char *rule = "type='signal'";
+	const char **rules = &rule;
+	DBusMessage *msg, *reply;
+	dbus_uint32_t flags = 0;
+	DBusError err;
+	int fd;
+
+	dbus_error_init(&err);
+
+	dbus_conn = dbus_bus_get_private(DBUS_BUS_SYSTEM, &err);
+	if (!dbus_conn) {
+		fprintf(stderr, "Failed to connect to system bus: %s\n",
+								err.message);
+		dbus_error_free(&err);
+		return false;
+	}
+
+	dbus_connection_set_exit_on_disconnect(dbus_conn, FALSE);
+
+	bluez_owner = get_name_owner(dbus_conn, "org.bluez");
+
+	msg = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+					"org.freedesktop.DBus.Monitoring",
+					"BecomeMonitor");
+	if (!msg)
+		goto fail;
+
+	dbus_message_append_args(msg, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+					&rules, 1, DBUS_TYPE_UINT32, &flags,
+					DBUS_TYPE_INVALID);
+
+	reply = dbus_connection_send_with_reply_and_block(dbus_conn, msg, -1,
+									&err);
+	dbus_message_unref(msg);
+
+	if (!reply) {
+		fprintf(stderr, "Failed to monitor system bus: %s\n",
+								err.message);
+		dbus_error_free(&err);
+		goto fail;
+	}
+
+	dbus_message_unref(reply);
+
+	if (!dbus_connection_get_unix_fd(dbus_conn, &fd))
+		goto fail;
+
+	mainloop_add_fd(fd, EPOLLIN, dbus_callback, NULL, NULL);
+
+	return true;
+
+fail:
+	dbus_connection_close(dbus_conn);
+	dbus_connection_unref(dbus_conn);
+	dbus_conn = NULL;
+	return false;
+}
+
+static void print_report(void)
+{
+	struct timeval now;
+	uint64_t cpu_end[2];
+	long hz = sysconf(_SC_CLK_TCK);
+
+	gettimeofday(&now, NULL);
+
+	printf("\nReplay summary\n");
+	printf("  Elapsed:          %.3f s\n",
+				tv_diff_usec(&now, &start_tv) / 1000000.0);
+	printf("  Host commands:    %u (%u not in capture)\n", host_cmds,
+							unmatched_cmds);
+	printf("  Host data:        %u packets\n", host_data);
+	printf("  Events sent:      %u\n", sent_events);
+	printf("  Data sent:        %u packets\n", sent_data);
+	printf("  Replayed traffic: %zu of %zu packets\n", traffic_pos,
+								traffic_count);
+
+	if (latency_count)
+		printf("  Host latency:     avg %" PRIu64 " usec max %" PRIu64
+					" usec over %u commands\n",
+					latency_sum / latency_count,
+					latency_max, latency_count);
+
+	if (daemon_pid && hz > 0 && read_cpu_time(daemon_pid, cpu_end))
+		printf("  CPU time:         user %.3f s system %.3f s "
+				"(pid %d)\n",
+				(double) (cpu_end[0] - cpu_start[0]) / hz,
+				(double) (cpu_end[1] - cpu_start[1]) / hz,
+				daemon_pid);
+
+	if (dbus_conn)
+		printf("  D-Bus signals:    %" PRIu64 "\n", dbus_signals);
+}
+
+static void hexdump_print(const char *str, void *user_data)
+{
+	printf("%s\n", str);
+}
+
+static void send_packet(uint8_t type, const void *data, uint16_t size)
+{
+	struct iovec iov[2];
+
+	iov[0].iov_base = &type;
+	iov[0].iov_len = 1;
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = size;
+
+	if (debug_enabled)
+		util_hexdump('<', data, size, hexdump_print, NULL);
+
+	if (writev(vhci_fd, iov, 2) < 0) {
+		perror("Failed to write packet");
+		mainloop_exit_failure();
+		return;
+	}
+
+	if (type == H4_EVT_PKT)
+		sent_events++;
+	else
+		sent_data++;
+
+	gettimeofday(&last_sent, NULL);
+}
+
+static void release_traffic(void);
+
+static void timing_timeout(int id, void *user_data)
+{
+	mainloop_remove_timeout(id);
+	timing_id = -1;
+	timing_done = true;
+
+	release_traffic();
+}
+
+/*
+ * Traffic that the controller sent on its own is released in capture order
+ * once the host has issued as many commands as had been recorded before it,
+ * so connection events follow the command that triggered them.
+ */
+static void release_traffic(void)
+{
+	while (traffic_pos < traffic_count && timing_id < 0) {
+		struct record *rec = &traffic[traffic_pos];
+
+		if (rec->gate > cmd_gate)
+			break;
+
+		if (use_timing && !timing_done && traffic_pos > 0) {
+			struct timeval *prev = &traffic[traffic_pos - 1].tv;
+			uint64_t delay = tv_diff_usec(&rec->tv, prev) / 1000;
+
+			if (delay) {
+				timing_id = mainloop_add_timeout(delay,
+							timing_timeout,
+							NULL, NULL);
+				break;
+			}
+		}
+
+		timing_done = false;
+
+		send_packet(rec->type, rec->data, rec->size);
+		traffic_pos++;
+	}
+}
+
+static void idle_callback(int id, void *user_data)
+{
+	/* The host stopped short of the recorded commands, move on anyway */
+	if (traffic_pos < traffic_count && timing_id < 0) {
+		cmd_gate = traffic[traffic_pos].gate;
+		release_traffic();
+		mainloop_modify_timeout(id, idle_timeout);
+		return;
+	}
+
+	if (traffic_pos < traffic_count) {
+		mainloop_modify_timeout(id, idle_timeout);
+		return;
+	}
+
+	print_report();
+	mainloop_quit();
+}
+
+static struct response *find_response(uint16_t opcode)
+{
+	size_t i;
+
+	while (response_next < response_count &&
+					responses[response_next].used)
+		response_next++;
+
+	for (i = response_next; i < response_count; i++) {
+		if (responses[i].opcode != opcode)
+			continue;
+
+		if (!responses[i].used)
+			return &responses[i];
+	}
+
+	/* Repeated commands reuse the last answer the controller gave */
+	for (i = response_count; i > 0; i--) {
+		if (responses[i - 1].opcode == opcode)
+			return &responses[i - 1];
+	}
+
+	return NULL;
+}
+
+static void host_command(const uint8_t *data, uint16_t size)
+{
+	const struct bt_hci_cmd_hdr *hdr = (const void *) data;
+	struct response *rsp;
+	struct timeval now;
+	uint16_t opcode;
+
+	if (size < sizeof(*hdr))
+		return;
+
+	opcode = le16_to_cpu(hdr->opcode);
+
+	gettimeofday(&now, NULL);
+
+	if (timerisset(&last_sent)) {
+		uint64_t latency = tv_diff_usec(&now, &last_sent);
+
+		latency_sum += latency;
+		latency_count++;
+
+		if (latency > latency_max)
+			latency_max = latency;
+	}
+
+	rsp = find_response(opcode);
+	if (rsp) {
+		rsp->used = true;
+		send_packet(H4_EVT_PKT, rsp->evt->data, rsp->evt->size);
+	} else {
+		uint8_t buf[sizeof(struct bt_hci_evt_hdr) +
+				sizeof(struct bt_hci_evt_cmd_complete) + 1];
+		struct bt_hci_evt_hdr *evt = (void *) buf;
+		struct bt_hci_evt_cmd_complete *cc = (void *) (evt + 1);
+
+		evt->evt = BT_HCI_EVT_CMD_COMPLETE;
+		evt->plen = sizeof(*cc) + 1;
+		cc->ncmd = 0x01;
+		cc->opcode = cpu_to_le16(opcode);
+		buf[sizeof(buf) - 1] = BT_HCI_ERR_UNKNOWN_COMMAND;
+
+		send_packet(H4_EVT_PKT, buf, sizeof(buf));
+		unmatched_cmds++;
+	}
+
+	host_cmds++;
+	cmd_gate++;
+
+	release_traffic();
+}
+
+/* Data is acknowledged right away instead of replaying recorded credits */
+static void host_data_packet(const uint8_t *data, uint16_t size)
+{
+	const struct bt_hci_acl_hdr *hdr = (const void *) data;
+	uint8_t buf[sizeof(struct bt_hci_evt_hdr) +
+			sizeof(struct bt_hci_evt_num_completed_packets)];
+	struct bt_hci_evt_hdr *evt = (void *) buf;
+	struct bt_hci_evt_num_completed_packets *ev = (void *) (evt + 1);
+
+	if (size < sizeof(*hdr))
+		return;
+
+	host_data++;
+
+	evt->evt = BT_HCI_EVT_NUM_COMPLETED_PACKETS;
+	evt->plen = sizeof(*ev);
+	ev->num_handles = 1;
+	ev->handle = cpu_to_le16(le16_to_cpu(hdr->handle) & 0x0fff);
+	ev->count = cpu_to_le16(1);
+
+	send_packet(H4_EVT_PKT, buf, sizeof(buf));
+}
+
+static void vhci_callback(int fd, uint32_t events, void *user_data)
+{
+	uint8_t buf[4096];
+	ssize_t len;
+
+	if (events & (EPOLLERR | EPOLLHUP)) {
+		mainloop_remove_fd(fd);
+		mainloop_exit_failure();
+		return;
+	}
+
+	len = read(fd, buf, sizeof(buf));
+	if (len < 1)
+		return;
+
+	if (debug_enabled)
+		util_hexdump('>', buf, len, hexdump_print, NULL);
+
+	mainloop_modify_timeout(idle_id, idle_timeout);
+
+	switch (buf[0]) {
+	case H4_CMD_PKT:
+		host_command(buf + 1, len - 1);
+		break;
+	case H4_ACL_PKT:
+	case H4_ISO_PKT:
+		host_data_packet(buf + 1, len - 1);
+		break;
+	case H4_VENDOR_PKT:
+		if (len >= 4)
+			printf("Replaying to hci%u\n", get_le16(buf + 2));
+		break;
+	}
+}
+
+static bool is_num_completed(const struct record *rec)
+{
+	return rec->type == H4_EVT_PKT && rec->size &&
+			rec->data[0] == BT_HCI_EVT_NUM_COMPLETED_PACKETS;
+}
+
+static bool is_response(const struct record *rec, uint16_t opcode)
+{
+	const struct bt_hci_evt_hdr *hdr = (const void *) rec->data;
+
+	if (rec->type != H4_EVT_PKT || rec->size < sizeof(*hdr) + 4)
+		return false;
+
+	switch (hdr->evt) {
+	case BT_HCI_EVT_CMD_COMPLETE:
+		return get_le16(rec->data + sizeof(*hdr) + 1) == opcode;
+	case BT_HCI_EVT_CMD_STATUS:
+		return get_le16(rec->data + sizeof(*hdr) + 2) == opcode;
+	}
+
+	return false;
+}
+
+static uint8_t record_type(uint16_t opcode)
+{
+	switch (opcode) {
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		return H4_CMD_PKT;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		return H4_EVT_PKT;
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+		return H4_ACL_PKT;
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+		return H4_SCO_PKT;
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		return H4_ISO_PKT;
+	}
+
+	return 0;
+}
+
+/*
+ * Split the capture into the replies to host commands, looked up when the
+ * host sends a command with the same opcode, and the remaining controller
+ * to host traffic.
+ */
+static bool load_capture(const char *path, int index)
+{
+	struct record *recs = NULL;
+	size_t count = 0, alloc = 0, i, j;
+	unsigned int cmds = 0;
+	struct btsnoop *snoop;
+	uint8_t buf[BTSNOOP_MAX_PACKET_SIZE];
+	struct timeval tv;
+	uint16_t idx, opcode, size;
+
+	snoop = btsnoop_open(path, 0);
+	if (!snoop) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		return false;
+	}
+
+	while (btsnoop_read_hci(snoop, &tv, &idx, &opcode, buf, &size)) {
+		uint8_t type = record_type(opcode);
+
+		if (opcode == 0xffff || !type)
+			continue;
+
+		if (index < 0)
+			index = idx;
+
+		if (idx != index)
+			continue;
+
+		if (count == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			recs = realloc(recs, alloc * sizeof(*recs));
+			if (!recs) {
+				btsnoop_unref(snoop);
+				return false;
+			}
+		}
+
+		recs[count].tv = tv;
+		recs[count].type = type;
+		recs[count].size = size;
+		recs[count].data = util_memdup(buf, size);
+		recs[count].gate = 0;
+		count++;
+	}
+
+	btsnoop_unref(snoop);
+
+	responses = new0(struct response, count + 1);
+	traffic = new0(struct record, count + 1);
+
+	for (i = 0; i < count; i++) {
+		struct record *rec = &recs[i];
+
+		if (rec->type != H4_CMD_PKT) {
+			if (!rec->data)
+				continue;
+
+			if (is_num_completed(rec)) {
+				free(rec->data);
+				continue;
+			}
+
+			rec->gate = cmds;
+			traffic[traffic_count++] = *rec;
+			continue;
+		}
+
+		cmds++;
+
+		if (rec->size < sizeof(struct bt_hci_cmd_hdr))
+			continue;
+
+		opcode = get_le16(rec->data);
+
+		for (j = i + 1; j < count; j++) {
+			if (!is_response(&recs[j], opcode))
+				continue;
+
+			responses[response_count].opcode = opcode;
+			responses[response_count].evt = new0(struct record, 1);
+			*responses[response_count].evt = recs[j];
+			response_count++;
+
+			/* Claimed, not replayed as traffic */
+			recs[j].data = NULL;
+			break;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (recs[i].type == H4_CMD_PKT)
+			free(recs[i].data);
+	}
+
+	free(recs);
+
+	printf("Loaded %u commands, %zu replies and %zu packets of traffic "
+			"for index %d\n", cmds, response_count, traffic_count,
+			index);
+
+	return true;
+}
+
+static int open_vhci(uint8_t type)
+{
+	uint8_t create_req[2] = { H4_VENDOR_PKT, type };
+	int fd;
+
+	fd = open("/dev/vhci", O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		perror("Failed to open /dev/vhci device");
+		return -1;
+	}
+
+	if (write(fd, create_req, sizeof(create_req)) < 0) {
+		perror("Failed to set device type");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void signal_callback(int signum, void *user_data)
+{
+	switch (signum) {
+	case SIGINT:
+	case SIGTERM:
+		print_report();
+		mainloop_quit();
+		break;
+	}
+}
+
+static void usage(void)
+{
+	printf("btreplay - Replay a capture against bluetoothd\n"
+		"Usage:\n");
+	printf("\tbtreplay [options] <file>\n");
+	printf("Options:\n"
+		"\t-i, --index <num>           Replay specified capture index\n"
+		"\t-p, --pid <pid>             Measure specified daemon\n"
+		"\t-w, --wait <msec>           Idle time before finishing\n"
+		"\t-t, --timing                Keep recorded packet timing\n"
+		"\t-n, --no-dbus               Don't count D-Bus signals\n"
+		"\t-d, --debug                 Enable debugging output\n"
+		"\t-h, --help                  Show help options\n");
+}
+
+static const struct option main_options[] = {
+	{ "index",   required_argument, NULL, 'i' },
+	{ "pid",     required_argument, NULL, 'p' },
+	{ "wait",    required_argument, NULL, 'w' },
+	{ "timing",  no_argument,       NULL, 't' },
+	{ "no-dbus", no_argument,       NULL, 'n' },
+	{ "debug",   no_argument,       NULL, 'd' },
+	{ "version", no_argument,       NULL, 'v' },
+	{ "help",    no_argument,       NULL, 'h' },
+	{ }
+};
+
+int main(int argc, char *argv[])
+{
+	bool use_dbus = true;
+	int index = -1;
+
+	for (;;) {
+		int opt;
+
+		opt = getopt_long(argc, argv, "i:p:w:tndvh", main_options,
+									NULL);
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'i':
+			index = atoi(optarg);
+			break;
+		case 'p':
+			daemon_pid = atoi(optarg);
+			break;
+		case 'w':
+			idle_timeout = atoi(optarg);
+			if (!idle_timeout)
+				idle_timeout = DEFAULT_IDLE_TIMEOUT;
+			break;
+		case 't':
+			use_timing = true;
+			break;
+		case 'n':
+			use_dbus = false;
+			break;
+		case 'd':
+			debug_enabled = true;
+			break;
+		case 'v':
+			printf("%s\n", VERSION);
+			return EXIT_SUCCESS;
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind != 1) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (!load_capture(argv[optind], index))
+		return EXIT_FAILURE;
+
+	mainloop_init();
+
+	if (!daemon_pid)
+		daemon_pid = find_daemon();
+
+	if (!daemon_pid || !read_cpu_time(daemon_pid, cpu_start)) {
+		fprintf(stderr, "bluetoothd not found, no CPU time reported\n");
+		daemon_pid = 0;
+	}
+
+	if (use_dbus)
+		setup_dbus();
+
+	vhci_fd = open_vhci(HCI_PRIMARY);
+	if (vhci_fd < 0)
+		return EXIT_FAILURE;
+
+	gettimeofday(&start_tv, NULL);
+
+	mainloop_add_fd(vhci_fd, EPOLLIN, vhci_callback, NULL, NULL);
+	idle_id = mainloop_add_timeout(idle_timeout, idle_callback, NULL,
+									NULL);
+
+	release_traffic();
+
+	return mainloop_run_with_signal(signal_callback, NULL);
+}
@@ -26,12 +26,17 @@
 #include <sys/param.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <signal.h>
+#include <poll.h>
+#include <time.h>
 
 #include "lib/bluetooth.h"
 #include "lib/hci.h"
 #include "lib/hci_lib.h"
 
+#include "monitor/bt.h"
+
 #include "src/oui.h"
 
 #ifndef MIN
@@ -2326,7 +2331,8 @@ static int read_flags(uint8_t *flags, const uint8_t *data, size_t size)
 	return -ENOENT;
 }
 
-static int check_report_filter(uint8_t procedure, le_advertising_info *info)
+static int check_report_filter(uint8_t procedure, const uint8_t *data,
+								uint8_t len)
 {
 	uint8_t flags;
 
@@ -2335,7 +2341,7 @@ static int check_report_filter(uint8_t procedure, le_advertising_info *info)
 		return 1;
 
 	/* Read flags AD type value from the advertising report if it exists */
-	if (read_flags(&flags, info->data, info->length))
+	if (read_flags(&flags, data, len))
 		return 0;
 
 	switch (procedure) {
@@ -2395,13 +2401,257 @@ failed:
 	snprintf(buf, buf_len, "(unknown)");
 }
 
-static int print_advertising_devices(int dd, uint8_t filter_type)
+#define LESCAN_RING_SIZE	(1 << 20)
+#define LESCAN_RCVBUF		(1 << 20)
+
+enum lescan_format {
+	LESCAN_TEXT,
+	LESCAN_JSON,
+	LESCAN_BINARY,
+};
+
+struct lescan_report {
+	uint16_t evt_type;
+	uint8_t addr_type;
+	bdaddr_t bdaddr;
+	int8_t rssi;
+	uint8_t len;
+	const uint8_t *data;
+};
+
+/* Binary output record, all fields little endian, followed by data */
+struct lescan_record {
+	uint64_t timestamp;
+	uint16_t evt_type;
+	uint8_t addr_type;
+	bdaddr_t bdaddr;
+	int8_t rssi;
+	uint8_t len;
+} __attribute__ ((packed));
+
+struct lescan_ring {
+	uint8_t buf[LESCAN_RING_SIZE];
+	size_t head;
+	size_t tail;
+};
+
+struct lescan {
+	uint8_t filter_type;
+	enum lescan_format format;
+	int stats;
+	struct lescan_ring ring;
+	unsigned int reports;
+	unsigned int dropped;
+	unsigned long long total;
+};
+
+static int ring_push(struct lescan_ring *ring, const void *data, size_t len)
+{
+	size_t off, part;
+
+	if (LESCAN_RING_SIZE - (ring->head - ring->tail) < len)
+		return -ENOSPC;
+
+	off = ring->head % LESCAN_RING_SIZE;
+	part = MIN(len, LESCAN_RING_SIZE - off);
+
+	memcpy(ring->buf + off, data, part);
+	memcpy(ring->buf, (const uint8_t *) data + part, len - part);
+	ring->head += len;
+
+	return 0;
+}
+
+static int ring_flush(struct lescan_ring *ring, int fd)
+{
+	while (ring->head != ring->tail) {
+		size_t off = ring->tail % LESCAN_RING_SIZE;
+		size_t len = MIN(ring->head - ring->tail,
+						LESCAN_RING_SIZE - off);
+		ssize_t written;
+
+		written = write(fd, ring->buf + off, len);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EAGAIN)
+				return 0;
+
+			return -errno;
+		}
+
+		ring->tail += written;
+	}
+
+	return 0;
+}
+
+static uint64_t lescan_timestamp(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int format_report(struct lescan *scan, const struct lescan_report *rp,
+						char *str, size_t size)
+{
+	struct lescan_record *rec = (void *) str;
+	char addr[18], name[30];
+	int len, i;
+
+	switch (scan->format) {
+	case LESCAN_BINARY:
+		bt_put_le64(lescan_timestamp(), &rec->timestamp);
+		bt_put_le16(rp->evt_type, &rec->evt_type);
+		rec->addr_type = rp->addr_type;
+		bacpy(&rec->bdaddr, &rp->bdaddr);
+		rec->rssi = rp->rssi;
+		rec->len = rp->len;
+		memcpy(str + sizeof(*rec), rp->data, rp->len);
+		return sizeof(*rec) + rp->len;
+
+	case LESCAN_JSON:
+		ba2str(&rp->bdaddr, addr);
+		len = snprintf(str, size, "{\"timestamp\":%llu,\"addr\":\"%s\","
+				"\"addr_type\":%u,\"evt_type\":%u,\"rssi\":%d,"
+				"\"data\":\"",
+				(unsigned long long) lescan_timestamp(), addr,
+				rp->addr_type, rp->evt_type, rp->rssi);
+
+		for (i = 0; i < rp->len; i++)
+			len += sprintf(str + len, "%2.2x", rp->data[i]);
+
+		len += sprintf(str + len, "\"}\n");
+		return len;
+
+	case LESCAN_TEXT:
+	default:
+		memset(name, 0, sizeof(name));
+
+		ba2str(&rp->bdaddr, addr);
+		eir_parse_name((uint8_t *) rp->data, rp->len, name,
+							sizeof(name) - 1);
+
+		return snprintf(str, size, "%s %s\n", addr, name);
+	}
+}
+
+static void output_report(struct lescan *scan, const struct lescan_report *rp)
+{
+	/* Large enough for a hex encoded 255 byte report */
+	char str[sizeof(struct lescan_record) + 640];
+	int len;
+
+	if (!check_report_filter(scan->filter_type, rp->data, rp->len))
+		return;
+
+	scan->reports++;
+	scan->total++;
+
+	len = format_report(scan, rp, str, sizeof(str));
+
+	/* Drop reports instead of stalling the HCI socket on slow output */
+	if (ring_push(&scan->ring, str, len) < 0)
+		scan->dropped++;
+}
+
+static void process_adv_report(struct lescan *scan, const uint8_t *data,
+								int len)
+{
+	struct lescan_report rp;
+	uint8_t num_reports;
+
+	if (len < 1)
+		return;
+
+	num_reports = *data++;
+	len--;
+
+	while (num_reports--) {
+		const le_advertising_info *info = (void *) data;
+		int size = LE_ADVERTISING_INFO_SIZE;
+
+		/* Each legacy report is followed by its RSSI */
+		if (len < size || len < size + info->length + 1)
+			return;
+
+		rp.evt_type = info->evt_type;
+		rp.addr_type = info->bdaddr_type;
+		bacpy(&rp.bdaddr, &info->bdaddr);
+		rp.len = info->length;
+		rp.data = info->data;
+		rp.rssi = info->data[info->length];
+
+		output_report(scan, &rp);
+
+		data += size + info->length + 1;
+		len -= size + info->length + 1;
+	}
+}
+
+static void process_ext_adv_report(struct lescan *scan, const uint8_t *data,
+								int len)
+{
+	struct lescan_report rp;
+	uint8_t num_reports;
+
+	if (len < 1)
+		return;
+
+	num_reports = *data++;
+	len--;
+
+	while (num_reports--) {
+		const struct bt_hci_le_ext_adv_report *info = (void *) data;
+		int size = sizeof(*info);
+
+		if (len < size || len < size + info->data_len)
+			return;
+
+		rp.evt_type = btohs(info->event_type);
+		rp.addr_type = info->addr_type;
+		memcpy(&rp.bdaddr, info->addr, sizeof(rp.bdaddr));
+		rp.len = info->data_len;
+		rp.data = info->data;
+		rp.rssi = info->rssi;
+
+		output_report(scan, &rp);
+
+		data += size + info->data_len;
+		len -= size + info->data_len;
+	}
+}
+
+static long lescan_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void print_stats(struct lescan *scan)
+{
+	fprintf(stderr, "reports %u/s dropped %u/s total %llu\n",
+				scan->reports, scan->dropped, scan->total);
+
+	scan->reports = 0;
+	scan->dropped = 0;
+}
+
+static int print_advertising_devices(int dd, struct lescan *scan)
 {
 	unsigned char buf[HCI_MAX_EVENT_SIZE], *ptr;
 	struct hci_filter nf, of;
 	struct sigaction sa;
 	socklen_t olen;
-	int len;
+	int len, flags, rcvbuf = LESCAN_RCVBUF;
+	long next_stats;
 
 	olen = sizeof(of);
 	if (getsockopt(dd, SOL_HCI, HCI_FILTER, &of, &olen) < 0) {
@@ -2418,17 +2668,39 @@ static int print_advertising_devices(int dd, uint8_t filter_type)
 		return -1;
 	}
 
+	/* Give bursts of reports room while the output catches up */
+	setsockopt(dd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
 	memset(&sa, 0, sizeof(sa));
 	sa.sa_flags = SA_NOCLDSTOP;
 	sa.sa_handler = sigint_handler;
 	sigaction(SIGINT, &sa, NULL);
 
+	fflush(stdout);
+	flags = fcntl(STDOUT_FILENO, F_GETFL);
+	if (flags >= 0)
+		fcntl(STDOUT_FILENO, F_SETFL, flags | O_NONBLOCK);
+
+	next_stats = lescan_now() + 1000;
+
 	while (1) {
 		evt_le_meta_event *meta;
-		le_advertising_info *info;
-		char addr[18];
+		struct pollfd p[2];
+		int n, timeout = -1;
 
-		while ((len = read(dd, buf, sizeof(buf))) < 0) {
+		p[0].fd = dd;
+		p[0].events = POLLIN;
+		p[1].fd = STDOUT_FILENO;
+		p[1].events = scan->ring.head != scan->ring.tail ? POLLOUT : 0;
+
+		if (scan->stats) {
+			timeout = next_stats - lescan_now();
+			if (timeout < 0)
+				timeout = 0;
+		}
+
+		n = poll(p, 2, timeout);
+		if (n < 0) {
 			if (errno == EINTR && signal_received == SIGINT) {
 				len = 0;
 				goto done;
@@ -2436,33 +2708,64 @@ static int print_advertising_devices(int dd, uint8_t filter_type)
 
 			if (errno == EAGAIN || errno == EINTR)
 				continue;
+
+			len = -1;
 			goto done;
 		}
 
-		ptr = buf + (1 + HCI_EVENT_HDR_SIZE);
-		len -= (1 + HCI_EVENT_HDR_SIZE);
+		if (scan->stats && lescan_now() >= next_stats) {
+			print_stats(scan);
+			next_stats += 1000;
+		}
 
-		meta = (void *) ptr;
+		if (p[1].revents & (POLLERR | POLLHUP)) {
+			len = 0;
+			goto done;
+		}
 
-		if (meta->subevent != 0x02)
+		if (p[1].revents & POLLOUT && ring_flush(&scan->ring,
+							STDOUT_FILENO) < 0) {
+			len = -1;
 			goto done;
+		}
+
+		if (!(p[0].revents & POLLIN))
+			continue;
+
+		while ((len = read(dd, buf, sizeof(buf))) < 0) {
+			if (errno == EINTR && signal_received == SIGINT) {
+				len = 0;
+				goto done;
+			}
 
-		/* Ignoring multiple reports */
-		info = (le_advertising_info *) (meta->data + 1);
-		if (check_report_filter(filter_type, info)) {
-			char name[30];
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			goto done;
+		}
 
-			memset(name, 0, sizeof(name));
+		ptr = buf + (1 + HCI_EVENT_HDR_SIZE);
+		len -= (1 + HCI_EVENT_HDR_SIZE);
+		if (len < 1)
+			continue;
 
-			ba2str(&info->bdaddr, addr);
-			eir_parse_name(info->data, info->length,
-							name, sizeof(name) - 1);
+		meta = (void *) ptr;
 
-			printf("%s %s\n", addr, name);
+		switch (meta->subevent) {
+		case EVT_LE_ADVERTISING_REPORT:
+			process_adv_report(scan, meta->data, len - 1);
+			break;
+		case BT_HCI_EVT_LE_EXT_ADV_REPORT:
+			process_ext_adv_report(scan, meta->data, len - 1);
+			break;
 		}
 	}
 
 done:
+	if (flags >= 0)
+		fcntl(STDOUT_FILENO, F_SETFL, flags);
+
+	ring_flush(&scan->ring, STDOUT_FILENO);
+
 	setsockopt(dd, SOL_HCI, HCI_FILTER, &of, sizeof(of));
 
 	if (len < 0)
@@ -2471,6 +2774,87 @@ done:
 	return 0;
 }
 
+static int le_set_ext_scan_parameters(int dd, uint8_t type, uint16_t interval,
+					uint16_t window, uint8_t own_type,
+					uint8_t filter, int coded, int to)
+{
+	uint8_t param[sizeof(struct bt_hci_cmd_le_set_ext_scan_params) +
+				2 * sizeof(struct bt_hci_le_scan_phy)];
+	struct bt_hci_cmd_le_set_ext_scan_params *cp = (void *) param;
+	struct bt_hci_le_scan_phy *phy = (void *) cp->data;
+	struct hci_request rq;
+	uint8_t status;
+	int i, num = coded ? 2 : 1;
+
+	memset(param, 0, sizeof(param));
+	cp->own_addr_type = own_type;
+	cp->filter_policy = filter;
+	cp->num_phys = coded ? 0x05 : 0x01;
+
+	for (i = 0; i < num; i++) {
+		phy[i].type = type;
+		phy[i].interval = interval;
+		phy[i].window = window;
+	}
+
+	memset(&rq, 0, sizeof(rq));
+	rq.ogf = OGF_LE_CTL;
+	rq.ocf = BT_HCI_CMD_LE_SET_EXT_SCAN_PARAMS & 0x03ff;
+	rq.cparam = param;
+	rq.clen = sizeof(*cp) + num * sizeof(*phy);
+	rq.rparam = &status;
+	rq.rlen = 1;
+
+	if (hci_send_req(dd, &rq, to) < 0)
+		return -1;
+
+	if (status) {
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int le_set_ext_scan_enable(int dd, uint8_t enable, uint8_t filter_dup,
+									int to)
+{
+	struct bt_hci_cmd_le_set_ext_scan_enable cp;
+	struct hci_request rq;
+	uint8_t status;
+
+	memset(&cp, 0, sizeof(cp));
+	cp.enable = enable;
+	cp.filter_dup = filter_dup;
+
+	memset(&rq, 0, sizeof(rq));
+	rq.ogf = OGF_LE_CTL;
+	rq.ocf = BT_HCI_CMD_LE_SET_EXT_SCAN_ENABLE & 0x03ff;
+	rq.cparam = &cp;
+	rq.clen = sizeof(cp);
+	rq.rparam = &status;
+	rq.rlen = 1;
+
+	if (hci_send_req(dd, &rq, to) < 0)
+		return -1;
+
+	if (status) {
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int le_scan_enable(int dd, int extended, uint8_t enable,
+						uint8_t filter_dup, int to)
+{
+	if (extended)
+		return le_set_ext_scan_enable(dd, enable, filter_dup, to);
+
+	return hci_le_set_scan_enable(dd, enable, filter_dup, to);
+}
+
 static struct option lescan_options[] = {
 	{ "help",	0, 0, 'h' },
 	{ "static",	0, 0, 's' },
@@ -2480,6 +2864,10 @@ static struct option lescan_options[] = {
 	{ "acceptlist",	0, 0, 'a' },
 	{ "discovery",	1, 0, 'd' },
 	{ "duplicates",	0, 0, 'D' },
+	{ "extended",	0, 0, 'e' },
+	{ "coded",	0, 0, 'c' },
+	{ "output",	1, 0, 'o' },
+	{ "stats",	0, 0, 'S' },
 	{ 0, 0, 0, 0 }
 };
 
@@ -2490,18 +2878,31 @@ static const char *lescan_help =
 	"\tlescan [--acceptlist] scan for address in the accept list only\n"
 	"\tlescan [--discovery=g|l] enable general or limited discovery"
 		"procedure\n"
-	"\tlescan [--duplicates] don't filter duplicates\n";
+	"\tlescan [--duplicates] don't filter duplicates\n"
+	"\tlescan [--extended] use extended scanning\n"
+	"\tlescan [--coded] also scan on LE Coded PHY (with --extended)\n"
+	"\tlescan [--output=text|json|binary] select report output format\n"
+	"\tlescan [--stats] print report counters every second\n";
 
 static void cmd_lescan(int dev_id, int argc, char **argv)
 {
 	int err, opt, dd;
 	uint8_t own_type = LE_PUBLIC_ADDRESS;
 	uint8_t scan_type = 0x01;
-	uint8_t filter_type = 0;
 	uint8_t filter_policy = 0x00;
 	uint16_t interval = htobs(0x0010);
 	uint16_t window = htobs(0x0010);
 	uint8_t filter_dup = 0x01;
+	int extended = 0, coded = 0;
+	struct lescan *scan;
+
+	scan = malloc(sizeof(*scan));
+	if (!scan) {
+		perror("Could not allocate scan buffer");
+		exit(1);
+	}
+
+	memset(scan, 0, sizeof(*scan));
 
 	for_each_opt(opt, lescan_options, NULL) {
 		switch (opt) {
@@ -2519,8 +2920,9 @@ static void cmd_lescan(int dev_id, int argc, char **argv)
 			filter_policy = 0x01; /* Accept list */
 			break;
 		case 'd':
-			filter_type = optarg[0];
-			if (filter_type != 'g' && filter_type != 'l') {
+			scan->filter_type = optarg[0];
+			if (scan->filter_type != 'g' &&
+						scan->filter_type != 'l') {
 				fprintf(stderr, "Unknown discovery procedure\n");
 				exit(1);
 			}
@@ -2531,13 +2933,40 @@ static void cmd_lescan(int dev_id, int argc, char **argv)
 		case 'D':
 			filter_dup = 0x00;
 			break;
+		case 'e':
+			extended = 1;
+			break;
+		case 'c':
+			coded = 1;
+			break;
+		case 'o':
+			if (!strcasecmp(optarg, "text"))
+				scan->format = LESCAN_TEXT;
+			else if (!strcasecmp(optarg, "json"))
+				scan->format = LESCAN_JSON;
+			else if (!strcasecmp(optarg, "binary"))
+				scan->format = LESCAN_BINARY;
+			else {
+				fprintf(stderr, "Unknown output format\n");
+				exit(1);
+			}
+			break;
+		case 'S':
+			scan->stats = 1;
+			break;
 		default:
 			printf("%s", lescan_help);
+			free(scan);
 			return;
 		}
 	}
 	helper_arg(0, 1, &argc, &argv, lescan_help);
 
+	if (coded && !extended) {
+		fprintf(stderr, "Coded PHY requires extended scanning\n");
+		exit(1);
+	}
+
 	if (dev_id < 0)
 		dev_id = hci_get_route(NULL);
 
@@ -2547,34 +2976,44 @@ static void cmd_lescan(int dev_id, int argc, char **argv)
 		exit(1);
 	}
 
-	err = hci_le_set_scan_parameters(dd, scan_type, interval, window,
-						own_type, filter_policy, 10000);
+	if (extended)
+		err = le_set_ext_scan_parameters(dd, scan_type, interval,
+						window, own_type, filter_policy,
+						coded, 10000);
+	else
+		err = hci_le_set_scan_parameters(dd, scan_type, interval,
+						window, own_type, filter_policy,
+						10000);
 	if (err < 0) {
 		perror("Set scan parameters failed");
 		exit(1);
 	}
 
-	err = hci_le_set_scan_enable(dd, 0x01, filter_dup, 10000);
+	err = le_scan_enable(dd, extended, 0x01, filter_dup, 10000);
 	if (err < 0) {
 		perror("Enable scan failed");
 		exit(1);
 	}
 
-	printf("LE Scan ...\n");
+	if (scan->format == LESCAN_TEXT)
+		printf("LE Scan ...\n");
+	else
+		fprintf(stderr, "LE Scan ...\n");
 
-	err = print_advertising_devices(dd, filter_type);
+	err = print_advertising_devices(dd, scan);
 	if (err < 0) {
 		perror("Could not receive advertising events");
 		exit(1);
 	}
 
-	err = hci_le_set_scan_enable(dd, 0x00, filter_dup, 10000);
+	err = le_scan_enable(dd, extended, 0x00, filter_dup, 10000);
 	if (err < 0) {
 		perror("Disable scan failed");
 		exit(1);
 	}
 
 	hci_close_dev(dd);
+	free(scan);
 }
 
 static struct option leinfo_options[] = {
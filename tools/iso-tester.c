@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <poll.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <time.h>
 
 #include <linux/errqueue.h>
@@ -461,6 +462,14 @@ static const uint8_t base_lc3_ac_14[] = {
 					     */
 };
 
+struct iso_stream_stats {
+	unsigned int sent;
+	struct timespec start;
+	struct timespec last;
+	struct timespec cpu;
+	uint64_t gap_max;
+};
+
 struct test_data {
 	const void *test_data;
 	struct mgmt *mgmt;
@@ -477,6 +486,7 @@ struct test_data {
 	bool reconnect;
 	bool suspending;
 	struct tx_tstamp_data tx_ts;
+	struct iso_stream_stats stream;
 };
 
 struct iso_client_data {
@@ -517,6 +527,11 @@ struct iso_client_data {
 
 	/* Disable BT_POLL_ERRQUEUE before enabling TX timestamping */
 	bool no_poll_errqueue;
+
+	/* Number of packets to stream as fast as the controller accepts them,
+	 * reporting throughput, CPU time and jitter.
+	 */
+	unsigned int stream;
 };
 
 typedef bool (*iso_defer_accept_t)(struct test_data *data, GIOChannel *io,
@@ -577,6 +592,9 @@ static void index_added_callback(uint16_t index, uint16_t length,
 	tester_print("Index Added callback");
 	tester_print("  Index: 0x%04x", index);
 
+	if (data->hciemu && index != hciemu_get_index(data->hciemu))
+		return;
+
 	data->mgmt_index = index;
 
 	mgmt_send(data->mgmt, MGMT_OP_READ_INFO, data->mgmt_index, 0, NULL,
@@ -1061,6 +1079,20 @@ static const struct iso_client_data connect_16_2_1_send = {
 	.send = &send_16_2_1,
 };
 
+static const struct iso_client_data connect_16_2_1_stream = {
+	.qos = QOS_16_2_1,
+	.expect_err = 0,
+	.send = &send_16_2_1,
+	.stream = 500,
+};
+
+static const struct iso_client_data connect_48_2_1_stream = {
+	.qos = QOS_48_2_1,
+	.expect_err = 0,
+	.send = &send_48_2_1,
+	.stream = 500,
+};
+
 static const struct iso_client_data connect_send_tx_timestamping = {
 	.qos = QOS_16_2_1,
 	.expect_err = 0,
@@ -1375,6 +1407,16 @@ static const struct iso_client_data bcast_16_2_1_send = {
 	.base_len = sizeof(base_lc3_16_2_1),
 };
 
+static const struct iso_client_data bcast_16_2_1_stream = {
+	.qos = QOS_OUT_16_2_1,
+	.expect_err = 0,
+	.send = &send_16_2_1,
+	.bcast = true,
+	.base = base_lc3_16_2_1,
+	.base_len = sizeof(base_lc3_16_2_1),
+	.stream = 500,
+};
+
 static const struct iso_client_data bcast_enc_16_2_1_send = {
 	.qos = QOS_OUT_ENC_16_2_1,
 	.expect_err = 0,
@@ -2380,11 +2422,118 @@ static void iso_send_data(struct test_data *data, GIOChannel *io)
 	data->step++;
 }
 
+static uint64_t timespec_diff_us(const struct timespec *a,
+					const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000000LL +
+			(b->tv_nsec - a->tv_nsec) / 1000;
+}
+
+static void iso_stream_report(struct test_data *data)
+{
+	const struct iso_client_data *isodata = data->test_data;
+	struct iso_stream_stats *stats = &data->stream;
+	struct timespec cpu;
+	uint64_t elapsed, cpu_us, bytes;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+	elapsed = timespec_diff_us(&stats->start, &stats->last);
+	cpu_us = timespec_diff_us(&stats->cpu, &cpu);
+	bytes = (uint64_t) stats->sent * isodata->send->iov_len;
+
+	tester_print("Streamed %u packets (%" PRIu64 " bytes) in %" PRIu64
+			" us: %" PRIu64 " bytes/s", stats->sent, bytes,
+			elapsed, elapsed ? bytes * 1000000 / elapsed : 0);
+	tester_print("CPU %" PRIu64 " us (%" PRIu64 " ns/packet), "
+			"max gap %" PRIu64 " us", cpu_us,
+			cpu_us * 1000 / stats->sent, stats->gap_max);
+}
+
+static gboolean iso_stream_cb(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct test_data *data = user_data;
+	const struct iso_client_data *isodata = data->test_data;
+	struct iso_stream_stats *stats = &data->stream;
+	struct timespec now;
+	uint64_t gap;
+	ssize_t ret;
+	int sk;
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		tester_warn("Stream interrupted after %u packets",
+							stats->sent);
+		goto failed;
+	}
+
+	sk = g_io_channel_unix_get_fd(io);
+
+	while (stats->sent < isodata->stream) {
+		ret = send(sk, isodata->send->iov_base,
+				isodata->send->iov_len, MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EAGAIN)
+				return TRUE;
+
+			tester_warn("Failed to write %zu bytes: %s (%d)",
+					isodata->send->iov_len,
+					strerror(errno), errno);
+			goto failed;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		if (stats->sent) {
+			gap = timespec_diff_us(&stats->last, &now);
+			if (gap > stats->gap_max)
+				stats->gap_max = gap;
+		}
+
+		stats->last = now;
+		stats->sent++;
+	}
+
+	iso_stream_report(data);
+
+	data->io_id[2] = 0;
+	tester_test_passed();
+
+	return FALSE;
+
+failed:
+	data->io_id[2] = 0;
+	tester_test_failed();
+
+	return FALSE;
+}
+
+static void iso_stream(struct test_data *data, GIOChannel *io)
+{
+	const struct iso_client_data *isodata = data->test_data;
+
+	tester_print("Streaming %u packets of %zu bytes", isodata->stream,
+						isodata->send->iov_len);
+
+	memset(&data->stream, 0, sizeof(data->stream));
+	clock_gettime(CLOCK_MONOTONIC, &data->stream.start);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &data->stream.cpu);
+	data->stream.last = data->stream.start;
+
+	data->io_id[2] = g_io_add_watch(io, G_IO_OUT | G_IO_ERR | G_IO_HUP |
+					G_IO_NVAL, iso_stream_cb, data);
+}
+
 static void iso_send(struct test_data *data, GIOChannel *io)
 {
 	const struct iso_client_data *isodata = data->test_data;
 	unsigned int count;
 
+	if (isodata->stream) {
+		iso_stream(data, io);
+		return;
+	}
+
 	for (count = 0; count < isodata->repeat_send_pre_ts; ++count)
 		iso_send_data(data, io);
 
@@ -3633,6 +3782,12 @@ int main(int argc, char *argv[])
 	test_iso("ISO Send - Success", &connect_16_2_1_send, setup_powered,
 							test_connect);
 
+	/* Stream packets back to back to measure throughput and jitter */
+	test_iso("ISO Send Stream 16_2_1 - Success", &connect_16_2_1_stream,
+						setup_powered, test_connect);
+	test_iso("ISO Send Stream 48_2_1 - Success", &connect_48_2_1_stream,
+						setup_powered, test_connect);
+
 	/* Test basic TX timestamping */
 	test_iso("ISO Send - TX Timestamping", &connect_send_tx_timestamping,
 						setup_powered, test_connect);
@@ -3803,6 +3958,8 @@ int main(int argc, char *argv[])
 
 	test_iso("ISO Broadcaster - Success", &bcast_16_2_1_send, setup_powered,
 							test_bcast);
+	test_iso("ISO Broadcaster Stream - Success", &bcast_16_2_1_stream,
+						setup_powered, test_bcast);
 	test_iso("ISO Broadcaster Encrypted - Success", &bcast_enc_16_2_1_send,
 							setup_powered,
 							test_bcast);
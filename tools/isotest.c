@@ -29,7 +29,10 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include <linux/sockios.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <time.h>
 #include <inttypes.h>
 #include <sys/wait.h>
@@ -53,6 +56,8 @@
 
 #define MAX_DATA_SIZE 0x40000000
 
+#define TX_TSTAMP_MAX 64
+
 /* Test modes */
 enum {
 	SEND,
@@ -76,6 +81,11 @@ static int defer_setup;
 static int sndbuf;
 static struct timeval sndto;
 static bool quiet;
+static bool zerocopy;
+static bool tstamp;
+static bool sync_send;
+static const uint8_t *map_data;
+static size_t map_size;
 
 struct bt_iso_qos *iso_qos;
 static bool inout;
@@ -119,6 +129,124 @@ static float tv2fl(struct timeval tv)
 	return (float)tv.tv_sec + (float)(tv.tv_usec/1000000.0);
 }
 
+static int64_t ts_diff_us(const struct timespec *a, const struct timespec *b)
+{
+	return ((int64_t) a->tv_sec - b->tv_sec) * 1000000L +
+				((int64_t) a->tv_nsec - b->tv_nsec) / 1000L;
+}
+
+static void tstamp_enable(int sk, uint32_t flags)
+{
+	if (setsockopt(sk, SOL_SOCKET, SO_TIMESTAMPING, &flags,
+							sizeof(flags)) < 0)
+		syslog(LOG_ERR, "Can't set socket SO_TIMESTAMPING option: "
+					"%s (%d)", strerror(errno), errno);
+}
+
+static ssize_t recv_sdu(int sk, void *data, size_t len, struct timespec *ts)
+{
+	unsigned char control[128];
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	ssize_t ret;
+
+	iov.iov_base = data;
+	iov.iov_len = len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ret = recvmsg(sk, &msg, 0);
+	if (ret < 0 || !ts)
+		return ret;
+
+	memset(ts, 0, sizeof(*ts));
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		struct scm_timestamping *tss;
+
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+					cmsg->cmsg_type != SCM_TIMESTAMPING)
+			continue;
+
+		tss = (void *) CMSG_DATA(cmsg);
+		*ts = tss->ts[0];
+		break;
+	}
+
+	return ret;
+}
+
+/* Report how long each SDU took from send() until the controller took it */
+static void tx_tstamp_drain(int sk, const struct timespec *sent)
+{
+	unsigned char control[256];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	while (1) {
+		struct scm_timestamping *tss = NULL;
+		struct sock_extended_err *serr = NULL;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(sk, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			return;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+					cmsg->cmsg_type == SCM_TIMESTAMPING)
+				tss = (void *) CMSG_DATA(cmsg);
+			else if (cmsg->cmsg_level == SOL_BLUETOOTH &&
+					cmsg->cmsg_type == BT_SCM_ERROR)
+				serr = (void *) CMSG_DATA(cmsg);
+		}
+
+		if (!tss || !serr || serr->ee_errno != ENOMSG ||
+				serr->ee_origin != SO_EE_ORIGIN_TIMESTAMPING)
+			continue;
+
+		if (!quiet)
+			syslog(LOG_INFO, "[seq %u] tx latency %" PRId64 " us",
+				serr->ee_data, ts_diff_us(&tss->ts[0],
+					&sent[serr->ee_data % TX_TSTAMP_MAX]));
+	}
+}
+
+/* Map regular input files so SDUs are sent straight from the page cache
+ * instead of being read into a userspace buffer first.
+ */
+static void map_file(int fd)
+{
+	struct stat st;
+	void *addr;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !st.st_size) {
+		syslog(LOG_INFO, "Input is not a regular file, not mapping");
+		return;
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED) {
+		syslog(LOG_ERR, "Can't map input file: %s (%d)",
+						strerror(errno), errno);
+		return;
+	}
+
+	madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+	map_data = addr;
+	map_size = st.st_size;
+}
+
 static const uint8_t set_iso_socket_param[] = {
 	0x3e, 0xe0, 0xb4, 0xfd, 0xdd, 0xd6, 0x85, 0x98, /* UUID - ISO Socket */
 	0x6a, 0x49, 0xe0, 0x05, 0x88, 0xf1, 0xba, 0x6f,
@@ -633,6 +761,7 @@ error:
 
 static void dump_mode(int fd, int sk, char *peer)
 {
+	struct timespec ts;
 	int len;
 
 	if (defer_setup && !peer) {
@@ -644,8 +773,13 @@ static void dump_mode(int fd, int sk, char *peer)
 			syslog(LOG_INFO, "Initial bytes %d", len);
 	}
 
+	if (tstamp)
+		tstamp_enable(sk, SOF_TIMESTAMPING_SOFTWARE |
+					SOF_TIMESTAMPING_RX_SOFTWARE);
+
 	syslog(LOG_INFO, "Receiving ...");
-	while ((len = read(sk, buf, data_size)) >= 0) {
+	while ((len = recv_sdu(sk, buf, data_size,
+					tstamp ? &ts : NULL)) >= 0) {
 		if (fd >= 0) {
 			len = write(fd, buf, len);
 			if (len < 0) {
@@ -653,7 +787,12 @@ static void dump_mode(int fd, int sk, char *peer)
 						strerror(errno), errno);
 				return;
 			}
-		} else if (!quiet)
+		} else if (quiet)
+			continue;
+		else if (tstamp)
+			syslog(LOG_INFO, "Received %d bytes at %ld.%06ld", len,
+					(long) ts.tv_sec, ts.tv_nsec / 1000);
+		else
 			syslog(LOG_INFO, "Received %d bytes", len);
 	}
 }
@@ -661,6 +800,8 @@ static void dump_mode(int fd, int sk, char *peer)
 static void recv_mode(int fd, int sk, char *peer)
 {
 	struct timeval tv_beg, tv_end, tv_diff;
+	struct timespec ts, ts_prev = { 0 };
+	int64_t delta, jitter_max;
 	long total;
 	int len;
 	uint32_t seq;
@@ -674,15 +815,20 @@ static void recv_mode(int fd, int sk, char *peer)
 			syslog(LOG_INFO, "Initial bytes %d", len);
 	}
 
+	if (tstamp)
+		tstamp_enable(sk, SOF_TIMESTAMPING_SOFTWARE |
+					SOF_TIMESTAMPING_RX_SOFTWARE);
+
 	syslog(LOG_INFO, "Receiving ...");
 
 	for (seq = 0; ; seq++) {
 		gettimeofday(&tv_beg, NULL);
 		total = 0;
+		jitter_max = 0;
 		while (total < data_size) {
 			int r;
 
-			r = recv(sk, buf, data_size, 0);
+			r = recv_sdu(sk, buf, data_size, tstamp ? &ts : NULL);
 			if (r < 0) {
 				if (r < 0)
 					syslog(LOG_ERR, "Read failed: %s (%d)",
@@ -693,6 +839,20 @@ static void recv_mode(int fd, int sk, char *peer)
 				r = 0;
 			}
 
+			/* Track the largest gap between kernel receive
+			 * timestamps, which is unaffected by how late this
+			 * process got scheduled.
+			 */
+			if (tstamp && r > 0 && ts.tv_sec) {
+				if (ts_prev.tv_sec) {
+					delta = ts_diff_us(&ts, &ts_prev);
+					if (delta > jitter_max)
+						jitter_max = delta;
+				}
+
+				ts_prev = ts;
+			}
+
 			if (fd >= 0) {
 				r = write(fd, buf, r);
 				if (r < 0) {
@@ -713,6 +873,10 @@ static void recv_mode(int fd, int sk, char *peer)
 				"[seq %d] %ld bytes in %.2f sec speed %.2f "
 				"kb/s", seq, total, tv2fl(tv_diff),
 				(float)(total * 8 / tv2fl(tv_diff)) / 1024.0);
+
+		if (!quiet && tstamp)
+			syslog(LOG_INFO, "[seq %d] max SDU gap %" PRId64 " us",
+							seq, jitter_max);
 	}
 }
 
@@ -810,45 +974,39 @@ static int read_file(int fd, ssize_t count, bool rewind)
 	return len;
 }
 
-static void do_send(int sk, int fd, char *peer, bool repeat)
+static struct bt_iso_io_qos *send_setup(int sk, char *peer,
+					struct bt_iso_qos *qos, uint32_t *num)
 {
-	uint32_t seq;
-	struct timespec t_start;
-	int send_len, used;
-	socklen_t len;
-	struct bt_iso_qos qos;
-	uint32_t num;
 	struct bt_iso_io_qos *out;
-
-	syslog(LOG_INFO, "Sending ...");
+	socklen_t len;
 
 	/* Read QoS */
 	if (!strcmp(peer, "00:00:00:00:00:00"))
-		out = &qos.bcast.out;
+		out = &qos->bcast.out;
 	else
-		out = &qos.ucast.out;
+		out = &qos->ucast.out;
 
-	memset(&qos, 0, sizeof(qos));
-	len = sizeof(qos);
-	if (getsockopt(sk, SOL_BLUETOOTH, BT_ISO_QOS, &qos, &len) < 0) {
+	memset(qos, 0, sizeof(*qos));
+	len = sizeof(*qos);
+	if (getsockopt(sk, SOL_BLUETOOTH, BT_ISO_QOS, qos, &len) < 0) {
 		syslog(LOG_ERR, "Can't get Output QoS socket option: %s (%d)",
 				strerror(errno), errno);
 		out->sdu = ISO_DEFAULT_MTU;
 	}
 
 	/* num of packets = latency (ms) / interval (us) */
-	num = ROUND_CLOSEST(out->latency * 1000, out->interval);
-	if (!num)
-		num = 1;
+	*num = ROUND_CLOSEST(out->latency * 1000, out->interval);
+	if (!*num)
+		*num = 1;
 
-	syslog(LOG_INFO, "Number of packets: %d", num);
+	syslog(LOG_INFO, "Number of packets: %d", *num);
 
 	if (!sndbuf)
 		/* Use socket buffer as a jitter buffer for the entire buffer
 		 * latency:
 		 * jitter buffer = 2 * (SDU * subevents)
 		 */
-		sndbuf = 2 * (num * out->sdu);
+		sndbuf = 2 * (*num * out->sdu);
 
 	len = sizeof(sndbuf);
 	if (setsockopt(sk, SOL_SOCKET, SO_SNDBUF, &sndbuf, len) < 0) {
@@ -872,29 +1030,93 @@ static void do_send(int sk, int fd, char *peer, bool repeat)
 	for (int i = 6; i < out->sdu; i++)
 		buf[i] = 0x7f;
 
+	if (tstamp)
+		tstamp_enable(sk, SOF_TIMESTAMPING_SOFTWARE |
+					SOF_TIMESTAMPING_TX_SOFTWARE |
+					SOF_TIMESTAMPING_OPT_ID |
+					SOF_TIMESTAMPING_OPT_TSONLY);
+
+	return out;
+}
+
+static int next_sdu(int fd, uint16_t sdu, bool repeat, size_t *map_off,
+						const uint8_t **data)
+{
+	int len;
+
+	*data = buf;
+
+	if (map_data) {
+		if (*map_off >= map_size) {
+			if (!repeat)
+				return 0;
+
+			*map_off = 0;
+		}
+
+		*data = map_data + *map_off;
+		len = sdu;
+		if ((size_t) len > map_size - *map_off)
+			len = map_size - *map_off;
+		*map_off += len;
+
+		return len;
+	}
+
+	if (fd >= 0)
+		return read_file(fd, sdu, repeat);
+
+	return sdu;
+}
+
+static void do_send(int sk, int fd, char *peer, bool repeat)
+{
+	uint32_t seq;
+	struct timespec t_start;
+	struct timespec tx_sent[TX_TSTAMP_MAX];
+	const uint8_t *data;
+	size_t map_off = 0;
+	int send_len, used;
+	struct bt_iso_qos qos;
+	uint32_t num;
+	struct bt_iso_io_qos *out;
+
+	syslog(LOG_INFO, "Sending ...");
+
+	out = send_setup(sk, peer, &qos, &num);
+
 	if (clock_gettime(CLOCK_MONOTONIC, &t_start) < 0) {
 		perror("clock_gettime");
 		exit(EXIT_FAILURE);
 	}
 
 	for (seq = 0; ; seq++) {
-		if (fd >= 0) {
-			send_len = read_file(fd, out->sdu, repeat);
-			if (send_len < 0) {
-				syslog(LOG_ERR, "read failed: %s (%d)",
-						strerror(-send_len), -send_len);
-				exit(1);
-			}
-		} else
-			send_len = out->sdu;
+		send_len = next_sdu(fd, out->sdu, repeat, &map_off, &data);
+		if (send_len < 0) {
+			syslog(LOG_ERR, "read failed: %s (%d)",
+					strerror(-send_len), -send_len);
+			exit(1);
+		}
+
+		if (!send_len && map_data) {
+			syslog(LOG_INFO, "End of file");
+			return;
+		}
 
-		send_len = send(sk, buf, send_len, 0);
+		if (tstamp)
+			clock_gettime(CLOCK_REALTIME,
+					&tx_sent[seq % TX_TSTAMP_MAX]);
+
+		send_len = send(sk, data, send_len, 0);
 		if (send_len <= 0) {
 			syslog(LOG_ERR, "send failed: %s (%d)",
 						strerror(errno), errno);
 			exit(1);
 		}
 
+		if (tstamp)
+			tx_tstamp_drain(sk, tx_sent);
+
 		ioctl(sk, TIOCOUTQ, &used);
 
 		if (!quiet)
@@ -907,6 +1129,138 @@ static void do_send(int sk, int fd, char *peer, bool repeat)
 	}
 }
 
+struct bis_stats {
+	uint32_t sent;
+	uint32_t late;
+	uint32_t dropped;
+	int64_t jitter_max;
+};
+
+static void ts_add_us(struct timespec *ts, uint32_t us)
+{
+	ts->tv_nsec += (long) us * 1000L;
+	while (ts->tv_nsec >= 1000000000L) {
+		ts->tv_nsec -= 1000000000L;
+		ts->tv_sec++;
+	}
+}
+
+static void bis_report(struct bis_stats *stats, uint8_t count, uint32_t seq)
+{
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		syslog(LOG_INFO, "[seq %u] BIS %u: %u sent %u late %u dropped "
+				"max jitter %" PRId64 " us", seq, i + 1,
+				stats[i].sent, stats[i].late, stats[i].dropped,
+				stats[i].jitter_max);
+		stats[i].jitter_max = 0;
+	}
+}
+
+/* Send one SDU to every BIS of the BIG from a single paced loop, so the
+ * BISes are fed in lock step instead of by independent processes.
+ */
+static void do_send_sync(int *sk_arr, uint8_t count, int fd, char *peer,
+								bool repeat)
+{
+	struct bt_iso_qos qos;
+	struct bt_iso_io_qos *out = NULL;
+	struct bis_stats *stats;
+	struct timespec deadline, t_now;
+	struct timespec tx_sent[TX_TSTAMP_MAX];
+	const uint8_t *data;
+	size_t map_off = 0;
+	uint32_t num = 1, seq, report;
+	int send_len;
+	uint8_t i;
+
+	syslog(LOG_INFO, "Sending to %u BISes ...", count);
+
+	for (i = 0; i < count; i++)
+		out = send_setup(sk_arr[i], peer, &qos, &num);
+
+	stats = calloc(count, sizeof(*stats));
+	if (!stats) {
+		syslog(LOG_ERR, "Can't allocate BIS statistics");
+		exit(1);
+	}
+
+	/* Report roughly once per second */
+	report = out->interval ? 1000000 / out->interval : 1;
+	if (!report)
+		report = 1;
+
+	for (seq = 0; ; seq++) {
+		send_len = next_sdu(fd, out->sdu, repeat, &map_off, &data);
+		if (send_len < 0) {
+			syslog(LOG_ERR, "read failed: %s (%d)",
+					strerror(-send_len), -send_len);
+			exit(1);
+		}
+
+		if (!send_len) {
+			syslog(LOG_INFO, "End of file");
+			break;
+		}
+
+		/* The first num SDUs fill the jitter buffer, after that one
+		 * SDU per BIS is due every SDU interval on an absolute
+		 * schedule so oversleeping does not accumulate drift.
+		 */
+		if (seq < num) {
+			if (clock_gettime(CLOCK_MONOTONIC, &deadline) < 0) {
+				perror("clock_gettime");
+				exit(EXIT_FAILURE);
+			}
+		} else {
+			ts_add_us(&deadline, out->interval);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+						&deadline, NULL) == EINTR)
+				;
+		}
+
+		if (tstamp)
+			clock_gettime(CLOCK_REALTIME,
+					&tx_sent[seq % TX_TSTAMP_MAX]);
+
+		for (i = 0; i < count; i++) {
+			int64_t delta;
+
+			if (send(sk_arr[i], data, send_len, MSG_DONTWAIT) < 0) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK) {
+					syslog(LOG_ERR, "send failed: %s (%d)",
+							strerror(errno), errno);
+					exit(1);
+				}
+
+				stats[i].dropped++;
+				continue;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &t_now);
+
+			delta = ts_diff_us(&t_now, &deadline);
+			if (delta > stats[i].jitter_max)
+				stats[i].jitter_max = delta;
+
+			if (delta > out->interval)
+				stats[i].late++;
+
+			stats[i].sent++;
+
+			if (tstamp)
+				tx_tstamp_drain(sk_arr[i], tx_sent);
+		}
+
+		if (!quiet && !((seq + 1) % report))
+			bis_report(stats, count, seq);
+	}
+
+	bis_report(stats, count, seq);
+	free(stats);
+}
+
 static void send_mode(char *filename, char *peer, int i, bool repeat)
 {
 	int sk, fd = -1;
@@ -928,6 +1282,9 @@ static void send_mode(char *filename, char *peer, int i, bool repeat)
 
 		if (fd < 0)
 			fd = open_file(filename);
+
+		if (fd >= 0 && zerocopy)
+			map_file(fd);
 	}
 
 	if (nconn > 1) {
@@ -935,6 +1292,11 @@ static void send_mode(char *filename, char *peer, int i, bool repeat)
 		if (!sk_arr)
 			exit(1);
 
+		if (sync_send) {
+			do_send_sync(sk_arr, nconn, fd, peer, repeat);
+			goto done;
+		}
+
 		for (int i = 0; i < nconn; i++) {
 			if (fork()) {
 				/* Parent */
@@ -950,6 +1312,7 @@ static void send_mode(char *filename, char *peer, int i, bool repeat)
 		while (wait(NULL) > 0)
 			;
 
+done:
 		for (int i = 0; i < nconn; i++)
 			close(sk_arr[i]);
 
@@ -1131,6 +1494,9 @@ static void usage(void)
 		"\t[-j, --jitter <bytes>    socket/jitter buffer]\n"
 		"\t[-h, --help]\n"
 		"\t[-q, --quiet             disable packet logging]\n"
+		"\t[-Z, --zerocopy          send from a mapped input file]\n"
+		"\t[-K, --timestamp         report kernel SDU timestamps]\n"
+		"\t[-A, --sync              pace all BISes from one loop]\n"
 		"\t[-t, --timeout <usec>    send timeout]\n"
 		"\t[-C, --continue]\n"
 		"\t[-W, --defer <seconds>]  enable deferred setup\n"
@@ -1161,6 +1527,9 @@ static const struct option main_options[] = {
 	{ "jitter",    required_argument, NULL, 'j'},
 	{ "help",      no_argument,       NULL, 'h'},
 	{ "quiet",     no_argument,       NULL, 'q'},
+	{ "zerocopy",  no_argument,       NULL, 'Z'},
+	{ "timestamp", no_argument,       NULL, 'K'},
+	{ "sync",      no_argument,       NULL, 'A'},
 	{ "timeout",   required_argument, NULL, 't'},
 	{ "continue",  no_argument,       NULL, 'C'},
 	{ "defer",     required_argument, NULL, 'W'},
@@ -1218,7 +1587,7 @@ int main(int argc, char *argv[])
 		int opt;
 
 		opt = getopt_long(argc, argv,
-			"d::cmr::s::nb:i:j:hqt:CV:W:M:S:P:F:I:L:Y:R:B:G:T:e:k:N:",
+			"d::cmr::s::nb:i:j:hqZKAt:CV:W:M:S:P:F:I:L:Y:R:B:G:T:e:k:N:",
 			main_options, NULL);
 		if (opt < 0)
 			break;
@@ -1279,6 +1648,18 @@ int main(int argc, char *argv[])
 			quiet = true;
 			break;
 
+		case 'Z':
+			zerocopy = true;
+			break;
+
+		case 'K':
+			tstamp = true;
+			break;
+
+		case 'A':
+			sync_send = true;
+			break;
+
 		case 't':
 			if (optarg)
 				sndto.tv_usec = atoi(optarg);
@@ -17,6 +17,7 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <ctype.h>
 #include <fcntl.h>
@@ -26,6 +27,7 @@
 #include <syslog.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <time.h>
 #include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -63,6 +65,28 @@ enum {
 	CSENDRECV,
 	INFOREQ,
 	PAIRING,
+	THROUGHPUT,
+	LECHO,
+};
+
+/* Throughput SDU header: seq (4), len (2), echo timestamp (8) */
+#define TP_HDR_SIZE	14
+#define TP_ECHO_INTERVAL	100000000ULL
+
+struct tp_chan {
+	int sk;
+	uint32_t seq;
+	uint64_t bytes;
+	uint64_t next_send;
+	uint64_t next_echo;
+	bool stalled;
+	uint64_t stall_start;
+	uint64_t stall_time;
+	unsigned int stalls;
+	uint64_t rtt_min;
+	uint64_t rtt_max;
+	uint64_t rtt_sum;
+	unsigned int rtt_count;
 };
 
 static unsigned char *buf;
@@ -124,6 +148,11 @@ static int rcvbuf = 0;
 static int chan_policy = -1;
 static int bdaddr_type = 0;
 
+/* Throughput mode */
+static int num_chans = 1;
+static unsigned long pace_rate = 0;
+static int tp_duration = 10;
+
 struct lookup_table {
 	const char *name;
 	int flag;
@@ -1061,6 +1090,258 @@ static void send_and_recv_mode(int sk)
 	return;
 }
 
+static uint64_t get_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void echo_mode(int sk)
+{
+	int len;
+
+	syslog(LOG_INFO, "Echoing ...");
+
+	while (1) {
+		len = recv(sk, buf, buffer_size, 0);
+		if (len <= 0) {
+			if (len < 0)
+				syslog(LOG_ERR, "Read failed: %s (%d)",
+							strerror(errno), errno);
+			return;
+		}
+
+		/* Only SDUs carrying a timestamp are echoed */
+		if (len < TP_HDR_SIZE || !get_le64(buf + 6))
+			continue;
+
+		if (send(sk, buf, TP_HDR_SIZE, 0) < 0) {
+			syslog(LOG_ERR, "Echo failed: %s (%d)",
+							strerror(errno), errno);
+			return;
+		}
+	}
+}
+
+static bool tp_send(struct tp_chan *chan, uint64_t now)
+{
+	bool echo = now >= chan->next_echo;
+
+	put_le32(chan->seq, buf);
+	put_le16(data_size, buf + 4);
+	put_le64(echo ? now : 0, buf + 6);
+
+	if (send(chan->sk, buf, data_size, MSG_DONTWAIT) < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			syslog(LOG_ERR, "Send failed: %s (%d)",
+							strerror(errno), errno);
+			exit(1);
+		}
+
+		/* Out of credits or transmit window */
+		chan->stalled = true;
+		chan->stall_start = now;
+		chan->stalls++;
+
+		return false;
+	}
+
+	if (echo)
+		chan->next_echo = now + TP_ECHO_INTERVAL;
+
+	chan->seq++;
+	chan->bytes += data_size;
+
+	return true;
+}
+
+static void tp_recv(struct tp_chan *chan, uint64_t now)
+{
+	uint8_t echo[TP_HDR_SIZE];
+	uint64_t rtt;
+	int len;
+
+	len = recv(chan->sk, echo, sizeof(echo), MSG_DONTWAIT);
+	if (len < TP_HDR_SIZE)
+		return;
+
+	rtt = now - get_le64(echo + 6);
+
+	if (!chan->rtt_count || rtt < chan->rtt_min)
+		chan->rtt_min = rtt;
+
+	if (rtt > chan->rtt_max)
+		chan->rtt_max = rtt;
+
+	chan->rtt_sum += rtt;
+	chan->rtt_count++;
+}
+
+static void tp_report(const char *name, uint64_t bytes, uint64_t elapsed,
+				unsigned int stalls, uint64_t stall_time,
+				unsigned int rtt_count, uint64_t rtt_min,
+				uint64_t rtt_avg, uint64_t rtt_max)
+{
+	double secs = elapsed / 1e9;
+
+	syslog(LOG_INFO, "%s: %" PRIu64 " bytes in %.2f sec, %.2f kB/s, "
+			"%u stalls (%.2f ms)", name, bytes, secs,
+			bytes / secs / 1024.0, stalls, stall_time / 1e6);
+
+	if (rtt_count)
+		syslog(LOG_INFO, "%s: rtt min/avg/max %.2f/%.2f/%.2f ms "
+				"(%u samples)", name, rtt_min / 1e6,
+				rtt_avg / 1e6, rtt_max / 1e6, rtt_count);
+}
+
+static void throughput_mode(char *svr)
+{
+	struct tp_chan *chans;
+	struct pollfd *p;
+	uint64_t start, end, now, interval = 0, stall_time = 0, bytes = 0;
+	uint64_t rtt_min = 0, rtt_max = 0, rtt_sum = 0;
+	unsigned int stalls = 0, rtt_count = 0;
+	char name[16];
+	int i;
+
+	chans = calloc(num_chans, sizeof(*chans));
+	p = calloc(num_chans, sizeof(*p));
+	if (!chans || !p) {
+		syslog(LOG_ERR, "Can't allocate channels");
+		exit(1);
+	}
+
+	for (i = 0; i < num_chans; i++) {
+		chans[i].sk = do_connect(svr);
+		if (chans[i].sk < 0)
+			exit(1);
+	}
+
+	if (data_size < 0 || data_size > omtu)
+		data_size = omtu;
+
+	if (data_size < TP_HDR_SIZE) {
+		syslog(LOG_ERR, "SDU size must be at least %d bytes",
+								TP_HDR_SIZE);
+		exit(1);
+	}
+
+	memset(buf + TP_HDR_SIZE, 0x7f, data_size - TP_HDR_SIZE);
+
+	if (pace_rate)
+		interval = data_size * 1000000000ULL / (pace_rate * 1024);
+
+	syslog(LOG_INFO, "Sending %ld byte SDUs on %d channels for %d sec%s",
+				data_size, num_chans, tp_duration,
+				pace_rate ? " (paced)" : "");
+
+	start = get_ns();
+	end = start + tp_duration * 1000000000ULL;
+
+	for (i = 0; i < num_chans; i++)
+		chans[i].next_send = start;
+
+	while ((now = get_ns()) < end) {
+		int timeout = 100;
+
+		for (i = 0; i < num_chans; i++) {
+			struct tp_chan *chan = &chans[i];
+			int burst = 8;
+
+			while (!chan->stalled && chan->next_send <= now &&
+								burst--) {
+				if (!tp_send(chan, now))
+					break;
+
+				chan->next_send += interval;
+
+				/* Don't try to catch up after a long stall */
+				if (chan->next_send + 1000000000ULL < now)
+					chan->next_send = now;
+			}
+
+			if (!chan->stalled && chan->next_send > now) {
+				uint64_t ms = (chan->next_send - now) / 1000000;
+
+				if (ms < (uint64_t) timeout)
+					timeout = ms;
+			} else if (!chan->stalled)
+				timeout = 0;
+
+			p[i].fd = chan->sk;
+			p[i].events = POLLIN;
+			if (chan->stalled)
+				p[i].events |= POLLOUT;
+			p[i].revents = 0;
+		}
+
+		if (poll(p, num_chans, timeout) < 0 && errno != EINTR) {
+			syslog(LOG_ERR, "Poll failed: %s (%d)",
+							strerror(errno), errno);
+			exit(1);
+		}
+
+		now = get_ns();
+
+		for (i = 0; i < num_chans; i++) {
+			struct tp_chan *chan = &chans[i];
+
+			if (p[i].revents & (POLLERR | POLLHUP)) {
+				syslog(LOG_ERR, "Channel %d disconnected", i);
+				exit(1);
+			}
+
+			if (p[i].revents & POLLIN)
+				tp_recv(chan, now);
+
+			if (chan->stalled && (p[i].revents & POLLOUT)) {
+				chan->stalled = false;
+				chan->stall_time += now - chan->stall_start;
+			}
+		}
+	}
+
+	now = get_ns();
+
+	for (i = 0; i < num_chans; i++) {
+		struct tp_chan *chan = &chans[i];
+
+		if (chan->stalled)
+			chan->stall_time += now - chan->stall_start;
+
+		snprintf(name, sizeof(name), "Channel %d", i);
+		tp_report(name, chan->bytes, now - start, chan->stalls,
+				chan->stall_time, chan->rtt_count,
+				chan->rtt_min, chan->rtt_count ?
+				chan->rtt_sum / chan->rtt_count : 0,
+				chan->rtt_max);
+
+		bytes += chan->bytes;
+		stalls += chan->stalls;
+		stall_time += chan->stall_time;
+
+		if (chan->rtt_count && (!rtt_count || chan->rtt_min < rtt_min))
+			rtt_min = chan->rtt_min;
+
+		if (chan->rtt_max > rtt_max)
+			rtt_max = chan->rtt_max;
+
+		rtt_sum += chan->rtt_sum;
+		rtt_count += chan->rtt_count;
+
+		close(chan->sk);
+	}
+
+	tp_report("Total", bytes, now - start, stalls, stall_time, rtt_count,
+			rtt_min, rtt_count ? rtt_sum / rtt_count : 0, rtt_max);
+
+	free(p);
+	free(chans);
+}
+
 static void reconnect_mode(char *svr)
 {
 	while (1) {
@@ -1323,7 +1604,9 @@ static void usage(void)
 		"\t-c connect, disconnect, connect, ...\n"
 		"\t-m multiple connects\n"
 		"\t-p trigger dedicated bonding\n"
-		"\t-z information request\n");
+		"\t-z information request\n"
+		"\t-o connect, then run throughput test\n"
+		"\t-j listen and echo throughput test timestamps\n");
 
 	printf("Options:\n"
 		"\t[-b bytes] [-i device] [-P psm] [-J cid]\n"
@@ -1352,7 +1635,10 @@ static void usage(void)
 		"\t[-M] become central\n"
 		"\t[-T] enable timestamps\n"
 		"\t[-V type] address type (help for list, default = bredr)\n"
-		"\t[-e seq] initial sequence value (default = 0)\n");
+		"\t[-e seq] initial sequence value (default = 0)\n"
+		"\t[-k num] throughput test channels (default = 1)\n"
+		"\t[-l kB/s] pace each throughput test channel\n"
+		"\t[-f seconds] throughput test duration (default = 10)\n");
 }
 
 int main(int argc, char *argv[])
@@ -1362,7 +1648,7 @@ int main(int argc, char *argv[])
 
 	bacpy(&bdaddr, BDADDR_ANY);
 
-	while ((opt = getopt(argc, argv, "a:b:cde:g:i:mnpqrstuwxyz"
+	while ((opt = getopt(argc, argv, "a:b:cde:f:g:i:jk:l:mnopqrstuwxyz"
 		"AB:C:D:EF:GH:I:J:K:L:MN:O:P:Q:RSTUV:W:X:Y:Z:")) != EOF) {
 		switch (opt) {
 		case 'r':
@@ -1429,6 +1715,31 @@ int main(int argc, char *argv[])
 			need_addr = 1;
 			break;
 
+		case 'o':
+			mode = THROUGHPUT;
+			need_addr = 1;
+			break;
+
+		case 'j':
+			mode = LECHO;
+			break;
+
+		case 'k':
+			num_chans = atoi(optarg);
+			if (num_chans < 1) {
+				usage();
+				exit(1);
+			}
+			break;
+
+		case 'l':
+			pace_rate = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'f':
+			tp_duration = atoi(optarg);
+			break;
+
 		case 'b':
 			data_size = atoi(optarg);
 			break;
@@ -1681,6 +1992,14 @@ int main(int argc, char *argv[])
 		case PAIRING:
 			do_pairing(argv[optind]);
 			exit(0);
+
+		case THROUGHPUT:
+			throughput_mode(argv[optind]);
+			break;
+
+		case LECHO:
+			do_listen(echo_mode);
+			break;
 	}
 
 	syslog(LOG_INFO, "Exit");
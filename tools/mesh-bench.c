@@ -0,0 +1,518 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ell/ell.h>
+
+#include "mesh/mesh-defs.h"
+#include "mesh/util.h"
+#include "mesh/crypto.h"
+#include "mesh/mesh-io.h"
+#include "mesh/net.h"
+#include "mesh/net-keys.h"
+
+#define BENCH_IV_INDEX		0x12345678
+#define BENCH_TTL		0x07
+#define BENCH_MAX_LEN		96
+
+struct bench_subnet {
+	uint32_t net_key_id;
+	uint8_t app_key[16];
+	uint8_t key_aid;
+};
+
+struct bench_pdu {
+	uint8_t len;
+	uint8_t data[29];
+};
+
+struct bench_msg {
+	struct bench_subnet *subnet;
+	struct bench_pdu *pdus;
+	uint32_t seq;
+	uint16_t src;
+	uint16_t dst;
+	uint16_t len;
+	uint8_t seg_n;
+	bool segmented;
+};
+
+struct bench_result {
+	const char *name;
+	unsigned int count;
+	uint64_t elapsed;
+	uint64_t *lat;
+	unsigned long allocs;
+	unsigned int failed;
+};
+
+static unsigned int num_msgs = 10000;
+static unsigned int num_srcs = 64;
+static unsigned int num_subnets = 4;
+static unsigned int seg_pct = 25;
+
+static struct bench_subnet *subnets;
+static struct bench_msg *msgs;
+static unsigned int num_pdus;
+
+#ifdef __GLIBC__
+/* Count heap allocations made by the code under test */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static bool counting;
+static unsigned long allocs;
+
+void *malloc(size_t size)
+{
+	if (counting)
+		allocs++;
+
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	if (counting)
+		allocs++;
+
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if (counting)
+		allocs++;
+
+	return __libc_realloc(ptr, size);
+}
+#else
+static bool counting;
+static unsigned long allocs;
+#endif
+
+/* Beacons are never enabled, so there is no I/O or network to drive */
+bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	return true;
+}
+
+void net_local_beacon(uint32_t key_id, uint32_t ivi, bool ivu, bool kr)
+{
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t bench_rand(void)
+{
+	static uint32_t state = 0x2545f491;
+
+	/* xorshift32, so runs are reproducible */
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return state;
+}
+
+static void rand_bytes(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = bench_rand();
+}
+
+static bool setup_subnets(void)
+{
+	unsigned int i;
+
+	subnets = l_new(struct bench_subnet, num_subnets);
+
+	for (i = 0; i < num_subnets; i++) {
+		struct bench_subnet *subnet = &subnets[i];
+		uint8_t net_key[16];
+
+		rand_bytes(net_key, sizeof(net_key));
+		rand_bytes(subnet->app_key, sizeof(subnet->app_key));
+
+		subnet->net_key_id = net_key_add(net_key);
+		if (!subnet->net_key_id)
+			return false;
+
+		if (!mesh_crypto_k4(subnet->app_key, &subnet->key_aid))
+			return false;
+
+		subnet->key_aid |= KEY_ID_AKF;
+	}
+
+	return true;
+}
+
+static bool build_msg(struct bench_msg *msg, uint32_t *seqs)
+{
+	uint8_t payload[BENCH_MAX_LEN], enc[BENCH_MAX_LEN + 4];
+	unsigned int src_idx = bench_rand() % num_srcs;
+	uint16_t enc_len, seq_zero;
+	uint8_t i;
+
+	msg->subnet = &subnets[bench_rand() % num_subnets];
+	msg->src = 0x0100 + src_idx;
+
+	if (bench_rand() & 1)
+		msg->dst = 0x0001 + bench_rand() % 0x00ff;
+	else
+		msg->dst = 0xc000 + bench_rand() % 0x0100;
+
+	msg->segmented = bench_rand() % 100 < seg_pct;
+
+	if (msg->segmented)
+		msg->len = 12 + bench_rand() % (BENCH_MAX_LEN - 12);
+	else
+		msg->len = 1 + bench_rand() % 11;
+
+	rand_bytes(payload, msg->len);
+	enc_len = msg->len + 4;
+
+	msg->seg_n = msg->segmented ? (enc_len - 1) / 12 : 0;
+	msg->seq = seqs[src_idx];
+	seqs[src_idx] += msg->seg_n + 1;
+	seq_zero = msg->seq & SEQ_ZERO_MASK;
+
+	if (!mesh_crypto_payload_encrypt(NULL, payload, enc, msg->len,
+					msg->src, msg->dst,
+					msg->subnet->key_aid, msg->seq,
+					BENCH_IV_INDEX, false,
+					msg->subnet->app_key))
+		return false;
+
+	msg->pdus = l_new(struct bench_pdu, msg->seg_n + 1);
+
+	for (i = 0; i <= msg->seg_n; i++) {
+		struct bench_pdu *pdu = &msg->pdus[i];
+		uint8_t off = i * 12;
+		uint8_t seg_len;
+
+		if (msg->segmented)
+			seg_len = enc_len - off > 12 ? 12 : enc_len - off;
+		else
+			seg_len = enc_len;
+
+		if (!mesh_crypto_packet_build(false, BENCH_TTL, msg->seq + i,
+					msg->src, msg->dst, 0,
+					msg->segmented, msg->subnet->key_aid,
+					false, false, seq_zero, i, msg->seg_n,
+					enc + off, seg_len,
+					pdu->data, &pdu->len))
+			return false;
+
+		if (!net_key_encrypt(msg->subnet->net_key_id, BENCH_IV_INDEX,
+							pdu->data, pdu->len))
+			return false;
+	}
+
+	num_pdus += msg->seg_n + 1;
+
+	return true;
+}
+
+static bool setup_traffic(void)
+{
+	uint32_t *seqs = l_new(uint32_t, num_srcs);
+	unsigned int i;
+	bool result = true;
+
+	for (i = 0; i < num_srcs; i++)
+		seqs[i] = bench_rand() & 0xffff;
+
+	msgs = l_new(struct bench_msg, num_msgs);
+
+	for (i = 0; i < num_msgs && result; i++)
+		result = build_msg(&msgs[i], seqs);
+
+	l_free(seqs);
+
+	return result;
+}
+
+static void result_start(struct bench_result *res, const char *name,
+							unsigned int count)
+{
+	memset(res, 0, sizeof(*res));
+	res->name = name;
+	res->lat = l_new(uint64_t, count);
+
+	allocs = 0;
+	counting = true;
+}
+
+static void result_stop(struct bench_result *res)
+{
+	counting = false;
+	res->allocs = allocs;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	const uint64_t *x = a, *y = b;
+
+	return (*x > *y) - (*x < *y);
+}
+
+static void result_print(struct bench_result *res)
+{
+	double secs = res->elapsed / 1e9;
+	uint64_t p50 = 0, p99 = 0;
+
+	if (res->count) {
+		qsort(res->lat, res->count, sizeof(uint64_t), cmp_u64);
+		p50 = res->lat[res->count / 2];
+		p99 = res->lat[(res->count * 99) / 100];
+	}
+
+	printf("%-10s %8u %12.0f/s %9.2f us %9.2f us %9.2f us %8.2f %6u\n",
+			res->name, res->count,
+			secs > 0 ? res->count / secs : 0.0,
+			res->count ? res->elapsed / 1e3 / res->count : 0.0,
+			p50 / 1e3, p99 / 1e3,
+			res->count ? (double) res->allocs / res->count : 0.0,
+			res->failed);
+
+	l_free(res->lat);
+}
+
+/* Network layer receive: NID lookup, deobfuscation, NetMIC and parse */
+static void bench_rx(struct bench_result *res)
+{
+	unsigned int i, j;
+
+	result_start(res, "rx", num_pdus);
+
+	for (i = 0; i < num_msgs; i++) {
+		for (j = 0; j <= msgs[i].seg_n; j++) {
+			struct bench_pdu *pdu = &msgs[i].pdus[j];
+			uint64_t start = now_ns();
+			uint8_t *out;
+			size_t out_len;
+			uint16_t src, dst;
+			uint32_t seq;
+			bool ctl;
+			uint8_t ttl;
+
+			if (!net_key_decrypt(BENCH_IV_INDEX, pdu->data,
+						pdu->len, &out, &out_len) ||
+				!mesh_crypto_packet_parse(out, out_len, &ctl,
+						&ttl, &seq, &src, &dst, NULL,
+						NULL, NULL, NULL, NULL, NULL,
+						NULL, NULL, NULL, NULL, NULL))
+				res->failed++;
+
+			res->lat[res->count] = now_ns() - start;
+			res->elapsed += res->lat[res->count++];
+		}
+	}
+
+	result_stop(res);
+}
+
+/* Relay: receive, decrement TTL, re-encrypt and re-obfuscate */
+static void bench_relay(struct bench_result *res)
+{
+	unsigned int i, j;
+
+	result_start(res, "relay", num_pdus);
+
+	for (i = 0; i < num_msgs; i++) {
+		for (j = 0; j <= msgs[i].seg_n; j++) {
+			struct bench_pdu *pdu = &msgs[i].pdus[j];
+			uint64_t start = now_ns();
+			uint8_t relay[29];
+			uint32_t id;
+			uint8_t *out;
+			size_t out_len;
+
+			id = net_key_decrypt(BENCH_IV_INDEX, pdu->data,
+						pdu->len, &out, &out_len);
+			if (!id) {
+				res->failed++;
+				continue;
+			}
+
+			memcpy(relay, out, out_len);
+			relay[1] = (relay[1] & ~TTL_MASK) |
+						((relay[1] & TTL_MASK) - 1);
+
+			if (!net_key_encrypt(id, BENCH_IV_INDEX, relay,
+								pdu->len))
+				res->failed++;
+
+			res->lat[res->count] = now_ns() - start;
+			res->elapsed += res->lat[res->count++];
+		}
+	}
+
+	result_stop(res);
+}
+
+/* Transport: reassemble segments and decrypt the Access payload */
+static void bench_transport(struct bench_result *res)
+{
+	unsigned int i, j;
+
+	result_start(res, "transport", num_msgs);
+
+	for (i = 0; i < num_msgs; i++) {
+		struct bench_msg *msg = &msgs[i];
+		uint8_t sar[BENCH_MAX_LEN + 4], plain[BENCH_MAX_LEN + 4];
+		uint64_t start = now_ns();
+		uint16_t sar_len = 0;
+
+		for (j = 0; j <= msg->seg_n; j++) {
+			const uint8_t *payload;
+			uint8_t payload_len, seg_o = 0;
+			uint8_t *out;
+			size_t out_len;
+
+			if (!net_key_decrypt(BENCH_IV_INDEX, msg->pdus[j].data,
+						msg->pdus[j].len, &out,
+						&out_len) ||
+				!mesh_crypto_packet_parse(out, out_len, NULL,
+						NULL, NULL, NULL, NULL, NULL,
+						NULL, NULL, NULL, NULL, NULL,
+						NULL, &seg_o, NULL, &payload,
+						&payload_len))
+				break;
+
+			memcpy(sar + seg_o * 12, payload, payload_len);
+			sar_len += payload_len;
+		}
+
+		if (j <= msg->seg_n ||
+			!mesh_crypto_payload_decrypt(NULL, 0, sar, sar_len,
+					false, msg->src, msg->dst,
+					msg->subnet->key_aid, msg->seq,
+					BENCH_IV_INDEX, plain,
+					msg->subnet->app_key))
+			res->failed++;
+
+		res->lat[res->count] = now_ns() - start;
+		res->elapsed += res->lat[res->count++];
+	}
+
+	result_stop(res);
+}
+
+static void usage(void)
+{
+	printf("mesh-bench - Mesh network PDU processing benchmark\n"
+		"Usage:\n");
+	printf("\tmesh-bench [options]\n");
+	printf("options:\n"
+		"\t-n, --messages <count>   Access messages (default 10000)\n"
+		"\t-s, --sources <count>    Source addresses (default 64)\n"
+		"\t-k, --subnets <count>    Network keys (default 4)\n"
+		"\t-g, --segmented <pct>    Segmented messages (default 25)\n"
+		"\t-h, --help               Show help options\n");
+}
+
+static const struct option main_options[] = {
+	{ "messages",	required_argument,	NULL, 'n' },
+	{ "sources",	required_argument,	NULL, 's' },
+	{ "subnets",	required_argument,	NULL, 'k' },
+	{ "segmented",	required_argument,	NULL, 'g' },
+	{ "help",	no_argument,		NULL, 'h' },
+	{ }
+};
+
+int main(int argc, char *argv[])
+{
+	struct bench_result res;
+	unsigned int i;
+
+	for (;;) {
+		int opt;
+
+		opt = getopt_long(argc, argv, "n:s:k:g:h", main_options, NULL);
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'n':
+			num_msgs = atoi(optarg);
+			break;
+		case 's':
+			num_srcs = atoi(optarg);
+			break;
+		case 'k':
+			num_subnets = atoi(optarg);
+			break;
+		case 'g':
+			seg_pct = atoi(optarg);
+			break;
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!num_msgs || !num_srcs || !num_subnets || seg_pct > 100) {
+		fprintf(stderr, "Invalid command line parameters\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!setup_subnets() || !setup_traffic()) {
+		fprintf(stderr, "Failed to generate traffic\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%u messages, %u PDUs, %u sources, %u subnets, %u%% segmented\n",
+				num_msgs, num_pdus, num_srcs, num_subnets,
+				seg_pct);
+	printf("%-10s %8s %14s %12s %12s %12s %8s %6s\n", "phase", "count",
+			"rate", "avg", "p50", "p99", "allocs", "failed");
+
+	bench_rx(&res);
+	result_print(&res);
+
+	bench_relay(&res);
+	result_print(&res);
+
+	bench_transport(&res);
+	result_print(&res);
+
+	for (i = 0; i < num_msgs; i++)
+		l_free(msgs[i].pdus);
+
+	l_free(msgs);
+	l_free(subnets);
+	net_key_cleanup();
+
+	return EXIT_SUCCESS;
+}
@@ -40,18 +40,41 @@
 /* Default timeout for getting a response to a sent config command (seconds) */
 #define DEFAULT_TIMEOUT 2
 
+/* Outstanding requests and attempts per request of the "apply" command */
+#define APPLY_PARALLEL	8
+#define APPLY_ATTEMPTS	3
+
 struct cfg_cmd {
 	uint32_t opcode;
 	uint32_t rsp;
 	const char *desc;
 };
 
+struct cfg_job {
+	uint16_t dst;
+	uint32_t opcode;
+	uint8_t msg[32];
+	uint16_t len;
+	uint16_t key_idx;
+	uint8_t attempts;
+};
+
 struct pending_req {
 	struct l_timeout *timer;
 	const struct cfg_cmd *cmd;
 	uint16_t addr;
+	struct cfg_job *job;
 };
 
+static struct {
+	struct l_queue *jobs;
+	struct l_queue *active;
+	unsigned int max;
+	unsigned int total;
+	unsigned int done;
+	unsigned int failed;
+} apply;
+
 static struct l_queue *requests;
 static struct l_queue *groups;
 
@@ -220,9 +243,12 @@ static struct pending_req *get_req_by_rsp(uint16_t addr, uint32_t rsp)
 	return NULL;
 }
 
+static void apply_timeout(struct cfg_job *job);
+
 static void wait_rsp_timeout(struct l_timeout *timeout, void *user_data)
 {
 	struct pending_req *req = user_data;
+	struct cfg_job *job = req->job;
 
 	bt_shell_printf("No response for \"%s\" from %4.4x\n",
 						req->cmd->desc, req->addr);
@@ -233,6 +259,9 @@ static void wait_rsp_timeout(struct l_timeout *timeout, void *user_data)
 
 	l_queue_remove(requests, req);
 	free_request(req);
+
+	if (job)
+		apply_timeout(job);
 }
 
 static void add_request(uint32_t opcode)
@@ -412,6 +441,8 @@ static bool match_group_addr(const void *a, const void *b)
 	return grp->addr == addr;
 }
 
+static void apply_done(struct cfg_job *job, bool success);
+
 static bool msg_recvd(uint16_t src, uint16_t idx, uint8_t *data,
 							uint16_t len)
 {
@@ -435,9 +466,14 @@ static bool msg_recvd(uint16_t src, uint16_t idx, uint8_t *data,
 
 	req = get_req_by_rsp(src, opcode);
 	if (req) {
+		struct cfg_job *job = req->job;
+
 		cmd = req->cmd;
 		l_queue_remove(requests, req);
 		free_request(req);
+
+		if (job)
+			apply_done(job, len && data[0] == MESH_STATUS_SUCCESS);
 	} else
 		cmd = NULL;
 
@@ -2079,6 +2115,255 @@ static bool tx_setup(model_send_msg_func_t send_func, void *user_data)
 	return true;
 }
 
+static bool match_job_dst(const void *a, const void *b)
+{
+	const struct cfg_job *job = a;
+
+	return job->dst == L_PTR_TO_UINT(b);
+}
+
+static bool apply_send(struct cfg_job *job)
+{
+	const struct cfg_cmd *cmd = get_cmd(job->opcode);
+	struct pending_req *req;
+	uint16_t saved = target;
+	bool res;
+
+	if (!cmd)
+		return false;
+
+	target = job->dst;
+
+	if (!job->len) {
+		res = send_key_msg(key_data, target, job->key_idx, true, false);
+		if (res)
+			add_request(job->opcode);
+	} else
+		res = config_send(job->msg, job->len, job->opcode);
+
+	target = saved;
+
+	req = res ? get_req_by_rsp(job->dst, cmd->rsp) : NULL;
+	if (!req)
+		return false;
+
+	req->job = job;
+
+	return true;
+}
+
+static void apply_next(void)
+{
+	const struct l_queue_entry *entry;
+
+	entry = l_queue_get_entries(apply.jobs);
+
+	/* Keep at most one request in flight per node */
+	while (entry && l_queue_length(apply.active) < apply.max) {
+		struct cfg_job *job = entry->data;
+
+		entry = entry->next;
+
+		if (l_queue_find(apply.active, match_job_dst,
+						L_UINT_TO_PTR(job->dst)))
+			continue;
+
+		l_queue_remove(apply.jobs, job);
+		job->attempts++;
+
+		if (!apply_send(job)) {
+			apply.failed++;
+			l_free(job);
+			continue;
+		}
+
+		l_queue_push_tail(apply.active, job);
+	}
+
+	if (!l_queue_isempty(apply.active) || !l_queue_isempty(apply.jobs))
+		return;
+
+	bt_shell_printf("Apply complete: %u of %u succeeded, %u failed\n",
+					apply.done, apply.total, apply.failed);
+
+	l_queue_destroy(apply.jobs, NULL);
+	l_queue_destroy(apply.active, NULL);
+	memset(&apply, 0, sizeof(apply));
+}
+
+static void apply_progress(void)
+{
+	bt_shell_printf("Apply: %u/%u done, %u failed\n",
+				apply.done + apply.failed, apply.total,
+				apply.failed);
+}
+
+static void apply_done(struct cfg_job *job, bool success)
+{
+	l_queue_remove(apply.active, job);
+
+	if (success)
+		apply.done++;
+	else
+		apply.failed++;
+
+	l_free(job);
+
+	apply_progress();
+	apply_next();
+}
+
+static void apply_timeout(struct cfg_job *job)
+{
+	l_queue_remove(apply.active, job);
+
+	if (job->attempts < APPLY_ATTEMPTS) {
+		/* Retry before any other request to the same node */
+		l_queue_push_head(apply.jobs, job);
+	} else {
+		apply.failed++;
+		l_free(job);
+		apply_progress();
+	}
+
+	apply_next();
+}
+
+static struct cfg_job *apply_parse(char **argv, uint32_t cnt)
+{
+	struct cfg_job *job;
+	uint16_t n;
+
+	job = l_new(struct cfg_job, 1);
+
+	if (!strcmp(argv[0], "appkey") && cnt == 1) {
+		job->opcode = OP_APPKEY_ADD;
+		job->key_idx = parms[0];
+		return job;
+	}
+
+	if (!strcmp(argv[0], "bind") && (cnt == 3 || cnt == 4)) {
+		job->opcode = OP_MODEL_APP_BIND;
+		n = mesh_opcode_set(job->opcode, job->msg);
+		put_le16(parms[0], job->msg + n);
+		n += 2;
+		put_le16(parms[1], job->msg + n);
+		n += 2;
+		n += put_model_id(job->msg + n, &parms[2], cnt == 4);
+		job->len = n;
+		return job;
+	}
+
+	if (!strcmp(argv[0], "sub") && (cnt == 3 || cnt == 4) &&
+				IS_GROUP(parms[1]) && !IS_ALL_NODES(parms[1])) {
+		job->opcode = OP_CONFIG_MODEL_SUB_ADD;
+		n = mesh_opcode_set(job->opcode, job->msg);
+		put_le16(parms[0], job->msg + n);
+		n += 2;
+		put_le16(parms[1], job->msg + n);
+		n += 2;
+		n += put_model_id(job->msg + n, &parms[2], cnt == 4);
+		job->len = n;
+		return job;
+	}
+
+	if (!strcmp(argv[0], "pub") && (cnt == 6 || cnt == 7) &&
+				!IS_VIRTUAL(parms[1]) &&
+				parms[1] <= ALL_NODES_ADDRESS) {
+		job->opcode = OP_CONFIG_MODEL_PUB_SET;
+		n = mesh_opcode_set(job->opcode, job->msg);
+		put_le16(parms[0], job->msg + n);
+		n += 2;
+		put_le16(parms[1], job->msg + n);
+		n += 2;
+		put_le16(parms[2], job->msg + n);
+		n += 2;
+		job->msg[n++] = DEFAULT_TTL;
+		job->msg[n++] = parms[3];
+		job->msg[n++] = parms[4];
+		n += put_model_id(job->msg + n, &parms[5], cnt == 7);
+		job->len = n;
+		return job;
+	}
+
+	l_free(job);
+
+	return NULL;
+}
+
+static void cmd_apply(int argc, char *argv[])
+{
+	unsigned int line_num = 0;
+	char *line = NULL;
+	size_t len = 0;
+	FILE *f;
+
+	if (apply.jobs) {
+		bt_shell_printf("Another configuration is being applied\n");
+		return bt_shell_noninteractive_quit(EXIT_FAILURE);
+	}
+
+	f = fopen(argv[1], "r");
+	if (!f) {
+		bt_shell_printf("Unable to open %s\n", argv[1]);
+		return bt_shell_noninteractive_quit(EXIT_FAILURE);
+	}
+
+	apply.max = argc > 2 ? atoi(argv[2]) : APPLY_PARALLEL;
+	if (!apply.max)
+		apply.max = 1;
+
+	apply.jobs = l_queue_new();
+	apply.active = l_queue_new();
+
+	/* Each line is "<unicast> <appkey|bind|sub|pub> <parameters>" with
+	 * parameters given as for the corresponding config command.
+	 */
+	while (getline(&line, &len, f) > 0) {
+		struct cfg_job *job = NULL;
+		char **str;
+		uint32_t cnt;
+		unsigned int dst = 0;
+
+		line_num++;
+		str = l_strsplit_set(l_strstrip(line), " \t");
+
+		if (!str[0] || str[0][0] == '#' || str[0][0] == '\0') {
+			l_strfreev(str);
+			continue;
+		}
+
+		if (str[1] && sscanf(str[0], "%x", &dst) == 1 &&
+							IS_UNICAST(dst)) {
+			cnt = read_input_parameters(l_strv_length(str) - 1,
+								str + 1);
+			job = apply_parse(str + 1, cnt);
+		}
+
+		l_strfreev(str);
+
+		if (!job) {
+			bt_shell_printf("%s:%u: invalid entry\n", argv[1],
+								line_num);
+			continue;
+		}
+
+		job->dst = dst;
+		l_queue_push_tail(apply.jobs, job);
+		apply.total++;
+	}
+
+	free(line);
+	fclose(f);
+
+	bt_shell_printf("Applying %u configuration messages, %u in parallel\n",
+						apply.total, apply.max);
+
+	apply_next();
+
+	return bt_shell_noninteractive_quit(EXIT_SUCCESS);
+}
+
 static const struct bt_shell_menu cfg_menu = {
 	.name = "config",
 	.desc = "Configuration Model Submenu",
@@ -2175,6 +2460,8 @@ static const struct bt_shell_menu cfg_menu = {
 				"Get subscription"},
 	{"node-reset", NULL, cmd_node_reset,
 				"Reset a node and remove it from network"},
+	{"apply", "<filename> [parallel]", cmd_apply,
+				"Apply configuration file to multiple nodes"},
 	{} },
 };
 
@@ -2208,6 +2495,8 @@ struct model_info *cfgcli_init(key_send_func_t key_send,
 
 void cfgcli_cleanup(void)
 {
+	l_queue_destroy(apply.jobs, l_free);
+	l_queue_destroy(apply.active, l_free);
 	l_queue_destroy(requests, free_request);
 	l_queue_destroy(groups, l_free);
 }
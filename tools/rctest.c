@@ -15,6 +15,8 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <ctype.h>
 #include <fcntl.h>
@@ -23,6 +25,8 @@
 #include <getopt.h>
 #include <syslog.h>
 #include <signal.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -54,6 +58,34 @@ enum {
 	CRECV,
 	LSEND,
 	AUTO,
+	BENCH,
+	LECHO,
+};
+
+/* Benchmark frame header: seq (4), len (2), echo timestamp (8) */
+#define BENCH_HDR_SIZE		14
+#define BENCH_ECHO_INTERVAL	100000000ULL
+#define BENCH_HIST_BUCKETS	21
+
+struct bench_dlc {
+	int sk;
+	uint8_t channel;
+	uint32_t seq;
+	long tx_off;
+	uint64_t tx_stamp;
+	uint64_t bytes;
+	uint64_t next_echo;
+	uint8_t rx[BENCH_HDR_SIZE];
+	int rx_len;
+	bool stalled;
+	uint64_t stall_start;
+	uint64_t stall_time;
+	unsigned int stalls;
+	uint64_t rtt_min;
+	uint64_t rtt_max;
+	uint64_t rtt_sum;
+	unsigned int rtt_count;
+	unsigned int hist[BENCH_HIST_BUCKETS];
 };
 
 static unsigned char *buf;
@@ -88,6 +120,10 @@ static int timestamp = 0;
 static int defer_setup = 0;
 static int priority = -1;
 
+/* Benchmark mode */
+static int num_dlcs = 1;
+static int bench_duration = 10;
+
 static float tv2fl(struct timeval tv)
 {
 	return (float)tv.tv_sec + (float)(tv.tv_usec/1000000.0);
@@ -595,6 +631,314 @@ static void send_mode(int sk)
 	close(sk);
 }
 
+static uint64_t get_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool read_full(int sk, uint8_t *data, long len)
+{
+	while (len > 0) {
+		ssize_t r = read(sk, data, len);
+
+		if (r <= 0) {
+			if (r < 0)
+				syslog(LOG_ERR, "Read failed: %s (%d)",
+							strerror(errno), errno);
+			return false;
+		}
+
+		data += r;
+		len -= r;
+	}
+
+	return true;
+}
+
+static void echo_mode(int sk)
+{
+	uint16_t len;
+
+	syslog(LOG_INFO, "Echoing ...");
+
+	/* RFCOMM is a stream so frames are delimited by their header */
+	while (read_full(sk, buf, BENCH_HDR_SIZE)) {
+		len = get_le16(buf + 4);
+		if (len < BENCH_HDR_SIZE || len > data_size) {
+			syslog(LOG_ERR, "Invalid frame length %u", len);
+			return;
+		}
+
+		if (get_le64(buf + 6) && send(sk, buf, BENCH_HDR_SIZE, 0) < 0) {
+			syslog(LOG_ERR, "Echo failed: %s (%d)",
+							strerror(errno), errno);
+			return;
+		}
+
+		if (!read_full(sk, buf + BENCH_HDR_SIZE, len - BENCH_HDR_SIZE))
+			return;
+	}
+}
+
+static void bench_stall(struct bench_dlc *dlc, uint64_t now)
+{
+	/* Out of RFCOMM credits or socket buffer space */
+	dlc->stalled = true;
+	dlc->stall_start = now;
+	dlc->stalls++;
+}
+
+static void bench_send(struct bench_dlc *dlc, uint64_t now)
+{
+	ssize_t len;
+
+	if (!dlc->tx_off) {
+		dlc->tx_stamp = now >= dlc->next_echo ? now : 0;
+		if (dlc->tx_stamp)
+			dlc->next_echo = now + BENCH_ECHO_INTERVAL;
+	}
+
+	put_le32(dlc->seq, buf);
+	put_le16(data_size, buf + 4);
+	put_le64(dlc->tx_stamp, buf + 6);
+
+	len = send(dlc->sk, buf + dlc->tx_off, data_size - dlc->tx_off,
+								MSG_DONTWAIT);
+	if (len < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			syslog(LOG_ERR, "Send failed: %s (%d)",
+							strerror(errno), errno);
+			exit(1);
+		}
+
+		bench_stall(dlc, now);
+		return;
+	}
+
+	dlc->bytes += len;
+	dlc->tx_off += len;
+
+	if (dlc->tx_off < data_size) {
+		bench_stall(dlc, now);
+		return;
+	}
+
+	dlc->tx_off = 0;
+	dlc->seq++;
+}
+
+static void bench_recv(struct bench_dlc *dlc, uint64_t now)
+{
+	uint64_t rtt, us;
+	ssize_t len;
+	int i;
+
+	len = recv(dlc->sk, dlc->rx + dlc->rx_len,
+				sizeof(dlc->rx) - dlc->rx_len, MSG_DONTWAIT);
+	if (len <= 0)
+		return;
+
+	dlc->rx_len += len;
+	if (dlc->rx_len < BENCH_HDR_SIZE)
+		return;
+
+	dlc->rx_len = 0;
+
+	rtt = now - get_le64(dlc->rx + 6);
+
+	if (!dlc->rtt_count || rtt < dlc->rtt_min)
+		dlc->rtt_min = rtt;
+
+	if (rtt > dlc->rtt_max)
+		dlc->rtt_max = rtt;
+
+	dlc->rtt_sum += rtt;
+	dlc->rtt_count++;
+
+	/* Power of two buckets in microseconds, the last one is open */
+	for (i = 0, us = rtt / 1000; us > 1 && i < BENCH_HIST_BUCKETS - 1;
+								i++, us >>= 1)
+		;
+
+	dlc->hist[i]++;
+}
+
+static void bench_report(const char *name, int chan, uint64_t bytes,
+				uint64_t elapsed, unsigned int stalls,
+				uint64_t stall_time, unsigned int rtt_count,
+				uint64_t rtt_min, uint64_t rtt_sum,
+				uint64_t rtt_max)
+{
+	double secs = elapsed / 1e9;
+
+	printf("%s,%d,%" PRIu64 ",%.3f,%.2f,%u,%.3f,%u,%" PRIu64 ",%" PRIu64
+			",%" PRIu64 "\n", name, chan, bytes, secs,
+			bytes / secs / 1024.0, stalls, stall_time / 1e6,
+			rtt_count, rtt_min / 1000,
+			rtt_count ? rtt_sum / rtt_count / 1000 : 0,
+			rtt_max / 1000);
+}
+
+static void bench_mode(char *svr)
+{
+	struct bench_dlc *dlcs, total;
+	struct pollfd *p;
+	uint64_t start, end, now;
+	uint8_t base;
+	char name[8];
+	int i, j;
+
+	if (data_size < BENCH_HDR_SIZE) {
+		syslog(LOG_ERR, "Frame size must be at least %d bytes",
+							BENCH_HDR_SIZE);
+		exit(1);
+	}
+
+	dlcs = calloc(num_dlcs, sizeof(*dlcs));
+	p = calloc(num_dlcs, sizeof(*p));
+	if (!dlcs || !p) {
+		syslog(LOG_ERR, "Can't allocate DLCs");
+		exit(1);
+	}
+
+	/* Resolve the first channel once, the others follow it */
+	if (uuid != 0x0000) {
+		channel = get_channel(svr, uuid);
+		uuid = 0x0000;
+	}
+
+	base = channel;
+
+	for (i = 0; i < num_dlcs; i++) {
+		channel = base + i;
+
+		dlcs[i].channel = channel;
+		dlcs[i].sk = do_connect(svr);
+		if (dlcs[i].sk < 0)
+			exit(1);
+	}
+
+	channel = base;
+
+	memset(buf + BENCH_HDR_SIZE, 0x7f, data_size - BENCH_HDR_SIZE);
+
+	syslog(LOG_INFO, "Sending %ld byte frames on %d DLCs for %d sec",
+					data_size, num_dlcs, bench_duration);
+
+	start = get_ns();
+	end = start + bench_duration * 1000000000ULL;
+
+	while ((now = get_ns()) < end) {
+		for (i = 0; i < num_dlcs; i++) {
+			struct bench_dlc *dlc = &dlcs[i];
+
+			for (j = 0; j < 8 && !dlc->stalled; j++)
+				bench_send(dlc, now);
+
+			p[i].fd = dlc->sk;
+			p[i].events = POLLIN;
+			if (dlc->stalled)
+				p[i].events |= POLLOUT;
+			p[i].revents = 0;
+		}
+
+		if (poll(p, num_dlcs, 100) < 0 && errno != EINTR) {
+			syslog(LOG_ERR, "Poll failed: %s (%d)",
+							strerror(errno), errno);
+			exit(1);
+		}
+
+		now = get_ns();
+
+		for (i = 0; i < num_dlcs; i++) {
+			struct bench_dlc *dlc = &dlcs[i];
+
+			if (p[i].revents & (POLLERR | POLLHUP)) {
+				syslog(LOG_ERR, "DLC %d disconnected", i);
+				exit(1);
+			}
+
+			if (p[i].revents & POLLIN)
+				bench_recv(dlc, now);
+
+			if (dlc->stalled && (p[i].revents & POLLOUT)) {
+				dlc->stalled = false;
+				dlc->stall_time += now - dlc->stall_start;
+			}
+		}
+	}
+
+	now = get_ns();
+
+	memset(&total, 0, sizeof(total));
+
+	printf("dlc,channel,bytes,seconds,kB/s,stalls,stall_ms,rtt_samples,"
+			"rtt_min_us,rtt_avg_us,rtt_max_us\n");
+
+	for (i = 0; i < num_dlcs; i++) {
+		struct bench_dlc *dlc = &dlcs[i];
+
+		if (dlc->stalled)
+			dlc->stall_time += now - dlc->stall_start;
+
+		snprintf(name, sizeof(name), "%d", i);
+		bench_report(name, dlc->channel, dlc->bytes, now - start,
+				dlc->stalls, dlc->stall_time, dlc->rtt_count,
+				dlc->rtt_min, dlc->rtt_sum, dlc->rtt_max);
+
+		if (dlc->rtt_count && (!total.rtt_count ||
+						dlc->rtt_min < total.rtt_min))
+			total.rtt_min = dlc->rtt_min;
+
+		if (dlc->rtt_max > total.rtt_max)
+			total.rtt_max = dlc->rtt_max;
+
+		total.bytes += dlc->bytes;
+		total.stalls += dlc->stalls;
+		total.stall_time += dlc->stall_time;
+		total.rtt_sum += dlc->rtt_sum;
+		total.rtt_count += dlc->rtt_count;
+
+		for (j = 0; j < BENCH_HIST_BUCKETS; j++)
+			total.hist[j] += dlc->hist[j];
+
+		close(dlc->sk);
+	}
+
+	bench_report("total", 0, total.bytes, now - start, total.stalls,
+				total.stall_time, total.rtt_count,
+				total.rtt_min, total.rtt_sum, total.rtt_max);
+
+	printf("\nrtt_below_us,count\n");
+
+	for (j = 0; j < BENCH_HIST_BUCKETS - 1; j++)
+		printf("%u,%u\n", 2U << j, total.hist[j]);
+
+	printf("inf,%u\n", total.hist[j]);
+
+	free(p);
+	free(dlcs);
+}
+
+static void multi_listen(void (*handler)(int sk))
+{
+	int i;
+
+	/* One listener per DLC, on consecutive channels */
+	for (i = 1; i < num_dlcs; i++) {
+		if (!fork()) {
+			channel += i;
+			break;
+		}
+	}
+
+	do_listen(handler);
+}
+
 static void reconnect_mode(char *svr)
 {
 	while(1) {
@@ -674,7 +1018,9 @@ static void usage(void)
 		"\t-n connect and be silent\n"
 		"\t-c connect, disconnect, connect, ...\n"
 		"\t-m multiple connects\n"
-		"\t-a automated test (receive hcix as parameter)\n");
+		"\t-a automated test (receive hcix as parameter)\n"
+		"\t-q connect multiple DLCs and run benchmark\n"
+		"\t-e listen and echo benchmark timestamps\n");
 
 	printf("Options:\n"
 		"\t[-b bytes] [-i device] [-P channel] [-U uuid]\n"
@@ -690,7 +1036,10 @@ static void usage(void)
 		"\t[-E] request encryption\n"
 		"\t[-S] secure connection\n"
 		"\t[-M] become central\n"
-		"\t[-T] enable timestamps\n");
+		"\t[-T] enable timestamps\n"
+		"\t[-K num] benchmark DLCs on consecutive channels "
+							"(default = 1)\n"
+		"\t[-G seconds] benchmark duration (default = 10)\n");
 }
 
 int main(int argc, char *argv[])
@@ -702,7 +1051,8 @@ int main(int argc, char *argv[])
 	bacpy(&auto_bdaddr, BDADDR_ANY);
 
 	while ((opt = getopt(argc, argv,
-			"rdscuwmna:b:i:P:U:B:O:N:MAESL:W:C:D:Y:T")) != EOF) {
+			"rdscuwmnqea:b:i:P:U:B:O:N:MAESL:W:C:D:Y:T"
+			"K:G:")) != EOF) {
 		switch (opt) {
 		case 'r':
 			mode = RECV;
@@ -741,6 +1091,30 @@ int main(int argc, char *argv[])
 			need_addr = 1;
 			break;
 
+		case 'q':
+			mode = BENCH;
+			need_addr = 1;
+			break;
+
+		case 'e':
+			mode = LECHO;
+			break;
+
+		case 'K':
+			if (optarg)
+				num_dlcs = atoi(optarg);
+
+			if (num_dlcs < 1) {
+				usage();
+				exit(1);
+			}
+			break;
+
+		case 'G':
+			if (optarg)
+				bench_duration = atoi(optarg);
+			break;
+
 		case 'a':
 			if (!optarg)
 				break;
@@ -914,6 +1288,14 @@ int main(int argc, char *argv[])
 		case AUTO:
 			automated_send_recv();
 			break;
+
+		case BENCH:
+			bench_mode(argv[optind]);
+			break;
+
+		case LECHO:
+			multi_listen(echo_mode);
+			break;
 	}
 
 	syslog(LOG_INFO, "Exit");
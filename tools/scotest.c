@@ -19,9 +19,11 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <getopt.h>
 #include <syslog.h>
 #include <signal.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/socket.h>
 
@@ -50,11 +52,123 @@ static bdaddr_t bdaddr;
 static int defer_setup = 0;
 static int voice = 0;
 
+/* Packets sent or received per system call */
+static int batch = 1;
+static int latency = 0;
+
+/* Packet header: sequence number, data size and, with -L, send time */
+#define PKT_HDR_SIZE		6
+#define PKT_LAT_HDR_SIZE	(PKT_HDR_SIZE + 8)
+
+#define BATCH_ALIGN		64
+
+static uint8_t *batch_buf;
+static struct iovec *batch_iov;
+static struct mmsghdr *batch_msgs;
+
+struct lat_stats {
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+	unsigned long count;
+};
+
 static float tv2fl(struct timeval tv)
 {
 	return (float)tv.tv_sec + (float)(tv.tv_usec/1000000.0);
 }
 
+static uint64_t monotonic_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void lat_reset(struct lat_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->min = UINT64_MAX;
+}
+
+static void lat_update(struct lat_stats *stats, uint64_t us)
+{
+	if (us < stats->min)
+		stats->min = us;
+	if (us > stats->max)
+		stats->max = us;
+
+	stats->sum += us;
+	stats->count++;
+}
+
+static void lat_report(const char *name, struct lat_stats *stats)
+{
+	if (!stats->count)
+		return;
+
+	syslog(LOG_INFO, "%s min %" PRIu64 " avg %" PRIu64 " max %" PRIu64
+					" us (%lu samples)", name, stats->min,
+					stats->sum / stats->count, stats->max,
+					stats->count);
+}
+
+/* Sets up |batch| packet buffers of |mtu| bytes each, aligned to cache lines,
+ * so several packets can be moved with a single sendmmsg/recvmmsg call.
+ */
+static int setup_batch(uint16_t mtu)
+{
+	size_t stride = (mtu + BATCH_ALIGN - 1) & ~(BATCH_ALIGN - 1);
+	int i;
+
+	if (posix_memalign((void **) &batch_buf, BATCH_ALIGN,
+							batch * stride))
+		return -ENOMEM;
+
+	batch_iov = calloc(batch, sizeof(*batch_iov));
+	batch_msgs = calloc(batch, sizeof(*batch_msgs));
+	if (!batch_iov || !batch_msgs)
+		return -ENOMEM;
+
+	memset(batch_buf, 0x7f, batch * stride);
+
+	for (i = 0; i < batch; i++) {
+		batch_iov[i].iov_base = batch_buf + i * stride;
+		batch_iov[i].iov_len = mtu;
+		batch_msgs[i].msg_hdr.msg_iov = &batch_iov[i];
+		batch_msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	return 0;
+}
+
+static uint16_t get_mtu(int sk)
+{
+	struct sco_options so;
+	socklen_t len;
+
+	len = sizeof(so);
+	if (getsockopt(sk, SOL_SCO, SCO_OPTIONS, &so, &len) < 0) {
+		syslog(LOG_ERR, "Can't get SCO options: %s (%d)",
+							strerror(errno), errno);
+		exit(1);
+	}
+
+	if (latency && so.mtu < PKT_LAT_HDR_SIZE) {
+		syslog(LOG_ERR, "MTU %u too small for latency mode", so.mtu);
+		exit(1);
+	}
+
+	if (setup_batch(so.mtu) < 0) {
+		syslog(LOG_ERR, "Can't allocate batch buffers");
+		exit(1);
+	}
+
+	return so.mtu;
+}
+
 static int do_connect(char *svr)
 {
 	struct sockaddr_sco addr;
@@ -260,8 +374,11 @@ static void recv_mode(int sk)
 {
 	struct timeval tv_beg,tv_end,tv_diff;
 	struct bt_voice opts;
+	struct lat_stats lat;
+	uint32_t seq, expect = 0;
+	unsigned long pkts, lost;
 	long total;
-	int len;
+	int len, i;
 
 	/* SCO voice setting */
 	memset(&opts, 0, sizeof(opts));
@@ -279,14 +396,20 @@ static void recv_mode(int sk)
 			syslog(LOG_INFO, "Initial bytes %d", len);
 	}
 
+	get_mtu(sk);
+
 	syslog(LOG_INFO, "Receiving ...");
 
 	while (1) {
 		gettimeofday(&tv_beg, NULL);
+		lat_reset(&lat);
 		total = 0;
+		pkts = 0;
+		lost = 0;
 		while (total < data_size) {
 			int r;
-			if ((r = recv(sk, buf, data_size, 0)) <= 0) {
+			if ((r = recvmmsg(sk, batch_msgs, batch, 0,
+							NULL)) <= 0) {
 				if (r < 0)
 					syslog(LOG_ERR, "Read failed: %s (%d)",
 							strerror(errno), errno);
@@ -294,7 +417,25 @@ static void recv_mode(int sk)
 					return;
 				r = 0;
 			}
-			total += r;
+
+			for (i = 0; i < r; i++) {
+				uint8_t *pkt = batch_iov[i].iov_base;
+
+				total += batch_msgs[i].msg_len;
+				pkts++;
+
+				if (!latency ||
+				    batch_msgs[i].msg_len < PKT_LAT_HDR_SIZE)
+					continue;
+
+				seq = get_le32(pkt);
+				if (seq > expect)
+					lost += seq - expect;
+				expect = seq + 1;
+
+				lat_update(&lat, monotonic_us() -
+						get_le64(pkt + PKT_HDR_SIZE));
+			}
 		}
 		gettimeofday(&tv_end, NULL);
 
@@ -303,14 +444,21 @@ static void recv_mode(int sk)
 		syslog(LOG_INFO,"%ld bytes in %.2fm speed %.2f kb", total,
 			tv2fl(tv_diff) / 60.0,
 			(float)( total / tv2fl(tv_diff) ) / 1024.0 );
+
+		if (latency) {
+			syslog(LOG_INFO, "%lu packets, %lu lost", pkts, lost);
+			lat_report("Latency", &lat);
+		}
 	}
 }
 
 static void send_mode(char *svr)
 {
-	struct sco_options so;
-	socklen_t len;
+	struct timeval tv_beg, tv_end, tv_diff;
+	struct lat_stats lat;
+	uint16_t mtu;
 	uint32_t seq;
+	long total;
 	int i, sk;
 
 	if ((sk = do_connect(svr)) < 0) {
@@ -319,31 +467,66 @@ static void send_mode(char *svr)
 		exit(1);
 	}
 
-	len = sizeof(so);
-	if (getsockopt(sk, SOL_SCO, SCO_OPTIONS, &so, &len) < 0) {
-		syslog(LOG_ERR, "Can't get SCO options: %s (%d)",
-							strerror(errno), errno);
-		exit(1);
-	}
+	mtu = get_mtu(sk);
 
 	syslog(LOG_INFO,"Sending ...");
 
-	for (i = 6; i < so.mtu; i++)
-		buf[i] = 0x7f;
-
 	seq = 0;
+	total = 0;
+	lat_reset(&lat);
+	gettimeofday(&tv_beg, NULL);
+
 	while (1) {
-		put_le32(seq, buf);
-		put_le16(data_size, buf + 4);
+		uint64_t start;
+		int r;
+
+		for (i = 0; i < batch; i++) {
+			uint8_t *pkt = batch_iov[i].iov_base;
+
+			put_le32(seq, pkt);
+			put_le16(data_size, pkt + 4);
 
-		seq++;
+			seq++;
+		}
+
+		start = monotonic_us();
+
+		for (i = 0; latency && i < batch; i++) {
+			uint8_t *pkt = batch_iov[i].iov_base;
+
+			put_le64(start, pkt + PKT_HDR_SIZE);
+		}
 
-		if (send(sk, buf, so.mtu, 0) <= 0) {
+		r = sendmmsg(sk, batch_msgs, batch, 0);
+		if (r <= 0) {
 			syslog(LOG_ERR, "Send failed: %s (%d)",
 							strerror(errno), errno);
 			exit(1);
 		}
 
+		/* Packets not accepted are sent again with new numbers */
+		seq -= batch - r;
+
+		if (latency) {
+			lat_update(&lat, monotonic_us() - start);
+			total += r * mtu;
+
+			gettimeofday(&tv_end, NULL);
+			timersub(&tv_end, &tv_beg, &tv_diff);
+
+			if (tv_diff.tv_sec >= 1) {
+				syslog(LOG_INFO, "%ld bytes in %.2fs speed "
+					"%.2f kb", total, tv2fl(tv_diff),
+					(float) (total / tv2fl(tv_diff)) /
+					1024.0);
+				lat_report("Send call", &lat);
+
+				lat_reset(&lat);
+				total = 0;
+				tv_beg = tv_end;
+			}
+		}
+
 		usleep(1);
 	}
 }
@@ -403,7 +586,9 @@ static void usage(void)
 		"Options:\n"
 		"\t[-b bytes]\n"
 		"\t[-W seconds] enable deferred setup\n"
-		"\t[-V voice] select SCO voice setting (0x0060 cvsd, 0x0003 transparent)\n");
+		"\t[-V voice] select SCO voice setting (0x0060 cvsd, 0x0003 transparent)\n"
+		"\t[-B packets] packets per system call (send/receive)\n"
+		"\t[-L] report speed, latency and losses (send/receive)\n");
 }
 
 int main(int argc ,char *argv[])
@@ -411,7 +596,7 @@ int main(int argc ,char *argv[])
 	struct sigaction sa;
 	int opt, sk, mode = RECV;
 
-	while ((opt = getopt(argc, argv, "rdscmnb:W:V:")) != EOF) {
+	while ((opt = getopt(argc, argv, "rdscmnb:W:V:B:L")) != EOF) {
 		switch(opt) {
 		case 'r':
 			mode = RECV;
@@ -449,6 +634,16 @@ int main(int argc ,char *argv[])
 			voice = strtol(optarg, NULL, 0);
 			break;
 
+		case 'B':
+			batch = atoi(optarg);
+			if (batch < 1)
+				batch = 1;
+			break;
+
+		case 'L':
+			latency = 1;
+			break;
+
 		default:
 			usage();
 			exit(1);
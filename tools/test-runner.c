@@ -41,6 +41,7 @@
 #endif
 
 #define CMDLINE_MAX (2048 * 10)
+#define MAX_JOBS 16
 
 static const char *own_binary;
 static char **test_argv;
@@ -54,6 +55,8 @@ static bool start_emulator = false;
 static bool start_monitor = false;
 static bool qemu_host_cpu = false;
 static int num_devs = 0;
+static int num_jobs = 1;
+static int job_id = 0;
 static const char *qemu_binary = NULL;
 static const char *kernel_image = NULL;
 static char *audio_server;
@@ -272,11 +275,13 @@ static void start_qemu(void)
 				"TESTHOME=%s TESTDBUS=%u TESTDAEMON=%u "
 				"TESTDBUSSESSION=%u XDG_RUNTIME_DIR=/run/user/0 "
 				"TESTMONITOR=%u TESTEMULATOR=%u TESTDEVS=%d "
-				"TESTAUTO=%u TESTAUDIO='%s' TESTARGS=\'%s\'",
+				"TESTAUTO=%u TESTJOB=%d TESTJOBS=%d "
+				"TESTAUDIO='%s' TESTARGS=\'%s\'",
 				initcmd, cwd, start_dbus, start_daemon,
 				start_dbus_session,
 				start_monitor, start_emulator, num_devs,
-				run_auto, audio_server ? audio_server : "",
+				run_auto, job_id, num_jobs,
+				audio_server ? audio_server : "",
 				testargs);
 
 	argv = alloca(sizeof(qemu_argv) +
@@ -323,6 +328,156 @@ static void start_qemu(void)
 	execve(argv[0], argv, qemu_envp);
 }
 
+struct job {
+	pid_t pid;
+	int fd;
+	char buf[1024];
+	size_t len;
+};
+
+static unsigned int summary_value(const char *line, const char *key)
+{
+	const char *ptr = strstr(line, key);
+
+	return ptr ? strtoul(ptr + strlen(key), NULL, 10) : 0;
+}
+
+static void job_line(int index, const char *line, unsigned int totals[4])
+{
+	printf("[%d] %s\n", index, line);
+
+	/* Summary lines of the testers, see tester_summarize() */
+	if (!strstr(line, "Total: "))
+		return;
+
+	totals[0] += summary_value(line, "Total: ");
+	totals[1] += summary_value(line, "Passed: ");
+	totals[2] += summary_value(line, "Failed: ");
+	totals[3] += summary_value(line, "Not Run: ");
+}
+
+static bool job_read(struct job *job, int index, unsigned int totals[4])
+{
+	char *end;
+	ssize_t len;
+
+	len = read(job->fd, job->buf + job->len,
+					sizeof(job->buf) - job->len - 1);
+	if (len <= 0) {
+		if (job->len) {
+			job->buf[job->len] = '\0';
+			job_line(index, job->buf, totals);
+		}
+		return false;
+	}
+
+	job->len += len;
+	job->buf[job->len] = '\0';
+
+	while ((end = strchr(job->buf, '\n'))) {
+		*end = '\0';
+		if (end > job->buf && end[-1] == '\r')
+			end[-1] = '\0';
+		job_line(index, job->buf, totals);
+		job->len -= end + 1 - job->buf;
+		memmove(job->buf, end + 1, job->len + 1);
+	}
+
+	/* Flush overlong lines rather than stalling the instance */
+	if (job->len == sizeof(job->buf) - 1) {
+		job_line(index, job->buf, totals);
+		job->len = 0;
+	}
+
+	return true;
+}
+
+/* Every instance shares the read-only root filesystem and runs its share of
+ * the testers, or of the test cases when a single tester is given.
+ */
+static int run_jobs(void)
+{
+	struct job jobs[MAX_JOBS];
+	struct pollfd pfds[MAX_JOBS];
+	unsigned int totals[4] = { 0, 0, 0, 0 };
+	int i, running = 0;
+
+	for (i = 0; i < num_jobs; i++) {
+		int fds[2];
+
+		jobs[i].fd = -1;
+		jobs[i].len = 0;
+
+		if (pipe2(fds, O_CLOEXEC) < 0) {
+			perror("Failed to create pipe");
+			continue;
+		}
+
+		jobs[i].pid = fork();
+		if (jobs[i].pid < 0) {
+			perror("Failed to fork new process");
+			close(fds[0]);
+			close(fds[1]);
+			continue;
+		}
+
+		if (jobs[i].pid == 0) {
+			int null_fd = open("/dev/null", O_RDONLY);
+
+			if (null_fd >= 0)
+				dup2(null_fd, STDIN_FILENO);
+
+			dup2(fds[1], STDOUT_FILENO);
+			dup2(fds[1], STDERR_FILENO);
+
+			job_id = i;
+			start_qemu();
+			exit(EXIT_FAILURE);
+		}
+
+		close(fds[1]);
+		jobs[i].fd = fds[0];
+		running++;
+	}
+
+	while (running > 0) {
+		for (i = 0; i < num_jobs; i++) {
+			pfds[i].fd = jobs[i].fd;
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+		}
+
+		if (poll(pfds, num_jobs, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < num_jobs; i++) {
+			if (!pfds[i].revents)
+				continue;
+
+			if (job_read(&jobs[i], i, totals))
+				continue;
+
+			close(jobs[i].fd);
+			jobs[i].fd = -1;
+			running--;
+		}
+	}
+
+	for (i = 0; i < num_jobs; i++) {
+		if (jobs[i].pid > 0)
+			waitpid(jobs[i].pid, NULL, 0);
+	}
+
+	printf("\nCombined summary of %d instances\n", num_jobs);
+	printf("Total: %u, Passed: %u, Failed: %u, Not Run: %u\n",
+				totals[0], totals[1], totals[2], totals[3]);
+
+	return totals[2] ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static int open_serial(const char *path)
 {
 	struct termios ti;
@@ -857,7 +1012,8 @@ static int start_audio_server(pid_t pids[2])
 
 static void run_command(char *cmdname, char *home)
 {
-	char *argv[9], *envp[3];
+	char *argv[9], *envp[4], shard[32];
+	unsigned int found = 0;
 	int pos = 0, idx = 0;
 	int serial_fd;
 	pid_t pid, dbus_pid, daemon_pid, monitor_pid, emulator_pid,
@@ -933,7 +1089,9 @@ start_next:
 			if (!test_table[idx])
 				return;
 
-			if (!stat(test_table[idx], &st))
+			/* With several instances each takes every Nth tester */
+			if (!stat(test_table[idx], &st) &&
+					found++ % num_jobs == job_id)
 				break;
 
 			idx++;
@@ -949,6 +1107,11 @@ start_next:
 	envp[pos++] = "TERM=linux";
 	if (home)
 		envp[pos++] = home;
+	if (!run_auto && num_jobs > 1) {
+		snprintf(shard, sizeof(shard), "TESTER_SHARD=%d/%d", job_id,
+								num_jobs);
+		envp[pos++] = shard;
+	}
 	envp[pos] = NULL;
 
 	printf("Running command %s\n", cmdname ? cmdname : argv[0]);
@@ -1103,6 +1266,22 @@ static void run_tests(void)
 		run_auto= true;
 	}
 
+	ptr = strstr(cmdline, "TESTJOBS=");
+	if (ptr)
+		num_jobs = atoi(ptr + 9);
+
+	ptr = strstr(cmdline, "TESTJOB=");
+	if (ptr)
+		job_id = atoi(ptr + 8);
+
+	if (num_jobs < 1 || job_id < 0 || job_id >= num_jobs) {
+		num_jobs = 1;
+		job_id = 0;
+	}
+
+	if (num_jobs > 1)
+		printf("Instance %d of %d\n", job_id + 1, num_jobs);
+
 	ptr = strstr(cmdline, "TESTDEVS=1");
 	if (ptr) {
 		printf("Attachment of devices requested\n");
@@ -1178,6 +1357,7 @@ static void usage(void)
 		"\t-q, --qemu <path>      QEMU binary\n"
 		"\t-H, --qemu-host-cpu    Use host CPU (requires KVM support)\n"
 		"\t-k, --kernel <image>   Kernel image (bzImage)\n"
+		"\t-j, --jobs <num>       Run tests in parallel instances\n"
 		"\t-h, --help             Show help options\n");
 }
 
@@ -1193,6 +1373,7 @@ static const struct option main_options[] = {
 	{ "qemu",    required_argument, NULL, 'q' },
 	{ "qemu-host-cpu", no_argument, NULL, 'H' },
 	{ "kernel",  required_argument, NULL, 'k' },
+	{ "jobs",    required_argument, NULL, 'j' },
 	{ "audio",   optional_argument, NULL, 'A' },
 	{ "version", no_argument,       NULL, 'v' },
 	{ "help",    no_argument,       NULL, 'h' },
@@ -1213,8 +1394,8 @@ int main(int argc, char *argv[])
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "aubdslmq:Hk:A::vh", main_options,
-								NULL);
+		opt = getopt_long(argc, argv, "aubdslmq:Hk:j:A::vh",
+							main_options, NULL);
 		if (opt < 0)
 			break;
 
@@ -1250,6 +1431,13 @@ int main(int argc, char *argv[])
 		case 'k':
 			kernel_image = optarg;
 			break;
+		case 'j':
+			num_jobs = atoi(optarg);
+			if (num_jobs < 1 || num_jobs > MAX_JOBS) {
+				fprintf(stderr, "Invalid number of jobs\n");
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'A':
 			audio_server = optarg ? optarg : "/usr/bin/pipewire";
 			break;
@@ -1299,6 +1487,16 @@ int main(int argc, char *argv[])
 	printf("Using QEMU binary %s\n", qemu_binary);
 	printf("Using kernel image %s\n", kernel_image);
 
+	if (num_jobs > 1) {
+		/* The instances would all attach to the same host socket */
+		if (num_devs) {
+			fprintf(stderr, "Serial device needs a single job\n");
+			return EXIT_FAILURE;
+		}
+
+		return run_jobs();
+	}
+
 	start_qemu();
 
 	return EXIT_SUCCESS;
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2012  Intel Corporation. All rights reserved.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <glib.h>
+
+#include "lib/bluetooth.h"
+#include "lib/uuid.h"
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/att.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/ad.h"
+#include "src/shared/btsnoop.h"
+#include "src/shared/tester.h"
+#include "src/eir.h"
+#include "attrib/att.h"
+
+#define QUEUE_ENTRIES		64
+#define DB_SERVICES		32
+#define DB_CHRCS		8
+#define SNOOP_PACKETS		64
+#define AD_MONITORS		32
+
+static const uint8_t adv_data[] = {
+	0x02, 0x01, 0x06,
+	0x05, 0x03, 0x0d, 0x18, 0x0f, 0x18,
+	0x11, 0x07, 0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
+	0x00, 0x10, 0x00, 0x00, 0x0d, 0x18, 0x00, 0x00,
+	0x06, 0xff, 0x4c, 0x00, 0x02, 0x15, 0x00,
+	0x09, 0x09, 'B', 'l', 'u', 'e', 'Z', ' ', 'H', 'R',
+	0x02, 0x0a, 0x08,
+};
+
+static struct queue *bench_queue;
+static struct gatt_db *bench_db;
+static struct queue *bench_patterns[AD_MONITORS];
+static struct bt_ad_matcher *bench_matcher;
+static char snoop_path[] = "/tmp/bench-shared-XXXXXX";
+
+static bool match_ptr(const void *a, const void *b)
+{
+	return a == b;
+}
+
+static void bench_queue_push_pop(const void *test_data)
+{
+	struct queue *queue = queue_new();
+	unsigned int i;
+
+	for (i = 0; i < QUEUE_ENTRIES; i++)
+		queue_push_tail(queue, UINT_TO_PTR(i + 1));
+
+	while (queue_pop_head(queue))
+		;
+
+	queue_destroy(queue, NULL);
+}
+
+static void bench_queue_find(const void *test_data)
+{
+	queue_find(bench_queue, match_ptr, UINT_TO_PTR(QUEUE_ENTRIES));
+}
+
+static void setup_db(void)
+{
+	bt_uuid_t uuid;
+	unsigned int i, j;
+
+	bench_db = gatt_db_new();
+
+	for (i = 0; i < DB_SERVICES; i++) {
+		struct gatt_db_attribute *attr;
+
+		bt_uuid16_create(&uuid, 0x1800 + i);
+		attr = gatt_db_add_service(bench_db, &uuid, true,
+							1 + DB_CHRCS * 2);
+
+		for (j = 0; j < DB_CHRCS; j++) {
+			bt_uuid16_create(&uuid, 0x2a00 + j);
+			gatt_db_service_add_characteristic(attr, &uuid,
+						BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ,
+						NULL, NULL, NULL);
+		}
+
+		gatt_db_service_set_active(attr, true);
+	}
+}
+
+static void bench_db_get_attribute(const void *test_data)
+{
+	static uint16_t handle;
+
+	handle = handle % (DB_SERVICES * (1 + DB_CHRCS * 2)) + 1;
+
+	gatt_db_get_attribute(bench_db, handle);
+}
+
+static void count_attr(struct gatt_db_attribute *attrib, void *user_data)
+{
+	unsigned int *count = user_data;
+
+	(*count)++;
+}
+
+static void bench_db_find_by_type(const void *test_data)
+{
+	unsigned int count = 0;
+	bt_uuid_t uuid;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
+
+	gatt_db_find_by_type(bench_db, 0x0001, 0xffff, &uuid, count_attr,
+								&count);
+}
+
+static void bench_att_read_by_type(const void *test_data)
+{
+	uint8_t pdu[ATT_DEFAULT_LE_MTU];
+	uint16_t start, end, len;
+	bt_uuid_t uuid;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
+
+	len = enc_read_by_type_req(0x0001, 0xffff, &uuid, pdu, sizeof(pdu));
+	dec_read_by_type_req(pdu, len, &start, &end, &uuid);
+}
+
+static void bench_att_read_resp(const void *test_data)
+{
+	uint8_t value[ATT_DEFAULT_LE_MTU - 1];
+	uint8_t pdu[ATT_DEFAULT_LE_MTU];
+	uint16_t len;
+
+	memset(value, 0x42, sizeof(value));
+
+	len = enc_read_resp(value, sizeof(value), pdu, sizeof(pdu));
+	dec_read_resp(pdu, len, value, sizeof(value));
+}
+
+static void bench_ad_parse(const void *test_data)
+{
+	struct bt_ad *ad;
+
+	ad = bt_ad_new_with_data(sizeof(adv_data), adv_data);
+	bt_ad_unref(ad);
+}
+
+static void bench_ad_view(const void *test_data)
+{
+	struct bt_ad_manufacturer_data manuf;
+	struct bt_ad_data name;
+	bt_uuid_t uuid;
+
+	bt_uuid16_create(&uuid, 0x180f);
+
+	bt_ad_view_has_service_uuid(adv_data, sizeof(adv_data), &uuid);
+	bt_ad_view_get_manufacturer_data(adv_data, sizeof(adv_data), 0x004c,
+								&manuf);
+	bt_ad_view_find(adv_data, sizeof(adv_data), BT_AD_NAME_COMPLETE,
+								&name);
+}
+
+static void setup_patterns(void)
+{
+	unsigned int i;
+
+	bench_matcher = bt_ad_matcher_new();
+
+	/* Only the last monitor matches the iBeacon prefix of adv_data */
+	for (i = 0; i < AD_MONITORS; i++) {
+		uint8_t data[] = { 0x4c, 0x00, 0x02, 0x15 };
+
+		if (i < AD_MONITORS - 1)
+			data[3] = i;
+
+		bench_patterns[i] = queue_new();
+		queue_push_tail(bench_patterns[i], bt_ad_pattern_new(
+						BT_AD_MANUFACTURER_DATA, 0,
+						sizeof(data), data));
+		queue_push_tail(bench_patterns[i], bt_ad_pattern_new(
+						BT_AD_NAME_COMPLETE, 0, 1,
+						data + 3));
+
+		bt_ad_matcher_add(bench_matcher, bench_patterns[i],
+							bench_patterns[i]);
+	}
+}
+
+static void free_patterns(void)
+{
+	unsigned int i;
+
+	bt_ad_matcher_free(bench_matcher);
+
+	for (i = 0; i < AD_MONITORS; i++)
+		queue_destroy(bench_patterns[i], free);
+}
+
+static void bench_ad_pattern_match(const void *test_data)
+{
+	struct bt_ad *ad;
+	unsigned int i;
+
+	ad = bt_ad_new_with_data(sizeof(adv_data), adv_data);
+
+	for (i = 0; i < AD_MONITORS; i++)
+		bt_ad_pattern_match(ad, bench_patterns[i]);
+
+	bt_ad_unref(ad);
+}
+
+static void count_match(void *match_data, void *user_data)
+{
+	unsigned int *count = user_data;
+
+	(*count)++;
+}
+
+static void bench_ad_matcher(const void *test_data)
+{
+	unsigned int count = 0;
+
+	bt_ad_matcher_match(bench_matcher, adv_data, sizeof(adv_data),
+							count_match, &count);
+}
+
+static void bench_eir_parse(const void *test_data)
+{
+	struct eir_data eir;
+
+	memset(&eir, 0, sizeof(eir));
+	eir_parse(&eir, adv_data, sizeof(adv_data));
+	eir_data_free(&eir);
+}
+
+static bool setup_snoop(void)
+{
+	struct btsnoop *snoop;
+	struct timeval tv;
+	uint8_t buf[sizeof(adv_data) + 16];
+	unsigned int i;
+	int fd;
+
+	fd = mkstemp(snoop_path);
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	unlink(snoop_path);
+
+	snoop = btsnoop_create(snoop_path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	if (!snoop)
+		return false;
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf + 16, adv_data, sizeof(adv_data));
+	gettimeofday(&tv, NULL);
+
+	for (i = 0; i < SNOOP_PACKETS; i++)
+		btsnoop_write_hci(snoop, &tv, 0, BTSNOOP_OPCODE_EVENT_PKT, 0,
+							buf, sizeof(buf));
+
+	btsnoop_unref(snoop);
+
+	return true;
+}
+
+static void bench_snoop_read(const void *test_data)
+{
+	struct btsnoop *snoop;
+	struct timeval tv;
+	uint16_t index, opcode, size;
+	uint8_t buf[BTSNOOP_MAX_PACKET_SIZE];
+
+	snoop = btsnoop_open(snoop_path, 0);
+	if (!snoop)
+		return;
+
+	while (btsnoop_read_hci(snoop, &tv, &index, &opcode, buf, &size))
+		;
+
+	btsnoop_unref(snoop);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i;
+	int ret;
+
+	tester_init(&argc, &argv);
+
+	bench_queue = queue_new();
+	for (i = 0; i < QUEUE_ENTRIES; i++)
+		queue_push_tail(bench_queue, UINT_TO_PTR(i + 1));
+
+	setup_db();
+	setup_patterns();
+
+	tester_add_benchmark("/queue/push_pop", NULL, bench_queue_push_pop);
+	tester_add_benchmark("/queue/find", NULL, bench_queue_find);
+	tester_add_benchmark("/gatt-db/get_attribute", NULL,
+						bench_db_get_attribute);
+	tester_add_benchmark("/gatt-db/find_by_type", NULL,
+						bench_db_find_by_type);
+	tester_add_benchmark("/att/read_by_type_req", NULL,
+						bench_att_read_by_type);
+	tester_add_benchmark("/att/read_resp", NULL, bench_att_read_resp);
+	tester_add_benchmark("/ad/parse", NULL, bench_ad_parse);
+	tester_add_benchmark("/ad/view", NULL, bench_ad_view);
+	tester_add_benchmark("/ad/pattern_match", NULL,
+							bench_ad_pattern_match);
+	tester_add_benchmark("/ad/matcher", NULL, bench_ad_matcher);
+	tester_add_benchmark("/eir/parse", NULL, bench_eir_parse);
+
+	if (setup_snoop())
+		tester_add_benchmark("/btsnoop/read", NULL, bench_snoop_read);
+
+	ret = tester_run();
+
+	unlink(snoop_path);
+	free_patterns();
+	gatt_db_unref(bench_db);
+	queue_destroy(bench_queue, NULL);
+
+	return ret;
+}
@@ -383,6 +383,62 @@ static void test_sih(const void *data)
 	tester_test_passed();
 }
 
+static void test_resolve(const void *data)
+{
+	const uint8_t irk[16] = {
+			0x9b, 0x7d, 0x39, 0x0a, 0xa6, 0x10, 0x10, 0x34,
+			0x05, 0xad, 0xc8, 0x57, 0xa3, 0x34, 0x02, 0xec };
+	const uint8_t rpa[6] = { 0xaa, 0xfb, 0x0d, 0x94, 0x81, 0x70 };
+	const uint8_t other[6] = { 0xab, 0xfb, 0x0d, 0x94, 0x81, 0x70 };
+	struct bt_crypto_resolver *resolver;
+	uint8_t keys[10][16];
+	unsigned int i;
+
+	resolver = bt_crypto_resolver_new();
+
+	/* Put the matching IRK past the first batch of four */
+	for (i = 0; i < 10; i++) {
+		memset(keys[i], i + 1, 16);
+
+		if (i == 6)
+			memcpy(keys[i], irk, 16);
+
+		bt_crypto_resolver_add(resolver, keys[i], keys[i]);
+	}
+
+	if (bt_crypto_resolver_resolve(resolver, rpa) != keys[6])
+		goto failed;
+
+	/* Second lookup is answered from the cache */
+	if (bt_crypto_resolver_resolve(resolver, rpa) != keys[6])
+		goto failed;
+
+	if (bt_crypto_resolver_resolve(resolver, other))
+		goto failed;
+
+	bt_crypto_resolver_remove(resolver, irk);
+
+	if (bt_crypto_resolver_resolve(resolver, rpa))
+		goto failed;
+
+	/* Adding a key drops the cached miss */
+	bt_crypto_resolver_add(resolver, irk, (void *) irk);
+
+	if (bt_crypto_resolver_resolve(resolver, rpa) != irk)
+		goto failed;
+
+	if (bt_crypto_resolver_resolve(resolver, other))
+		goto failed;
+
+	bt_crypto_resolver_free(resolver);
+	tester_test_passed();
+	return;
+
+failed:
+	bt_crypto_resolver_free(resolver);
+	tester_test_failed();
+}
+
 int main(int argc, char *argv[])
 {
 	int exit_status;
@@ -411,6 +467,7 @@ int main(int argc, char *argv[])
 						NULL, test_verify_sign, NULL);
 	tester_add("/crypto/sef", NULL, NULL, test_sef, NULL);
 	tester_add("/crypto/sih", NULL, NULL, test_sih, NULL);
+	tester_add("/crypto/resolve", NULL, NULL, test_resolve, NULL);
 
 	exit_status = tester_run();
 
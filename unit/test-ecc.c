@@ -16,6 +16,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include "src/shared/ecc.h"
 #include "src/shared/util.h"
@@ -73,8 +74,19 @@ static int test_sample(uint8_t priv_a[32], uint8_t priv_b[32],
 				uint8_t dhkey[32])
 {
 	uint8_t dhkey_a[32], dhkey_b[32];
+	uint8_t pub[64];
 	int fails = 0;
 
+	if (!ecc_make_public_key(priv_a, pub) || memcmp(pub, pub_a, 64)) {
+		tester_debug("Public key A doesn't match!");
+		fails++;
+	}
+
+	if (!ecc_make_public_key(priv_b, pub) || memcmp(pub, pub_b, 64)) {
+		tester_debug("Public key B doesn't match!");
+		fails++;
+	}
+
 	memset(dhkey_a, 0, sizeof(dhkey_a));
 	ecdh_shared_secret(pub_b, priv_a, dhkey_a);
 
@@ -261,6 +273,58 @@ static void test_invalid_pub(const void *data)
 	tester_test_passed();
 }
 
+#define BENCH_COUNT 100
+
+static double bench_elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000.0 +
+				(now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void test_bench(const void *data)
+{
+	uint8_t public1[64], public2[64];
+	uint8_t private1[32], private2[32];
+	uint8_t shared[32];
+	struct timespec start;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < BENCH_COUNT; i++) {
+		if (!ecc_make_key(public1, private1)) {
+			tester_test_failed();
+			return;
+		}
+	}
+
+	tester_debug("ecc_make_key: %.3f ms",
+					bench_elapsed(&start) / BENCH_COUNT);
+
+	if (!ecc_make_key(public2, private2)) {
+		tester_test_failed();
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < BENCH_COUNT; i++) {
+		if (!ecdh_shared_secret(public2, private1, shared)) {
+			tester_test_failed();
+			return;
+		}
+	}
+
+	tester_debug("ecdh_shared_secret: %.3f ms",
+					bench_elapsed(&start) / BENCH_COUNT);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -273,5 +337,7 @@ int main(int argc, char *argv[])
 
 	tester_add("/ecdh/invalid", NULL, NULL, test_invalid_pub, NULL);
 
+	tester_add("/ecdh/bench", NULL, NULL, test_bench, NULL);
+
 	return tester_run();
 }
@@ -588,6 +588,85 @@ static void test_ad(const struct test_data *test, struct eir_data *eir)
 	bt_ad_unref(ad);
 }
 
+static void test_view(const struct test_data *test, struct eir_data *eir)
+{
+	struct bt_ad_data flags;
+	GSList *list;
+
+	if (bt_ad_view_find(test->eir_data, test->eir_size, BT_AD_FLAGS,
+							&flags) && flags.len)
+		g_assert_cmpint(flags.data[0], ==, test->flags);
+	else
+		g_assert_cmpint(test->flags, ==, 0);
+
+	if (test->uuid) {
+		int i;
+
+		for (i = 0; test->uuid[i]; i++) {
+			bt_uuid_t uuid;
+
+			bt_string_to_uuid(&uuid, test->uuid[i]);
+			g_assert(bt_ad_view_has_service_uuid(test->eir_data,
+							test->eir_size, &uuid));
+		}
+	}
+
+	for (list = eir->msd_list; list; list = list->next) {
+		struct eir_msd *msd = list->data;
+		struct bt_ad_manufacturer_data adm;
+
+		g_assert(bt_ad_view_get_manufacturer_data(test->eir_data,
+						test->eir_size, msd->company,
+						&adm));
+	}
+
+	for (list = eir->sd_list; list; list = list->next) {
+		struct eir_sd *sd = list->data;
+		struct bt_ad_service_data ads;
+		bt_uuid_t uuid;
+
+		bt_string_to_uuid(&uuid, sd->uuid);
+		g_assert(bt_ad_view_get_service_data(test->eir_data,
+							test->eir_size, &uuid,
+							&ads));
+	}
+}
+
+static void test_peek(const struct test_data *test, struct eir_data *eir)
+{
+	struct eir_peek peek;
+	GSList *list;
+
+	eir_peek(&peek, test->eir_data, test->eir_size);
+
+	g_assert_cmpint(peek.flags, ==, eir->flags);
+	g_assert(peek.tx_power == eir->tx_power);
+	g_assert(peek.rsi == eir->rsi);
+
+	if (eir->name) {
+		g_assert(peek.name_valid);
+		g_assert_cmpint(peek.name_len, ==, strlen(eir->name));
+		g_assert(!memcmp(peek.name, eir->name, peek.name_len));
+	} else {
+		g_assert(peek.name == NULL);
+	}
+
+	for (list = eir->services; list; list = list->next) {
+		bt_uuid_t uuid, u128;
+
+		g_assert(bt_string_to_uuid(&uuid, list->data) == 0);
+		bt_uuid_to_uuid128(&uuid, &u128);
+
+		g_assert(eir_peek_match_uuids(&peek, &u128.value.u128, 1));
+	}
+
+	for (list = eir->sd_list; list; list = list->next) {
+		struct eir_sd *sd = list->data;
+
+		g_assert(eir_peek_has_service_data(&peek, sd->uuid));
+	}
+}
+
 static void test_parsing(gconstpointer data)
 {
 	const struct test_data *test = data;
@@ -649,6 +728,8 @@ static void test_parsing(gconstpointer data)
 	}
 
 	test_ad(data, &eir);
+	test_view(data, &eir);
+	test_peek(data, &eir);
 
 	eir_data_free(&eir);
 
@@ -2412,6 +2412,82 @@ static void test_hash_db(gconstpointer data)
 	context_quit(context);
 }
 
+#define LARGE_DB_SERVICES	100
+#define LARGE_DB_CHRCS		3
+#define LARGE_DB_ROUNDS		1000
+
+static struct gatt_db *make_large_db(void)
+{
+	struct gatt_db *db = gatt_db_new();
+	bt_uuid_t uuid;
+	int i, j;
+
+	for (i = 0; i < LARGE_DB_SERVICES; i++) {
+		struct gatt_db_attribute *attr;
+
+		bt_uuid16_create(&uuid, 0x1800 + i);
+		attr = gatt_db_add_service(db, &uuid, true,
+						1 + LARGE_DB_CHRCS * 3);
+		g_assert(attr);
+
+		for (j = 0; j < LARGE_DB_CHRCS; j++) {
+			struct gatt_db_attribute *chrc;
+
+			bt_uuid16_create(&uuid, 0x2a00 + j);
+			chrc = gatt_db_service_add_characteristic(attr, &uuid,
+						BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ |
+						BT_GATT_CHRC_PROP_NOTIFY,
+						NULL, NULL, NULL);
+			g_assert(chrc);
+
+			bt_uuid16_create(&uuid, GATT_CLIENT_CHARAC_CFG_UUID);
+			g_assert(gatt_db_service_add_descriptor(attr, &uuid,
+						BT_ATT_PERM_READ |
+						BT_ATT_PERM_WRITE,
+						NULL, NULL, NULL));
+		}
+
+		gatt_db_service_set_active(attr, true);
+	}
+
+	return db;
+}
+
+static void test_large_db_read_by_type(const void *data)
+{
+	struct gatt_db *db = make_large_db();
+	struct queue *q = queue_new();
+	bt_uuid_t uuid;
+	int64_t start;
+	int i;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
+
+	start = g_get_monotonic_time();
+
+	for (i = 0; i < LARGE_DB_ROUNDS; i++) {
+		gatt_db_read_by_type(db, 0x0001, 0xffff, uuid, q);
+		g_assert_cmpint(queue_length(q), ==,
+					LARGE_DB_SERVICES * LARGE_DB_CHRCS);
+		queue_remove_all(q, NULL, NULL, NULL);
+	}
+
+	tester_debug("%d read by type rounds over %d attributes: %" PRId64
+			" us", LARGE_DB_ROUNDS,
+			LARGE_DB_SERVICES * (1 + LARGE_DB_CHRCS * 3),
+			g_get_monotonic_time() - start);
+
+	/* Range covering services 10 to 19 only */
+	gatt_db_read_by_type(db, 101, 200, uuid, q);
+	g_assert_cmpint(queue_length(q), ==, 10 * LARGE_DB_CHRCS);
+	queue_remove_all(q, NULL, NULL, NULL);
+
+	queue_destroy(q, NULL);
+	gatt_db_unref(db);
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	struct gatt_db *service_db_1, *service_db_2, *service_db_3;
@@ -4559,5 +4635,8 @@ int main(int argc, char *argv[])
 			test_hash_db, ts_tail_db, NULL,
 			{});
 
+	tester_add("/benchmark/large-db-read-by-type", NULL, NULL,
+					test_large_db_read_by_type, NULL);
+
 	return tester_run();
 }
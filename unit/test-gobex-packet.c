@@ -148,6 +148,31 @@ static void test_decode_encode(void)
 	g_obex_packet_free(pkt);
 }
 
+static void test_decode_encode_reuse(void)
+{
+	GError *err = NULL;
+	uint8_t buf[255];
+	int i;
+
+	for (i = 0; i < 64; i++) {
+		GObexPacket *pkt;
+		gssize len;
+
+		pkt = g_obex_packet_decode(pkt_put_action,
+						sizeof(pkt_put_action), 0,
+						G_OBEX_DATA_REF, &err);
+		g_assert_no_error(err);
+
+		len = g_obex_packet_encode(pkt, buf, sizeof(buf));
+		g_assert_cmpint(len, ==, sizeof(pkt_put_action));
+
+		assert_memequal(pkt_put_action, sizeof(pkt_put_action),
+								buf, len);
+
+		g_obex_packet_free(pkt);
+	}
+}
+
 static gssize get_body_data(void *buf, gsize len, gpointer user_data)
 {
 	uint8_t data[] = { 1, 2, 3, 4 };
@@ -236,6 +261,8 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gobex/test_decode_nval", test_decode_nval);
 
 	g_test_add_func("/gobex/test_encode_pkt", test_decode_encode);
+	g_test_add_func("/gobex/test_encode_pkt_reuse",
+						test_decode_encode_reuse);
 
 	g_test_add_func("/gobex/test_encode_on_demand", test_encode_on_demand);
 	g_test_add_func("/gobex/test_encode_on_demand_fail",
@@ -229,6 +229,9 @@ static const struct command_test_data command_test_2 = {
 	.cmd_size = sizeof(read_info_command),
 };
 
+static const unsigned char read_ext_info_command[] =
+				{ 0x7c, 0x00, 0x00, 0x02, 0x00, 0x00 };
+
 static const unsigned char invalid_index_response[] =
 				{ 0x02, 0x00, 0xff, 0xff, 0x03, 0x00,
 				0x01, 0x00, 0x11 };
@@ -296,6 +299,28 @@ static void test_response(gconstpointer data)
 	execute_context(context);
 }
 
+static void test_pipelined(gconstpointer data)
+{
+	struct context *context = create_context();
+
+	add_action(context, read_info_command, sizeof(read_info_command),
+			NULL, 0, 0, false, ACTION_IGNORE);
+	add_action(context, read_ext_info_command,
+			sizeof(read_ext_info_command), NULL, 0, 0, false,
+			ACTION_PASSED);
+
+	mgmt_set_max_pending(context->mgmt_client, 2);
+	mgmt_set_pipelined(context->mgmt_client, MGMT_OP_READ_INFO, true);
+	mgmt_set_pipelined(context->mgmt_client, MGMT_OP_READ_EXT_INFO, true);
+
+	mgmt_send(context->mgmt_client, MGMT_OP_READ_INFO, 512, 0, NULL,
+						NULL, NULL, NULL);
+	mgmt_send(context->mgmt_client, MGMT_OP_READ_EXT_INFO, 512, 0, NULL,
+						NULL, NULL, NULL);
+
+	execute_context(context);
+}
+
 static void event_cb(uint16_t index, uint16_t length, const void *param,
 							void *user_data)
 {
@@ -307,6 +332,9 @@ static void event_cb(uint16_t index, uint16_t length, const void *param,
 	context_quit(context);
 }
 
+static const unsigned char event_index_removed[] =
+				{ 0x05, 0x00, 0x01, 0x00, 0x00, 0x00 };
+
 static void test_event(gconstpointer data)
 {
 	const struct command_test_data *test = data;
@@ -337,6 +365,50 @@ static void test_event2(gconstpointer data)
 	execute_context(context);
 }
 
+static void batch_cb(uint16_t index, uint16_t length, const void *param,
+							void *user_data)
+{
+	struct context *context = user_data;
+	static unsigned int count;
+
+	/* Quit once the last of the two batched events has arrived */
+	g_assert_cmpint(index, ==, 1);
+
+	if (++count == 2)
+		context_quit(context);
+}
+
+static void unexpected_cb(uint16_t index, uint16_t length, const void *param,
+							void *user_data)
+{
+	g_assert_not_reached();
+}
+
+static void test_event_batch(gconstpointer data)
+{
+	struct context *context = create_context();
+
+	g_assert(mgmt_set_read_batch(context->mgmt_client, 4));
+
+	mgmt_register(context->mgmt_client, MGMT_EV_INDEX_ADDED, 1,
+						batch_cb, context, NULL);
+	mgmt_register(context->mgmt_client, MGMT_EV_INDEX_ADDED, 2,
+						unexpected_cb, context, NULL);
+	mgmt_register(context->mgmt_client, MGMT_EV_CLASS_OF_DEV_CHANGED,
+				MGMT_INDEX_NONE, unexpected_cb, context, NULL);
+	mgmt_register(context->mgmt_client, MGMT_EV_INDEX_REMOVED,
+				MGMT_INDEX_NONE, batch_cb, context, NULL);
+
+	g_assert_cmpint(write(context->fd, event_index_added,
+				sizeof(event_index_added)), ==,
+				sizeof(event_index_added));
+	g_assert_cmpint(write(context->fd, event_index_removed,
+				sizeof(event_index_removed)), ==,
+				sizeof(event_index_removed));
+
+	execute_context(context);
+}
+
 static void unregister_all_cb(uint16_t index, uint16_t length,
 					const void *param, void *user_data)
 {
@@ -428,8 +500,11 @@ int main(int argc, char *argv[])
 	g_test_add_data_func("/mgmt/response/2", &command_test_3,
 								test_response);
 
+	g_test_add_data_func("/mgmt/pipelined/1", NULL, test_pipelined);
+
 	g_test_add_data_func("/mgmt/event/1", &event_test_1, test_event);
 	g_test_add_data_func("/mgmt/event/2", &event_test_1, test_event2);
+	g_test_add_data_func("/mgmt/event/3", NULL, test_event_batch);
 
 	g_test_add_data_func("/mgmt/unregister/1", &event_test_1,
 							test_unregister_all);
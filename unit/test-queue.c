@@ -246,6 +246,86 @@ static void test_remove_all(const void *data)
 	tester_test_passed();
 }
 
+struct hash_item {
+	unsigned int key;
+};
+
+static unsigned int hash_item(const void *data)
+{
+	const struct hash_item *item = data;
+
+	return item->key;
+}
+
+static bool match_item(const void *a, const void *b)
+{
+	const struct hash_item *item = a;
+	unsigned int key = PTR_TO_UINT(b);
+
+	return item->key == key;
+}
+
+static void test_hash(const void *data)
+{
+	struct queue *queue;
+	struct hash_item items[1024];
+	unsigned int i;
+
+	queue = queue_new();
+	g_assert(queue != NULL);
+
+	for (i = 0; i < 512; i++) {
+		items[i].key = i;
+		g_assert(queue_push_tail(queue, &items[i]));
+	}
+
+	/* Index built from existing entries */
+	g_assert(queue_set_hash(queue, hash_item));
+	g_assert(!queue_set_hash(queue, hash_item));
+
+	for (i = 512; i < 1024; i++) {
+		items[i].key = i;
+		g_assert(queue_push_head(queue, &items[i]));
+	}
+
+	g_assert(queue_length(queue) == 1024);
+
+	for (i = 0; i < 1024; i++)
+		g_assert(queue_find_hash(queue, i, match_item,
+					UINT_TO_PTR(i)) == &items[i]);
+
+	g_assert(queue_find_hash(queue, 2048, match_item,
+					UINT_TO_PTR(2048)) == NULL);
+
+	/* Entries removed from the list must leave the index */
+	g_assert(queue_pop_head(queue) == &items[1023]);
+	g_assert(queue_remove(queue, &items[0]));
+	g_assert(queue_remove_if(queue, match_item, UINT_TO_PTR(10)) ==
+								&items[10]);
+
+	g_assert(!queue_find_hash(queue, 1023, match_item, UINT_TO_PTR(1023)));
+	g_assert(!queue_find_hash(queue, 0, match_item, UINT_TO_PTR(0)));
+	g_assert(!queue_find_hash(queue, 10, match_item, UINT_TO_PTR(10)));
+
+	/* Key change followed by rehash */
+	items[20].key = 4096;
+	g_assert(queue_rehash(queue, &items[20]));
+	g_assert(!queue_find_hash(queue, 20, match_item, UINT_TO_PTR(20)));
+	g_assert(queue_find_hash(queue, 4096, match_item,
+					UINT_TO_PTR(4096)) == &items[20]);
+	g_assert(!queue_rehash(queue, &items[0]));
+
+	g_assert(queue_remove_all(queue, NULL, NULL, NULL) == 1021);
+	g_assert(!queue_find_hash(queue, 30, match_item, UINT_TO_PTR(30)));
+
+	g_assert(queue_push_tail(queue, &items[30]));
+	g_assert(queue_find_hash(queue, 30, match_item,
+					UINT_TO_PTR(30)) == &items[30]);
+
+	queue_destroy(queue, NULL);
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -263,6 +343,7 @@ int main(int argc, char *argv[])
 						test_destroy_remove, NULL);
 	tester_add("/queue/push_after",  NULL, NULL, test_push_after, NULL);
 	tester_add("/queue/remove_all",  NULL, NULL, test_remove_all, NULL);
+	tester_add("/queue/hash",  NULL, NULL, test_hash, NULL);
 
 	return tester_run();
 }
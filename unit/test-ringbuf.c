@@ -133,6 +133,157 @@ static void test_printf(const void *data)
 	tester_test_passed();
 }
 
+static void test_pushv(const void *data)
+{
+	static size_t rb_capa = 512;
+	uint8_t in[100], out[100];
+	struct ringbuf *rb;
+	struct iovec iov[2];
+	uint16_t hdr;
+	int i;
+
+	rb = ringbuf_new(rb_capa);
+	g_assert(rb != NULL);
+
+	for (i = 0; i < 10000; i++) {
+		size_t count = i % sizeof(in);
+
+		tester_debug("Iteration %i\n", i);
+
+		memset(in, i, count);
+		hdr = count;
+
+		iov[0].iov_base = &hdr;
+		iov[0].iov_len = sizeof(hdr);
+		iov[1].iov_base = in;
+		iov[1].iov_len = count;
+
+		g_assert(ringbuf_pushv(rb, iov, 2));
+		g_assert(ringbuf_len(rb) == sizeof(hdr) + count);
+
+		hdr = 0;
+		g_assert(ringbuf_pull(rb, &hdr, sizeof(hdr)) == sizeof(hdr));
+		g_assert(hdr == count);
+		g_assert(ringbuf_pull(rb, out, count) == count);
+		g_assert(memcmp(in, out, count) == 0);
+		g_assert(ringbuf_len(rb) == 0);
+	}
+
+	/* A frame that does not fit is rejected as a whole */
+	iov[0].iov_base = in;
+	iov[0].iov_len = sizeof(in);
+
+	for (i = 0; i < 5; i++)
+		g_assert(ringbuf_pushv(rb, iov, 1));
+
+	g_assert(!ringbuf_pushv(rb, iov, 1));
+	g_assert(ringbuf_len(rb) == 5 * sizeof(in));
+	g_assert(ringbuf_pull(rb, out, 6 * sizeof(in)) == 0);
+
+	ringbuf_free(rb);
+	tester_test_passed();
+}
+
+static void test_peekv(const void *data)
+{
+	static size_t rb_capa = 512;
+	uint8_t in[100], out[100];
+	struct ringbuf *rb;
+	struct iovec iov[2];
+	int i, j, iovcnt;
+
+	rb = ringbuf_new(rb_capa);
+	g_assert(rb != NULL);
+
+	for (i = 0; i < 10000; i++) {
+		size_t count = i % sizeof(in) + 1, len = 0;
+
+		tester_debug("Iteration %i\n", i);
+
+		memset(in, i, count);
+
+		iovcnt = ringbuf_reservev(rb, iov);
+		g_assert(iovcnt > 0);
+
+		for (j = 0; j < iovcnt && len < count; j++) {
+			size_t n = MIN(iov[j].iov_len, count - len);
+
+			memcpy(iov[j].iov_base, in + len, n);
+			len += n;
+		}
+
+		g_assert(len == count);
+		g_assert(ringbuf_commit(rb, count) == count);
+		g_assert(ringbuf_len(rb) == count);
+
+		iovcnt = ringbuf_peekv(rb, 0, iov);
+		g_assert(iovcnt > 0);
+
+		for (j = 0, len = 0; j < iovcnt; j++) {
+			memcpy(out + len, iov[j].iov_base, iov[j].iov_len);
+			len += iov[j].iov_len;
+		}
+
+		g_assert(len == count);
+		g_assert(memcmp(in, out, count) == 0);
+
+		/* Leave data behind so that the next round wraps */
+		g_assert(ringbuf_drain(rb, count - 1) == count - 1);
+		g_assert(ringbuf_peekv(rb, 1, iov) == 0);
+		g_assert(ringbuf_peekv(rb, 2, iov) < 0);
+		ringbuf_drain(rb, 1);
+	}
+
+	ringbuf_free(rb);
+	tester_test_passed();
+}
+
+static void test_mirrored(const void *data)
+{
+	struct ringbuf *rb;
+	struct iovec iov[2];
+	size_t capa, len;
+	char *ptr;
+	int i;
+
+	rb = ringbuf_new_mirrored(100);
+	if (!rb) {
+		tester_test_abort();
+		return;
+	}
+
+	g_assert(ringbuf_is_mirrored(rb));
+
+	capa = ringbuf_capacity(rb);
+	g_assert(capa >= 100);
+	g_assert(ringbuf_avail(rb) == capa);
+
+	/* Move the indexes close to the end of the buffer */
+	for (i = 0; i < (int) capa - 4; i++)
+		g_assert(ringbuf_printf(rb, "x") == 1);
+
+	g_assert(ringbuf_drain(rb, capa - 5) == capa - 5);
+
+	g_assert(ringbuf_printf(rb, "wrapped") == 7);
+
+	ptr = ringbuf_peek(rb, 0, &len);
+	g_assert(len == 8);
+	g_assert(strncmp(ptr, "xwrapped", len) == 0);
+
+	ptr = ringbuf_peek(rb, 1, &len);
+	g_assert(len == 7);
+	g_assert(strncmp(ptr, "wrapped", len) == 0);
+
+	g_assert(ringbuf_peekv(rb, 0, iov) == 1);
+	g_assert(iov[0].iov_len == 8);
+
+	g_assert(ringbuf_reservev(rb, iov) == 1);
+	g_assert(iov[0].iov_len == capa - 8);
+
+	ringbuf_free(rb);
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -140,6 +291,9 @@ int main(int argc, char *argv[])
 	tester_add("/ringbuf/power2", NULL, NULL, test_power2, NULL);
 	tester_add("/ringbuf/alloc", NULL, NULL, test_alloc, NULL);
 	tester_add("/ringbuf/printf", NULL, NULL, test_printf, NULL);
+	tester_add("/ringbuf/pushv", NULL, NULL, test_pushv, NULL);
+	tester_add("/ringbuf/peekv", NULL, NULL, test_peekv, NULL);
+	tester_add("/ringbuf/mirrored", NULL, NULL, test_mirrored, NULL);
 
 	return tester_run();
 }
@@ -757,6 +757,47 @@ static void test_sdp_de_attr(gconstpointer data)
 	tester_test_passed();
 }
 
+static void test_sdp_de_seq16(gconstpointer data)
+{
+	uint8_t dtd = SDP_UINT16;
+	uint16_t values[100];
+	void *dtds[100], *ptrs[100];
+	sdp_record_t *rec, *dup;
+	sdp_data_t *d;
+	sdp_buf_t buf;
+	uint16_t i;
+	int scanned;
+
+	/* 100 UINT16 elements do not fit in a SEQ8 */
+	for (i = 0; i < 100; i++) {
+		values[i] = i;
+		dtds[i] = &dtd;
+		ptrs[i] = &values[i];
+	}
+
+	rec = sdp_record_alloc();
+	sdp_attr_add(rec, 0x0200, sdp_seq_alloc(dtds, ptrs, 100));
+	g_assert(sdp_gen_record_pdu(rec, &buf) == 0);
+
+	dup = sdp_extract_pdu(buf.data, buf.data_size, &scanned);
+	g_assert(dup != NULL);
+	g_assert_cmpint(scanned, ==, buf.data_size);
+
+	d = sdp_data_get(dup, 0x0200);
+	g_assert(d != NULL);
+	g_assert_cmpuint(d->dtd, ==, SDP_SEQ16);
+
+	for (i = 0, d = d->val.dataseq; d; d = d->next, i++)
+		g_assert_cmpuint(d->val.uint16, ==, i);
+
+	g_assert_cmpuint(i, ==, 100);
+
+	free(buf.data);
+	sdp_record_free(dup);
+	sdp_record_free(rec);
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -2214,6 +2255,33 @@ int main(int argc, char *argv[])
 			0xff, 0xff, 0x35, 0x03, 0x09, 0x00, 0x01, 0x00),
 		raw_pdu(0x01, 0x00, 0x01, 0x00, 0x02, 0x00, 0x04));
 
+	/*
+	 * Service Search Attribute Request
+	 *
+	 * Verify that repeated identical requests, answered from the
+	 * response cache, and a request for a different attribute of the
+	 * same service get the correct responses.
+	 */
+	define_ssa("CACHE/repeat",
+		raw_pdu(0x06, 0x00, 0x01, 0x00, 0x0d, 0x35, 0x03, 0x19,
+			0x11, 0x01, 0x00, 0x1e, 0x35, 0x03, 0x09, 0x00,
+			0x03, 0x00),
+		raw_pdu(0x07, 0x00, 0x01, 0x00, 0x0d, 0x00, 0x0a, 0x35,
+			0x08, 0x35, 0x06, 0x09, 0x00, 0x03, 0x19, 0x11,
+			0x01, 0x00),
+		raw_pdu(0x06, 0x00, 0x02, 0x00, 0x0d, 0x35, 0x03, 0x19,
+			0x11, 0x01, 0x00, 0x1e, 0x35, 0x03, 0x09, 0x00,
+			0x03, 0x00),
+		raw_pdu(0x07, 0x00, 0x02, 0x00, 0x0d, 0x00, 0x0a, 0x35,
+			0x08, 0x35, 0x06, 0x09, 0x00, 0x03, 0x19, 0x11,
+			0x01, 0x00),
+		raw_pdu(0x06, 0x00, 0x03, 0x00, 0x0f, 0x35, 0x05, 0x1a,
+			0x00, 0x00, 0x11, 0x01, 0x00, 0x13, 0x35, 0x03,
+			0x09, 0x00, 0x07, 0x00),
+		raw_pdu(0x07, 0x00, 0x03, 0x00, 0x0f, 0x00, 0x0c, 0x35,
+			0x0a, 0x35, 0x08, 0x09, 0x00, 0x07, 0x0a, 0x00,
+			0x00, 0xff, 0xff, 0x00));
+
 	/*
 	 * Service Browse
 	 *
@@ -2719,6 +2787,8 @@ int main(int argc, char *argv[])
 	 *
 	 * Test extraction of valid DEs supported by sdp_extract_attr().
 	 */
+	tester_add("/sdp/DE/SEQ16", NULL, NULL, test_sdp_de_seq16, NULL);
+
 	define_test_de_attr("TEXT_STR8/empty",
 			raw_data(0x25, 0x00),
 			exp_data(SDP_TEXT_STR8, str, ""));
@@ -249,6 +249,50 @@ static void test_multiple(const void *data)
 	tester_test_passed();
 }
 
+static void test_multi(const void *data)
+{
+	const char *keys[] = { "00:00:00:00:00:03", "00:00:00:00:00:01",
+				"00:00:00:00:00:02", "00:00:00:00:00:04" };
+	const char *values[] = { "c", "a", "b", NULL };
+	char *str[4];
+	unsigned int i;
+
+	util_create_empty();
+
+	g_assert(textfile_put(test_pathname, keys[3], "d") == 0);
+	g_assert(textfile_put(test_pathname, keys[1], "x") == 0);
+
+	g_assert(textfile_put_multi(test_pathname, keys, values, 4) == 0);
+
+	g_assert(textfile_get_multi(test_pathname, keys, str, 4) == 0);
+
+	for (i = 0; i < 4; i++) {
+		tester_debug("%s %s\n", keys[i], str[i]);
+
+		if (!values[i]) {
+			g_assert(str[i] == NULL);
+			continue;
+		}
+
+		g_assert(str[i] != NULL);
+		g_assert(strcmp(str[i], values[i]) == 0);
+		free(str[i]);
+	}
+
+	values[0] = NULL;
+	values[2] = NULL;
+	g_assert(textfile_put_multi(test_pathname, keys, values, 4) == 0);
+
+	str[0] = textfile_get(test_pathname, keys[1]);
+	g_assert(str[0] != NULL);
+	g_assert(strcmp(str[0], "a") == 0);
+	free(str[0]);
+
+	g_assert(textfile_get(test_pathname, keys[0]) == NULL);
+	g_assert(textfile_get(test_pathname, keys[2]) == NULL);
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -257,6 +301,7 @@ int main(int argc, char *argv[])
 	tester_add("/textfile/delete", NULL, NULL, test_delete, NULL);
 	tester_add("/textfile/overwrite", NULL, NULL, test_overwrite, NULL);
 	tester_add("/textfile/multiple", NULL, NULL, test_multiple, NULL);
+	tester_add("/textfile/multi", NULL, NULL, test_multi, NULL);
 
 	return tester_run();
 }
@@ -16,6 +16,7 @@
 
 #include "lib/bluetooth.h"
 #include "lib/uuid.h"
+#include "src/shared/util.h"
 #include "src/shared/tester.h"
 
 struct uuid_test_data {
@@ -169,6 +170,112 @@ static void test_cmp(gconstpointer data)
 	tester_test_passed();
 }
 
+static int sign(int value)
+{
+	return value < 0 ? -1 : value > 0;
+}
+
+static const char *order[] = {
+	"0000",
+	"1234",
+	"FFFF",
+	"00010000",
+	"12345678",
+	"12345678-0000-1000-8000-00805f9b34fa",
+	"12345678-0000-1000-8000-00805f9b34fc",
+	"F0000000-0000-1000-8000-00805f9b34fb",
+	"FFFFFFFF-FFFF-FFFF-FFFF-FFFFFFFFFFFF",
+	NULL,
+};
+
+static void test_cmp_order(gconstpointer data)
+{
+	size_t i, j;
+
+	for (i = 0; order[i]; i++) {
+		for (j = 0; order[j]; j++) {
+			bt_uuid_t uuid1, uuid2, u1, u2;
+			int ret;
+
+			g_assert(bt_string_to_uuid(&uuid1, order[i]) == 0);
+			g_assert(bt_string_to_uuid(&uuid2, order[j]) == 0);
+
+			bt_uuid_to_uuid128(&uuid1, &u1);
+			bt_uuid_to_uuid128(&uuid2, &u2);
+
+			ret = memcmp(&u1.value.u128, &u2.value.u128, 16);
+
+			g_assert(sign(bt_uuid_cmp(&uuid1, &uuid2)) ==
+								sign(ret));
+			g_assert(sign(bt_uuid_cmp(&uuid1, &uuid2)) ==
+						sign((int) i - (int) j));
+		}
+	}
+
+	tester_test_passed();
+}
+
+static void test_find(gconstpointer data)
+{
+	uint128_t set[G_N_ELEMENTS(order) - 1];
+	size_t i;
+
+	for (i = 0; order[i]; i++) {
+		bt_uuid_t uuid, u128;
+
+		g_assert(bt_string_to_uuid(&uuid, order[i]) == 0);
+		bt_uuid_to_uuid128(&uuid, &u128);
+
+		g_assert(bt_uuid128_find(set, i, &u128.value.u128) == -1);
+
+		set[i] = u128.value.u128;
+
+		g_assert(bt_uuid128_find(set, i + 1, &u128.value.u128) ==
+								(int) i);
+	}
+
+	tester_test_passed();
+}
+
+static const struct {
+	uint16_t uuid;
+	const char *str;
+} names[] = {
+	{ 0x0000, "Unknown" },
+	{ 0x0001, "SDP" },
+	{ 0x180d, "Heart Rate" },
+	{ 0xfccc, "Wi-Fi Easy Connect Specification" },
+	{ 0xfd5f, "Oculus VR, LLC" },
+	{ 0xfeff, "GN Netcom" },
+	{ 0xfffe, "Wireless Power Transfer" },
+	{ 0xffff, "Unknown" },
+};
+
+static void test_to_str(gconstpointer data)
+{
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(names); i++)
+		g_assert_cmpstr(bt_uuid16_to_str(names[i].uuid), ==,
+							names[i].str);
+
+	g_assert_cmpstr(bt_uuidstr_to_str(
+				"0000180d-0000-1000-8000-00805f9b34fb"), ==,
+				"Heart Rate");
+	g_assert_cmpstr(bt_uuidstr_to_str(
+				"6e400001-b5a3-f393-e0a9-e50e24dcca9e"), ==,
+				"Nordic UART Service");
+	g_assert_cmpstr(bt_uuidstr_to_str(
+				"6e400001-b5a3-f393-e0a9-e50e24dcca9f"), ==,
+				"Vendor specific");
+
+	g_assert_cmpstr(bt_appear_to_str(0x00c1), ==, "Sports Watch");
+	g_assert_cmpstr(bt_appear_to_str(0x00c8), ==, "Watch");
+	g_assert_cmpstr(bt_appear_to_str(0xffff), ==, "Undefined");
+
+	tester_test_passed();
+}
+
 static const struct uuid_test_data compress[] = {
 	{
 		.str = "00001234-0000-1000-8000-00805f9b34fb",
@@ -247,6 +354,10 @@ int main(int argc, char *argv[])
 	tester_add("/uuid/onetwentyeight/str", &uuid_128, NULL, test_str, NULL);
 	tester_add("/uuid/onetwentyeight/cmp", &uuid_128, NULL, test_cmp, NULL);
 
+	tester_add("/uuid/cmp/order", NULL, NULL, test_cmp_order, NULL);
+	tester_add("/uuid/find", NULL, NULL, test_find, NULL);
+	tester_add("/uuid/to_str", NULL, NULL, test_to_str, NULL);
+
 	for (i = 0; malformed[i]; i++) {
 		char *testpath;
 